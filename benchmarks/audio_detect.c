@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Offline throughput of the igt_audio signal detectors. Runs every backend
+ * over either a synthesized capture or a S32_LE WAV file as written by
+ * audio_create_wav_file_s32_le(), looking for the same frequencies as
+ * kms_chamelium_audio.
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "igt_audio.h"
+#include "igt_benchmark.h"
+
+static const int test_frequencies[] = {
+	300, 600, 1200, 10000, 80000,
+};
+
+static double elapsed(const struct timespec *start,
+		      const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + 1e-9*(end->tv_nsec - start->tv_nsec);
+}
+
+static int32_t *load_wav(const char *path, size_t *len,
+			 uint32_t *rate, uint16_t *channels)
+{
+	struct stat st;
+	int32_t *pcm;
+	ssize_t ret;
+	int fd;
+
+	fd = audio_open_wav_file_s32_le(path, rate, channels);
+	if (fd < 0 || fstat(fd, &st))
+		return NULL;
+
+	pcm = malloc(st.st_size);
+	ret = read(fd, pcm, st.st_size);
+	close(fd);
+	if (!pcm || ret < 0) {
+		free(pcm);
+		return NULL;
+	}
+
+	*len = ret / sizeof(int32_t);
+	*len -= *len % *channels;
+
+	return pcm;
+}
+
+static int32_t *synthesize(struct audio_signal *signal, size_t frames,
+			   uint16_t channels)
+{
+	double *tmp = malloc(frames * channels * sizeof(double));
+	int32_t *pcm = malloc(frames * channels * sizeof(int32_t));
+
+	audio_signal_fill(signal, tmp, frames);
+	audio_convert_to(pcm, tmp, frames * channels, SND_PCM_FORMAT_S32_LE);
+	free(tmp);
+
+	return pcm;
+}
+
+struct measure {
+	struct audio_signal *signal;
+	enum audio_detector_backend backend;
+	uint32_t rate;
+	uint16_t channels;
+	size_t window, hop;
+	const int32_t *pcm;
+	size_t len;
+	size_t windows, detected;
+};
+
+static double measure(void *data)
+{
+	struct measure *m = data;
+	struct timespec start, end;
+
+	m->windows = 0;
+	m->detected = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int j = 0; j < m->channels; j++) {
+		struct audio_detector_stats stats;
+		struct audio_detector *det;
+
+		det = audio_detector_init(m->signal, m->rate, j, m->window,
+					  m->hop, m->backend);
+		audio_detector_push_s32_le(det, m->pcm, m->len, m->channels, j);
+		audio_detector_get_stats(det, &stats);
+		audio_detector_fini(det);
+
+		m->windows += stats.windows;
+		m->detected += stats.detected;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return 1e-6 * m->len / elapsed(&start, &end);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		IGT_BENCHMARK_LONG_OPTIONS,
+		{ }
+	};
+	static const struct {
+		const char *name;
+		enum audio_detector_backend backend;
+	} backends[] = {
+		{ "goertzel", AUDIO_DETECTOR_GOERTZEL },
+		{ "fft", AUDIO_DETECTOR_FFT },
+	};
+	const struct igt_benchmark_result *r;
+	struct audio_signal *signal;
+	struct igt_benchmark *b;
+	struct measure m;
+	uint32_t rate = 48000;
+	uint16_t channels = 2;
+	size_t window = 2048, hop = 0;
+	double seconds = 10;
+	const char *path = NULL;
+	int32_t *pcm;
+	size_t len;
+	int step, c;
+
+	b = igt_benchmark_create("audio_detect");
+	if (!b)
+		return 1;
+
+	while ((c = getopt_long(argc, argv, "f:r:c:w:h:t:", options, NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'w':
+			window = atoi(optarg);
+			break;
+		case 'h':
+			hop = atoi(optarg);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		default:
+			if (!igt_benchmark_option(b, c, optarg))
+				break;
+
+			fprintf(stderr,
+				"usage: %s [-f file.wav | -r rate -c channels -t seconds]"
+				" [-w window] [-h hop]\n"
+				IGT_BENCHMARK_USAGE,
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!hop)
+		hop = window;
+
+	if (path) {
+		pcm = load_wav(path, &len, &rate, &channels);
+		if (!pcm) {
+			fprintf(stderr, "Unable to load %s\n", path);
+			return 1;
+		}
+	}
+
+	/* Same frequencies as kms_chamelium_audio, two bins apart per channel */
+	signal = audio_signal_init(channels, rate);
+	step = 2 * rate / window;
+	for (int i = 0; i < sizeof(test_frequencies) / sizeof(test_frequencies[0]); i++)
+		for (int j = 0; j < channels; j++)
+			audio_signal_add_frequency(signal,
+						   test_frequencies[i] + j * step,
+						   j);
+	audio_signal_synthesize(signal);
+
+	if (!path) {
+		size_t frames = seconds * rate;
+
+		pcm = synthesize(signal, frames, channels);
+		len = frames * channels;
+	}
+
+	igt_benchmark_param(b, "source", "%s", path ?: "synthesized");
+	igt_benchmark_param(b, "frames", "%zu", len / channels);
+	igt_benchmark_param(b, "rate", "%u", rate);
+	igt_benchmark_param(b, "channels", "%u", channels);
+	igt_benchmark_param(b, "window", "%zu", window);
+	igt_benchmark_param(b, "hop", "%zu", hop);
+
+	printf("%zu frames, %u Hz, %u channels, window %zu, hop %zu\n",
+	       len / channels, rate, channels, window, hop);
+
+	m = (struct measure){
+		.signal = signal,
+		.rate = rate,
+		.channels = channels,
+		.window = window,
+		.hop = hop,
+		.pcm = pcm,
+		.len = len,
+	};
+	for (int i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+		m.backend = backends[i].backend;
+		r = igt_benchmark_run(b, backends[i].name, "Msamples/s", true,
+				      measure, &m);
+		if (!r)
+			return 1;
+
+		printf("%-8s %9.2f Msamples/s, %zu/%zu windows detected\n",
+		       backends[i].name, r->median, m.detected, m.windows);
+	}
+
+	audio_signal_fini(signal);
+	free(pcm);
+
+	return igt_benchmark_finish(b) ? 1 : 0;
+}
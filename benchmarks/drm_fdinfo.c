@@ -0,0 +1,405 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/*
+ * Measures parsing of synthetic fdinfo files with the key sets of several
+ * drivers: one call to __igt_parse_drm_fdinfo() per file as the tools used to
+ * do, a parser reused across files, and batches of files through a parser.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt.h"
+#include "igt_benchmark.h"
+#include "igt_drm_fdinfo.h"
+
+#define BATCH 16
+
+static const char i915_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t26\n"
+	"ino:\t1077\n"
+	"drm-driver:\ti915\n"
+	"drm-client-id:\t%u\n"
+	"drm-pdev:\t0000:00:02.0\n"
+	"drm-total-system0:\t%u KiB\n"
+	"drm-shared-system0:\t0\n"
+	"drm-active-system0:\t0\n"
+	"drm-resident-system0:\t%u KiB\n"
+	"drm-purgeable-system0:\t0\n"
+	"drm-total-local0:\t%u KiB\n"
+	"drm-shared-local0:\t0\n"
+	"drm-active-local0:\t0\n"
+	"drm-resident-local0:\t%u KiB\n"
+	"drm-purgeable-local0:\t0\n"
+	"drm-engine-render:\t%u ns\n"
+	"drm-engine-copy:\t%u ns\n"
+	"drm-engine-video:\t%u ns\n"
+	"drm-engine-capacity-video:\t2\n"
+	"drm-engine-video-enhance:\t%u ns\n"
+	"drm-engine-compute:\t%u ns\n";
+
+static const char xe_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t0100002\n"
+	"mnt_id:\t25\n"
+	"ino:\t1077\n"
+	"drm-driver:\txe\n"
+	"drm-client-id:\t%u\n"
+	"drm-pdev:\t0000:03:00.0\n"
+	"drm-total-system:\t%u KiB\n"
+	"drm-shared-system:\t0\n"
+	"drm-active-system:\t0\n"
+	"drm-resident-system:\t%u KiB\n"
+	"drm-purgeable-system:\t0\n"
+	"drm-total-gtt:\t%u KiB\n"
+	"drm-shared-gtt:\t0\n"
+	"drm-active-gtt:\t0\n"
+	"drm-resident-gtt:\t%u KiB\n"
+	"drm-total-vram0:\t%u MiB\n"
+	"drm-shared-vram0:\t0\n"
+	"drm-active-vram0:\t0\n"
+	"drm-resident-vram0:\t%u MiB\n"
+	"drm-cycles-rcs:\t%u\n"
+	"drm-total-cycles-rcs:\t7655183225\n"
+	"drm-cycles-bcs:\t%u\n"
+	"drm-total-cycles-bcs:\t7655183225\n"
+	"drm-cycles-vcs:\t%u\n"
+	"drm-total-cycles-vcs:\t7655183225\n"
+	"drm-engine-capacity-vcs:\t2\n"
+	"drm-cycles-vecs:\t0\n"
+	"drm-total-cycles-vecs:\t7655183225\n"
+	"drm-cycles-ccs:\t0\n"
+	"drm-total-cycles-ccs:\t7655183225\n";
+
+static const char amdgpu_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t24\n"
+	"ino:\t1077\n"
+	"drm-driver:\tamdgpu\n"
+	"drm-client-id:\t%u\n"
+	"drm-pdev:\t0000:0a:00.0\n"
+	"pasid:\t32770\n"
+	"drm-memory-vram:\t%u KiB\n"
+	"drm-memory-gtt:\t%u KiB\n"
+	"drm-memory-cpu:\t%u KiB\n"
+	"amd-memory-visible-vram:\t%u KiB\n"
+	"amd-evicted-vram:\t0 KiB\n"
+	"amd-evicted-visible-vram:\t0 KiB\n"
+	"amd-requested-vram:\t%u KiB\n"
+	"amd-requested-visible-vram:\t0 KiB\n"
+	"amd-requested-gtt:\t0 KiB\n"
+	"drm-engine-gfx:\t%u ns\n"
+	"drm-engine-compute:\t%u ns\n"
+	"drm-engine-dma:\t%u ns\n"
+	"drm-engine-dec:\t%u ns\n"
+	"drm-engine-enc:\t%u ns\n"
+	"drm-engine-enc_1:\t0 ns\n"
+	"drm-engine-jpeg:\t0 ns\n";
+
+static const char msm_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t24\n"
+	"ino:\t1077\n"
+	"drm-driver:\tmsm\n"
+	"drm-client-id:\t%u\n"
+	"drm-engine-gpu:\t%u ns\n"
+	"drm-cycles-gpu:\t%u\n"
+	"drm-maxfreq-gpu:\t680000000 Hz\n"
+	"drm-total-memory:\t%u KiB\n"
+	"drm-shared-memory:\t%u\n"
+	"drm-active-memory:\t%u\n"
+	"drm-resident-memory:\t%u KiB\n"
+	"drm-purgeable-memory:\t%u\n";
+
+static const char *i915_engines[] = {
+	"render", "copy", "video", "video-enhance", "compute",
+};
+static const char *i915_regions[] = { "system0", "local0" };
+
+static const char *xe_engines[] = { "rcs", "bcs", "vcs", "vecs", "ccs" };
+static const char *xe_regions[] = { "system", "gtt", "vram0" };
+
+static const char *amdgpu_engines[] = {
+	"gfx", "compute", "dma", "dec", "enc", "enc_1", "jpeg",
+};
+static const char *amdgpu_regions[] = { "vram", "gtt", "cpu" };
+
+static const char *msm_engines[] = { "gpu" };
+static const char *msm_regions[] = { "memory" };
+
+#define DRIVER(name) { #name, name##_fdinfo, \
+	name##_engines, ARRAY_SIZE(name##_engines), \
+	name##_regions, ARRAY_SIZE(name##_regions) }
+
+static const struct fdinfo_driver {
+	const char *name;
+	const char *fmt;
+	const char **engines;
+	unsigned int num_engines;
+	const char **regions;
+	unsigned int num_regions;
+} drivers[] = {
+	DRIVER(i915),
+	DRIVER(xe),
+	DRIVER(amdgpu),
+	DRIVER(msm),
+};
+
+enum method {
+	LEGACY,
+	PARSER,
+	BATCHED,
+};
+
+static const char *method_names[] = {
+	[LEGACY] = "legacy",
+	[PARSER] = "parser",
+	[BATCHED] = "batch",
+};
+
+static double elapsed(const struct timespec *start,
+		      const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + 1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+static void write_files(int dir, const struct fdinfo_driver *driver,
+			unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int v = 1000 * i + 7;
+		char name[32];
+		FILE *file;
+		int fd;
+
+		snprintf(name, sizeof(name), "%s-%u", driver->name, i);
+		fd = openat(dir, name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		igt_assert(fd >= 0);
+		file = fdopen(fd, "w");
+		igt_assert(file);
+		/* Extra arguments are unused by the shorter formats. */
+		fprintf(file, driver->fmt, i + 1, v, v, v, v, v, v, v, v, v, v, v);
+		fclose(file);
+	}
+}
+
+static void remove_files(int dir, const struct fdinfo_driver *driver,
+			 unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "%s-%u", driver->name, i);
+		unlinkat(dir, name, 0);
+	}
+}
+
+struct measure {
+	int dir;
+	const struct fdinfo_driver *driver;
+	char (*names)[32];
+	unsigned int count;
+	enum method method;
+	bool maps;
+};
+
+/* Returns the time taken to parse one file, in ns. */
+static double measure(void *data)
+{
+	const struct measure *m = data;
+	const struct fdinfo_driver *driver = m->driver;
+	const char **engines = m->maps ? driver->engines : NULL;
+	const char **regions = m->maps ? driver->regions : NULL;
+	unsigned int num_engines = m->maps ? driver->num_engines : 0;
+	unsigned int num_regions = m->maps ? driver->num_regions : 0;
+	char (*names)[32] = m->names;
+	unsigned int count = m->count;
+	int dir = m->dir;
+	struct drm_client_fdinfo *infos = malloc(BATCH * sizeof(*infos));
+	struct igt_drm_fdinfo_parser *parser = NULL;
+	const char *batch[BATCH];
+	unsigned int results[BATCH];
+	struct timespec start, end;
+	uint64_t files = 0;
+
+	igt_assert(infos);
+	if (m->method != LEGACY) {
+		parser = igt_drm_fdinfo_parser_create(engines, num_engines,
+						      regions, num_regions);
+		igt_assert(parser);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (unsigned int i = 0; i < count; i += BATCH) {
+			unsigned int n = min_t(unsigned int, count - i, BATCH);
+
+			switch (m->method) {
+			case LEGACY:
+				for (unsigned int j = 0; j < n; j++) {
+					memset(infos, 0, sizeof(*infos));
+					igt_assert(__igt_parse_drm_fdinfo(dir, names[i + j],
+									  infos,
+									  engines, num_engines,
+									  regions, num_regions));
+				}
+				break;
+			case PARSER:
+				for (unsigned int j = 0; j < n; j++) {
+					memset(infos, 0, sizeof(*infos));
+					igt_assert(igt_drm_fdinfo_parse(parser, dir,
+									names[i + j],
+									infos));
+				}
+				break;
+			case BATCHED:
+				for (unsigned int j = 0; j < n; j++)
+					batch[j] = names[i + j];
+				igt_assert_eq(igt_drm_fdinfo_parse_batch(parser, dir,
+									 batch, n,
+									 infos,
+									 results), n);
+				break;
+			}
+		}
+
+		files += count;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+	} while (elapsed(&start, &end) < 0.2);
+
+	igt_drm_fdinfo_parser_destroy(parser);
+	free(infos);
+
+	return 1e9 * elapsed(&start, &end) / files;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d <driver>  Only use the i915, xe, amdgpu or msm key set\n"
+		"  -n <files>   Number of fdinfo files per driver (default 256)\n"
+		"  -r <reps>    Same as --repeat, default 13 here\n"
+		"  -m           Pass the engine and region maps to the parser\n"
+		IGT_BENCHMARK_USAGE,
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		IGT_BENCHMARK_LONG_OPTIONS,
+		{ }
+	};
+	char dirname[] = "/tmp/drm_fdinfo-XXXXXX";
+	const struct igt_benchmark_result *r;
+	struct igt_benchmark *b;
+	const char *only = NULL;
+	unsigned int count = 256;
+	char (*names)[32];
+	struct measure m;
+	bool maps = false;
+	int c, dir;
+
+	b = igt_benchmark_create("drm_fdinfo");
+	if (!b)
+		return 1;
+
+	/* The parsers are quick and noisy, keep more samples than usual */
+	igt_benchmark_option(b, IGT_BENCHMARK_OPT_REPEAT, "13");
+
+	while ((c = getopt_long(argc, argv, "d:n:r:mh", options, NULL)) != -1) {
+		switch (c) {
+		case 'd':
+			only = optarg;
+			break;
+
+		case 'n':
+			count = atoi(optarg);
+			if (count < 1)
+				count = 1;
+			break;
+
+		case 'r':
+			if (igt_benchmark_option(b, IGT_BENCHMARK_OPT_REPEAT,
+						 optarg)) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+
+		case 'm':
+			maps = true;
+			break;
+
+		default:
+			if (c != 'h' && !igt_benchmark_option(b, c, optarg))
+				break;
+
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	igt_benchmark_param(b, "files", "%u", count);
+	igt_benchmark_param(b, "maps", "%s", maps ? "yes" : "no");
+
+	igt_assert(mkdtemp(dirname));
+	dir = open(dirname, O_DIRECTORY | O_RDONLY);
+	igt_assert(dir >= 0);
+
+	names = calloc(count, sizeof(*names));
+	igt_assert(names);
+
+	for (unsigned int d = 0; d < ARRAY_SIZE(drivers); d++) {
+		const struct fdinfo_driver *driver = &drivers[d];
+
+		if (only && strcmp(only, driver->name))
+			continue;
+
+		for (unsigned int i = 0; i < count; i++)
+			snprintf(names[i], sizeof(names[i]), "%s-%u",
+				 driver->name, i);
+		write_files(dir, driver, count);
+
+		m = (struct measure){
+			.dir = dir,
+			.driver = driver,
+			.names = names,
+			.count = count,
+			.maps = maps,
+		};
+		for (m.method = LEGACY; m.method <= BATCHED; m.method++) {
+			char name[64];
+
+			snprintf(name, sizeof(name), "%s/%s",
+				 driver->name, method_names[m.method]);
+			r = igt_benchmark_run(b, name, "ns/file", false,
+					      measure, &m);
+			igt_assert(r);
+
+			printf("%s %s: %.0f ns/file\n", driver->name,
+			       method_names[m.method], r->median);
+		}
+
+		remove_files(dir, driver, count);
+	}
+
+	free(names);
+	close(dir);
+	rmdir(dirname);
+
+	return igt_benchmark_finish(b) ? 1 : 0;
+}
@@ -32,277 +32,88 @@
 #include <string.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <time.h>
-#include <assert.h>
 
 #include "drm.h"
 #include "drmtest.h"
 #include "i915/gem_create.h"
+#include "igt_exec_replay.h"
+#include "igt_exec_trace.h"
 #include "igt_stats.h"
 #include "intel_io.h"
 #include "ioctl_wrappers.h"
 
-enum {
-	ADD_BO = 0,
-	DEL_BO,
-	ADD_CTX,
-	DEL_CTX,
-	EXEC,
-	WAIT,
-};
-
-struct trace_add_bo {
-	uint32_t handle;
-	uint64_t size;
-} __attribute__((packed));
-
-struct trace_del_bo {
-	uint32_t handle;
-} __attribute__((packed));
-
-struct trace_add_ctx {
-	uint32_t handle;
-} __attribute__((packed));
-
-struct trace_del_ctx {
-	uint32_t handle;
-} __attribute__((packed));
-
-struct trace_exec {
-	uint32_t object_count;
-	uint64_t flags;
-	uint32_t context;
-}__attribute__((packed));
-
-struct trace_exec_object {
-	uint32_t handle;
-	uint32_t relocation_count;
-	uint64_t alignment;
-	uint64_t offset;
-	uint64_t flags;
-	uint64_t rsvd1;
-	uint64_t rsvd2;
-}__attribute__((packed));
-
-struct trace_wait {
-	uint32_t handle;
-} __attribute__((packed));
-
-static uint32_t hars_petruska_f54_1_random(void)
-{
-	static uint32_t state = 0x12345678;
-
-#define rol(x,k) ((x << k) | (x >> (32-k)))
-	return state = (state ^ rol (state, 5) ^ rol (state, 24)) + 0x37798849;
-#undef rol
-}
-
 static double elapsed(const struct timespec *start, const struct timespec *end)
 {
 	return 1e3*(end->tv_sec - start->tv_sec) + 1e-6*(end->tv_nsec - start->tv_nsec);
 }
 
-static uint32_t __gem_context_create_local(int fd)
-{
-	struct drm_i915_gem_context_create arg = {};
-	drmIoctl(fd, DRM_IOCTL_I915_GEM_CONTEXT_CREATE, &arg);
-	return arg.ctx_id;
-}
+struct result {
+	int err;
+	struct igt_exec_replay_stats stats;
+};
 
-static double replay(const char *filename, long nop, long range)
+static int replay(const char *filename, long nop, long range, double scale,
+		  bool null, struct igt_exec_replay_stats *stats)
 {
-	struct timespec t_start, t_end;
-	struct drm_i915_gem_execbuffer2 eb = {};
-	const struct trace_version {
-		uint32_t magic;
-		uint32_t version;
-	} *tv;
 	const uint32_t bbe = 0xa << 23;
-	struct drm_i915_gem_exec_object2 *exec_objects = NULL;
-	uint32_t *bo, *ctx;
-	int num_bo, num_ctx;
-	int max_objects = 0;
+	struct igt_exec_replay_opts opts = {
+		.fd = -1,
+		.ioctl = igt_exec_replay_null_ioctl,
+		.scale = scale,
+	};
+	struct igt_exec_trace *trace;
 	struct stat st;
-	uint8_t *ptr, *end;
-	int fd;
+	void *ptr;
+	int fd, ret;
 
 	fd = open(filename, O_RDONLY);
 	if (fd < 0)
-		return -1;
+		return -errno;
 
 	if (fstat(fd, &st) < 0) {
+		ret = -errno;
 		close(fd);
-		return -1;
+		return ret;
 	}
 
-	ptr = mmap(0, st.st_size, PROT_WRITE, MAP_PRIVATE, fd, 0);
+	ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 	close(fd);
-
 	if (ptr == MAP_FAILED)
-		return -1;
+		return -errno;
 
 	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
-	end = ptr + st.st_size;
-
-	tv = (struct trace_version *)ptr;
-	if (tv->magic != 0xdeadbeef) {
-		fprintf(stderr, "%s: invalid magic\n", filename);
-		return -1;
-	}
-	if (tv->version != 1) {
-		fprintf(stderr, "%s: unhandled version %d\n",
-			filename, tv->version);
-		return -1;
-	}
-	ptr = (void *)(tv + 1);
-
-	ctx = calloc(1024, sizeof(*ctx));
-	num_ctx = 1024;
-
-	bo = calloc(4096, sizeof(*bo));
-	num_bo = 4096;
-
-	fd = drm_open_driver(DRIVER_INTEL);
-	if (nop > 0) {
-		bo[0] = gem_create(fd, nop + range);
-		gem_write(fd, bo[0], nop + range - sizeof(bbe),
-			  &bbe, sizeof(bbe));
-		range *= 2;
-		range -= 64;
-	} else {
-		bo[0] = gem_create(fd, 4096);
-		gem_write(fd, bo[0], 0, &bbe, sizeof(bbe));
-	}
-
-	clock_gettime(CLOCK_MONOTONIC, &t_start);
-	do switch (*ptr++) {
-	case ADD_BO:
-		{
-			struct trace_add_bo *t = (void *)ptr;
-			ptr = (void *)(t + 1);
-
-			if (t->handle >= num_bo) {
-				int new_bo = ALIGN(t->handle, 4096);
-				bo = realloc(bo, sizeof(*bo)*new_bo);
-				memset(bo + num_bo, 0, sizeof(*bo)*(new_bo - num_bo));
-				num_bo = new_bo;
-			}
-
-			bo[t->handle] = gem_create(fd, t->size);
-			break;
-		}
-	case DEL_BO:
-		{
-			struct trace_del_bo *t = (void *)ptr;
-			ptr = (void *)(t + 1);
-
-			assert(t->handle && t->handle < num_bo && bo[t->handle]);
-			gem_close(fd, bo[t->handle]);
-			bo[t->handle] = 0;
-			break;
-		}
-	case ADD_CTX:
-		{
-			struct trace_add_ctx *t = (void *)ptr;
-			ptr = (void *)(t + 1);
-
-			if (t->handle >= num_ctx) {
-				int new_ctx = ALIGN(t->handle, 1024);
-				ctx = realloc(ctx, sizeof(*ctx)*new_ctx);
-				memset(ctx + num_ctx, 0, sizeof(*ctx)*(new_ctx - num_ctx));
-				num_ctx = new_ctx;
-			}
-
-			ctx[t->handle] = __gem_context_create_local(fd);
-			break;
-		}
-	case DEL_CTX:
-		{
-			struct trace_del_ctx *t = (void *)ptr;
-			ptr = (void *)(t + 1);
-
-			assert(t->handle < num_ctx && ctx[t->handle]);
-			gem_context_destroy(fd, ctx[t->handle]);
-			ctx[t->handle] = 0;
-			break;
-		}
-	case EXEC:
-		{
-			struct trace_exec *t = (void *)ptr;
-			ptr = (void *)(t + 1);
-
-			eb.buffer_count = t->object_count;
-			eb.flags = t->flags;
-			eb.rsvd1 = ctx[t->context];
-
-			if (eb.buffer_count >= max_objects) {
-				free(exec_objects);
-
-				max_objects = ALIGN(eb.buffer_count + 1, 4096);
-
-				exec_objects = malloc(max_objects*sizeof(*exec_objects));
-				eb.buffers_ptr = (uintptr_t)exec_objects;
-			}
-
-			for (uint32_t i = 0; i < eb.buffer_count; i++) {
-				struct trace_exec_object *to = (void *)ptr;
-				ptr = (void *)(to + 1);
-
-				exec_objects[i].handle = bo[to->handle];
-				exec_objects[i].alignment = to->alignment;
-				exec_objects[i].offset = to->offset;
-				exec_objects[i].flags = to->flags;
-				exec_objects[i].rsvd1 = to->rsvd1;
-				exec_objects[i].rsvd2 = to->rsvd2;
-
-				exec_objects[i].relocation_count = to->relocation_count;
-				exec_objects[i].relocs_ptr = (uintptr_t)ptr;
-
-				if (!(eb.flags & I915_EXEC_HANDLE_LUT)) {
-					struct drm_i915_gem_relocation_entry *relocs =
-						(struct drm_i915_gem_relocation_entry *)ptr;
-					for (uint32_t j = 0; j < to->relocation_count; j++)
-						relocs[j].target_handle = bo[relocs[j].target_handle];
-				}
-
-				ptr += sizeof(struct drm_i915_gem_relocation_entry) * to->relocation_count;
-			}
-
-			((struct drm_i915_gem_exec_object2 *)
-			 memset(&exec_objects[eb.buffer_count++], 0,
-				sizeof(*exec_objects)))->handle = bo[0];
-
-			if (nop > 0) {
-				eb.batch_start_offset = hars_petruska_f54_1_random();
-				eb.batch_start_offset =
-					((uint64_t)eb.batch_start_offset * range) >> 32;
-				eb.batch_start_offset = ALIGN(eb.batch_start_offset, 64);
-			}
-			gem_execbuf(fd, &eb);
-			break;
+	ret = igt_exec_trace_parse(ptr, st.st_size, &trace);
+	munmap(ptr, st.st_size);
+	if (ret)
+		return ret;
+
+	if (!null) {
+		opts.fd = drm_open_driver(DRIVER_INTEL);
+		opts.ioctl = igt_ioctl;
+		if (nop > 0) {
+			opts.batch = gem_create(opts.fd, nop + range);
+			gem_write(opts.fd, opts.batch, nop + range - sizeof(bbe),
+				  &bbe, sizeof(bbe));
+			opts.range = 2 * range - 64;
+		} else {
+			opts.batch = gem_create(opts.fd, 4096);
+			gem_write(opts.fd, opts.batch, 0, &bbe, sizeof(bbe));
 		}
+	}
 
-	case WAIT:
-		{
-			struct trace_wait *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+	ret = igt_exec_replay(trace, &opts, stats);
 
-			assert(t->handle && t->handle < num_bo && bo[t->handle]);
-			gem_wait(fd, bo[t->handle], NULL);
-			break;
-		}
+	if (!null)
+		close(opts.fd);
+	igt_exec_trace_free(trace);
 
-	default:
-		fprintf(stderr, "Unknown cmd: %x\n", *ptr);
-		return -1;
-	} while (ptr < end);
-	clock_gettime(CLOCK_MONOTONIC, &t_end);
-
-	return elapsed(&t_start, &t_end);
+	return ret;
 }
 
 static long calibrate_nop(int usecs)
@@ -364,18 +175,63 @@ static int measure_nop(long nop)
 	return 1e3*elapsed(&t_start, &t_end) / 9;
 }
 
+static int convert(const char *filename,
+		   const struct igt_exec_trace_wsim *opts)
+{
+	char wsim[PATH_MAX];
+	struct stat st;
+	FILE *out;
+	void *ptr;
+	int fd, ret;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0) {
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+		return -errno;
+
+	snprintf(wsim, sizeof(wsim), "%s.wsim", filename);
+	out = fopen(wsim, "w");
+	if (!out) {
+		ret = -errno;
+		munmap(ptr, st.st_size);
+		return ret;
+	}
+
+	ret = igt_exec_trace_to_wsim(ptr, st.st_size, out, opts);
+	if (fclose(out) && !ret)
+		ret = -errno;
+	munmap(ptr, st.st_size);
+
+	if (ret)
+		unlink(wsim);
+	else
+		printf("%s: written to %s\n", filename, wsim);
+
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
+	struct igt_exec_trace_wsim wsim = { };
+	bool write_wsim = false, null = false;
+	struct result *results;
+	double scale = 0;
 	int delay = 1000;
-	double *results;
 	long nop = 0;
 	long range = 0;
 	int i, c;
 
-	results = mmap(NULL, ALIGN(argc*sizeof(double), 4096),
-		       PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
-
-	while ((c = getopt(argc, argv, "d:n:r:")) != -1) {
+	while ((c = getopt(argc, argv, "d:n:Np:r:t:w")) != -1) {
 		switch (c) {
 		case 'd':
 			delay = atoi(optarg);
@@ -385,21 +241,58 @@ int main(int argc, char **argv)
 			if (nop > 0)
 				nop = ALIGN(nop, 4096);
 			break;
+		case 'N':
+			null = true;
+			break;
 		case 'r':
 			range = strtol(optarg, NULL, 0);
 			if (range > 0)
 				range = ALIGN(range, 4096);
 			break;
+		case 'p':
+			wsim.period_us = atoi(optarg);
+			break;
+		case 't':
+			scale = atof(optarg);
+			break;
+		case 'w':
+			write_wsim = true;
+			break;
 		default:
 			break;
 		}
 	}
 
-	if (!nop)
+	/*
+	 * Convert the traces to workloads for gem_wsim instead, with each
+	 * batch lasting the delay and looping over a repeating frame.
+	 */
+	if (write_wsim) {
+		int ret, err = 0;
+
+		wsim.duration_us = delay;
+		wsim.loop = true;
+		for (i = optind; i < argc; i++) {
+			ret = convert(argv[i], &wsim);
+			if (ret) {
+				fprintf(stderr, "%s: failed to convert, %s\n",
+					argv[i], strerror(-ret));
+				err = 1;
+			}
+		}
+
+		return err;
+	}
+
+	results = mmap(NULL, ALIGN(argc*sizeof(*results), 4096),
+		       PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+
+	/* Without a device, only the pacing of the replay is measured. */
+	if (!null && !nop)
 		nop = calibrate_nop(delay);
 	if (!range)
 		range = nop / 2;
-	if (nop > 0) {
+	if (!null && nop > 0) {
 		delay = measure_nop(nop);
 		printf("Using %lu nop batch for ~%dus delay, range %lu [%dus]\n",
 		       nop, delay,
@@ -407,15 +300,31 @@ int main(int argc, char **argv)
 	}
 
 	igt_fork(child, argc-optind)
-		results[child] = replay(argv[child + optind], nop, range);
+		results[child].err = replay(argv[child + optind],
+					    nop, range, scale, null,
+					    &results[child].stats);
 	igt_waitchildren();
 
 	for (i = 0; i < argc - optind; i++) {
-		double t = results[i];
-		if (t < 0)
-			printf("%s: failed\n", argv[optind + i]);
-		else
-			printf("%s: %.3f\n", argv[optind + i], t);
+		const struct igt_exec_replay_stats *st = &results[i].stats;
+
+		if (results[i].err) {
+			printf("%s: failed, %s\n",
+			       argv[optind + i], strerror(-results[i].err));
+			continue;
+		}
+
+		printf("%s: %.3f", argv[optind + i], 1e-6 * st->elapsed_ns);
+		if (scale > 0)
+			printf(", slip mean %.1fus, median %.1fus, p99 %.1fus, max %.1fus",
+			       1e-3 * st->slip_mean_ns,
+			       1e-3 * st->slip_median_ns,
+			       1e-3 * st->slip_p99_ns,
+			       1e-3 * st->slip_max_ns);
+		if (st->nr_errors)
+			printf(", %u of %u ioctls failed",
+			       st->nr_errors, st->nr_events);
+		printf("\n");
 	}
 
 	return 0;
@@ -21,23 +21,44 @@
  * IN THE SOFTWARE.
  */
 
+/*
+ * Records every execbuf of the application, along with the buffers and
+ * contexts it uses and the buffers it waits for, into /tmp/trace-<pid>.<fd>
+ * for each i915 device it opens, to be replayed with gem_exec_trace.
+ *
+ * Intercepting an ioctl only packs its records into a buffer of the calling
+ * thread for the device, without taking any lock, and a flusher thread
+ * writes the buffers out in chunks every few milliseconds or as they fill
+ * up. A sequence number shared by the threads orders the records of all
+ * buffers and each record has the time it was made, for replaying at the
+ * pace of the application on as many threads. Set GEM_EXEC_TRACER_STATS to
+ * print the time spent tracing each ioctl as the traces are closed.
+ */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <inttypes.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/mman.h>
 #include <dlfcn.h>
 #include <i915_drm.h>
 #include <pthread.h>
+#include <time.h>
 
+#include "igt_exec_trace.h"
 #include "intel_aub.h"
 #include "intel_chipset.h"
 
@@ -50,80 +71,53 @@ static int (*libc_ioctl)(int fd, unsigned long request, void *argp);
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+#define BUFFER_SIZE (256 << 10) /* Must be a power of two */
+#define FLUSH_INTERVAL_NS 10000000
+
 struct trace {
 	int fd;
-	FILE *file;
+	int out;
+	atomic_bool closed;
+	atomic_uint_fast64_t seq;
+	unsigned int nr_buffers, next_id;
+
+	/* Overhead of the buffers freed so far */
+	uint64_t ioctls, ns, stalls, bytes;
+
 	struct trace *next;
 } *traces;
 
-#define DRM_MAJOR 226
+/* Ring of packed records of a thread for a trace. */
+struct buffer {
+	struct trace *trace;
+	unsigned int id;
+	struct buffer *next; /* Of all threads, under the mutex */
+	struct buffer *thread_next;
+	atomic_bool exited; /* Left for the flusher to free */
+
+	_Atomic uint64_t head; /* Published by the thread */
+	_Atomic uint64_t tail; /* Written out by the flusher */
+	uint64_t pending; /* Packed by the thread but not yet published */
+	bool dropping; /* The flusher stopped, nothing more is written out */
+	struct igt_exec_trace_packer packer;
+
+	uint64_t ioctls, ns, stalls;
+
+	uint8_t data[BUFFER_SIZE];
+} *buffers;
 
-enum {
-	ADD_BO = 0,
-	DEL_BO,
-	ADD_CTX,
-	DEL_CTX,
-	EXEC,
-	WAIT,
-};
-
-static struct trace_verion {
-	uint32_t magic;
-	uint32_t version;
-} version = {
-	.magic = 0xdeadbeef,
-	.version = 1
-};
-
-struct trace_add_bo {
-	uint8_t cmd;
-	uint32_t handle;
-	uint64_t size;
-} __attribute__((packed));
-struct trace_del_bo {
-	uint8_t cmd;
-	uint32_t handle;
-}__attribute__((packed));
-
-struct trace_add_ctx {
-	uint8_t cmd;
-	uint32_t handle;
-} __attribute__((packed));
-struct trace_del_ctx {
-	uint8_t cmd;
-	uint32_t handle;
-}__attribute__((packed));
-
-struct trace_exec {
-	uint8_t cmd;
-	uint32_t object_count;
-	uint64_t flags;
-	uint32_t context;
-}__attribute__((packed));
-
-struct trace_exec_object {
-	uint32_t handle;
-	uint32_t relocation_count;
-	uint64_t alignment;
-	uint64_t offset;
-	uint64_t flags;
-	uint64_t rsvd1;
-	uint64_t rsvd2;
-}__attribute__((packed));
-
-struct trace_exec_relocation {
-	uint32_t target_handle;
-	uint32_t delta;
-	uint64_t offset;
-	uint64_t presumed_offset;
-	uint32_t read_domains;
-	uint32_t write_domain;
-}__attribute__((packed));
-
-struct trace_wait {
-	uint8_t cmd;
-	uint32_t handle;
-} __attribute__((packed));
+static __thread struct buffer *thread_buffers;
+static pthread_key_t thread_key;
+
+static pthread_t flusher;
+static bool flusher_running;
+static bool finished; /* At exit, ioctls are not traced anymore */
+static atomic_bool flusher_stop, flusher_kicked;
+static pthread_cond_t flusher_cond = PTHREAD_COND_INITIALIZER;
+
+static bool stats;
+
+#define DRM_MAJOR 226
 
 static void __attribute__ ((format(__printf__, 2, 3)))
 fail_if(int cond, const char *format, ...)
@@ -140,99 +134,326 @@ fail_if(int cond, const char *format, ...)
 	abort();
 }
 
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void kick_flusher(void)
+{
+	if (!atomic_exchange(&flusher_kicked, true))
+		pthread_cond_signal(&flusher_cond);
+}
+
+static void publish(struct buffer *b)
+{
+	atomic_store_explicit(&b->head, b->pending, memory_order_release);
+
+	if (b->pending - atomic_load_explicit(&b->tail, memory_order_relaxed) >
+	    BUFFER_SIZE / 2)
+		kick_flusher();
+}
+
+/*
+ * Waits for the flusher to make room, handing it what there is of the
+ * record so far. Once it stopped at exit, the rest is dropped, along with
+ * any record after it, leaving the record cut short last in the buffer.
+ */
+static bool stall(struct buffer *b)
+{
+	const struct timespec ts = { .tv_nsec = 10000 };
+
+	if (atomic_load(&flusher_stop))
+		return false;
+
+	publish(b);
+	kick_flusher();
+	b->stalls++;
+	nanosleep(&ts, NULL);
+
+	return true;
+}
+
+static void put(struct buffer *b, const uint8_t *data, size_t len)
+{
+	while (len && !b->dropping) {
+		uint64_t tail = atomic_load_explicit(&b->tail,
+						     memory_order_acquire);
+		size_t offset = b->pending & (BUFFER_SIZE - 1);
+		size_t n = BUFFER_SIZE - (b->pending - tail);
+
+		if (!n) {
+			if (!stall(b)) {
+				b->pending = b->head;
+				b->dropping = true;
+			}
+			continue;
+		}
+
+		if (n > BUFFER_SIZE - offset)
+			n = BUFFER_SIZE - offset;
+		if (n > len)
+			n = len;
+
+		memcpy(b->data + offset, data, n);
+		b->pending += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static uint8_t *record(struct buffer *b, uint8_t *ptr, uint8_t cmd)
+{
+	uint64_t seq = atomic_fetch_add_explicit(&b->trace->seq, 1,
+						 memory_order_relaxed);
+
+	return igt_exec_trace_pack_cmd(&b->packer, ptr, cmd, seq, now_ns());
+}
+
 static void
-trace_exec(struct trace *trace,
+trace_exec(struct buffer *b,
 	   const struct drm_i915_gem_execbuffer2 *execbuffer2)
 {
 #define to_ptr(T, x) ((T *)(uintptr_t)(x))
 	const struct drm_i915_gem_exec_object2 *exec_objects =
 		to_ptr(typeof(*exec_objects), execbuffer2->buffers_ptr);
+	uint8_t t[IGT_EXEC_TRACE_MAX_PACKED], *ptr;
 
 	fail_if(execbuffer2->flags & (I915_EXEC_FENCE_IN | I915_EXEC_FENCE_OUT),
 		"fences not supported yet\n");
 
-	flockfile(trace->file);
-	{
-		struct trace_exec t = {
-			EXEC,
-			execbuffer2->buffer_count,
-			execbuffer2->flags,
-			execbuffer2->rsvd1,
-		};
-		fwrite(&t, sizeof(t), 1, trace->file);
-	}
+	ptr = record(b, t, IGT_EXEC_TRACE_EXEC);
+	ptr = igt_exec_trace_pack(ptr, execbuffer2->buffer_count);
+	ptr = igt_exec_trace_pack(ptr, execbuffer2->flags);
+	ptr = igt_exec_trace_pack(ptr, (uint32_t)execbuffer2->rsvd1);
+	put(b, t, ptr - t);
 
 	for (uint32_t i = 0; i < execbuffer2->buffer_count; i++) {
 		const struct drm_i915_gem_exec_object2 *obj = &exec_objects[i];
 		const struct drm_i915_gem_relocation_entry *relocs =
 			to_ptr(typeof(*relocs), obj->relocs_ptr);
-		{
-			struct trace_exec_object t = {
-				obj->handle,
-				obj->relocation_count,
-				obj->alignment,
-				obj->offset,
-				obj->flags,
-				obj->rsvd1,
-				obj->rsvd2
-			};
-			fwrite(&t, sizeof(t), 1, trace->file);
+
+		ptr = igt_exec_trace_pack_handle(&b->packer, t, obj->handle);
+		ptr = igt_exec_trace_pack(ptr, obj->relocation_count);
+		ptr = igt_exec_trace_pack(ptr, obj->alignment);
+		ptr = igt_exec_trace_pack(ptr, obj->offset);
+		ptr = igt_exec_trace_pack(ptr, obj->flags);
+		ptr = igt_exec_trace_pack(ptr, obj->rsvd1);
+		ptr = igt_exec_trace_pack(ptr, obj->rsvd2);
+		put(b, t, ptr - t);
+
+		for (uint32_t j = 0; j < obj->relocation_count; j++) {
+			ptr = igt_exec_trace_pack(t, relocs[j].target_handle);
+			ptr = igt_exec_trace_pack(ptr, relocs[j].delta);
+			ptr = igt_exec_trace_pack(ptr, relocs[j].offset);
+			ptr = igt_exec_trace_pack(ptr, relocs[j].presumed_offset);
+			ptr = igt_exec_trace_pack(ptr, relocs[j].read_domains);
+			ptr = igt_exec_trace_pack(ptr, relocs[j].write_domain);
+			put(b, t, ptr - t);
 		}
-		fwrite(relocs, sizeof(*relocs), obj->relocation_count,
-		       trace->file);
 	}
 
-	fflush(trace->file);
-	funlockfile(trace->file);
+	publish(b);
 #undef to_ptr
 }
 
 static void
-trace_wait(struct trace *trace, uint32_t handle)
+trace_handle(struct buffer *b, uint8_t cmd, uint32_t handle)
 {
-	struct trace_wait t = { WAIT, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	uint8_t t[IGT_EXEC_TRACE_MAX_PACKED], *ptr;
+
+	ptr = record(b, t, cmd);
+	ptr = igt_exec_trace_pack_handle(&b->packer, ptr, handle);
+	put(b, t, ptr - t);
+	publish(b);
 }
 
 static void
-trace_add(struct trace *trace, uint32_t handle, uint64_t size)
+trace_wait(struct buffer *b, uint32_t handle)
 {
-	struct trace_add_bo t = { ADD_BO, handle, size };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(b, IGT_EXEC_TRACE_WAIT, handle);
 }
 
 static void
-trace_del(struct trace *trace, uint32_t handle)
+trace_add(struct buffer *b, uint32_t handle, uint64_t size)
 {
-	struct trace_del_bo t = { DEL_BO, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	uint8_t t[IGT_EXEC_TRACE_MAX_PACKED], *ptr;
+
+	ptr = record(b, t, IGT_EXEC_TRACE_ADD_BO);
+	ptr = igt_exec_trace_pack_handle(&b->packer, ptr, handle);
+	ptr = igt_exec_trace_pack(ptr, size);
+	put(b, t, ptr - t);
+	publish(b);
 }
 
 static void
-trace_add_context(struct trace *trace, uint32_t handle)
+trace_del(struct buffer *b, uint32_t handle)
 {
-	struct trace_add_ctx t = { ADD_CTX, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(b, IGT_EXEC_TRACE_DEL_BO, handle);
 }
 
 static void
-trace_del_context(struct trace *trace, uint32_t handle)
+trace_context(struct buffer *b, uint8_t cmd, uint32_t handle)
+{
+	uint8_t t[IGT_EXEC_TRACE_MAX_PACKED], *ptr;
+
+	ptr = record(b, t, cmd);
+	ptr = igt_exec_trace_pack(ptr, handle);
+	put(b, t, ptr - t);
+	publish(b);
+}
+
+static void
+trace_add_context(struct buffer *b, uint32_t handle)
+{
+	trace_context(b, IGT_EXEC_TRACE_ADD_CTX, handle);
+}
+
+static void
+trace_del_context(struct buffer *b, uint32_t handle)
+{
+	trace_context(b, IGT_EXEC_TRACE_DEL_CTX, handle);
+}
+
+/*
+ * Writes out what the thread published, called under the mutex. Whatever was
+ * published after the trace was closed is dropped: its fd may name another
+ * file of the application by now.
+ */
+static void flush_buffer(struct buffer *b)
+{
+	uint64_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+	uint64_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+
+	if (atomic_load(&b->trace->closed))
+		tail = head;
+
+	while (tail != head) {
+		size_t offset = tail & (BUFFER_SIZE - 1);
+		size_t len = head - tail;
+		uint8_t chunk[20], *ptr;
+		struct iovec iov[2];
+
+		if (len > BUFFER_SIZE - offset)
+			len = BUFFER_SIZE - offset;
+
+		ptr = igt_exec_trace_pack(chunk, b->id);
+		ptr = igt_exec_trace_pack(ptr, len);
+		iov[0].iov_base = chunk;
+		iov[0].iov_len = ptr - chunk;
+		iov[1].iov_base = b->data + offset;
+		iov[1].iov_len = len;
+
+		if (writev(b->trace->out, iov, 2) > 0)
+			b->trace->bytes += iov[0].iov_len + len;
+		tail += len;
+	}
+
+	atomic_store_explicit(&b->tail, tail, memory_order_release);
+}
+
+static void free_buffer(struct buffer *b)
+{
+	struct trace *t = b->trace;
+
+	t->ioctls += b->ioctls;
+	t->ns += b->ns;
+	t->stalls += b->stalls;
+	free(b);
+
+	if (!--t->nr_buffers && atomic_load(&t->closed))
+		free(t);
+}
+
+static void flush_all(void)
+{
+	struct buffer *b, **p;
+
+	for (p = &buffers; (b = *p); ) {
+		bool exited = atomic_load_explicit(&b->exited,
+						   memory_order_acquire);
+
+		flush_buffer(b);
+		if (exited) {
+			*p = b->next;
+			free_buffer(b);
+		} else {
+			p = &b->next;
+		}
+	}
+}
+
+static void *flusher_thread(void *arg)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&mutex);
+	while (!atomic_load(&flusher_stop)) {
+		if (!atomic_load(&flusher_kicked)) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += FLUSH_INTERVAL_NS;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&flusher_cond, &mutex, &ts);
+		}
+		atomic_store(&flusher_kicked, false);
+
+		flush_all();
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return NULL;
+}
+
+/* Writes out the trace and closes it, called under the mutex. */
+static void close_trace(struct trace *t)
 {
-	struct trace_del_ctx t = { DEL_CTX, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	uint64_t ioctls = t->ioctls, ns = t->ns, stalls = t->stalls;
+	struct trace **p;
+	struct buffer *b;
+
+	for (p = &traces; *p != t; p = &(*p)->next)
+		;
+	*p = t->next;
+
+	for (b = buffers; b; b = b->next) {
+		if (b->trace != t)
+			continue;
+
+		flush_buffer(b);
+		ioctls += b->ioctls;
+		ns += b->ns;
+		stalls += b->stalls;
+	}
+
+	if (stats)
+		fprintf(stderr, "gem_exec_tracer: /tmp/trace-%d.%d: "
+			"%"PRIu64" ioctls traced in %.0fns each, "
+			"%"PRIu64" bytes written, %"PRIu64" stalls\n",
+			getpid(), t->fd, ioctls,
+			ioctls ? (double)ns / ioctls : 0.,
+			t->bytes, stalls);
+
+	libc_close(t->out);
+	atomic_store(&t->closed, true);
+	if (!t->nr_buffers)
+		free(t);
 }
 
 int
 close(int fd)
 {
-	struct trace *t, **p;
+	struct trace *t;
 
 	pthread_mutex_lock(&mutex);
-	for (p = &traces; (t = *p); p = &t->next) {
+	for (t = traces; t; t = t->next) {
 		if (t->fd == fd) {
-			*p = t->next;
-			fclose(t->file);
-			free(t);
+			close_trace(t);
 			break;
 		}
 	}
@@ -270,6 +491,113 @@ static int is_i915(int fd)
 	return strcmp(name, "i915") == 0;
 }
 
+/* Called under the mutex. */
+static struct trace *open_trace(int fd)
+{
+	const struct igt_exec_trace_version version = {
+		.magic = IGT_EXEC_TRACE_MAGIC,
+		.version = IGT_EXEC_TRACE_VERSION_TIMED,
+	};
+	char filename[80];
+	struct trace *t;
+
+	for (t = traces; t; t = t->next)
+		if (t->fd == fd)
+			return t;
+
+	/* Reopening would truncate the trace written out at exit. */
+	if (finished || !is_i915(fd))
+		return NULL;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	sprintf(filename, "/tmp/trace-%d.%d", getpid(), fd);
+	t->out = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (t->out < 0) {
+		free(t);
+		return NULL;
+	}
+
+	if (write(t->out, &version, sizeof(version)) != sizeof(version)) {
+		libc_close(t->out);
+		free(t);
+		return NULL;
+	}
+
+	if (!flusher_running) {
+		fail_if(pthread_create(&flusher, NULL, flusher_thread, NULL),
+			"failed to start the flusher\n");
+		flusher_running = true;
+	}
+
+	t->fd = fd;
+	t->next = traces;
+	traces = t;
+
+	return t;
+}
+
+/*
+ * Finds the buffer of the thread for the device, without locking unless
+ * it is the first ioctl of the thread on it. Buffers of traces since closed
+ * are left for the flusher to free.
+ */
+static struct buffer *get_buffer(int fd)
+{
+	uint8_t tid[IGT_EXEC_TRACE_MAX_PACKED];
+	struct buffer *b, **p;
+	struct trace *t;
+
+	for (p = &thread_buffers; (b = *p); ) {
+		if (atomic_load_explicit(&b->trace->closed,
+					 memory_order_relaxed)) {
+			*p = b->thread_next;
+			atomic_store_explicit(&b->exited, true,
+					      memory_order_release);
+			pthread_setspecific(thread_key, thread_buffers);
+			continue;
+		}
+
+		if (b->trace->fd == fd)
+			return b;
+
+		p = &b->thread_next;
+	}
+
+	pthread_mutex_lock(&mutex);
+	t = open_trace(fd);
+	if (!t) {
+		pthread_mutex_unlock(&mutex);
+		return NULL;
+	}
+
+	b = malloc(sizeof(*b));
+	if (!b) {
+		pthread_mutex_unlock(&mutex);
+		return NULL;
+	}
+
+	memset(b, 0, offsetof(struct buffer, data));
+	b->trace = t;
+	b->id = t->next_id++;
+	t->nr_buffers++;
+	b->next = buffers;
+	buffers = b;
+	pthread_mutex_unlock(&mutex);
+
+	/* The buffer starts with the thread it is of */
+	put(b, tid, igt_exec_trace_pack(tid, syscall(SYS_gettid)) - tid);
+	publish(b);
+
+	b->thread_next = thread_buffers;
+	thread_buffers = b;
+	pthread_setspecific(thread_key, thread_buffers);
+
+	return b;
+}
+
 int
 #ifdef __GLIBC__
 ioctl(int fd, unsigned long request, ...)
@@ -277,7 +605,8 @@ ioctl(int fd, unsigned long request, ...)
 ioctl(int fd, int request, ...)
 #endif
 {
-	struct trace *t, **p;
+	uint64_t start = 0;
+	struct buffer *b;
 	va_list args;
 	void *argp;
 	int ret;
@@ -289,98 +618,72 @@ ioctl(int fd, int request, ...)
 	if (_IOC_TYPE(request) != DRM_IOCTL_BASE)
 		goto untraced;
 
-	pthread_mutex_lock(&mutex);
-	for (p = &traces; (t = *p); p = &t->next) {
-		if (fd == t->fd) {
-			if (traces != t) {
-				*p = t->next;
-				t->next = traces;
-				traces = t;
-			}
-			break;
-		}
-	}
-	if (!t) {
-		char filename[80];
+	if (stats)
+		start = now_ns();
 
-		if (!is_i915(fd)) {
-			pthread_mutex_unlock(&mutex);
-			goto untraced;
-		}
-
-		t = malloc(sizeof(*t));
-		if (!t) {
-			pthread_mutex_unlock(&mutex);
-			return -ENOMEM;
-		}
-
-		sprintf(filename, "/tmp/trace-%d.%d", getpid(), fd);
-		t->file = fopen(filename, "w+");
-		t->fd = fd;
-
-		if (!fwrite(&version, sizeof(version), 1, t->file)) {
-			pthread_mutex_unlock(&mutex);
-			fclose(t->file);
-			free(t);
-			return -ENOMEM;
-		}
+	b = get_buffer(fd);
+	if (!b)
+		goto untraced;
 
-		t->next = traces;
-		traces = t;
-	}
-	pthread_mutex_unlock(&mutex);
+	b->ioctls++;
 
 	switch (request) {
 	case DRM_IOCTL_I915_GEM_EXECBUFFER2:
 	case DRM_IOCTL_I915_GEM_EXECBUFFER2_WR:
-		trace_exec(t, argp);
+		trace_exec(b, argp);
 		break;
 
 	case DRM_IOCTL_GEM_CLOSE: {
 		struct drm_gem_close *close = argp;
-		trace_del(t, close->handle);
+		trace_del(b, close->handle);
 		break;
 	}
 
 	case DRM_IOCTL_I915_GEM_CONTEXT_DESTROY: {
 		struct drm_i915_gem_context_destroy *close = argp;
-		trace_del_context(t, close->ctx_id);
+		trace_del_context(b, close->ctx_id);
 		break;
 	}
 
 	case DRM_IOCTL_I915_GEM_WAIT: {
 		struct drm_i915_gem_wait *w = argp;
-		trace_wait(t, w->bo_handle);
+		trace_wait(b, w->bo_handle);
 		break;
 	}
 
 	case DRM_IOCTL_I915_GEM_SET_DOMAIN: {
 		struct drm_i915_gem_set_domain *w = argp;
-		trace_wait(t, w->handle);
+		trace_wait(b, w->handle);
 		break;
 	}
 	}
 
+	if (stats)
+		b->ns += now_ns() - start;
+
 	ret = libc_ioctl(fd, request, argp);
 	if (ret)
 		return ret;
 
+	if (stats)
+		start = now_ns();
+
 	switch (request) {
 	case DRM_IOCTL_I915_GEM_CREATE: {
 		struct drm_i915_gem_create *create = argp;
-		trace_add(t, create->handle, create->size);
+		trace_add(b, create->handle, create->size);
 		break;
 	}
 
 	case DRM_IOCTL_I915_GEM_USERPTR: {
 		struct drm_i915_gem_userptr *userptr = argp;
-		trace_add(t, userptr->handle, userptr->user_size);
+		trace_add(b, userptr->handle, userptr->user_size);
 		break;
 	}
 
 	case DRM_IOCTL_GEM_OPEN: {
 		struct drm_gem_open *open = argp;
-		trace_add(t, open->handle, open->size);
+		trace_add(b, open->handle, open->size);
 		break;
 	}
 
@@ -388,29 +691,65 @@ ioctl(int fd, int request, ...)
 		struct drm_prime_handle *prime = argp;
 		off_t size = lseek(prime->fd, 0, SEEK_END);
 		fail_if(size == -1, "failed to get prime bo size\n");
-		trace_add(t, prime->handle, size);
+		trace_add(b, prime->handle, size);
 		break;
 	}
 
 	case DRM_IOCTL_MODE_GETFB: {
 		struct drm_mode_fb_cmd *cmd = argp;
-		trace_add(t, cmd->handle, size_for_fb(cmd));
+		trace_add(b, cmd->handle, size_for_fb(cmd));
 		break;
 	}
 
 	case DRM_IOCTL_I915_GEM_CONTEXT_CREATE: {
 		struct drm_i915_gem_context_create *create = argp;
-		trace_add_context(t, create->ctx_id);
+		trace_add_context(b, create->ctx_id);
 		break;
 	}
 	}
 
+	if (stats)
+		b->ns += now_ns() - start;
+
 	return 0;
 
 untraced:
 	return libc_ioctl(fd, request, argp);
 }
 
+static void thread_exit(void *arg)
+{
+	for (struct buffer *b = arg; b; b = b->thread_next)
+		atomic_store_explicit(&b->exited, true, memory_order_release);
+}
+
+static void fork_prepare(void)
+{
+	pthread_mutex_lock(&mutex);
+}
+
+static void fork_parent(void)
+{
+	pthread_mutex_unlock(&mutex);
+}
+
+/*
+ * The child starts tracing afresh into its own files, leaving the records
+ * of the parent to the parent.
+ */
+static void fork_child(void)
+{
+	for (struct trace *t = traces; t; t = t->next) {
+		libc_close(t->out);
+		atomic_store(&t->closed, true);
+	}
+	traces = NULL;
+	buffers = NULL;
+	flusher_running = false;
+
+	pthread_mutex_init(&mutex, NULL);
+}
+
 static void __attribute__ ((constructor))
 init(void)
 {
@@ -418,4 +757,31 @@ init(void)
 	libc_ioctl = dlsym(RTLD_NEXT, "ioctl");
 	fail_if(libc_close == NULL || libc_ioctl == NULL,
 		"failed to get libc ioctl or close\n");
+
+	fail_if(pthread_key_create(&thread_key, thread_exit),
+		"failed to create the thread key\n");
+	pthread_atfork(fork_prepare, fork_parent, fork_child);
+
+	stats = getenv("GEM_EXEC_TRACER_STATS");
+}
+
+static void __attribute__ ((destructor))
+fini(void)
+{
+	bool running;
+
+	pthread_mutex_lock(&mutex);
+	finished = true;
+	running = flusher_running;
+	atomic_store(&flusher_stop, true);
+	pthread_cond_signal(&flusher_cond);
+	pthread_mutex_unlock(&mutex);
+
+	if (running)
+		pthread_join(flusher, NULL);
+
+	pthread_mutex_lock(&mutex);
+	while (traces)
+		close_trace(traces);
+	pthread_mutex_unlock(&mutex);
 }
@@ -44,10 +44,12 @@
 #include <pthread.h>
 #include <math.h>
 #include <ctype.h>
+#include <getopt.h>
 
 #include "drm.h"
 #include "drmtest.h"
 #include "igt_device_scan.h"
+#include "igt_map.h"
 #include "intel_chipset.h"
 #include "intel_reg.h"
 #include "ioctl_wrappers.h"
@@ -56,6 +58,7 @@
 #include "igt_aux.h"
 #include "igt_rand.h"
 #include "igt_perf.h"
+#include "igt_stats.h"
 #include "sw_sync.h"
 
 #include "i915/gem_create.h"
@@ -184,18 +187,28 @@ struct working_set {
 
 struct workload;
 
-struct w_step {
-	struct workload *wrk;
-
-	/* Workload step metadata */
+/*
+ * Workload step as parsed. Steps are compiled once per workload into a plan
+ * shared read-only by all clients running it, see struct w_step for their
+ * per-client state.
+ */
+struct w_step_desc {
 	enum w_type type;
+	unsigned int idx;
 	unsigned int context;
 	intel_engine_t engine;
-	unsigned int engine_idx;
 	struct duration duration;
 	struct deps data_deps;
 	struct deps fence_deps;
-	int emit_fence;
+	/*
+	 * Absolute indices of the batches this step depends on for data,
+	 * followed by the fence dependencies.
+	 */
+	const unsigned int *dep_steps;
+	unsigned int nr_data_steps;
+	unsigned int nr_fence_steps;
+	unsigned int desc_offset; /* Of the step, for parse errors. */
+	bool emits_fence; /* A later step has a fence dependency on it. */
 	union {
 		int sync;
 		int delay;
@@ -207,14 +220,30 @@ struct w_step {
 		bool load_balance;
 		struct bond bond;
 		int sseu;
-		struct working_set working_set;
+		struct working_set working_set; /* Buffer sizes to pick from. */
 	};
+};
+
+struct w_plan {
+	unsigned int nr_steps;
+	struct w_step_desc *steps;
+	unsigned int *dep_graph; /* Backs w_step_desc.dep_steps. */
+};
+
+struct w_step {
+	const struct w_step_desc *desc;
+	struct workload *wrk;
 
 	/* Implementation details */
-	unsigned int idx;
+	intel_engine_t engine; /* Resolved to a physical engine. */
+	unsigned int engine_idx;
+	int emit_fence;
+	struct working_set working_set; /* Buffers of a working set step. */
 	struct igt_list_head rq_link;
 	unsigned int request_idx;
 	unsigned int preempt_us;
+	struct igt_histogram *latency;
+	uint64_t submit_ns;
 
 	union {
 		struct {
@@ -269,6 +298,7 @@ struct ctx {
 struct workload {
 	unsigned int id;
 
+	struct w_plan *plan; /* Shared with the clones, see free_plan(). */
 	unsigned int nr_steps;
 	struct w_step *steps;
 	int prio;
@@ -298,6 +328,8 @@ struct workload {
 
 	struct igt_list_head *requests;
 	unsigned int *nrequest;
+
+	struct igt_histogram *queue_latency; /* Per engine, when simulating. */
 };
 
 #define __for_each_ctx(__ctx, __wrk, __ctx_idx) \
@@ -325,12 +357,79 @@ static struct drm_i915_gem_context_param_sseu device_sseu = {
 #define FLAG_DEPSYNC		(1<<2)
 #define FLAG_SSEU		(1<<3)
 
+/*
+ * Latency histograms are per client so recording needs no synchronisation,
+ * clients are only merged for the output at the end.
+ */
+static enum {
+	LATENCY_NONE,
+	LATENCY_CSV,
+	LATENCY_JSON,
+} latency_format;
+
+/* Print the active working set of each engine after preparing the workloads */
+static bool footprint;
+
+#define LATENCY_PRECISION 7 /* <1% error */
+#define LATENCY_LIMIT (60 * NSEC_PER_SEC)
+
+#define SIM_MAX_ENGINES 64
+
+/*
+ * Virtual engine model standing in for the device with --simulate. Workloads
+ * then run in virtual time, see simulate_workloads().
+ */
+static struct {
+	bool enabled;
+	unsigned int nr_engines[NUM_ENGINE_CLASSES];
+	bool fifo; /* Ignore context priorities. */
+	bool preempt; /* At the arbitration points of running batches. */
+} sim = {
+	.nr_engines = { [RCS] = 1, [BCS] = 1, [VCS] = 2, [VECS] = 1 },
+	.preempt = true,
+};
+
+/* Buffer state for implicit synchronisation, indexed by simulated handle. */
+struct sim_object {
+	struct sim_request *write;
+	struct sim_request **reads;
+	unsigned int nr_reads;
+};
+
+static struct sim_object *sim_objects;
+static uint32_t sim_nr_objects;
+
+static uint32_t sim_alloc_object(void)
+{
+	sim_objects = realloc(sim_objects,
+			      (sim_nr_objects + 1) * sizeof(*sim_objects));
+	igt_assert(sim_objects);
+	memset(&sim_objects[sim_nr_objects], 0, sizeof(*sim_objects));
+
+	return sim_nr_objects++;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
 static void w_step_sync(struct w_step *w)
 {
 	if (is_xe)
 		igt_assert(syncobj_wait(fd, &w->xe.syncs[0].handle, 1, INT64_MAX, 0, NULL));
 	else
 		gem_sync(fd, w->i915.obj[0].handle);
+
+	/* Latency as observed by the first wait after submission. */
+	if (w->latency && w->submit_ns) {
+		igt_histogram_add(w->latency, now_ns() - w->submit_ns);
+		w->submit_ns = 0;
+	}
 }
 
 static int read_timestamp_frequency(int i915)
@@ -378,8 +477,7 @@ static void add_dep(struct deps *deps, struct dep_entry entry)
 }
 
 static int
-parse_working_set_deps(struct workload *wrk,
-		       struct deps *deps,
+parse_working_set_deps(struct deps *deps,
 		       struct dep_entry _entry,
 		       char *str)
 {
@@ -431,8 +529,46 @@ wsim_err(const char *fmt, ...)
 	va_end(ap);
 }
 
+/* Descriptor being parsed, to locate errors by line and column. */
+static struct {
+	const char *name;
+	const char *desc;
+	const char *step; /* Working copy of the step being parsed. */
+	unsigned int offset; /* Of the step in the descriptor. */
+} parse_pos;
+
+/* @at points into the step being parsed, or is NULL for the whole step. */
+static void __attribute__((format(printf, 2, 3)))
+parse_err(const char *at, const char *fmt, ...)
+{
+	unsigned int offset = parse_pos.offset, line = 1, column = 1;
+	unsigned int i;
+	va_list ap;
+
+	if (!verbose)
+		return;
+
+	if (at)
+		offset += at - parse_pos.step;
+
+	for (i = 0; i < offset && parse_pos.desc[i]; i++) {
+		if (parse_pos.desc[i] == '\n') {
+			line++;
+			column = 1;
+		} else {
+			column++;
+		}
+	}
+
+	fprintf(stderr, "%s:%u:%u: ", parse_pos.name, line, column);
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
 static int
-parse_dependency(unsigned int nr_steps, struct w_step *w, char *str)
+parse_dependency(unsigned int nr_steps, struct w_step_desc *w, char *str)
 {
 	struct dep_entry entry = { .working_set = -1 };
 	bool submit_fence = false;
@@ -488,7 +624,7 @@ parse_dependency(unsigned int nr_steps, struct w_step *w, char *str)
 		if (entry.working_set < 0)
 			return -1;
 
-		if (parse_working_set_deps(w->wrk, &w->data_deps, entry, ++s))
+		if (parse_working_set_deps(&w->data_deps, entry, ++s))
 			return -1;
 
 		break;
@@ -500,7 +636,7 @@ parse_dependency(unsigned int nr_steps, struct w_step *w, char *str)
 }
 
 static int
-parse_dependencies(unsigned int nr_steps, struct w_step *w, char *_desc)
+parse_dependencies(unsigned int nr_steps, struct w_step_desc *w, char *_desc)
 {
 	char *desc = strdup(_desc);
 	char *token, *tctx = NULL, *tstart = desc;
@@ -532,10 +668,21 @@ out:
 	return ret;
 }
 
+/* Only for parse_workload, errors point at the field being parsed. */
 #define check_arg(cond, fmt, ...) \
 { \
 	if (cond) { \
-		wsim_err(fmt, __VA_ARGS__); \
+		parse_err(field, fmt, __VA_ARGS__); \
+		return NULL; \
+	} \
+}
+
+/* Errors found once all steps are parsed point at the offending step. */
+#define check_step(cond, idx, fmt, ...) \
+{ \
+	if (cond) { \
+		parse_pos.offset = steps[idx].desc_offset; \
+		parse_err(NULL, fmt, __VA_ARGS__); \
 		return NULL; \
 	} \
 }
@@ -634,6 +781,22 @@ static bool are_equal_engines(const intel_engine_t *e1,
 	       e1->gt_id == e2->gt_id;
 }
 
+static const char *engine_name(const intel_engine_t *engine, char *buf,
+			       size_t len)
+{
+	if (engine->engine_class == DEFAULT_ID)
+		return "DEFAULT";
+
+	if (engine->engine_instance == DEFAULT_ID)
+		return intel_engine_class_string(engine->engine_class);
+
+	snprintf(buf, len, "%s%u",
+		 intel_engine_class_string(engine->engine_class),
+		 engine->engine_instance + 1);
+
+	return buf;
+}
+
 static bool find_engine_in_map(const intel_engine_t *engine,
 			       struct intel_engines *engines, unsigned int *idx)
 {
@@ -654,7 +817,21 @@ static struct intel_engines *query_engines(void)
 	if (engines.nr_engines)
 		return &engines;
 
-	if (is_xe) {
+	if (sim.enabled) {
+		engines.engines = calloc(SIM_MAX_ENGINES, sizeof(intel_engine_t));
+		igt_assert(engines.engines);
+		for (unsigned int c = 0; c < NUM_ENGINE_CLASSES; c++) {
+			for (unsigned int i = 0; i < sim.nr_engines[c]; i++) {
+				intel_engine_t *e =
+					&engines.engines[engines.nr_engines++];
+
+				e->engine_class = c;
+				e->engine_instance = i;
+				e->gt_id = DEFAULT_ID;
+			}
+		}
+		igt_assert(engines.nr_engines);
+	} else if (is_xe) {
 		struct drm_xe_engine_class_instance *hwe;
 
 		engines.engines = calloc(xe_number_engines(fd), sizeof(intel_engine_t));
@@ -767,7 +944,7 @@ static void resolve_to_physical_engine(intel_engine_t *engine)
 	igt_assert(is_valid_engine(engine));
 }
 
-static int parse_engine_map(struct w_step *step, const char *_str)
+static int parse_engine_map(struct w_step_desc *step, const char *_str)
 {
 	char *token, *tctx = NULL, *tstart = (char *)_str;
 	intel_engine_t engine;
@@ -786,7 +963,7 @@ static int parse_engine_map(struct w_step *step, const char *_str)
 	return 0;
 }
 
-static int parse_bond_engines(struct w_step *step, const char *_str)
+static int parse_bond_engines(struct w_step_desc *step, const char *_str)
 {
 	char *token, *tctx = NULL, *tstart = (char *)_str;
 	intel_engine_t engine;
@@ -919,7 +1096,7 @@ static int parse_working_set(struct working_set *set, char *str)
 }
 
 static unsigned long
-allocate_working_set(struct workload *wrk, struct working_set *set);
+allocate_working_sets(struct workload *wrk, bool shared);
 
 static long __duration(long dur, double scale)
 {
@@ -933,15 +1110,16 @@ parse_duration(unsigned int nr_steps, struct duration *dur, double scale_dur, ch
 	long tmpl;
 
 	if (field[0] == '*') {
-		if (intel_gen(intel_get_drm_devid(fd)) < 8) {
-			wsim_err("Infinite batch at step %u needs Gen8+!\n", nr_steps);
+		if (!sim.enabled && intel_gen(intel_get_drm_devid(fd)) < 8) {
+			parse_err(field, "Infinite batch at step %u needs Gen8+!\n",
+				  nr_steps);
 			return -1;
 		}
 		dur->unbound = true;
 	} else {
 		tmpl = strtol(field, &sep, 10);
 		if (tmpl <= 0 || tmpl == LONG_MIN || tmpl == LONG_MAX) {
-			wsim_err("Invalid duration at step %u!\n", nr_steps);
+			parse_err(field, "Invalid duration at step %u!\n", nr_steps);
 			return -1;
 		}
 
@@ -951,7 +1129,9 @@ parse_duration(unsigned int nr_steps, struct duration *dur, double scale_dur, ch
 			tmpl = strtol(sep + 1, NULL, 10);
 			if (tmpl <= 0 || __duration(tmpl, scale_dur) <= dur->min ||
 			    tmpl == LONG_MIN || tmpl == LONG_MAX) {
-				wsim_err("Invalid maximum duration at step %u!\n", nr_steps);
+				parse_err(sep + 1,
+					  "Invalid maximum duration at step %u!\n",
+					  nr_steps);
 				return -1;
 			}
 
@@ -976,6 +1156,54 @@ parse_duration(unsigned int nr_steps, struct duration *dur, double scale_dur, ch
 		} \
 	} while (0)
 
+/* Whether a working set dependency names a buffer of a working set. */
+static bool find_working_set(const struct w_plan *plan,
+			     const struct dep_entry *dep)
+{
+	for (unsigned int i = 0; i < plan->nr_steps; i++) {
+		const struct w_step_desc *d = &plan->steps[i];
+
+		if (d->type == WORKINGSET &&
+		    d->working_set.id == dep->working_set)
+			return dep->target < d->working_set.nr;
+	}
+
+	return false;
+}
+
+/*
+ * Per-client state of the steps of a plan. Working sets get their own copy of
+ * the buffer sizes, which are picked from the ranges when allocating.
+ */
+static struct w_step *alloc_steps(const struct w_plan *plan)
+{
+	struct w_step *steps;
+
+	steps = calloc(plan->nr_steps, sizeof(*steps));
+	igt_assert(steps);
+
+	for (unsigned int i = 0; i < plan->nr_steps; i++) {
+		const struct w_step_desc *d = &plan->steps[i];
+		struct w_step *w = &steps[i];
+
+		w->desc = d;
+		w->engine = d->engine;
+		w->emit_fence = d->emits_fence ? -1 : 0;
+
+		if (d->type == WORKINGSET) {
+			struct working_set *set = &w->working_set;
+
+			*set = d->working_set;
+			set->sizes = calloc(set->nr, sizeof(*set->sizes));
+			igt_assert(set->sizes);
+			memcpy(set->sizes, d->working_set.sizes,
+			       set->nr * sizeof(*set->sizes));
+		}
+	}
+
+	return steps;
+}
+
 static struct workload *
 parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 	       double scale_time, struct workload *app_w)
@@ -985,16 +1213,24 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 	char *desc = strdup(arg->desc);
 	char *_token, *token, *tctx = NULL, *tstart = desc;
 	char *field, *fctx = NULL, *fstart;
-	struct w_step step, *w, *steps = NULL;
-	unsigned int valid;
+	struct w_step_desc step, *steps = NULL;
+	unsigned int valid, nr_deps, *dep;
+	struct w_plan *plan;
+	struct w_step *w;
 	int i, j, tmp;
 
 	igt_assert(desc);
 
-	while ((_token = strtok_r(tstart, ",", &tctx))) {
+	parse_pos.name = arg->filename && arg->filename != arg->desc ?
+			 arg->filename : "<command line>";
+	parse_pos.desc = arg->desc;
+
+	while ((_token = strtok_r(tstart, ",\n", &tctx))) {
 		tstart = NULL;
 		token = strdup(_token);
 		igt_assert(token);
+		parse_pos.step = token;
+		parse_pos.offset = _token - desc;
 		fstart = token;
 		valid = 0;
 		memset(&step, 0, sizeof(step));
@@ -1021,7 +1257,7 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 				unsigned int nr = 0;
 
 				if (is_xe) {
-					wsim_err("Priority step is not implemented with xe yet.\n");
+					parse_err(field, "Priority step is not implemented with xe yet.\n");
 					free(token);
 					return NULL;
 				}
@@ -1053,7 +1289,7 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 				unsigned int nr = 0;
 
 				if (is_xe) {
-					wsim_err("SSEU step is not implemented with xe yet.\n");
+					parse_err(field, "SSEU step is not implemented with xe yet.\n");
 					free(token);
 					return NULL;
 				}
@@ -1172,7 +1408,7 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 				unsigned int nr = 0;
 
 				if (is_xe) {
-					wsim_err("Bonding is not implemented with xe yet.\n");
+					parse_err(field, "Bonding is not implemented with xe yet.\n");
 					free(token);
 					return NULL;
 				}
@@ -1194,7 +1430,7 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 							  "Invalid siblings list at step %u!\n",
 							  nr_steps);
 					} else if (nr == 2) {
-						struct intel_engines engines;
+						struct intel_engines engines = { };
 
 						step.bond.master = str_to_engine(field);
 						check_arg(append_matching_engines(&step.bond.master,
@@ -1213,7 +1449,7 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 				unsigned int nr = 0;
 
 				if (is_xe) {
-					wsim_err("Working sets are not implemented with xe yet.\n");
+					parse_err(field, "Working sets are not implemented with xe yet.\n");
 					free(token);
 					return NULL;
 				}
@@ -1240,10 +1476,8 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 			}
 
 			if (!field) {
-				if (verbose)
-					fprintf(stderr,
-						"Parse error at step %u!\n",
-						nr_steps);
+				parse_err(NULL, "Parse error at step %u!\n",
+					  nr_steps);
 				return NULL;
 			}
 
@@ -1309,8 +1543,7 @@ add_step:
 			step.delay = __duration(step.delay, scale_time);
 
 		step.idx = nr_steps++;
-		step.rq_link.next = NULL;
-		step.rq_link.prev = NULL;
+		step.desc_offset = parse_pos.offset;
 		steps = realloc(steps, sizeof(step) * nr_steps);
 		igt_assert(steps);
 
@@ -1324,7 +1557,7 @@ add_step:
 				(nr_steps + app_w->nr_steps));
 		igt_assert(steps);
 
-		memcpy(&steps[nr_steps], app_w->steps,
+		memcpy(&steps[nr_steps], app_w->plan->steps,
 		       sizeof(step) * app_w->nr_steps);
 
 		for (i = 0; i < app_w->nr_steps; i++)
@@ -1333,83 +1566,122 @@ add_step:
 		nr_steps += app_w->nr_steps;
 	}
 
-	wrk = malloc(sizeof(*wrk));
-	igt_assert(wrk);
+	free(desc);
 
-	wrk->nr_steps = nr_steps;
-	wrk->steps = steps;
-	wrk->prio = arg->prio;
-	wrk->sseu = arg->sseu;
-	wrk->max_working_set_id = -1;
-	wrk->working_sets = NULL;
-	wrk->bo_prng = (flags & FLAG_SYNCEDCLIENTS) ? master_prng : rand();
+	plan = calloc(1, sizeof(*plan));
+	igt_assert(plan);
 
-	free(desc);
+	plan->nr_steps = nr_steps;
+	plan->steps = steps;
 
 	/*
-	 * Tag all steps which need to emit a sync fence if another step is
-	 * referencing them as a sync fence dependency.
+	 * Resolve all dependencies into a flat graph of step indices, shared
+	 * by all clients, so nothing is searched for while running. Steps can
+	 * only depend on earlier steps so a graph which validates is acyclic.
 	 */
+	nr_deps = 0;
+	for (i = 0; i < nr_steps; i++)
+		nr_deps += steps[i].data_deps.nr + steps[i].fence_deps.nr;
+	plan->dep_graph = calloc(nr_deps ?: 1, sizeof(*plan->dep_graph));
+	igt_assert(plan->dep_graph);
+	dep = plan->dep_graph;
+
 	for (i = 0; i < nr_steps; i++) {
-		struct dep_entry *dep;
+		struct dep_entry *entry;
+
+		steps[i].dep_steps = dep;
+		steps[i].nr_data_steps = 0;
+		steps[i].nr_fence_steps = 0;
+
+		for_each_dep(entry, steps[i].data_deps) {
+			if (entry->working_set >= 0) {
+				check_step(!find_working_set(plan, entry), i,
+					   "Invalid working set dependency at step %u!\n",
+					   i);
+				continue;
+			}
 
-		for_each_dep(dep, steps[i].fence_deps) {
-			tmp = steps[i].idx + dep->target;
-			check_arg(tmp < 0 || tmp >= i ||
-				  (steps[tmp].type != BATCH &&
-				   steps[tmp].type != SW_FENCE),
-				  "Invalid dependency target %u!\n", i);
-			steps[tmp].emit_fence = -1;
+			tmp = i + entry->target;
+			check_step(tmp < 0 || tmp >= i ||
+				   steps[tmp].type != BATCH, i,
+				   "Invalid data dependency at step %u!\n", i);
+			*dep++ = tmp;
+			steps[i].nr_data_steps++;
 		}
-	}
 
-	/* Validate SW_FENCE_SIGNAL targets. */
-	for (i = 0; i < nr_steps; i++) {
-		if (steps[i].type == SW_FENCE_SIGNAL) {
-			tmp = steps[i].idx + steps[i].target;
-			check_arg(tmp < 0 || tmp >= i ||
-				  steps[tmp].type != SW_FENCE,
-				  "Invalid sw fence target %u!\n", i);
+		/*
+		 * Tag all steps which need to emit a sync fence if another
+		 * step is referencing them as a sync fence dependency.
+		 */
+		for_each_dep(entry, steps[i].fence_deps) {
+			tmp = i + entry->target;
+			check_step(tmp < 0 || tmp >= i ||
+				   (steps[tmp].type != BATCH &&
+				    steps[tmp].type != SW_FENCE), i,
+				   "Invalid dependency target %u!\n", i);
+			steps[tmp].emits_fence = true;
+			*dep++ = tmp;
+			steps[i].nr_fence_steps++;
+		}
+
+		tmp = i + steps[i].target;
+		switch (steps[i].type) {
+		case SYNC:
+			check_step(steps[tmp].type != BATCH, i,
+				   "Invalid sync target at step %u!\n", i);
+			break;
+		case TERMINATE:
+			check_step(steps[tmp].type != BATCH ||
+				   !steps[tmp].duration.unbound, i,
+				   "Invalid terminate target at step %u!\n", i);
+			break;
+		case SW_FENCE_SIGNAL:
+			check_step(tmp < 0 || tmp >= i ||
+				   steps[tmp].type != SW_FENCE, i,
+				   "Invalid sw fence target %u!\n", i);
+			break;
+		default:
+			break;
 		}
 	}
 
 	/*
 	 * Check no duplicate working set ids.
 	 */
-	for_each_w_step(w, wrk) {
-		struct w_step *w2;
-
-		if (w->type != WORKINGSET)
+	for (i = 0; i < nr_steps; i++) {
+		if (steps[i].type != WORKINGSET)
 			continue;
 
-		for_each_w_step(w2, wrk) {
-			if (w->idx == w2->idx)
-				continue;
-			if (w2->type != WORKINGSET)
+		for (j = 0; j < nr_steps; j++) {
+			if (i == j || steps[j].type != WORKINGSET)
 				continue;
 
-			check_arg(w->working_set.id == w2->working_set.id,
-				  "Duplicate working set id at %u!\n", j);
+			check_step(steps[i].working_set.id ==
+				   steps[j].working_set.id,
+				   i, "Duplicate working set id at %u!\n", i);
 		}
 	}
 
+	wrk = calloc(1, sizeof(*wrk));
+	igt_assert(wrk);
+
+	wrk->plan = plan;
+	wrk->nr_steps = nr_steps;
+	wrk->steps = alloc_steps(plan);
+	wrk->prio = arg->prio;
+	wrk->sseu = arg->sseu;
+	wrk->max_working_set_id = -1;
+	wrk->working_sets = NULL;
+	wrk->bo_prng = (flags & FLAG_SYNCEDCLIENTS) ? master_prng : rand();
+
 	/*
 	 * Allocate shared working sets.
 	 */
-	for_each_w_step(w, wrk) {
-		if (w->type == WORKINGSET && w->working_set.shared) {
-			unsigned long total =
-				allocate_working_set(wrk, &w->working_set);
-
-			if (verbose > 1)
-				printf("%u: %lu bytes in shared working set %u\n",
-				       wrk->id, total, w->working_set.id);
-		}
-	}
+	allocate_working_sets(wrk, true);
 
 	wrk->max_working_set_id = -1;
 	for_each_w_step(w, wrk) {
-		if (w->type == WORKINGSET &&
+		if (w->desc->type == WORKINGSET &&
 		    w->working_set.shared &&
 		    w->working_set.id > wrk->max_working_set_id)
 			wrk->max_working_set_id = w->working_set.id;
@@ -1420,13 +1692,21 @@ add_step:
 	igt_assert(wrk->working_sets);
 
 	for_each_w_step(w, wrk) {
-		if (w->type == WORKINGSET && w->working_set.shared)
+		if (w->desc->type == WORKINGSET && w->working_set.shared)
 			wrk->working_sets[w->working_set.id] = &w->working_set;
 	}
 
 	return wrk;
 }
 
+/* Only once the parsed workload and all its clones are done with it. */
+static void free_plan(struct w_plan *plan)
+{
+	free(plan->dep_graph);
+	free(plan->steps);
+	free(plan);
+}
+
 static struct workload *
 clone_workload(struct workload *_wrk)
 {
@@ -1440,11 +1720,9 @@ clone_workload(struct workload *_wrk)
 
 	wrk->prio = _wrk->prio;
 	wrk->sseu = _wrk->sseu;
+	wrk->plan = _wrk->plan;
 	wrk->nr_steps = _wrk->nr_steps;
-	wrk->steps = calloc(wrk->nr_steps, sizeof(struct w_step));
-	igt_assert(wrk->steps);
-
-	memcpy(wrk->steps, _wrk->steps, sizeof(struct w_step) * wrk->nr_steps);
+	wrk->steps = alloc_steps(wrk->plan);
 
 	wrk->max_working_set_id = _wrk->max_working_set_id;
 	if (wrk->max_working_set_id >= 0) {
@@ -1460,7 +1738,7 @@ clone_workload(struct workload *_wrk)
 
 	/* Check if we need a sw sync timeline. */
 	for_each_w_step(w, wrk) {
-		if (w->type == SW_FENCE) {
+		if (w->desc->type == SW_FENCE && !sim.enabled) {
 			wrk->sync_timeline = sw_sync_timeline_create();
 			igt_assert(wrk->sync_timeline >= 0);
 			break;
@@ -1484,7 +1762,7 @@ clone_workload(struct workload *_wrk)
 
 static unsigned int get_duration(struct workload *wrk, struct w_step *w)
 {
-	struct duration *dur = &w->duration;
+	const struct duration *dur = &w->desc->duration;
 
 	if (dur->min == dur->max)
 		return dur->min;
@@ -1496,7 +1774,7 @@ static unsigned int get_duration(struct workload *wrk, struct w_step *w)
 static struct ctx *
 __get_ctx(struct workload *wrk, const struct w_step *w)
 {
-	return &wrk->ctx_list[w->context];
+	return &wrk->ctx_list[w->desc->context];
 }
 
 static uint32_t mmio_base(int i915, const intel_engine_t *engine, int gen)
@@ -1647,7 +1925,7 @@ eb_update_flags(struct workload *wrk, struct w_step *w)
 static uint32_t
 get_ctxid(struct workload *wrk, struct w_step *w)
 {
-	return wrk->ctx_list[w->context].id;
+	return wrk->ctx_list[w->desc->context].id;
 }
 
 static struct xe_exec_queue *
@@ -1682,7 +1960,7 @@ alloc_step_batch(struct workload *wrk, struct w_step *w)
 {
 	struct dep_entry *dep;
 	unsigned int j = 0;
-	unsigned int nr_obj = 2 + w->data_deps.nr;
+	unsigned int nr_obj = 2 + w->desc->data_deps.nr;
 	unsigned int objflags = 0;
 	uint64_t addr;
 	struct vm *vm = get_vm(wrk, w);
@@ -1709,16 +1987,16 @@ alloc_step_batch(struct workload *wrk, struct w_step *w)
 	j++;
 	igt_assert(j < nr_obj);
 
-	for_each_dep(dep, w->data_deps) {
+	for_each_dep(dep, w->desc->data_deps) {
 		uint32_t dep_handle;
 		uint64_t dep_size;
 
 		if (dep->working_set == -1) {
-			int dep_idx = w->idx + dep->target;
+			int dep_idx = w->desc->idx + dep->target;
 
 			igt_assert(dep->target <= 0);
-			igt_assert(dep_idx >= 0 && dep_idx < w->idx);
-			igt_assert(wrk->steps[dep_idx].type == BATCH);
+			igt_assert(dep_idx >= 0 && dep_idx < w->desc->idx);
+			igt_assert(wrk->steps[dep_idx].desc->type == BATCH);
 
 			dep_handle = wrk->steps[dep_idx].i915.obj[0].handle;
 			dep_size = w->bb_size;
@@ -1783,8 +2061,7 @@ xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 {
 	struct vm *vm = get_vm(wrk, w);
 	struct xe_exec_queue *eq = xe_get_eq(wrk, w);
-	struct dep_entry *dep;
-	int i;
+	unsigned int i;
 
 	w->bb_size = xe_bb_size(fd, PAGE_SIZE);
 	w->bb_handle = xe_bo_create(fd, vm->id, w->bb_size,
@@ -1801,47 +2078,21 @@ xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 								      1000LL * get_duration(wrk, w)));
 	w->xe.exec.exec_queue_id = eq->id;
 	w->xe.exec.num_batch_buffer = 1;
-	/* always at least one out fence */
-	w->xe.exec.num_syncs = 1;
-	/* count syncs */
-	for_each_dep(dep, w->data_deps) {
-		int dep_idx = w->idx + dep->target;
-
-		igt_assert(dep_idx >= 0 && dep_idx < w->idx);
-		igt_assert(wrk->steps[dep_idx].type == BATCH);
-
-		w->xe.exec.num_syncs++;
-	}
-	for_each_dep(dep, w->fence_deps) {
-		int dep_idx = w->idx + dep->target;
-
-		igt_assert(dep_idx >= 0 && dep_idx < w->idx);
-		igt_assert(wrk->steps[dep_idx].type == SW_FENCE ||
-			   wrk->steps[dep_idx].type == BATCH);
-
-		w->xe.exec.num_syncs++;
-	}
+	/* one out fence and an in fence per data and fence dependency */
+	w->xe.exec.num_syncs = 1 + w->desc->nr_data_steps +
+			       w->desc->nr_fence_steps;
 	w->xe.syncs = calloc(w->xe.exec.num_syncs, sizeof(*w->xe.syncs));
-	/* fill syncs */
-	i = 0;
 	/* out fence */
-	w->xe.syncs[i].handle = syncobj_create(fd, 0);
-	w->xe.syncs[i].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
-	w->xe.syncs[i++].flags = DRM_XE_SYNC_FLAG_SIGNAL;
+	w->xe.syncs[0].handle = syncobj_create(fd, 0);
+	w->xe.syncs[0].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
+	w->xe.syncs[0].flags = DRM_XE_SYNC_FLAG_SIGNAL;
 	/* in fence(s) */
-	for_each_dep(dep, w->data_deps) {
-		int dep_idx = w->idx + dep->target;
+	for (i = 1; i < w->xe.exec.num_syncs; i++) {
+		struct w_step *dep = &wrk->steps[w->desc->dep_steps[i - 1]];
 
-		igt_assert(wrk->steps[dep_idx].xe.syncs && wrk->steps[dep_idx].xe.syncs[0].handle);
-		w->xe.syncs[i].handle = wrk->steps[dep_idx].xe.syncs[0].handle;
-		w->xe.syncs[i++].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
-	}
-	for_each_dep(dep, w->fence_deps) {
-		int dep_idx = w->idx + dep->target;
-
-		igt_assert(wrk->steps[dep_idx].xe.syncs && wrk->steps[dep_idx].xe.syncs[0].handle);
-		w->xe.syncs[i].handle = wrk->steps[dep_idx].xe.syncs[0].handle;
-		w->xe.syncs[i++].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
+		igt_assert(dep->xe.syncs && dep->xe.syncs[0].handle);
+		w->xe.syncs[i].handle = dep->xe.syncs[0].handle;
+		w->xe.syncs[i].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
 	}
 	w->xe.exec.syncs = to_user_pointer(w->xe.syncs);
 }
@@ -1964,50 +2215,201 @@ get_buffer_size(struct workload *wrk, const struct work_buffer_size *sz)
 		       (sz->max + 1 - sz->min);
 }
 
-static unsigned long
-allocate_working_set(struct workload *wrk, struct working_set *set)
+/*
+ * Draws the buffer sizes of a working set, in order from the workload prng so
+ * they are the same however the buffers end up being created.
+ */
+static void size_working_set(struct workload *wrk, struct working_set *set)
 {
-	unsigned long total = 0;
 	unsigned int i;
 
 	set->handles = calloc(set->nr, sizeof(*set->handles));
 	igt_assert(set->handles);
 
-	for (i = 0; i < set->nr; i++) {
+	for (i = 0; i < set->nr; i++)
 		set->sizes[i].size = get_buffer_size(wrk, &set->sizes[i]);
-		set->handles[i] = alloc_bo(fd, &set->sizes[i].size);
-		total += set->sizes[i].size;
+}
+
+struct ws_create {
+	struct ws_buffer {
+		struct working_set *set;
+		unsigned int idx;
+	} *buffers;
+	unsigned long nr;
+	unsigned long next;
+};
+
+static void *ws_create_thread(void *data)
+{
+	struct ws_create *c = data;
+	unsigned long i;
+
+	while ((i = __atomic_fetch_add(&c->next, 1, __ATOMIC_RELAXED)) < c->nr) {
+		struct working_set *set = c->buffers[i].set;
+		unsigned int idx = c->buffers[i].idx;
+
+		set->handles[idx] = alloc_bo(fd, &set->sizes[idx].size);
+
+		/*
+		 * Populate the backing store now rather than on the first
+		 * execbuf. Devices without domains refuse, leaving the pages
+		 * to be allocated on first use.
+		 */
+		__gem_set_domain(fd, set->handles[idx], I915_GEM_DOMAIN_GTT, 0);
 	}
 
-	return total;
+	return NULL;
+}
+
+/*
+ * Creates the buffers of the sized working sets from as many threads as there
+ * are cpus, since populating large working sets serially dominates startup.
+ * Simulated objects are only indices and are allocated in order.
+ */
+static void create_working_sets(struct working_set **sets, unsigned int nr)
+{
+	struct ws_create c = { };
+	unsigned long nr_threads;
+	pthread_t *threads;
+	unsigned int i, j;
+
+	if (sim.enabled) {
+		for (i = 0; i < nr; i++)
+			for (j = 0; j < sets[i]->nr; j++)
+				sets[i]->handles[j] = sim_alloc_object();
+		return;
+	}
+
+	for (i = 0; i < nr; i++)
+		c.nr += sets[i]->nr;
+	if (!c.nr)
+		return;
+
+	c.buffers = calloc(c.nr, sizeof(*c.buffers));
+	igt_assert(c.buffers);
+	for (i = 0; i < nr; i++)
+		for (j = 0; j < sets[i]->nr; j++)
+			c.buffers[c.next++] = (struct ws_buffer){ sets[i], j };
+	c.next = 0;
+
+	nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	nr_threads = max(1ul, min(nr_threads, c.nr));
+	threads = calloc(nr_threads, sizeof(*threads));
+	igt_assert(threads);
+
+	for (i = 1; i < nr_threads; i++)
+		igt_assert_eq(pthread_create(&threads[i], NULL,
+					     ws_create_thread, &c), 0);
+	ws_create_thread(&c);
+	for (i = 1; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	free(c.buffers);
 }
 
-static bool
-find_dep(struct dep_entry *deps, unsigned int nr, struct dep_entry dep)
+static unsigned long working_set_size(const struct working_set *set)
 {
+	unsigned long total = 0;
 	unsigned int i;
 
+	for (i = 0; i < set->nr; i++)
+		total += set->sizes[i].size;
+
+	return total;
+}
+
+/*
+ * Allocates either the shared or the private working sets of a workload,
+ * returning their combined size.
+ */
+static unsigned long
+allocate_working_sets(struct workload *wrk, bool shared)
+{
+	struct working_set **sets;
+	unsigned long total = 0;
+	unsigned int nr = 0, i;
+	struct w_step *w;
+
+	for_each_w_step(w, wrk)
+		nr += w->desc->type == WORKINGSET && w->working_set.shared == shared;
+	if (!nr)
+		return 0;
+
+	sets = calloc(nr, sizeof(*sets));
+	igt_assert(sets);
+
+	i = 0;
+	for_each_w_step(w, wrk) {
+		if (w->desc->type == WORKINGSET && w->working_set.shared == shared) {
+			size_working_set(wrk, &w->working_set);
+			sets[i++] = &w->working_set;
+		}
+	}
+
+	create_working_sets(sets, nr);
+
 	for (i = 0; i < nr; i++) {
-		if (deps[i].working_set == dep.working_set &&
-		    deps[i].target == dep.target)
-			return true;
+		unsigned long size = working_set_size(sets[i]);
+
+		if (shared && verbose > 1)
+			printf("%u: %lu bytes in shared working set %u\n",
+			       wrk->id, size, sets[i]->id);
+		total += size;
 	}
 
-	return false;
+	free(sets);
+
+	return total;
+}
+
+/*
+ * Buffers of the active working set, keyed by working set and buffer index.
+ * Buffers of earlier batches have working set -1 and are keyed by their step.
+ */
+struct active_buffer {
+	uint64_t key;
+	unsigned long size;
+};
+
+struct engine_footprint {
+	intel_engine_t engine;
+	struct igt_map *buffers;
+	unsigned long total;
+	unsigned int nr;
+};
+
+static uint64_t active_key(int working_set, int target)
+{
+	return (uint64_t)(uint32_t)working_set << 32 | (uint32_t)target;
 }
 
 static void measure_active_set(struct workload *wrk)
 {
-	unsigned long total = 0, batch_sizes = 0;
-	struct dep_entry *dep, *deps = NULL;
-	unsigned int nr = 0;
+	unsigned long total = 0, batch_sizes = 0, nr_deps = 0;
+	struct engine_footprint *engines = NULL;
+	unsigned int nr = 0, nr_engines = 0;
+	struct active_buffer *buffers;
+	struct igt_map *active;
+	struct dep_entry *dep;
 	struct w_step *w;
+	char name[16];
 
-	if (verbose < 3)
+	if (verbose < 3 && !footprint)
 		return;
 
+	for_each_w_step(w, wrk)
+		if (w->desc->type == BATCH)
+			nr_deps += w->desc->data_deps.nr;
+
+	buffers = calloc(max(nr_deps, 1ul), sizeof(*buffers));
+	igt_assert(buffers);
+	active = igt_map_create(igt_map_hash_64, igt_map_equal_64);
+
 	for_each_w_step(w, wrk) {
-		if (w->type != BATCH)
+		struct engine_footprint *e;
+
+		if (w->desc->type != BATCH)
 			continue;
 
 		batch_sizes += w->bb_size;
@@ -2015,45 +2417,80 @@ static void measure_active_set(struct workload *wrk)
 		if (is_xe)
 			continue;
 
-		for_each_dep(dep, w->data_deps) {
-			struct dep_entry _dep = *dep;
+		for (e = engines; e < engines + nr_engines; e++)
+			if (are_equal_engines(&e->engine, &w->engine))
+				break;
+		if (e == engines + nr_engines) {
+			engines = realloc(engines,
+					  ++nr_engines * sizeof(*engines));
+			igt_assert(engines);
+			e = &engines[nr_engines - 1];
+			e->engine = w->engine;
+			e->buffers = igt_map_create(igt_map_hash_64,
+						    igt_map_equal_64);
+			e->total = 0;
+			e->nr = 0;
+		}
 
-			if (dep->working_set == -1 && dep->target < 0) {
-				int idx = w->idx + dep->target;
+		for_each_dep(dep, w->desc->data_deps) {
+			struct active_buffer *found, dep_buf;
 
-				igt_assert(idx >= 0 && idx < w->idx);
-				igt_assert(wrk->steps[idx].type == BATCH);
+			if (dep->working_set == -1) {
+				int idx = w->desc->idx + dep->target;
 
-				_dep.target = wrk->steps[idx].i915.obj[0].handle;
-			}
+				igt_assert(idx >= 0 && idx < w->desc->idx);
+				igt_assert(wrk->steps[idx].desc->type == BATCH);
 
-			if (!find_dep(deps, nr, _dep)) {
-				if (dep->working_set == -1) {
-					total += w->bb_size;
-				} else {
-					struct working_set *set;
+				dep_buf.key = active_key(-1, idx);
+				dep_buf.size = wrk->steps[idx].bb_size;
+			} else {
+				struct working_set *set;
 
-					igt_assert(dep->working_set <=
-						   wrk->max_working_set_id);
+				igt_assert(dep->working_set <=
+					   wrk->max_working_set_id);
 
-					set = wrk->working_sets[dep->working_set];
-					igt_assert(set->nr);
-					igt_assert(dep->target < set->nr);
-					igt_assert(set->sizes[dep->target].size);
+				set = wrk->working_sets[dep->working_set];
+				igt_assert(set->nr);
+				igt_assert(dep->target < set->nr);
+				igt_assert(set->sizes[dep->target].size);
 
-					total += set->sizes[dep->target].size;
-				}
+				dep_buf.key = active_key(dep->working_set,
+							 dep->target);
+				dep_buf.size = set->sizes[dep->target].size;
+			}
+
+			found = igt_map_search(active, &dep_buf.key);
+			if (!found) {
+				found = &buffers[nr++];
+				*found = dep_buf;
+				igt_map_insert(active, &found->key, found);
+				total += found->size;
+			}
 
-				deps = realloc(deps, (nr + 1) * sizeof(*deps));
-				deps[nr++] = *dep;
+			if (!igt_map_search(e->buffers, &found->key)) {
+				igt_map_insert(e->buffers, &found->key, found);
+				e->total += found->size;
+				e->nr++;
 			}
 		}
 	}
 
-	free(deps);
-
 	printf("%u: %lu bytes active working set in %u buffers. %lu in batch buffers.\n",
 	       wrk->id, total, nr, batch_sizes);
+
+	for (unsigned int i = 0; i < nr_engines; i++) {
+		if (footprint)
+			printf("%u: %lu bytes active working set on %s in %u buffers.\n",
+			       wrk->id, engines[i].total,
+			       engine_name(&engines[i].engine,
+					   name, sizeof(name)),
+			       engines[i].nr);
+		igt_map_destroy(engines[i].buffers, NULL);
+	}
+
+	igt_map_destroy(active, NULL);
+	free(engines);
+	free(buffers);
 }
 
 #define alloca0(sz) ({ size_t sz__ = (sz); memset(alloca(sz__), 0, sz__); })
@@ -2091,7 +2528,7 @@ static void allocate_contexts(unsigned int id, struct workload *wrk)
 	 * Pre-scan workload steps to allocate context list storage.
 	 */
 	for_each_w_step(w, wrk) {
-		int ctx = w->context + 1;
+		int ctx = w->desc->context + 1;
 		int delta;
 
 		w->wrk = wrk;
@@ -2111,34 +2548,33 @@ static void allocate_contexts(unsigned int id, struct workload *wrk)
 	}
 }
 
-static int prepare_contexts(unsigned int id, struct workload *wrk)
+/*
+ * Transfer over engine map configuration from the workload step.
+ */
+static int configure_engine_maps(struct workload *wrk)
 {
-	uint32_t share_vm = 0;
 	struct w_step *w;
-	struct ctx *ctx, *ctx2;
-	unsigned int j;
+	struct ctx *ctx;
 
-	/*
-	 * Transfer over engine map configuration from the workload step.
-	 */
 	__for_each_ctx(ctx, wrk, ctx_idx) {
 		for_each_w_step(w, wrk) {
-			if (w->context != ctx_idx)
+			if (w->desc->context != ctx_idx)
 				continue;
 
-			if (w->type == ENGINE_MAP) {
-				ctx->engine_map = w->engine_map;
-			} else if (w->type == LOAD_BALANCE) {
+			if (w->desc->type == ENGINE_MAP) {
+				ctx->engine_map = w->desc->engine_map;
+			} else if (w->desc->type == LOAD_BALANCE) {
 				if (!ctx->engine_map.nr_engines) {
 					wsim_err("Load balancing needs an engine map!\n");
 					return 1;
 				}
-				if (intel_gen(intel_get_drm_devid(fd)) < 11) {
+				if (!sim.enabled &&
+				    intel_gen(intel_get_drm_devid(fd)) < 11) {
 					wsim_err("Load balancing needs relative mmio support, gen11+!\n");
 					return 1;
 				}
-				ctx->load_balance = w->load_balance;
-			} else if (w->type == BOND) {
+				ctx->load_balance = w->desc->load_balance;
+			} else if (w->desc->type == BOND) {
 				if (!ctx->load_balance) {
 					wsim_err("Engine bonds need load balancing engine map!\n");
 					return 1;
@@ -2148,11 +2584,58 @@ static int prepare_contexts(unsigned int id, struct workload *wrk)
 						     ctx->bond_count *
 						     sizeof(struct bond));
 				igt_assert(ctx->bonds);
-				ctx->bonds[ctx->bond_count - 1] = w->bond;
+				ctx->bonds[ctx->bond_count - 1] = w->desc->bond;
 			}
 		}
 	}
 
+	return 0;
+}
+
+/* Update engine_idx and request_idx of the batches of a context. */
+static void resolve_ctx_engines(struct workload *wrk, unsigned int ctx_idx,
+				struct ctx *ctx)
+{
+	struct w_step *w;
+
+	for_each_w_step(w, wrk) {
+		if (w->desc->context != ctx_idx || w->desc->type != BATCH)
+			continue;
+
+		if (ctx->engine_map.nr_engines) {
+			unsigned int map_idx = 0;
+
+			if (find_engine_in_map(&w->engine, &ctx->engine_map,
+					       &map_idx))
+				/* 0 is virtual, map indexes are shifted by one */
+				w->engine_idx = map_idx + 1;
+			else
+				igt_assert(ctx->load_balance);
+
+			igt_assert(find_engine_in_map(&ctx->engine_map
+								.engines[map_idx],
+						      query_engines(),
+						      &w->request_idx));
+		} else {
+			if (!sim.enabled)
+				w->engine_idx = engine_to_i915_legacy_ring(&w->engine);
+			resolve_to_physical_engine(&w->engine);
+			igt_assert(find_engine_in_map(&w->engine,
+						      query_engines(),
+						      &w->request_idx));
+		}
+	}
+}
+
+static int prepare_contexts(unsigned int id, struct workload *wrk)
+{
+	uint32_t share_vm = 0;
+	struct ctx *ctx, *ctx2;
+	unsigned int j;
+
+	if (configure_engine_maps(wrk))
+		return 1;
+
 	/*
 	 * Create and configure contexts.
 	 */
@@ -2219,26 +2702,7 @@ static int prepare_contexts(unsigned int id, struct workload *wrk)
 			};
 			struct i915_context_engines_bond *last = NULL;
 
-			/* update engine_idx and request_idx */
-			for_each_w_step(w, wrk) {
-				if (w->context != ctx_idx)
-					continue;
-				if (w->type == BATCH) {
-					unsigned int map_idx = 0;
-
-					if (find_engine_in_map(&w->engine, &ctx->engine_map,
-							       &map_idx))
-						/* 0 is virtual, map indexes are shifted by one */
-						w->engine_idx = map_idx + 1;
-					else
-						igt_assert(ctx->load_balance);
-
-					igt_assert(find_engine_in_map(&ctx->engine_map
-										.engines[map_idx],
-								      query_engines(),
-								      &w->request_idx));
-				}
-			}
+			resolve_ctx_engines(wrk, ctx_idx, ctx);
 
 			if (ctx->load_balance) {
 				set_engines->extensions =
@@ -2295,18 +2759,7 @@ static int prepare_contexts(unsigned int id, struct workload *wrk)
 
 			gem_context_set_param(fd, &param);
 		} else {
-			/* update engine_idx and request_idx */
-			for_each_w_step(w, wrk) {
-				if (w->context != ctx_idx)
-					continue;
-				if (w->type == BATCH) {
-					w->engine_idx = engine_to_i915_legacy_ring(&w->engine);
-					resolve_to_physical_engine(&w->engine);
-					igt_assert(find_engine_in_map(&w->engine,
-								      query_engines(),
-								      &w->request_idx));
-				}
-			}
+			resolve_ctx_engines(wrk, ctx_idx, ctx);
 		}
 
 		if (wrk->sseu) {
@@ -2341,16 +2794,16 @@ static int xe_prepare_contexts(unsigned int id, struct workload *wrk)
 		/* link with vm */
 		ctx->vm = wrk->vm_list;
 		for_each_w_step(w, wrk) {
-			if (w->context != ctx_idx)
+			if (w->desc->context != ctx_idx)
 				continue;
-			if (w->type == ENGINE_MAP) {
-				ctx->engine_map = w->engine_map;
-			} else if (w->type == LOAD_BALANCE) {
+			if (w->desc->type == ENGINE_MAP) {
+				ctx->engine_map = w->desc->engine_map;
+			} else if (w->desc->type == LOAD_BALANCE) {
 				if (!ctx->engine_map.nr_engines) {
 					wsim_err("Load balancing needs an engine map!\n");
 					return 1;
 				}
-				ctx->load_balance = w->load_balance;
+				ctx->load_balance = w->desc->load_balance;
 			}
 		}
 
@@ -2399,9 +2852,9 @@ static int xe_prepare_contexts(unsigned int id, struct workload *wrk)
 		} else {
 			/* create engine_map, update engine_idx */
 			for_each_w_step(w, wrk) {
-				if (w->context != ctx_idx)
+				if (w->desc->context != ctx_idx)
 					continue;
-				if (w->type == BATCH) {
+				if (w->desc->type == BATCH) {
 					resolve_to_physical_engine(&w->engine);
 					if (!find_engine_in_map(&w->engine, &ctx->engine_map,
 								&w->engine_idx)) {
@@ -2443,9 +2896,9 @@ static int xe_prepare_contexts(unsigned int id, struct workload *wrk)
 
 		/* update request_idx */
 		for_each_w_step(w, wrk) {
-			if (w->context != ctx_idx)
+			if (w->desc->context != ctx_idx)
 				continue;
-			if (w->type == BATCH) {
+			if (w->desc->type == BATCH) {
 				igt_assert(find_engine_in_map(&ctx->engine_map
 									.engines[w->engine_idx],
 							      query_engines(),
@@ -2456,7 +2909,7 @@ static int xe_prepare_contexts(unsigned int id, struct workload *wrk)
 
 	/* create syncobjs for SW_FENCE */
 	for_each_w_step(w, wrk)
-		if (w->type == SW_FENCE) {
+		if (w->desc->type == SW_FENCE) {
 			w->xe.syncs = calloc(1, sizeof(struct drm_xe_sync));
 			w->xe.syncs[0].handle = syncobj_create(fd, 0);
 			w->xe.syncs[0].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
@@ -2465,6 +2918,21 @@ static int xe_prepare_contexts(unsigned int id, struct workload *wrk)
 	return 0;
 }
 
+static int sim_prepare_contexts(struct workload *wrk)
+{
+	struct ctx *ctx;
+
+	if (configure_engine_maps(wrk))
+		return 1;
+
+	__for_each_ctx(ctx, wrk, ctx_idx) {
+		ctx->priority = wrk->prio;
+		resolve_ctx_engines(wrk, ctx_idx, ctx);
+	}
+
+	return 0;
+}
+
 static void prepare_working_sets(unsigned int id, struct workload *wrk)
 {
 	struct working_set **sets;
@@ -2474,10 +2942,7 @@ static void prepare_working_sets(unsigned int id, struct workload *wrk)
 	/*
 	 * Allocate working sets.
 	 */
-	for_each_w_step(w, wrk) {
-		if (w->type == WORKINGSET && !w->working_set.shared)
-			total += allocate_working_set(wrk, &w->working_set);
-	}
+	total = allocate_working_sets(wrk, false);
 
 	if (verbose > 2)
 		printf("%u: %lu bytes in working sets.\n", wrk->id, total);
@@ -2487,7 +2952,7 @@ static void prepare_working_sets(unsigned int id, struct workload *wrk)
 	 */
 	wrk->max_working_set_id = -1;
 	for_each_w_step(w, wrk) {
-		if (w->type == WORKINGSET &&
+		if (w->desc->type == WORKINGSET &&
 		    w->working_set.id > wrk->max_working_set_id)
 			wrk->max_working_set_id = w->working_set.id;
 	}
@@ -2500,7 +2965,7 @@ static void prepare_working_sets(unsigned int id, struct workload *wrk)
 	for_each_w_step(w, wrk) {
 		struct working_set *set;
 
-		if (w->type != WORKINGSET)
+		if (w->desc->type != WORKINGSET)
 			continue;
 
 		if (!w->working_set.shared) {
@@ -2532,7 +2997,9 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 
 	allocate_contexts(id, wrk);
 
-	if (is_xe)
+	if (sim.enabled)
+		ret = sim_prepare_contexts(wrk);
+	else if (is_xe)
 		ret = xe_prepare_contexts(id, wrk);
 	else
 		ret = prepare_contexts(id, wrk);
@@ -2542,7 +3009,7 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 
 	/* Record default preemption. */
 	for_each_w_step(w, wrk)
-		if (w->type == BATCH)
+		if (w->desc->type == BATCH)
 			w->preempt_us = 100;
 
 	/*
@@ -2553,20 +3020,20 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 	for_each_w_step(w, wrk) {
 		struct w_step *w2;
 
-		if (w->type != PREEMPTION)
+		if (w->desc->type != PREEMPTION)
 			continue;
 
-		for (int j = w->idx + 1; j < wrk->nr_steps; j++) {
+		for (int j = w->desc->idx + 1; j < wrk->nr_steps; j++) {
 			w2 = &wrk->steps[j];
 
-			if (w2->context != w->context)
+			if (w2->desc->context != w->desc->context)
 				continue;
-			else if (w2->type == PREEMPTION)
+			else if (w2->desc->type == PREEMPTION)
 				break;
-			else if (w2->type != BATCH)
+			else if (w2->desc->type != BATCH)
 				continue;
 
-			w2->preempt_us = w->period;
+			w2->preempt_us = w->desc->period;
 		}
 	}
 
@@ -2574,7 +3041,7 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 	 * Scan for SSEU control steps.
 	 */
 	for_each_w_step(w, wrk) {
-		if (w->type == SSEU) {
+		if (w->desc->type == SSEU && !sim.enabled) {
 			get_device_sseu();
 			break;
 		}
@@ -2586,17 +3053,44 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 	 * Allocate batch buffers.
 	 */
 	for_each_w_step(w, wrk) {
-		if (w->type != BATCH)
+		if (w->desc->type != BATCH)
 			continue;
 
-		if (is_xe)
+		if (sim.enabled) {
+			w->bb_handle = sim_alloc_object();
+			w->bb_size = PAGE_SIZE;
+		} else if (is_xe) {
 			xe_alloc_step_batch(wrk, w);
-		else
+		} else {
 			alloc_step_batch(wrk, w);
+		}
 	}
 
 	measure_active_set(wrk);
 
+	if (latency_format != LATENCY_NONE) {
+		for_each_w_step(w, wrk) {
+			if (w->desc->type != BATCH && w->desc->type != PERIOD)
+				continue;
+
+			w->latency = malloc(sizeof(*w->latency));
+			igt_assert(w->latency);
+			igt_histogram_init(w->latency, LATENCY_PRECISION,
+					   LATENCY_LIMIT);
+		}
+	}
+
+	if (latency_format != LATENCY_NONE && sim.enabled) {
+		unsigned int nr_engines = query_engines()->nr_engines;
+
+		wrk->queue_latency = calloc(nr_engines,
+					    sizeof(*wrk->queue_latency));
+		igt_assert(wrk->queue_latency);
+		for (int i = 0; i < nr_engines; i++)
+			igt_histogram_init(&wrk->queue_latency[i],
+					   LATENCY_PRECISION, LATENCY_LIMIT);
+	}
+
 	return ret;
 }
 
@@ -2611,6 +3105,13 @@ static int elapsed_us(const struct timespec *start, const struct timespec *end)
 	return elapsed(start, end) * 1e6;
 }
 
+static uint64_t elapsed_ns(const struct timespec *start,
+			   const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * NSEC_PER_SEC +
+	       end->tv_nsec - start->tv_nsec;
+}
+
 static void
 update_bb_start(struct workload *wrk, struct w_step *w)
 {
@@ -2618,7 +3119,7 @@ update_bb_start(struct workload *wrk, struct w_step *w)
 
 	/* ticks is inverted for MI_DO_COMPARE (less-than comparison) */
 	ticks = 0;
-	if (!w->duration.unbound)
+	if (!w->desc->duration.unbound)
 		ticks = ~ns_to_ctx_ticks(1000LL * get_duration(wrk, w));
 
 	*w->i915.bb_duration = ticks;
@@ -2631,13 +3132,13 @@ static void w_sync_to(struct workload *wrk, struct w_step *w, int target)
 
 	igt_assert(target < wrk->nr_steps);
 
-	while (wrk->steps[target].type != BATCH) {
+	while (wrk->steps[target].desc->type != BATCH) {
 		if (--target < 0)
 			target = wrk->nr_steps + target;
 	}
 
 	igt_assert(target < wrk->nr_steps);
-	igt_assert(wrk->steps[target].type == BATCH);
+	igt_assert(wrk->steps[target].desc->type == BATCH);
 
 	w_step_sync(&wrk->steps[target]);
 }
@@ -2651,7 +3152,7 @@ static void do_xe_exec(struct workload *wrk, struct w_step *w)
 		syncobj_reset(fd, &w->xe.syncs[0].handle, 1);
 
 	/* update duration if random */
-	if (w->duration.max != w->duration.min)
+	if (w->desc->duration.max != w->desc->duration.min)
 		xe_spin_init_opts(&w->xe.data->spin,
 				  .addr = w->xe.exec.address,
 				  .preempt = (w->preempt_us > 0),
@@ -2663,21 +3164,19 @@ static void do_xe_exec(struct workload *wrk, struct w_step *w)
 static void
 do_eb(struct workload *wrk, struct w_step *w)
 {
-	struct dep_entry *dep;
 	unsigned int i;
 
 	eb_update_flags(wrk, w);
 	update_bb_start(wrk, w);
 
-	for_each_dep(dep, w->fence_deps) {
-		int tgt = w->idx + dep->target;
+	for (i = 0; i < w->desc->nr_fence_steps; i++) {
+		int tgt = w->desc->dep_steps[w->desc->nr_data_steps + i];
 
 		/* TODO: fence merging needed to support multiple inputs */
 		igt_assert(i == 0);
-		igt_assert(tgt >= 0 && tgt < w->idx);
 		igt_assert(wrk->steps[tgt].emit_fence > 0);
 
-		if (w->fence_deps.submit_fence)
+		if (w->desc->fence_deps.submit_fence)
 			w->i915.eb.flags |= I915_EXEC_FENCE_SUBMIT;
 		else
 			w->i915.eb.flags |= I915_EXEC_FENCE_IN;
@@ -2700,25 +3199,22 @@ static void sync_deps(struct workload *wrk, struct w_step *w)
 {
 	unsigned int i;
 
-	for (i = 0; i < w->data_deps.nr; i++) {
-		struct dep_entry *entry = &w->data_deps.list[i];
-		int dep_idx;
-
-		if (entry->working_set == -1)
-			continue;
-
-		igt_assert(entry->target <= 0);
-
-		if (!entry->target)
-			continue;
-
-		dep_idx = w->idx + entry->target;
-
-		igt_assert(dep_idx >= 0 && dep_idx < w->idx);
-		igt_assert(wrk->steps[dep_idx].type == BATCH);
+	for (i = 0; i < w->desc->nr_data_steps; i++)
+		w_step_sync(&wrk->steps[w->desc->dep_steps[i]]);
+}
 
-		w_step_sync(&wrk->steps[dep_idx]);
-	}
+static void
+print_workload_stats(struct workload *wrk, double t, int count,
+		     unsigned long time_tot, unsigned long time_min,
+		     unsigned long time_max, int missed)
+{
+	printf("%c%u: %.3fs elapsed (%d cycles, %.3f workloads/s).",
+	       wrk->background ? ' ' : '*', wrk->id,
+	       t, count, count / t);
+	if (time_tot)
+		printf(" Time avg/min/max=%lu/%lu/%luus; %u missed.",
+		       time_tot / count, time_min, time_max, missed);
+	putchar('\n');
 }
 
 static void *run_workload(void *data)
@@ -2740,20 +3236,24 @@ static void *run_workload(void *data)
 		clock_gettime(CLOCK_MONOTONIC, &repeat_start);
 
 		for_each_w_step(w, wrk) {
+			const struct w_step_desc *d = w->desc;
 			int do_sleep = 0;
 
 			if (!wrk->run)
 				break;
 
-			if (w->type == DELAY) {
-				do_sleep = w->delay;
-			} else if (w->type == PERIOD) {
+			if (d->type == DELAY) {
+				do_sleep = d->delay;
+			} else if (d->type == PERIOD) {
 				struct timespec now;
 				int elapsed;
 
 				clock_gettime(CLOCK_MONOTONIC, &now);
 				elapsed = elapsed_us(&repeat_start, &now);
-				do_sleep = w->period - elapsed;
+				if (w->latency)
+					igt_histogram_add(w->latency,
+							  elapsed_ns(&repeat_start, &now));
+				do_sleep = d->period - elapsed;
 				time_tot += elapsed;
 				if (elapsed < time_min)
 					time_min = elapsed;
@@ -2763,62 +3263,62 @@ static void *run_workload(void *data)
 					missed++;
 					if (verbose > 2)
 						printf("%u: Dropped period @ %u/%u (%dus late)!\n",
-						       wrk->id, count, w->idx, do_sleep);
+						       wrk->id, count, d->idx, do_sleep);
 					continue;
 				}
-			} else if (w->type == SYNC) {
-				unsigned int s_idx = w->idx + w->target;
+			} else if (d->type == SYNC) {
+				unsigned int s_idx = d->idx + d->target;
 
-				igt_assert(s_idx >= 0 && s_idx < w->idx);
-				igt_assert(wrk->steps[s_idx].type == BATCH);
+				igt_assert(s_idx >= 0 && s_idx < d->idx);
+				igt_assert(wrk->steps[s_idx].desc->type == BATCH);
 				w_step_sync(&wrk->steps[s_idx]);
 				continue;
-			} else if (w->type == THROTTLE) {
-				throttle = w->throttle;
+			} else if (d->type == THROTTLE) {
+				throttle = d->throttle;
 				continue;
-			} else if (w->type == QD_THROTTLE) {
-				qd_throttle = w->throttle;
+			} else if (d->type == QD_THROTTLE) {
+				qd_throttle = d->throttle;
 				continue;
-			} else if (w->type == SW_FENCE) {
+			} else if (d->type == SW_FENCE) {
 				igt_assert(w->emit_fence < 0);
 				w->emit_fence =
 					sw_sync_timeline_create_fence(wrk->sync_timeline,
-								      cur_seqno + w->idx);
+								      cur_seqno + d->idx);
 				igt_assert(w->emit_fence > 0);
 				if (is_xe)
 					/* Convert sync file to syncobj */
 					syncobj_import_sync_file(fd, w->xe.syncs[0].handle,
 								 w->emit_fence);
 				continue;
-			} else if (w->type == SW_FENCE_SIGNAL) {
-				int tgt = w->idx + w->target;
+			} else if (d->type == SW_FENCE_SIGNAL) {
+				int tgt = d->idx + d->target;
 				int inc;
 
-				igt_assert(tgt >= 0 && tgt < w->idx);
-				igt_assert(wrk->steps[tgt].type == SW_FENCE);
-				cur_seqno += wrk->steps[tgt].idx;
+				igt_assert(tgt >= 0 && tgt < d->idx);
+				igt_assert(wrk->steps[tgt].desc->type == SW_FENCE);
+				cur_seqno += wrk->steps[tgt].desc->idx;
 				inc = cur_seqno - wrk->sync_seqno;
 				sw_sync_timeline_inc(wrk->sync_timeline, inc);
 				continue;
-			} else if (w->type == CTX_PRIORITY) {
-				if (w->priority != wrk->ctx_list[w->context].priority) {
+			} else if (d->type == CTX_PRIORITY) {
+				if (d->priority != wrk->ctx_list[d->context].priority) {
 					struct drm_i915_gem_context_param param = {
-						.ctx_id = wrk->ctx_list[w->context].id,
+						.ctx_id = wrk->ctx_list[d->context].id,
 						.param = I915_CONTEXT_PARAM_PRIORITY,
-						.value = w->priority,
+						.value = d->priority,
 					};
 
 					gem_context_set_param(fd, &param);
-					wrk->ctx_list[w->context].priority =
-								    w->priority;
+					wrk->ctx_list[d->context].priority =
+								    d->priority;
 				}
 				continue;
-			} else if (w->type == TERMINATE) {
-				unsigned int t_idx = w->idx + w->target;
+			} else if (d->type == TERMINATE) {
+				unsigned int t_idx = d->idx + d->target;
 
-				igt_assert(t_idx >= 0 && t_idx < w->idx);
-				igt_assert(wrk->steps[t_idx].type == BATCH);
-				igt_assert(wrk->steps[t_idx].duration.unbound);
+				igt_assert(t_idx >= 0 && t_idx < d->idx);
+				igt_assert(wrk->steps[t_idx].desc->type == BATCH);
+				igt_assert(wrk->steps[t_idx].desc->duration.unbound);
 
 				if (is_xe)
 					xe_spin_end(&wrk->steps[t_idx].xe.data->spin);
@@ -2826,34 +3326,37 @@ static void *run_workload(void *data)
 					*wrk->steps[t_idx].i915.bb_duration = 0xffffffff;
 				__sync_synchronize();
 				continue;
-			} else if (w->type == SSEU) {
-				if (w->sseu != wrk->ctx_list[w->context * 2].sseu) {
-					wrk->ctx_list[w->context * 2].sseu =
-						set_ctx_sseu(&wrk->ctx_list[w->context * 2],
-							     w->sseu);
+			} else if (d->type == SSEU) {
+				if (d->sseu != wrk->ctx_list[d->context * 2].sseu) {
+					wrk->ctx_list[d->context * 2].sseu =
+						set_ctx_sseu(&wrk->ctx_list[d->context * 2],
+							     d->sseu);
 				}
 				continue;
-			} else if (w->type == PREEMPTION ||
-				   w->type == ENGINE_MAP ||
-				   w->type == LOAD_BALANCE ||
-				   w->type == BOND ||
-				   w->type == WORKINGSET) {
+			} else if (d->type == PREEMPTION ||
+				   d->type == ENGINE_MAP ||
+				   d->type == LOAD_BALANCE ||
+				   d->type == BOND ||
+				   d->type == WORKINGSET) {
 				   /* No action for these at execution time. */
 				continue;
 			}
 
-			if (do_sleep || w->type == PERIOD) {
+			if (do_sleep || d->type == PERIOD) {
 				usleep(do_sleep);
 				continue;
 			}
 
-			igt_assert(w->type == BATCH);
+			igt_assert(d->type == BATCH);
 
 			if (wrk->flags & FLAG_DEPSYNC)
 				sync_deps(wrk, w);
 
 			if (throttle > 0)
-				w_sync_to(wrk, w, w->idx - throttle);
+				w_sync_to(wrk, w, d->idx - throttle);
+
+			if (w->latency)
+				w->submit_ns = now_ns();
 
 			if (is_xe)
 				do_xe_exec(wrk, w);
@@ -2870,7 +3373,7 @@ static void *run_workload(void *data)
 			if (!wrk->run)
 				break;
 
-			if (w->sync)
+			if (d->sync)
 				w_step_sync(w);
 
 			if (qd_throttle > 0) {
@@ -2903,7 +3406,7 @@ static void *run_workload(void *data)
 
 			if (w->emit_fence > 0) {
 				if (is_xe) {
-					igt_assert(w->type == SW_FENCE);
+					igt_assert(w->desc->type == SW_FENCE);
 					syncobj_reset(fd, &w->xe.syncs[0].handle, 1);
 				}
 				close(w->emit_fence);
@@ -2922,7 +3425,7 @@ static void *run_workload(void *data)
 
 	if (is_xe) {
 		for_each_w_step(w, wrk) {
-			if (w->type == BATCH) {
+			if (w->desc->type == BATCH) {
 				w_step_sync(w);
 				syncobj_destroy(fd, w->xe.syncs[0].handle);
 				free(w->xe.syncs);
@@ -2930,7 +3433,7 @@ static void *run_workload(void *data)
 						  w->bb_size);
 				gem_munmap(w->xe.data, w->bb_size);
 				gem_close(fd, w->bb_handle);
-			} else if (w->type == SW_FENCE) {
+			} else if (w->desc->type == SW_FENCE) {
 				syncobj_destroy(fd, w->xe.syncs[0].handle);
 				free(w->xe.syncs);
 			}
@@ -2939,23 +3442,825 @@ static void *run_workload(void *data)
 
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
-	if (wrk->print_stats) {
-		double t = elapsed(&t_start, &t_end);
+	if (wrk->print_stats)
+		print_workload_stats(wrk, elapsed(&t_start, &t_end), count,
+				     time_tot, time_min, time_max, missed);
+
+	return NULL;
+}
+
+/*
+ * Discrete event simulation of the workloads, with --simulate.
+ *
+ * Batches become requests against the engines of the sim model and clients
+ * step through their workloads in virtual time, blocking wherever
+ * run_workload() would block. A request runs after the previous request of
+ * its context on the same engine, after its fence dependencies and, through
+ * the objects it accesses, after its implicit data dependencies. Ready
+ * requests are picked in priority order and a higher priority request
+ * preempts a running one at its next arbitration point.
+ */
+
+#define SIM_UNBOUND UINT64_MAX
+
+struct sim_waiter {
+	struct sim_request *rq;
+	bool on_start; /* Submit fence, signalled when the request starts. */
+};
 
-		printf("%c%u: %.3fs elapsed (%d cycles, %.3f workloads/s).",
-		       wrk->background ? ' ' : '*', wrk->id,
-		       t, count, count / t);
-		if (time_tot)
-			printf(" Time avg/min/max=%lu/%lu/%luus; %u missed.",
-			       time_tot / count, time_min, time_max, missed);
-		putchar('\n');
+struct sim_request {
+	unsigned int refcount;
+	uint64_t seqno;
+	int prio;
+	uint64_t engines; /* Mask of engines it can run on, none for sw fences. */
+	int engine;
+	unsigned int preempt_us;
+	uint64_t remaining; /* Execution time left in ns. */
+	unsigned int pending; /* Unsignalled dependencies. */
+	bool started;
+	bool done;
+	struct w_step *step;
+	struct ctx *ctx;
+	uint64_t submit_ns;
+	uint64_t ready_ns;
+	struct sim_waiter *waiters;
+	unsigned int nr_waiters;
+	struct igt_list_head link;
+};
+
+struct sim_engine {
+	struct sim_request *rq;
+	uint64_t start;
+	bool preempt;
+	uint64_t preempt_at;
+	uint64_t busy;
+};
+
+struct sim_client {
+	struct workload *wrk;
+	struct sim_request **rq; /* Latest request of each step. */
+	struct sim_request **timelines; /* Per context and engine. */
+	struct sim_request *wait;
+	uint64_t wake;
+	uint64_t repeat_start;
+	uint64_t t_end;
+	unsigned int step;
+	bool in_iteration;
+	bool submitted;
+	bool draining;
+	bool finished;
+	int throttle;
+	int qd_throttle;
+	int count, missed;
+	unsigned long time_tot, time_min, time_max;
+};
+
+static uint64_t sim_now;
+static uint64_t sim_seqno;
+static IGT_LIST_HEAD(sim_queue); /* Ready requests in execution order. */
+static struct sim_engine sim_engines[SIM_MAX_ENGINES];
+static unsigned int sim_nr_engines;
+
+static struct sim_request *sim_request_get(struct sim_request *rq)
+{
+	if (rq)
+		rq->refcount++;
+
+	return rq;
+}
+
+static void sim_request_put(struct sim_request *rq)
+{
+	if (!rq || --rq->refcount)
+		return;
+
+	igt_assert(rq->done);
+	free(rq->waiters);
+	free(rq);
+}
+
+static void sim_request_assign(struct sim_request **slot,
+			       struct sim_request *rq)
+{
+	sim_request_get(rq);
+	sim_request_put(*slot);
+	*slot = rq;
+}
+
+static uint64_t sim_engine_mask(const struct intel_engines *engines)
+{
+	uint64_t mask = 0;
+	unsigned int i, idx;
+
+	for (i = 0; i < engines->nr_engines; i++)
+		if (find_engine_in_map(&engines->engines[i], query_engines(),
+				       &idx))
+			mask |= 1ull << idx;
+
+	return mask;
+}
+
+/* Restrict a bonded request to the siblings of the engine its master got. */
+static void sim_bond(struct sim_request *rq, const struct sim_request *master)
+{
+	const intel_engine_t *engine;
+	unsigned int i;
+
+	if (master->engine < 0)
+		return;
+
+	engine = &query_engines()->engines[master->engine];
+	for (i = 0; i < rq->ctx->bond_count; i++)
+		if (are_equal_engines(&rq->ctx->bonds[i].master, engine))
+			rq->engines &= sim_engine_mask(&rq->ctx->bonds[i].mask);
+}
+
+static void sim_queue_request(struct sim_request *rq)
+{
+	struct sim_request *pos;
+
+	igt_list_for_each_entry(pos, &sim_queue, link) {
+		if ((!sim.fifo && rq->prio > pos->prio) ||
+		    ((sim.fifo || rq->prio == pos->prio) &&
+		     rq->seqno < pos->seqno)) {
+			igt_list_add_tail(&rq->link, &pos->link);
+			return;
+		}
+	}
+
+	igt_list_add_tail(&rq->link, &sim_queue);
+}
+
+static void sim_request_submit(struct sim_request *rq)
+{
+	/* Software fences only wait to be signalled. */
+	if (!--rq->pending && rq->engines) {
+		rq->ready_ns = sim_now;
+		sim_queue_request(rq);
+	}
+}
+
+static void sim_signal(struct sim_request *rq)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < rq->nr_waiters; i++) {
+		struct sim_waiter *waiter = &rq->waiters[i];
+
+		if (!rq->done && !waiter->on_start) {
+			rq->waiters[n++] = *waiter;
+			continue;
+		}
+
+		if (waiter->on_start)
+			sim_bond(waiter->rq, rq);
+		sim_request_submit(waiter->rq);
+	}
+
+	rq->nr_waiters = n;
+}
+
+static void sim_await(struct sim_request *rq, struct sim_request *signal,
+		      bool on_start)
+{
+	if (!signal || signal == rq || signal->done)
+		return;
+
+	if (on_start && signal->started) {
+		sim_bond(rq, signal);
+		return;
+	}
+
+	signal->waiters = realloc(signal->waiters, (signal->nr_waiters + 1) *
+				  sizeof(*signal->waiters));
+	igt_assert(signal->waiters);
+	signal->waiters[signal->nr_waiters++] =
+		(struct sim_waiter){ rq, on_start };
+	rq->pending++;
+}
+
+static void sim_complete(struct sim_request *rq)
+{
+	/* Unlike on a device every completion is seen as it happens. */
+	if (rq->step->latency)
+		igt_histogram_add(rq->step->latency, sim_now - rq->submit_ns);
+
+	rq->started = true;
+	rq->done = true;
+	sim_signal(rq);
+	sim_request_put(rq); /* Reference held while in flight. */
+}
+
+/* Writers wait for everyone before them, readers only for the last writer. */
+static void sim_object_access(struct sim_request *rq, uint32_t handle,
+			      bool write)
+{
+	struct sim_object *obj = &sim_objects[handle];
+	unsigned int i, n = 0;
+
+	sim_await(rq, obj->write, false);
+
+	if (write) {
+		for (i = 0; i < obj->nr_reads; i++) {
+			sim_await(rq, obj->reads[i], false);
+			sim_request_put(obj->reads[i]);
+		}
+		obj->nr_reads = 0;
+		sim_request_assign(&obj->write, rq);
+		return;
+	}
+
+	for (i = 0; i < obj->nr_reads; i++) {
+		if (obj->reads[i]->done)
+			sim_request_put(obj->reads[i]);
+		else
+			obj->reads[n++] = obj->reads[i];
+	}
+
+	obj->reads = realloc(obj->reads, (n + 1) * sizeof(*obj->reads));
+	igt_assert(obj->reads);
+	obj->reads[n++] = sim_request_get(rq);
+	obj->nr_reads = n;
+}
+
+static struct sim_request *
+sim_request_create(struct sim_client *c, struct w_step *w, uint64_t engines)
+{
+	struct sim_request *rq;
+
+	rq = calloc(1, sizeof(*rq));
+	igt_assert(rq);
+
+	rq->refcount = 1; /* Dropped on completion. */
+	rq->pending = 1; /* Dropped once submitted. */
+	rq->seqno = ++sim_seqno;
+	rq->engine = -1;
+	rq->engines = engines;
+	rq->step = w;
+	rq->submit_ns = sim_now;
+	rq->ctx = __get_ctx(c->wrk, w);
+	rq->prio = rq->ctx->priority;
+
+	sim_request_assign(&c->rq[w->desc->idx], rq);
+
+	return rq;
+}
+
+static void sim_submit_batch(struct sim_client *c, struct w_step *w)
+{
+	const struct w_step_desc *d = w->desc;
+	struct workload *wrk = c->wrk;
+	struct ctx *ctx = __get_ctx(wrk, w);
+	struct sim_request *rq, **timeline;
+	struct dep_entry *dep;
+	unsigned int slot, i;
+
+	if (ctx->load_balance && !w->engine_idx)
+		rq = sim_request_create(c, w, sim_engine_mask(&ctx->engine_map));
+	else
+		rq = sim_request_create(c, w, 1ull << w->request_idx);
+
+	rq->preempt_us = w->preempt_us;
+	rq->remaining = d->duration.unbound ?
+			SIM_UNBOUND : 1000ull * get_duration(wrk, w);
+
+	/* Contexts execute in order on each of their engines. */
+	slot = ctx->engine_map.nr_engines ? w->engine_idx : w->request_idx + 1;
+	igt_assert(slot <= sim_nr_engines);
+	timeline = &c->timelines[d->context * (sim_nr_engines + 1) + slot];
+	sim_await(rq, *timeline, false);
+	sim_request_assign(timeline, rq);
+
+	for (i = 0; i < d->nr_fence_steps; i++)
+		sim_await(rq, c->rq[d->dep_steps[d->nr_data_steps + i]],
+			  d->fence_deps.submit_fence);
+
+	sim_object_access(rq, w->bb_handle, true);
+	for_each_dep(dep, d->data_deps) {
+		uint32_t handle;
+
+		if (dep->working_set == -1) {
+			int dep_idx = d->idx + dep->target;
+
+			igt_assert(dep_idx >= 0 && dep_idx < d->idx);
+			igt_assert(wrk->steps[dep_idx].desc->type == BATCH);
+			handle = wrk->steps[dep_idx].bb_handle;
+		} else {
+			struct working_set *set;
+
+			igt_assert(dep->working_set <= wrk->max_working_set_id);
+			set = wrk->working_sets[dep->working_set];
+			igt_assert(dep->target < set->nr);
+			handle = set->handles[dep->target];
+		}
+
+		sim_object_access(rq, handle, dep->write);
+	}
+
+	sim_request_submit(rq);
+}
+
+/* Software fences signal like a sync timeline advanced to the target. */
+static void sim_signal_fences(struct sim_client *c, int target)
+{
+	struct workload *wrk = c->wrk;
+	struct w_step *w;
+
+	for_each_w_step(w, wrk) {
+		struct sim_request *rq = c->rq[w->desc->idx];
+
+		if (w->desc->idx > target)
+			break;
+
+		if (w->desc->type == SW_FENCE && rq && !rq->done)
+			sim_complete(rq);
+	}
+}
+
+static void sim_terminate(struct sim_request *rq)
+{
+	struct sim_engine *engine;
+
+	if (!rq || rq->done || rq->remaining != SIM_UNBOUND)
+		return;
+
+	engine = rq->engine >= 0 ? &sim_engines[rq->engine] : NULL;
+	if (engine && engine->rq == rq)
+		rq->remaining = sim_now - engine->start;
+	else
+		rq->remaining = 0;
+}
+
+/* Returns true if the client has to wait for the request. */
+static bool sim_wait(struct sim_client *c, struct sim_request *rq)
+{
+	if (!rq || rq->done)
+		return false;
+
+	sim_request_assign(&c->wait, rq);
+
+	return true;
+}
+
+static struct sim_request *sim_sync_to(struct sim_client *c, int target)
+{
+	struct workload *wrk = c->wrk;
+
+	if (target < 0)
+		target = wrk->nr_steps + target;
+
+	igt_assert(target < wrk->nr_steps);
+
+	while (wrk->steps[target].desc->type != BATCH) {
+		if (--target < 0)
+			target = wrk->nr_steps + target;
+	}
+
+	return c->rq[target];
+}
+
+static struct sim_request *sim_sync_deps(struct sim_client *c, struct w_step *w)
+{
+	unsigned int i;
+
+	for (i = 0; i < w->desc->nr_data_steps; i++) {
+		struct sim_request *rq = c->rq[w->desc->dep_steps[i]];
+
+		if (rq && !rq->done)
+			return rq;
 	}
 
 	return NULL;
 }
 
+/* Returns false if the client has to wait before completing the batch step. */
+static bool sim_client_batch(struct sim_client *c, struct w_step *w)
+{
+	struct workload *wrk = c->wrk;
+
+	if (!c->submitted) {
+		if ((wrk->flags & FLAG_DEPSYNC) &&
+		    sim_wait(c, sim_sync_deps(c, w)))
+			return false;
+
+		if (c->throttle > 0 &&
+		    sim_wait(c, sim_sync_to(c, w->desc->idx - c->throttle)))
+			return false;
+
+		sim_submit_batch(c, w);
+		c->submitted = true;
+
+		if (w->rq_link.next) {
+			igt_list_del(&w->rq_link);
+			wrk->nrequest[w->request_idx]--;
+		}
+		igt_list_add_tail(&w->rq_link, &wrk->requests[w->request_idx]);
+		wrk->nrequest[w->request_idx]++;
+
+		if (!wrk->run)
+			return true;
+	}
+
+	if (w->desc->sync && sim_wait(c, c->rq[w->desc->idx]))
+		return false;
+
+	if (c->qd_throttle > 0) {
+		while (wrk->nrequest[w->request_idx] > c->qd_throttle) {
+			struct w_step *s;
+
+			s = igt_list_first_entry(&wrk->requests[w->request_idx],
+						 s, rq_link);
+
+			if (sim_wait(c, c->rq[s->desc->idx]))
+				return false;
+
+			igt_list_del(&s->rq_link);
+			wrk->nrequest[w->request_idx]--;
+		}
+	}
+
+	return true;
+}
+
+/* Returns false if the client has to wait before completing the step. */
+static bool sim_client_step(struct sim_client *c, struct w_step *w)
+{
+	const struct w_step_desc *d = w->desc;
+	struct workload *wrk = c->wrk;
+	int elapsed, do_sleep;
+	unsigned int idx;
+
+	switch (d->type) {
+	case BATCH:
+		return sim_client_batch(c, w);
+	case DELAY:
+		c->wake = sim_now + 1000ull * d->delay;
+		break;
+	case PERIOD:
+		if (w->latency)
+			igt_histogram_add(w->latency, sim_now - c->repeat_start);
+		elapsed = (sim_now - c->repeat_start) / 1000;
+		do_sleep = d->period - elapsed;
+		c->time_tot += elapsed;
+		if (elapsed < c->time_min)
+			c->time_min = elapsed;
+		if (elapsed > c->time_max)
+			c->time_max = elapsed;
+		if (do_sleep < 0) {
+			c->missed++;
+			if (verbose > 2)
+				printf("%u: Dropped period @ %u/%u (%dus late)!\n",
+				       wrk->id, c->count, d->idx, do_sleep);
+			break;
+		}
+		c->wake = sim_now + 1000ull * do_sleep;
+		break;
+	case SYNC:
+		idx = d->idx + d->target;
+		igt_assert(idx < d->idx);
+		igt_assert(wrk->steps[idx].desc->type == BATCH);
+		sim_wait(c, c->rq[idx]);
+		break;
+	case THROTTLE:
+		c->throttle = d->throttle;
+		break;
+	case QD_THROTTLE:
+		c->qd_throttle = d->throttle;
+		break;
+	case SW_FENCE:
+		sim_request_submit(sim_request_create(c, w, 0));
+		break;
+	case SW_FENCE_SIGNAL:
+		idx = d->idx + d->target;
+		igt_assert(idx < d->idx);
+		igt_assert(wrk->steps[idx].desc->type == SW_FENCE);
+		sim_signal_fences(c, idx);
+		break;
+	case CTX_PRIORITY:
+		wrk->ctx_list[d->context].priority = d->priority;
+		break;
+	case TERMINATE:
+		idx = d->idx + d->target;
+		igt_assert(idx < d->idx);
+		igt_assert(wrk->steps[idx].desc->type == BATCH);
+		igt_assert(wrk->steps[idx].desc->duration.unbound);
+		sim_terminate(c->rq[idx]);
+		break;
+	default:
+		/* No action for these at execution time. */
+		break;
+	}
+
+	return true;
+}
+
+static void sim_client_run(struct sim_client *c)
+{
+	struct workload *wrk = c->wrk;
+	struct w_step *w;
+	int i;
+
+	while (!c->finished) {
+		if (c->wait) {
+			if (!c->wait->done)
+				return;
+			sim_request_assign(&c->wait, NULL);
+		}
+
+		if (c->wake > sim_now)
+			return;
+
+		if (c->draining) {
+			for (i = sim_nr_engines; --i >= 0;) {
+				if (!wrk->nrequest[i])
+					continue;
+
+				w = igt_list_last_entry(&wrk->requests[i], w,
+							rq_link);
+				if (sim_wait(c, c->rq[w->desc->idx]))
+					return;
+			}
+
+			c->t_end = sim_now;
+			c->finished = true;
+		} else if (!c->in_iteration) {
+			if (!wrk->run ||
+			    (!wrk->background && c->count >= wrk->repeat)) {
+				c->draining = true;
+				continue;
+			}
+
+			c->in_iteration = true;
+			c->repeat_start = sim_now;
+			c->step = 0;
+		} else if (c->step == wrk->nr_steps ||
+			   (!wrk->run && !c->submitted)) {
+			/* A partial iteration counts, like in run_workload(). */
+			sim_signal_fences(c, wrk->nr_steps);
+			c->in_iteration = false;
+			c->count++;
+		} else if (sim_client_step(c, &wrk->steps[c->step])) {
+			c->submitted = false;
+			c->step++;
+		}
+	}
+}
+
+/* Completes and preempts requests due by now, returns true on any change. */
+static bool sim_retire(void)
+{
+	bool changed = false;
+	unsigned int e;
+
+	for (e = 0; e < sim_nr_engines; e++) {
+		struct sim_engine *engine = &sim_engines[e];
+		struct sim_request *rq = engine->rq;
+		uint64_t run;
+
+		if (!rq)
+			continue;
+
+		run = sim_now - engine->start;
+		if (rq->remaining != SIM_UNBOUND && run >= rq->remaining) {
+			engine->busy += run;
+			engine->rq = NULL;
+			sim_complete(rq);
+		} else if (engine->preempt && engine->preempt_at <= sim_now) {
+			engine->busy += run;
+			engine->rq = NULL;
+			if (rq->remaining != SIM_UNBOUND)
+				rq->remaining -= run;
+			sim_queue_request(rq);
+		} else {
+			continue;
+		}
+
+		changed = true;
+	}
+
+	return changed;
+}
+
+static void sim_start(struct sim_request *rq, unsigned int e)
+{
+	struct sim_engine *engine = &sim_engines[e];
+
+	igt_list_del(&rq->link);
+	rq->engine = e;
+	engine->rq = rq;
+	engine->start = sim_now;
+	engine->preempt = false;
+
+	if (!rq->started) {
+		struct workload *wrk = rq->step->wrk;
+
+		if (wrk->queue_latency)
+			igt_histogram_add(&wrk->queue_latency[e],
+					  sim_now - rq->ready_ns);
+
+		rq->started = true;
+		sim_signal(rq);
+	}
+}
+
+static void sim_dispatch(void)
+{
+	struct sim_request *rq;
+	unsigned int e;
+
+restart:
+	igt_list_for_each_entry(rq, &sim_queue, link) {
+		for (e = 0; e < sim_nr_engines; e++) {
+			if (rq->engines & (1ull << e) && !sim_engines[e].rq) {
+				sim_start(rq, e);
+				/* Starting can ready bonded requests. */
+				goto restart;
+			}
+		}
+	}
+
+	for (e = 0; e < sim_nr_engines; e++)
+		sim_engines[e].preempt = false;
+
+	if (sim.fifo || !sim.preempt)
+		return;
+
+	/*
+	 * Every engine a queued request could use is busy by now. Pick the
+	 * lowest priority preemptible batch below it to kick off at its next
+	 * arbitration point.
+	 */
+	igt_list_for_each_entry(rq, &sim_queue, link) {
+		struct sim_engine *victim = NULL;
+		uint64_t period;
+
+		for (e = 0; e < sim_nr_engines; e++) {
+			struct sim_engine *engine = &sim_engines[e];
+
+			if (!(rq->engines & (1ull << e)) || engine->preempt ||
+			    !engine->rq->preempt_us ||
+			    engine->rq->prio >= rq->prio)
+				continue;
+
+			if (!victim || engine->rq->prio < victim->rq->prio)
+				victim = engine;
+		}
+
+		if (!victim)
+			continue;
+
+		period = 1000ull * victim->rq->preempt_us;
+		victim->preempt = true;
+		victim->preempt_at = victim->start +
+				     div64_u64_round_up(sim_now - victim->start,
+							period) * period;
+	}
+}
+
+static uint64_t sim_next_event(struct sim_client *c, unsigned int clients)
+{
+	uint64_t next = SIM_UNBOUND;
+	unsigned int i;
+
+	for (i = 0; i < sim_nr_engines; i++) {
+		struct sim_engine *engine = &sim_engines[i];
+
+		if (!engine->rq)
+			continue;
+
+		if (engine->rq->remaining != SIM_UNBOUND)
+			next = min(next, engine->start + engine->rq->remaining);
+		if (engine->preempt)
+			next = min(next, engine->preempt_at);
+	}
+
+	for (i = 0; i < clients; i++)
+		if (!c[i].finished && !c[i].wait && c[i].wake > sim_now)
+			next = min(next, c[i].wake);
+
+	return next;
+}
+
+/*
+ * Runs the clients against the sim model until all of them complete.
+ * Returns the virtual time it took in seconds, or a negative value if the
+ * workloads deadlocked.
+ */
+static double
+simulate_workloads(struct workload **w, unsigned int clients, int master)
+{
+	struct sim_client *c;
+	unsigned int i, finished = 0;
+	double t = -1;
+
+	sim_nr_engines = query_engines()->nr_engines;
+
+	c = calloc(clients, sizeof(*c));
+	igt_assert(c);
+
+	for (i = 0; i < clients; i++) {
+		c[i].wrk = w[i];
+		c[i].rq = calloc(w[i]->nr_steps, sizeof(*c[i].rq));
+		igt_assert(c[i].rq);
+		c[i].timelines = calloc(w[i]->nr_ctxs * (sim_nr_engines + 1),
+					sizeof(*c[i].timelines));
+		igt_assert(c[i].timelines);
+		c[i].throttle = -1;
+		c[i].qd_throttle = -1;
+		c[i].time_min = ULONG_MAX;
+	}
+
+	for (;;) {
+		do {
+			for (i = 0; i < clients; i++) {
+				struct workload *wrk = c[i].wrk;
+
+				if (c[i].finished)
+					continue;
+
+				sim_client_run(&c[i]);
+				if (!c[i].finished)
+					continue;
+
+				finished++;
+				if (wrk->print_stats)
+					print_workload_stats(wrk,
+							     c[i].t_end / 1e9,
+							     c[i].count,
+							     c[i].time_tot,
+							     c[i].time_min,
+							     c[i].time_max,
+							     c[i].missed);
+
+				if (master == i)
+					for (unsigned int j = 0; j < clients; j++)
+						w[j]->run = false;
+			}
+
+			sim_dispatch();
+		} while (sim_retire());
+
+		if (finished == clients) {
+			t = sim_now / 1e9;
+			break;
+		}
+
+		sim_now = sim_next_event(c, clients);
+		if (sim_now == SIM_UNBOUND) {
+			wsim_err("Simulated workloads deadlocked!\n");
+			break;
+		}
+	}
+
+	if (verbose > 1 && t > 0) {
+		for (i = 0; i < sim_nr_engines; i++) {
+			const intel_engine_t *engine = &query_engines()->engines[i];
+
+			if (sim.nr_engines[engine->engine_class] > 1)
+				printf("%s%u",
+				       intel_engine_class_string(engine->engine_class),
+				       engine->engine_instance + 1);
+			else
+				printf("%s",
+				       intel_engine_class_string(engine->engine_class));
+			printf(": %.1f%% busy\n",
+			       100.0 * sim_engines[i].busy / sim_now);
+		}
+	}
+
+	for (i = 0; i < clients; i++) {
+		for (unsigned int j = 0; j < w[i]->nr_steps; j++)
+			sim_request_put(c[i].rq[j]);
+		for (unsigned int j = 0; j < w[i]->nr_ctxs * (sim_nr_engines + 1); j++)
+			sim_request_put(c[i].timelines[j]);
+		sim_request_put(c[i].wait);
+		free(c[i].rq);
+		free(c[i].timelines);
+	}
+	free(c);
+
+	return t;
+}
+
 static void fini_workload(struct workload *wrk)
 {
+	struct w_step *w;
+
+	for_each_w_step(w, wrk) {
+		if (w->latency) {
+			igt_histogram_fini(w->latency);
+			free(w->latency);
+		}
+		free(w->working_set.sizes);
+		free(w->working_set.handles);
+	}
+
+	if (wrk->queue_latency) {
+		for (int i = 0; i < query_engines()->nr_engines; i++)
+			igt_histogram_fini(&wrk->queue_latency[i]);
+		free(wrk->queue_latency);
+	}
+
 	free(wrk->steps);
 	free(wrk);
 }
@@ -2991,6 +4296,25 @@ static void print_help(void)
 "  -L                List GPUs.\n"
 "  -l                List physical engines.\n"
 "  -D <gpu>          One of the GPUs from -L.\n"
+"  --simulate[=<model>]\n"
+"                    Run the workloads in virtual time against a model of the\n"
+"                    engines instead of a device. The model is a comma\n"
+"                    separated list of engine counts per class, like rcs=1,\n"
+"                    bcs=1, vcs=2, vecs=1 and ccs=0 which are the defaults,\n"
+"                    sched=fifo|prio and preempt=0|1 (default prio and 1).\n"
+"  --check           Only parse and validate the workloads, against the engines\n"
+"                    of the --simulate model, without a device. All workloads\n"
+"                    are checked and the exit status is non-zero if any fail.\n"
+"  --latency=<csv|json>\n"
+"                    Print latency percentiles after the run: the frame time\n"
+"                    of period steps, the completion latency of batches as\n"
+"                    seen by the first wait for them (any completion when\n"
+"                    simulating) and, when simulating, the queueing delay per\n"
+"                    engine. Clients running the same workload are also\n"
+"                    merged.\n"
+"  --footprint       Print the active working set of each client before\n"
+"                    running, in total and per engine: the distinct buffers\n"
+"                    the batches depend on and their combined size.\n"
 	);
 }
 
@@ -3007,7 +4331,7 @@ static char *load_workload_descriptor(char *filename)
 		return filename;
 
 	igt_assert(sbuf.st_size < 1024 * 1024); /* Just so. */
-	buf = malloc(sbuf.st_size);
+	buf = malloc(sbuf.st_size + 1);
 	igt_assert(buf);
 
 	infd = open(filename, O_RDONLY);
@@ -3015,7 +4339,12 @@ static char *load_workload_descriptor(char *filename)
 	len = read(infd, buf, sbuf.st_size);
 	igt_assert(len == sbuf.st_size);
 	close(infd);
+	buf[len] = 0;
 
+	/*
+	 * Lines are steps just like the command line step separator (','),
+	 * they are kept so parse errors can be reported by line and column.
+	 */
 	for (i = 0; i < len; i++) {
 		/*
 		 * Lines starting with '#' are skipped.
@@ -3024,17 +4353,12 @@ static char *load_workload_descriptor(char *filename)
 		 */
 		if (buf[i] == '#')
 			in_comment = true;
-		else if (buf[i] == '\n') {
-			buf[i] = ',';
+		else if (buf[i] == '\n')
 			in_comment = false;
-		} else if (in_comment && buf[i] == ',')
+		else if (in_comment && buf[i] == ',')
 			buf[i] = ';';
 	}
 
-	len--;
-	while (buf[len] == ',')
-		buf[len--] = 0;
-
 	return buf;
 }
 
@@ -3080,11 +4404,249 @@ static void list_engines(void)
 	}
 }
 
+static unsigned int latency_rows;
+
+static void print_latency_row(const char *client, int step, const char *type,
+			      const char *engine, const struct igt_histogram *h)
+{
+	static const struct {
+		const char *name;
+		double percentile;
+	} percentiles[] = {
+		{ "p50", 50 }, { "p90", 90 }, { "p99", 99 }, { "p99.9", 99.9 },
+	};
+	unsigned int i;
+
+	if (!igt_histogram_get_count(h))
+		return;
+
+	if (latency_format == LATENCY_CSV) {
+		if (!latency_rows) {
+			printf("client,step,type,engine,count,min_us,mean_us");
+			for (i = 0; i < ARRAY_SIZE(percentiles); i++)
+				printf(",%s_us", percentiles[i].name);
+			printf(",max_us\n");
+		}
+
+		printf("%s,", client);
+		if (step >= 0)
+			printf("%d", step);
+		printf(",%s,%s,%" PRIu64 ",%.3f,%.3f", type, engine,
+		       igt_histogram_get_count(h),
+		       igt_histogram_get_min(h) / 1e3,
+		       igt_histogram_get_mean(h) / 1e3);
+		for (i = 0; i < ARRAY_SIZE(percentiles); i++)
+			printf(",%.3f",
+			       igt_histogram_get_percentile(h, percentiles[i].percentile) / 1e3);
+		printf(",%.3f\n", igt_histogram_get_max(h) / 1e3);
+	} else {
+		printf("%s\t\t{ \"client\": \"%s\", \"step\": ",
+		       latency_rows ? ",\n" : "{\n\t\"latency\": [\n", client);
+		if (step >= 0)
+			printf("%d", step);
+		else
+			printf("null");
+		printf(", \"type\": \"%s\", \"engine\": \"%s\", \"count\": %" PRIu64 ", \"min_us\": %.3f, \"mean_us\": %.3f",
+		       type, engine, igt_histogram_get_count(h),
+		       igt_histogram_get_min(h) / 1e3,
+		       igt_histogram_get_mean(h) / 1e3);
+		for (i = 0; i < ARRAY_SIZE(percentiles); i++)
+			printf(", \"%s_us\": %.3f", percentiles[i].name,
+			       igt_histogram_get_percentile(h, percentiles[i].percentile) / 1e3);
+		printf(", \"max_us\": %.3f }", igt_histogram_get_max(h) / 1e3);
+	}
+
+	latency_rows++;
+}
+
+/*
+ * One row per step and client, followed by the clients merged when they all
+ * run the same workload. Engine queueing delays are only known when
+ * simulating.
+ */
+static void print_latency(struct workload **w, unsigned int clients,
+			  bool cloned)
+{
+	unsigned int nr_engines = query_engines()->nr_engines;
+	struct igt_histogram merged;
+	struct w_step *step;
+	char client[16], buf[16];
+	unsigned int i, e;
+
+	for (i = 0; i < clients; i++) {
+		struct workload *wrk = w[i];
+
+		snprintf(client, sizeof(client), "%u", i);
+
+		for_each_w_step(step, wrk) {
+			if (step->latency)
+				print_latency_row(client, step->desc->idx,
+						  step->desc->type == PERIOD ?
+						  "period" : "batch",
+						  step->desc->type == PERIOD ? "" :
+						  engine_name(&step->engine,
+							      buf, sizeof(buf)),
+						  step->latency);
+		}
+
+		for (e = 0; wrk->queue_latency && e < nr_engines; e++)
+			print_latency_row(client, -1, "queue",
+					  engine_name(&query_engines()->engines[e],
+						      buf, sizeof(buf)),
+					  &wrk->queue_latency[e]);
+	}
+
+	if (clients > 1 && cloned) {
+		for_each_w_step(step, w[0]) {
+			const struct w_step_desc *d = step->desc;
+
+			if (!step->latency)
+				continue;
+
+			igt_histogram_init(&merged, LATENCY_PRECISION,
+					   LATENCY_LIMIT);
+			for (i = 0; i < clients; i++)
+				igt_assert(igt_histogram_merge(&merged,
+							       w[i]->steps[d->idx].latency));
+			print_latency_row("all", d->idx,
+					  d->type == PERIOD ? "period" : "batch",
+					  d->type == PERIOD ? "" :
+					  engine_name(&step->engine, buf, sizeof(buf)),
+					  &merged);
+			igt_histogram_fini(&merged);
+		}
+	}
+
+	for (e = 0; clients > 1 && w[0]->queue_latency && e < nr_engines; e++) {
+		igt_histogram_init(&merged, LATENCY_PRECISION, LATENCY_LIMIT);
+		for (i = 0; i < clients; i++)
+			igt_assert(igt_histogram_merge(&merged,
+						       &w[i]->queue_latency[e]));
+		print_latency_row("all", -1, "queue",
+				  engine_name(&query_engines()->engines[e],
+					      buf, sizeof(buf)),
+				  &merged);
+		igt_histogram_fini(&merged);
+	}
+
+	if (latency_format == LATENCY_JSON)
+		printf(latency_rows ? "\n\t]\n}\n" : "{\n\t\"latency\": [ ]\n}\n");
+}
+
+/*
+ * Engine model for --simulate, a comma separated list of engine counts per
+ * class (rcs=<n>, bcs=<n>, ...), sched=fifo|prio and preempt=0|1.
+ */
+static int parse_sim_model(const char *str)
+{
+	char *model = strdup(str);
+	char *token, *tctx = NULL, *tstart = model;
+	unsigned int total = 0, i;
+	int ret = 0;
+
+	igt_assert(model);
+
+	while ((token = strtok_r(tstart, ",", &tctx))) {
+		char *value = strchr(token, '=');
+		intel_engine_t engine;
+		char *end;
+		long n;
+
+		tstart = NULL;
+
+		if (!value) {
+			ret = -1;
+			break;
+		}
+		*value++ = 0;
+
+		engine = str_to_engine(token);
+		if (is_valid_engine(&engine) &&
+		    engine.engine_class != DEFAULT_ID &&
+		    engine.engine_instance == DEFAULT_ID) {
+			n = strtol(value, &end, 10);
+			if (end == value || *end || n < 0 ||
+			    n > SIM_MAX_ENGINES) {
+				ret = -1;
+				break;
+			}
+			sim.nr_engines[engine.engine_class] = n;
+		} else if (!strcmp(token, "sched") &&
+			   (!strcmp(value, "fifo") || !strcmp(value, "prio"))) {
+			sim.fifo = !strcmp(value, "fifo");
+		} else if (!strcmp(token, "preempt") &&
+			   (!strcmp(value, "0") || !strcmp(value, "1"))) {
+			sim.preempt = value[0] == '1';
+		} else {
+			ret = -1;
+			break;
+		}
+	}
+
+	free(model);
+
+	for (i = 0; i < NUM_ENGINE_CLASSES; i++)
+		total += sim.nr_engines[i];
+	if (!total || total > SIM_MAX_ENGINES)
+		ret = -1;
+
+	return ret;
+}
+
+/*
+ * Parses and prepares each workload against the simulated engines without
+ * running it, carrying on after failures so all invalid workloads are listed.
+ */
+static unsigned int check_workloads(struct w_arg *w_args,
+				    unsigned int nr_w_args,
+				    struct workload *app_w, unsigned int flags)
+{
+	unsigned int i, failed = 0;
+
+	for (i = 0; i < nr_w_args; i++) {
+		struct workload *wrk, *w;
+		bool ok = false;
+
+		w_args[i].desc = load_workload_descriptor(w_args[i].filename);
+		wrk = parse_workload(&w_args[i], flags, 1.0, 1.0, app_w);
+		if (wrk) {
+			w = clone_workload(wrk);
+			w->flags = flags;
+			ok = !prepare_workload(i, w);
+			fini_workload(w);
+			free_plan(wrk->plan);
+			fini_workload(wrk);
+		}
+
+		if (verbose)
+			printf("%s: %s\n", w_args[i].filename,
+			       ok ? "OK" : "FAILED");
+		failed += !ok;
+	}
+
+	return failed;
+}
+
+enum {
+	OPT_SIMULATE = 256,
+	OPT_LATENCY,
+	OPT_CHECK,
+	OPT_FOOTPRINT,
+};
+
 int main(int argc, char **argv)
 {
+	static const struct option long_options[] = {
+		{ "simulate", optional_argument, NULL, OPT_SIMULATE },
+		{ "latency", required_argument, NULL, OPT_LATENCY },
+		{ "check", no_argument, NULL, OPT_CHECK },
+		{ "footprint", no_argument, NULL, OPT_FOOTPRINT },
+		{ }
+	};
 	struct igt_device_card card = { };
 	bool list_devices_arg = false;
 	bool list_engines_arg = false;
+	bool check_only = false;
 	unsigned int repeat = 1;
 	unsigned int clients = 1;
 	unsigned int flags = 0;
@@ -3106,9 +4668,34 @@ int main(int argc, char **argv)
 
 	master_prng = time(NULL);
 
-	while ((c = getopt(argc, argv,
-			   "LlhqvsSdc:r:w:W:a:p:I:f:F:D:")) != -1) {
+	while ((c = getopt_long(argc, argv, "LlhqvsSdc:r:w:W:a:p:I:f:F:D:",
+				long_options, NULL)) != -1) {
 		switch (c) {
+		case OPT_SIMULATE:
+			sim.enabled = true;
+			if (optarg && parse_sim_model(optarg)) {
+				wsim_err("Invalid simulation model '%s'!\n",
+					 optarg);
+				goto err;
+			}
+			break;
+		case OPT_LATENCY:
+			if (!strcmp(optarg, "csv")) {
+				latency_format = LATENCY_CSV;
+			} else if (!strcmp(optarg, "json")) {
+				latency_format = LATENCY_JSON;
+			} else {
+				wsim_err("Invalid latency format '%s'!\n",
+					 optarg);
+				goto err;
+			}
+			break;
+		case OPT_CHECK:
+			check_only = true;
+			break;
+		case OPT_FOOTPRINT:
+			footprint = true;
+			break;
 		case 'L':
 			list_devices_arg = true;
 			break;
@@ -3178,6 +4765,19 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* Workloads are checked against the simulated engines. */
+	if (check_only)
+		sim.enabled = true;
+
+	if (sim.enabled) {
+		if (device_arg || list_devices_arg) {
+			wsim_err("Simulation does not use a device!\n");
+			free(device_arg);
+			return EXIT_FAILURE;
+		}
+		goto engines;
+	}
+
 	igt_devices_scan();
 
 	if (list_devices_arg) {
@@ -3235,6 +4835,7 @@ int main(int argc, char **argv)
 	if (is_xe)
 		xe_device_get(fd);
 
+engines:
 	if (list_engines_arg) {
 		list_engines();
 		goto out;
@@ -3245,21 +4846,19 @@ int main(int argc, char **argv)
 		goto err;
 	}
 
-	if (nr_w_args > 1 && clients > 1) {
+	if (nr_w_args > 1 && clients > 1 && !check_only) {
 		wsim_err("Cloned clients cannot be combined with multiple workloads!\n");
 		goto err;
 	}
 
 	if (append_workload_arg) {
-		append_workload_arg = load_workload_descriptor(append_workload_arg);
-		if (!append_workload_arg) {
+		struct w_arg arg = { append_workload_arg, NULL, 0 };
+
+		arg.desc = load_workload_descriptor(append_workload_arg);
+		if (!arg.desc) {
 			wsim_err("Failed to load append workload descriptor!\n");
 			goto err;
 		}
-	}
-
-	if (append_workload_arg) {
-		struct w_arg arg = { NULL, append_workload_arg, 0 };
 
 		app_w = parse_workload(&arg, flags, scale_dur, scale_time,
 				       NULL);
@@ -3269,6 +4868,12 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (check_only) {
+		if (check_workloads(w_args, nr_w_args, app_w, flags))
+			goto err;
+		goto out;
+	}
+
 	wrk = calloc(nr_w_args, sizeof(*wrk));
 	igt_assert(wrk);
 
@@ -3320,6 +4925,13 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (sim.enabled) {
+		t = simulate_workloads(w, clients, master_workload);
+		if (t < 0)
+			goto err;
+		goto stats;
+	}
+
 	clock_gettime(CLOCK_MONOTONIC, &t_start);
 
 	for (i = 0; i < clients; i++) {
@@ -3345,15 +4957,21 @@ int main(int argc, char **argv)
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
 	t = elapsed(&t_start, &t_end);
+stats:
 	if (verbose)
 		printf("%.3fs elapsed (%.3f workloads/s)\n",
 		       t, clients * repeat / t);
 
+	if (latency_format != LATENCY_NONE)
+		print_latency(w, clients, nr_w_args == 1);
+
 	for (i = 0; i < clients; i++)
 		fini_workload(w[i]);
 	free(w);
-	for (i = 0; i < nr_w_args; i++)
+	for (i = 0; i < nr_w_args; i++) {
+		free_plan(wrk[i]->plan);
 		fini_workload(wrk[i]);
+	}
 	free(w_args);
 
 out:
@@ -0,0 +1,320 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * CPU only benchmark of the OA report accumulation, reporting millions of
+ * report pairs per second for the pair at a time intel_perf_accumulate_reports()
+ * and every intel_perf_accumulate_reports_n() implementation available on
+ * this machine. Runs over an i915-perf-recorder file, or over random
+ * reports of the requested format.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <i915_drm.h>
+
+#include "i915/perf.h"
+#include "i915/perf_data_reader.h"
+#include "igt_benchmark.h"
+
+#define REPORT_SIZE 256
+
+static const struct {
+	const char *name;
+	uint64_t format;
+} formats[] = {
+	{ "a24u40", I915_OA_FORMAT_A24u40_A14u32_B8_C8 },
+	{ "a32u40", I915_OA_FORMAT_A32u40_A4u32_B8_C8 },
+	{ "a45", I915_OA_FORMAT_A45_B8_C8 },
+	{ "mpec8", I915_OAM_FORMAT_MPEC8u32_B8_C8 },
+};
+
+static double elapsed(const struct timespec *start,
+		      const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + 1e-9*(end->tv_nsec - start->tv_nsec);
+}
+
+struct measure {
+	const struct intel_perf_accumulate_impl *impl; /* NULL for pairs */
+	const struct intel_perf *perf;
+	const struct intel_perf_metric_set *metric_set;
+	const struct drm_i915_perf_record_header **records;
+	struct intel_perf_deltas *deltas;
+	uint32_t n_deltas;
+	double duration;
+};
+
+static double measure_pairs(const struct intel_perf *perf,
+			    const struct intel_perf_metric_set *metric_set,
+			    const struct drm_i915_perf_record_header **records,
+			    uint32_t n_deltas, double duration)
+{
+	struct intel_perf_accumulator acc;
+	struct timespec start, end;
+	unsigned long loops = 0;
+	uint64_t sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (uint32_t i = 0; i < n_deltas; i++) {
+			intel_perf_accumulate_reports(&acc, perf, metric_set,
+						      records[i], records[i + 1]);
+			sum += acc.deltas[1];
+		}
+		loops++;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+	} while (elapsed(&start, &end) < duration);
+
+	/* Keep the accumulation alive */
+	if (sum == 1)
+		printf(" ");
+
+	return 1e-6 * n_deltas * loops / elapsed(&start, &end);
+}
+
+static double measure_batch(const struct intel_perf_accumulate_impl *impl,
+			    const struct intel_perf *perf,
+			    const struct intel_perf_metric_set *metric_set,
+			    const struct drm_i915_perf_record_header **records,
+			    struct intel_perf_deltas *deltas,
+			    uint32_t n_deltas, double duration)
+{
+	struct timespec start, end;
+	unsigned long loops = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		impl->accumulate(deltas, perf, metric_set, records, n_deltas);
+		loops++;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+	} while (elapsed(&start, &end) < duration);
+
+	return 1e-6 * n_deltas * loops / elapsed(&start, &end);
+}
+
+static double measure(void *data)
+{
+	const struct measure *m = data;
+
+	if (!m->impl)
+		return measure_pairs(m->perf, m->metric_set, m->records,
+				     m->n_deltas, m->duration);
+
+	return measure_batch(m->impl, m->perf, m->metric_set, m->records,
+			     m->deltas, m->n_deltas, m->duration);
+}
+
+static bool check_batch(const struct intel_perf *perf,
+			const struct intel_perf_metric_set *metric_set,
+			const struct drm_i915_perf_record_header **records,
+			const struct intel_perf_deltas *deltas,
+			uint32_t n_deltas)
+{
+	for (uint32_t i = 0; i < n_deltas; i++) {
+		struct intel_perf_accumulator expected, acc;
+
+		intel_perf_accumulate_reports(&expected, perf, metric_set,
+					      records[i], records[i + 1]);
+		intel_perf_deltas_get(deltas, i, &acc);
+		if (memcmp(&expected, &acc, sizeof(acc)))
+			return false;
+	}
+
+	return true;
+}
+
+static const struct drm_i915_perf_record_header **
+synthesize(uint32_t n_records, uint8_t **data)
+{
+	const size_t record_size = sizeof(struct drm_i915_perf_record_header) + REPORT_SIZE;
+	const struct drm_i915_perf_record_header **records;
+
+	*data = malloc(record_size * n_records);
+	records = malloc(sizeof(*records) * n_records);
+	if (!*data || !records)
+		return NULL;
+
+	for (size_t i = 0; i < record_size * n_records; i++)
+		(*data)[i] = random();
+
+	for (uint32_t i = 0; i < n_records; i++) {
+		struct drm_i915_perf_record_header *header =
+			(void *)(*data + i * record_size);
+
+		header->type = DRM_I915_PERF_RECORD_SAMPLE;
+		header->size = record_size;
+		records[i] = header;
+	}
+
+	return records;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		IGT_BENCHMARK_LONG_OPTIONS,
+		{ }
+	};
+	static struct intel_perf_metric_set synthetic_metric_set;
+	static struct intel_perf synthetic_perf;
+	const struct drm_i915_perf_record_header **records;
+	const struct intel_perf_metric_set *metric_set;
+	const struct intel_perf_accumulate_impl *impl;
+	const struct igt_benchmark_result *r;
+	struct intel_perf_data_reader reader;
+	struct intel_perf_deltas deltas = {};
+	const struct intel_perf *perf;
+	struct igt_benchmark *b;
+	struct measure m;
+	const char *path = NULL;
+	uint32_t n_records = 100000;
+	uint8_t *data = NULL;
+	double duration = .2;
+	int format = 0;
+	int fd = -1;
+	int c;
+
+	b = igt_benchmark_create("i915_perf_accumulate");
+	if (!b)
+		return 1;
+
+	while ((c = getopt_long(argc, argv, "f:F:n:t:", options, NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'F':
+			for (format = 0; format < sizeof(formats) / sizeof(formats[0]); format++)
+				if (!strcmp(optarg, formats[format].name))
+					break;
+			if (format == sizeof(formats) / sizeof(formats[0])) {
+				fprintf(stderr, "Unknown report format %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n':
+			n_records = atoi(optarg);
+			break;
+		case 't':
+			duration = atof(optarg);
+			break;
+		default:
+			if (!igt_benchmark_option(b, c, optarg))
+				break;
+
+			fprintf(stderr,
+				"usage: %s [-f recording | -F a24u40|a32u40|a45|mpec8 -n reports]"
+				" [-t seconds]\n"
+				"  -t  seconds of each sample, default 0.2\n"
+				IGT_BENCHMARK_USAGE,
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (path) {
+		fd = open(path, O_RDONLY);
+		if (fd < 0 || !intel_perf_data_reader_init(&reader, fd)) {
+			fprintf(stderr, "Unable to load %s: %s\n", path,
+				fd < 0 ? "cannot open" : reader.error_msg);
+			return 1;
+		}
+
+		perf = reader.perf;
+		metric_set = reader.metric_set;
+		records = reader.records;
+		n_records = reader.n_records;
+		printf("%s: %u reports, metric set %s\n",
+		       path, n_records, metric_set->symbol_name);
+		igt_benchmark_param(b, "recording", "%s", path);
+		igt_benchmark_param(b, "metric_set", "%s",
+				    metric_set->symbol_name);
+	} else {
+		synthetic_metric_set.perf_oa_format = formats[format].format;
+		perf = &synthetic_perf;
+		metric_set = &synthetic_metric_set;
+		records = synthesize(n_records, &data);
+		if (!records)
+			return 1;
+		printf("%u random %s reports\n", n_records, formats[format].name);
+		igt_benchmark_param(b, "format", "%s", formats[format].name);
+	}
+	igt_benchmark_param(b, "reports", "%u", n_records);
+	igt_benchmark_param(b, "seconds", "%g", duration);
+
+	if (n_records < 2)
+		return 1;
+
+	deltas.stride = n_records - 1;
+	deltas.deltas = malloc(sizeof(*deltas.deltas) *
+			       INTEL_PERF_MAX_RAW_OA_COUNTERS * deltas.stride);
+	if (!deltas.deltas)
+		return 1;
+
+	m = (struct measure){
+		.perf = perf,
+		.metric_set = metric_set,
+		.records = records,
+		.deltas = &deltas,
+		.n_deltas = deltas.stride,
+		.duration = duration,
+	};
+	r = igt_benchmark_run(b, "pairs", "Mreports/s", true, measure, &m);
+	if (!r)
+		return 1;
+
+	printf("%-8s %9.2f Mreports/s\n", "pairs", r->median);
+
+	for (unsigned int i = 0; (impl = intel_perf_accumulate_impl_get(i)); i++) {
+		m.impl = impl;
+		r = igt_benchmark_run(b, impl->name, "Mreports/s", true,
+				      measure, &m);
+		if (!r)
+			return 1;
+
+		printf("%-8s %9.2f Mreports/s%s\n", impl->name, r->median,
+		       check_batch(perf, metric_set, records, &deltas, deltas.stride) ?
+		       "" : " MISMATCH");
+	}
+
+	free(deltas.deltas);
+	if (path) {
+		intel_perf_data_reader_fini(&reader);
+		close(fd);
+	} else {
+		free(records);
+		free(data);
+	}
+
+	return igt_benchmark_finish(b) ? 1 : 0;
+}
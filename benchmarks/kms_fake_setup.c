@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/*
+ * CPU only benchmark of the overhead of igt_kms and igt_fb, replaying a
+ * recorded KMS device with igt_kms_fake: display setup, building and
+ * checking atomic requests, commits and framebuffer creation.
+ */
+
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+
+#include "igt.h"
+#include "igt_benchmark.h"
+#include "igt_kms_fake.h"
+
+struct bench {
+	int fd;
+	unsigned int loops;
+	igt_display_t display;
+	igt_output_t *output;
+	igt_plane_t *primary;
+	drmModeModeInfo mode;
+	struct igt_fb fb;
+	int x;
+};
+
+static struct igt_benchmark *benchmark;
+static const char *recording;
+static const char *record_to;
+static unsigned int loops = 100;
+static uint64_t commit_ns;
+
+static double elapsed(const struct timespec *start,
+		      const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+	       1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+/* Returns the time of a loop of @fn, in microseconds */
+static double time_loops(struct bench *b, void (*fn)(struct bench *b))
+{
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned int i = 0; i < b->loops; i++)
+		fn(b);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return 1e6 * elapsed(&start, &end) / b->loops;
+}
+
+static void display_require(struct bench *b)
+{
+	igt_display_t display;
+
+	igt_display_require(&display, b->fd);
+	igt_display_fini(&display);
+}
+
+static double measure_display_require(void *data)
+{
+	return time_loops(data, display_require);
+}
+
+/* Moves the plane so that every request carries a change */
+static void move_plane(struct bench *b)
+{
+	b->x = !b->x;
+	igt_plane_set_position(b->primary, b->x, 0);
+}
+
+static void test_commit(struct bench *b)
+{
+	int ret;
+
+	move_plane(b);
+	ret = igt_display_try_commit_atomic(&b->display,
+					    DRM_MODE_ATOMIC_TEST_ONLY |
+					    DRM_MODE_ATOMIC_ALLOW_MODESET,
+					    NULL);
+	igt_assert_eq(ret, 0);
+}
+
+static double measure_test_commit(void *data)
+{
+	return time_loops(data, test_commit);
+}
+
+static void commit(struct bench *b)
+{
+	move_plane(b);
+	igt_display_commit2(&b->display, COMMIT_ATOMIC);
+}
+
+static double measure_commit(void *data)
+{
+	return time_loops(data, commit);
+}
+
+static void create_fb(struct bench *b)
+{
+	struct igt_fb fb;
+
+	igt_create_fb(b->fd, b->mode.hdisplay, b->mode.vdisplay,
+		      DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR, &fb);
+	igt_remove_fb(b->fd, &fb);
+}
+
+static double measure_create_fb(void *data)
+{
+	return time_loops(data, create_fb);
+}
+
+static void setup(struct bench *b)
+{
+	enum pipe pipe;
+
+	igt_display_require(&b->display, b->fd);
+	igt_require(b->display.is_atomic);
+	igt_display_require_output(&b->display);
+	igt_display_reset(&b->display);
+
+	for_each_pipe_with_valid_output(&b->display, pipe, b->output)
+		break;
+
+	igt_output_set_pipe(b->output, pipe);
+	b->mode = *igt_output_get_mode(b->output);
+	b->primary = igt_output_get_plane_type(b->output,
+					       DRM_PLANE_TYPE_PRIMARY);
+
+	igt_create_fb(b->fd, b->mode.hdisplay, b->mode.vdisplay,
+		      DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR, &b->fb);
+	igt_plane_set_fb(b->primary, &b->fb);
+	igt_display_commit2(&b->display, COMMIT_ATOMIC);
+}
+
+static void run(const char *name, double (*fn)(void *data), struct bench *b)
+{
+	const struct igt_benchmark_result *r;
+
+	r = igt_benchmark_run(benchmark, name, "us", false, fn, b);
+	igt_assert(r);
+
+	igt_info("%-16s %9.2f us\n", name, r->median);
+}
+
+static struct igt_benchmark *get_benchmark(void)
+{
+	if (!benchmark)
+		benchmark = igt_benchmark_create("kms_fake_setup");
+
+	return benchmark;
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	switch (opt) {
+	case 'f':
+		recording = optarg;
+		break;
+	case 'R':
+		record_to = optarg;
+		break;
+	case 'n':
+		loops = atoi(optarg);
+		break;
+	case 'l':
+		commit_ns = strtoull(optarg, NULL, 0) * NSEC_PER_USEC;
+		break;
+	default:
+		if (!get_benchmark() ||
+		    igt_benchmark_option(benchmark, opt, optarg))
+			return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const struct option long_opts[] = {
+	{ "recording", required_argument, NULL, 'f' },
+	{ "record", required_argument, NULL, 'R' },
+	{ "loops", required_argument, NULL, 'n' },
+	{ "latency", required_argument, NULL, 'l' },
+	IGT_BENCHMARK_LONG_OPTIONS,
+	{ }
+};
+
+static const char help_str[] =
+	"  -f, --recording=<file>  replay a device recorded with --record\n"
+	"  -R, --record=<file>     record the KMS device and exit\n"
+	"  -n, --loops=<n>         operations per sample, default 100\n"
+	"  -l, --latency=<us>      time taken by every commit, default 0\n"
+	IGT_BENCHMARK_USAGE;
+
+igt_simple_main_args("f:R:n:l:", long_opts, help_str, opt_handler, NULL)
+{
+	struct igt_kms_fake_opts opts = { };
+	struct bench b = { };
+
+	igt_assert(get_benchmark());
+
+	if (record_to) {
+		int fd = drm_open_driver_master(DRIVER_ANY);
+
+		igt_assert_eq(igt_kms_fake_record(fd, record_to), 0);
+		drm_close_driver(fd);
+		return;
+	}
+
+	igt_require_f(recording, "No recording given, see --help\n");
+	igt_require(loops);
+
+	opts.commit_ns = commit_ns;
+	b.fd = igt_kms_fake_open(recording, &opts);
+	igt_assert_f(b.fd >= 0, "Failed to load %s: %s\n",
+		     recording, strerror(-b.fd));
+	b.loops = loops;
+
+	igt_benchmark_param(benchmark, "recording", "%s", recording);
+	igt_benchmark_param(benchmark, "loops", "%u", loops);
+	igt_benchmark_param(benchmark, "latency_ns", "%" PRIu64, commit_ns);
+
+	run("display-require", measure_display_require, &b);
+
+	setup(&b);
+	run("test-commit", measure_test_commit, &b);
+	run("commit", measure_commit, &b);
+	run("create-fb", measure_create_fb, &b);
+
+	igt_remove_fb(b.fd, &b.fb);
+	igt_display_fini(&b.display);
+	igt_kms_fake_close(b.fd);
+
+	igt_assert_eq(igt_benchmark_finish(benchmark), 0);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * CPU only benchmark of the 16 bpc RGB <-> float framebuffer conversion
+ * kernels used by igt_fb, reporting MPix/s for every kernel set available
+ * on this machine.
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "igt_benchmark.h"
+#include "igt_halffloat.h"
+
+static double elapsed(const struct timespec *start,
+		      const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + 1e-9*(end->tv_nsec - start->tv_nsec);
+}
+
+enum op { HALF_TO_FLOAT, FLOAT_TO_HALF, UINT16_TO_FLOAT, FLOAT_TO_UINT16 };
+
+static const char *op_names[] = {
+	[HALF_TO_FLOAT] = "fp16->float",
+	[FLOAT_TO_HALF] = "float->fp16",
+	[UINT16_TO_FLOAT] = "u16->float",
+	[FLOAT_TO_UINT16] = "float->u16",
+};
+
+static void run_frame(const struct igt_rgbx16_kernels *k, enum op op,
+		      uint16_t *u, float *f,
+		      unsigned int width, unsigned int height, bool swap_rb)
+{
+	for (unsigned int y = 0; y < height; y++) {
+		uint16_t *row16 = u + y * width * 4;
+		float *rowf = f + y * width * 4;
+
+		switch (op) {
+		case HALF_TO_FLOAT:
+			k->half_to_float(row16, rowf, width, swap_rb);
+			break;
+		case FLOAT_TO_HALF:
+			k->float_to_half(rowf, row16, width, swap_rb);
+			break;
+		case UINT16_TO_FLOAT:
+			k->uint16_to_float(row16, rowf, width, swap_rb);
+			break;
+		case FLOAT_TO_UINT16:
+			k->float_to_uint16(rowf, row16, width, swap_rb);
+			break;
+		}
+	}
+}
+
+struct measure {
+	const struct igt_rgbx16_kernels *k;
+	enum op op;
+	uint16_t *u;
+	float *f;
+	unsigned int width, height;
+	bool swap_rb;
+	double duration;
+};
+
+static double measure(void *data)
+{
+	const struct measure *m = data;
+	struct timespec start, end;
+	unsigned long frames = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		run_frame(m->k, m->op, m->u, m->f,
+			  m->width, m->height, m->swap_rb);
+		frames++;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+	} while (elapsed(&start, &end) < m->duration);
+
+	return 1e-6 * m->width * m->height * frames / elapsed(&start, &end);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		IGT_BENCHMARK_LONG_OPTIONS,
+		{ }
+	};
+	struct measure m = {
+		.width = 3840, .height = 2160,
+		.swap_rb = true,
+		.duration = .2,
+	};
+	const struct igt_benchmark_result *r;
+	const struct igt_rgbx16_kernels *k;
+	struct igt_benchmark *b;
+	size_t count;
+	int c;
+
+	b = igt_benchmark_create("rgbx16_convert");
+	if (!b)
+		return 1;
+
+	while ((c = getopt_long(argc, argv, "w:h:t:r", options, NULL)) != -1) {
+		switch (c) {
+		case 'w':
+			m.width = atoi(optarg);
+			break;
+		case 'h':
+			m.height = atoi(optarg);
+			break;
+		case 't':
+			m.duration = atof(optarg);
+			break;
+		case 'r':
+			m.swap_rb = false;
+			break;
+		default:
+			if (!igt_benchmark_option(b, c, optarg))
+				break;
+
+			fprintf(stderr,
+				"usage: %s [-w width] [-h height] [-t seconds] [-r]\n"
+				"  -t  seconds of each sample, default 0.2\n"
+				"  -r  use RGBX channel order (no R/B swap)\n"
+				IGT_BENCHMARK_USAGE,
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!m.width || !m.height)
+		return 1;
+
+	count = (size_t)m.width * m.height * 4;
+	m.u = malloc(count * sizeof(*m.u));
+	m.f = malloc(count * sizeof(*m.f));
+	if (!m.u || !m.f)
+		return 1;
+
+	for (size_t i = 0; i < count; i++)
+		m.f[i] = (i % 1021) / 1020.0f;
+
+	igt_benchmark_param(b, "width", "%u", m.width);
+	igt_benchmark_param(b, "height", "%u", m.height);
+	igt_benchmark_param(b, "order", "%s", m.swap_rb ? "BGRX" : "RGBX");
+	igt_benchmark_param(b, "seconds", "%g", m.duration);
+
+	printf("%ux%u, %s\n", m.width, m.height, m.swap_rb ? "BGRX" : "RGBX");
+	for (unsigned int i = 0; (k = igt_rgbx16_kernels_get(i)); i++) {
+		m.k = k;
+		for (m.op = HALF_TO_FLOAT; m.op <= FLOAT_TO_UINT16; m.op++) {
+			char name[64];
+
+			/* Seed the 16 bpc frame with sane values for each op */
+			if (m.op == HALF_TO_FLOAT)
+				k->float_to_half(m.f, m.u, count / 4, false);
+			else if (m.op == UINT16_TO_FLOAT)
+				k->float_to_uint16(m.f, m.u, count / 4, false);
+
+			snprintf(name, sizeof(name), "%s/%s",
+				 k->name, op_names[m.op]);
+			r = igt_benchmark_run(b, name, "MPix/s", true,
+					      measure, &m);
+			if (!r)
+				return 1;
+
+			printf("%-8s %-12s %9.1f MPix/s\n",
+			       k->name, op_names[m.op], r->median);
+		}
+	}
+
+	free(m.f);
+	free(m.u);
+
+	return igt_benchmark_finish(b) ? 1 : 0;
+}
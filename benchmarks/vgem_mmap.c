@@ -22,6 +22,7 @@
  *
  */
 
+#include <getopt.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -36,108 +37,183 @@
 #include <time.h>
 
 #include "igt.h"
+#include "igt_benchmark.h"
 #include "igt_vgem.h"
 
+enum dir { READ, WRITE, CLEAR, FAULT };
+
+static const char * const dir_names[] = {
+	[READ] = "read",
+	[WRITE] = "write",
+	[CLEAR] = "clear",
+	[FAULT] = "fault",
+};
+
+struct measure {
+	enum dir dir;
+	int vgem;
+	struct vgem_bo bo;
+	void *ptr, *src, *dst;
+	int loops;
+	bool print; /* each sample, as ezbench expects from -r */
+};
+
 static double elapsed(const struct timespec *start,
 		      const struct timespec *end)
 {
 	return (end->tv_sec - start->tv_sec) + 1e-9*(end->tv_nsec - start->tv_nsec);
 }
 
+static void run(struct measure *m)
+{
+	int page;
+
+	switch (m->dir) {
+	case CLEAR:
+		memset(m->dst, 0, m->bo.size);
+		break;
+	case FAULT:
+		munmap(m->ptr, m->bo.size);
+		m->ptr = vgem_mmap(m->vgem, &m->bo, PROT_WRITE);
+		for (page = 0; page < m->bo.size; page += 4096) {
+			uint32_t *x = (uint32_t *)m->ptr + page/4;
+			__asm__ __volatile__("": : :"memory");
+			page += *x; /* should be zero! */
+		}
+		break;
+	default:
+		memcpy(m->dst, m->src, m->bo.size);
+		break;
+	}
+}
+
+static double measure(void *data)
+{
+	struct measure *m = data;
+	struct timespec start, end;
+	double rate;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int c = 0; c < m->loops; c++)
+		run(m);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rate = m->bo.size / elapsed(&start, &end) * m->loops / (1024*1024);
+	if (m->print)
+		printf("%7.3f\n", rate);
+
+	return rate;
+}
+
 int main(int argc, char **argv)
 {
-	enum dir {READ, WRITE, CLEAR, FAULT} dir = READ;
+	static const struct option options[] = {
+		IGT_BENCHMARK_LONG_OPTIONS,
+		{ }
+	};
+	struct measure m = { .dir = READ };
+	const struct igt_benchmark_result *r;
 	struct timespec start, end;
-	struct vgem_bo bo;
+	struct igt_benchmark *b;
+	double duration = -1;
 	void *buf;
-	void *ptr, *src, *dst;
-	int reps = 1;
-	int loops;
-	int vgem;
 	int c;
 
-	while ((c = getopt (argc, argv, "d:r:")) != -1) {
+	b = igt_benchmark_create("vgem_mmap");
+	if (!b)
+		return 1;
+
+	while ((c = getopt_long(argc, argv, "d:r:t:", options, NULL)) != -1) {
 		switch (c) {
 		case 'd':
 			if (strcmp(optarg, "read") == 0)
-				dir = READ;
+				m.dir = READ;
 			else if (strcmp(optarg, "write") == 0)
-				dir = WRITE;
+				m.dir = WRITE;
 			else if (strcmp(optarg, "clear") == 0)
-				dir = CLEAR;
+				m.dir = CLEAR;
 			else if (strcmp(optarg, "fault") == 0)
-				dir = FAULT;
+				m.dir = FAULT;
 			else
 				abort();
 			break;
 
 		case 'r':
-			reps = atoi(optarg);
-			if (reps < 1)
-				reps = 1;
+			/* Kept from before the harness for ezbench */
+			if (igt_benchmark_option(b, IGT_BENCHMARK_OPT_REPEAT,
+						 optarg))
+				return 1;
+			m.print = true;
 			break;
 
-		default:
+		case 't':
+			duration = atof(optarg);
 			break;
+
+		default:
+			if (!igt_benchmark_option(b, c, optarg))
+				break;
+
+			fprintf(stderr,
+				"usage: %s [-d read|write|clear|fault] [-t seconds] [-r reps]\n"
+				"  -t  seconds of each sample, default 0.4, or 2 with -r\n"
+				"  -r  print each of <reps> samples rather than their\n"
+				"      median, without warm-up\n"
+				IGT_BENCHMARK_USAGE,
+				argv[0]);
+			return 1;
 		}
 	}
 
-	vgem = drm_open_driver(DRIVER_VGEM);
+	/* -r is what ezbench runs, one line per 2 second repetition */
+	if (duration < 0)
+		duration = m.print ? 2 : .4;
+	if (m.print)
+		igt_benchmark_option(b, IGT_BENCHMARK_OPT_WARMUP, "0");
 
-	bo.width = 2024;
-	bo.height = 2024;
-	bo.bpp = 4;
-	vgem_create(vgem, &bo);
-	ptr = vgem_mmap(vgem, &bo, PROT_WRITE);
-	buf = malloc(bo.size);
+	m.vgem = drm_open_driver(DRIVER_VGEM);
 
-	if (dir == READ) {
-		src = ptr;
-		dst = buf;
+	m.bo.width = 2024;
+	m.bo.height = 2024;
+	m.bo.bpp = 4;
+	vgem_create(m.vgem, &m.bo);
+	m.ptr = vgem_mmap(m.vgem, &m.bo, PROT_WRITE);
+	buf = malloc(m.bo.size);
+
+	if (m.dir == READ) {
+		m.src = m.ptr;
+		m.dst = buf;
 	} else {
-		src = buf;
-		dst = ptr;
+		m.src = buf;
+		m.dst = m.ptr;
 	}
 
 	clock_gettime(CLOCK_MONOTONIC, &start);
-	switch (dir) {
+	switch (m.dir) {
 	case CLEAR:
 	case FAULT:
-		memset(dst, 0, bo.size);
+		memset(m.dst, 0, m.bo.size);
 		break;
 	default:
-		memcpy(dst, src, bo.size);
+		memcpy(m.dst, m.src, m.bo.size);
 		break;
 	}
 	clock_gettime(CLOCK_MONOTONIC, &end);
 
-	loops = 2 / elapsed(&start, &end);
-	while (reps--) {
-		clock_gettime(CLOCK_MONOTONIC, &start);
-		for (c = 0; c < loops; c++) {
-			int page;
+	m.loops = duration / elapsed(&start, &end);
+	if (m.loops < 1)
+		m.loops = 1;
 
-			switch (dir) {
-			case CLEAR:
-				memset(dst, 0, bo.size);
-				break;
-			case FAULT:
-				munmap(ptr, bo.size);
-				ptr = vgem_mmap(vgem, &bo, PROT_WRITE);
-				for (page = 0; page < bo.size; page += 4096) {
-					uint32_t *x = (uint32_t *)ptr + page/4;
-					__asm__ __volatile__("": : :"memory");
-					page += *x; /* should be zero! */
-				}
-				break;
-			default:
-				memcpy(dst, src, bo.size);
-				break;
-			}
-		}
-		clock_gettime(CLOCK_MONOTONIC, &end);
-		printf("%7.3f\n", bo.size / elapsed(&start, &end) * loops / (1024*1024));
-	}
+	igt_benchmark_param(b, "direction", "%s", dir_names[m.dir]);
+	igt_benchmark_param(b, "size", "%"PRIu64, m.bo.size);
+	igt_benchmark_param(b, "loops", "%d", m.loops);
+
+	r = igt_benchmark_run(b, dir_names[m.dir], "MiB/s", true, measure, &m);
+	if (!r)
+		return 1;
+
+	if (!m.print)
+		printf("%7.3f\n", r->median);
 
-	return 0;
+	return igt_benchmark_finish(b) ? 1 : 0;
 }
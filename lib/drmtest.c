@@ -56,6 +56,7 @@
 #include "igt_device.h"
 #include "igt_gt.h"
 #include "igt_kmod.h"
+#include "igt_kms_props.h"
 #include "igt_params.h"
 #include "igt_sysfs.h"
 #include "igt_device_scan.h"
@@ -806,6 +807,9 @@ int __drm_close_driver(int fd)
 	if (is_xe_device(fd))
 		xe_device_put(fd);
 
+	/* The fd number may be reused for another card. */
+	igt_kms_props_invalidate(fd);
+
 	return close(fd);
 }
 
@@ -22,6 +22,8 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -31,6 +33,14 @@
 
 #include "igt.h"
 #include "intel_decode.h"
+#include "intel_decode_cmds.h"
+
+struct intel_decode_counts {
+	uint64_t mi[64];
+	uint64_t blt[128];
+	uint64_t r3d[0x2000];
+	uint64_t unknown;
+};
 
 /* Struct for tracking intel_decode state. */
 struct intel_decode {
@@ -75,13 +85,33 @@ struct intel_decode {
 	bool dump_past_end;
 
 	bool overflowed;
+
+	/** Set when no output file is given, only visit and count commands. */
+	bool quiet;
+
+	/** Optional callback invoked for every decoded command. */
+	intel_decode_visit_fn visit;
+	void *visit_data;
+
+	/** Command counts for intel_decode_print_summary(), or NULL. */
+	struct intel_decode_counts *counts;
+
+	/** @{
+	 * Opcode to table entry lookup, built for the device's gen when the
+	 * context is allocated.  0 means no entry, otherwise index + 1.
+	 */
+	uint8_t mi_index[64];
+	uint8_t blt_index[128];
+	uint8_t r965_index[0x2000];
+	/** @} */
 };
 
-static FILE *out;
-static uint32_t saved_s2 = 0, saved_s4 = 0;
-static char saved_s2_set = 0, saved_s4_set = 0;
-static uint32_t head_offset = 0xffffffff;	/* undefined */
-static uint32_t tail_offset = 0xffffffff;	/* undefined */
+/* Per thread, so that separate contexts can decode concurrently */
+static __thread FILE *out;
+static __thread uint32_t saved_s2 = 0, saved_s4 = 0;
+static __thread char saved_s2_set = 0, saved_s4_set = 0;
+static __thread uint32_t head_offset = 0xffffffff;	/* undefined */
+static __thread uint32_t tail_offset = 0xffffffff;	/* undefined */
 
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(A) (sizeof(A)/sizeof(A[0]))
@@ -112,6 +142,9 @@ instr_out(struct intel_decode *ctx, unsigned int index,
 	const char *parseinfo;
 	uint32_t offset = ctx->hw_offset + index * 4;
 
+	if (ctx->quiet)
+		return;
+
 	if (index > ctx->count) {
 		if (!ctx->overflowed) {
 			fprintf(out, "ERROR: Decode attempted to continue beyond end of batchbuffer\n");
@@ -218,66 +251,52 @@ decode_MI_WAIT_FOR_EVENT(struct intel_decode *ctx)
 	return 1;
 }
 
+struct mi_cmd {
+	uint32_t opcode;
+	int len_mask;
+	unsigned int min_len;
+	unsigned int max_len;
+	const char *name;
+	int (*func)(struct intel_decode *ctx);
+};
+
+#define MI_CMD(_opcode, _len_mask, _min_len, _max_len, _name, _func) \
+	{ _opcode, _len_mask, _min_len, _max_len, _name, _func },
+
+static const struct mi_cmd opcodes_mi[] = {
+	INTEL_DECODE_MI_CMDS(MI_CMD)
+};
+
+static const struct mi_cmd *
+lookup_mi(struct intel_decode *ctx, uint32_t dw0)
+{
+	uint8_t idx = ctx->mi_index[(dw0 & 0x1f800000) >> 23];
+
+	return idx ? &opcodes_mi[idx - 1] : NULL;
+}
+
 static int
 decode_mi(struct intel_decode *ctx)
 {
-	unsigned int opcode, len = -1;
+	unsigned int len = -1;
 	const char *post_sync_op = "";
 	uint32_t *data = ctx->data;
-
-	struct {
-		uint32_t opcode;
-		int len_mask;
-		unsigned int min_len;
-		unsigned int max_len;
-		const char *name;
-		int (*func)(struct intel_decode *ctx);
-	} opcodes_mi[] = {
-		{ 0x08, 0, 1, 1, "MI_ARB_ON_OFF" },
-		{ 0x0a, 0, 1, 1, "MI_BATCH_BUFFER_END" },
-		{ 0x30, 0x3f, 3, 3, "MI_BATCH_BUFFER" },
-		{ 0x31, 0x3f, 2, 3, "MI_BATCH_BUFFER_START" },
-		{ 0x14, 0x3f, 3, 3, "MI_DISPLAY_BUFFER_INFO" },
-		{ 0x04, 0, 1, 1, "MI_FLUSH" },
-		{ 0x22, 0x1f, 3, 3, "MI_LOAD_REGISTER_IMM" },
-		{ 0x13, 0x3f, 2, 2, "MI_LOAD_SCAN_LINES_EXCL" },
-		{ 0x12, 0x3f, 2, 2, "MI_LOAD_SCAN_LINES_INCL" },
-		{ 0x00, 0, 1, 1, "MI_NOOP" },
-		{ 0x11, 0x3f, 2, 2, "MI_OVERLAY_FLIP" },
-		{ 0x07, 0, 1, 1, "MI_REPORT_HEAD" },
-		{ 0x18, 0x3f, 2, 2, "MI_SET_CONTEXT", decode_MI_SET_CONTEXT },
-		{ 0x20, 0x3f, 3, 4, "MI_STORE_DATA_IMM" },
-		{ 0x21, 0x3f, 3, 4, "MI_STORE_DATA_INDEX" },
-		{ 0x24, 0x3f, 3, 3, "MI_STORE_REGISTER_MEM" },
-		{ 0x02, 0, 1, 1, "MI_USER_INTERRUPT" },
-		{ 0x03, 0, 1, 1, "MI_WAIT_FOR_EVENT", decode_MI_WAIT_FOR_EVENT },
-		{ 0x16, 0x7f, 3, 3, "MI_SEMAPHORE_MBOX" },
-		{ 0x26, 0x1f, 3, 4, "MI_FLUSH_DW" },
-		{ 0x28, 0x3f, 3, 3, "MI_REPORT_PERF_COUNT" },
-		{ 0x29, 0xff, 3, 3, "MI_LOAD_REGISTER_MEM" },
-		{ 0x0b, 0, 1, 1, "MI_SUSPEND_FLUSH"},
-		{ 0x05, 0, 1, 1, "MI_ARB_CHECK"},
-	}, *opcode_mi = NULL;
+	const struct mi_cmd *opcode_mi;
 
 	/* check instruction length */
-	for (opcode = 0; opcode < sizeof(opcodes_mi) / sizeof(opcodes_mi[0]);
-	     opcode++) {
-		if ((data[0] & 0x1f800000) >> 23 == opcodes_mi[opcode].opcode) {
-			len = 1;
-			if (opcodes_mi[opcode].max_len > 1) {
-				len =
-				    (data[0] & opcodes_mi[opcode].len_mask) + 2;
-				if (len < opcodes_mi[opcode].min_len
-				    || len > opcodes_mi[opcode].max_len) {
-					fprintf(out,
-						"Bad length (%d) in %s, [%d, %d]\n",
-						len, opcodes_mi[opcode].name,
-						opcodes_mi[opcode].min_len,
-						opcodes_mi[opcode].max_len);
-				}
+	opcode_mi = lookup_mi(ctx, data[0]);
+	if (opcode_mi) {
+		len = 1;
+		if (opcode_mi->max_len > 1) {
+			len = (data[0] & opcode_mi->len_mask) + 2;
+			if (len < opcode_mi->min_len ||
+			    len > opcode_mi->max_len) {
+				fprintf(out,
+					"Bad length (%d) in %s, [%d, %d]\n",
+					len, opcode_mi->name,
+					opcode_mi->min_len,
+					opcode_mi->max_len);
 			}
-			opcode_mi = &opcodes_mi[opcode];
-			break;
 		}
 	}
 
@@ -350,19 +369,15 @@ decode_mi(struct intel_decode *ctx)
 		return len;
 	}
 
-	for (opcode = 0; opcode < sizeof(opcodes_mi) / sizeof(opcodes_mi[0]);
-	     opcode++) {
-		if ((data[0] & 0x1f800000) >> 23 == opcodes_mi[opcode].opcode) {
-			unsigned int i;
-
-			instr_out(ctx, 0, "%s\n",
-				  opcodes_mi[opcode].name);
-			for (i = 1; i < len; i++) {
-				instr_out(ctx, i, "dword %d\n", i);
-			}
+	if (opcode_mi) {
+		unsigned int i;
 
-			return len;
+		instr_out(ctx, 0, "%s\n", opcode_mi->name);
+		for (i = 1; i < len; i++) {
+			instr_out(ctx, i, "dword %d\n", i);
 		}
+
+		return len;
 	}
 
 	instr_out(ctx, 0, "MI UNKNOWN\n");
@@ -413,44 +428,35 @@ decode_2d_br01(struct intel_decode *ctx)
 
 }
 
+struct blt_cmd {
+	uint32_t opcode;
+	unsigned int min_len;
+	unsigned int max_len;
+	const char *name;
+};
+
+#define BLT_CMD(_opcode, _min_len, _max_len, _name) \
+	{ _opcode, _min_len, _max_len, _name },
+
+static const struct blt_cmd opcodes_2d[] = {
+	INTEL_DECODE_2D_CMDS(BLT_CMD)
+};
+
+static const struct blt_cmd *
+lookup_2d(struct intel_decode *ctx, uint32_t dw0)
+{
+	uint8_t idx = ctx->blt_index[(dw0 & 0x1fc00000) >> 22];
+
+	return idx ? &opcodes_2d[idx - 1] : NULL;
+}
+
 static int
 decode_2d(struct intel_decode *ctx)
 {
-	unsigned int opcode, len;
+	unsigned int len;
 	uint32_t *data = ctx->data;
 
-	struct {
-		uint32_t opcode;
-		unsigned int min_len;
-		unsigned int max_len;
-		const char *name;
-	} opcodes_2d[] = {
-		{ 0x40, 5, 5, "COLOR_BLT" },
-		{ 0x43, 6, 6, "SRC_COPY_BLT" },
-		{ 0x01, 8, 8, "XY_SETUP_BLT" },
-		{ 0x11, 9, 9, "XY_SETUP_MONO_PATTERN_SL_BLT" },
-		{ 0x03, 3, 3, "XY_SETUP_CLIP_BLT" },
-		{ 0x24, 2, 2, "XY_PIXEL_BLT" },
-		{ 0x25, 3, 3, "XY_SCANLINES_BLT" },
-		{ 0x26, 4, 4, "Y_TEXT_BLT" },
-		{ 0x31, 5, 134, "XY_TEXT_IMMEDIATE_BLT" },
-		{ 0x50, 6, 6, "XY_COLOR_BLT" },
-		{ 0x51, 6, 6, "XY_PAT_BLT" },
-		{ 0x76, 8, 8, "XY_PAT_CHROMA_BLT" },
-		{ 0x72, 7, 135, "XY_PAT_BLT_IMMEDIATE" },
-		{ 0x77, 9, 137, "XY_PAT_CHROMA_BLT_IMMEDIATE" },
-		{ 0x52, 9, 9, "XY_MONO_PAT_BLT" },
-		{ 0x59, 7, 7, "XY_MONO_PAT_FIXED_BLT" },
-		{ 0x53, 8, 8, "XY_SRC_COPY_BLT" },
-		{ 0x54, 8, 8, "XY_MONO_SRC_COPY_BLT" },
-		{ 0x71, 9, 137, "XY_MONO_SRC_COPY_IMMEDIATE_BLT" },
-		{ 0x55, 9, 9, "XY_FULL_BLT" },
-		{ 0x55, 9, 137, "XY_FULL_IMMEDIATE_PATTERN_BLT" },
-		{ 0x56, 9, 9, "XY_FULL_MONO_SRC_BLT" },
-		{ 0x75, 10, 138, "XY_FULL_MONO_SRC_IMMEDIATE_PATTERN_BLT" },
-		{ 0x57, 12, 12, "XY_FULL_MONO_PATTERN_BLT" },
-		{ 0x58, 12, 12, "XY_FULL_MONO_PATTERN_MONO_SRC_BLT"},
-	};
+	const struct blt_cmd *opcode_2d;
 
 	switch ((data[0] & 0x1fc00000) >> 22) {
 	case 0x25:
@@ -554,29 +560,26 @@ decode_2d(struct intel_decode *ctx)
 		return len;
 	}
 
-	for (opcode = 0; opcode < sizeof(opcodes_2d) / sizeof(opcodes_2d[0]);
-	     opcode++) {
-		if ((data[0] & 0x1fc00000) >> 22 == opcodes_2d[opcode].opcode) {
-			unsigned int i;
-
-			len = 1;
-			instr_out(ctx, 0, "%s\n",
-				  opcodes_2d[opcode].name);
-			if (opcodes_2d[opcode].max_len > 1) {
-				len = (data[0] & 0x000000ff) + 2;
-				if (len < opcodes_2d[opcode].min_len ||
-				    len > opcodes_2d[opcode].max_len) {
-					fprintf(out, "Bad count in %s\n",
-						opcodes_2d[opcode].name);
-				}
-			}
-
-			for (i = 1; i < len; i++) {
-				instr_out(ctx, i, "dword %d\n", i);
+	opcode_2d = lookup_2d(ctx, data[0]);
+	if (opcode_2d) {
+		unsigned int i;
+
+		len = 1;
+		instr_out(ctx, 0, "%s\n", opcode_2d->name);
+		if (opcode_2d->max_len > 1) {
+			len = (data[0] & 0x000000ff) + 2;
+			if (len < opcode_2d->min_len ||
+			    len > opcode_2d->max_len) {
+				fprintf(out, "Bad count in %s\n",
+					opcode_2d->name);
 			}
+		}
 
-			return len;
+		for (i = 1; i < len; i++) {
+			instr_out(ctx, i, "dword %d\n", i);
 		}
+
+		return len;
 	}
 
 	instr_out(ctx, 0, "2D UNKNOWN\n");
@@ -1270,7 +1273,7 @@ decode_3d_1d(struct intel_decode *ctx)
 	uint32_t *data = ctx->data;
 	uint32_t devid = ctx->devid;
 
-	struct {
+	static const struct {
 		uint32_t opcode;
 		int i830_only;
 		unsigned int min_len;
@@ -2542,7 +2545,7 @@ decode_3d(struct intel_decode *ctx)
 	unsigned int idx;
 	uint32_t *data = ctx->data;
 
-	struct {
+	static const struct {
 		uint32_t opcode;
 		unsigned int min_len;
 		unsigned int max_len;
@@ -3127,6 +3130,37 @@ gen7_3DPRIMITIVE(struct intel_decode *ctx)
 	return 7;
 }
 
+struct r965_cmd {
+	uint32_t opcode;
+	uint32_t len_mask;
+	int unsigned min_len;
+	int unsigned max_len;
+	const char *name;
+	int gen;
+	int (*func)(struct intel_decode *ctx);
+	/* name, or the decode function without its genN_ prefix */
+	const char *label;
+};
+
+#define R965_CMD(_opcode, _len_mask, _min_len, _max_len, _name, _gen, _func) \
+	{ _opcode, _len_mask, _min_len, _max_len, _name, _gen, _func, \
+	  (_name) ? (_name) : &#_func[sizeof("genN_") - 1] },
+
+static const struct r965_cmd opcodes_3d_965[] = {
+	INTEL_DECODE_3D_965_CMDS(R965_CMD)
+};
+
+/* Type 3 commands are 0x6000-0x7fff, index by the low 13 bits */
+#define R965_INDEX(opcode) ((opcode) & 0x1fff)
+
+static const struct r965_cmd *
+lookup_3d_965(struct intel_decode *ctx, uint32_t dw0)
+{
+	uint8_t idx = ctx->r965_index[R965_INDEX(dw0 >> 16)];
+
+	return idx ? &opcodes_3d_965[idx - 1] : NULL;
+}
+
 static int
 decode_3d_965(struct intel_decode *ctx)
 {
@@ -3136,119 +3170,10 @@ decode_3d_965(struct intel_decode *ctx)
 	const char *desc1 = NULL;
 	uint32_t *data = ctx->data;
 	uint32_t devid = ctx->devid;
-
-	struct {
-		uint32_t opcode;
-		uint32_t len_mask;
-		int unsigned min_len;
-		int unsigned max_len;
-		const char *name;
-		int gen;
-		int (*func)(struct intel_decode *ctx);
-	} opcodes_3d[] = {
-		{ 0x6000, 0x00ff, 3, 3, "URB_FENCE" },
-		{ 0x6001, 0xffff, 2, 2, "CS_URB_STATE" },
-		{ 0x6002, 0x00ff, 2, 2, "CONSTANT_BUFFER" },
-		{ 0x6101, 0xffff, 6, 10, "STATE_BASE_ADDRESS" },
-		{ 0x6102, 0xffff, 2, 2, "STATE_SIP" },
-		{ 0x6104, 0xffff, 1, 1, "3DSTATE_PIPELINE_SELECT" },
-		{ 0x680b, 0xffff, 1, 1, "3DSTATE_VF_STATISTICS" },
-		{ 0x6904, 0xffff, 1, 1, "3DSTATE_PIPELINE_SELECT" },
-		{ 0x7800, 0xffff, 7, 7, "3DSTATE_PIPELINED_POINTERS" },
-		{ 0x7801, 0x00ff, 4, 6, "3DSTATE_BINDING_TABLE_POINTERS" },
-		{ 0x7802, 0x00ff, 4, 4, "3DSTATE_SAMPLER_STATE_POINTERS" },
-		{ 0x7805, 0x00ff, 7, 7, "3DSTATE_DEPTH_BUFFER", 7 },
-		{ 0x7805, 0x00ff, 3, 3, "3DSTATE_URB" },
-		{ 0x7804, 0x00ff, 3, 3, "3DSTATE_CLEAR_PARAMS" },
-		{ 0x7806, 0x00ff, 3, 3, "3DSTATE_STENCIL_BUFFER" },
-		{ 0x790f, 0x00ff, 3, 3, "3DSTATE_HIER_DEPTH_BUFFER", 6 },
-		{ 0x7807, 0x00ff, 3, 3, "3DSTATE_HIER_DEPTH_BUFFER", 7, gen7_3DSTATE_HIER_DEPTH_BUFFER },
-		{ 0x7808, 0x00ff, 5, 257, "3DSTATE_VERTEX_BUFFERS" },
-		{ 0x7809, 0x00ff, 3, 256, "3DSTATE_VERTEX_ELEMENTS" },
-		{ 0x780a, 0x00ff, 3, 3, "3DSTATE_INDEX_BUFFER" },
-		{ 0x780b, 0xffff, 1, 1, "3DSTATE_VF_STATISTICS" },
-		{ 0x780d, 0x00ff, 4, 4, "3DSTATE_VIEWPORT_STATE_POINTERS" },
-		{ 0x780e, 0xffff, 4, 4, NULL, 6, gen6_3DSTATE_CC_STATE_POINTERS },
-		{ 0x780e, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_CC_STATE_POINTERS },
-		{ 0x780f, 0x00ff, 2, 2, "3DSTATE_SCISSOR_POINTERS" },
-		{ 0x7810, 0x00ff, 6, 6, "3DSTATE_VS" },
-		{ 0x7811, 0x00ff, 7, 7, "3DSTATE_GS" },
-		{ 0x7812, 0x00ff, 4, 4, "3DSTATE_CLIP" },
-		{ 0x7813, 0x00ff, 20, 20, "3DSTATE_SF", 6 },
-		{ 0x7813, 0x00ff, 7, 7, "3DSTATE_SF", 7 },
-		{ 0x7814, 0x00ff, 3, 3, "3DSTATE_WM", 7, gen7_3DSTATE_WM },
-		{ 0x7814, 0x00ff, 9, 9, "3DSTATE_WM", 6, gen6_3DSTATE_WM },
-		{ 0x7815, 0x00ff, 5, 5, "3DSTATE_CONSTANT_VS_STATE", 6 },
-		{ 0x7815, 0x00ff, 7, 7, "3DSTATE_CONSTANT_VS", 7, gen7_3DSTATE_CONSTANT_VS },
-		{ 0x7816, 0x00ff, 5, 5, "3DSTATE_CONSTANT_GS_STATE", 6 },
-		{ 0x7816, 0x00ff, 7, 7, "3DSTATE_CONSTANT_GS", 7, gen7_3DSTATE_CONSTANT_GS },
-		{ 0x7817, 0x00ff, 5, 5, "3DSTATE_CONSTANT_PS_STATE", 6 },
-		{ 0x7817, 0x00ff, 7, 7, "3DSTATE_CONSTANT_PS", 7, gen7_3DSTATE_CONSTANT_PS },
-		{ 0x7818, 0xffff, 2, 2, "3DSTATE_SAMPLE_MASK" },
-		{ 0x7819, 0x00ff, 7, 7, "3DSTATE_CONSTANT_HS", 7, gen7_3DSTATE_CONSTANT_HS },
-		{ 0x781a, 0x00ff, 7, 7, "3DSTATE_CONSTANT_DS", 7, gen7_3DSTATE_CONSTANT_DS },
-		{ 0x781b, 0x00ff, 7, 7, "3DSTATE_HS" },
-		{ 0x781c, 0x00ff, 4, 4, "3DSTATE_TE" },
-		{ 0x781d, 0x00ff, 6, 6, "3DSTATE_DS" },
-		{ 0x781e, 0x00ff, 3, 3, "3DSTATE_STREAMOUT" },
-		{ 0x781f, 0x00ff, 14, 14, "3DSTATE_SBE" },
-		{ 0x7820, 0x00ff, 8, 8, "3DSTATE_PS" },
-		{ 0x7821, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_VIEWPORT_STATE_POINTERS_SF_CLIP },
-		{ 0x7823, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_VIEWPORT_STATE_POINTERS_CC },
-		{ 0x7824, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_BLEND_STATE_POINTERS },
-		{ 0x7825, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_DEPTH_STENCIL_STATE_POINTERS },
-		{ 0x7826, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_VS" },
-		{ 0x7827, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_HS" },
-		{ 0x7828, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_DS" },
-		{ 0x7829, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_GS" },
-		{ 0x782a, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_PS" },
-		{ 0x782b, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_VS" },
-		{ 0x782c, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_HS" },
-		{ 0x782d, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_DS" },
-		{ 0x782e, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_GS" },
-		{ 0x782f, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_PS" },
-		{ 0x7830, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_VS },
-		{ 0x7831, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_HS },
-		{ 0x7832, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_DS },
-		{ 0x7833, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_GS },
-		{ 0x7900, 0xffff, 4, 4, "3DSTATE_DRAWING_RECTANGLE" },
-		{ 0x7901, 0xffff, 5, 5, "3DSTATE_CONSTANT_COLOR" },
-		{ 0x7905, 0xffff, 5, 7, "3DSTATE_DEPTH_BUFFER" },
-		{ 0x7906, 0xffff, 2, 2, "3DSTATE_POLY_STIPPLE_OFFSET" },
-		{ 0x7907, 0xffff, 33, 33, "3DSTATE_POLY_STIPPLE_PATTERN" },
-		{ 0x7908, 0xffff, 3, 3, "3DSTATE_LINE_STIPPLE" },
-		{ 0x7909, 0xffff, 2, 2, "3DSTATE_GLOBAL_DEPTH_OFFSET_CLAMP" },
-		{ 0x7909, 0xffff, 2, 2, "3DSTATE_CLEAR_PARAMS" },
-		{ 0x790a, 0xffff, 3, 3, "3DSTATE_AA_LINE_PARAMETERS" },
-		{ 0x790b, 0xffff, 4, 4, "3DSTATE_GS_SVB_INDEX" },
-		{ 0x790d, 0xffff, 3, 3, "3DSTATE_MULTISAMPLE", 6 },
-		{ 0x790d, 0xffff, 4, 4, "3DSTATE_MULTISAMPLE", 7 },
-		{ 0x7910, 0x00ff, 2, 2, "3DSTATE_CLEAR_PARAMS" },
-		{ 0x7912, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_VS" },
-		{ 0x7913, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_HS" },
-		{ 0x7914, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_DS" },
-		{ 0x7915, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_GS" },
-		{ 0x7916, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_PS" },
-		{ 0x7917, 0x00ff, 2, 2+128*2, "3DSTATE_SO_DECL_LIST" },
-		{ 0x7918, 0x00ff, 4, 4, "3DSTATE_SO_BUFFER" },
-		{ 0x7a00, 0x00ff, 4, 6, "PIPE_CONTROL" },
-		{ 0x7b00, 0x00ff, 7, 7, NULL, 7, gen7_3DPRIMITIVE },
-		{ 0x7b00, 0x00ff, 6, 6, NULL, 0, gen4_3DPRIMITIVE },
-	}, *opcode_3d = NULL;
+	const struct r965_cmd *opcode_3d;
 
 	opcode = (data[0] & 0xffff0000) >> 16;
-
-	for (i = 0; i < ARRAY_SIZE(opcodes_3d); i++) {
-		if (opcode != opcodes_3d[i].opcode)
-			continue;
-
-		/* If it's marked as not our gen, skip. */
-		if (opcodes_3d[i].gen && opcodes_3d[i].gen != ctx->gen)
-			continue;
-
-		opcode_3d = &opcodes_3d[i];
-		break;
-	}
+	opcode_3d = lookup_3d_965(ctx, data[0]);
 
 	if (opcode_3d) {
 		if (opcode_3d->max_len == 1)
@@ -3757,7 +3682,7 @@ decode_3d_i830(struct intel_decode *ctx)
 	uint32_t opcode;
 	uint32_t *data = ctx->data;
 
-	struct {
+	static const struct {
 		uint32_t opcode;
 		unsigned int min_len;
 		unsigned int max_len;
@@ -3819,6 +3744,109 @@ decode_3d_i830(struct intel_decode *ctx)
 	return 1;
 }
 
+static void
+build_indexes(struct intel_decode *ctx)
+{
+	int i;
+
+	/* Walk backwards so the first applicable entry wins */
+	for (i = ARRAY_SIZE(opcodes_mi) - 1; i >= 0; i--)
+		ctx->mi_index[opcodes_mi[i].opcode] = i + 1;
+
+	for (i = ARRAY_SIZE(opcodes_2d) - 1; i >= 0; i--)
+		ctx->blt_index[opcodes_2d[i].opcode] = i + 1;
+
+	for (i = ARRAY_SIZE(opcodes_3d_965) - 1; i >= 0; i--) {
+		const struct r965_cmd *cmd = &opcodes_3d_965[i];
+
+		if (cmd->gen && cmd->gen != ctx->gen)
+			continue;
+
+		ctx->r965_index[R965_INDEX(cmd->opcode)] = i + 1;
+	}
+}
+
+_Static_assert(ARRAY_SIZE(opcodes_mi) < 256 &&
+	       ARRAY_SIZE(opcodes_2d) < 256 &&
+	       ARRAY_SIZE(opcodes_3d_965) < 256,
+	       "opcode indexes are 8 bits wide");
+
+static void
+describe_cmd(struct intel_decode *ctx, uint32_t dw0,
+	     struct intel_decode_cmd *cmd)
+{
+	const struct mi_cmd *mi;
+	const struct blt_cmd *blt;
+	const struct r965_cmd *r965;
+
+	cmd->name = NULL;
+
+	switch (dw0 >> 29) {
+	case 0x0:
+		cmd->type = INTEL_DECODE_CMD_MI;
+		cmd->opcode = (dw0 & 0x1f800000) >> 23;
+		mi = lookup_mi(ctx, dw0);
+		if (mi)
+			cmd->name = mi->name;
+		break;
+	case 0x2:
+		cmd->type = INTEL_DECODE_CMD_2D;
+		cmd->opcode = (dw0 & 0x1fc00000) >> 22;
+		blt = lookup_2d(ctx, dw0);
+		if (blt)
+			cmd->name = blt->name;
+		break;
+	case 0x3:
+		cmd->type = INTEL_DECODE_CMD_3D;
+		if (ctx->gen >= 4) {
+			cmd->opcode = dw0 >> 16;
+			r965 = lookup_3d_965(ctx, dw0);
+			if (r965)
+				cmd->name = r965->label;
+		} else {
+			cmd->opcode = (dw0 & 0x1f000000) >> 24;
+		}
+		break;
+	default:
+		cmd->type = INTEL_DECODE_CMD_UNKNOWN;
+		cmd->opcode = dw0 >> 29;
+		break;
+	}
+}
+
+static void
+visit_cmd(struct intel_decode *ctx, unsigned int len)
+{
+	struct intel_decode_cmd cmd;
+	struct intel_decode_counts *counts = ctx->counts;
+
+	describe_cmd(ctx, ctx->data[0], &cmd);
+	cmd.hw_offset = ctx->hw_offset;
+	cmd.data = ctx->data;
+	cmd.len = min(len, ctx->count);
+
+	if (ctx->visit)
+		ctx->visit(&cmd, ctx->visit_data);
+
+	if (!counts)
+		return;
+
+	switch (cmd.type) {
+	case INTEL_DECODE_CMD_MI:
+		counts->mi[cmd.opcode]++;
+		break;
+	case INTEL_DECODE_CMD_2D:
+		counts->blt[cmd.opcode]++;
+		break;
+	case INTEL_DECODE_CMD_3D:
+		counts->r3d[R965_INDEX(cmd.opcode)]++;
+		break;
+	default:
+		counts->unknown++;
+		break;
+	}
+}
+
 struct intel_decode *
 intel_decode_context_alloc(uint32_t devid)
 {
@@ -3835,12 +3863,17 @@ intel_decode_context_alloc(uint32_t devid)
 	ctx->gen = gen;
 	ctx->out = stdout;
 
+	build_indexes(ctx);
+
 	return ctx;
 }
 
 void
 intel_decode_context_free(struct intel_decode *ctx)
 {
+	if (ctx->quiet)
+		fclose(ctx->out);
+	free(ctx->counts);
 	free(ctx);
 }
 
@@ -3868,11 +3901,145 @@ intel_decode_set_head_tail(struct intel_decode *ctx,
 	ctx->tail = tail;
 }
 
+/**
+ * Sets the stdio file the decode is written to.
+ *
+ * A NULL \p output disables the text output altogether, which is much
+ * faster when the batch is only walked by a visitor or for a summary.
+ */
 void
 intel_decode_set_output_file(struct intel_decode *ctx,
 				 FILE *output)
 {
+	bool quiet = !output;
+
+	if (quiet && ctx->quiet)
+		return;
+
+	/* Diagnostics are still printed to the stream, so discard them */
+	if (quiet) {
+		output = fopencookie(NULL, "w", (cookie_io_functions_t) {});
+		if (!output)
+			return;
+	}
+
+	if (ctx->quiet)
+		fclose(ctx->out);
+
 	ctx->out = output;
+	ctx->quiet = quiet;
+}
+
+/**
+ * Sets a callback invoked for every command once it has been decoded.
+ */
+void
+intel_decode_set_visitor(struct intel_decode *ctx,
+			 intel_decode_visit_fn visit, void *data)
+{
+	ctx->visit = visit;
+	ctx->visit_data = data;
+}
+
+/**
+ * Enables counting commands by opcode across intel_decode() calls, for
+ * intel_decode_print_summary().  Enabling it again resets the counts.
+ *
+ * \return 0 on success, -ENOMEM if the counters could not be allocated
+ */
+int
+intel_decode_set_summary(struct intel_decode *ctx, int summary)
+{
+	free(ctx->counts);
+	ctx->counts = NULL;
+
+	if (!summary)
+		return 0;
+
+	ctx->counts = calloc(1, sizeof(*ctx->counts));
+
+	return ctx->counts ? 0 : -ENOMEM;
+}
+
+struct summary_entry {
+	uint64_t count;
+	uint32_t dw0;
+};
+
+static int cmp_summary_entry(const void *A, const void *B)
+{
+	const struct summary_entry *a = A, *b = B;
+
+	if (a->count != b->count)
+		return a->count < b->count ? 1 : -1;
+
+	return a->dw0 < b->dw0 ? -1 : a->dw0 > b->dw0;
+}
+
+/**
+ * Prints the number of commands seen since intel_decode_set_summary(),
+ * most frequent first.
+ */
+void
+intel_decode_print_summary(struct intel_decode *ctx, FILE *output)
+{
+	struct intel_decode_counts *counts = ctx->counts;
+	struct summary_entry *entries;
+	unsigned int i, n = 0;
+	uint64_t total = 0;
+
+	if (!counts)
+		return;
+
+	entries = malloc((ARRAY_SIZE(counts->mi) + ARRAY_SIZE(counts->blt) +
+			  ARRAY_SIZE(counts->r3d)) * sizeof(*entries));
+	if (!entries)
+		return;
+
+	/* Store the counts as a canonical dword 0 to look the name up */
+	for (i = 0; i < ARRAY_SIZE(counts->mi); i++)
+		if (counts->mi[i])
+			entries[n++] = (struct summary_entry) {
+				counts->mi[i], i << 23 };
+
+	for (i = 0; i < ARRAY_SIZE(counts->blt); i++)
+		if (counts->blt[i])
+			entries[n++] = (struct summary_entry) {
+				counts->blt[i], 0x2u << 29 | i << 22 };
+
+	for (i = 0; i < ARRAY_SIZE(counts->r3d); i++)
+		if (counts->r3d[i])
+			entries[n++] = (struct summary_entry) {
+				counts->r3d[i], ctx->gen >= 4 ?
+				(0x6000 | i) << 16 : 0x3u << 29 | i << 24 };
+
+	qsort(entries, n, sizeof(*entries), cmp_summary_entry);
+
+	for (i = 0; i < n; i++) {
+		struct intel_decode_cmd cmd;
+
+		describe_cmd(ctx, entries[i].dw0, &cmd);
+		total += entries[i].count;
+
+		if (cmd.name)
+			fprintf(output, "%12" PRIu64 "  %s\n",
+				entries[i].count, cmd.name);
+		else
+			fprintf(output, "%12" PRIu64 "  %s UNKNOWN 0x%x\n",
+				entries[i].count,
+				cmd.type == INTEL_DECODE_CMD_MI ? "MI" :
+				cmd.type == INTEL_DECODE_CMD_2D ? "2D" : "3D",
+				cmd.opcode);
+	}
+
+	if (counts->unknown) {
+		fprintf(output, "%12" PRIu64 "  UNKNOWN\n", counts->unknown);
+		total += counts->unknown;
+	}
+
+	fprintf(output, "%12" PRIu64 "  total\n", total);
+
+	free(entries);
 }
 
 /**
@@ -3887,7 +4054,6 @@ intel_decode(struct intel_decode *ctx)
 {
 	int ret;
 	unsigned int index = 0;
-	uint32_t devid;
 	int size;
 	void *temp;
 
@@ -3906,8 +4072,8 @@ intel_decode(struct intel_decode *ctx)
 
 	ctx->hw_offset = ctx->base_hw_offset;
 	ctx->count = ctx->base_count;
+	ctx->overflowed = false;
 
-	devid = ctx->devid;
 	head_offset = ctx->head;
 	tail_offset = ctx->tail;
 	out = ctx->out;
@@ -3916,6 +4082,8 @@ intel_decode(struct intel_decode *ctx)
 	saved_s4_set = 1;
 
 	while (ctx->count > 0) {
+		unsigned int len;
+
 		index = 0;
 
 		switch ((ctx->data[index] & 0xe0000000) >> 29) {
@@ -3929,6 +4097,7 @@ intel_decode(struct intel_decode *ctx)
 			 * case.
 			 */
 			if (ret == -1) {
+				len = 1;
 				if (ctx->dump_past_end) {
 					index++;
 				} else {
@@ -3937,29 +4106,36 @@ intel_decode(struct intel_decode *ctx)
 						instr_out(ctx, index, "\n");
 					}
 				}
-			} else
+			} else {
 				index += ret;
+				len = index;
+			}
 			break;
 		case 0x2:
 			index += decode_2d(ctx);
+			len = index;
 			break;
 		case 0x3:
-			if (intel_gen(devid) >= 4) {
+			if (ctx->gen >= 4) {
 				index +=
 				    decode_3d_965(ctx);
-			} else if (IS_GEN3(devid)) {
+			} else if (ctx->gen == 3) {
 				index += decode_3d(ctx);
 			} else {
 				index +=
 				    decode_3d_i830(ctx);
 			}
+			len = index;
 			break;
 		default:
 			instr_out(ctx, index, "UNKNOWN\n");
 			index++;
+			len = index;
 			break;
 		}
-		fflush(out);
+
+		if (ctx->visit || ctx->counts)
+			visit_cmd(ctx, len);
 
 		if (ctx->count < index)
 			break;
@@ -3969,5 +4145,8 @@ intel_decode(struct intel_decode *ctx)
 		ctx->hw_offset += 4 * index;
 	}
 
+	if (!ctx->quiet)
+		fflush(out);
+
 	free(temp);
 }
@@ -29,6 +29,28 @@
 
 struct intel_decode;
 
+enum intel_decode_cmd_type {
+	INTEL_DECODE_CMD_MI,
+	INTEL_DECODE_CMD_2D,
+	INTEL_DECODE_CMD_3D,
+	INTEL_DECODE_CMD_UNKNOWN,
+};
+
+struct intel_decode_cmd {
+	enum intel_decode_cmd_type type;
+	/* MI: bits 28:23, 2D: 28:22, 3D: 31:16 on gen4+ and 28:24 before */
+	uint32_t opcode;
+	/* NULL if the command is not in the decode tables */
+	const char *name;
+	uint32_t hw_offset;
+	/* Only valid until the visitor returns */
+	const uint32_t *data;
+	uint32_t len;
+};
+
+typedef void (*intel_decode_visit_fn)(const struct intel_decode_cmd *cmd,
+				      void *data);
+
 struct intel_decode *intel_decode_context_alloc(uint32_t devid);
 void intel_decode_context_free(struct intel_decode *ctx);
 void intel_decode_set_dump_past_end(struct intel_decode *ctx, int dump_past_end);
@@ -37,6 +59,11 @@ void intel_decode_set_batch_pointer(struct intel_decode *ctx,
 void intel_decode_set_head_tail(struct intel_decode *ctx,
 				uint32_t head, uint32_t tail);
 void intel_decode_set_output_file(struct intel_decode *ctx, FILE *output);
+
+void intel_decode_set_visitor(struct intel_decode *ctx,
+			      intel_decode_visit_fn visit, void *data);
+int intel_decode_set_summary(struct intel_decode *ctx, int summary);
+void intel_decode_print_summary(struct intel_decode *ctx, FILE *output);
 void intel_decode(struct intel_decode *ctx);
 
 #endif /* INTEL_DECODE_H */
@@ -0,0 +1,185 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Command descriptions used by intel_decode.c to build its opcode tables.
+ *
+ * Each list invokes X() once per command, and is only meant to be expanded
+ * inside intel_decode.c where the named decode functions are visible.  When
+ * several entries share an opcode the first one applicable to the device's
+ * gen wins, so keep gen specific entries ahead of the generic ones.
+ *
+ * MI:     X(opcode, len_mask, min_len, max_len, name, func)
+ * 2D:     X(opcode, min_len, max_len, name)
+ * 3D 965: X(opcode, len_mask, min_len, max_len, name, gen, func)
+ *
+ * A NULL name means the command is fully described by its decode function.
+ */
+
+#ifndef INTEL_DECODE_CMDS_H
+#define INTEL_DECODE_CMDS_H
+
+#define INTEL_DECODE_MI_CMDS(X) \
+	X(0x08, 0, 1, 1, "MI_ARB_ON_OFF", NULL) \
+	X(0x0a, 0, 1, 1, "MI_BATCH_BUFFER_END", NULL) \
+	X(0x30, 0x3f, 3, 3, "MI_BATCH_BUFFER", NULL) \
+	X(0x31, 0x3f, 2, 3, "MI_BATCH_BUFFER_START", NULL) \
+	X(0x14, 0x3f, 3, 3, "MI_DISPLAY_BUFFER_INFO", NULL) \
+	X(0x04, 0, 1, 1, "MI_FLUSH", NULL) \
+	X(0x22, 0x1f, 3, 3, "MI_LOAD_REGISTER_IMM", NULL) \
+	X(0x13, 0x3f, 2, 2, "MI_LOAD_SCAN_LINES_EXCL", NULL) \
+	X(0x12, 0x3f, 2, 2, "MI_LOAD_SCAN_LINES_INCL", NULL) \
+	X(0x00, 0, 1, 1, "MI_NOOP", NULL) \
+	X(0x11, 0x3f, 2, 2, "MI_OVERLAY_FLIP", NULL) \
+	X(0x07, 0, 1, 1, "MI_REPORT_HEAD", NULL) \
+	X(0x18, 0x3f, 2, 2, "MI_SET_CONTEXT", decode_MI_SET_CONTEXT) \
+	X(0x20, 0x3f, 3, 4, "MI_STORE_DATA_IMM", NULL) \
+	X(0x21, 0x3f, 3, 4, "MI_STORE_DATA_INDEX", NULL) \
+	X(0x24, 0x3f, 3, 3, "MI_STORE_REGISTER_MEM", NULL) \
+	X(0x02, 0, 1, 1, "MI_USER_INTERRUPT", NULL) \
+	X(0x03, 0, 1, 1, "MI_WAIT_FOR_EVENT", decode_MI_WAIT_FOR_EVENT) \
+	X(0x16, 0x7f, 3, 3, "MI_SEMAPHORE_MBOX", NULL) \
+	X(0x26, 0x1f, 3, 4, "MI_FLUSH_DW", NULL) \
+	X(0x28, 0x3f, 3, 3, "MI_REPORT_PERF_COUNT", NULL) \
+	X(0x29, 0xff, 3, 3, "MI_LOAD_REGISTER_MEM", NULL) \
+	X(0x0b, 0, 1, 1, "MI_SUSPEND_FLUSH", NULL) \
+	X(0x05, 0, 1, 1, "MI_ARB_CHECK", NULL)
+
+#define INTEL_DECODE_2D_CMDS(X) \
+	X(0x40, 5, 5, "COLOR_BLT") \
+	X(0x43, 6, 6, "SRC_COPY_BLT") \
+	X(0x01, 8, 8, "XY_SETUP_BLT") \
+	X(0x11, 9, 9, "XY_SETUP_MONO_PATTERN_SL_BLT") \
+	X(0x03, 3, 3, "XY_SETUP_CLIP_BLT") \
+	X(0x24, 2, 2, "XY_PIXEL_BLT") \
+	X(0x25, 3, 3, "XY_SCANLINES_BLT") \
+	X(0x26, 4, 4, "Y_TEXT_BLT") \
+	X(0x31, 5, 134, "XY_TEXT_IMMEDIATE_BLT") \
+	X(0x50, 6, 6, "XY_COLOR_BLT") \
+	X(0x51, 6, 6, "XY_PAT_BLT") \
+	X(0x76, 8, 8, "XY_PAT_CHROMA_BLT") \
+	X(0x72, 7, 135, "XY_PAT_BLT_IMMEDIATE") \
+	X(0x77, 9, 137, "XY_PAT_CHROMA_BLT_IMMEDIATE") \
+	X(0x52, 9, 9, "XY_MONO_PAT_BLT") \
+	X(0x59, 7, 7, "XY_MONO_PAT_FIXED_BLT") \
+	X(0x53, 8, 8, "XY_SRC_COPY_BLT") \
+	X(0x54, 8, 8, "XY_MONO_SRC_COPY_BLT") \
+	X(0x71, 9, 137, "XY_MONO_SRC_COPY_IMMEDIATE_BLT") \
+	X(0x55, 9, 9, "XY_FULL_BLT") \
+	X(0x55, 9, 137, "XY_FULL_IMMEDIATE_PATTERN_BLT") \
+	X(0x56, 9, 9, "XY_FULL_MONO_SRC_BLT") \
+	X(0x75, 10, 138, "XY_FULL_MONO_SRC_IMMEDIATE_PATTERN_BLT") \
+	X(0x57, 12, 12, "XY_FULL_MONO_PATTERN_BLT") \
+	X(0x58, 12, 12, "XY_FULL_MONO_PATTERN_MONO_SRC_BLT")
+
+#define INTEL_DECODE_3D_965_CMDS(X) \
+	X(0x6000, 0x00ff, 3, 3, "URB_FENCE", 0, NULL) \
+	X(0x6001, 0xffff, 2, 2, "CS_URB_STATE", 0, NULL) \
+	X(0x6002, 0x00ff, 2, 2, "CONSTANT_BUFFER", 0, NULL) \
+	X(0x6101, 0xffff, 6, 10, "STATE_BASE_ADDRESS", 0, NULL) \
+	X(0x6102, 0xffff, 2, 2, "STATE_SIP", 0, NULL) \
+	X(0x6104, 0xffff, 1, 1, "3DSTATE_PIPELINE_SELECT", 0, NULL) \
+	X(0x680b, 0xffff, 1, 1, "3DSTATE_VF_STATISTICS", 0, NULL) \
+	X(0x6904, 0xffff, 1, 1, "3DSTATE_PIPELINE_SELECT", 0, NULL) \
+	X(0x7800, 0xffff, 7, 7, "3DSTATE_PIPELINED_POINTERS", 0, NULL) \
+	X(0x7801, 0x00ff, 4, 6, "3DSTATE_BINDING_TABLE_POINTERS", 0, NULL) \
+	X(0x7802, 0x00ff, 4, 4, "3DSTATE_SAMPLER_STATE_POINTERS", 0, NULL) \
+	X(0x7805, 0x00ff, 7, 7, "3DSTATE_DEPTH_BUFFER", 7, NULL) \
+	X(0x7805, 0x00ff, 3, 3, "3DSTATE_URB", 0, NULL) \
+	X(0x7804, 0x00ff, 3, 3, "3DSTATE_CLEAR_PARAMS", 0, NULL) \
+	X(0x7806, 0x00ff, 3, 3, "3DSTATE_STENCIL_BUFFER", 0, NULL) \
+	X(0x790f, 0x00ff, 3, 3, "3DSTATE_HIER_DEPTH_BUFFER", 6, NULL) \
+	X(0x7807, 0x00ff, 3, 3, "3DSTATE_HIER_DEPTH_BUFFER", 7, gen7_3DSTATE_HIER_DEPTH_BUFFER) \
+	X(0x7808, 0x00ff, 5, 257, "3DSTATE_VERTEX_BUFFERS", 0, NULL) \
+	X(0x7809, 0x00ff, 3, 256, "3DSTATE_VERTEX_ELEMENTS", 0, NULL) \
+	X(0x780a, 0x00ff, 3, 3, "3DSTATE_INDEX_BUFFER", 0, NULL) \
+	X(0x780b, 0xffff, 1, 1, "3DSTATE_VF_STATISTICS", 0, NULL) \
+	X(0x780d, 0x00ff, 4, 4, "3DSTATE_VIEWPORT_STATE_POINTERS", 0, NULL) \
+	X(0x780e, 0xffff, 4, 4, NULL, 6, gen6_3DSTATE_CC_STATE_POINTERS) \
+	X(0x780e, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_CC_STATE_POINTERS) \
+	X(0x780f, 0x00ff, 2, 2, "3DSTATE_SCISSOR_POINTERS", 0, NULL) \
+	X(0x7810, 0x00ff, 6, 6, "3DSTATE_VS", 0, NULL) \
+	X(0x7811, 0x00ff, 7, 7, "3DSTATE_GS", 0, NULL) \
+	X(0x7812, 0x00ff, 4, 4, "3DSTATE_CLIP", 0, NULL) \
+	X(0x7813, 0x00ff, 20, 20, "3DSTATE_SF", 6, NULL) \
+	X(0x7813, 0x00ff, 7, 7, "3DSTATE_SF", 7, NULL) \
+	X(0x7814, 0x00ff, 3, 3, "3DSTATE_WM", 7, gen7_3DSTATE_WM) \
+	X(0x7814, 0x00ff, 9, 9, "3DSTATE_WM", 6, gen6_3DSTATE_WM) \
+	X(0x7815, 0x00ff, 5, 5, "3DSTATE_CONSTANT_VS_STATE", 6, NULL) \
+	X(0x7815, 0x00ff, 7, 7, "3DSTATE_CONSTANT_VS", 7, gen7_3DSTATE_CONSTANT_VS) \
+	X(0x7816, 0x00ff, 5, 5, "3DSTATE_CONSTANT_GS_STATE", 6, NULL) \
+	X(0x7816, 0x00ff, 7, 7, "3DSTATE_CONSTANT_GS", 7, gen7_3DSTATE_CONSTANT_GS) \
+	X(0x7817, 0x00ff, 5, 5, "3DSTATE_CONSTANT_PS_STATE", 6, NULL) \
+	X(0x7817, 0x00ff, 7, 7, "3DSTATE_CONSTANT_PS", 7, gen7_3DSTATE_CONSTANT_PS) \
+	X(0x7818, 0xffff, 2, 2, "3DSTATE_SAMPLE_MASK", 0, NULL) \
+	X(0x7819, 0x00ff, 7, 7, "3DSTATE_CONSTANT_HS", 7, gen7_3DSTATE_CONSTANT_HS) \
+	X(0x781a, 0x00ff, 7, 7, "3DSTATE_CONSTANT_DS", 7, gen7_3DSTATE_CONSTANT_DS) \
+	X(0x781b, 0x00ff, 7, 7, "3DSTATE_HS", 0, NULL) \
+	X(0x781c, 0x00ff, 4, 4, "3DSTATE_TE", 0, NULL) \
+	X(0x781d, 0x00ff, 6, 6, "3DSTATE_DS", 0, NULL) \
+	X(0x781e, 0x00ff, 3, 3, "3DSTATE_STREAMOUT", 0, NULL) \
+	X(0x781f, 0x00ff, 14, 14, "3DSTATE_SBE", 0, NULL) \
+	X(0x7820, 0x00ff, 8, 8, "3DSTATE_PS", 0, NULL) \
+	X(0x7821, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_VIEWPORT_STATE_POINTERS_SF_CLIP) \
+	X(0x7823, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_VIEWPORT_STATE_POINTERS_CC) \
+	X(0x7824, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_BLEND_STATE_POINTERS) \
+	X(0x7825, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_DEPTH_STENCIL_STATE_POINTERS) \
+	X(0x7826, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_VS", 0, NULL) \
+	X(0x7827, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_HS", 0, NULL) \
+	X(0x7828, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_DS", 0, NULL) \
+	X(0x7829, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_GS", 0, NULL) \
+	X(0x782a, 0x00ff, 2, 2, "3DSTATE_BINDING_TABLE_POINTERS_PS", 0, NULL) \
+	X(0x782b, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_VS", 0, NULL) \
+	X(0x782c, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_HS", 0, NULL) \
+	X(0x782d, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_DS", 0, NULL) \
+	X(0x782e, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_GS", 0, NULL) \
+	X(0x782f, 0x00ff, 2, 2, "3DSTATE_SAMPLER_STATE_POINTERS_PS", 0, NULL) \
+	X(0x7830, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_VS) \
+	X(0x7831, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_HS) \
+	X(0x7832, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_DS) \
+	X(0x7833, 0x00ff, 2, 2, NULL, 7, gen7_3DSTATE_URB_GS) \
+	X(0x7900, 0xffff, 4, 4, "3DSTATE_DRAWING_RECTANGLE", 0, NULL) \
+	X(0x7901, 0xffff, 5, 5, "3DSTATE_CONSTANT_COLOR", 0, NULL) \
+	X(0x7905, 0xffff, 5, 7, "3DSTATE_DEPTH_BUFFER", 0, NULL) \
+	X(0x7906, 0xffff, 2, 2, "3DSTATE_POLY_STIPPLE_OFFSET", 0, NULL) \
+	X(0x7907, 0xffff, 33, 33, "3DSTATE_POLY_STIPPLE_PATTERN", 0, NULL) \
+	X(0x7908, 0xffff, 3, 3, "3DSTATE_LINE_STIPPLE", 0, NULL) \
+	X(0x7909, 0xffff, 2, 2, "3DSTATE_GLOBAL_DEPTH_OFFSET_CLAMP", 0, NULL) \
+	X(0x7909, 0xffff, 2, 2, "3DSTATE_CLEAR_PARAMS", 0, NULL) \
+	X(0x790a, 0xffff, 3, 3, "3DSTATE_AA_LINE_PARAMETERS", 0, NULL) \
+	X(0x790b, 0xffff, 4, 4, "3DSTATE_GS_SVB_INDEX", 0, NULL) \
+	X(0x790d, 0xffff, 3, 3, "3DSTATE_MULTISAMPLE", 6, NULL) \
+	X(0x790d, 0xffff, 4, 4, "3DSTATE_MULTISAMPLE", 7, NULL) \
+	X(0x7910, 0x00ff, 2, 2, "3DSTATE_CLEAR_PARAMS", 0, NULL) \
+	X(0x7912, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_VS", 0, NULL) \
+	X(0x7913, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_HS", 0, NULL) \
+	X(0x7914, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_DS", 0, NULL) \
+	X(0x7915, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_GS", 0, NULL) \
+	X(0x7916, 0x00ff, 2, 2, "3DSTATE_PUSH_CONSTANT_ALLOC_PS", 0, NULL) \
+	X(0x7917, 0x00ff, 2, 2+128*2, "3DSTATE_SO_DECL_LIST", 0, NULL) \
+	X(0x7918, 0x00ff, 4, 4, "3DSTATE_SO_BUFFER", 0, NULL) \
+	X(0x7a00, 0x00ff, 4, 6, "PIPE_CONTROL", 0, NULL) \
+	X(0x7b00, 0x00ff, 7, 7, NULL, 7, gen7_3DPRIMITIVE) \
+	X(0x7b00, 0x00ff, 6, 6, NULL, 0, gen4_3DPRIMITIVE)
+
+#endif /* INTEL_DECODE_CMDS_H */
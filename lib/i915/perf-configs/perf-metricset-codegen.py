@@ -90,6 +90,96 @@ def output_counter_report(set, counter):
     c("},")
 
 
+def metric_set_hash(name, seed):
+    # Must match metric_set_hash() in lib/i915/perf.c
+    h = 0x811c9dc5 ^ seed
+    for ch in name.lower().encode():
+        h ^= ch
+        h = (h * 0x01000193) & 0xffffffff
+    # FNV's low bits are too regular for small tables, mix them up
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & 0xffffffff
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & 0xffffffff
+    h ^= h >> 16
+    return h
+
+
+def perfect_hash(names):
+    """Hash and displace: every bucket of names sharing a first level
+    hash gets the first seed mapping all of them to free slots.
+    Returns the per bucket seeds and the slot to name index mapping.
+    """
+    n = len(names)
+    if len(set(name.lower() for name in names)) != n:
+        raise Exception("Metric set symbol names must be case insensitively unique")
+
+    buckets = [[] for i in range(n)]
+    for i, name in enumerate(names):
+        buckets[metric_set_hash(name, 0) % n].append(i)
+
+    seeds = [0] * n
+    slots = [None] * n
+    for b in sorted(range(n), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            break
+        for seed in range(1, 0x10000):
+            taken = [metric_set_hash(names[i], seed) % n for i in buckets[b]]
+            if len(set(taken)) == len(taken) and all(slots[t] is None for t in taken):
+                break
+        else:
+            raise Exception("No perfect hash seed found")
+        seeds[b] = seed
+        for i, t in zip(buckets[b], taken):
+            slots[t] = i
+
+    return seeds, slots
+
+
+def output_metric_set_format(set):
+    gen = set.gen
+    if gen.chipset == "hsw":
+        c(textwrap.dedent("""\
+            .perf_oa_format = I915_OA_FORMAT_A45_B8_C8,
+            .perf_raw_size = 256,
+            .gpu_time_offset = 0,
+            .a_offset = 1,
+            .b_offset = 1 + 45,
+            .c_offset = 1 + 45 + 8,
+            .perfcnt_offset = 1 + 45 + 8 + 8,"""))
+    elif (gen.chipset.startswith("acm") or gen.chipset.startswith("mtl")) and \
+         set.oa_format == "128B_MPEC8_NOA16":
+        c(textwrap.dedent("""\
+            .perf_oa_format = I915_OAM_FORMAT_MPEC8u32_B8_C8,
+            .perf_raw_size = 128,
+            .gpu_time_offset = 0,
+            .gpu_clock_offset = 1,
+            .a_offset = 2,
+            .b_offset = 2 + 8,
+            .c_offset = 2 + 8 + 8,
+            .perfcnt_offset = 2 + 8 + 8 + 8,"""))
+    elif gen.chipset.startswith("acm") or gen.chipset.startswith("mtl"):
+        c(textwrap.dedent("""\
+            .perf_oa_format = I915_OA_FORMAT_A24u40_A14u32_B8_C8,
+            .perf_raw_size = 256,
+            .gpu_time_offset = 0,
+            .gpu_clock_offset = 1,
+            .a_offset = 2,
+            .b_offset = 2 + 38,
+            .c_offset = 2 + 38 + 8,
+            .perfcnt_offset = 2 + 38 + 8 + 8,"""))
+    else:
+        c(textwrap.dedent("""\
+            .perf_oa_format = I915_OA_FORMAT_A32u40_A4u32_B8_C8,
+            .perf_raw_size = 256,
+            .gpu_time_offset = 0,
+            .gpu_clock_offset = 1,
+            .a_offset = 2,
+            .b_offset = 2 + 36,
+            .c_offset = 2 + 36 + 8,
+            .perfcnt_offset = 2 + 36 + 8 + 8,"""))
+
+
 def generate_metric_sets(args, gen):
     c(textwrap.dedent("""\
         #include <stddef.h>
@@ -106,8 +196,8 @@ def generate_metric_sets(args, gen):
     c("#include \"{0}\"".format(os.path.basename(args.equations_include)))
     c("#include \"{0}\"".format(os.path.basename(args.registers_include)))
 
-    # Print out all set registration functions for each set in each
-    # generation.
+    # Print out the counters of each set as static tables, only copied
+    # when the set is looked up.
     for set in gen.sets:
         counters = sorted(set.counters, key=lambda k: k.get('symbol_name'))
 
@@ -116,118 +206,61 @@ def generate_metric_sets(args, gen):
         for counter in counters:
           output_availability_funcs(set, counter)
 
-        c("\nstatic void\n")
-        c(gen.chipset + "_add_" + set.underscore_name + "_metric_set(struct intel_perf *perf)")
-        c("{\n")
+        c("\nstatic const struct intel_perf_logical_counter " +
+          gen.chipset + "_" + set.underscore_name + "_counters[] = {")
         c.indent(4)
-
-        c("struct intel_perf_metric_set *metric_set;\n")
-        c("struct intel_perf_logical_counter *counter;\n\n")
-
-        c("metric_set = calloc(1, sizeof(*metric_set));\n")
-        c("metric_set->name = \"" + set.name + "\";\n")
-        c("metric_set->symbol_name = \"" + set.symbol_name + "\";\n")
-        c("metric_set->hw_config_guid = \"" + set.hw_config_guid + "\";\n")
-        c("metric_set->counters = calloc({0}, sizeof(struct intel_perf_logical_counter));\n".format(str(len(counters))))
-        c("metric_set->n_counters = 0;\n")
-        c("metric_set->perf_oa_metrics_set = 0; // determined at runtime\n")
-
-        if gen.chipset == "hsw":
-            c(textwrap.dedent("""\
-                metric_set->perf_oa_format = I915_OA_FORMAT_A45_B8_C8;
-
-                metric_set->perf_raw_size = 256;
-                metric_set->gpu_time_offset = 0;
-                metric_set->a_offset = 1;
-                metric_set->b_offset = metric_set->a_offset + 45;
-                metric_set->c_offset = metric_set->b_offset + 8;
-                metric_set->perfcnt_offset = metric_set->c_offset + 8;
-
-            """))
-        elif gen.chipset.startswith("acm") or gen.chipset.startswith("mtl"):
-            if set.oa_format == "128B_MPEC8_NOA16":
-                c(textwrap.dedent("""\
-                    metric_set->perf_oa_format = I915_OAM_FORMAT_MPEC8u32_B8_C8;
-
-                    metric_set->perf_raw_size = 128;
-                    metric_set->gpu_time_offset = 0;
-                    metric_set->gpu_clock_offset = 1;
-                    metric_set->a_offset = 2;
-                    metric_set->b_offset = metric_set->a_offset + 8;
-                    metric_set->c_offset = metric_set->b_offset + 8;
-                    metric_set->perfcnt_offset = metric_set->c_offset + 8;
-                """))
-            else:
-                c(textwrap.dedent("""\
-                    metric_set->perf_oa_format = I915_OA_FORMAT_A24u40_A14u32_B8_C8;
-
-                    metric_set->perf_raw_size = 256;
-                    metric_set->gpu_time_offset = 0;
-                    metric_set->gpu_clock_offset = 1;
-                    metric_set->a_offset = 2;
-                    metric_set->b_offset = metric_set->a_offset + 38;
-                    metric_set->c_offset = metric_set->b_offset + 8;
-                    metric_set->perfcnt_offset = metric_set->c_offset + 8;
-                """))
-        else:
-            c(textwrap.dedent("""\
-                metric_set->perf_oa_format = I915_OA_FORMAT_A32u40_A4u32_B8_C8;
-
-                metric_set->perf_raw_size = 256;
-                metric_set->gpu_time_offset = 0;
-                metric_set->gpu_clock_offset = 1;
-                metric_set->a_offset = 2;
-                metric_set->b_offset = metric_set->a_offset + 36;
-                metric_set->c_offset = metric_set->b_offset + 8;
-                metric_set->perfcnt_offset = metric_set->c_offset + 8;
-
-            """))
-
-        c("%s_%s_add_registers(perf, metric_set);" % (gen.chipset, set.underscore_name))
-
-        c("intel_perf_add_metric_set(perf, metric_set);");
-        c("\n")
-
-        c("{")
-        c.indent(4)
-        c("static const struct intel_perf_logical_counter _counters[] = {")
-        c.indent(4)
-
         for counter in counters:
             output_counter_report(set, counter)
         c.outdent(4)
         c("};")
-        c("int i;")
 
-        c("for (i = 0; i < sizeof(_counters) / sizeof(_counters[0]); i++) {")
+    c("\nstatic const struct intel_perf_metric_set_desc " + gen.chipset + "_metric_sets[] = {")
+    c.indent(4)
+    for set in gen.sets:
+        counters = gen.chipset + "_" + set.underscore_name + "_counters"
+
+        c("{")
         c.indent(4)
-        c("if (_counters[i].availability && !_counters[i].availability(perf))")
+        c(".set = {")
         c.indent(4)
-        c("continue;")
+        c(".name = \"" + set.name + "\",")
+        c(".symbol_name = \"" + set.symbol_name + "\",")
+        c(".hw_config_guid = \"" + set.hw_config_guid + "\",")
+        output_metric_set_format(set)
         c.outdent(4)
-        c("counter = &metric_set->counters[metric_set->n_counters++];")
-        c("*counter = _counters[i];")
-        c("counter->metric_set = metric_set;")
-        c("intel_perf_add_logical_counter(perf, counter, counter->group);")
+        c("},")
+        c(".add_registers = %s_%s_add_registers," % (gen.chipset, set.underscore_name))
+        c(".counters = " + counters + ",")
+        c(".n_counters = sizeof(" + counters + ") / sizeof(" + counters + "[0]),")
         c.outdent(4)
-        c("}")
-        c.outdent(4)
-        c("}")
-        c("\nassert(metric_set->n_counters <= {0});\n".format(len(counters)));
+        c("},")
+    c.outdent(4)
+    c("};")
 
-        c.outdent(4)
-        c("}\n")
+    seeds, slots = perfect_hash([set.symbol_name for set in gen.sets])
 
-    c("\nvoid")
-    c("intel_perf_load_metrics_" + gen.chipset + "(struct intel_perf *perf)")
-    c("{")
+    c("\nstatic const uint16_t " + gen.chipset + "_metric_set_seeds[] = {")
     c.indent(4)
+    for i in range(0, len(seeds), 8):
+        c(", ".join(str(seed) for seed in seeds[i:i + 8]) + ",")
+    c.outdent(4)
+    c("};")
 
-    for set in gen.sets:
-        c("{0}_add_{1}_metric_set(perf);".format(gen.chipset, set.underscore_name))
+    c("\nstatic const uint16_t " + gen.chipset + "_metric_set_slots[] = {")
+    c.indent(4)
+    for i in range(0, len(slots), 8):
+        c(", ".join(str(slot) for slot in slots[i:i + 8]) + ",")
+    c.outdent(4)
+    c("};")
 
+    c("\nconst struct intel_perf_metric_set_table intel_perf_metrics_" + gen.chipset + " = {")
+    c.indent(4)
+    c(".sets = " + gen.chipset + "_metric_sets,")
+    c(".n_sets = {0},".format(len(gen.sets)))
+    c(".seeds = " + gen.chipset + "_metric_set_seeds,")
+    c(".slots = " + gen.chipset + "_metric_set_slots,")
     c.outdent(4)
-    c("}")
+    c("};")
 
 
 
@@ -291,8 +324,7 @@ def main():
 
         """ % (header_define, header_define)))
 
-    # Print out all set registration functions for each generation.
-    h("void intel_perf_load_metrics_" + gen.chipset + "(struct intel_perf *perf);\n\n")
+    h("extern const struct intel_perf_metric_set_table intel_perf_metrics_" + gen.chipset + ";\n\n")
 
     h(textwrap.dedent("""\
         #endif /* %s */
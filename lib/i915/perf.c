@@ -21,6 +21,7 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,6 +41,7 @@
 #include "pciids.h"
 #include "i915_pciids_local.h"
 
+#include "igt_x86.h"
 #include "intel_chipset.h"
 #include "perf.h"
 
@@ -258,13 +260,28 @@ is_arl_gt2(const struct intel_perf_devinfo *devinfo)
 	return false;
 }
 
+/**
+ * intel_perf_for_devinfo_lazy:
+ * @device_id: PCI device id
+ * @revision: PCI revision
+ * @timestamp_frequency: OA timestamp frequency, in Hz
+ * @gt_min_freq: minimum GT frequency, in Hz
+ * @gt_max_freq: maximum GT frequency, in Hz
+ * @topology: slice, subslice and EU topology of the device
+ *
+ * Like intel_perf_for_devinfo(), but leaves the metric_sets list empty.
+ * Sets are only built when looked up with intel_perf_find_metric_set(), or
+ * all at once with intel_perf_load_metric_sets().
+ *
+ * Returns: the perf description of the device, or NULL if unsupported.
+ */
 struct intel_perf *
-intel_perf_for_devinfo(uint32_t device_id,
-		       uint32_t revision,
-		       uint64_t timestamp_frequency,
-		       uint64_t gt_min_freq,
-		       uint64_t gt_max_freq,
-		       const struct drm_i915_query_topology_info *topology)
+intel_perf_for_devinfo_lazy(uint32_t device_id,
+			    uint32_t revision,
+			    uint64_t timestamp_frequency,
+			    uint64_t gt_min_freq,
+			    uint64_t gt_max_freq,
+			    const struct drm_i915_query_topology_info *topology)
 {
 	const struct intel_device_info *devinfo = intel_get_device_info(device_id);
 	struct intel_perf *perf;
@@ -359,77 +376,77 @@ intel_perf_for_devinfo(uint32_t device_id,
 	perf->devinfo.oa_timestamp_shift = 0;
 
 	if (devinfo->is_haswell) {
-		intel_perf_load_metrics_hsw(perf);
+		perf->metric_set_table = &intel_perf_metrics_hsw;
 	} else if (devinfo->is_broadwell) {
-		intel_perf_load_metrics_bdw(perf);
+		perf->metric_set_table = &intel_perf_metrics_bdw;
 	} else if (devinfo->is_cherryview) {
-		intel_perf_load_metrics_chv(perf);
+		perf->metric_set_table = &intel_perf_metrics_chv;
 	} else if (devinfo->is_skylake) {
 		switch (devinfo->gt) {
 		case 2:
-			intel_perf_load_metrics_sklgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_sklgt2;
 			break;
 		case 3:
-			intel_perf_load_metrics_sklgt3(perf);
+			perf->metric_set_table = &intel_perf_metrics_sklgt3;
 			break;
 		case 4:
-			intel_perf_load_metrics_sklgt4(perf);
+			perf->metric_set_table = &intel_perf_metrics_sklgt4;
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_broxton) {
 		perf->devinfo.eu_threads_count = 6;
-		intel_perf_load_metrics_bxt(perf);
+		perf->metric_set_table = &intel_perf_metrics_bxt;
 	} else if (devinfo->is_kabylake) {
 		switch (devinfo->gt) {
 		case 2:
-			intel_perf_load_metrics_kblgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_kblgt2;
 			break;
 		case 3:
-			intel_perf_load_metrics_kblgt3(perf);
+			perf->metric_set_table = &intel_perf_metrics_kblgt3;
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_geminilake) {
 		perf->devinfo.eu_threads_count = 6;
-		intel_perf_load_metrics_glk(perf);
+		perf->metric_set_table = &intel_perf_metrics_glk;
 	} else if (devinfo->is_coffeelake || devinfo->is_cometlake) {
 		switch (devinfo->gt) {
 		case 2:
-			intel_perf_load_metrics_cflgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_cflgt2;
 			break;
 		case 3:
-			intel_perf_load_metrics_cflgt3(perf);
+			perf->metric_set_table = &intel_perf_metrics_cflgt3;
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_cannonlake) {
-		intel_perf_load_metrics_cnl(perf);
+		perf->metric_set_table = &intel_perf_metrics_cnl;
 	} else if (devinfo->is_icelake) {
-		intel_perf_load_metrics_icl(perf);
+		perf->metric_set_table = &intel_perf_metrics_icl;
 	} else if (devinfo->is_elkhartlake || devinfo->is_jasperlake) {
-		intel_perf_load_metrics_ehl(perf);
+		perf->metric_set_table = &intel_perf_metrics_ehl;
 	} else if (devinfo->is_tigerlake) {
 		switch (devinfo->gt) {
 		case 1:
-			intel_perf_load_metrics_tglgt1(perf);
+			perf->metric_set_table = &intel_perf_metrics_tglgt1;
 			break;
 		case 2:
-			intel_perf_load_metrics_tglgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_tglgt2;
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_rocketlake) {
-		intel_perf_load_metrics_rkl(perf);
+		perf->metric_set_table = &intel_perf_metrics_rkl;
 	} else if (devinfo->is_dg1) {
-		intel_perf_load_metrics_dg1(perf);
+		perf->metric_set_table = &intel_perf_metrics_dg1;
 	} else if (devinfo->is_alderlake_s || devinfo->is_alderlake_p ||
 		   devinfo->is_raptorlake_s || devinfo->is_alderlake_n) {
-		intel_perf_load_metrics_adl(perf);
+		perf->metric_set_table = &intel_perf_metrics_adl;
 	} else if (devinfo->is_dg2) {
 		perf->devinfo.eu_threads_count = 8;
 		/* OA reports have the timestamp value shifted to the
@@ -440,11 +457,11 @@ intel_perf_for_devinfo(uint32_t device_id,
 		perf->devinfo.oa_timestamp_mask = 0x7fffffff;
 
 		if (is_acm_gt1(&perf->devinfo))
-			intel_perf_load_metrics_acmgt1(perf);
+			perf->metric_set_table = &intel_perf_metrics_acmgt1;
 		else if (is_acm_gt2(&perf->devinfo))
-			intel_perf_load_metrics_acmgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_acmgt2;
 		else if (is_acm_gt3(&perf->devinfo))
-			intel_perf_load_metrics_acmgt3(perf);
+			perf->metric_set_table = &intel_perf_metrics_acmgt3;
 		else
 			return unsupported_i915_perf_platform(perf);
 	} else if (devinfo->is_meteorlake) {
@@ -457,13 +474,13 @@ intel_perf_for_devinfo(uint32_t device_id,
 		perf->devinfo.oa_timestamp_mask = 0x7fffffff;
 
 		if (is_mtl_gt2(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_mtlgt2;
 		else if (is_mtl_gt3(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt3(perf);
+			perf->metric_set_table = &intel_perf_metrics_mtlgt3;
 		else if (is_arl_gt1(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt2(perf);
+			perf->metric_set_table = &intel_perf_metrics_mtlgt2;
 		else if (is_arl_gt2(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt3(perf);
+			perf->metric_set_table = &intel_perf_metrics_mtlgt3;
 		else
 			return unsupported_i915_perf_platform(perf);
 	} else {
@@ -473,6 +490,38 @@ intel_perf_for_devinfo(uint32_t device_id,
 	return perf;
 }
 
+/**
+ * intel_perf_for_devinfo:
+ * @device_id: PCI device id
+ * @revision: PCI revision
+ * @timestamp_frequency: OA timestamp frequency, in Hz
+ * @gt_min_freq: minimum GT frequency, in Hz
+ * @gt_max_freq: maximum GT frequency, in Hz
+ * @topology: slice, subslice and EU topology of the device
+ *
+ * Returns: the perf description of the device with all its metric sets in
+ * the metric_sets list, or NULL if unsupported.
+ */
+struct intel_perf *
+intel_perf_for_devinfo(uint32_t device_id,
+		       uint32_t revision,
+		       uint64_t timestamp_frequency,
+		       uint64_t gt_min_freq,
+		       uint64_t gt_max_freq,
+		       const struct drm_i915_query_topology_info *topology)
+{
+	struct intel_perf *perf;
+
+	perf = intel_perf_for_devinfo_lazy(device_id, revision,
+					   timestamp_frequency,
+					   gt_min_freq, gt_max_freq,
+					   topology);
+	if (perf)
+		intel_perf_load_metric_sets(perf);
+
+	return perf;
+}
+
 static int
 getparam(int drm_fd, uint32_t param, uint32_t *val)
 {
@@ -629,8 +678,18 @@ intel_sysfs_attr_id_to_name(int sysfs_dirfd, intel_sysfs_attr_id id, int gt)
 		intel_sysfs_attr_name[0][id];
 }
 
+/**
+ * intel_perf_for_fd_lazy:
+ * @drm_fd: i915 device
+ * @gt: GT of the device
+ *
+ * Like intel_perf_for_fd(), but only builds metric sets on lookup, see
+ * intel_perf_for_devinfo_lazy().
+ *
+ * Returns: the perf description of the device, or NULL if unsupported.
+ */
 struct intel_perf *
-intel_perf_for_fd(int drm_fd, int gt)
+intel_perf_for_fd_lazy(int drm_fd, int gt)
 {
 	uint32_t device_id;
 	uint32_t device_revision;
@@ -667,17 +726,36 @@ intel_perf_for_fd(int drm_fd, int gt)
 	if (!topology)
 		return NULL;
 
-	ret = intel_perf_for_devinfo(device_id,
-				     device_revision,
-				     timestamp_frequency,
-				     gt_min_freq * 1000000,
-				     gt_max_freq * 1000000,
-				     topology);
+	ret = intel_perf_for_devinfo_lazy(device_id,
+					  device_revision,
+					  timestamp_frequency,
+					  gt_min_freq * 1000000,
+					  gt_max_freq * 1000000,
+					  topology);
 	free(topology);
 
 	return ret;
 }
 
+/**
+ * intel_perf_for_fd:
+ * @drm_fd: i915 device
+ * @gt: GT of the device
+ *
+ * Returns: the perf description of the device with all its metric sets in
+ * the metric_sets list, or NULL if unsupported.
+ */
+struct intel_perf *
+intel_perf_for_fd(int drm_fd, int gt)
+{
+	struct intel_perf *perf = intel_perf_for_fd_lazy(drm_fd, gt);
+
+	if (perf)
+		intel_perf_load_metric_sets(perf);
+
+	return perf;
+}
+
 void
 intel_perf_free(struct intel_perf *perf)
 {
@@ -690,6 +768,7 @@ intel_perf_free(struct intel_perf *perf)
 		intel_perf_metric_set_free(metric_set);
 	}
 
+	free(perf->metric_set_cache);
 	free(perf);
 }
 
@@ -737,6 +816,126 @@ intel_perf_add_metric_set(struct intel_perf *perf,
 	igt_list_add_tail(&metric_set->link, &perf->metric_sets);
 }
 
+/* Must match metric_set_hash() in perf-configs/perf-metricset-codegen.py */
+static uint32_t
+metric_set_hash(const char *name, uint32_t seed)
+{
+	uint32_t hash = 0x811c9dc5 ^ seed;
+
+	for (; *name; name++) {
+		hash ^= tolower((unsigned char)*name);
+		hash *= 0x01000193;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static struct intel_perf_metric_set *
+materialise_metric_set(struct intel_perf *perf, uint32_t idx)
+{
+	const struct intel_perf_metric_set_table *table = perf->metric_set_table;
+	const struct intel_perf_metric_set_desc *desc = &table->sets[idx];
+	struct intel_perf_metric_set *metric_set;
+
+	if (!perf->metric_set_cache) {
+		perf->metric_set_cache = calloc(table->n_sets,
+						sizeof(*perf->metric_set_cache));
+		if (!perf->metric_set_cache)
+			return NULL;
+	}
+
+	if (perf->metric_set_cache[idx])
+		return perf->metric_set_cache[idx];
+
+	metric_set = calloc(1, sizeof(*metric_set));
+	if (!metric_set)
+		return NULL;
+
+	*metric_set = desc->set;
+	metric_set->counters = calloc(desc->n_counters, sizeof(*metric_set->counters));
+	if (!metric_set->counters) {
+		free(metric_set);
+		return NULL;
+	}
+
+	desc->add_registers(perf, metric_set);
+
+	for (int i = 0; i < desc->n_counters; i++) {
+		struct intel_perf_logical_counter *counter;
+
+		if (desc->counters[i].availability &&
+		    !desc->counters[i].availability(perf))
+			continue;
+
+		counter = &metric_set->counters[metric_set->n_counters++];
+		*counter = desc->counters[i];
+		counter->metric_set = metric_set;
+		intel_perf_add_logical_counter(perf, counter, counter->group);
+	}
+
+	/* Keep the list in table order, whatever the lookup order */
+	perf->metric_set_cache[idx] = metric_set;
+	for (uint32_t i = idx + 1; i < table->n_sets; i++) {
+		if (perf->metric_set_cache[i]) {
+			igt_list_add_tail(&metric_set->link,
+					  &perf->metric_set_cache[i]->link);
+			return metric_set;
+		}
+	}
+	intel_perf_add_metric_set(perf, metric_set);
+
+	return metric_set;
+}
+
+/**
+ * intel_perf_find_metric_set:
+ * @perf: perf description of the device
+ * @symbol_name: symbol name of the metric set, case insensitive
+ *
+ * Looks up a metric set of the device and builds its counters on first
+ * use, adding it to @perf's metric_sets list.
+ *
+ * Returns: the metric set, or NULL if the device has no such set.
+ */
+struct intel_perf_metric_set *
+intel_perf_find_metric_set(struct intel_perf *perf, const char *symbol_name)
+{
+	const struct intel_perf_metric_set_table *table = perf->metric_set_table;
+	uint32_t seed, idx;
+
+	if (!table || !table->n_sets)
+		return NULL;
+
+	seed = table->seeds[metric_set_hash(symbol_name, 0) % table->n_sets];
+	idx = table->slots[metric_set_hash(symbol_name, seed) % table->n_sets];
+	if (strcasecmp(table->sets[idx].set.symbol_name, symbol_name))
+		return NULL;
+
+	return materialise_metric_set(perf, idx);
+}
+
+/**
+ * intel_perf_load_metric_sets:
+ * @perf: perf description of the device
+ *
+ * Builds all the metric sets of the device, for users walking the
+ * metric_sets list rather than looking sets up by name.
+ */
+void
+intel_perf_load_metric_sets(struct intel_perf *perf)
+{
+	const struct intel_perf_metric_set_table *table = perf->metric_set_table;
+
+	for (uint32_t i = 0; table && i < table->n_sets; i++)
+		materialise_metric_set(perf, i);
+}
+
 static void
 load_metric_set_config(struct intel_perf_metric_set *metric_set, int drm_fd)
 {
@@ -761,6 +960,26 @@ load_metric_set_config(struct intel_perf_metric_set *metric_set, int drm_fd)
 		metric_set->perf_oa_metrics_set = ret;
 }
 
+static struct intel_perf_metric_set *
+find_metric_set_by_guid(struct intel_perf *perf, const char *guid)
+{
+	const struct intel_perf_metric_set_table *table = perf->metric_set_table;
+
+	for (uint32_t i = 0; table && i < table->n_sets; i++) {
+		if (!strcmp(table->sets[i].set.hw_config_guid, guid))
+			return materialise_metric_set(perf, i);
+	}
+
+	return NULL;
+}
+
+/*
+ * Builds the metric sets the kernel already has a configuration for. Of
+ * the others, only the sets built so far get their configuration added, which
+ * with intel_perf_for_fd() and intel_perf_for_devinfo() is all of them. Users
+ * of the lazy constructors look up the other sets they need before calling
+ * this.
+ */
 void
 intel_perf_load_perf_configs(struct intel_perf *perf, int drm_fd)
 {
@@ -805,12 +1024,9 @@ intel_perf_load_perf_configs(struct intel_perf *perf, int drm_fd)
 		if (!metric_id_read)
 			continue;
 
-		igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
-			if (!strcmp(metric_set->hw_config_guid, entry->d_name)) {
-				metric_set->perf_oa_metrics_set = metric_id;
-				break;
-			}
-		}
+		metric_set = find_metric_set_by_guid(perf, entry->d_name);
+		if (metric_set)
+			metric_set->perf_oa_metrics_set = metric_id;
 	}
 
 	closedir(metrics_dir);
@@ -823,150 +1039,506 @@ intel_perf_load_perf_configs(struct intel_perf *perf, int drm_fd)
 	}
 }
 
-static void
-accumulate_uint32(const uint32_t *report0,
-                  const uint32_t *report1,
-                  uint64_t *deltas)
+/*
+ * Reports are accumulated in blocks of OA_BLOCK pairs: each pair is
+ * expanded into one row of a small tile, which is then transposed into
+ * the per counter columns of struct intel_perf_deltas. The row kernels
+ * below are specialised per report format and per instruction set.
+ */
+#define OA_BLOCK 8
+
+static inline uint64_t
+oa_timestamp32(const uint32_t *start, const uint32_t *end, int shift)
 {
-	*deltas += (uint32_t)(*report1 - *report0);
+	if (shift >= 0)
+		return (uint32_t)((end[1] - start[1]) << shift);
+	else
+		return (end[1] - start[1]) >> -shift;
 }
 
-static void
-accumulate_uint40(int a_index,
-                  const uint32_t *report0,
-                  const uint32_t *report1,
-                  uint64_t *deltas)
+static inline uint64_t
+oa_timestamp64(const uint64_t *start, const uint64_t *end, int shift)
 {
-	const uint8_t *high_bytes0 = (uint8_t *)(report0 + 40);
-	const uint8_t *high_bytes1 = (uint8_t *)(report1 + 40);
-	uint64_t high0 = (uint64_t)(high_bytes0[a_index]) << 32;
-	uint64_t high1 = (uint64_t)(high_bytes1[a_index]) << 32;
-	uint64_t value0 = report0[a_index + 4] | high0;
-	uint64_t value1 = report1[a_index + 4] | high1;
-	uint64_t delta;
-
-	if (value0 > value1)
-		delta = (1ULL << 40) + value1 - value0;
+	if (shift >= 0)
+		return (end[1] - start[1]) << shift;
 	else
-		delta = value1 - value0;
+		return (end[1] - start[1]) >> -shift;
+}
 
-	*deltas += delta;
+static inline __attribute__((always_inline)) void
+accumulate_uint32_scalar(uint64_t *deltas,
+			 const uint32_t *report0,
+			 const uint32_t *report1,
+			 int count)
+{
+	for (int i = 0; i < count; i++)
+		deltas[i] = (uint32_t)(report1[i] - report0[i]);
 }
 
-void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
-				   const struct intel_perf *perf,
-				   const struct intel_perf_metric_set *metric_set,
-				   const struct drm_i915_perf_record_header *record0,
-				   const struct drm_i915_perf_record_header *record1)
+/*
+ * 40 bit A counters: the low 32 bits are at @offset dwords, the high
+ * byte of counter @a_index is in the byte array following dword 40.
+ */
+static inline __attribute__((always_inline)) void
+accumulate_uint40_scalar(uint64_t *deltas, int a_index, int offset,
+			 const uint32_t *report0,
+			 const uint32_t *report1,
+			 int count)
 {
-	const uint32_t *start = (const uint32_t *)(record0 + 1);
-	const uint32_t *end = (const uint32_t *)(record1 + 1);
-	uint64_t *deltas = acc->deltas;
-	int idx = 0;
-	int i;
+	const uint8_t *high_bytes0 = (const uint8_t *)(report0 + 40) + a_index;
+	const uint8_t *high_bytes1 = (const uint8_t *)(report1 + 40) + a_index;
 
-	memset(acc, 0, sizeof(*acc));
+	for (int i = 0; i < count; i++) {
+		uint64_t value0 = report0[offset + i] | (uint64_t)high_bytes0[i] << 32;
+		uint64_t value1 = report1[offset + i] | (uint64_t)high_bytes1[i] << 32;
 
-	switch (metric_set->perf_oa_format) {
-	case I915_OA_FORMAT_A24u40_A14u32_B8_C8:
-		/* timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
-		accumulate_uint32(start + 3, end + 3, deltas + idx++); /* clock */
+		deltas[i] = (value1 - value0) & ((1ULL << 40) - 1);
+	}
+}
 
-		/* 4x 32bit A0-3 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 4 + i, end + 4 + i, deltas + idx++);
+static inline __attribute__((always_inline)) void
+transpose_rows(uint64_t *column, uint32_t stride,
+	       uint64_t tile[OA_BLOCK][INTEL_PERF_MAX_RAW_OA_COUNTERS],
+	       uint32_t rows, int first, int n)
+{
+	column += first * stride;
+	for (int c = first; c < n; c++) {
+		for (uint32_t j = 0; j < rows; j++)
+			column[j] = tile[j][c];
+		column += stride;
+	}
+}
 
-		/* 20x 40bit A4-23 counters... */
-		for (i = 0; i < 20; i++)
-			accumulate_uint40(i + 4, start, end, deltas + idx++);
+static inline __attribute__((always_inline)) void
+transpose_tile_scalar(uint64_t *column, uint32_t stride,
+		      uint64_t tile[OA_BLOCK][INTEL_PERF_MAX_RAW_OA_COUNTERS],
+		      int n)
+{
+	transpose_rows(column, stride, tile, OA_BLOCK, 0, n);
+}
 
-		/* 4x 32bit A24-27 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 28 + i, end + 28 + i, deltas + idx++);
+/*
+ * Expands the report pairs in blocks of OA_BLOCK rows of a tile, which
+ * is then transposed into the @n counter columns of @out.
+ */
+#define OA_BLOCK_KERNEL(fmt, isa, n)					\
+static void								\
+accumulate_##fmt##_##isa(struct intel_perf_deltas *out, int shift,	\
+			 const struct drm_i915_perf_record_header * const *records, \
+			 uint32_t n_deltas)				\
+{									\
+	uint64_t tile[OA_BLOCK][INTEL_PERF_MAX_RAW_OA_COUNTERS];	\
+									\
+	out->n_counters = n;						\
+	for (uint32_t i = 0; i < n_deltas; i += OA_BLOCK) {		\
+		uint32_t rows = n_deltas - i < OA_BLOCK ? n_deltas - i : OA_BLOCK; \
+		uint64_t *column = out->deltas + i;			\
+									\
+		for (uint32_t j = 0; j < rows; j++)			\
+			row_##fmt##_##isa(tile[j],			\
+					  (const uint32_t *)(records[i + j] + 1), \
+					  (const uint32_t *)(records[i + j + 1] + 1), \
+					  shift);			\
+									\
+		if (rows == OA_BLOCK)					\
+			transpose_tile_##isa(column, out->stride, tile, n); \
+		else							\
+			transpose_rows(column, out->stride, tile, rows, 0, n); \
+	}								\
+}
 
-		/* 4x 40bit A28-31 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint40(i + 28, start, end, deltas + idx++);
+/*
+ * Per format row kernels, instantiated once per instruction set @isa
+ * from its accumulate_uint32_<isa>() and accumulate_uint40_<isa>().
+ */
+#define OA_ROW_KERNELS(isa)						\
+static inline __attribute__((always_inline)) void			\
+row_a24u40_a14u32_b8_c8_##isa(uint64_t *d, const uint32_t *s,		\
+			      const uint32_t *e, int shift)		\
+{									\
+	d[0] = oa_timestamp32(s, e, shift);				\
+	accumulate_uint32_##isa(d + 1, s + 3, e + 3, 5); /* clock, A0-3 */ \
+	accumulate_uint40_##isa(d + 6, 4, 8, s, e, 20); /* A4-23 */	\
+	accumulate_uint32_##isa(d + 26, s + 28, e + 28, 4); /* A24-27 */ \
+	accumulate_uint40_##isa(d + 30, 28, 32, s, e, 4); /* A28-31 */	\
+	accumulate_uint32_##isa(d + 34, s + 36, e + 36, 5); /* A32-36 */ \
+	accumulate_uint32_##isa(d + 39, s + 46, e + 46, 1); /* A37 */	\
+	accumulate_uint32_##isa(d + 40, s + 48, e + 48, 16); /* B, C */	\
+}									\
+									\
+static inline __attribute__((always_inline)) void			\
+row_a32u40_a4u32_b8_c8_##isa(uint64_t *d, const uint32_t *s,		\
+			     const uint32_t *e, int shift)		\
+{									\
+	d[0] = oa_timestamp32(s, e, shift);				\
+	accumulate_uint32_##isa(d + 1, s + 3, e + 3, 1); /* clock */	\
+	accumulate_uint40_##isa(d + 2, 0, 4, s, e, 32); /* A0-31 */	\
+	accumulate_uint32_##isa(d + 34, s + 36, e + 36, 4); /* A32-35 */ \
+	accumulate_uint32_##isa(d + 38, s + 48, e + 48, 16); /* B, C */	\
+}									\
+									\
+static inline __attribute__((always_inline)) void			\
+row_a45_b8_c8_##isa(uint64_t *d, const uint32_t *s,			\
+		    const uint32_t *e, int shift)			\
+{									\
+	d[0] = oa_timestamp32(s, e, shift);				\
+	accumulate_uint32_##isa(d + 1, s + 3, e + 3, 61); /* A, B, C */	\
+}									\
+									\
+static inline __attribute__((always_inline)) void			\
+row_mpec8u32_b8_c8_##isa(uint64_t *d, const uint32_t *s,		\
+			 const uint32_t *e, int shift)			\
+{									\
+	const uint64_t *s64 = (const uint64_t *)s;			\
+	const uint64_t *e64 = (const uint64_t *)e;			\
+									\
+	d[0] = oa_timestamp64(s64, e64, shift);				\
+	d[1] = e64[3] - s64[3]; /* clock */				\
+	accumulate_uint32_##isa(d + 2, s + 8, e + 8, 24); /* MPEC, B, C */ \
+}									\
+									\
+OA_BLOCK_KERNEL(a24u40_a14u32_b8_c8, isa, 56)				\
+OA_BLOCK_KERNEL(a32u40_a4u32_b8_c8, isa, 54)				\
+OA_BLOCK_KERNEL(a45_b8_c8, isa, 62)					\
+OA_BLOCK_KERNEL(mpec8u32_b8_c8, isa, 26)				\
+									\
+static void								\
+accumulate_reports_##isa(struct intel_perf_deltas *out,			\
+			 const struct intel_perf *perf,			\
+			 const struct intel_perf_metric_set *metric_set, \
+			 const struct drm_i915_perf_record_header * const *records, \
+			 uint32_t n_deltas)				\
+{									\
+	int shift = perf->devinfo.oa_timestamp_shift;			\
+									\
+	switch (metric_set->perf_oa_format) {				\
+	case I915_OA_FORMAT_A24u40_A14u32_B8_C8:			\
+		accumulate_a24u40_a14u32_b8_c8_##isa(out, shift, records, n_deltas); \
+		break;							\
+	case I915_OAR_FORMAT_A32u40_A4u32_B8_C8:			\
+	case I915_OA_FORMAT_A32u40_A4u32_B8_C8:				\
+		accumulate_a32u40_a4u32_b8_c8_##isa(out, shift, records, n_deltas); \
+		break;							\
+	case I915_OA_FORMAT_A45_B8_C8:					\
+		accumulate_a45_b8_c8_##isa(out, shift, records, n_deltas); \
+		break;							\
+	case I915_OAM_FORMAT_MPEC8u32_B8_C8:				\
+		accumulate_mpec8u32_b8_c8_##isa(out, shift, records, n_deltas); \
+		break;							\
+	default:							\
+		assert(0);						\
+	}								\
+}
 
-		/* 5x 32bit A32-36 counters... */
-		for (i = 0; i < 5; i++)
-			accumulate_uint32(start + 36 + i, end + 36 + i, deltas + idx++);
+OA_ROW_KERNELS(scalar)
 
-		/* 1x 32bit A37 counter... */
-		accumulate_uint32(start + 46, end + 46, deltas + idx++);
+#if defined(__x86_64__) && !defined(__clang__) && defined(__GLIBC__) && !defined(__UCLIBC__)
 
-		/* 8x 32bit B counters + 8x 32bit C counters... */
-		for (i = 0; i < 16; i++)
-			accumulate_uint32(start + 48 + i, end + 48 + i, deltas + idx++);
-		break;
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
 
-	case I915_OAR_FORMAT_A32u40_A4u32_B8_C8:
-	case I915_OA_FORMAT_A32u40_A4u32_B8_C8:
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
-		accumulate_uint32(start + 3, end + 3, deltas + idx++); /* clock */
-
-		/* 32x 40bit A counters... */
-		for (i = 0; i < 32; i++)
-			accumulate_uint40(i, start, end, deltas + idx++);
-
-		/* 4x 32bit A counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 36 + i, end + 36 + i, deltas + idx++);
-
-		/* 8x 32bit B counters + 8x 32bit C counters... */
-		for (i = 0; i < 16; i++)
-			accumulate_uint32(start + 48 + i, end + 48 + i, deltas + idx++);
-		break;
-
-	case I915_OA_FORMAT_A45_B8_C8:
-		/* timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[0] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[0] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
+#include <immintrin.h>
 
-		for (i = 0; i < 61; i++)
-			accumulate_uint32(start + 3 + i, end + 3 + i, deltas + 1 + i);
-		break;
+static inline __attribute__((always_inline)) void
+accumulate_uint32_sse41(uint64_t *deltas,
+			const uint32_t *report0,
+			const uint32_t *report1,
+			int count)
+{
+	int i = 0;
 
-	case I915_OAM_FORMAT_MPEC8u32_B8_C8: {
-		const uint64_t *start64 = (const uint64_t *)(record0 + 1);
-		const uint64_t *end64 = (const uint64_t *)(record1 + 1);
+	for (; i + 4 <= count; i += 4) {
+		__m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(report1 + i)),
+					  _mm_loadu_si128((const __m128i *)(report0 + i)));
 
-		/* 64 bit timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end64[1] - start64[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end64[1] - start64[1]) >> (-perf->devinfo.oa_timestamp_shift);
+		_mm_storeu_si128((__m128i *)(deltas + i), _mm_cvtepu32_epi64(d));
+		_mm_storeu_si128((__m128i *)(deltas + i + 2),
+				 _mm_cvtepu32_epi64(_mm_srli_si128(d, 8)));
+	}
+
+	accumulate_uint32_scalar(deltas + i, report0 + i, report1 + i, count - i);
+}
+
+static inline __m128i load_uint40x2(const uint32_t *low, const uint8_t *high)
+{
+	uint16_t h;
+
+	memcpy(&h, high, sizeof(h));
+
+	return _mm_or_si128(_mm_cvtepu32_epi64(_mm_loadl_epi64((const __m128i *)low)),
+			    _mm_slli_epi64(_mm_cvtepu8_epi64(_mm_cvtsi32_si128(h)), 32));
+}
+
+static inline __attribute__((always_inline)) void
+accumulate_uint40_sse41(uint64_t *deltas, int a_index, int offset,
+			const uint32_t *report0,
+			const uint32_t *report1,
+			int count)
+{
+	const uint8_t *high_bytes0 = (const uint8_t *)(report0 + 40) + a_index;
+	const uint8_t *high_bytes1 = (const uint8_t *)(report1 + 40) + a_index;
+	const __m128i mask = _mm_set1_epi64x((1ULL << 40) - 1);
+
+	for (int i = 0; i < count; i += 2) {
+		__m128i v0 = load_uint40x2(report0 + offset + i, high_bytes0 + i);
+		__m128i v1 = load_uint40x2(report1 + offset + i, high_bytes1 + i);
+
+		_mm_storeu_si128((__m128i *)(deltas + i),
+				 _mm_and_si128(_mm_sub_epi64(v1, v0), mask));
+	}
+}
+
+static inline __attribute__((always_inline)) void
+transpose_tile_sse41(uint64_t *column, uint32_t stride,
+		     uint64_t tile[OA_BLOCK][INTEL_PERF_MAX_RAW_OA_COUNTERS],
+		     int n)
+{
+	int c;
+
+	for (c = 0; c + 2 <= n; c += 2) {
+		for (int j = 0; j < OA_BLOCK; j += 2) {
+			__m128i a = _mm_loadu_si128((const __m128i *)&tile[j][c]);
+			__m128i b = _mm_loadu_si128((const __m128i *)&tile[j + 1][c]);
 
-		/* 64 bit clock */
-		deltas[idx++] += end64[3] - start64[3];
+			_mm_storeu_si128((__m128i *)(column + j),
+					 _mm_unpacklo_epi64(a, b));
+			_mm_storeu_si128((__m128i *)(column + stride + j),
+					 _mm_unpackhi_epi64(a, b));
+		}
+		column += 2 * stride;
+	}
+
+	transpose_rows(column - c * stride, stride, tile, OA_BLOCK, c, n);
+}
 
-		/* 8x 32bit MPEC counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 8 + i, end + 8 + i, deltas + idx++);
+OA_ROW_KERNELS(sse41)
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+static inline __attribute__((always_inline)) void
+accumulate_uint32_avx2(uint64_t *deltas,
+		       const uint32_t *report0,
+		       const uint32_t *report1,
+		       int count)
+{
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i d = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(report1 + i)),
+					     _mm256_loadu_si256((const __m256i *)(report0 + i)));
+
+		_mm256_storeu_si256((__m256i *)(deltas + i),
+				    _mm256_cvtepu32_epi64(_mm256_castsi256_si128(d)));
+		_mm256_storeu_si256((__m256i *)(deltas + i + 4),
+				    _mm256_cvtepu32_epi64(_mm256_extracti128_si256(d, 1)));
+	}
 
-		/* 8x 32bit B counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 16 + i, end + 16 + i, deltas + idx++);
+	for (; i + 4 <= count; i += 4) {
+		__m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(report1 + i)),
+					  _mm_loadu_si128((const __m128i *)(report0 + i)));
 
-		/* 8x 32bit C counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 24 + i, end + 24 + i, deltas + idx++);
+		_mm256_storeu_si256((__m256i *)(deltas + i), _mm256_cvtepu32_epi64(d));
+	}
+
+	accumulate_uint32_scalar(deltas + i, report0 + i, report1 + i, count - i);
+}
+
+static inline __m256i load_uint40x4(const uint32_t *low, const uint8_t *high)
+{
+	uint32_t h;
+
+	memcpy(&h, high, sizeof(h));
+
+	return _mm256_or_si256(_mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)low)),
+			       _mm256_slli_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(h)), 32));
+}
+
+static inline __attribute__((always_inline)) void
+accumulate_uint40_avx2(uint64_t *deltas, int a_index, int offset,
+		       const uint32_t *report0,
+		       const uint32_t *report1,
+		       int count)
+{
+	const uint8_t *high_bytes0 = (const uint8_t *)(report0 + 40) + a_index;
+	const uint8_t *high_bytes1 = (const uint8_t *)(report1 + 40) + a_index;
+	const __m256i mask = _mm256_set1_epi64x((1ULL << 40) - 1);
+
+	for (int i = 0; i < count; i += 4) {
+		__m256i v0 = load_uint40x4(report0 + offset + i, high_bytes0 + i);
+		__m256i v1 = load_uint40x4(report1 + offset + i, high_bytes1 + i);
+
+		_mm256_storeu_si256((__m256i *)(deltas + i),
+				    _mm256_and_si256(_mm256_sub_epi64(v1, v0), mask));
+	}
+}
 
-		break;
+/* 4x4 transposes of 64 bit counters */
+static inline __attribute__((always_inline)) void
+transpose_tile_avx2(uint64_t *column, uint32_t stride,
+		    uint64_t tile[OA_BLOCK][INTEL_PERF_MAX_RAW_OA_COUNTERS],
+		    int n)
+{
+	int c;
+
+	for (c = 0; c + 4 <= n; c += 4) {
+		for (int j = 0; j < OA_BLOCK; j += 4) {
+			__m256i r0 = _mm256_loadu_si256((const __m256i *)&tile[j][c]);
+			__m256i r1 = _mm256_loadu_si256((const __m256i *)&tile[j + 1][c]);
+			__m256i r2 = _mm256_loadu_si256((const __m256i *)&tile[j + 2][c]);
+			__m256i r3 = _mm256_loadu_si256((const __m256i *)&tile[j + 3][c]);
+			__m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+			__m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+			__m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+			__m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+
+			_mm256_storeu_si256((__m256i *)(column + j),
+					    _mm256_permute2x128_si256(t0, t2, 0x20));
+			_mm256_storeu_si256((__m256i *)(column + stride + j),
+					    _mm256_permute2x128_si256(t1, t3, 0x20));
+			_mm256_storeu_si256((__m256i *)(column + 2 * stride + j),
+					    _mm256_permute2x128_si256(t0, t2, 0x31));
+			_mm256_storeu_si256((__m256i *)(column + 3 * stride + j),
+					    _mm256_permute2x128_si256(t1, t3, 0x31));
 		}
-	default:
-		assert(0);
+		column += 4 * stride;
+	}
+
+	transpose_rows(column - c * stride, stride, tile, OA_BLOCK, c, n);
+}
+
+OA_ROW_KERNELS(avx2)
+
+#pragma GCC pop_options
+
+static const struct intel_perf_accumulate_impl accumulate_impls[] = {
+	{ "avx2", accumulate_reports_avx2 },
+	{ "sse4.1", accumulate_reports_sse41 },
+	{ "scalar", accumulate_reports_scalar },
+};
+
+static bool accumulate_impl_supported(const struct intel_perf_accumulate_impl *impl)
+{
+	if (impl->accumulate == accumulate_reports_avx2)
+		return igt_x86_features() & AVX2;
+	if (impl->accumulate == accumulate_reports_sse41)
+		return igt_x86_features() & SSE4_1;
+
+	return true;
+}
+
+/* The PLT is not initialized when ifunc resolvers run, so all external
+ * functions must be inlined with __attribute__((flatten)).
+ */
+__attribute__((flatten))
+static intel_perf_accumulate_fn resolve_accumulate_reports_n(void)
+{
+	if (igt_x86_features() & AVX2)
+		return accumulate_reports_avx2;
+	if (igt_x86_features() & SSE4_1)
+		return accumulate_reports_sse41;
+
+	return accumulate_reports_scalar;
+}
+
+/**
+ * intel_perf_accumulate_reports_n:
+ * @out: destination, with stride >= @n_deltas
+ * @perf: perf description of the device
+ * @metric_set: metric set the reports were captured with
+ * @records: @n_deltas + 1 sample records
+ * @n_deltas: number of consecutive report pairs
+ *
+ * Computes the raw counter deltas between each pair of consecutive
+ * records, records[i] and records[i + 1], into column i of @out.
+ */
+void intel_perf_accumulate_reports_n(struct intel_perf_deltas *out,
+				     const struct intel_perf *perf,
+				     const struct intel_perf_metric_set *metric_set,
+				     const struct drm_i915_perf_record_header * const *records,
+				     uint32_t n_deltas)
+	__attribute__((ifunc("resolve_accumulate_reports_n")));
+
+#else
+
+static const struct intel_perf_accumulate_impl accumulate_impls[] = {
+	{ "scalar", accumulate_reports_scalar },
+};
+
+static bool accumulate_impl_supported(const struct intel_perf_accumulate_impl *impl)
+{
+	return true;
+}
+
+void intel_perf_accumulate_reports_n(struct intel_perf_deltas *out,
+				     const struct intel_perf *perf,
+				     const struct intel_perf_metric_set *metric_set,
+				     const struct drm_i915_perf_record_header * const *records,
+				     uint32_t n_deltas)
+{
+	accumulate_reports_scalar(out, perf, metric_set, records, n_deltas);
+}
+
+#endif
+
+/**
+ * intel_perf_accumulate_impl_get:
+ * @idx: index of the implementation
+ *
+ * Enumerates the implementations of intel_perf_accumulate_reports_n()
+ * usable on this CPU, best first, e.g. for benchmarking them against
+ * each other.
+ *
+ * Returns: the @idx'th usable implementation or NULL past the last one.
+ */
+const struct intel_perf_accumulate_impl *
+intel_perf_accumulate_impl_get(unsigned int idx)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(accumulate_impls); i++) {
+		if (!accumulate_impl_supported(&accumulate_impls[i]))
+			continue;
+
+		if (!idx--)
+			return &accumulate_impls[i];
 	}
 
+	return NULL;
+}
+
+void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
+				   const struct intel_perf *perf,
+				   const struct intel_perf_metric_set *metric_set,
+				   const struct drm_i915_perf_record_header *record0,
+				   const struct drm_i915_perf_record_header *record1)
+{
+	const struct drm_i915_perf_record_header *records[] = { record0, record1 };
+	struct intel_perf_deltas deltas = {
+		.deltas = acc->deltas,
+		.stride = 1,
+	};
+
+	memset(acc, 0, sizeof(*acc));
+	intel_perf_accumulate_reports_n(&deltas, perf, metric_set, records, 1);
+}
+
+/**
+ * intel_perf_deltas_get:
+ * @deltas: deltas filled by intel_perf_accumulate_reports_n()
+ * @index: index of the report pair
+ * @acc: accumulator to fill
+ *
+ * Gathers the raw counter deltas of one report pair, as
+ * intel_perf_accumulate_reports() would have computed them.
+ */
+void intel_perf_deltas_get(const struct intel_perf_deltas *deltas,
+			   uint32_t index,
+			   struct intel_perf_accumulator *acc)
+{
+	memset(acc, 0, sizeof(*acc));
+	for (uint32_t c = 0; c < deltas->n_counters; c++)
+		acc->deltas[c] = deltas->deltas[c * deltas->stride + index];
 }
 
 uint64_t intel_perf_read_record_timestamp(const struct intel_perf *perf,
@@ -200,6 +200,18 @@ struct intel_perf_accumulator {
 	uint64_t deltas[INTEL_PERF_MAX_RAW_OA_COUNTERS];
 };
 
+/*
+ * Deltas of raw performance counters for a series of report pairs, stored
+ * by counter: the delta of counter c for pair i is deltas[c * stride + i].
+ * deltas must hold INTEL_PERF_MAX_RAW_OA_COUNTERS * stride values.
+ */
+struct intel_perf_deltas {
+	uint64_t *deltas;
+	uint32_t stride;
+	/* Number of counters of the report format, set on accumulation. */
+	uint32_t n_counters;
+};
+
 struct intel_perf;
 struct intel_perf_metric_set;
 struct intel_perf_logical_counter {
@@ -280,14 +292,48 @@ struct intel_perf_logical_counter_group {
 	struct igt_list_head link;  /* link for intel_perf_logical_counter_group.groups */
 };
 
+/*
+ * Static description of a metric set, as generated from the XML files.
+ * intel_perf_for_fd() and intel_perf_for_devinfo() materialise all of them
+ * into intel_perf.metric_sets, their _lazy variants only when looked up, see
+ * intel_perf_find_metric_set().
+ */
+struct intel_perf_metric_set_desc {
+	/* Everything but the counters and registers */
+	struct intel_perf_metric_set set;
+
+	void (*add_registers)(struct intel_perf *perf,
+			      struct intel_perf_metric_set *metric_set);
+
+	const struct intel_perf_logical_counter *counters;
+	int n_counters;
+};
+
+struct intel_perf_metric_set_table {
+	const struct intel_perf_metric_set_desc *sets;
+	uint32_t n_sets;
+
+	/* Minimal perfect hash of the case folded symbol names */
+	const uint16_t *seeds;
+	const uint16_t *slots;
+};
+
 struct intel_perf {
 	const char *name;
 
 	struct intel_perf_logical_counter_group *root_group;
 
+	/* Materialised metric sets, in table order */
 	struct igt_list_head metric_sets;
 
 	struct intel_perf_devinfo devinfo;
+
+	/*
+	 * Private, only ever allocated by the constructors below so that
+	 * fields can be appended without breaking the ABI.
+	 */
+	const struct intel_perf_metric_set_table *metric_set_table;
+	struct intel_perf_metric_set **metric_set_cache;
 };
 
 struct drm_i915_perf_record_header;
@@ -325,6 +371,13 @@ struct intel_perf *intel_perf_for_devinfo(uint32_t device_id,
 					  uint64_t gt_min_freq,
 					  uint64_t gt_max_freq,
 					  const struct drm_i915_query_topology_info *topology);
+struct intel_perf *intel_perf_for_fd_lazy(int drm_fd, int gt);
+struct intel_perf *intel_perf_for_devinfo_lazy(uint32_t device_id,
+					       uint32_t revision,
+					       uint64_t timestamp_frequency,
+					       uint64_t gt_min_freq,
+					       uint64_t gt_max_freq,
+					       const struct drm_i915_query_topology_info *topology);
 void intel_perf_free(struct intel_perf *perf);
 
 void intel_perf_add_logical_counter(struct intel_perf *perf,
@@ -334,6 +387,10 @@ void intel_perf_add_logical_counter(struct intel_perf *perf,
 void intel_perf_add_metric_set(struct intel_perf *perf,
 			       struct intel_perf_metric_set *metric_set);
 
+struct intel_perf_metric_set *
+intel_perf_find_metric_set(struct intel_perf *perf, const char *symbol_name);
+void intel_perf_load_metric_sets(struct intel_perf *perf);
+
 void intel_perf_load_perf_configs(struct intel_perf *perf, int drm_fd);
 
 void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
@@ -342,6 +399,30 @@ void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
 				   const struct drm_i915_perf_record_header *record0,
 				   const struct drm_i915_perf_record_header *record1);
 
+void intel_perf_accumulate_reports_n(struct intel_perf_deltas *deltas,
+				     const struct intel_perf *perf,
+				     const struct intel_perf_metric_set *metric_set,
+				     const struct drm_i915_perf_record_header * const *records,
+				     uint32_t n_deltas);
+
+void intel_perf_deltas_get(const struct intel_perf_deltas *deltas,
+			   uint32_t index,
+			   struct intel_perf_accumulator *acc);
+
+typedef void (*intel_perf_accumulate_fn)(struct intel_perf_deltas *deltas,
+					 const struct intel_perf *perf,
+					 const struct intel_perf_metric_set *metric_set,
+					 const struct drm_i915_perf_record_header * const *records,
+					 uint32_t n_deltas);
+
+struct intel_perf_accumulate_impl {
+	const char *name;
+	intel_perf_accumulate_fn accumulate;
+};
+
+const struct intel_perf_accumulate_impl *
+intel_perf_accumulate_impl_get(unsigned int idx);
+
 uint64_t intel_perf_read_record_timestamp(const struct intel_perf *perf,
 					  const struct intel_perf_metric_set *metric_set,
 					  const struct drm_i915_perf_record_header *record);
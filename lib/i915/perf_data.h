@@ -111,6 +111,60 @@ struct intel_perf_record_timestamp_correlation {
 	uint64_t gpu_timestamp;
 } __attribute__((packed));
 
+/* Sidecar index of a recording, usually stored next to it as
+ * <recording>.idx. The header is followed by n_records
+ * intel_perf_index_record, n_timelines intel_perf_index_timeline and
+ * n_correlations intel_perf_record_timestamp_correlation.
+ */
+#define INTEL_PERF_INDEX_MAGIC "i915pidx"
+
+struct intel_perf_index_header {
+	char magic[8];
+
+	/* Version of the index format. */
+	uint32_t version;
+
+#define INTEL_PERF_INDEX_VERSION (1)
+
+	uint32_t n_records;
+	uint32_t n_timelines;
+	uint32_t n_correlations;
+
+	/* Size of the indexed recording, an index for a recording of a
+	 * different size is stale.
+	 */
+	uint64_t data_size;
+
+	/* Offsets of the device info & topology payloads in the
+	 * recording.
+	 */
+	uint64_t device_info_offset;
+	uint64_t topology_offset;
+} __attribute__((packed));
+
+struct intel_perf_index_record {
+	/* Offset of the DRM_I915_PERF_RECORD_SAMPLE in the recording */
+	uint64_t offset;
+
+	/* Correlated CPU timestamp of the report */
+	uint64_t cpu_timestamp;
+} __attribute__((packed));
+
+/* Context switch point, see intel_perf_timeline_item. */
+struct intel_perf_index_timeline {
+	uint64_t ts_start;
+	uint64_t ts_end;
+	uint64_t cpu_ts_start;
+	uint64_t cpu_ts_end;
+
+	uint32_t record_start;
+	uint32_t record_end;
+
+	uint32_t hw_id;
+
+	uint32_t pad;
+} __attribute__((packed));
+
 #ifdef __cplusplus
 };
 #endif
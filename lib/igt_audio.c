@@ -322,18 +322,11 @@ static double hann_window(double v, size_t i, size_t N)
 	return v * 0.5 * (1 - cos(2.0 * M_PI * (double) i / (double) N));
 }
 
-/**
- * Checks that frequencies specified in signal, and only those, are included
- * in the input data.
- *
- * sampling_rate is given in Hz. samples_len is the number of elements in
- * samples.
- */
-bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
-			 int channel, const double *samples, size_t samples_len)
+/* Same as audio_signal_detect(), but transforms @data in place */
+static bool __audio_signal_detect(struct audio_signal *signal,
+				  int sampling_rate, int channel,
+				  double *data, size_t data_len)
 {
-	double *data;
-	size_t data_len = samples_len;
 	size_t bin_power_len = data_len / 2 + 1;
 	double bin_power[bin_power_len];
 	bool detected[FREQS_MAX];
@@ -342,10 +335,6 @@ bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
 	size_t i, j;
 	bool above, success;
 
-	/* gsl will mutate the array in-place, so make a copy */
-	data = malloc(samples_len * sizeof(double));
-	memcpy(data, samples, samples_len * sizeof(double));
-
 	/* Apply a Hann window to the input signal, to reduce frequency leaks
 	 * due to the endpoints of the signal being discontinuous.
 	 *
@@ -361,10 +350,7 @@ bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
 	igt_debug("Allowed freq. error: %d Hz\n", freq_accuracy);
 
 	ret = gsl_fft_real_radix2_transform(data, 1, data_len);
-	if (ret != 0) {
-		free(data);
-		igt_assert(0);
-	}
+	igt_assert(ret == 0);
 
 	/* Compute the power received by every bin of the FFT.
 	 *
@@ -374,13 +360,15 @@ bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
 	 * so their imaginary part isn't stored.
 	 *
 	 * The power is encoded as the magnitude of the complex number and the
-	 * phase is encoded as its angle.
+	 * phase is encoded as its angle. The magnitude of the purely real
+	 * terms is their absolute value, a negative DC offset is as much
+	 * noise as a positive one.
 	 */
-	bin_power[0] = data[0];
+	bin_power[0] = fabs(data[0]);
 	for (i = 1; i < bin_power_len - 1; i++) {
 		bin_power[i] = hypot(data[i], data[data_len - i]);
 	}
-	bin_power[bin_power_len - 1] = data[data_len / 2];
+	bin_power[bin_power_len - 1] = fabs(data[data_len / 2]);
 
 	/* Normalize the power */
 	for (i = 0; i < bin_power_len; i++)
@@ -487,11 +475,469 @@ bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
 		}
 	}
 
+	return success;
+}
+
+/**
+ * Checks that frequencies specified in signal, and only those, are included
+ * in the input data.
+ *
+ * sampling_rate is given in Hz. samples_len is the number of elements in
+ * samples.
+ */
+bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
+			 int channel, const double *samples, size_t samples_len)
+{
+	double *data;
+	bool success;
+
+	/* gsl will mutate the array in-place, so make a copy */
+	data = malloc(samples_len * sizeof(double));
+	memcpy(data, samples, samples_len * sizeof(double));
+
+	success = __audio_signal_detect(signal, sampling_rate, channel,
+					data, samples_len);
+
 	free(data);
 
 	return success;
 }
 
+/**
+ * DETECTOR_NOISE_PROBES: maximum number of Goertzel filters used to sample
+ * the noise band below #MIN_FREQ - 100Hz, which the FFT detector checks bin
+ * by bin.
+ */
+#define DETECTOR_NOISE_PROBES 8
+
+struct audio_detector_probe {
+	double coeff; /* 2 * cos(2 * pi * f / sampling_rate) */
+	int freq; /* Hz */
+	bool noise; /* part of the noise band rather than an expected freq */
+};
+
+/* Goertzel state for one window, see audio_detector_push_sample() */
+struct audio_detector_window {
+	ssize_t pos; /* negative until the window starts */
+	double energy;
+	double *s1, *s2;
+};
+
+struct audio_detector {
+	struct audio_signal *signal;
+	enum audio_detector_backend backend;
+	int sampling_rate;
+	int channel;
+	size_t window_len;
+	size_t hop_len;
+
+	/* Hann window coefficients, shared by all the Goertzel windows */
+	double *hann;
+
+	struct audio_detector_probe probes[FREQS_MAX + DETECTOR_NOISE_PROBES];
+	size_t probes_count;
+
+	/* Goertzel: window_len / hop_len overlapping windows */
+	struct audio_detector_window *windows;
+	size_t windows_count;
+	double *state;
+
+	/* The last window_len samples, and a scratch copy for gsl. Always
+	 * there for FFT, and for Goertzel when window_len is a power of two
+	 * so that the windows it can't clearly accept go through the FFT. */
+	double *history;
+	double *scratch;
+	size_t history_pos;
+	size_t pushed;
+
+	struct audio_detector_stats stats;
+};
+
+/**
+ * audio_detector_init:
+ * @signal: The expected signal
+ * @sampling_rate: The sampling rate of the captured data, in Hz
+ * @channel: The channel of @signal to look for
+ * @window_len: The number of samples analysed at a time
+ * @hop_len: The number of samples between the start of two consecutive
+ * windows, @window_len must be a multiple of it
+ * @backend: The detection algorithm to use
+ *
+ * Create a streaming detector for @signal. Samples are pushed with
+ * audio_detector_push_s32_le() or audio_detector_push() and a verdict is
+ * reached every @hop_len samples once the first @window_len samples have
+ * been received.
+ *
+ * Unlike audio_signal_detect(), the #AUDIO_DETECTOR_GOERTZEL backend only
+ * evaluates the spectrum at the expected frequencies and a handful of noise
+ * band frequencies, with one Goertzel filter each. Unexpected frequencies are
+ * caught by comparing the total energy of the window with the energy
+ * explained by the expected ones. That energy might be spread over the
+ * spectrum without forming any peak, so when @window_len is a power of two
+ * the windows which don't pass every check with some margin are handed over
+ * to the FFT analysis, and both backends reach the same verdicts. Clean
+ * captures rarely need it.
+ *
+ * #AUDIO_DETECTOR_FFT runs the same analysis as audio_signal_detect() on each
+ * window, and requires @window_len to be a power of two.
+ *
+ * Returns: A newly-allocated detector, to be released with
+ * audio_detector_fini().
+ */
+struct audio_detector *audio_detector_init(struct audio_signal *signal,
+					   int sampling_rate, int channel,
+					   size_t window_len, size_t hop_len,
+					   enum audio_detector_backend backend)
+{
+	struct audio_detector *det;
+	struct audio_detector_probe *probe;
+	size_t noise_bins, i, n;
+
+	igt_assert(window_len > 0);
+	igt_assert(hop_len > 0 && window_len % hop_len == 0);
+	igt_assert(channel < signal->channels);
+
+	det = calloc(1, sizeof(*det));
+	igt_assert(det);
+	det->signal = signal;
+	det->backend = backend;
+	det->sampling_rate = sampling_rate;
+	det->channel = channel;
+	det->window_len = window_len;
+	det->hop_len = hop_len;
+
+	if (backend == AUDIO_DETECTOR_FFT)
+		igt_assert((window_len & (window_len - 1)) == 0);
+
+	if ((window_len & (window_len - 1)) == 0) {
+		det->history = calloc(window_len, sizeof(double));
+		det->scratch = malloc(window_len * sizeof(double));
+		igt_assert(det->history && det->scratch);
+	}
+
+	if (backend == AUDIO_DETECTOR_FFT)
+		return det;
+
+	det->hann = malloc(window_len * sizeof(double));
+	igt_assert(det->hann);
+	for (i = 0; i < window_len; i++)
+		det->hann[i] = hann_window(1.0, i, window_len);
+
+	for (i = 0; i < signal->freqs_count; i++) {
+		if (signal->freqs[i].channel >= 0 &&
+		    signal->freqs[i].channel != channel)
+			continue;
+
+		probe = &det->probes[det->probes_count++];
+		probe->freq = signal->freqs[i].freq;
+		probe->coeff = 2 * cos(2.0 * M_PI * probe->freq / sampling_rate);
+	}
+
+	/* Sample the same noise band as the FFT detector, spreading the
+	 * probes over its bins if there are too many of them. The filters
+	 * are tuned to the exact bin frequencies, the rounded down ones are
+	 * only for the logs. */
+	noise_bins = (size_t)(MIN_FREQ - 100) * window_len / sampling_rate + 1;
+	n = noise_bins < DETECTOR_NOISE_PROBES ? noise_bins : DETECTOR_NOISE_PROBES;
+	for (i = 0; i < n; i++) {
+		size_t bin = i * noise_bins / n;
+
+		probe = &det->probes[det->probes_count++];
+		probe->freq = sampling_rate * bin / window_len;
+		probe->coeff = 2 * cos(2.0 * M_PI * bin / window_len);
+		probe->noise = true;
+	}
+
+	det->windows_count = window_len / hop_len;
+	det->windows = calloc(det->windows_count, sizeof(*det->windows));
+	det->state = calloc(2 * det->windows_count * det->probes_count,
+			    sizeof(double));
+	igt_assert(det->windows && det->state);
+	for (i = 0; i < det->windows_count; i++) {
+		det->windows[i].s1 = det->state + 2 * i * det->probes_count;
+		det->windows[i].s2 = det->windows[i].s1 + det->probes_count;
+	}
+
+	audio_detector_reset(det);
+
+	return det;
+}
+
+/**
+ * audio_detector_fini:
+ * @det: The detector to release
+ */
+void audio_detector_fini(struct audio_detector *det)
+{
+	free(det->hann);
+	free(det->windows);
+	free(det->state);
+	free(det->history);
+	free(det->scratch);
+	free(det);
+}
+
+/**
+ * audio_detector_reset:
+ * @det: The target detector
+ *
+ * Drop all the samples pushed so far and clear the statistics.
+ */
+void audio_detector_reset(struct audio_detector *det)
+{
+	size_t i;
+
+	memset(&det->stats, 0, sizeof(det->stats));
+	det->history_pos = 0;
+	det->pushed = 0;
+
+	if (!det->windows)
+		return;
+
+	memset(det->state, 0,
+	       2 * det->windows_count * det->probes_count * sizeof(double));
+	for (i = 0; i < det->windows_count; i++) {
+		det->windows[i].pos = -(ssize_t)(i * det->hop_len);
+		det->windows[i].energy = 0;
+	}
+}
+
+/**
+ * audio_detector_get_stats:
+ * @det: The target detector
+ * @stats: Filled with the detection statistics so far
+ */
+void audio_detector_get_stats(const struct audio_detector *det,
+			      struct audio_detector_stats *stats)
+{
+	*stats = det->stats;
+}
+
+static void audio_detector_record(struct audio_detector *det, bool detected)
+{
+	det->stats.windows++;
+	if (detected) {
+		det->stats.detected++;
+		det->stats.streak++;
+	} else {
+		det->stats.streak = 0;
+	}
+	det->stats.last = detected;
+}
+
+/* FFT verdict for the last window_len samples */
+static bool audio_detector_fft_eval(struct audio_detector *det)
+{
+	size_t n;
+
+	/* Unroll the history, the oldest sample is at history_pos */
+	n = det->window_len - det->history_pos;
+	memcpy(det->scratch, det->history + det->history_pos,
+	       n * sizeof(double));
+	memcpy(det->scratch + n, det->history,
+	       det->history_pos * sizeof(double));
+
+	return __audio_signal_detect(det->signal, det->sampling_rate,
+				     det->channel, det->scratch,
+				     det->window_len);
+}
+
+/*
+ * Goertzel verdict for a full window. All magnitudes are normalized like the
+ * FFT bins in audio_signal_detect() so that the same thresholds apply.
+ *
+ * The filters can't tell where the energy they don't explain sits in the
+ * spectrum, nor whether the expected peaks stand out the way the FFT
+ * detector wants them to. So a window is only accepted here when it passes
+ * every check with some margin, the others are left to the FFT when the
+ * window is still around.
+ */
+static bool audio_detector_goertzel_eval(struct audio_detector *det,
+					 struct audio_detector_window *win)
+{
+	const double N = det->window_len;
+	double power[FREQS_MAX + DETECTOR_NOISE_PROBES];
+	double max = 0, explained = 0, residual, limit;
+	struct audio_detector_probe *probe;
+	bool success = true, clear = true;
+	size_t i;
+
+	for (i = 0; i < det->probes_count; i++) {
+		double s1 = win->s1[i], s2 = win->s2[i];
+		double mag2 = s1 * s1 + s2 * s2 - det->probes[i].coeff * s1 * s2;
+
+		power[i] = 2 * sqrt(fmax(mag2, 0)) / N;
+	}
+
+	for (i = 0; i < det->probes_count; i++) {
+		probe = &det->probes[i];
+
+		if (!probe->noise) {
+			max = fmax(max, power[i]);
+			continue;
+		}
+
+		if (power[i] > NOISE_THRESHOLD) {
+			igt_debug("Noise level too high: freq=%d power=%f\n",
+				  probe->freq, power[i]);
+			success = false;
+		}
+		if (power[i] > NOISE_THRESHOLD / 2)
+			clear = false;
+	}
+
+	/* Like the FFT detector, an expected frequency is found if its power
+	 * is at least half of the strongest one. */
+	for (i = 0; i < det->probes_count; i++) {
+		probe = &det->probes[i];
+		if (probe->noise)
+			continue;
+
+		if (power[i] <= NOISE_THRESHOLD || power[i] < max / 2) {
+			igt_debug("Missing frequency: %d\n", probe->freq);
+			success = false;
+		}
+		if (power[i] <= 2 * NOISE_THRESHOLD || power[i] < max * 3 / 4)
+			clear = false;
+
+		/* The Hann window has a coherent gain of 1/2 and a power
+		 * gain of 3/8, so a sine whose normalized bin power is p has
+		 * an amplitude of 2p and contributes (2p)^2 / 2 * 3N/8 to the
+		 * windowed energy. */
+		explained += 3 * N / 4 * power[i] * power[i];
+	}
+
+	/* Whatever energy is left comes from frequencies we didn't generate,
+	 * either as peaks or spread over the whole spectrum. Anything worth
+	 * more than a sine of half the strongest expected amplitude might be
+	 * a peak the FFT detector would flag. */
+	residual = win->energy - explained;
+	limit = 3 * N / 4 * (max / 2) * (max / 2);
+	if (residual > limit) {
+		igt_debug("Residual energy %f out of %f\n",
+			  residual, win->energy);
+		success = false;
+	}
+	if (residual > limit / 4)
+		clear = false;
+
+	if (clear) {
+		igt_debug("All frequencies detected\n");
+		return true;
+	}
+
+	if (det->history)
+		return audio_detector_fft_eval(det);
+
+	if (success)
+		igt_debug("All frequencies detected\n");
+
+	return success;
+}
+
+static void audio_detector_push_sample(struct audio_detector *det, double v)
+{
+	struct audio_detector_window *win;
+	size_t i, j;
+
+	if (det->history) {
+		det->history[det->history_pos] = v;
+		det->history_pos = (det->history_pos + 1) % det->window_len;
+		det->pushed++;
+	}
+
+	if (det->backend == AUDIO_DETECTOR_FFT) {
+		if (det->pushed < det->window_len ||
+		    (det->pushed - det->window_len) % det->hop_len)
+			return;
+
+		audio_detector_record(det, audio_detector_fft_eval(det));
+		return;
+	}
+
+	for (i = 0; i < det->windows_count; i++) {
+		double x;
+
+		win = &det->windows[i];
+		if (win->pos < 0) {
+			win->pos++;
+			continue;
+		}
+
+		x = v * det->hann[win->pos++];
+		win->energy += x * x;
+		for (j = 0; j < det->probes_count; j++) {
+			double s0 = x + det->probes[j].coeff * win->s1[j] -
+				    win->s2[j];
+
+			win->s2[j] = win->s1[j];
+			win->s1[j] = s0;
+		}
+
+		if (win->pos < det->window_len)
+			continue;
+
+		audio_detector_record(det, audio_detector_goertzel_eval(det, win));
+
+		/* The next window of this slot starts right away, the other
+		 * slots are still hop_len apart from it. */
+		memset(win->s1, 0, 2 * det->probes_count * sizeof(double));
+		win->energy = 0;
+		win->pos = 0;
+	}
+}
+
+/**
+ * audio_detector_push:
+ * @det: The target detector
+ * @samples: Normalized samples of the detector's channel
+ * @samples_len: The number of elements in @samples
+ *
+ * Feed single-channel samples to the detector.
+ *
+ * Returns: the number of windows evaluated while processing @samples.
+ */
+size_t audio_detector_push(struct audio_detector *det,
+			   const double *samples, size_t samples_len)
+{
+	size_t windows = det->stats.windows;
+	size_t i;
+
+	for (i = 0; i < samples_len; i++)
+		audio_detector_push_sample(det, samples[i]);
+
+	return det->stats.windows - windows;
+}
+
+/**
+ * audio_detector_push_s32_le:
+ * @det: The target detector
+ * @src: Interleaved S32_LE samples
+ * @src_len: The number of elements in @src
+ * @n_channels: The number of channels interleaved in @src
+ * @channel: The channel of @src to feed to the detector
+ *
+ * Feed one channel of a multi-channel S32_LE capture to the detector,
+ * without extracting it first like audio_extract_channel_s32_le() does.
+ *
+ * Returns: the number of windows evaluated while processing @src.
+ */
+size_t audio_detector_push_s32_le(struct audio_detector *det,
+				  const int32_t *src, size_t src_len,
+				  int n_channels, int channel)
+{
+	size_t windows = det->stats.windows;
+	size_t i;
+
+	igt_assert(channel < n_channels);
+	igt_assert(src_len % n_channels == 0);
+
+	for (i = channel; i < src_len; i += n_channels)
+		audio_detector_push_sample(det, (double) src[i] / INT32_MAX);
+
+	return det->stats.windows - windows;
+}
+
 /**
  * audio_extract_channel_s32_le: extracts a single channel from a multi-channel
  * S32_LE input buffer.
@@ -657,3 +1103,51 @@ int audio_create_wav_file_s32_le(const char *qualifier, uint32_t sample_rate,
 
 	return fd;
 }
+
+/**
+ * audio_open_wav_file_s32_le:
+ * @path: the WAV file to open
+ * @sample_rate: set to the sample rate of the file, in Hz
+ * @channels: set to the number of channels of the file
+ *
+ * Opens a WAV file written by audio_create_wav_file_s32_le(), so that
+ * captures can be analysed offline.
+ *
+ * Returns: a file descriptor positioned at the start of the interleaved
+ * S32_LE PCM data, or -1 on error.
+ */
+int audio_open_wav_file_s32_le(const char *path, uint32_t *sample_rate,
+			       uint16_t *channels)
+{
+	char header[44];
+	uint16_t format, bits_per_sample;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		igt_warn("open failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (read(fd, header, sizeof(header)) != sizeof(header) ||
+	    memcmp(&header[0], RIFF_TAG, strlen(RIFF_TAG)) ||
+	    memcmp(&header[8], WAVE_TAG, strlen(WAVE_TAG)) ||
+	    memcmp(&header[12], FMT_TAG, strlen(FMT_TAG)) ||
+	    memcmp(&header[36], DATA_TAG, strlen(DATA_TAG))) {
+		igt_warn("%s: not a WAV file\n", path);
+		close(fd);
+		return -1;
+	}
+
+	memcpy(&format, &header[20], sizeof(format));
+	memcpy(channels, &header[22], sizeof(*channels));
+	memcpy(sample_rate, &header[24], sizeof(*sample_rate));
+	memcpy(&bits_per_sample, &header[34], sizeof(bits_per_sample));
+	if (format != 1 || bits_per_sample != 32 || *channels == 0) {
+		igt_warn("%s: not a S32_LE PCM WAV file\n", path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
@@ -35,6 +35,19 @@
 #include <alsa/asoundlib.h>
 
 struct audio_signal;
+struct audio_detector;
+
+enum audio_detector_backend {
+	AUDIO_DETECTOR_GOERTZEL,
+	AUDIO_DETECTOR_FFT,
+};
+
+struct audio_detector_stats {
+	size_t windows; /* number of windows evaluated */
+	size_t detected; /* windows in which the signal was detected */
+	size_t streak; /* consecutive detections, up to the last window */
+	bool last; /* verdict for the last window */
+};
 
 struct audio_signal *audio_signal_init(int channels, int sampling_rate);
 void audio_signal_fini(struct audio_signal *signal);
@@ -46,6 +59,19 @@ void audio_signal_fill(struct audio_signal *signal, double *buffer,
 		       size_t samples);
 bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
 			 int channel, const double *samples, size_t samples_len);
+struct audio_detector *audio_detector_init(struct audio_signal *signal,
+					   int sampling_rate, int channel,
+					   size_t window_len, size_t hop_len,
+					   enum audio_detector_backend backend);
+void audio_detector_fini(struct audio_detector *det);
+void audio_detector_reset(struct audio_detector *det);
+size_t audio_detector_push(struct audio_detector *det,
+			   const double *samples, size_t samples_len);
+size_t audio_detector_push_s32_le(struct audio_detector *det,
+				  const int32_t *src, size_t src_len,
+				  int n_channels, int channel);
+void audio_detector_get_stats(const struct audio_detector *det,
+			      struct audio_detector_stats *stats);
 size_t audio_extract_channel_s32_le(double *dst, size_t dst_cap,
 				    int32_t *src, size_t src_len,
 				    int n_channels, int channel);
@@ -53,5 +79,7 @@ void audio_convert_to(void *dst, double *src, size_t len,
 		      snd_pcm_format_t format);
 int audio_create_wav_file_s32_le(const char *qualifier, uint32_t sample_rate,
 				 uint16_t channels, char **path);
+int audio_open_wav_file_s32_le(const char *path, uint32_t *sample_rate,
+			       uint16_t *channels);
 
 #endif
@@ -0,0 +1,1054 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_benchmark
+ * @short_description: Common harness of the benchmarks
+ * @title: Benchmark harness
+ * @include: igt_benchmark.h
+ *
+ * Measures the results of a benchmark the same way for all of them: each
+ * result is sampled a few times after some warm-up runs, optionally pinned
+ * to a cpu, and samples lying beyond the interquartile fences are rejected
+ * as outliers before summarising the rest with igt_stats.
+ *
+ * The results can be written as JSON, along with the parameters of the
+ * benchmark and the environment it ran in, including the facts gathered by
+ * igt_facts(). The schema is
+ *
+ * |[<!-- language="json" -->
+ * {
+ *	"schema": "igt-benchmark", "version": 1,
+ *	"benchmark": "<name>",
+ *	"params": { "<name>": "<value>", ... },
+ *	"environment": {
+ *		"kernel": "<release>", "machine": "<arch>", "cpu": "<model>",
+ *		"cpus": <n>, "pinned_cpu": <n or -1>,
+ *		"facts": { "<name>": "<value>", ... }
+ *	},
+ *	"results": [ {
+ *		"name": "<name>", "unit": "<unit>", "higher_is_better": <bool>,
+ *		"median": <x>, "mean": <x>, "stddev": <x>,
+ *		"min": <x>, "max": <x>,
+ *		"outliers": <n>, "samples": [ <x>, ... ]
+ *	}, ... ]
+ * }
+ * ]|
+ *
+ * Result files are read back with igt_benchmark_load() and compared with
+ * igt_benchmark_compare(), which only flags changes that are both larger
+ * than a threshold and statistically significant by Welch's t-test.
+ *
+ * A benchmark adds #IGT_BENCHMARK_LONG_OPTIONS to its options and passes
+ * them on:
+ *
+ * |[<!-- language="C" -->
+ *	struct igt_benchmark *b = igt_benchmark_create("example");
+ *
+ *	while ((c = getopt_long(argc, argv, "", options, NULL)) != -1)
+ *		if (igt_benchmark_option(b, c, optarg))
+ *			return 1;
+ *
+ *	r = igt_benchmark_run(b, "op", "ops/s", true, measure, &data);
+ *	printf("%.1f\n", r->median);
+ *
+ *	return igt_benchmark_finish(b) ? 1 : 0;
+ * ]|
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "igt_benchmark.h"
+#include "igt_core.h"
+#include "igt_facts.h"
+#include "igt_stats.h"
+
+#define IGT_BENCHMARK_SCHEMA_VERSION 1
+
+struct param {
+	char *name;
+	char *value;
+};
+
+struct igt_benchmark {
+	char *name;
+	unsigned int warmup;
+	unsigned int repeat;
+	int cpu;
+	char *json;
+
+	struct param *params;
+	unsigned int nr_params;
+
+	struct igt_benchmark_results results;
+};
+
+static void free_results(struct igt_benchmark_results *results)
+{
+	for (unsigned int i = 0; i < results->nr_results; i++) {
+		free(results->results[i].name);
+		free(results->results[i].unit);
+		free(results->results[i].samples);
+	}
+	free(results->results);
+}
+
+/**
+ * igt_benchmark_create:
+ * @name: Name of the benchmark
+ *
+ * Creates the harness of a benchmark, to be configured by
+ * igt_benchmark_option() and freed by igt_benchmark_finish().
+ *
+ * Returns the harness, or NULL if out of memory.
+ */
+struct igt_benchmark *igt_benchmark_create(const char *name)
+{
+	struct igt_benchmark *b;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->name = strdup(name);
+	b->results.benchmark = b->name;
+	b->warmup = 1;
+	b->repeat = 5;
+	b->cpu = -1;
+	if (!b->name) {
+		free(b);
+		return NULL;
+	}
+
+	return b;
+}
+
+/**
+ * igt_benchmark_option:
+ * @b: Benchmark harness
+ * @opt: Option returned by getopt_long()
+ * @arg: Argument of the option
+ *
+ * Applies one of #IGT_BENCHMARK_LONG_OPTIONS.
+ *
+ * Returns 0 on success, -ENOENT if @opt is not one of them and -EINVAL if
+ * @arg is not valid.
+ */
+int igt_benchmark_option(struct igt_benchmark *b, int opt, const char *arg)
+{
+	char *end;
+	long value;
+
+	switch (opt) {
+	case IGT_BENCHMARK_OPT_WARMUP:
+	case IGT_BENCHMARK_OPT_REPEAT:
+	case IGT_BENCHMARK_OPT_CPU:
+		value = strtol(arg, &end, 0);
+		if (end == arg || *end || value < 0 || value > 1000000)
+			return -EINVAL;
+
+		if (opt == IGT_BENCHMARK_OPT_WARMUP)
+			b->warmup = value;
+		else if (opt == IGT_BENCHMARK_OPT_REPEAT && value)
+			b->repeat = value;
+		else if (opt == IGT_BENCHMARK_OPT_CPU && value < CPU_SETSIZE)
+			b->cpu = value;
+		else
+			return -EINVAL;
+		return 0;
+	case IGT_BENCHMARK_OPT_JSON:
+		free(b->json);
+		b->json = strdup(arg);
+		return b->json ? 0 : -ENOMEM;
+	}
+
+	return -ENOENT;
+}
+
+/**
+ * igt_benchmark_param:
+ * @b: Benchmark harness
+ * @name: Name of the parameter
+ * @fmt: printf() format of its value
+ * @...: Arguments of @fmt
+ *
+ * Records a parameter of the benchmark along with its results, such as a
+ * size or a mode given on the command line.
+ */
+void igt_benchmark_param(struct igt_benchmark *b, const char *name,
+			 const char *fmt, ...)
+{
+	struct param *params;
+	char *value, *copy;
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = vasprintf(&value, fmt, ap);
+	va_end(ap);
+	if (ret < 0)
+		return;
+
+	copy = strdup(name);
+	params = realloc(b->params, (b->nr_params + 1) * sizeof(*params));
+	if (!copy || !params) {
+		free(value);
+		free(copy);
+		if (params)
+			b->params = params;
+		return;
+	}
+
+	b->params = params;
+	b->params[b->nr_params++] = (struct param){ copy, value };
+}
+
+/* Median, mean and spread of the samples. */
+static void summarise(struct igt_benchmark_result *r)
+{
+	igt_stats_t stats;
+
+	r->median = r->mean = r->stddev = r->min = r->max = NAN;
+	if (!r->nr_samples)
+		return;
+
+	igt_stats_init_with_size(&stats, r->nr_samples);
+	r->min = r->max = r->samples[0];
+	for (unsigned int i = 0; i < r->nr_samples; i++) {
+		igt_stats_push_float(&stats, r->samples[i]);
+		if (r->samples[i] < r->min)
+			r->min = r->samples[i];
+		if (r->samples[i] > r->max)
+			r->max = r->samples[i];
+	}
+
+	r->median = igt_stats_get_median(&stats);
+	r->mean = igt_stats_get_mean(&stats);
+	r->stddev = r->nr_samples > 1 ? igt_stats_get_std_deviation(&stats) : 0;
+	igt_stats_fini(&stats);
+}
+
+/* Drops the samples beyond 1.5 interquartile ranges of the quartiles. */
+static void reject_outliers(struct igt_benchmark_result *r)
+{
+	double q1, q2, q3, iqr;
+	igt_stats_t stats;
+	unsigned int n = 0;
+
+	if (r->nr_samples < 4)
+		return;
+
+	igt_stats_init_with_size(&stats, r->nr_samples);
+	for (unsigned int i = 0; i < r->nr_samples; i++)
+		igt_stats_push_float(&stats, r->samples[i]);
+	igt_stats_get_quartiles(&stats, &q1, &q2, &q3);
+	igt_stats_fini(&stats);
+
+	iqr = q3 - q1;
+	for (unsigned int i = 0; i < r->nr_samples; i++)
+		if (r->samples[i] >= q1 - 1.5 * iqr &&
+		    r->samples[i] <= q3 + 1.5 * iqr)
+			r->samples[n++] = r->samples[i];
+
+	r->nr_outliers = r->nr_samples - n;
+	r->nr_samples = n;
+}
+
+/**
+ * igt_benchmark_run:
+ * @b: Benchmark harness
+ * @name: What is measured
+ * @unit: Unit of the samples
+ * @higher_is_better: Whether higher samples are improvements
+ * @fn: Takes one sample
+ * @data: Passed on to @fn
+ *
+ * Calls @fn for the warm-up runs, discarding what they return, and then
+ * for each sample, on the cpu asked for if any.
+ *
+ * Returns the result, valid until the next igt_benchmark_run() or
+ * igt_benchmark_finish(), or NULL if out of memory.
+ */
+const struct igt_benchmark_result *
+igt_benchmark_run(struct igt_benchmark *b, const char *name, const char *unit,
+		  bool higher_is_better, double (*fn)(void *data), void *data)
+{
+	struct igt_benchmark_results *results = &b->results;
+	struct igt_benchmark_result *r;
+	cpu_set_t saved, cpus;
+	bool pinned = false;
+
+	r = realloc(results->results,
+		    (results->nr_results + 1) * sizeof(*r));
+	if (!r)
+		return NULL;
+	results->results = r;
+
+	r = &results->results[results->nr_results];
+	*r = (struct igt_benchmark_result){
+		.name = strdup(name),
+		.unit = strdup(unit),
+		.higher_is_better = higher_is_better,
+		.samples = calloc(b->repeat, sizeof(*r->samples)),
+	};
+	if (!r->name || !r->unit || !r->samples) {
+		free(r->name);
+		free(r->unit);
+		free(r->samples);
+		return NULL;
+	}
+	results->nr_results++;
+
+	if (b->cpu >= 0 && !sched_getaffinity(0, sizeof(saved), &saved)) {
+		CPU_ZERO(&cpus);
+		CPU_SET(b->cpu, &cpus);
+		pinned = !sched_setaffinity(0, sizeof(cpus), &cpus);
+		if (!pinned)
+			igt_warn("Failed to pin to cpu %d\n", b->cpu);
+	}
+
+	for (unsigned int i = 0; i < b->warmup; i++)
+		fn(data);
+	for (unsigned int i = 0; i < b->repeat; i++)
+		r->samples[r->nr_samples++] = fn(data);
+
+	if (pinned)
+		sched_setaffinity(0, sizeof(saved), &saved);
+
+	reject_outliers(r);
+	summarise(r);
+
+	return r;
+}
+
+static void json_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void json_number(FILE *f, double value)
+{
+	if (isfinite(value))
+		fprintf(f, "%.17g", value);
+	else
+		fprintf(f, "null");
+}
+
+static void cpu_model(FILE *f)
+{
+	char *line = NULL, *model = NULL;
+	size_t len = 0;
+	FILE *info;
+
+	info = fopen("/proc/cpuinfo", "r");
+	while (info && !model && getline(&line, &len, info) > 0) {
+		if (strncmp(line, "model name", 10))
+			continue;
+
+		model = strchr(line, ':');
+		if (model) {
+			model += strspn(model, ": \t");
+			model[strcspn(model, "\n")] = '\0';
+		}
+	}
+	if (info)
+		fclose(info);
+
+	json_string(f, model ?: "unknown");
+	free(line);
+}
+
+static void write_fact(const igt_fact *fact, void *data)
+{
+	struct {
+		FILE *f;
+		const char *sep;
+	} *out = data;
+
+	fprintf(out->f, "%s\n\t\t\t", out->sep);
+	json_string(out->f, fact->name);
+	fprintf(out->f, ": ");
+	json_string(out->f, fact->value ?: "");
+	out->sep = ",";
+}
+
+static void write_environment(FILE *f, const struct igt_benchmark *b)
+{
+	enum igt_log_level level = igt_log_level;
+	static bool facts_init;
+	struct {
+		FILE *f;
+		const char *sep;
+	} out = { f, "" };
+	struct utsname u;
+
+	if (uname(&u))
+		memset(&u, 0, sizeof(u));
+
+	fprintf(f, "\t\"environment\": {\n\t\t\"kernel\": ");
+	json_string(f, u.release);
+	fprintf(f, ",\n\t\t\"machine\": ");
+	json_string(f, u.machine);
+	fprintf(f, ",\n\t\t\"cpu\": ");
+	cpu_model(f);
+	fprintf(f, ",\n\t\t\"cpus\": %ld,\n\t\t\"pinned_cpu\": %d,\n",
+		sysconf(_SC_NPROCESSORS_ONLN), b->cpu);
+
+	/* The facts are for the file, not for the output of the benchmark. */
+	if (!facts_init) {
+		igt_facts_lists_init();
+		facts_init = true;
+	}
+	igt_log_level = IGT_LOG_WARN;
+	igt_facts(b->name);
+	igt_log_level = level;
+
+	fprintf(f, "\t\t\"facts\": {");
+	igt_facts_for_each(write_fact, &out);
+	fprintf(f, "%s}\n\t},\n", *out.sep ? "\n\t\t" : " ");
+}
+
+static void write_result(FILE *f, const struct igt_benchmark_result *r)
+{
+	fprintf(f, "\t\t{\n\t\t\t\"name\": ");
+	json_string(f, r->name);
+	fprintf(f, ",\n\t\t\t\"unit\": ");
+	json_string(f, r->unit);
+	fprintf(f, ",\n\t\t\t\"higher_is_better\": %s",
+		r->higher_is_better ? "true" : "false");
+
+	fprintf(f, ",\n\t\t\t\"median\": ");
+	json_number(f, r->median);
+	fprintf(f, ",\n\t\t\t\"mean\": ");
+	json_number(f, r->mean);
+	fprintf(f, ",\n\t\t\t\"stddev\": ");
+	json_number(f, r->stddev);
+	fprintf(f, ",\n\t\t\t\"min\": ");
+	json_number(f, r->min);
+	fprintf(f, ",\n\t\t\t\"max\": ");
+	json_number(f, r->max);
+	fprintf(f, ",\n\t\t\t\"outliers\": %u,\n\t\t\t\"samples\": [",
+		r->nr_outliers);
+	for (unsigned int i = 0; i < r->nr_samples; i++) {
+		fprintf(f, i ? ", " : " ");
+		json_number(f, r->samples[i]);
+	}
+	fprintf(f, " ]\n\t\t}");
+}
+
+static int write_json(const struct igt_benchmark *b)
+{
+	FILE *f;
+
+	f = fopen(b->json, "w");
+	if (!f)
+		return -errno;
+
+	fprintf(f, "{\n\t\"schema\": \"igt-benchmark\",\n\t\"version\": %d,\n",
+		IGT_BENCHMARK_SCHEMA_VERSION);
+	fprintf(f, "\t\"benchmark\": ");
+	json_string(f, b->name);
+
+	fprintf(f, ",\n\t\"params\": {");
+	for (unsigned int i = 0; i < b->nr_params; i++) {
+		fprintf(f, "%s\n\t\t", i ? "," : "");
+		json_string(f, b->params[i].name);
+		fprintf(f, ": ");
+		json_string(f, b->params[i].value);
+	}
+	fprintf(f, "%s},\n", b->nr_params ? "\n\t" : " ");
+
+	write_environment(f, b);
+
+	fprintf(f, "\t\"results\": [");
+	for (unsigned int i = 0; i < b->results.nr_results; i++) {
+		fprintf(f, i ? ",\n" : "\n");
+		write_result(f, &b->results.results[i]);
+	}
+	fprintf(f, "%s]\n}\n", b->results.nr_results ? "\n\t" : " ");
+
+	if (fclose(f))
+		return -errno;
+
+	return 0;
+}
+
+/**
+ * igt_benchmark_finish:
+ * @b: Benchmark harness
+ *
+ * Writes the results to the JSON file asked for, if any, and frees @b along
+ * with its results.
+ *
+ * Returns 0 on success or the negative error code of writing the results.
+ */
+int igt_benchmark_finish(struct igt_benchmark *b)
+{
+	int ret = 0;
+
+	if (b->json) {
+		ret = write_json(b);
+		if (ret)
+			igt_warn("Failed to write %s: %s\n",
+				 b->json, strerror(-ret));
+	}
+
+	for (unsigned int i = 0; i < b->nr_params; i++) {
+		free(b->params[i].name);
+		free(b->params[i].value);
+	}
+	free(b->params);
+	free(b->json);
+
+	free_results(&b->results);
+	free(b->name);
+	free(b);
+
+	return ret;
+}
+
+/* Just enough of a JSON reader for the result files. */
+struct reader {
+	const char *ptr, *end;
+};
+
+static void skip_space(struct reader *r)
+{
+	while (r->ptr < r->end && isspace((unsigned char)*r->ptr))
+		r->ptr++;
+}
+
+static bool next_is(struct reader *r, char c)
+{
+	skip_space(r);
+	if (r->ptr < r->end && *r->ptr == c) {
+		r->ptr++;
+		return true;
+	}
+
+	return false;
+}
+
+static bool next_word(struct reader *r, const char *word)
+{
+	size_t len = strlen(word);
+
+	skip_space(r);
+	if ((size_t)(r->end - r->ptr) < len || memcmp(r->ptr, word, len))
+		return false;
+
+	r->ptr += len;
+	return true;
+}
+
+static char *read_string(struct reader *r)
+{
+	char *str, *out;
+
+	if (!next_is(r, '"'))
+		return NULL;
+
+	/* Escapes only ever shrink */
+	str = out = malloc(r->end - r->ptr + 1);
+	if (!str)
+		return NULL;
+
+	while (r->ptr < r->end && *r->ptr != '"') {
+		char c = *r->ptr++;
+
+		if (c == '\\') {
+			if (r->ptr == r->end)
+				break;
+
+			switch ((c = *r->ptr++)) {
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case 'u': {
+				char hex[5] = { };
+				unsigned long code;
+
+				if (r->end - r->ptr < 4)
+					goto err;
+				memcpy(hex, r->ptr, 4);
+				r->ptr += 4;
+				code = strtoul(hex, NULL, 16);
+				c = code < 0x80 ? code : '?';
+				break;
+			}
+			}
+		}
+		*out++ = c;
+	}
+	if (!next_is(r, '"'))
+		goto err;
+
+	*out = '\0';
+	return str;
+
+err:
+	free(str);
+	return NULL;
+}
+
+static bool read_number(struct reader *r, double *value)
+{
+	char buf[64], *end;
+	size_t len = 0;
+
+	skip_space(r);
+	if (next_word(r, "null")) {
+		*value = NAN;
+		return true;
+	}
+
+	while (r->ptr + len < r->end && len < sizeof(buf) - 1 &&
+	       strchr("+-.0123456789eE", r->ptr[len]))
+		len++;
+	memcpy(buf, r->ptr, len);
+	buf[len] = '\0';
+
+	*value = strtod(buf, &end);
+	if (end == buf || *end)
+		return false;
+
+	r->ptr += len;
+	return true;
+}
+
+static bool skip_value(struct reader *r, unsigned int depth)
+{
+	double number;
+	char *str;
+
+	if (depth > 32)
+		return false;
+
+	skip_space(r);
+	if (r->ptr == r->end)
+		return false;
+
+	switch (*r->ptr) {
+	case '"':
+		str = read_string(r);
+		free(str);
+		return str;
+	case '{':
+	case '[': {
+		char close = *r->ptr++ == '{' ? '}' : ']';
+
+		if (next_is(r, close))
+			return true;
+
+		do {
+			if (close == '}') {
+				str = read_string(r);
+				free(str);
+				if (!str || !next_is(r, ':'))
+					return false;
+			}
+			if (!skip_value(r, depth + 1))
+				return false;
+		} while (next_is(r, ','));
+
+		return next_is(r, close);
+	}
+	}
+
+	return next_word(r, "true") || next_word(r, "false") ||
+	       read_number(r, &number);
+}
+
+static bool read_samples(struct reader *r, struct igt_benchmark_result *res)
+{
+	unsigned int max = 0;
+
+	if (!next_is(r, '['))
+		return false;
+	if (next_is(r, ']'))
+		return true;
+
+	do {
+		double value;
+
+		if (!read_number(r, &value))
+			return false;
+
+		if (res->nr_samples == max) {
+			double *samples;
+
+			max = max ? 2 * max : 16;
+			samples = realloc(res->samples,
+					  max * sizeof(*samples));
+			if (!samples)
+				return false;
+			res->samples = samples;
+		}
+		res->samples[res->nr_samples++] = value;
+	} while (next_is(r, ','));
+
+	return next_is(r, ']');
+}
+
+static bool read_result(struct reader *r, struct igt_benchmark_result *res)
+{
+	if (!next_is(r, '{'))
+		return false;
+	if (next_is(r, '}'))
+		goto out;
+
+	do {
+		char *key = read_string(r);
+		bool ok;
+
+		if (!key || !next_is(r, ':')) {
+			free(key);
+			return false;
+		}
+
+		if (!strcmp(key, "name") && !res->name) {
+			ok = (res->name = read_string(r));
+		} else if (!strcmp(key, "unit") && !res->unit) {
+			ok = (res->unit = read_string(r));
+		} else if (!strcmp(key, "higher_is_better")) {
+			res->higher_is_better = next_word(r, "true");
+			ok = res->higher_is_better || next_word(r, "false");
+		} else if (!strcmp(key, "outliers")) {
+			double value;
+
+			ok = read_number(r, &value) && value >= 0;
+			res->nr_outliers = ok ? value : 0;
+		} else if (!strcmp(key, "samples") && !res->samples) {
+			ok = read_samples(r, res);
+		} else {
+			ok = skip_value(r, 0);
+		}
+		free(key);
+
+		if (!ok)
+			return false;
+	} while (next_is(r, ','));
+
+	if (!next_is(r, '}'))
+		return false;
+
+out:
+	if (!res->name || !res->unit)
+		return false;
+
+	/* Recomputed rather than trusted */
+	summarise(res);
+
+	return true;
+}
+
+static bool read_results(struct reader *r, struct igt_benchmark_results *out)
+{
+	if (!next_is(r, '['))
+		return false;
+	if (next_is(r, ']'))
+		return true;
+
+	do {
+		struct igt_benchmark_result *res;
+
+		res = realloc(out->results,
+			      (out->nr_results + 1) * sizeof(*res));
+		if (!res)
+			return false;
+		out->results = res;
+
+		res = &out->results[out->nr_results++];
+		memset(res, 0, sizeof(*res));
+		if (!read_result(r, res))
+			return false;
+	} while (next_is(r, ','));
+
+	return next_is(r, ']');
+}
+
+/**
+ * igt_benchmark_parse:
+ * @json: Results written by igt_benchmark_finish()
+ * @len: Length of @json
+ * @out: Returns the results, to be freed by igt_benchmark_results_free()
+ *
+ * Reads the results of a benchmark back. The summaries are recomputed from
+ * the samples.
+ *
+ * Returns 0 on success, -EPROTO if @json is not of a known schema version,
+ * -EINVAL if it is not valid and -ENOMEM.
+ */
+int igt_benchmark_parse(const char *json, size_t len,
+			struct igt_benchmark_results **out)
+{
+	struct reader r = { json, json + len };
+	struct igt_benchmark_results *results;
+	double version = 0;
+	bool ok = true;
+
+	results = calloc(1, sizeof(*results));
+	if (!results)
+		return -ENOMEM;
+
+	if (!next_is(&r, '{'))
+		goto err;
+
+	if (!next_is(&r, '}')) {
+		do {
+			char *key = read_string(&r);
+
+			if (!key || !next_is(&r, ':')) {
+				free(key);
+				goto err;
+			}
+
+			if (!strcmp(key, "version"))
+				ok = read_number(&r, &version);
+			else if (!strcmp(key, "benchmark") &&
+				 !results->benchmark)
+				ok = (results->benchmark = read_string(&r));
+			else if (!strcmp(key, "results") && !results->results)
+				ok = read_results(&r, results);
+			else
+				ok = skip_value(&r, 0);
+			free(key);
+
+			if (!ok)
+				goto err;
+		} while (next_is(&r, ','));
+
+		if (!next_is(&r, '}'))
+			goto err;
+	}
+
+	skip_space(&r);
+	if (r.ptr != r.end || !results->benchmark)
+		goto err;
+
+	if (version != IGT_BENCHMARK_SCHEMA_VERSION) {
+		igt_benchmark_results_free(results);
+		return -EPROTO;
+	}
+
+	*out = results;
+	return 0;
+
+err:
+	igt_benchmark_results_free(results);
+	return -EINVAL;
+}
+
+/**
+ * igt_benchmark_load:
+ * @filename: File written by a benchmark given --json
+ * @out: Returns the results, to be freed by igt_benchmark_results_free()
+ *
+ * Reads the results of a benchmark back from a file, see
+ * igt_benchmark_parse().
+ *
+ * Returns 0 on success or a negative error code.
+ */
+int igt_benchmark_load(const char *filename,
+		       struct igt_benchmark_results **out)
+{
+	char *json = NULL;
+	size_t len = 0, max = 0;
+	FILE *f;
+	int ret;
+
+	f = fopen(filename, "r");
+	if (!f)
+		return -errno;
+
+	do {
+		if (len == max) {
+			char *ptr;
+
+			max = max ? 2 * max : 65536;
+			ptr = realloc(json, max);
+			if (!ptr) {
+				fclose(f);
+				free(json);
+				return -ENOMEM;
+			}
+			json = ptr;
+		}
+		len += fread(json + len, 1, max - len, f);
+	} while (len == max);
+
+	ret = ferror(f) ? -EIO : igt_benchmark_parse(json, len, out);
+	fclose(f);
+	free(json);
+
+	return ret;
+}
+
+/**
+ * igt_benchmark_results_free:
+ * @results: Results of igt_benchmark_load()
+ *
+ * Frees @results.
+ */
+void igt_benchmark_results_free(struct igt_benchmark_results *results)
+{
+	if (!results)
+		return;
+
+	free_results(results);
+	free(results->benchmark);
+	free(results);
+}
+
+/**
+ * igt_benchmark_find:
+ * @results: Results of a benchmark
+ * @name: Name of the result
+ *
+ * Returns the result named @name, or NULL if there is none.
+ */
+const struct igt_benchmark_result *
+igt_benchmark_find(const struct igt_benchmark_results *results,
+		   const char *name)
+{
+	for (unsigned int i = 0; i < results->nr_results; i++)
+		if (!strcmp(results->results[i].name, name))
+			return &results->results[i];
+
+	return NULL;
+}
+
+/* Continued fraction of the regularized incomplete beta function. */
+static double beta_fraction(double a, double b, double x)
+{
+	const double tiny = 1e-300;
+	double c = 1, d = 1 - (a + b) * x / (a + 1), h;
+
+	if (fabs(d) < tiny)
+		d = tiny;
+	d = 1 / d;
+	h = d;
+
+	for (int m = 1; m <= 300; m++) {
+		double num, delta;
+
+		num = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+		d = 1 + num * d;
+		c = 1 + num / c;
+		d = fabs(d) < tiny ? 1 / tiny : 1 / d;
+		if (fabs(c) < tiny)
+			c = tiny;
+		h *= d * c;
+
+		num = -(a + m) * (a + b + m) * x /
+		      ((a + 2 * m) * (a + 2 * m + 1));
+		d = 1 + num * d;
+		c = 1 + num / c;
+		d = fabs(d) < tiny ? 1 / tiny : 1 / d;
+		if (fabs(c) < tiny)
+			c = tiny;
+		delta = d * c;
+		h *= delta;
+
+		if (fabs(delta - 1) < 1e-12)
+			break;
+	}
+
+	return h;
+}
+
+static double incomplete_beta(double a, double b, double x)
+{
+	double front;
+
+	if (x <= 0)
+		return 0;
+	if (x >= 1)
+		return 1;
+
+	front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) +
+		    a * log(x) + b * log1p(-x));
+
+	if (x < (a + 1) / (a + b + 2))
+		return front * beta_fraction(a, b, x) / a;
+
+	return 1 - front * beta_fraction(b, a, 1 - x) / b;
+}
+
+/* Two sided p-value of Welch's t-test. */
+static double welch_p(const struct igt_benchmark_result *a,
+		      const struct igt_benchmark_result *b)
+{
+	double va, vb, se, t, df;
+
+	if (a->nr_samples < 2 || b->nr_samples < 2)
+		return 1;
+
+	va = a->stddev * a->stddev / a->nr_samples;
+	vb = b->stddev * b->stddev / b->nr_samples;
+	se = va + vb;
+	if (se == 0)
+		return a->mean == b->mean ? 1 : 0;
+
+	t = (a->mean - b->mean) / sqrt(se);
+	df = se * se / (va * va / (a->nr_samples - 1) +
+			vb * vb / (b->nr_samples - 1));
+
+	return incomplete_beta(df / 2, 0.5, df / (df + t * t));
+}
+
+/**
+ * igt_benchmark_compare:
+ * @base: Result to compare against
+ * @result: Result to compare
+ * @alpha: Significance level, such as 0.05
+ * @threshold: Smallest relative change of the medians worth reporting,
+ *	       such as 0.02
+ * @out: Returns the comparison
+ *
+ * Compares @result with @base. A change is only flagged as a regression or
+ * an improvement when the medians differ by more than @threshold and the
+ * samples by Welch's t-test at the @alpha level, so that noisy results do
+ * not get flagged.
+ */
+void igt_benchmark_compare(const struct igt_benchmark_result *base,
+			   const struct igt_benchmark_result *result,
+			   double alpha, double threshold,
+			   struct igt_benchmark_comparison *out)
+{
+	bool flagged, higher;
+
+	memset(out, 0, sizeof(*out));
+	out->change = base->median ? (result->median - base->median) /
+				     fabs(base->median) : 0;
+	out->p = welch_p(base, result);
+
+	flagged = out->p < alpha && fabs(out->change) > threshold;
+	higher = out->change > 0;
+	out->regression = flagged && higher != base->higher_is_better;
+	out->improvement = flagged && higher == base->higher_is_better;
+}
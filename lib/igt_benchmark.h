@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_BENCHMARK_H
+#define IGT_BENCHMARK_H
+
+#include <getopt.h>
+#include <stdbool.h>
+
+/* Long options only, out of the way of the single letter ones */
+enum igt_benchmark_opt {
+	IGT_BENCHMARK_OPT_WARMUP = 0x1000,
+	IGT_BENCHMARK_OPT_REPEAT,
+	IGT_BENCHMARK_OPT_CPU,
+	IGT_BENCHMARK_OPT_JSON,
+};
+
+/**
+ * IGT_BENCHMARK_LONG_OPTIONS:
+ *
+ * Entries for the options of igt_benchmark_option(), to add to the struct
+ * option array given to getopt_long().
+ */
+#define IGT_BENCHMARK_LONG_OPTIONS \
+	{ "warmup", required_argument, NULL, IGT_BENCHMARK_OPT_WARMUP }, \
+	{ "repeat", required_argument, NULL, IGT_BENCHMARK_OPT_REPEAT }, \
+	{ "cpu", required_argument, NULL, IGT_BENCHMARK_OPT_CPU }, \
+	{ "json", required_argument, NULL, IGT_BENCHMARK_OPT_JSON }
+
+/**
+ * IGT_BENCHMARK_USAGE:
+ *
+ * Help text of #IGT_BENCHMARK_LONG_OPTIONS.
+ */
+#define IGT_BENCHMARK_USAGE \
+	"  --warmup=<n>   runs discarded before measuring, default 1\n" \
+	"  --repeat=<n>   samples of each result, default 5\n" \
+	"  --cpu=<n>      pin to a cpu while measuring\n" \
+	"  --json=<file>  write the results as JSON\n"
+
+/**
+ * igt_benchmark_result:
+ * @name: What was measured
+ * @unit: Unit of the samples
+ * @higher_is_better: Whether higher values are improvements
+ * @samples: The samples kept, in the order they were taken
+ * @nr_samples: Number of @samples
+ * @nr_outliers: Number of samples rejected as outliers
+ * @median: Median of @samples
+ * @mean: Mean of @samples
+ * @stddev: Standard deviation of @samples
+ * @min: Smallest of @samples
+ * @max: Largest of @samples
+ */
+struct igt_benchmark_result {
+	char *name;
+	char *unit;
+	bool higher_is_better;
+	double *samples;
+	unsigned int nr_samples;
+	unsigned int nr_outliers;
+	double median, mean, stddev, min, max;
+};
+
+/**
+ * igt_benchmark_results:
+ * @benchmark: Name of the benchmark
+ * @results: Results in the order they were measured
+ * @nr_results: Number of @results
+ */
+struct igt_benchmark_results {
+	char *benchmark;
+	struct igt_benchmark_result *results;
+	unsigned int nr_results;
+};
+
+/**
+ * igt_benchmark_comparison:
+ * @change: Relative change of the median, positive when higher
+ * @p: Probability of the difference of the means being down to chance
+ * @regression: Whether the change is a significant regression
+ * @improvement: Whether the change is a significant improvement
+ */
+struct igt_benchmark_comparison {
+	double change;
+	double p;
+	bool regression;
+	bool improvement;
+};
+
+struct igt_benchmark;
+
+struct igt_benchmark *igt_benchmark_create(const char *name);
+int igt_benchmark_option(struct igt_benchmark *b, int opt, const char *arg);
+void igt_benchmark_param(struct igt_benchmark *b, const char *name,
+			 const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+const struct igt_benchmark_result *
+igt_benchmark_run(struct igt_benchmark *b, const char *name, const char *unit,
+		  bool higher_is_better, double (*fn)(void *data), void *data);
+int igt_benchmark_finish(struct igt_benchmark *b);
+
+int igt_benchmark_parse(const char *json, size_t len,
+			struct igt_benchmark_results **out);
+int igt_benchmark_load(const char *filename,
+		       struct igt_benchmark_results **out);
+void igt_benchmark_results_free(struct igt_benchmark_results *results);
+const struct igt_benchmark_result *
+igt_benchmark_find(const struct igt_benchmark_results *results,
+		   const char *name);
+void igt_benchmark_compare(const struct igt_benchmark_result *base,
+			   const struct igt_benchmark_result *result,
+			   double alpha, double threshold,
+			   struct igt_benchmark_comparison *out);
+
+#endif /* IGT_BENCHMARK_H */
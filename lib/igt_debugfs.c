@@ -117,9 +117,6 @@ char *igt_debugfs_path(int device, char *path, int pathlen)
 	const char *debugfs_root;
 	int idx;
 
-	debugfs_root = igt_debugfs_mount();
-	igt_assert(debugfs_root);
-
 	memset(&st, 0, sizeof(st));
 	if (device != -1) { /* if no fd, we presume we want dri/0 */
 		if (fstat(device, &st)) {
@@ -133,6 +130,9 @@ char *igt_debugfs_path(int device, char *path, int pathlen)
 		}
 	}
 
+	debugfs_root = igt_debugfs_mount();
+	igt_assert(debugfs_root);
+
 	idx = minor(st.st_rdev);
 	snprintf(path, pathlen, "%s/dri/%d/name", debugfs_root, idx);
 	if (stat(path, &st))
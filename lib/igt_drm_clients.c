@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -24,6 +25,199 @@
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
 #endif
 
+#define DRM_MAJOR 226
+
+struct igt_drm_clients_cache {
+	char *proc_root;
+	unsigned int drm_major;
+
+	/* Open addressed hash table, with a power of two size. */
+	unsigned int *index; /* 1 + client array index, 0 for an empty slot. */
+	unsigned int index_size;
+	unsigned int index_used;
+
+	/* fdinfo parser for the engine and region maps the caller passes. */
+	struct igt_drm_fdinfo_parser *parser;
+	const char **name_map;
+	unsigned int map_entries;
+	const char **region_map;
+	unsigned int region_entries;
+
+	/* DRM fdinfo files of one process, parsed in one go. */
+	unsigned int batch_size;
+	unsigned int *minors;
+	struct drm_client_fdinfo *infos;
+	unsigned int *results;
+	const char **paths;
+	char (*path_buf)[64];
+};
+
+static struct igt_drm_clients_cache *get_cache(struct igt_drm_clients *clients)
+{
+	struct igt_drm_clients_cache *cache = clients->cache;
+
+	if (cache)
+		return cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->proc_root = strdup("/proc");
+	cache->drm_major = DRM_MAJOR;
+	if (!cache->proc_root) {
+		free(cache);
+		return NULL;
+	}
+
+	clients->cache = cache;
+
+	return cache;
+}
+
+static void cache_free(struct igt_drm_clients_cache *cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->index);
+	igt_drm_fdinfo_parser_destroy(cache->parser);
+	free(cache->minors);
+	free(cache->infos);
+	free(cache->results);
+	free(cache->paths);
+	free(cache->path_buf);
+	free(cache->proc_root);
+	free(cache);
+}
+
+static bool get_parser(struct igt_drm_clients_cache *cache,
+		       const char **name_map, unsigned int map_entries,
+		       const char **region_map, unsigned int region_entries)
+{
+	if (cache->parser &&
+	    cache->name_map == name_map && cache->map_entries == map_entries &&
+	    cache->region_map == region_map &&
+	    cache->region_entries == region_entries)
+		return true;
+
+	igt_drm_fdinfo_parser_destroy(cache->parser);
+	cache->parser = igt_drm_fdinfo_parser_create(name_map, map_entries,
+						     region_map,
+						     region_entries);
+	cache->name_map = name_map;
+	cache->map_entries = map_entries;
+	cache->region_map = region_map;
+	cache->region_entries = region_entries;
+
+	return cache->parser;
+}
+
+static bool grow_batch(struct igt_drm_clients_cache *cache, unsigned int count)
+{
+	unsigned int size = cache->batch_size ?: 4;
+	struct drm_client_fdinfo *infos;
+	unsigned int *minors, *results;
+	char (*path_buf)[64];
+	const char **paths;
+
+	if (count <= cache->batch_size)
+		return true;
+
+	while (size < count)
+		size *= 2;
+
+	minors = realloc(cache->minors, size * sizeof(*minors));
+	if (minors)
+		cache->minors = minors;
+	infos = realloc(cache->infos, size * sizeof(*infos));
+	if (infos)
+		cache->infos = infos;
+	results = realloc(cache->results, size * sizeof(*results));
+	if (results)
+		cache->results = results;
+	paths = realloc(cache->paths, size * sizeof(*paths));
+	if (paths)
+		cache->paths = paths;
+	path_buf = realloc(cache->path_buf, size * sizeof(*path_buf));
+	if (path_buf)
+		cache->path_buf = path_buf;
+
+	if (!minors || !infos || !results || !paths || !path_buf)
+		return false;
+
+	cache->batch_size = size;
+	for (unsigned int i = 0; i < size; i++)
+		cache->paths[i] = cache->path_buf[i];
+
+	return true;
+}
+
+static unsigned int client_hash(unsigned int drm_minor, unsigned long id)
+{
+	uint64_t h = ((uint64_t)drm_minor << 48 ^ id) * 0x9e3779b97f4a7c15ull;
+
+	return h >> 32;
+}
+
+static void client_index_insert(struct igt_drm_clients_cache *cache,
+				const struct igt_drm_client *client,
+				unsigned int idx)
+{
+	unsigned int i = client_hash(client->drm_minor, client->id) &
+			 (cache->index_size - 1);
+
+	while (cache->index[i])
+		i = (i + 1) & (cache->index_size - 1);
+
+	cache->index[i] = idx + 1;
+	cache->index_used++;
+}
+
+/* Indexes the alive and probed clients, whose order igt_drm_clients_sort changes. */
+static bool client_index_rebuild(struct igt_drm_clients *clients,
+				 unsigned int capacity)
+{
+	struct igt_drm_clients_cache *cache = clients->cache;
+	unsigned int size = 64;
+
+	while (size < 2 * capacity)
+		size *= 2;
+
+	if (size != cache->index_size) {
+		free(cache->index);
+		cache->index = malloc(size * sizeof(*cache->index));
+		if (!cache->index) {
+			cache->index_size = 0;
+			return false;
+		}
+		cache->index_size = size;
+	}
+	memset(cache->index, 0, size * sizeof(*cache->index));
+	cache->index_used = 0;
+
+	for (unsigned int i = 0; i < clients->num_clients; i++) {
+		if (clients->client[i].status != IGT_DRM_CLIENT_FREE)
+			client_index_insert(cache, &clients->client[i], i);
+	}
+
+	return true;
+}
+
+static void client_index_add(struct igt_drm_clients *clients,
+			     struct igt_drm_client *c)
+{
+	struct igt_drm_clients_cache *cache = clients->cache;
+
+	if (!cache || !cache->index_size)
+		return;
+
+	if (2 * (cache->index_used + 1) > cache->index_size)
+		client_index_rebuild(clients, cache->index_used + 1);
+	else
+		client_index_insert(cache, c, c - clients->client);
+}
+
 /**
  * igt_drm_clients_init:
  * @private_data: private data to store in the struct
@@ -52,6 +246,20 @@ igt_drm_clients_find(struct igt_drm_clients *clients,
 	unsigned int start, num;
 	struct igt_drm_client *c;
 
+	if (status != IGT_DRM_CLIENT_FREE && clients->cache &&
+	    clients->cache->index_size) {
+		const struct igt_drm_clients_cache *cache = clients->cache;
+		unsigned int i = client_hash(drm_minor, id) & (cache->index_size - 1);
+
+		for (; cache->index[i]; i = (i + 1) & (cache->index_size - 1)) {
+			c = &clients->client[cache->index[i] - 1];
+			if (c->drm_minor == drm_minor && c->id == id)
+				return c->status == status ? c : NULL;
+		}
+
+		return NULL;
+	}
+
 	start = status == IGT_DRM_CLIENT_FREE ? clients->active_clients : 0; /* Free block at the end. */
 	num = clients->num_clients - start;
 
@@ -236,6 +444,7 @@ igt_drm_client_add(struct igt_drm_clients *clients,
 	assert(c->memory);
 
 	igt_drm_client_update(c, pid, name, info);
+	client_index_add(clients, c);
 }
 
 static
@@ -352,10 +561,40 @@ void igt_drm_clients_free(struct igt_drm_clients *clients)
 	igt_for_each_drm_client(clients, c, tmp)
 		igt_drm_client_free(c, false);
 
+	cache_free(clients->cache);
 	free(clients->client);
 	free(clients);
 }
 
+/**
+ * igt_drm_clients_set_proc:
+ * @clients: Previously initialised clients object
+ * @proc_root: Path to scan instead of /proc
+ * @drm_major: Major number of the DRM character devices, 0 for the default
+ *
+ * Points igt_drm_clients_scan at a different procfs like tree, mainly to
+ * test it against a fake one.
+ *
+ * Returns: 0 on success, -ENOMEM on allocation failure.
+ */
+int igt_drm_clients_set_proc(struct igt_drm_clients *clients,
+			     const char *proc_root, unsigned int drm_major)
+{
+	struct igt_drm_clients_cache *cache = get_cache(clients);
+	char *root = strdup(proc_root);
+
+	if (!cache || !root) {
+		free(root);
+		return -ENOMEM;
+	}
+
+	free(cache->proc_root);
+	cache->proc_root = root;
+	cache->drm_major = drm_major ?: DRM_MAJOR;
+
+	return 0;
+}
+
 static DIR *opendirat(int at, const char *name)
 {
 	DIR *dir;
@@ -422,7 +661,8 @@ static void get_task_data(int pid_dir, unsigned int *pid, char *task, size_t tas
 }
 
 
-static bool is_drm_fd(int fd_dir, const char *name, unsigned int *minor)
+static bool is_drm_fd(int fd_dir, const char *name, unsigned int drm_major,
+		      unsigned int *minor)
 {
 	struct stat stat;
 	int ret;
@@ -431,7 +671,7 @@ static bool is_drm_fd(int fd_dir, const char *name, unsigned int *minor)
 
 	if (ret == 0 &&
 	    (stat.st_mode & S_IFMT) == S_IFCHR &&
-	    major(stat.st_rdev) == 226) {
+	    major(stat.st_rdev) == drm_major) {
 		*minor = minor(stat.st_rdev);
 		return true;
 	}
@@ -439,6 +679,95 @@ static bool is_drm_fd(int fd_dir, const char *name, unsigned int *minor)
 	return false;
 }
 
+/*
+ * There is deliberately no (pid, fd) to DRM minor cache: every file descriptor
+ * is stat()ed again on each scan. A number closed and reopened between two
+ * scans leaves the fd names, the size and the mtime of the fd table as they
+ * were, and the stat() of each fd that would tell is all classifying costs.
+ */
+static void
+scan_pid(struct igt_drm_clients *clients, int proc_fd, const char *pid_name,
+	 bool (*filter_client)(const struct igt_drm_clients *,
+			       const struct drm_client_fdinfo *))
+{
+	struct igt_drm_clients_cache *cache = clients->cache;
+	unsigned int client_pid = 0, count = 0;
+	char client_name[64] = { };
+	struct igt_drm_client *c;
+	struct dirent *dent;
+	char path[64];
+	DIR *fd_dir;
+
+	snprintf(path, sizeof(path), "%s/fd", pid_name);
+	fd_dir = opendirat(proc_fd, path);
+	if (!fd_dir)
+		return;
+
+	while ((dent = readdir(fd_dir)) != NULL) {
+		unsigned int minor;
+
+		if (!isdigit(dent->d_name[0]))
+			continue;
+
+		if (!is_drm_fd(dirfd(fd_dir), dent->d_name, cache->drm_major,
+			       &minor))
+			continue;
+
+		if (!grow_batch(cache, count + 1))
+			break;
+
+		cache->minors[count] = minor;
+		snprintf(cache->path_buf[count++], sizeof(cache->path_buf[0]),
+			 "%s/fdinfo/%s", pid_name, dent->d_name);
+	}
+
+	closedir(fd_dir);
+
+	if (!count)
+		return;
+
+	igt_drm_fdinfo_parse_batch(cache->parser, proc_fd, cache->paths, count,
+				   cache->infos, cache->results);
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct drm_client_fdinfo *info = &cache->infos[i];
+		unsigned int minor = cache->minors[i];
+
+		if (!cache->results[i])
+			continue; /* Closed since, or not a client. */
+
+		if (filter_client && !filter_client(clients, info))
+			continue;
+
+		if (igt_drm_clients_find(clients, IGT_DRM_CLIENT_ALIVE,
+					 minor, info->id))
+			continue; /* Skip duplicate fds. */
+
+		if (!client_pid) {
+			int pid_dir = openat(proc_fd, pid_name,
+					     O_DIRECTORY | O_RDONLY);
+
+			if (pid_dir < 0)
+				return;
+
+			get_task_data(pid_dir, &client_pid, client_name,
+				      sizeof(client_name));
+			close(pid_dir);
+			if (!client_pid)
+				return;
+		}
+
+		c = igt_drm_clients_find(clients, IGT_DRM_CLIENT_PROBE,
+					 minor, info->id);
+		if (!c)
+			igt_drm_client_add(clients, info, client_pid,
+					   client_name, minor);
+		else
+			igt_drm_client_update(c, client_pid,
+					      client_name, info);
+	}
+}
+
 static void clients_update_max_lengths(struct igt_drm_clients *clients)
 {
 	struct igt_drm_client *c;
@@ -481,6 +810,11 @@ static void clients_update_max_lengths(struct igt_drm_clients *clients)
  * If @name_map is not provided engine names will be auto-detected (this is
  * less performant) and indices will correspond with auto-detected names as
  * listed int clients->engines->names[].
+ *
+ * Every file descriptor of every process is looked at on each scan, which file
+ * descriptors are DRM ones is not remembered from one scan to the next. Only
+ * the fdinfo of the DRM ones is read, all of a process in one go, and known
+ * clients are looked up through a hash index.
  */
 struct igt_drm_clients *
 igt_drm_clients_scan(struct igt_drm_clients *clients,
@@ -489,6 +823,7 @@ igt_drm_clients_scan(struct igt_drm_clients *clients,
 		     const char **name_map, unsigned int map_entries,
 		     const char **region_map, unsigned int region_entries)
 {
+	struct igt_drm_clients_cache *cache;
 	struct dirent *proc_dent;
 	struct igt_drm_client *c;
 	bool freed = false;
@@ -510,82 +845,24 @@ igt_drm_clients_scan(struct igt_drm_clients *clients,
 			break; /* Free block at the end of array. */
 	}
 
-	proc_dir = opendir("/proc");
+	cache = get_cache(clients);
+	if (!cache || !client_index_rebuild(clients, clients->num_clients) ||
+	    !get_parser(cache, name_map, map_entries,
+			region_map, region_entries))
+		return clients;
+
+	proc_dir = opendir(cache->proc_root);
 	if (!proc_dir)
 		return clients;
 
 	while ((proc_dent = readdir(proc_dir)) != NULL) {
-		unsigned int client_pid = 0, minor = 0;
-		int pid_dir = -1, fd_dir = -1;
-		struct dirent *fdinfo_dent;
-		char client_name[64] = { };
-		DIR *fdinfo_dir = NULL;
-
 		if (proc_dent->d_type != DT_DIR)
 			continue;
 		if (!isdigit(proc_dent->d_name[0]))
 			continue;
 
-		pid_dir = openat(dirfd(proc_dir), proc_dent->d_name,
-				 O_DIRECTORY | O_RDONLY);
-		if (pid_dir < 0)
-			continue;
-
-		fd_dir = openat(pid_dir, "fd", O_DIRECTORY | O_RDONLY);
-		if (fd_dir < 0)
-			goto next;
-
-		fdinfo_dir = opendirat(pid_dir, "fdinfo");
-		if (!fdinfo_dir)
-			goto next;
-
-		while ((fdinfo_dent = readdir(fdinfo_dir)) != NULL) {
-			struct drm_client_fdinfo info = { };
-
-			if (fdinfo_dent->d_type != DT_REG)
-				continue;
-			if (!isdigit(fdinfo_dent->d_name[0]))
-				continue;
-
-			if (!is_drm_fd(fd_dir, fdinfo_dent->d_name, &minor))
-				continue;
-
-			if (!__igt_parse_drm_fdinfo(dirfd(fdinfo_dir),
-						    fdinfo_dent->d_name, &info,
-						    name_map, map_entries,
-						    region_map, region_entries))
-				continue;
-
-			if (filter_client && !filter_client(clients, &info))
-				continue;
-
-			if (igt_drm_clients_find(clients, IGT_DRM_CLIENT_ALIVE,
-						 minor, info.id))
-				continue; /* Skip duplicate fds. */
-
-			if (!client_pid) {
-				get_task_data(pid_dir, &client_pid, client_name,
-					      sizeof(client_name));
-				assert(client_pid > 0);
-			}
-
-			c = igt_drm_clients_find(clients, IGT_DRM_CLIENT_PROBE,
-						 minor, info.id);
-			if (!c)
-				igt_drm_client_add(clients, &info, client_pid,
-						   client_name, minor);
-			else
-				igt_drm_client_update(c, client_pid,
-						      client_name, &info);
-		}
-
-next:
-		if (fdinfo_dir)
-			closedir(fdinfo_dir);
-		if (fd_dir >= 0)
-			close(fd_dir);
-		if (pid_dir >= 0)
-			close(pid_dir);
+		scan_pid(clients, dirfd(proc_dir), proc_dent->d_name,
+			 filter_client);
 	}
 
 	closedir(proc_dir);
@@ -89,6 +89,8 @@ struct igt_drm_client {
 	struct drm_client_meminfo *memory; /* Array of region memory utilisation as parsed from fdinfo. */
 };
 
+struct igt_drm_clients_cache;
+
 struct igt_drm_clients {
 	unsigned int num_clients;
 	unsigned int active_clients;
@@ -98,6 +100,8 @@ struct igt_drm_clients {
 
 	void *private_data;
 
+	struct igt_drm_clients_cache *cache; /* Private to igt_drm_clients_scan. */
+
 	struct igt_drm_client *client; /* Must be last. */
 };
 
@@ -108,6 +112,9 @@ struct igt_drm_clients {
 struct igt_drm_clients *igt_drm_clients_init(void *private_data);
 void igt_drm_clients_free(struct igt_drm_clients *clients);
 
+int igt_drm_clients_set_proc(struct igt_drm_clients *clients,
+			     const char *proc_root, unsigned int drm_major);
+
 struct igt_drm_clients *
 igt_drm_clients_scan(struct igt_drm_clients *clients,
 		     bool (*filter_client)(const struct igt_drm_clients *,
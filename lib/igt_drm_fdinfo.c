@@ -35,272 +35,588 @@
 #include "drmtest.h"
 
 #include "igt_drm_fdinfo.h"
+/*
+ * Sized well above the maximum number of engines or regions, so that the open
+ * addressed name tables stay sparse.
+ */
+#define FDINFO_NAME_SLOTS 64
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+enum fdinfo_key_type {
+	FDINFO_DRIVER,
+	FDINFO_CLIENT_ID,
+	FDINFO_PDEV,
+	FDINFO_ENGINE_CAPACITY,
+	FDINFO_ENGINE_TIME,
+	FDINFO_CYCLES,
+	FDINFO_TOTAL_CYCLES,
+	FDINFO_TOTAL,
+	FDINFO_SHARED,
+	FDINFO_RESIDENT,
+	FDINFO_PURGEABLE,
+	FDINFO_ACTIVE,
+};
+
+/*
+ * Recognised keys without their "drm-" prefix, grouped by first letter. Keys
+ * ending with a dash are followed by an engine or a region name, and where one
+ * key is a prefix of another the longer one must come first.
+ */
+static const struct fdinfo_key {
+	const char *key;
+	unsigned int len;
+	enum fdinfo_key_type type;
+} fdinfo_keys[] = {
+#define FDINFO_KEY(k, t) { k, sizeof(k) - 1, t }
+	FDINFO_KEY("active-", FDINFO_ACTIVE),
+	FDINFO_KEY("client-id", FDINFO_CLIENT_ID),
+	FDINFO_KEY("cycles-", FDINFO_CYCLES),
+	FDINFO_KEY("driver", FDINFO_DRIVER),
+	FDINFO_KEY("engine-capacity-", FDINFO_ENGINE_CAPACITY),
+	FDINFO_KEY("engine-", FDINFO_ENGINE_TIME),
+	FDINFO_KEY("memory-", FDINFO_RESIDENT), /* amdgpu legacy key */
+	FDINFO_KEY("pdev", FDINFO_PDEV),
+	FDINFO_KEY("purgeable-", FDINFO_PURGEABLE),
+	FDINFO_KEY("resident-", FDINFO_RESIDENT),
+	FDINFO_KEY("shared-", FDINFO_SHARED),
+	FDINFO_KEY("total-cycles-", FDINFO_TOTAL_CYCLES),
+	FDINFO_KEY("total-", FDINFO_TOTAL),
+#undef FDINFO_KEY
+};
+
+struct fdinfo_name {
+	const char *name; /* NULL for an empty slot. */
+	unsigned int len;
+	uint32_t hash;
+	int index;
+};
+
+struct igt_drm_fdinfo_parser {
+	/* Range of fdinfo_keys[] starting with each lower case letter. */
+	uint8_t key_first[26];
+	uint8_t key_count[26];
+
+	const char **engine_map;
+	unsigned int engine_entries;
+	const char **region_map;
+	unsigned int region_entries;
+	struct fdinfo_name engines[FDINFO_NAME_SLOTS];
+	struct fdinfo_name regions[FDINFO_NAME_SLOTS];
+
+	char buf[8192];
+};
+
+struct fdinfo_state {
+	struct drm_client_fdinfo *info;
+	bool engines_found[DRM_CLIENT_FDINFO_MAX_ENGINES];
+	bool regions_found[DRM_CLIENT_FDINFO_MAX_REGIONS];
+	unsigned int good;
+	unsigned int num_capacity;
+};
 
 static size_t read_fdinfo(char *buf, const size_t sz, int at, const char *name)
 {
-	size_t count;
+	ssize_t count;
 	int fd;
 
 	fd = openat(at, name, O_RDONLY);
 	if (fd < 0)
 		return 0;
 
-	count = read(fd, buf, sz - 1);
-	if (count > 0)
-		buf[count - 1] = 0;
+	count = read(fd, buf, sz);
 	close(fd);
 
 	return count > 0 ? count : 0;
 }
 
-static const char *ignore_space(const char *s)
+static uint32_t name_hash(const char *name, unsigned int len)
 {
-	for (; *s && isspace(*s); s++)
+	uint32_t hash = FNV_OFFSET_BASIS;
+
+	while (len--)
+		hash = (hash ^ (uint8_t)*name++) * FNV_PRIME;
+
+	return hash;
+}
+
+static int lookup_name(const struct fdinfo_name *table,
+		       const char *name, unsigned int len, uint32_t hash)
+{
+	unsigned int i;
+
+	for (i = hash & (FDINFO_NAME_SLOTS - 1); table[i].name;
+	     i = (i + 1) & (FDINFO_NAME_SLOTS - 1)) {
+		if (table[i].hash == hash && table[i].len == len &&
+		    !memcmp(table[i].name, name, len))
+			return table[i].index;
+	}
+
+	return -1;
+}
+
+/*
+ * Names which are a prefix of a map entry have always matched it, such as the
+ * xe "system" region with a "system0" map entry, so fall back to that.
+ */
+static int lookup_map(const struct fdinfo_name *table,
+		      const char **map, unsigned int entries,
+		      const char *name, unsigned int len, uint32_t hash)
+{
+	int idx = lookup_name(table, name, len, hash);
+
+	if (idx >= 0)
+		return idx;
+
+	for (unsigned int i = 0; i < entries; i++) {
+		if (map[i] && !strncmp(name, map[i], len))
+			return i;
+	}
+
+	return -1;
+}
+
+static void build_names(struct fdinfo_name *table,
+			const char **map, unsigned int entries)
+{
+	for (unsigned int idx = 0; idx < entries; idx++) {
+		unsigned int len, i;
+		uint32_t hash;
+
+		if (!map[idx])
+			continue;
+
+		len = strlen(map[idx]);
+		hash = name_hash(map[idx], len);
+		if (lookup_name(table, map[idx], len, hash) >= 0)
+			continue; /* First entry wins, as with a linear search. */
+
+		i = hash & (FDINFO_NAME_SLOTS - 1);
+		while (table[i].name)
+			i = (i + 1) & (FDINFO_NAME_SLOTS - 1);
+
+		table[i].name = map[idx];
+		table[i].len = len;
+		table[i].hash = hash;
+		table[i].index = idx;
+	}
+}
+
+static void parser_init(struct igt_drm_fdinfo_parser *parser,
+			const char **name_map, unsigned int map_entries,
+			const char **region_map, unsigned int region_entries)
+{
+	assert(map_entries <= DRM_CLIENT_FDINFO_MAX_ENGINES);
+	assert(region_entries <= DRM_CLIENT_FDINFO_MAX_REGIONS);
+
+	memset(parser->key_count, 0, sizeof(parser->key_count));
+	for (unsigned int i = 0; i < ARRAY_SIZE(fdinfo_keys); i++) {
+		unsigned int letter = fdinfo_keys[i].key[0] - 'a';
+
+		if (!parser->key_count[letter])
+			parser->key_first[letter] = i;
+		parser->key_count[letter]++;
+	}
+
+	memset(parser->engines, 0, sizeof(parser->engines));
+	memset(parser->regions, 0, sizeof(parser->regions));
+
+	parser->engine_map = name_map;
+	parser->engine_entries = map_entries;
+	if (name_map)
+		build_names(parser->engines, name_map, map_entries);
+
+	parser->region_map = region_map;
+	parser->region_entries = region_entries;
+	if (region_map)
+		build_names(parser->regions, region_map, region_entries);
+}
+
+static const char *
+skip_space(const char *s, const char *end)
+{
+	for (; s < end && isspace(*s); s++)
 		;
 
 	return s;
 }
 
-static int parse_engine(const char *name, struct drm_client_fdinfo *info,
-			const char **name_map, unsigned int map_entries,
-			uint64_t *val)
+static const char *
+parse_u64(const char *s, const char *end, uint64_t *val)
+{
+	uint64_t v = 0;
+
+	for (; s < end && *s >= '0' && *s <= '9'; s++)
+		v = v * 10 + (*s - '0');
+	*val = v;
+
+	return s;
+}
+
+static void copy_value(char *dst, size_t size, const char *s, const char *end)
+{
+	size_t len = end - s;
+
+	if (len > size - 1)
+		len = size - 1;
+	memcpy(dst, s, len);
+	dst[len] = '\0';
+}
+
+static int find_engine(const struct igt_drm_fdinfo_parser *parser,
+		       struct drm_client_fdinfo *info,
+		       const char *name, unsigned int len, uint32_t hash)
 {
-	const char *p;
-	size_t name_len;
-	int found = -1;
 	unsigned int i;
 
-	p = strchr(name, ':');
-	if (!p)
-		return -1;
-
-	name_len = p - name;
-	if (name_len < 1)
-		return -1;
-	p++;
-
-	if (name_map) {
-		for (i = 0; i < map_entries; i++) {
-			if (!strncmp(name, name_map[i], name_len)) {
-				found = i;
-				break;
-			}
-		}
-	} else {
-		for (i = 0; i < info->num_engines; i++) {
-			if (!strncmp(name, info->names[i], name_len)) {
-				found = i;
-				break;
-			}
-		}
+	if (parser->engine_map)
+		return lookup_map(parser->engines, parser->engine_map,
+				  parser->engine_entries, name, len, hash);
 
-		if (found < 0) {
-			assert((info->num_engines + 1) < ARRAY_SIZE(info->names));
-			assert(name_len  < sizeof(info->names[0]));
-			memcpy(info->names[info->num_engines], name, name_len);
-			info->names[info->num_engines][name_len] = '\0';
-			found = info->num_engines;
-		}
+	for (i = 0; i < info->num_engines; i++) {
+		if (!memcmp(info->names[i], name, len) && !info->names[i][len])
+			return i;
 	}
 
-	p++;
-	if (found >= 0)
-		*val = strtoull(p, NULL, 10);
+	assert((info->num_engines + 1) < ARRAY_SIZE(info->names));
+	assert(len < sizeof(info->names[0]));
+	memcpy(info->names[info->num_engines], name, len);
+	info->names[info->num_engines][len] = '\0';
 
-	return found;
+	return info->num_engines;
 }
 
-static int parse_region(const char *name, struct drm_client_fdinfo *info,
-			const char **region_map, unsigned int region_entries,
-			uint64_t *val)
+static int find_region(const struct igt_drm_fdinfo_parser *parser,
+		       struct drm_client_fdinfo *info,
+		       const char *name, unsigned int len, uint32_t hash)
 {
-	char *p;
-	ssize_t name_len;
-	int found = -1;
 	unsigned int i;
-
-	p = strchr(name, ':');
-	if (!p)
-		return -1;
-
-	name_len = p - name;
-	if (name_len < 1)
-		return -1;
-
-	p++;
-
-	if (region_map) {
-		for (i = 0; i < region_entries; i++) {
-			if (!strncmp(name, region_map[i], name_len)) {
-				found = i;
-				if (!info->region_names[info->num_regions][0]) {
-					assert(name_len < sizeof(info->region_names[i]));
-					strncpy(info->region_names[i], name, name_len);
-				}
-				break;
-			}
-		}
-	} else {
-		for (i = 0; i < info->num_regions; i++) {
-			if (!strncmp(name, info->region_names[i], name_len)) {
-				found = i;
-				break;
-			}
+	int idx;
+
+	if (parser->region_map) {
+		idx = lookup_map(parser->regions, parser->region_map,
+				 parser->region_entries, name, len, hash);
+		if (idx >= 0 && !info->region_names[idx][0]) {
+			assert(len < sizeof(info->region_names[idx]));
+			memcpy(info->region_names[idx], name, len);
+			info->region_names[idx][len] = '\0';
 		}
 
-		if (found < 0) {
-			assert((info->num_regions + 1) < ARRAY_SIZE(info->region_names));
-			assert((strlen(name) + 1) < sizeof(info->region_names[0]));
-			strncpy(info->region_names[info->num_regions], name, name_len);
-			found = info->num_regions;
-		}
+		return idx;
 	}
 
-	if (found < 0)
-		goto out;
-
-	p++;
-	*val = strtoull(p, &p, 10);
-	p = (char *)ignore_space(p);
-	if (!*p)
-		goto out;
-
-	if (!strcmp(p, "KiB")) {
-		*val *= 1024;
-	} else if (!strcmp(p, "MiB")) {
-		*val *= 1024 * 1024;
-	} else if (!strcmp(p, "GiB")) {
-		*val *= 1024 * 1024 * 1024;
+	for (i = 0; i < info->num_regions; i++) {
+		if (!memcmp(info->region_names[i], name, len) &&
+		    !info->region_names[i][len])
+			return i;
 	}
 
-out:
-	return found;
+	assert((info->num_regions + 1) < ARRAY_SIZE(info->region_names));
+	assert(len < sizeof(info->region_names[0]));
+	memcpy(info->region_names[info->num_regions], name, len);
+	info->region_names[info->num_regions][len] = '\0';
+
+	return info->num_regions;
 }
 
-#define UPDATE_REGION(idx, region, val)					\
-	do {								\
-		if (idx >= 0) {						\
-			info->region_mem[idx].region = val;		\
-			if (!regions_found[idx]) {			\
-				info->num_regions++;			\
-				regions_found[idx] = true;		\
-				if (idx > info->last_region_index)	\
-					info->last_region_index = idx;	\
-			}						\
-		}							\
-	} while (0)
-
-#define UPDATE_ENGINE(idx, member, val, utilization_key)		\
-	do {								\
-		if (idx >= 0) {						\
-			info->member[idx] = val;			\
-			info->utilization_mask |= utilization_key;	\
-			if (!info->capacity[idx])			\
-				info->capacity[idx] = 1;		\
-			if (!engines_found[idx]) {			\
-				info->num_engines++;			\
-				engines_found[idx] = true;		\
-				if (idx > info->last_engine_index)	\
-					info->last_engine_index = idx;	\
-			}						\
-		}							\
-	} while (0)
-
-#define strstartswith(a, b, plen__) ({					\
-		*plen__ = strlen(b);					\
-		strncmp(a, b, *plen__) == 0;				\
-})
+static void update_engine(struct fdinfo_state *state, int idx,
+			  uint64_t *member, uint64_t val,
+			  unsigned int utilization_key)
+{
+	struct drm_client_fdinfo *info = state->info;
+
+	member[idx] = val;
+	info->utilization_mask |= utilization_key;
+	if (!info->capacity[idx])
+		info->capacity[idx] = 1;
+	if (!state->engines_found[idx]) {
+		info->num_engines++;
+		state->engines_found[idx] = true;
+		if (idx > info->last_engine_index)
+			info->last_engine_index = idx;
+	}
+}
 
-unsigned int
-__igt_parse_drm_fdinfo(int dir, const char *fd, struct drm_client_fdinfo *info,
-		       const char **name_map, unsigned int map_entries,
-		       const char **region_map, unsigned int region_entries)
+static void update_region(struct fdinfo_state *state, int idx,
+			  enum fdinfo_key_type type, uint64_t val)
 {
-	bool regions_found[DRM_CLIENT_FDINFO_MAX_REGIONS] = { };
-	bool engines_found[DRM_CLIENT_FDINFO_MAX_ENGINES] = { };
-	unsigned int good = 0, num_capacity = 0;
-	char buf[4096], *_buf = buf;
-	char *l, *ctx = NULL;
+	struct drm_client_fdinfo *info = state->info;
+	struct drm_client_meminfo *mem = &info->region_mem[idx];
+
+	switch (type) {
+	case FDINFO_TOTAL:
+		mem->total = val;
+		break;
+	case FDINFO_SHARED:
+		mem->shared = val;
+		break;
+	case FDINFO_RESIDENT:
+		mem->resident = val;
+		break;
+	case FDINFO_PURGEABLE:
+		mem->purgeable = val;
+		break;
+	case FDINFO_ACTIVE:
+		mem->active = val;
+		break;
+	default:
+		return;
+	}
+
+	if (!state->regions_found[idx]) {
+		info->num_regions++;
+		state->regions_found[idx] = true;
+		if (idx > info->last_region_index)
+			info->last_region_index = idx;
+	}
+}
+
+static const struct fdinfo_key *
+match_key(const struct igt_drm_fdinfo_parser *parser,
+	  const char *l, const char *end)
+{
+	unsigned int letter = (unsigned char)*l - 'a';
+	unsigned int i, last;
+
+	if (letter >= ARRAY_SIZE(parser->key_first))
+		return NULL;
+
+	last = parser->key_first[letter] + parser->key_count[letter];
+	for (i = parser->key_first[letter]; i < last; i++) {
+		const struct fdinfo_key *key = &fdinfo_keys[i];
+
+		/* Leave room for at least the separator after the key. */
+		if (end - l > key->len && !memcmp(l, key->key, key->len))
+			return key;
+	}
+
+	return NULL;
+}
+
+static void parse_line(const struct igt_drm_fdinfo_parser *parser,
+		       struct fdinfo_state *state,
+		       const char *l, const char *end)
+{
+	struct drm_client_fdinfo *info = state->info;
+	const struct fdinfo_key *key;
+	const char *name, *v;
+	uint32_t hash = FNV_OFFSET_BASIS;
+	uint64_t val;
+	int idx;
+
+	if (end - l < 5 || memcmp(l, "drm-", 4))
+		return;
+	l += 4;
+
+	key = match_key(parser, l, end);
+	if (!key)
+		return;
+	name = l + key->len;
+
+	switch (key->type) {
+	case FDINFO_DRIVER:
+		if (*name != ':')
+			return;
+		v = skip_space(name + 1, end);
+		if (v < end) {
+			copy_value(info->driver, sizeof(info->driver), v, end);
+			state->good++;
+		}
+		return;
+	case FDINFO_CLIENT_ID:
+		if (*name != ':')
+			return;
+		v = skip_space(name + 1, end);
+		if (parse_u64(v, end, &val) != v) {
+			info->id = val;
+			state->good++;
+		}
+		return;
+	case FDINFO_PDEV:
+		if (*name != ':')
+			return;
+		v = skip_space(name + 1, end);
+		copy_value(info->pdev, sizeof(info->pdev), v, end);
+		return;
+	default:
+		break;
+	}
+
+	/* The engine or region name, hashed on the way to the separator. */
+	for (v = name; v < end && *v != ':'; v++)
+		hash = (hash ^ (uint8_t)*v) * FNV_PRIME;
+	if (v == end || v == name)
+		return;
+
+	switch (key->type) {
+	case FDINFO_ENGINE_CAPACITY:
+	case FDINFO_ENGINE_TIME:
+	case FDINFO_CYCLES:
+	case FDINFO_TOTAL_CYCLES:
+		idx = find_engine(parser, info, name, v - name, hash);
+		if (idx < 0)
+			return;
+
+		parse_u64(skip_space(v + 1, end), end, &val);
+		if (key->type == FDINFO_ENGINE_CAPACITY) {
+			info->capacity[idx] = val;
+			state->num_capacity++;
+		} else if (key->type == FDINFO_ENGINE_TIME) {
+			update_engine(state, idx, info->engine_time, val,
+				      DRM_FDINFO_UTILIZATION_ENGINE_TIME);
+		} else if (key->type == FDINFO_CYCLES) {
+			update_engine(state, idx, info->cycles, val,
+				      DRM_FDINFO_UTILIZATION_CYCLES);
+		} else {
+			update_engine(state, idx, info->total_cycles, val,
+				      DRM_FDINFO_UTILIZATION_TOTAL_CYCLES);
+		}
+		break;
+	default:
+		idx = find_region(parser, info, name, v - name, hash);
+		if (idx < 0)
+			return;
+
+		v = parse_u64(skip_space(v + 1, end), end, &val);
+		v = skip_space(v, end);
+		if (end - v == 3) {
+			if (!memcmp(v, "KiB", 3))
+				val *= 1024;
+			else if (!memcmp(v, "MiB", 3))
+				val *= 1024 * 1024;
+			else if (!memcmp(v, "GiB", 3))
+				val *= 1024 * 1024 * 1024;
+		}
+		update_region(state, idx, key->type, val);
+		break;
+	}
+}
+
+static unsigned int
+parse_fdinfo(struct igt_drm_fdinfo_parser *parser, int dir, const char *fd,
+	     struct drm_client_fdinfo *info)
+{
+	struct fdinfo_state state = { .info = info };
+	const char *l, *end;
 	size_t count;
 
-	count = read_fdinfo(buf, sizeof(buf), dir, fd);
+	count = read_fdinfo(parser->buf, sizeof(parser->buf), dir, fd);
 	if (!count)
 		return 0;
 
-	while ((l = strtok_r(_buf, "\n", &ctx))) {
-		uint64_t val = 0;
-		size_t keylen;
-		const char *v;
-		char *end_ptr;
-		int idx;
-
-		_buf = NULL;
-
-		if (strstartswith(l, "drm-driver:", &keylen)) {
-			v = ignore_space(l + keylen);
-			if (*v) {
-				strncpy(info->driver, v, sizeof(info->driver) - 1);
-				good++;
-			}
-		}  else if (strstartswith(l, "drm-client-id:", &keylen)) {
-			v = l + keylen;
-			info->id = strtol(v, &end_ptr, 10);
-			if (end_ptr != v)
-				good++;
-		} else if (strstartswith(l, "drm-pdev:", &keylen)) {
-			v = ignore_space(l + keylen);
-			strncpy(info->pdev, v, sizeof(info->pdev) - 1);
-		} else if (strstartswith(l, "drm-engine-capacity-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			if (idx >= 0) {
-				info->capacity[idx] = val;
-				num_capacity++;
-			}
-		} else if (strstartswith(l, "drm-engine-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			UPDATE_ENGINE(idx, engine_time, val, DRM_FDINFO_UTILIZATION_ENGINE_TIME);
-		} else if (strstartswith(l, "drm-cycles-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			UPDATE_ENGINE(idx, cycles, val, DRM_FDINFO_UTILIZATION_CYCLES);
-		} else if (strstartswith(l, "drm-total-cycles-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			UPDATE_ENGINE(idx, total_cycles, val, DRM_FDINFO_UTILIZATION_TOTAL_CYCLES);
-		} else if (strstartswith(l, "drm-total-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, total, val);
-		} else if (strstartswith(l, "drm-shared-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, shared, val);
-		} else if (strstartswith(l, "drm-resident-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, resident, val);
-		} else if (strstartswith(l, "drm-memory-", &keylen)) {
-			/* amdgpu legacy key */
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, resident, val);
-		} else if (strstartswith(l, "drm-purgeable-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, purgeable, val);
-		} else if (strstartswith(l, "drm-active-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, active, val);
-		}
+	end = parser->buf + count;
+	for (l = parser->buf; l < end; ) {
+		const char *eol = memchr(l, '\n', end - l);
+
+		if (!eol)
+			eol = end;
+		parse_line(parser, &state, l, eol);
+		l = eol + 1;
 	}
 
-	if (good < 2 || (!info->num_engines && !info->num_regions))
+	if (state.good < 2 || (!info->num_engines && !info->num_regions))
 		return 0; /* fdinfo format not as expected */
 
-	return good + info->num_engines + num_capacity + info->num_regions;
+	return state.good + info->num_engines + state.num_capacity +
+	       info->num_regions;
+}
+
+/**
+ * igt_drm_fdinfo_parser_create:
+ * @name_map: Optional array of strings representing engine names
+ * @map_entries: Number of strings in the names array
+ * @region_map: Optional array of strings representing memory regions
+ * @region_entries: Number of strings in the region map
+ *
+ * Builds the key and name lookup tables once, for parsing any number of
+ * fdinfo files with igt_drm_fdinfo_parse() or igt_drm_fdinfo_parse_batch().
+ * The maps are referenced, not copied, and must outlive the parser.
+ *
+ * Returns the parser, or NULL on allocation failure.
+ */
+struct igt_drm_fdinfo_parser *
+igt_drm_fdinfo_parser_create(const char **name_map, unsigned int map_entries,
+			     const char **region_map, unsigned int region_entries)
+{
+	struct igt_drm_fdinfo_parser *parser = malloc(sizeof(*parser));
+
+	if (parser)
+		parser_init(parser, name_map, map_entries,
+			    region_map, region_entries);
+
+	return parser;
+}
+
+/**
+ * igt_drm_fdinfo_parser_destroy:
+ * @parser: Parser to free, may be NULL
+ */
+void igt_drm_fdinfo_parser_destroy(struct igt_drm_fdinfo_parser *parser)
+{
+	free(parser);
+}
+
+/**
+ * igt_drm_fdinfo_parse:
+ * @parser: Parser from igt_drm_fdinfo_parser_create()
+ * @dir: File descriptor pointing to a /proc/<pid>/fdinfo directory, or any
+ *	 directory @fd is relative to
+ * @fd: Path of the fdinfo file to parse, relative to @dir
+ * @info: Structure to populate with read data. Must be zeroed.
+ *
+ * Like __igt_parse_drm_fdinfo(), with the maps the parser was created with.
+ *
+ * Returns the number of valid drm fdinfo keys found or zero if not all
+ * mandatory keys were present or no engines found.
+ */
+unsigned int
+igt_drm_fdinfo_parse(struct igt_drm_fdinfo_parser *parser, int dir,
+		     const char *fd, struct drm_client_fdinfo *info)
+{
+	return parse_fdinfo(parser, dir, fd, info);
+}
+
+/**
+ * igt_drm_fdinfo_parse_batch:
+ * @parser: Parser from igt_drm_fdinfo_parser_create()
+ * @dir: Directory the fdinfo paths are relative to
+ * @fds: Array of @count fdinfo paths
+ * @count: Number of files to parse
+ * @infos: Array of @count structures to populate, zeroed here
+ * @results: Array of @count results, as returned by igt_drm_fdinfo_parse()
+ *
+ * Parses several fdinfo files through the same read buffer and tables.
+ *
+ * Returns the number of files which parsed as valid drm fdinfo.
+ */
+unsigned int
+igt_drm_fdinfo_parse_batch(struct igt_drm_fdinfo_parser *parser, int dir,
+			   const char * const *fds, unsigned int count,
+			   struct drm_client_fdinfo *infos,
+			   unsigned int *results)
+{
+	unsigned int valid = 0;
+
+	for (unsigned int i = 0; i < count; i++) {
+		memset(&infos[i], 0, sizeof(infos[i]));
+		results[i] = parse_fdinfo(parser, dir, fds[i], &infos[i]);
+		valid += results[i] != 0;
+	}
+
+	return valid;
+}
+
+unsigned int
+__igt_parse_drm_fdinfo(int dir, const char *fd, struct drm_client_fdinfo *info,
+		       const char **name_map, unsigned int map_entries,
+		       const char **region_map, unsigned int region_entries)
+{
+	struct igt_drm_fdinfo_parser parser;
+
+	parser_init(&parser, name_map, map_entries, region_map, region_entries);
+
+	return parse_fdinfo(&parser, dir, fd, info);
 }
 
 unsigned int
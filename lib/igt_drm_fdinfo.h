@@ -115,4 +115,20 @@ __igt_parse_drm_fdinfo(int dir, const char *fd,
 		       const char **name_map, unsigned int map_entries,
 		       const char **region_map, unsigned int region_entries);
 
+struct igt_drm_fdinfo_parser;
+
+struct igt_drm_fdinfo_parser *
+igt_drm_fdinfo_parser_create(const char **name_map, unsigned int map_entries,
+			     const char **region_map, unsigned int region_entries);
+void igt_drm_fdinfo_parser_destroy(struct igt_drm_fdinfo_parser *parser);
+
+unsigned int
+igt_drm_fdinfo_parse(struct igt_drm_fdinfo_parser *parser, int dir,
+		     const char *fd, struct drm_client_fdinfo *info);
+unsigned int
+igt_drm_fdinfo_parse_batch(struct igt_drm_fdinfo_parser *parser, int dir,
+			   const char * const *fds, unsigned int count,
+			   struct drm_client_fdinfo *infos,
+			   unsigned int *results);
+
 #endif /* IGT_DRM_FDINFO_H */
@@ -0,0 +1,646 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_exec_replay
+ * @short_description: Replay of execbuf traces
+ * @title: Execbuf replay
+ * @include: igt_exec_replay.h
+ *
+ * igt_exec_replay() replays the events of a trace recorded by gem_exec_tracer,
+ * as parsed by igt_exec_trace_parse(), each recorded thread on a thread of its
+ * own. Buffers and contexts are created as recorded and every execbuf runs a
+ * given batch instead of the recorded one.
+ *
+ * Events are replayed as fast as possible or at their recorded times, scaled,
+ * keeping the bursts of submissions of the application. How late the events
+ * are replayed is reported as their slip. Events of a thread touching buffers
+ * or contexts which other threads touched before wait for those threads to
+ * catch up, so that the handles are valid and shared buffers used in the
+ * recorded order, which is counted as slip too.
+ *
+ * All ioctls are issued through a hook, so traces can be replayed without a
+ * device with igt_exec_replay_null_ioctl().
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i915_drm.h"
+#include "igt_exec_replay.h"
+#include "igt_rand.h"
+#include "igt_stats.h"
+
+struct dep {
+	unsigned int thread;
+	unsigned int count; /* Of events the thread must have replayed */
+};
+
+struct replay_thread {
+	struct replay *replay;
+	pthread_t thread;
+
+	unsigned int *events;
+	unsigned int nr_events;
+	atomic_uint done;
+
+	struct drm_i915_gem_exec_object2 *objects;
+	unsigned int max_objects;
+	struct drm_i915_gem_relocation_entry *relocs;
+	unsigned int max_relocs;
+
+	struct igt_histogram slip;
+	unsigned int nr_errors;
+	uint64_t end;
+	uint32_t seed;
+};
+
+struct replay {
+	const struct igt_exec_trace *trace;
+	const struct igt_exec_replay_opts *opts;
+
+	struct replay_thread *threads;
+	unsigned int nr_threads;
+
+	unsigned int *deps_start; /* Of each event, into deps */
+	struct dep *deps;
+
+	uint32_t *bo, *ctx; /* Recorded handles to replayed ones */
+	unsigned int nr_bo, nr_ctx;
+
+	uint64_t start;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * Sleeping overshoots by the timer slack, 50us by default, which would be
+ * more than the gaps between most events, so only longer gaps are slept
+ * through and the rest is yielded away.
+ */
+#define SLEEP_MARGIN_NS 100000
+
+static void wait_until(uint64_t ns)
+{
+	if (ns > now_ns() + SLEEP_MARGIN_NS) {
+		struct timespec ts = {
+			.tv_sec = (ns - SLEEP_MARGIN_NS) / 1000000000,
+			.tv_nsec = (ns - SLEEP_MARGIN_NS) % 1000000000,
+		};
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &ts, NULL) == EINTR)
+			;
+	}
+
+	while (now_ns() < ns)
+		sched_yield();
+}
+
+static uint32_t get_u32(const uint8_t *ptr)
+{
+	uint32_t value;
+
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+/*
+ * Calls @fn for each buffer or, with @ctx, context handle the event refers
+ * to, until it returns non-zero.
+ */
+static int for_each_handle(const struct igt_exec_trace_event *ev,
+			   int (*fn)(void *data, uint32_t handle, bool ctx),
+			   void *data)
+{
+	const uint8_t *ptr = ev->record + 1;
+	struct igt_exec_trace_exec exec;
+	int ret;
+
+	switch (ev->cmd) {
+	case IGT_EXEC_TRACE_ADD_BO:
+	case IGT_EXEC_TRACE_DEL_BO:
+	case IGT_EXEC_TRACE_WAIT:
+		return fn(data, get_u32(ptr), false);
+	case IGT_EXEC_TRACE_ADD_CTX:
+	case IGT_EXEC_TRACE_DEL_CTX:
+		return fn(data, get_u32(ptr), true);
+	case IGT_EXEC_TRACE_EXEC:
+		break;
+	default:
+		return 0;
+	}
+
+	memcpy(&exec, ptr, sizeof(exec));
+	ptr += sizeof(exec);
+
+	if (exec.context) {
+		ret = fn(data, exec.context, true);
+		if (ret)
+			return ret;
+	}
+
+	for (uint32_t i = 0; i < exec.object_count; i++) {
+		struct igt_exec_trace_exec_object obj;
+
+		memcpy(&obj, ptr, sizeof(obj));
+		ptr += sizeof(obj) + (size_t)obj.relocation_count *
+		       sizeof(struct drm_i915_gem_relocation_entry);
+
+		ret = fn(data, obj.handle, false);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int max_handle(void *data, uint32_t handle, bool ctx)
+{
+	struct replay *r = data;
+
+	if (handle >= IGT_EXEC_TRACE_MAX_HANDLE)
+		return -EIO;
+
+	if (ctx && handle >= r->nr_ctx)
+		r->nr_ctx = handle + 1;
+	else if (!ctx && handle >= r->nr_bo)
+		r->nr_bo = handle + 1;
+
+	return 0;
+}
+
+struct deps {
+	struct replay *replay;
+	unsigned int thread, count;
+	unsigned int *need; /* Per thread */
+	unsigned int **last_bo, **last_ctx; /* Per thread, by handle once used */
+};
+
+/* Depends on the last events of other threads touching the handle. */
+static int add_deps(void *data, uint32_t handle, bool ctx)
+{
+	struct deps *d = data;
+	unsigned int nr = d->replay->nr_threads;
+	unsigned int **slot = (ctx ? d->last_ctx : d->last_bo) + handle;
+	unsigned int *last = *slot;
+
+	/* Traces use few of their handles, only track those. */
+	if (!last) {
+		last = calloc(nr, sizeof(*last));
+		if (!last)
+			return -ENOMEM;
+		*slot = last;
+	}
+
+	for (unsigned int t = 0; t < nr; t++)
+		if (t != d->thread && last[t] > d->need[t])
+			d->need[t] = last[t];
+	last[d->thread] = d->count;
+
+	return 0;
+}
+
+static int prepare(struct replay *r)
+{
+	const struct igt_exec_trace *trace = r->trace;
+	unsigned int nr_deps = 0, max_deps = 0, i;
+	struct deps d = { .replay = r };
+	int ret;
+
+	r->nr_threads = trace->nr_threads;
+	r->threads = calloc(r->nr_threads, sizeof(*r->threads));
+	r->deps_start = calloc(trace->nr_events + 1, sizeof(*r->deps_start));
+	if (!r->threads || !r->deps_start)
+		return -ENOMEM;
+
+	for (i = 0; i < r->nr_threads; i++) {
+		r->threads[i].replay = r;
+		r->threads[i].seed = i + 1;
+	}
+
+	for (i = 0; i < trace->nr_events; i++) {
+		ret = for_each_handle(&trace->events[i], max_handle, r);
+		if (ret)
+			return ret;
+		r->threads[trace->events[i].thread].nr_events++;
+	}
+
+	for (i = 0; i < r->nr_threads; i++) {
+		struct replay_thread *t = &r->threads[i];
+
+		t->events = calloc(t->nr_events ?: 1, sizeof(*t->events));
+		if (!t->events)
+			return -ENOMEM;
+		t->nr_events = 0;
+	}
+
+	r->bo = calloc(r->nr_bo ?: 1, sizeof(*r->bo));
+	r->ctx = calloc(r->nr_ctx ?: 1, sizeof(*r->ctx));
+	d.need = calloc(r->nr_threads, sizeof(*d.need));
+	d.last_bo = calloc(r->nr_bo ?: 1, sizeof(*d.last_bo));
+	d.last_ctx = calloc(r->nr_ctx ?: 1, sizeof(*d.last_ctx));
+	ret = -ENOMEM;
+	if (!r->bo || !r->ctx || !d.need || !d.last_bo || !d.last_ctx)
+		goto out;
+
+	for (i = 0; i < trace->nr_events; i++) {
+		struct replay_thread *t = &r->threads[trace->events[i].thread];
+
+		t->events[t->nr_events++] = i;
+
+		memset(d.need, 0, r->nr_threads * sizeof(*d.need));
+		d.thread = trace->events[i].thread;
+		d.count = t->nr_events;
+		ret = for_each_handle(&trace->events[i], add_deps, &d);
+		if (ret)
+			goto out;
+
+		r->deps_start[i] = nr_deps;
+		for (unsigned int j = 0; j < r->nr_threads; j++) {
+			if (!d.need[j])
+				continue;
+
+			if (nr_deps == max_deps) {
+				struct dep *deps;
+
+				max_deps = max_deps ? 2 * max_deps : 256;
+				deps = realloc(r->deps,
+					       max_deps * sizeof(*deps));
+				if (!deps) {
+					ret = -ENOMEM;
+					goto out;
+				}
+				r->deps = deps;
+			}
+
+			r->deps[nr_deps++] = (struct dep){ j, d.need[j] };
+		}
+	}
+	r->deps_start[i] = nr_deps;
+
+	ret = 0;
+out:
+	if (d.last_bo)
+		for (i = 0; i < r->nr_bo; i++)
+			free(d.last_bo[i]);
+	if (d.last_ctx)
+		for (i = 0; i < r->nr_ctx; i++)
+			free(d.last_ctx[i]);
+	free(d.need);
+	free(d.last_bo);
+	free(d.last_ctx);
+
+	return ret;
+}
+
+static void wait_deps(struct replay *r, unsigned int idx)
+{
+	for (unsigned int i = r->deps_start[idx];
+	     i < r->deps_start[idx + 1]; i++) {
+		const struct dep *dep = &r->deps[i];
+
+		while (atomic_load_explicit(&r->threads[dep->thread].done,
+					    memory_order_acquire) < dep->count)
+			sched_yield();
+	}
+}
+
+static uint32_t lookup(const uint32_t *map, unsigned int count,
+		       uint32_t handle)
+{
+	return handle < count ? map[handle] : 0;
+}
+
+static void store(uint32_t *map, unsigned int count, uint32_t handle,
+		  uint32_t value)
+{
+	if (handle < count)
+		map[handle] = value;
+}
+
+static int replay_exec(struct replay_thread *t,
+		       const struct igt_exec_trace_event *ev)
+{
+	struct replay *r = t->replay;
+	const uint8_t *ptr = ev->record + 1;
+	struct drm_i915_gem_execbuffer2 eb = { };
+	struct igt_exec_trace_exec exec;
+	unsigned int nr_relocs = 0;
+
+	memcpy(&exec, ptr, sizeof(exec));
+	ptr += sizeof(exec);
+
+	if (exec.object_count >= t->max_objects) {
+		unsigned int max = exec.object_count + 1;
+		void *objects;
+
+		objects = realloc(t->objects, max * sizeof(*t->objects));
+		if (!objects)
+			return -ENOMEM;
+
+		t->objects = objects;
+		t->max_objects = max;
+	}
+
+	for (uint32_t i = 0; i < exec.object_count; i++) {
+		struct drm_i915_gem_exec_object2 *obj = &t->objects[i];
+		struct igt_exec_trace_exec_object to;
+
+		memcpy(&to, ptr, sizeof(to));
+		ptr += sizeof(to);
+
+		if (nr_relocs + to.relocation_count > t->max_relocs) {
+			unsigned int max = nr_relocs + to.relocation_count;
+			void *relocs;
+
+			max *= 2;
+
+			relocs = realloc(t->relocs, max * sizeof(*t->relocs));
+			if (!relocs)
+				return -ENOMEM;
+
+			t->relocs = relocs;
+			t->max_relocs = max;
+		}
+
+		if (to.relocation_count)
+			memcpy(&t->relocs[nr_relocs], ptr,
+			       to.relocation_count * sizeof(*t->relocs));
+		ptr += to.relocation_count * sizeof(*t->relocs);
+
+		if (!(exec.flags & I915_EXEC_HANDLE_LUT))
+			for (uint32_t j = 0; j < to.relocation_count; j++) {
+				uint32_t *target =
+					&t->relocs[nr_relocs + j].target_handle;
+
+				*target = lookup(r->bo, r->nr_bo, *target);
+			}
+
+		*obj = (struct drm_i915_gem_exec_object2){
+			.handle = lookup(r->bo, r->nr_bo, to.handle),
+			.relocation_count = to.relocation_count,
+			.alignment = to.alignment,
+			.offset = to.offset,
+			.flags = to.flags,
+			.rsvd1 = to.rsvd1,
+			.rsvd2 = to.rsvd2,
+		};
+		nr_relocs += to.relocation_count;
+	}
+
+	/* Pointers last, the relocations may have moved growing. */
+	nr_relocs = 0;
+	for (uint32_t i = 0; i < exec.object_count; i++) {
+		t->objects[i].relocs_ptr = (uintptr_t)&t->relocs[nr_relocs];
+		nr_relocs += t->objects[i].relocation_count;
+	}
+
+	t->objects[exec.object_count] = (struct drm_i915_gem_exec_object2){
+		.handle = r->opts->batch,
+	};
+
+	eb.buffers_ptr = (uintptr_t)t->objects;
+	eb.buffer_count = exec.object_count + 1;
+	eb.flags = exec.flags & ~I915_EXEC_BATCH_FIRST;
+	eb.rsvd1 = lookup(r->ctx, r->nr_ctx, exec.context);
+	if (r->opts->range) {
+		uint64_t offset = hars_petruska_f54_1_random(&t->seed);
+
+		eb.batch_start_offset = (offset * r->opts->range >> 32) & ~63u;
+	}
+
+	return r->opts->ioctl(r->opts->fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &eb);
+}
+
+static int replay_event(struct replay_thread *t,
+			const struct igt_exec_trace_event *ev)
+{
+	struct replay *r = t->replay;
+	const struct igt_exec_replay_opts *opts = r->opts;
+	uint32_t handle = get_u32(ev->record + 1);
+	int ret;
+
+	switch (ev->cmd) {
+	case IGT_EXEC_TRACE_ADD_BO: {
+		struct drm_i915_gem_create create = { };
+		struct igt_exec_trace_add_bo bo;
+
+		memcpy(&bo, ev->record + 1, sizeof(bo));
+		create.size = bo.size;
+		ret = opts->ioctl(opts->fd, DRM_IOCTL_I915_GEM_CREATE, &create);
+		store(r->bo, r->nr_bo, handle, ret ? 0 : create.handle);
+		return ret;
+	}
+	case IGT_EXEC_TRACE_DEL_BO: {
+		struct drm_gem_close close = {
+			.handle = lookup(r->bo, r->nr_bo, handle),
+		};
+
+		store(r->bo, r->nr_bo, handle, 0);
+		return opts->ioctl(opts->fd, DRM_IOCTL_GEM_CLOSE, &close);
+	}
+	case IGT_EXEC_TRACE_ADD_CTX: {
+		struct drm_i915_gem_context_create create = { };
+
+		ret = opts->ioctl(opts->fd, DRM_IOCTL_I915_GEM_CONTEXT_CREATE,
+				  &create);
+		store(r->ctx, r->nr_ctx, handle, ret ? 0 : create.ctx_id);
+		return ret;
+	}
+	case IGT_EXEC_TRACE_DEL_CTX: {
+		struct drm_i915_gem_context_destroy destroy = {
+			.ctx_id = lookup(r->ctx, r->nr_ctx, handle),
+		};
+
+		store(r->ctx, r->nr_ctx, handle, 0);
+		return opts->ioctl(opts->fd, DRM_IOCTL_I915_GEM_CONTEXT_DESTROY,
+				   &destroy);
+	}
+	case IGT_EXEC_TRACE_EXEC:
+		return replay_exec(t, ev);
+	case IGT_EXEC_TRACE_WAIT: {
+		struct drm_i915_gem_wait wait = {
+			.bo_handle = lookup(r->bo, r->nr_bo, handle),
+			.timeout_ns = -1,
+		};
+
+		return opts->ioctl(opts->fd, DRM_IOCTL_I915_GEM_WAIT, &wait);
+	}
+	}
+
+	return -EINVAL;
+}
+
+static void *replay_thread(void *arg)
+{
+	struct replay_thread *t = arg;
+	struct replay *r = t->replay;
+	double scale = r->opts->scale;
+
+	for (unsigned int i = 0; i < t->nr_events; i++) {
+		unsigned int idx = t->events[i];
+		const struct igt_exec_trace_event *ev = &r->trace->events[idx];
+		uint64_t target = r->start + ev->time_ns * scale;
+		uint64_t now;
+
+		if (scale > 0)
+			wait_until(target);
+
+		wait_deps(r, idx);
+
+		now = now_ns();
+		if (scale > 0)
+			igt_histogram_add(&t->slip,
+					  now > target ? now - target : 0);
+
+		if (replay_event(t, ev))
+			t->nr_errors++;
+
+		atomic_store_explicit(&t->done, i + 1, memory_order_release);
+	}
+	t->end = now_ns();
+
+	return NULL;
+}
+
+static void cleanup(struct replay *r)
+{
+	if (r->threads) {
+		for (unsigned int i = 0; i < r->nr_threads; i++) {
+			free(r->threads[i].events);
+			free(r->threads[i].objects);
+			free(r->threads[i].relocs);
+		}
+	}
+	free(r->threads);
+	free(r->deps_start);
+	free(r->deps);
+	free(r->bo);
+	free(r->ctx);
+}
+
+/**
+ * igt_exec_replay:
+ * @trace: Trace to replay
+ * @opts: How to replay it
+ * @stats: Returns how the replay went
+ *
+ * Replays the events of @trace on a thread for each recorded thread, see the
+ * section description. Failing ioctls are counted in @stats and the replay
+ * goes on. Traces recorded without timestamps can only be replayed as fast
+ * as possible.
+ *
+ * Returns 0 on success, -EINVAL if @opts asks for the recorded times of a
+ * trace without them, -EIO if it refers to handles from
+ * #IGT_EXEC_TRACE_MAX_HANDLE, or a negative error code if the replay could
+ * not start.
+ */
+int igt_exec_replay(const struct igt_exec_trace *trace,
+		    const struct igt_exec_replay_opts *opts,
+		    struct igt_exec_replay_stats *stats)
+{
+	struct replay r = { .trace = trace, .opts = opts };
+	struct igt_histogram slip;
+	unsigned int i, started;
+	uint64_t end;
+	int ret;
+
+	if (opts->scale < 0 || (opts->scale > 0 && !trace->timed))
+		return -EINVAL;
+
+	ret = prepare(&r);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < r.nr_threads; i++)
+		igt_histogram_init(&r.threads[i].slip, 7, 10000000000ull);
+
+	/* Give the threads a moment to start before the first events. */
+	r.start = now_ns() + 1000000;
+	for (started = 0; started < r.nr_threads; started++) {
+		ret = -pthread_create(&r.threads[started].thread, NULL,
+				      replay_thread, &r.threads[started]);
+		if (ret)
+			break;
+	}
+
+	/* Threads not started would be waited for forever. */
+	if (ret)
+		for (i = started; i < r.nr_threads; i++)
+			atomic_store(&r.threads[i].done, UINT32_MAX);
+
+	end = r.start;
+	memset(stats, 0, sizeof(*stats));
+	igt_histogram_init(&slip, 7, 10000000000ull);
+	for (i = 0; i < started; i++) {
+		struct replay_thread *t = &r.threads[i];
+
+		pthread_join(t->thread, NULL);
+		if (t->end > end)
+			end = t->end;
+
+		igt_histogram_merge(&slip, &t->slip);
+		stats->nr_events += t->nr_events;
+		stats->nr_errors += t->nr_errors;
+	}
+	for (i = 0; i < r.nr_threads; i++)
+		igt_histogram_fini(&r.threads[i].slip);
+
+	stats->elapsed_ns = end - r.start;
+	stats->slip_mean_ns = igt_histogram_get_mean(&slip);
+	stats->slip_median_ns = igt_histogram_get_percentile(&slip, 50);
+	stats->slip_p99_ns = igt_histogram_get_percentile(&slip, 99);
+	stats->slip_max_ns = igt_histogram_get_max(&slip);
+	igt_histogram_fini(&slip);
+out:
+	cleanup(&r);
+
+	return ret;
+}
+
+/**
+ * igt_exec_replay_null_ioctl:
+ * @fd: Ignored
+ * @request: Ioctl to pretend issuing
+ * @arg: Argument of @request
+ *
+ * Ioctl backend for replaying without a device, doing nothing but handing
+ * out new handles for the buffers and contexts created.
+ *
+ * Returns 0.
+ */
+int igt_exec_replay_null_ioctl(int fd, unsigned long request, void *arg)
+{
+	static atomic_uint next_handle = 1;
+
+	switch (request) {
+	case DRM_IOCTL_I915_GEM_CREATE: {
+		struct drm_i915_gem_create *create = arg;
+
+		create->handle = atomic_fetch_add(&next_handle, 1);
+		break;
+	}
+	case DRM_IOCTL_I915_GEM_CONTEXT_CREATE: {
+		struct drm_i915_gem_context_create *create = arg;
+
+		create->ctx_id = atomic_fetch_add(&next_handle, 1);
+		break;
+	}
+	}
+
+	return 0;
+}
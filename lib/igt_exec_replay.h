@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_EXEC_REPLAY_H
+#define IGT_EXEC_REPLAY_H
+
+#include <stdint.h>
+
+#include "igt_exec_trace.h"
+
+/**
+ * igt_exec_replay_opts:
+ * @fd: Device to replay on
+ * @ioctl: Issues the ioctls of the replay, such as drmIoctl() or
+ *	   igt_exec_replay_null_ioctl()
+ * @scale: Factor of the recorded times to replay the events at, 0 to replay
+ *	   as fast as possible
+ * @batch: Batch buffer executed instead of the recorded ones
+ * @range: Bytes of @batch to pick random batch start offsets from, 0 for
+ *	   none
+ */
+struct igt_exec_replay_opts {
+	int fd;
+	int (*ioctl)(int fd, unsigned long request, void *arg);
+	double scale;
+	uint32_t batch;
+	uint64_t range;
+};
+
+/**
+ * igt_exec_replay_stats:
+ * @elapsed_ns: Time taken to replay all events
+ * @nr_events: Number of events replayed
+ * @nr_errors: Number of ioctls failing
+ * @slip_mean_ns: Mean time events were replayed behind their scaled
+ *		  recorded time, only when replaying at a scale
+ * @slip_median_ns: Median of the slip
+ * @slip_p99_ns: 99th percentile of the slip
+ * @slip_max_ns: Largest slip
+ */
+struct igt_exec_replay_stats {
+	uint64_t elapsed_ns;
+	unsigned int nr_events;
+	unsigned int nr_errors;
+	double slip_mean_ns;
+	uint64_t slip_median_ns;
+	uint64_t slip_p99_ns;
+	uint64_t slip_max_ns;
+};
+
+int igt_exec_replay(const struct igt_exec_trace *trace,
+		    const struct igt_exec_replay_opts *opts,
+		    struct igt_exec_replay_stats *stats);
+
+int igt_exec_replay_null_ioctl(int fd, unsigned long request, void *arg);
+
+#endif /* IGT_EXEC_REPLAY_H */
@@ -0,0 +1,1365 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_exec_trace
+ * @short_description: Conversion of execbuf traces to gem_wsim workloads
+ * @title: Execbuf traces
+ * @include: igt_exec_trace.h
+ *
+ * Traces recorded by preloading the gem_exec_tracer library into an
+ * application hold every execbuf it submitted, along with the buffers and
+ * contexts it used and the buffers it waited for. igt_exec_trace_to_wsim()
+ * turns such a trace into a gem_wsim workload descriptor which can be
+ * shared and replayed without the application.
+ *
+ * Each execbuf becomes a batch on its context and engine. Data dependencies
+ * are inferred from the buffers shared between batches the way implicit
+ * synchronisation orders them: reading a buffer waits for its last writer
+ * and writing one also waits for the readers since, unless the batches run
+ * in order anyway on the same context and engine. Waiting for a buffer
+ * becomes a sync with the last batch using it.
+ *
+ * Applications mostly submit the same frame over and over, so the longest
+ * repeating run of steps is looked for and, if it covers most of the trace,
+ * only a single frame is written, to be repeated with gem_wsim -r. Steps
+ * before the repeating run, typically setup, are skipped and dependencies
+ * between frames are lost.
+ *
+ * The tracer writes packed traces, with the records of each thread and the
+ * time they were made, which igt_exec_trace_parse() reads back as a list of
+ * events for replaying, see igt_exec_replay(), and igt_exec_trace_unpack()
+ * turns into the plain records of version 1.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i915_drm.h"
+#include "igt_exec_trace.h"
+
+#define MAX_FRAME 1024
+
+enum step_type {
+	STEP_BATCH,
+	STEP_SYNC,
+};
+
+struct step {
+	enum step_type type;
+	unsigned int ctx;
+	const char *engine;
+	unsigned int timeline;
+	bool sync;
+	unsigned int nr_deps;
+	unsigned int *deps; /* Earlier batches, in ascending order. */
+	unsigned int target; /* Of a sync step. */
+};
+
+struct object {
+	int last_write;
+	int last_use;
+	unsigned int nr_reads;
+	unsigned int *reads; /* Latest read on each timeline since the write. */
+};
+
+/* Batches on a context and engine execute in order. */
+struct timeline {
+	unsigned int ctx;
+	const char *engine;
+	int done; /* Last batch known to be complete. */
+};
+
+struct convert {
+	const uint8_t *ptr, *end;
+
+	struct timeline *timelines;
+	unsigned int nr_timelines;
+
+	struct step *steps;
+	unsigned int nr_steps, max_steps;
+	unsigned int nr_batches;
+
+	struct object *objects; /* Indexed by handle. */
+	unsigned int nr_objects;
+
+	unsigned int *ctx_ids; /* By context handle, 0 until used. */
+	unsigned int nr_ctx_handles;
+	unsigned int nr_ctxs;
+};
+
+static const void *take(struct convert *c, size_t len)
+{
+	const void *ptr = c->ptr;
+
+	if (len > (size_t)(c->end - c->ptr))
+		return NULL;
+
+	c->ptr += len;
+
+	return ptr;
+}
+
+/* @handle is below IGT_EXEC_TRACE_MAX_HANDLE, so rounding up cannot wrap. */
+static struct object *get_object(struct convert *c, uint32_t handle)
+{
+	if (handle >= c->nr_objects) {
+		unsigned int nr = (handle + 4096) & ~4095u;
+		struct object *objects;
+
+		objects = realloc(c->objects, nr * sizeof(*objects));
+		if (!objects)
+			return NULL;
+
+		for (unsigned int i = c->nr_objects; i < nr; i++)
+			objects[i] = (struct object){
+				.last_write = -1,
+				.last_use = -1,
+			};
+
+		c->objects = objects;
+		c->nr_objects = nr;
+	}
+
+	return &c->objects[handle];
+}
+
+static void reset_object(struct convert *c, uint32_t handle)
+{
+	struct object *obj;
+
+	if (handle >= c->nr_objects)
+		return;
+
+	obj = &c->objects[handle];
+	free(obj->reads);
+	*obj = (struct object){ .last_write = -1, .last_use = -1 };
+}
+
+static int get_ctx(struct convert *c, uint32_t handle)
+{
+	if (handle >= IGT_EXEC_TRACE_MAX_HANDLE)
+		return -EIO;
+
+	if (handle >= c->nr_ctx_handles) {
+		unsigned int nr = (handle + 1024) & ~1023u;
+		unsigned int *ids;
+
+		ids = realloc(c->ctx_ids, nr * sizeof(*ids));
+		if (!ids)
+			return -ENOMEM;
+
+		memset(ids + c->nr_ctx_handles, 0,
+		       (nr - c->nr_ctx_handles) * sizeof(*ids));
+		c->ctx_ids = ids;
+		c->nr_ctx_handles = nr;
+	}
+
+	if (!c->ctx_ids[handle])
+		c->ctx_ids[handle] = ++c->nr_ctxs;
+
+	return c->ctx_ids[handle];
+}
+
+/* Engine maps are not traced, so their indices cannot be told apart. */
+static const char *engine_name(uint64_t flags)
+{
+	switch (flags & I915_EXEC_RING_MASK) {
+	case I915_EXEC_DEFAULT:
+	case I915_EXEC_RENDER:
+		return "RCS";
+	case I915_EXEC_BSD:
+		switch (flags & I915_EXEC_BSD_MASK) {
+		case I915_EXEC_BSD_RING1:
+			return "VCS1";
+		case I915_EXEC_BSD_RING2:
+			return "VCS2";
+		default:
+			return "VCS";
+		}
+	case I915_EXEC_BLT:
+		return "BCS";
+	case I915_EXEC_VEBOX:
+		return "VECS";
+	default:
+		return "DEFAULT";
+	}
+}
+
+static struct step *add_step(struct convert *c, enum step_type type)
+{
+	struct step *step;
+
+	if (c->nr_steps == c->max_steps) {
+		unsigned int max = c->max_steps ? 2 * c->max_steps : 256;
+
+		step = realloc(c->steps, max * sizeof(*step));
+		if (!step)
+			return NULL;
+
+		c->steps = step;
+		c->max_steps = max;
+	}
+
+	step = &c->steps[c->nr_steps++];
+	memset(step, 0, sizeof(*step));
+	step->type = type;
+
+	return step;
+}
+
+static int get_timeline(struct convert *c, unsigned int ctx,
+			const char *engine)
+{
+	struct timeline *timelines;
+	unsigned int i;
+
+	for (i = 0; i < c->nr_timelines; i++)
+		if (c->timelines[i].ctx == ctx && c->timelines[i].engine == engine)
+			return i;
+
+	timelines = realloc(c->timelines, (i + 1) * sizeof(*timelines));
+	if (!timelines)
+		return -ENOMEM;
+
+	timelines[i] = (struct timeline){ ctx, engine, -1 };
+	c->timelines = timelines;
+	c->nr_timelines++;
+
+	return i;
+}
+
+/*
+ * Once the client waited for a batch, it and the batches it depends on are
+ * complete, along with the batches before them on their timelines. Not all
+ * of those are tracked, only the latest per timeline.
+ */
+static int mark_done(struct convert *c, unsigned int idx)
+{
+	unsigned int *stack, nr = 0, max = 16;
+
+	stack = malloc(max * sizeof(*stack));
+	if (!stack)
+		return -ENOMEM;
+
+	stack[nr++] = idx;
+	while (nr) {
+		const struct step *step = &c->steps[stack[--nr]];
+		struct timeline *tl = &c->timelines[step->timeline];
+
+		if ((int)(step - c->steps) <= tl->done)
+			continue;
+		tl->done = step - c->steps;
+
+		if (nr + step->nr_deps > max) {
+			unsigned int *s;
+
+			max = 2 * (nr + step->nr_deps);
+			s = realloc(stack, max * sizeof(*stack));
+			if (!s) {
+				free(stack);
+				return -ENOMEM;
+			}
+			stack = s;
+		}
+
+		for (unsigned int i = 0; i < step->nr_deps; i++)
+			stack[nr++] = step->deps[i];
+	}
+
+	free(stack);
+
+	return 0;
+}
+
+/* Batches known to be complete or in order anyway are no dependencies. */
+static int add_dep(struct convert *c, struct step *step, int dep)
+{
+	unsigned int *deps;
+
+	if (dep < 0 || c->steps[dep].timeline == step->timeline ||
+	    dep <= c->timelines[c->steps[dep].timeline].done)
+		return 0;
+
+	for (unsigned int i = 0; i < step->nr_deps; i++)
+		if (step->deps[i] == (unsigned int)dep)
+			return 0;
+
+	deps = realloc(step->deps, (step->nr_deps + 1) * sizeof(*deps));
+	if (!deps)
+		return -ENOMEM;
+
+	deps[step->nr_deps++] = dep;
+	step->deps = deps;
+
+	return 0;
+}
+
+static int add_read(struct convert *c, struct object *obj, unsigned int idx)
+{
+	unsigned int *reads;
+
+	/* Later reads on a timeline are ordered after the earlier ones. */
+	for (unsigned int i = 0; i < obj->nr_reads; i++) {
+		if (c->steps[obj->reads[i]].timeline == c->steps[idx].timeline) {
+			obj->reads[i] = idx;
+			return 0;
+		}
+	}
+
+	reads = realloc(obj->reads, (obj->nr_reads + 1) * sizeof(*reads));
+	if (!reads)
+		return -ENOMEM;
+
+	reads[obj->nr_reads++] = idx;
+	obj->reads = reads;
+
+	return 0;
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+	const unsigned int *x = a, *y = b;
+
+	return *x < *y ? -1 : *x > *y;
+}
+
+/* Object handles and whether each is written, as the batch sees them. */
+struct exec_object {
+	uint32_t handle;
+	bool write;
+	bool async;
+};
+
+static int convert_exec(struct convert *c)
+{
+	struct igt_exec_trace_exec t;
+	struct exec_object *objects;
+	uint32_t *written = NULL, *targets;
+	unsigned int idx, batch, i, nr_written = 0;
+	int ctx, timeline, ret = -EIO;
+	const void *ptr;
+	struct step *step;
+
+	ptr = take(c, sizeof(t));
+	if (!ptr)
+		return -EIO;
+	memcpy(&t, ptr, sizeof(t));
+
+	if (!t.object_count)
+		return -EIO;
+
+	objects = calloc(t.object_count, sizeof(*objects));
+	if (!objects)
+		return -ENOMEM;
+
+	for (i = 0; i < t.object_count; i++) {
+		struct igt_exec_trace_exec_object to;
+
+		ptr = take(c, sizeof(to));
+		if (!ptr)
+			goto out;
+		memcpy(&to, ptr, sizeof(to));
+		if (to.handle >= IGT_EXEC_TRACE_MAX_HANDLE)
+			goto out;
+
+		objects[i].handle = to.handle;
+		objects[i].write = to.flags & EXEC_OBJECT_WRITE;
+		objects[i].async = to.flags & EXEC_OBJECT_ASYNC;
+
+		for (uint32_t j = 0; j < to.relocation_count; j++) {
+			struct drm_i915_gem_relocation_entry reloc;
+
+			ptr = take(c, sizeof(reloc));
+			if (!ptr)
+				goto out;
+			memcpy(&reloc, ptr, sizeof(reloc));
+
+			if (!reloc.write_domain)
+				continue;
+
+			targets = realloc(written, (nr_written + 1) *
+					  sizeof(*written));
+			if (!targets) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			written = targets;
+			written[nr_written++] = reloc.target_handle;
+		}
+	}
+
+	/* Relocation targets are object indices or handles. */
+	for (i = 0; i < nr_written; i++) {
+		unsigned int k = written[i];
+
+		if (!(t.flags & I915_EXEC_HANDLE_LUT))
+			for (k = 0; k < t.object_count; k++)
+				if (objects[k].handle == written[i])
+					break;
+
+		if (k < t.object_count)
+			objects[k].write = true;
+	}
+
+	ctx = get_ctx(c, t.context);
+	if (ctx < 0) {
+		ret = ctx;
+		goto out;
+	}
+
+	timeline = get_timeline(c, ctx, engine_name(t.flags));
+	if (timeline < 0) {
+		ret = timeline;
+		goto out;
+	}
+
+	step = add_step(c, STEP_BATCH);
+	if (!step) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	idx = c->nr_steps - 1;
+	step->ctx = ctx;
+	step->engine = engine_name(t.flags);
+	step->timeline = timeline;
+	c->nr_batches++;
+
+	batch = t.flags & I915_EXEC_BATCH_FIRST ? 0 : t.object_count - 1;
+
+	for (i = 0; i < t.object_count; i++) {
+		struct object *obj = get_object(c, objects[i].handle);
+
+		ret = -ENOMEM;
+		if (!obj)
+			goto out;
+
+		obj->last_use = idx;
+		if (i == batch || objects[i].async)
+			continue;
+
+		if (add_dep(c, step, obj->last_write))
+			goto out;
+
+		if (objects[i].write) {
+			for (unsigned int r = 0; r < obj->nr_reads; r++)
+				if (add_dep(c, step, obj->reads[r]))
+					goto out;
+
+			obj->nr_reads = 0;
+			obj->last_write = idx;
+		} else if (add_read(c, obj, idx)) {
+			goto out;
+		}
+	}
+
+	if (step->nr_deps > 1)
+		qsort(step->deps, step->nr_deps, sizeof(*step->deps),
+		      cmp_uint);
+	ret = 0;
+out:
+	free(written);
+	free(objects);
+
+	return ret;
+}
+
+static int convert_wait(struct convert *c)
+{
+	struct igt_exec_trace_wait t;
+	const struct object *obj;
+	const void *ptr;
+	struct step *step;
+
+	ptr = take(c, sizeof(t));
+	if (!ptr)
+		return -EIO;
+	memcpy(&t, ptr, sizeof(t));
+
+	if (t.handle >= c->nr_objects || c->objects[t.handle].last_use < 0)
+		return 0;
+	obj = &c->objects[t.handle];
+
+	step = &c->steps[obj->last_use];
+	if (obj->last_use <= c->timelines[step->timeline].done)
+		return 0;
+
+	/* Waiting for the last batch right away is the sync flag of it. */
+	if (obj->last_use == c->nr_steps - 1) {
+		c->steps[obj->last_use].sync = true;
+		return mark_done(c, obj->last_use);
+	}
+
+	step = &c->steps[c->nr_steps - 1];
+	if (step->type == STEP_SYNC && step->target == obj->last_use)
+		return 0;
+
+	step = add_step(c, STEP_SYNC);
+	if (!step)
+		return -ENOMEM;
+	step->target = obj->last_use;
+
+	return mark_done(c, obj->last_use);
+}
+
+static int convert_trace(struct convert *c)
+{
+	const struct igt_exec_trace_version *version;
+	uint32_t handle;
+	const void *ptr;
+	int ret;
+
+	version = take(c, sizeof(*version));
+	if (!version || version->magic != IGT_EXEC_TRACE_MAGIC)
+		return -EINVAL;
+	if (version->version != IGT_EXEC_TRACE_VERSION)
+		return -EPROTO;
+
+	while (c->ptr < c->end) {
+		switch (*c->ptr++) {
+		case IGT_EXEC_TRACE_ADD_BO:
+			ptr = take(c, sizeof(struct igt_exec_trace_add_bo));
+			if (!ptr)
+				return -EIO;
+			memcpy(&handle, ptr, sizeof(handle));
+			reset_object(c, handle);
+			break;
+		case IGT_EXEC_TRACE_DEL_BO:
+			ptr = take(c, sizeof(struct igt_exec_trace_del_bo));
+			if (!ptr)
+				return -EIO;
+			memcpy(&handle, ptr, sizeof(handle));
+			reset_object(c, handle);
+			break;
+		case IGT_EXEC_TRACE_ADD_CTX:
+			if (!take(c, sizeof(struct igt_exec_trace_add_ctx)))
+				return -EIO;
+			break;
+		case IGT_EXEC_TRACE_DEL_CTX:
+			ptr = take(c, sizeof(struct igt_exec_trace_del_ctx));
+			if (!ptr)
+				return -EIO;
+			memcpy(&handle, ptr, sizeof(handle));
+			/* A context created with the same handle is another one. */
+			if (handle < c->nr_ctx_handles)
+				c->ctx_ids[handle] = 0;
+			break;
+		case IGT_EXEC_TRACE_EXEC:
+			ret = convert_exec(c);
+			if (ret)
+				return ret;
+			break;
+		case IGT_EXEC_TRACE_WAIT:
+			ret = convert_wait(c);
+			if (ret)
+				return ret;
+			break;
+		default:
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/* Steps are the same if they depend on the steps the same distance back. */
+static bool same_step(const struct convert *c, unsigned int a, unsigned int b)
+{
+	const struct step *x = &c->steps[a], *y = &c->steps[b];
+
+	if (x->type != y->type || x->ctx != y->ctx ||
+	    x->engine != y->engine || x->sync != y->sync ||
+	    x->nr_deps != y->nr_deps)
+		return false;
+
+	if (x->type == STEP_SYNC && a - x->target != b - y->target)
+		return false;
+
+	for (unsigned int i = 0; i < x->nr_deps; i++)
+		if (a - x->deps[i] != b - y->deps[i])
+			return false;
+
+	return true;
+}
+
+static unsigned int lost_deps(const struct convert *c, unsigned int start,
+			      unsigned int len)
+{
+	unsigned int lost = 0;
+
+	for (unsigned int i = start; i < start + len; i++) {
+		const struct step *step = &c->steps[i];
+
+		for (unsigned int j = 0; j < step->nr_deps; j++)
+			lost += step->deps[j] < start;
+		lost += step->type == STEP_SYNC && step->target < start;
+	}
+
+	return lost;
+}
+
+/*
+ * Finds the shortest frame which repeating covers most steps up to the end
+ * of the trace. Of its rotations the one losing the fewest dependencies on
+ * the previous frame is picked.
+ */
+static bool find_frame(const struct convert *c, unsigned int *start,
+		       unsigned int *len, unsigned int *repeats)
+{
+	unsigned int n = c->nr_steps, best = 0, k, s, lost, min_lost;
+
+	for (k = 1; k <= n / 2 && k <= MAX_FRAME; k++) {
+		s = n - k;
+		while (s > 0 && same_step(c, s - 1, s - 1 + k))
+			s--;
+
+		if ((n - s) / k >= 2 && (n - s) / k * k > best) {
+			best = (n - s) / k * k;
+			*start = s;
+			*len = k;
+		}
+	}
+
+	if (!best || 2 * best < n)
+		return false;
+
+	s = *start;
+	min_lost = lost_deps(c, s, *len);
+	for (k = s + 1; k < s + *len && (n - k) / *len >= 2; k++) {
+		lost = lost_deps(c, k, *len);
+		if (lost < min_lost) {
+			min_lost = lost;
+			*start = k;
+		}
+	}
+	*repeats = (n - *start) / *len;
+
+	return true;
+}
+
+struct unpack {
+	const uint8_t *ptr, *end;
+	struct igt_exec_trace_packer packer;
+
+	uint8_t *data; /* Version 1 records */
+	size_t len, max;
+};
+
+static int get_varint(struct unpack *u, uint64_t *value)
+{
+	*value = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (u->ptr == u->end)
+			return -EIO;
+
+		*value |= (uint64_t)(*u->ptr & 0x7f) << shift;
+		if (!(*u->ptr++ & 0x80))
+			return 0;
+	}
+
+	return -EIO;
+}
+
+static int get_varints(struct unpack *u, uint64_t *values, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		if (get_varint(u, &values[i]))
+			return -EIO;
+
+	return 0;
+}
+
+static int get_handle(struct unpack *u, uint32_t *handle)
+{
+	uint64_t zigzag;
+
+	if (get_varint(u, &zigzag))
+		return -EIO;
+
+	u->packer.handle += (uint32_t)(zigzag >> 1) ^ -(uint32_t)(zigzag & 1);
+	*handle = u->packer.handle;
+
+	return 0;
+}
+
+static int put(struct unpack *u, const void *data, size_t len)
+{
+	if (u->len + len > u->max) {
+		size_t max = u->max ? 2 * u->max : 4096;
+		uint8_t *ptr;
+
+		while (max < u->len + len)
+			max *= 2;
+
+		ptr = realloc(u->data, max);
+		if (!ptr)
+			return -ENOMEM;
+
+		u->data = ptr;
+		u->max = max;
+	}
+
+	memcpy(u->data + u->len, data, len);
+	u->len += len;
+
+	return 0;
+}
+
+static int unpack_exec(struct unpack *u)
+{
+	struct igt_exec_trace_exec t;
+	uint64_t v[6];
+	uint32_t handle;
+	int ret;
+
+	if (get_varints(u, v, 3))
+		return -EIO;
+
+	t.object_count = v[0];
+	t.flags = v[1];
+	t.context = v[2];
+	ret = put(u, &t, sizeof(t));
+	if (ret)
+		return ret;
+
+	for (uint32_t i = 0; i < t.object_count; i++) {
+		struct igt_exec_trace_exec_object obj;
+
+		if (get_handle(u, &handle) || get_varints(u, v, 6))
+			return -EIO;
+
+		obj.handle = handle;
+		obj.relocation_count = v[0];
+		obj.alignment = v[1];
+		obj.offset = v[2];
+		obj.flags = v[3];
+		obj.rsvd1 = v[4];
+		obj.rsvd2 = v[5];
+		ret = put(u, &obj, sizeof(obj));
+		if (ret)
+			return ret;
+
+		for (uint32_t r = 0; r < obj.relocation_count; r++) {
+			struct drm_i915_gem_relocation_entry reloc;
+
+			if (get_varints(u, v, 6))
+				return -EIO;
+
+			reloc.target_handle = v[0];
+			reloc.delta = v[1];
+			reloc.offset = v[2];
+			reloc.presumed_offset = v[3];
+			reloc.read_domains = v[4];
+			reloc.write_domain = v[5];
+			ret = put(u, &reloc, sizeof(reloc));
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+struct record {
+	uint64_t seq;
+	uint64_t time;
+	unsigned int thread;
+	size_t offset, len;
+};
+
+struct records {
+	struct record *records;
+	unsigned int nr, max;
+	uint32_t *tids;
+	unsigned int nr_threads;
+};
+
+static struct record *add_record(struct records *r)
+{
+	if (r->nr == r->max) {
+		unsigned int max = r->max ? 2 * r->max : 256;
+		struct record *records;
+
+		records = realloc(r->records, max * sizeof(*records));
+		if (!records)
+			return NULL;
+
+		r->records = records;
+		r->max = max;
+	}
+
+	return &r->records[r->nr++];
+}
+
+static int unpack_record(struct unpack *u, struct record *rec, uint8_t cmd,
+			 bool timed)
+{
+	uint64_t value;
+	uint32_t handle;
+	int ret;
+
+	if (get_varint(u, &value))
+		return -EIO;
+	u->packer.seq += value;
+	if (timed) {
+		if (get_varint(u, &value))
+			return -EIO;
+		u->packer.time += value;
+	}
+
+	rec->seq = u->packer.seq;
+	rec->time = u->packer.time;
+
+	ret = put(u, &cmd, sizeof(cmd));
+	if (ret)
+		return ret;
+
+	switch (cmd) {
+	case IGT_EXEC_TRACE_ADD_BO: {
+		struct igt_exec_trace_add_bo t;
+
+		if (get_handle(u, &handle) || get_varint(u, &value))
+			return -EIO;
+
+		t.handle = handle;
+		t.size = value;
+		return put(u, &t, sizeof(t));
+	}
+	case IGT_EXEC_TRACE_DEL_BO:
+	case IGT_EXEC_TRACE_WAIT:
+		if (get_handle(u, &handle))
+			return -EIO;
+
+		return put(u, &handle, sizeof(handle));
+	case IGT_EXEC_TRACE_ADD_CTX:
+	case IGT_EXEC_TRACE_DEL_CTX:
+		if (get_varint(u, &value))
+			return -EIO;
+
+		handle = value;
+		return put(u, &handle, sizeof(handle));
+	case IGT_EXEC_TRACE_EXEC:
+		return unpack_exec(u);
+	default:
+		return -EIO;
+	}
+}
+
+/*
+ * Unpacks the records of a buffer, noting where each went. The tracer drops
+ * what it could not write out of the record it was packing as the application
+ * exits, so the last record of a buffer may be cut short and is left out.
+ */
+static int unpack_buffer(struct unpack *u, struct records *r, bool timed)
+{
+	uint64_t value;
+	uint32_t *tids;
+	int ret;
+
+	tids = realloc(r->tids, (r->nr_threads + 1) * sizeof(*tids));
+	if (!tids)
+		return -ENOMEM;
+	r->tids = tids;
+	tids[r->nr_threads] = 0;
+	if (timed) {
+		if (get_varint(u, &value))
+			return -EIO;
+		tids[r->nr_threads] = value;
+	}
+
+	u->packer = (struct igt_exec_trace_packer){ };
+	while (u->ptr < u->end) {
+		uint8_t cmd = *u->ptr++;
+		struct record *rec;
+
+		rec = add_record(r);
+		if (!rec)
+			return -ENOMEM;
+
+		rec->thread = r->nr_threads;
+		rec->offset = u->len;
+
+		ret = unpack_record(u, rec, cmd, timed);
+		if (ret == -EIO && u->ptr == u->end &&
+		    cmd <= IGT_EXEC_TRACE_WAIT) {
+			r->nr--;
+			u->len = rec->offset;
+			break;
+		}
+		if (ret)
+			return ret;
+
+		rec->len = u->len - rec->offset;
+	}
+
+	r->nr_threads++;
+
+	return 0;
+}
+
+static int cmp_record(const void *a, const void *b)
+{
+	const struct record *x = a, *y = b;
+
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+struct stream {
+	uint8_t *data;
+	size_t len;
+};
+
+/* Joins the chunks of each buffer back together. */
+static int read_chunks(const uint8_t *ptr, const uint8_t *end,
+		       struct stream **streams, unsigned int *nr_streams)
+{
+	struct unpack u = { .ptr = ptr, .end = end };
+
+	while (u.ptr < u.end) {
+		uint64_t id, len;
+		struct stream *s;
+		uint8_t *data;
+
+		if (get_varint(&u, &id) || get_varint(&u, &len) ||
+		    len > (size_t)(u.end - u.ptr) || id >= 1 << 20)
+			return -EIO;
+
+		if (id >= *nr_streams) {
+			s = realloc(*streams, (id + 1) * sizeof(*s));
+			if (!s)
+				return -ENOMEM;
+
+			memset(s + *nr_streams, 0,
+			       (id + 1 - *nr_streams) * sizeof(*s));
+			*streams = s;
+			*nr_streams = id + 1;
+		}
+
+		s = &(*streams)[id];
+		data = realloc(s->data, s->len + len ?: 1);
+		if (!data)
+			return -ENOMEM;
+
+		memcpy(data + s->len, u.ptr, len);
+		s->data = data;
+		s->len += len;
+		u.ptr += len;
+	}
+
+	return 0;
+}
+
+static int unpack_trace(const uint8_t *ptr, const uint8_t *end, bool timed,
+			struct unpack *u, struct records *r)
+{
+	struct stream *streams = NULL;
+	unsigned int nr_streams = 0, i;
+	int ret;
+
+	ret = read_chunks(ptr, end, &streams, &nr_streams);
+
+	for (i = 0; !ret && i < nr_streams; i++) {
+		u->ptr = streams[i].data;
+		u->end = streams[i].data + streams[i].len;
+		ret = unpack_buffer(u, r, timed);
+	}
+
+	for (i = 0; i < nr_streams; i++)
+		free(streams[i].data);
+	free(streams);
+
+	if (!ret && r->nr)
+		qsort(r->records, r->nr, sizeof(*r->records), cmp_record);
+
+	return ret;
+}
+
+/* Splits a version 1 trace into its records, all of a single thread. */
+static int split_trace(const uint8_t *ptr, const uint8_t *end,
+		       struct unpack *u, struct records *r)
+{
+	u->ptr = ptr;
+	u->end = end;
+
+	r->tids = calloc(1, sizeof(*r->tids));
+	if (!r->tids)
+		return -ENOMEM;
+	r->nr_threads = 1;
+
+	while (u->ptr < u->end) {
+		const uint8_t *start = u->ptr;
+		struct igt_exec_trace_exec exec;
+		struct record *rec;
+		size_t len;
+
+		switch (*u->ptr++) {
+		case IGT_EXEC_TRACE_ADD_BO:
+			len = sizeof(struct igt_exec_trace_add_bo);
+			break;
+		case IGT_EXEC_TRACE_EXEC:
+			if (sizeof(exec) > (size_t)(u->end - u->ptr))
+				return -EIO;
+			memcpy(&exec, u->ptr, sizeof(exec));
+			len = sizeof(exec);
+
+			for (uint32_t i = 0; i < exec.object_count; i++) {
+				struct igt_exec_trace_exec_object obj;
+
+				if (len + sizeof(obj) > (size_t)(u->end - u->ptr))
+					return -EIO;
+				memcpy(&obj, u->ptr + len, sizeof(obj));
+				len += sizeof(obj) + (size_t)obj.relocation_count *
+				       sizeof(struct drm_i915_gem_relocation_entry);
+			}
+			break;
+		case IGT_EXEC_TRACE_DEL_BO:
+		case IGT_EXEC_TRACE_ADD_CTX:
+		case IGT_EXEC_TRACE_DEL_CTX:
+		case IGT_EXEC_TRACE_WAIT:
+			len = sizeof(uint32_t);
+			break;
+		default:
+			return -EIO;
+		}
+
+		if (len > (size_t)(u->end - u->ptr))
+			return -EIO;
+		u->ptr += len;
+
+		rec = add_record(r);
+		if (!rec)
+			return -ENOMEM;
+
+		*rec = (struct record){
+			.seq = r->nr - 1,
+			.offset = start - ptr,
+			.len = u->ptr - start,
+		};
+	}
+
+	return put(u, ptr, end - ptr);
+}
+
+/* The record lengths were checked when splitting or unpacking them. */
+static bool handles_valid(const uint8_t *record)
+{
+	const uint8_t *ptr = record + 1;
+	struct igt_exec_trace_exec exec;
+	uint32_t handle;
+
+	if (*record != IGT_EXEC_TRACE_EXEC) {
+		memcpy(&handle, ptr, sizeof(handle));
+		return handle < IGT_EXEC_TRACE_MAX_HANDLE;
+	}
+
+	memcpy(&exec, ptr, sizeof(exec));
+	if (exec.context >= IGT_EXEC_TRACE_MAX_HANDLE)
+		return false;
+	ptr += sizeof(exec);
+
+	for (uint32_t i = 0; i < exec.object_count; i++) {
+		struct igt_exec_trace_exec_object obj;
+
+		memcpy(&obj, ptr, sizeof(obj));
+		if (obj.handle >= IGT_EXEC_TRACE_MAX_HANDLE)
+			return false;
+		ptr += sizeof(obj) + (size_t)obj.relocation_count *
+		       sizeof(struct drm_i915_gem_relocation_entry);
+	}
+
+	return true;
+}
+
+/**
+ * igt_exec_trace_parse:
+ * @trace: Trace written by gem_exec_tracer, of any version
+ * @size: Size of @trace
+ * @out: Returns the parsed trace, to be freed with igt_exec_trace_free()
+ *
+ * Parses @trace into the events recorded by all threads, in order. Traces
+ * before #IGT_EXEC_TRACE_VERSION_TIMED have no timestamps and only those
+ * packed tell the threads apart.
+ *
+ * Returns 0 on success, -EINVAL if @trace is not an execbuf trace, -EPROTO
+ * for an unknown version, -EIO if it is corrupt or cut short and -ENOMEM.
+ */
+int igt_exec_trace_parse(const void *trace, size_t size,
+			 struct igt_exec_trace **out)
+{
+	const struct igt_exec_trace_version *version = trace;
+	const uint8_t *ptr = (const uint8_t *)(version + 1);
+	const uint8_t *end = (const uint8_t *)trace + size;
+	struct igt_exec_trace *t = NULL;
+	struct records r = { };
+	struct unpack u = { };
+	uint64_t start = UINT64_MAX;
+	unsigned int i;
+	int ret;
+
+	if (size < sizeof(*version) || version->magic != IGT_EXEC_TRACE_MAGIC)
+		return -EINVAL;
+
+	switch (version->version) {
+	case IGT_EXEC_TRACE_VERSION:
+		ret = split_trace(ptr, end, &u, &r);
+		break;
+	case IGT_EXEC_TRACE_VERSION_PACKED:
+	case IGT_EXEC_TRACE_VERSION_TIMED:
+		ret = unpack_trace(ptr, end,
+				   version->version == IGT_EXEC_TRACE_VERSION_TIMED,
+				   &u, &r);
+		break;
+	default:
+		return -EPROTO;
+	}
+	if (ret)
+		goto err;
+
+	ret = -ENOMEM;
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		goto err;
+
+	t->events = calloc(r.nr ?: 1, sizeof(*t->events));
+	if (!t->events)
+		goto err;
+
+	for (i = 0; i < r.nr; i++)
+		if (r.records[i].time < start)
+			start = r.records[i].time;
+
+	for (i = 0; i < r.nr; i++) {
+		const struct record *rec = &r.records[i];
+
+		if (!handles_valid(u.data + rec->offset)) {
+			ret = -EIO;
+			goto err;
+		}
+
+		t->events[i] = (struct igt_exec_trace_event){
+			.time_ns = rec->time - start,
+			.thread = rec->thread,
+			.cmd = u.data[rec->offset],
+			.record = u.data + rec->offset,
+			.len = rec->len,
+		};
+	}
+
+	t->nr_events = r.nr;
+	t->tids = r.tids;
+	t->nr_threads = r.nr_threads;
+	t->timed = version->version == IGT_EXEC_TRACE_VERSION_TIMED;
+	t->data = u.data;
+	free(r.records);
+
+	*out = t;
+
+	return 0;
+
+err:
+	if (t)
+		free(t->events);
+	free(t);
+	free(r.records);
+	free(r.tids);
+	free(u.data);
+
+	return ret;
+}
+
+/**
+ * igt_exec_trace_free:
+ * @trace: Trace returned by igt_exec_trace_parse()
+ *
+ * Frees @trace and its events.
+ */
+void igt_exec_trace_free(struct igt_exec_trace *trace)
+{
+	if (!trace)
+		return;
+
+	free(trace->events);
+	free(trace->tids);
+	free(trace->data);
+	free(trace);
+}
+
+/**
+ * igt_exec_trace_unpack:
+ * @trace: Packed trace written by gem_exec_tracer
+ * @size: Size of @trace
+ * @out: Returns the unpacked trace, to be freed by the caller
+ * @out_size: Returns the size of @out
+ *
+ * Unpacks a trace of #IGT_EXEC_TRACE_VERSION_PACKED or later into one of
+ * #IGT_EXEC_TRACE_VERSION, with the records of all threads in the order they
+ * were recorded. The last record of a thread is left out if the tracer could
+ * only write part of it before the application exited.
+ *
+ * Returns 0 on success, -EINVAL if @trace is not an execbuf trace, -EPROTO
+ * if it is not packed, -EIO if it is corrupt or cut short and -ENOMEM.
+ */
+int igt_exec_trace_unpack(const void *trace, size_t size,
+			  void **out, size_t *out_size)
+{
+	const struct igt_exec_trace_version *version = trace;
+	struct igt_exec_trace *t;
+	uint8_t *data;
+	size_t len;
+	int ret;
+
+	if (size >= sizeof(*version) &&
+	    version->magic == IGT_EXEC_TRACE_MAGIC &&
+	    version->version == IGT_EXEC_TRACE_VERSION)
+		return -EPROTO;
+
+	ret = igt_exec_trace_parse(trace, size, &t);
+	if (ret)
+		return ret;
+
+	len = sizeof(*version);
+	for (unsigned int i = 0; i < t->nr_events; i++)
+		len += t->events[i].len;
+
+	data = malloc(len);
+	if (!data) {
+		igt_exec_trace_free(t);
+		return -ENOMEM;
+	}
+
+	memcpy(data, &(struct igt_exec_trace_version){
+		IGT_EXEC_TRACE_MAGIC, IGT_EXEC_TRACE_VERSION
+	}, sizeof(*version));
+	len = sizeof(*version);
+	for (unsigned int i = 0; i < t->nr_events; i++) {
+		memcpy(data + len, t->events[i].record, t->events[i].len);
+		len += t->events[i].len;
+	}
+	igt_exec_trace_free(t);
+
+	*out = data;
+	*out_size = len;
+
+	return 0;
+}
+
+/*
+ * Writes the steps from @first, without the dependencies on earlier ones.
+ * Syncs with earlier steps are left out, shifting the steps after them, so
+ * @pos is where each step ends up in the workload.
+ */
+static void write_steps(const struct convert *c, FILE *out, unsigned int first,
+			unsigned int len, unsigned int *pos,
+			unsigned int duration_us)
+{
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < len; i++) {
+		const struct step *step = &c->steps[first + i];
+
+		pos[i] = nr;
+		if (step->type == STEP_SYNC) {
+			if (step->target < first)
+				continue;
+
+			fprintf(out, "s.-%u\n", nr - pos[step->target - first]);
+		} else {
+			unsigned int nr_deps = 0;
+
+			fprintf(out, "%u.%s.%u.", step->ctx, step->engine,
+				duration_us);
+			for (unsigned int j = step->nr_deps; j--; ) {
+				if (step->deps[j] < first)
+					continue;
+
+				fprintf(out, "%s-%u", nr_deps++ ? "/" : "",
+					nr - pos[step->deps[j] - first]);
+			}
+			fprintf(out, "%s.%u\n", nr_deps ? "" : "0", step->sync);
+		}
+		nr++;
+	}
+}
+
+/**
+ * igt_exec_trace_to_wsim:
+ * @trace: Trace written by gem_exec_tracer, packed or not
+ * @size: Size of @trace
+ * @out: Where to write the workload descriptor
+ * @opts: Conversion options
+ *
+ * Writes a gem_wsim workload descriptor replaying @trace to @out, see
+ * the section description.
+ *
+ * Returns 0 on success, -EINVAL if @trace is not an execbuf trace, -EPROTO
+ * for an unknown version, -EIO if it is corrupt or cut short and -ENOMEM.
+ */
+int igt_exec_trace_to_wsim(const void *trace, size_t size, FILE *out,
+			   const struct igt_exec_trace_wsim *opts)
+{
+	const struct igt_exec_trace_version *version = trace;
+	unsigned int start = 0, len, repeats = 1, *pos = NULL, i;
+	struct convert c = { };
+	void *unpacked = NULL;
+	bool frame = false;
+	int ret;
+
+	if (size >= sizeof(*version) &&
+	    version->magic == IGT_EXEC_TRACE_MAGIC &&
+	    version->version != IGT_EXEC_TRACE_VERSION) {
+		ret = igt_exec_trace_unpack(trace, size, &unpacked, &size);
+		if (ret)
+			return ret;
+
+		trace = unpacked;
+	}
+
+	c.ptr = trace;
+	c.end = (const uint8_t *)trace + size;
+	ret = convert_trace(&c);
+	if (ret)
+		goto out;
+
+	fprintf(out, "# Converted from gem_exec_tracer: %u batches on %u contexts\n",
+		c.nr_batches, c.nr_ctxs);
+
+	len = c.nr_steps;
+	if (opts->loop)
+		frame = find_frame(&c, &start, &len, &repeats);
+
+	if (frame) {
+		fprintf(out, "# Frame of %u steps repeating %u times, run with -r %u\n",
+			len, repeats, repeats);
+		if (start)
+			fprintf(out, "# The %u steps before were skipped\n",
+				start);
+		if (opts->period_us)
+			fprintf(out, "p.%u\n", opts->period_us);
+	}
+
+	pos = calloc(len ?: 1, sizeof(*pos));
+	if (!pos) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	write_steps(&c, out, start, len, pos, opts->duration_us);
+
+	if (ferror(out))
+		ret = -EIO;
+out:
+	free(pos);
+	free(unpacked);
+	for (i = 0; i < c.nr_steps; i++)
+		free(c.steps[i].deps);
+	free(c.steps);
+	for (i = 0; i < c.nr_objects; i++)
+		free(c.objects[i].reads);
+	free(c.objects);
+	free(c.ctx_ids);
+	free(c.timelines);
+
+	return ret;
+}
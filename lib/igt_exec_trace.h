@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_EXEC_TRACE_H
+#define IGT_EXEC_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define IGT_EXEC_TRACE_MAGIC 0xdeadbeef
+#define IGT_EXEC_TRACE_VERSION 1
+#define IGT_EXEC_TRACE_VERSION_PACKED 2
+#define IGT_EXEC_TRACE_VERSION_TIMED 3
+
+/*
+ * The kernel hands out the lowest free buffer and context handles, so traces
+ * with larger ones are taken as corrupt rather than sized for.
+ */
+#define IGT_EXEC_TRACE_MAX_HANDLE (1u << 20)
+
+/*
+ * Traces written by the gem_exec_tracer preload library start with the
+ * version, followed by records of a command byte and its payload.
+ */
+struct igt_exec_trace_version {
+	uint32_t magic;
+	uint32_t version;
+} __attribute__((packed));
+
+enum igt_exec_trace_cmd {
+	IGT_EXEC_TRACE_ADD_BO = 0,
+	IGT_EXEC_TRACE_DEL_BO,
+	IGT_EXEC_TRACE_ADD_CTX,
+	IGT_EXEC_TRACE_DEL_CTX,
+	IGT_EXEC_TRACE_EXEC,
+	IGT_EXEC_TRACE_WAIT,
+};
+
+struct igt_exec_trace_add_bo {
+	uint32_t handle;
+	uint64_t size;
+} __attribute__((packed));
+
+struct igt_exec_trace_del_bo {
+	uint32_t handle;
+} __attribute__((packed));
+
+struct igt_exec_trace_add_ctx {
+	uint32_t handle;
+} __attribute__((packed));
+
+struct igt_exec_trace_del_ctx {
+	uint32_t handle;
+} __attribute__((packed));
+
+/*
+ * Followed by object_count objects, each followed by its relocation_count
+ * struct drm_i915_gem_relocation_entry.
+ */
+struct igt_exec_trace_exec {
+	uint32_t object_count;
+	uint64_t flags;
+	uint32_t context;
+} __attribute__((packed));
+
+struct igt_exec_trace_exec_object {
+	uint32_t handle;
+	uint32_t relocation_count;
+	uint64_t alignment;
+	uint64_t offset;
+	uint64_t flags;
+	uint64_t rsvd1;
+	uint64_t rsvd2;
+} __attribute__((packed));
+
+struct igt_exec_trace_wait {
+	uint32_t handle;
+} __attribute__((packed));
+
+/*
+ * Packed traces, of version 2, are written by gem_exec_tracer from a buffer
+ * per thread. After the version come chunks of a varint buffer id and length
+ * followed by as many bytes of the buffer, so records may be split across
+ * chunks. Each buffer holds records of the command byte, the varint increment
+ * of the sequence number ordering the records of all buffers and the fields
+ * of the version 1 payload as varints, objects and relocations following
+ * their exec. Buffer handles are zigzag encoded differences from the previous
+ * handle in the buffer.
+ *
+ * Timed traces, of version 3, are packed the same but each buffer starts with
+ * the varint thread id and each sequence number is followed by the varint
+ * increment of the CLOCK_MONOTONIC nanoseconds the record was made at.
+ */
+#define IGT_EXEC_TRACE_MAX_PACKED 64 /* Largest record, object or relocation */
+
+struct igt_exec_trace_packer {
+	uint64_t seq;
+	uint64_t time;
+	uint32_t handle;
+};
+
+static inline uint8_t *igt_exec_trace_pack(uint8_t *ptr, uint64_t value)
+{
+	while (value >= 0x80) {
+		*ptr++ = value | 0x80;
+		value >>= 7;
+	}
+	*ptr++ = value;
+
+	return ptr;
+}
+
+static inline uint8_t *
+igt_exec_trace_pack_cmd(struct igt_exec_trace_packer *packer, uint8_t *ptr,
+			uint8_t cmd, uint64_t seq, uint64_t time)
+{
+	*ptr++ = cmd;
+	ptr = igt_exec_trace_pack(ptr, seq - packer->seq);
+	ptr = igt_exec_trace_pack(ptr, time - packer->time);
+	packer->seq = seq;
+	packer->time = time;
+
+	return ptr;
+}
+
+static inline uint8_t *
+igt_exec_trace_pack_handle(struct igt_exec_trace_packer *packer, uint8_t *ptr,
+			   uint32_t handle)
+{
+	int32_t delta = handle - packer->handle;
+
+	packer->handle = handle;
+
+	return igt_exec_trace_pack(ptr, (uint32_t)delta << 1 ^ (delta >> 31));
+}
+
+/**
+ * igt_exec_trace_event:
+ * @time_ns: When it was recorded, from the first event, 0 if not timed
+ * @thread: Index of the thread recording it
+ * @cmd: #igt_exec_trace_cmd
+ * @record: The version 1 record, from its command byte
+ * @len: Size of @record
+ */
+struct igt_exec_trace_event {
+	uint64_t time_ns;
+	unsigned int thread;
+	uint8_t cmd;
+	const uint8_t *record;
+	size_t len;
+};
+
+/**
+ * igt_exec_trace:
+ * @events: Events of all threads in the order they were recorded
+ * @nr_events: Number of @events
+ * @tids: Ids of the threads recording the events, 0 if not recorded
+ * @nr_threads: Number of @tids
+ * @timed: Whether the events have timestamps
+ */
+struct igt_exec_trace {
+	struct igt_exec_trace_event *events;
+	unsigned int nr_events;
+	uint32_t *tids;
+	unsigned int nr_threads;
+	bool timed;
+
+	/*< private >*/
+	uint8_t *data;
+};
+
+/**
+ * igt_exec_trace_wsim:
+ * @duration_us: Duration of every batch, which the trace does not record
+ * @period_us: Period of a frame found repeating, 0 for none
+ * @loop: Whether to look for a repeating frame at all
+ */
+struct igt_exec_trace_wsim {
+	unsigned int duration_us;
+	unsigned int period_us;
+	bool loop;
+};
+
+int igt_exec_trace_parse(const void *trace, size_t size,
+			 struct igt_exec_trace **out);
+void igt_exec_trace_free(struct igt_exec_trace *trace);
+int igt_exec_trace_unpack(const void *trace, size_t size,
+			  void **out, size_t *out_size);
+int igt_exec_trace_to_wsim(const void *trace, size_t size, FILE *out,
+			   const struct igt_exec_trace_wsim *opts);
+
+#endif /* IGT_EXEC_TRACE_H */
@@ -317,6 +317,32 @@ bool igt_facts_are_all_lists_empty(void)
 	       igt_list_empty(&igt_facts_list_pci_gpu_head);
 }
 
+/**
+ * igt_facts_for_each:
+ * @fn: function called with each fact
+ * @data: passed on to @fn
+ *
+ * Calls @fn for each of the facts gathered by the last igt_facts(), such as
+ * for recording the environment along with benchmark results.
+ *
+ * Returns: void
+ */
+void igt_facts_for_each(void (*fn)(const igt_fact *fact, void *data),
+			void *data)
+{
+	struct igt_list_head *heads[] = {
+		&igt_facts_list_pci_gpu_head,
+		&igt_facts_list_drm_card_head,
+		&igt_facts_list_kmod_head,
+		&igt_facts_list_ktaint_head,
+	};
+	igt_fact *fact;
+
+	for (int i = 0; i < sizeof(heads) / sizeof(heads[0]); i++)
+		igt_list_for_each_entry(fact, heads[i], link)
+			fn(fact, data);
+}
+
 /**
  * igt_facts_scan_pci_gpus:
  * @last_test: name of the last test
@@ -41,6 +41,8 @@ struct igt_facts_config {
 void igt_facts_lists_init(void);
 void igt_facts(const char *last_test);
 bool igt_facts_are_all_lists_empty(void);
+void igt_facts_for_each(void (*fn)(const igt_fact *fact, void *data),
+			void *data);
 void igt_facts_test(void); /* For unit testing only */
 
 #endif /* IGT_FACTS_H */
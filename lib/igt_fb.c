@@ -4175,11 +4175,11 @@ static void convert_float_to_Y410(struct fb_convert *cvt, bool alpha)
 	}
 }
 
-/* { R, G, B, X } */
-static const unsigned char swizzle_rgbx[] = { 0, 1, 2, 3 };
-static const unsigned char swizzle_bgrx[] = { 2, 1, 0, 3 };
-
-static const unsigned char *rgbx_swizzle(uint32_t format)
+/*
+ * The 16 bpc RGB formats are either stored as RGBX, which matches
+ * IGT_FORMAT_FLOAT, or as BGRX which needs R and B swapped.
+ */
+static bool rgbx_needs_swap(uint32_t format)
 {
 	switch (format) {
 	default:
@@ -4187,49 +4187,29 @@ static const unsigned char *rgbx_swizzle(uint32_t format)
 	case DRM_FORMAT_ARGB16161616F:
 	case DRM_FORMAT_XRGB16161616:
 	case DRM_FORMAT_ARGB16161616:
-		return swizzle_bgrx;
+		return true;
 	case DRM_FORMAT_XBGR16161616F:
 	case DRM_FORMAT_ABGR16161616F:
 	case DRM_FORMAT_XBGR16161616:
 	case DRM_FORMAT_ABGR16161616:
-		return swizzle_rgbx;
+		return false;
 	}
 }
 
 static void convert_fp16_to_float(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *fp16;
 	float *ptr = cvt->dst.ptr;
 	unsigned int float_stride = cvt->dst.fb->strides[0] / sizeof(*ptr);
 	unsigned int fp16_stride = cvt->src.fb->strides[0] / sizeof(*fp16);
-	const unsigned char *swz = rgbx_swizzle(cvt->src.fb->drm_format);
-	bool needs_reswizzle = swz != swizzle_rgbx;
+	bool swap_rb = rgbx_needs_swap(cvt->src.fb->drm_format);
 
 	uint16_t *buf = convert_src_get(cvt);
 	fp16 = buf + cvt->src.fb->offsets[0] / sizeof(*buf);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
-		if (needs_reswizzle) {
-			const uint16_t *fp16_tmp = fp16;
-			float *rgb_tmp = ptr;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				igt_half_to_float(fp16_tmp, rgb.d, 4);
-
-				rgb_tmp[0] = rgb.d[swz[0]];
-				rgb_tmp[1] = rgb.d[swz[1]];
-				rgb_tmp[2] = rgb.d[swz[2]];
-				rgb_tmp[3] = rgb.d[swz[3]];
-
-				rgb_tmp += 4;
-				fp16_tmp += 4;
-			}
-		} else {
-			igt_half_to_float(fp16, ptr, cvt->dst.fb->width * 4);
-		}
+		igt_rgbx16f_to_float(fp16, ptr, cvt->dst.fb->width, swap_rb);
 
 		ptr += float_stride;
 		fp16 += fp16_stride;
@@ -4240,87 +4220,35 @@ static void convert_fp16_to_float(struct fb_convert *cvt)
 
 static void convert_float_to_fp16(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *fp16 = cvt->dst.ptr + cvt->dst.fb->offsets[0];
 	const float *ptr = cvt->src.ptr;
 	unsigned float_stride = cvt->src.fb->strides[0] / sizeof(*ptr);
 	unsigned fp16_stride = cvt->dst.fb->strides[0] / sizeof(*fp16);
-	const unsigned char *swz = rgbx_swizzle(cvt->dst.fb->drm_format);
-	bool needs_reswizzle = swz != swizzle_rgbx;
+	bool swap_rb = rgbx_needs_swap(cvt->dst.fb->drm_format);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
-		if (needs_reswizzle) {
-			const float *rgb_tmp = ptr;
-			uint16_t *fp16_tmp = fp16;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				rgb.d[0] = rgb_tmp[swz[0]];
-				rgb.d[1] = rgb_tmp[swz[1]];
-				rgb.d[2] = rgb_tmp[swz[2]];
-				rgb.d[3] = rgb_tmp[swz[3]];
-
-				igt_float_to_half(rgb.d, fp16_tmp, 4);
-
-				rgb_tmp += 4;
-				fp16_tmp += 4;
-			}
-		} else {
-			igt_float_to_half(ptr, fp16, cvt->dst.fb->width * 4);
-		}
+		igt_float_to_rgbx16f(ptr, fp16, cvt->dst.fb->width, swap_rb);
 
 		ptr += float_stride;
 		fp16 += fp16_stride;
 	}
 }
 
-static void float_to_uint16(const float *f, uint16_t *h, unsigned int num)
-{
-	for (int i = 0; i < num; i++)
-		h[i] = f[i] * 65535.0f + 0.5f;
-}
-
-static void uint16_to_float(const uint16_t *h, float *f, unsigned int num)
-{
-	for (int i = 0; i < num; i++)
-		f[i] = ((float) h[i]) / 65535.0f;
-}
-
 static void convert_uint16_to_float(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *up16;
 	float *ptr = cvt->dst.ptr;
 	unsigned int float_stride = cvt->dst.fb->strides[0] / sizeof(*ptr);
 	unsigned int up16_stride = cvt->src.fb->strides[0] / sizeof(*up16);
-	const unsigned char *swz = rgbx_swizzle(cvt->src.fb->drm_format);
-	bool needs_reswizzle = swz != swizzle_rgbx;
+	bool swap_rb = rgbx_needs_swap(cvt->src.fb->drm_format);
 
 	uint16_t *buf = convert_src_get(cvt);
 	up16 = buf + cvt->src.fb->offsets[0] / sizeof(*buf);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
-		if (needs_reswizzle) {
-			const uint16_t *u16_tmp = up16;
-			float *rgb_tmp = ptr;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				uint16_to_float(u16_tmp, rgb.d, 4);
-
-				rgb_tmp[0] = rgb.d[swz[0]];
-				rgb_tmp[1] = rgb.d[swz[1]];
-				rgb_tmp[2] = rgb.d[swz[2]];
-				rgb_tmp[3] = rgb.d[swz[3]];
-
-				rgb_tmp += 4;
-				u16_tmp += 4;
-			}
-		} else {
-			uint16_to_float(up16, ptr, cvt->dst.fb->width * 4);
-		}
+		igt_rgbx16_to_float(up16, ptr, cvt->dst.fb->width, swap_rb);
 
 		ptr += float_stride;
 		up16 += up16_stride;
@@ -4331,35 +4259,15 @@ static void convert_uint16_to_float(struct fb_convert *cvt)
 
 static void convert_float_to_uint16(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *up16 = cvt->dst.ptr + cvt->dst.fb->offsets[0];
 	const float *ptr = cvt->src.ptr;
 	unsigned float_stride = cvt->src.fb->strides[0] / sizeof(*ptr);
 	unsigned up16_stride = cvt->dst.fb->strides[0] / sizeof(*up16);
-	const unsigned char *swz = rgbx_swizzle(cvt->dst.fb->drm_format);
-	bool needs_reswizzle = swz != swizzle_rgbx;
+	bool swap_rb = rgbx_needs_swap(cvt->dst.fb->drm_format);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
-		if (needs_reswizzle) {
-			const float *rgb_tmp = ptr;
-			uint16_t *u16_tmp = up16;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				rgb.d[0] = rgb_tmp[swz[0]];
-				rgb.d[1] = rgb_tmp[swz[1]];
-				rgb.d[2] = rgb_tmp[swz[2]];
-				rgb.d[3] = rgb_tmp[swz[3]];
-
-				float_to_uint16(rgb.d, u16_tmp, 4);
-
-				rgb_tmp += 4;
-				u16_tmp += 4;
-			}
-		} else {
-			float_to_uint16(ptr, up16, cvt->dst.fb->width * 4);
-		}
+		igt_float_to_rgbx16(ptr, up16, cvt->dst.fb->width, swap_rb);
 
 		ptr += float_stride;
 		up16 += up16_stride;
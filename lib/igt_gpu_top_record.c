@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_gpu_top_record
+ * @short_description: Compact recordings of GPU counter samples
+ * @title: GPU top recordings
+ * @include: igt_gpu_top_record.h
+ *
+ * Stores the samples intel_gpu_top takes, in the layout of
+ * struct igt_gpu_top_sample, to a file which can later be replayed through
+ * the same rendering code, or exported, without access to the GPU.
+ *
+ * A recording starts with a struct igt_gpu_top_record_header. Each sample
+ * follows as a record holding its difference to the previous one: the sample
+ * is taken as an array of 64 bit words, only covering the clients in use,
+ * and every word which changed is stored as the number of unchanged words
+ * skipped before it followed by the zigzag encoded difference, both as
+ * LEB128 varints. As all counters are cumulative a typical sample costs a
+ * few bytes per busy engine or client. Records are prefixed by their length
+ * so a recording cut short by a crash replays up to its last whole sample.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_gpu_top_record.h"
+
+#define SAMPLE_WORDS (sizeof(struct igt_gpu_top_sample) / sizeof(uint64_t))
+#define MAX_VARINT 10
+/* Word count, then a skip and a difference per word in the worst case. */
+#define MAX_RECORD (MAX_VARINT + 2 * MAX_VARINT * SAMPLE_WORDS)
+
+struct igt_gpu_top_record {
+	FILE *file;
+	uint64_t count;
+	struct igt_gpu_top_sample prev;
+	struct igt_gpu_top_sample cur;
+	uint8_t buf[MAX_RECORD + MAX_VARINT];
+};
+
+struct igt_gpu_top_replay {
+	FILE *file;
+	struct igt_gpu_top_record_header header;
+	struct igt_gpu_top_sample cur;
+	uint8_t buf[MAX_RECORD];
+};
+
+_Static_assert(sizeof(struct igt_gpu_top_sample) % sizeof(uint64_t) == 0,
+	       "samples must be whole words");
+_Static_assert(sizeof(struct igt_gpu_top_client) % sizeof(uint64_t) == 0,
+	       "clients must be whole words");
+
+/* Only the clients in use are part of a sample. */
+static unsigned int sample_words(const struct igt_gpu_top_sample *sample)
+{
+	uint32_t num_clients = sample->num_clients;
+
+	if (num_clients > IGT_GPU_TOP_MAX_CLIENTS)
+		num_clients = IGT_GPU_TOP_MAX_CLIENTS;
+
+	return (offsetof(struct igt_gpu_top_sample, clients) +
+		num_clients * sizeof(struct igt_gpu_top_client)) /
+	       sizeof(uint64_t);
+}
+
+static unsigned int put_varint(uint8_t *p, uint64_t v)
+{
+	unsigned int n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = v | 0x80;
+		v >>= 7;
+	}
+	p[n++] = v;
+
+	return n;
+}
+
+static int get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+	unsigned int shift;
+
+	*v = 0;
+	for (shift = 0; shift < 64 && *p < end; shift += 7) {
+		uint8_t b = *(*p)++;
+
+		*v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return 0;
+	}
+
+	return -EIO;
+}
+
+/**
+ * igt_gpu_top_record_create:
+ * @path: File to record to, replaced if it exists
+ * @info: Description of the device the samples are from
+ * @period_ns: Nominal sampling period
+ *
+ * Returns the recording to pass samples to, or NULL with errno set.
+ */
+struct igt_gpu_top_record *
+igt_gpu_top_record_create(const char *path, const struct igt_gpu_top_info *info,
+			  uint64_t period_ns)
+{
+	struct igt_gpu_top_record_header header = {
+		.magic = IGT_GPU_TOP_RECORD_MAGIC,
+		.version = IGT_GPU_TOP_RECORD_VERSION,
+		.info_size = sizeof(header.info),
+		.sample_size = sizeof(struct igt_gpu_top_sample),
+		.period_ns = period_ns,
+		.info = *info,
+	};
+	struct igt_gpu_top_record *rec;
+	int err;
+
+	rec = calloc(1, sizeof(*rec));
+	if (!rec)
+		return NULL;
+
+	rec->file = fopen(path, "w");
+	if (!rec->file) {
+		err = errno;
+		free(rec);
+		errno = err;
+		return NULL;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, rec->file) != 1) {
+		err = errno ?: EIO;
+		fclose(rec->file);
+		free(rec);
+		errno = err;
+		return NULL;
+	}
+
+	return rec;
+}
+
+/**
+ * igt_gpu_top_record_write:
+ * @rec: Recording from igt_gpu_top_record_create()
+ * @sample: Sample to append
+ *
+ * Appends @sample, as its difference to the previous one. The index of the
+ * sample is not taken from @sample but counts the samples recorded.
+ *
+ * Returns 0 on success or a negative error code.
+ */
+int igt_gpu_top_record_write(struct igt_gpu_top_record *rec,
+			     const struct igt_gpu_top_sample *sample)
+{
+	const uint64_t *cur = (const uint64_t *)&rec->cur;
+	uint64_t *prev = (uint64_t *)&rec->prev;
+	unsigned int words, skip = 0, len, hdr;
+	uint8_t *p = rec->buf + MAX_VARINT;
+	uint8_t *start = p;
+
+	words = sample_words(sample);
+	memcpy(&rec->cur, sample, words * sizeof(uint64_t));
+	rec->cur.index = rec->count;
+
+	p += put_varint(p, words);
+	for (unsigned int i = 0; i < words; i++) {
+		int64_t delta = cur[i] - prev[i];
+
+		if (!delta) {
+			skip++;
+			continue;
+		}
+
+		p += put_varint(p, skip);
+		p += put_varint(p, (uint64_t)delta << 1 ^ (uint64_t)(delta >> 63));
+		prev[i] = cur[i];
+		skip = 0;
+	}
+	if (skip)
+		p += put_varint(p, skip);
+
+	/* Length goes right in front of the record. */
+	len = p - start;
+	hdr = put_varint(rec->buf, len);
+	memmove(start - hdr, rec->buf, hdr);
+
+	if (fwrite(start - hdr, hdr + len, 1, rec->file) != 1)
+		return -EIO;
+
+	rec->count++;
+
+	return 0;
+}
+
+/**
+ * igt_gpu_top_record_close:
+ * @rec: Recording from igt_gpu_top_record_create(), or NULL
+ *
+ * Returns 0 on success, or a negative error code if the recording could not
+ * be written out completely.
+ */
+int igt_gpu_top_record_close(struct igt_gpu_top_record *rec)
+{
+	int ret = 0;
+
+	if (!rec)
+		return 0;
+
+	if (ferror(rec->file))
+		ret = -EIO;
+	if (fclose(rec->file) && !ret)
+		ret = -errno;
+	free(rec);
+
+	return ret;
+}
+
+/**
+ * igt_gpu_top_replay_open:
+ * @path: Recording made with igt_gpu_top_record_create()
+ *
+ * Returns the recording positioned at its first sample, or NULL with errno
+ * set. EPROTO means it was not made by a build using the same layout.
+ */
+struct igt_gpu_top_replay *igt_gpu_top_replay_open(const char *path)
+{
+	struct igt_gpu_top_replay *replay;
+	struct igt_gpu_top_record_header *header;
+	int err;
+
+	replay = calloc(1, sizeof(*replay));
+	if (!replay)
+		return NULL;
+	header = &replay->header;
+
+	replay->file = fopen(path, "r");
+	if (!replay->file) {
+		err = errno;
+		goto err;
+	}
+
+	if (fread(header, sizeof(*header), 1, replay->file) != 1 ||
+	    header->magic != IGT_GPU_TOP_RECORD_MAGIC)
+		err = EINVAL;
+	else if (header->version != IGT_GPU_TOP_RECORD_VERSION ||
+		 header->info_size != sizeof(header->info) ||
+		 header->sample_size != sizeof(struct igt_gpu_top_sample))
+		err = EPROTO;
+	else
+		return replay;
+
+	fclose(replay->file);
+err:
+	free(replay);
+	errno = err;
+	return NULL;
+}
+
+/**
+ * igt_gpu_top_replay_header:
+ * @replay: Recording from igt_gpu_top_replay_open()
+ *
+ * Returns the header of the recording, with the device description.
+ */
+const struct igt_gpu_top_record_header *
+igt_gpu_top_replay_header(const struct igt_gpu_top_replay *replay)
+{
+	return &replay->header;
+}
+
+static int read_length(FILE *file, uint64_t *len)
+{
+	unsigned int shift;
+	int c;
+
+	*len = 0;
+	for (shift = 0; shift < 64; shift += 7) {
+		c = getc(file);
+		if (c == EOF)
+			return -ENODATA;
+
+		*len |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return 0;
+	}
+
+	return -EIO;
+}
+
+/**
+ * igt_gpu_top_replay_next:
+ * @replay: Recording from igt_gpu_top_replay_open()
+ * @sample: Where to decode the next sample
+ *
+ * Only the clients in use are valid in the returned @sample.
+ *
+ * Returns 0 on success, -ENODATA at the end of the recording, including a
+ * sample cut short, and -EIO if the recording is corrupt.
+ */
+int igt_gpu_top_replay_next(struct igt_gpu_top_replay *replay,
+			    struct igt_gpu_top_sample *sample)
+{
+	uint64_t *cur = (uint64_t *)&replay->cur;
+	const uint8_t *p = replay->buf, *end;
+	uint64_t len, words, pos, v;
+	int ret;
+
+	ret = read_length(replay->file, &len);
+	if (ret)
+		return ret;
+	if (len > sizeof(replay->buf))
+		return -EIO;
+	if (fread(replay->buf, len, 1, replay->file) != 1)
+		return -ENODATA;
+	end = p + len;
+
+	if (get_varint(&p, end, &words) || words > SAMPLE_WORDS)
+		return -EIO;
+
+	for (pos = 0; pos < words; pos++) {
+		if (get_varint(&p, end, &v) || v > words - pos)
+			return -EIO;
+		pos += v;
+		if (pos == words)
+			break;
+
+		if (get_varint(&p, end, &v))
+			return -EIO;
+		cur[pos] += v >> 1 ^ -(v & 1);
+	}
+	if (p != end || sample_words(&replay->cur) != words)
+		return -EIO;
+
+	memcpy(sample, &replay->cur, words * sizeof(uint64_t));
+
+	return 0;
+}
+
+/**
+ * igt_gpu_top_replay_close:
+ * @replay: Recording from igt_gpu_top_replay_open(), or NULL
+ */
+void igt_gpu_top_replay_close(struct igt_gpu_top_replay *replay)
+{
+	if (!replay)
+		return;
+
+	fclose(replay->file);
+	free(replay);
+}
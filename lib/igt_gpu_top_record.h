@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_GPU_TOP_RECORD_H
+#define IGT_GPU_TOP_RECORD_H
+
+#include <stdint.h>
+
+#include "igt_gpu_top_shm.h"
+
+#define IGT_GPU_TOP_RECORD_MAGIC 0x52544749 /* "IGTR" */
+#define IGT_GPU_TOP_RECORD_VERSION 1
+
+/* Start of a recording, the delta encoded samples follow. */
+struct igt_gpu_top_record_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t info_size;
+	uint32_t sample_size;
+	uint64_t period_ns; /* Nominal sampling period. */
+	struct igt_gpu_top_info info;
+};
+
+struct igt_gpu_top_record;
+
+struct igt_gpu_top_record *
+igt_gpu_top_record_create(const char *path, const struct igt_gpu_top_info *info,
+			  uint64_t period_ns);
+int igt_gpu_top_record_write(struct igt_gpu_top_record *rec,
+			     const struct igt_gpu_top_sample *sample);
+int igt_gpu_top_record_close(struct igt_gpu_top_record *rec);
+
+struct igt_gpu_top_replay;
+
+struct igt_gpu_top_replay *igt_gpu_top_replay_open(const char *path);
+const struct igt_gpu_top_record_header *
+igt_gpu_top_replay_header(const struct igt_gpu_top_replay *replay);
+int igt_gpu_top_replay_next(struct igt_gpu_top_replay *replay,
+			    struct igt_gpu_top_sample *sample);
+void igt_gpu_top_replay_close(struct igt_gpu_top_replay *replay);
+
+#endif /* IGT_GPU_TOP_RECORD_H */
@@ -0,0 +1,279 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_gpu_top_shm
+ * @short_description: Shared memory export of GPU counter samples
+ * @title: GPU top shared memory
+ * @include: igt_gpu_top_shm.h
+ *
+ * A sampling daemon such as intel_gpu_top --daemon publishes the raw counter
+ * values it reads, and the DRM clients it finds, into a POSIX shared memory
+ * segment. Any number of viewers can attach to it and compute rates between
+ * two samples, without opening perf events or scanning /proc themselves.
+ *
+ * The segment starts with a struct igt_gpu_top_shm header, followed by an
+ * igt_seqlock ring of the most recent samples, so neither side ever blocks
+ * the other. All counters are cumulative, as read from perf or fdinfo.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "igt_gpu_top_shm.h"
+#include "igt_seqlock.h"
+
+_Static_assert(offsetof(struct igt_gpu_top_slot, sample) == sizeof(uint64_t),
+	       "igt_seqlock payload must follow the sequence count");
+
+static struct igt_seqlock_ring shm_ring(const struct igt_gpu_top_shm *shm)
+{
+	return (struct igt_seqlock_ring) {
+		.slots = (void *)shm->ring,
+		.slot_size = sizeof(shm->ring[0]),
+		.history = shm->history,
+		.head = (uint64_t *)&shm->head,
+	};
+}
+
+/**
+ * igt_gpu_top_shm_create:
+ * @name: POSIX shared memory object name, like IGT_GPU_TOP_SHM_NAME
+ * @info: Description of the device the samples are from
+ * @history: Number of samples kept in the ring
+ * @period_ns: Nominal sampling period, for the viewers
+ *
+ * Creates the segment, replacing any previous one of the same name. Viewers
+ * still attached to a replaced segment keep their mapping of it, but it is
+ * not updated anymore.
+ *
+ * Returns the mapped segment, or NULL with errno set.
+ */
+struct igt_gpu_top_shm *
+igt_gpu_top_shm_create(const char *name, const struct igt_gpu_top_info *info,
+		       unsigned int history, uint64_t period_ns)
+{
+	struct igt_gpu_top_shm *shm;
+	size_t size;
+	int fd, err;
+
+	if (!history) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	size = sizeof(*shm) + history * sizeof(shm->ring[0]);
+
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, size)) {
+		err = errno;
+		goto err;
+	}
+
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		err = errno;
+		goto err;
+	}
+	close(fd);
+
+	shm->version = IGT_GPU_TOP_SHM_VERSION;
+	shm->info_size = sizeof(shm->info);
+	shm->slot_size = sizeof(shm->ring[0]);
+	shm->history = history;
+	shm->pid = getpid();
+	shm->size = size;
+	shm->period_ns = period_ns;
+	shm->info = *info;
+	__atomic_store_n(&shm->magic, IGT_GPU_TOP_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return shm;
+
+err:
+	close(fd);
+	shm_unlink(name);
+	errno = err;
+	return NULL;
+}
+
+/**
+ * igt_gpu_top_shm_begin:
+ * @shm: Segment from igt_gpu_top_shm_create()
+ *
+ * Starts writing the next sample. The previous content of the returned slot
+ * is stale and all fields but the index need to be filled in before calling
+ * igt_gpu_top_shm_commit().
+ *
+ * Returns the sample to fill in.
+ */
+struct igt_gpu_top_sample *igt_gpu_top_shm_begin(struct igt_gpu_top_shm *shm)
+{
+	struct igt_seqlock_ring ring = shm_ring(shm);
+	struct igt_gpu_top_sample *sample = igt_seqlock_ring_begin(&ring);
+
+	sample->index = shm->head;
+
+	return sample;
+}
+
+/**
+ * igt_gpu_top_shm_commit:
+ * @shm: Segment from igt_gpu_top_shm_create()
+ *
+ * Publishes the sample started by igt_gpu_top_shm_begin() as the latest one.
+ */
+void igt_gpu_top_shm_commit(struct igt_gpu_top_shm *shm)
+{
+	struct igt_seqlock_ring ring = shm_ring(shm);
+
+	igt_seqlock_ring_commit(&ring);
+}
+
+/**
+ * igt_gpu_top_shm_destroy:
+ * @shm: Segment from igt_gpu_top_shm_create()
+ * @name: Name it was created with, or NULL to leave it in place
+ *
+ * Unmaps the segment, removing it unless @name is NULL.
+ */
+void igt_gpu_top_shm_destroy(struct igt_gpu_top_shm *shm, const char *name)
+{
+	if (!shm)
+		return;
+
+	if (name)
+		shm_unlink(name);
+	munmap(shm, shm->size);
+}
+
+/**
+ * igt_gpu_top_shm_attach:
+ * @name: POSIX shared memory object name
+ *
+ * Maps a segment published by igt_gpu_top_shm_create() read only.
+ *
+ * Returns the segment, or NULL with errno set. EAGAIN means the publisher is
+ * still setting it up, EPROTO that its layout is not the one of this build.
+ */
+const struct igt_gpu_top_shm *igt_gpu_top_shm_attach(const char *name)
+{
+	struct igt_gpu_top_shm *shm;
+	struct stat st;
+	int fd, err = 0;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st)) {
+		err = errno;
+		goto out;
+	}
+
+	if (st.st_size < sizeof(*shm)) {
+		err = EAGAIN;
+		goto out;
+	}
+
+	shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		err = errno;
+		goto out;
+	}
+
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != IGT_GPU_TOP_SHM_MAGIC)
+		err = EAGAIN;
+	else if (shm->version != IGT_GPU_TOP_SHM_VERSION ||
+		 shm->info_size != sizeof(shm->info) ||
+		 shm->slot_size != sizeof(shm->ring[0]) ||
+		 shm->size != st.st_size || !shm->history ||
+		 shm->size < sizeof(*shm) + shm->history * sizeof(shm->ring[0]))
+		err = EPROTO;
+
+	if (err)
+		munmap(shm, st.st_size);
+
+out:
+	close(fd);
+	if (err) {
+		errno = err;
+		return NULL;
+	}
+
+	return shm;
+}
+
+/**
+ * igt_gpu_top_shm_latest:
+ * @shm: Attached segment
+ *
+ * Returns the index of the latest published sample, or -1 if there is none
+ * yet.
+ */
+int64_t igt_gpu_top_shm_latest(const struct igt_gpu_top_shm *shm)
+{
+	struct igt_seqlock_ring ring = shm_ring(shm);
+
+	return igt_seqlock_ring_latest(&ring);
+}
+
+static void copy_sample(void *_dst, const void *_src, size_t len)
+{
+	struct igt_gpu_top_sample *dst = _dst;
+	const struct igt_gpu_top_sample *src = _src;
+	uint32_t num_clients;
+
+	/* Clients past the count are stale, no need to copy them. */
+	memcpy(dst, src, offsetof(struct igt_gpu_top_sample, clients));
+	num_clients = dst->num_clients;
+	if (num_clients > IGT_GPU_TOP_MAX_CLIENTS)
+		num_clients = IGT_GPU_TOP_MAX_CLIENTS;
+	memcpy(dst->clients, src->clients, num_clients * sizeof(dst->clients[0]));
+}
+
+/**
+ * igt_gpu_top_shm_read:
+ * @shm: Attached segment
+ * @index: Sample to read, at most igt_gpu_top_shm_latest()
+ * @sample: Where to copy the sample
+ *
+ * Copies out a consistent sample. Only the last shm->history samples are
+ * kept, older ones have been overwritten.
+ *
+ * Returns 0 on success, -EAGAIN if the sample was not published yet and
+ * -ENODATA if it was already overwritten.
+ */
+int igt_gpu_top_shm_read(const struct igt_gpu_top_shm *shm, uint64_t index,
+			 struct igt_gpu_top_sample *sample)
+{
+	struct igt_seqlock_ring ring = shm_ring(shm);
+	int ret;
+
+	ret = igt_seqlock_ring_read(&ring, index, sample, sizeof(*sample),
+				    copy_sample);
+	if (!ret && sample->index != index)
+		ret = -ENODATA;
+
+	return ret;
+}
+
+/**
+ * igt_gpu_top_shm_detach:
+ * @shm: Segment from igt_gpu_top_shm_attach()
+ */
+void igt_gpu_top_shm_detach(const struct igt_gpu_top_shm *shm)
+{
+	if (shm)
+		munmap((void *)shm, shm->size);
+}
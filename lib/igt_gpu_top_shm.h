@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_GPU_TOP_SHM_H
+#define IGT_GPU_TOP_SHM_H
+
+#include <stdint.h>
+
+#define IGT_GPU_TOP_SHM_NAME "/intel_gpu_top"
+#define IGT_GPU_TOP_SHM_MAGIC 0x50544749 /* "IGTP" */
+#define IGT_GPU_TOP_SHM_VERSION 1
+
+#define IGT_GPU_TOP_MAX_GTS 4
+#define IGT_GPU_TOP_MAX_ENGINES 64
+#define IGT_GPU_TOP_MAX_CLASSES 8
+#define IGT_GPU_TOP_MAX_REGIONS 4
+#define IGT_GPU_TOP_MAX_CLIENTS 128
+
+/**
+ * igt_gpu_top_counter:
+ *
+ * Indices of the device wide counters in struct igt_gpu_top_sample.
+ * Frequencies and RC6 are per GT, IGT_GPU_TOP_FREQ_REQ + gt and so on.
+ */
+enum igt_gpu_top_counter {
+	IGT_GPU_TOP_IRQ,
+	IGT_GPU_TOP_POWER_GPU,
+	IGT_GPU_TOP_POWER_PKG,
+	IGT_GPU_TOP_IMC_READS,
+	IGT_GPU_TOP_IMC_WRITES,
+	IGT_GPU_TOP_FREQ_REQ,
+	IGT_GPU_TOP_FREQ_ACT = IGT_GPU_TOP_FREQ_REQ + IGT_GPU_TOP_MAX_GTS,
+	IGT_GPU_TOP_RC6 = IGT_GPU_TOP_FREQ_ACT + IGT_GPU_TOP_MAX_GTS,
+	IGT_GPU_TOP_NUM_COUNTERS = IGT_GPU_TOP_RC6 + IGT_GPU_TOP_MAX_GTS,
+};
+
+/**
+ * igt_gpu_top_engine_counter:
+ *
+ * Indices of the per engine counters in struct igt_gpu_top_sample.
+ */
+enum igt_gpu_top_engine_counter {
+	IGT_GPU_TOP_ENGINE_BUSY,
+	IGT_GPU_TOP_ENGINE_WAIT,
+	IGT_GPU_TOP_ENGINE_SEMA,
+	IGT_GPU_TOP_ENGINE_COUNTERS,
+};
+
+struct igt_gpu_top_counter_info {
+	uint32_t present;
+	uint32_t pad;
+	double scale;
+	char units[16];
+};
+
+struct igt_gpu_top_engine_info {
+	char name[32]; /* PMU name, like rcs0. */
+	uint32_t class;
+	uint32_t instance;
+	uint32_t present; /* Mask of 1 << enum igt_gpu_top_engine_counter. */
+	uint32_t pad;
+};
+
+/* Static description of the device, written once before the first sample. */
+struct igt_gpu_top_info {
+	char card[64]; /* DRM device node. */
+	char codename[64];
+	char pci_slot[32];
+	char pmu_device[64];
+	uint32_t discrete;
+	uint32_t num_gts;
+	uint32_t num_engines;
+	uint32_t num_classes;
+	uint32_t num_regions;
+	uint32_t pad;
+	struct igt_gpu_top_counter_info counters[IGT_GPU_TOP_NUM_COUNTERS];
+	struct igt_gpu_top_engine_info engines[IGT_GPU_TOP_MAX_ENGINES];
+	char classes[IGT_GPU_TOP_MAX_CLASSES][16];
+	char regions[IGT_GPU_TOP_MAX_REGIONS][16];
+};
+
+struct igt_gpu_top_memory {
+	uint64_t total;
+	uint64_t shared;
+	uint64_t resident;
+	uint64_t purgeable;
+	uint64_t active;
+};
+
+struct igt_gpu_top_client {
+	uint64_t id;
+	uint32_t pid;
+	uint32_t drm_minor;
+	uint32_t num_regions; /* Regions the client reported. */
+	uint32_t pad;
+	char name[24];
+	uint64_t engine_time[IGT_GPU_TOP_MAX_CLASSES]; /* ns, per class. */
+	struct igt_gpu_top_memory memory[IGT_GPU_TOP_MAX_REGIONS];
+};
+
+struct igt_gpu_top_sample {
+	uint64_t index; /* Number of samples published before this one. */
+	uint64_t timestamp; /* perf timestamp of the counters, ns. */
+	uint64_t realtime; /* CLOCK_REALTIME when sampled, ns. */
+	uint64_t counters[IGT_GPU_TOP_NUM_COUNTERS];
+	uint64_t engines[IGT_GPU_TOP_MAX_ENGINES][IGT_GPU_TOP_ENGINE_COUNTERS];
+	uint32_t num_clients;
+	uint32_t pad;
+	struct igt_gpu_top_client clients[IGT_GPU_TOP_MAX_CLIENTS];
+};
+
+struct igt_gpu_top_slot {
+	uint64_t seq; /* Odd while the sample is written. */
+	struct igt_gpu_top_sample sample;
+};
+
+/* Layout of the segment, the ring of samples follows the header. */
+struct igt_gpu_top_shm {
+	uint32_t magic; /* Written last, once the header is valid. */
+	uint32_t version;
+	uint32_t info_size;
+	uint32_t slot_size;
+	uint32_t history; /* Number of ring slots. */
+	uint32_t pid; /* Publisher. */
+	uint64_t size; /* Of the whole segment. */
+	uint64_t period_ns; /* Nominal sampling period. */
+	uint64_t head; /* Number of samples published. */
+	struct igt_gpu_top_info info;
+	struct igt_gpu_top_slot ring[];
+};
+
+struct igt_gpu_top_shm *
+igt_gpu_top_shm_create(const char *name, const struct igt_gpu_top_info *info,
+		       unsigned int history, uint64_t period_ns);
+struct igt_gpu_top_sample *igt_gpu_top_shm_begin(struct igt_gpu_top_shm *shm);
+void igt_gpu_top_shm_commit(struct igt_gpu_top_shm *shm);
+void igt_gpu_top_shm_destroy(struct igt_gpu_top_shm *shm, const char *name);
+
+const struct igt_gpu_top_shm *igt_gpu_top_shm_attach(const char *name);
+int64_t igt_gpu_top_shm_latest(const struct igt_gpu_top_shm *shm);
+int igt_gpu_top_shm_read(const struct igt_gpu_top_shm *shm, uint64_t index,
+			 struct igt_gpu_top_sample *sample);
+void igt_gpu_top_shm_detach(const struct igt_gpu_top_shm *shm);
+
+#endif /* IGT_GPU_TOP_SHM_H */
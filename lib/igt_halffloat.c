@@ -24,6 +24,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdbool.h>
 
 #include "igt_halffloat.h"
 #include "igt_x86.h"
@@ -74,8 +75,8 @@ static inline uint16_t _float_to_half(float val)
 		/* m = 0; - already set */
 		e = 31;
 	} else if ((flt_e == 0xff) && (flt_m != 0)) {
-		/* NaN */
-		m = 1;
+		/* NaN -- quieted, with the payload truncated like F16C does */
+		m = 0x200 | (flt_m >> 13);
 		e = 31;
 	} else {
 		/* regular number */
@@ -149,9 +150,9 @@ static inline float _half_to_float(uint16_t val)
 		flt_e = 0xff;
 		flt_m = 0;
 	} else if ((e == 31) && (m != 0)) {
-		/* NaN */
+		/* NaN -- quieted, with the payload kept like F16C does */
 		flt_e = 0xff;
-		flt_m = 1;
+		flt_m = 0x400000 | (m << 13);
 	} else {
 		/* regular */
 		flt_e = e + 112;
@@ -162,6 +163,67 @@ static inline float _half_to_float(uint16_t val)
 	return fi.f;
 }
 
+static void float_to_half(const float *f, uint16_t *h, unsigned int num)
+{
+	for (int i = 0; i < num; i++)
+		h[i] = _float_to_half(f[i]);
+}
+
+static void half_to_float(const uint16_t *h, float *f, unsigned int num)
+{
+	for (int i = 0; i < num; i++)
+		f[i] = _half_to_float(h[i]);
+}
+
+/*
+ * Whole-row kernels for 4 channel, 16 bits per channel pixels. The only
+ * channel reordering the framebuffer code needs is the R<->B swap between
+ * the BGRX memory layout and the RGBX layout of IGT_FORMAT_FLOAT, so that
+ * is folded into the conversion instead of going through a temporary
+ * vector per pixel.
+ */
+static inline float _uint16_to_float(uint16_t val)
+{
+	return ((float) val) / 65535.0f;
+}
+
+/*
+ * Values outside [0.0, 1.0] saturate and NaN maps to 0, the float to
+ * integer conversion would be undefined for them otherwise. The SIMD
+ * kernels below implement the same clamping so that every path produces
+ * identical results for any input.
+ */
+static inline uint16_t _float_to_uint16(float val)
+{
+	if (!(val > 0.0f))
+		return 0;
+	if (val >= 1.0f)
+		return 65535;
+
+	return val * 65535.0f + 0.5f;
+}
+
+#define RGBX16_SCALAR(name, src_t, dst_t, cvt)				\
+static void name(const src_t *src, dst_t *dst,				\
+		 unsigned int num_pixels, bool swap_rb)			\
+{									\
+	const int r = swap_rb ? 2 : 0, b = swap_rb ? 0 : 2;		\
+									\
+	for (unsigned int i = 0; i < num_pixels; i++) {			\
+		dst[0] = cvt(src[r]);					\
+		dst[1] = cvt(src[1]);					\
+		dst[2] = cvt(src[b]);					\
+		dst[3] = cvt(src[3]);					\
+		src += 4;						\
+		dst += 4;						\
+	}								\
+}
+
+RGBX16_SCALAR(rgbx16f_to_float_scalar, uint16_t, float, _half_to_float)
+RGBX16_SCALAR(float_to_rgbx16f_scalar, float, uint16_t, _float_to_half)
+RGBX16_SCALAR(rgbx16_to_float_scalar, uint16_t, float, _uint16_to_float)
+RGBX16_SCALAR(float_to_rgbx16_scalar, float, uint16_t, _float_to_uint16)
+
 #if defined(__x86_64__) && !defined(__clang__) && defined(__GLIBC__) && !defined(__UCLIBC__)
 #pragma GCC push_options
 #pragma GCC target("f16c")
@@ -182,16 +244,132 @@ static void half_to_float_f16c(const uint16_t *h, float *f, unsigned int num)
 
 #pragma GCC pop_options
 
-static void float_to_half(const float *f, uint16_t *h, unsigned int num)
+#pragma GCC push_options
+#pragma GCC target("avx2,f16c")
+
+/*
+ * Each 128 bit lane of a ymm register holds exactly one pixel, so the R<->B
+ * swap is a single in-lane permute.
+ */
+#define SWAP_RB _MM_SHUFFLE(3, 0, 1, 2)
+
+static void rgbx16f_to_float_avx2(const uint16_t *h, float *f,
+				  unsigned int num_pixels, bool swap_rb)
 {
-	for (int i = 0; i < num; i++)
-		h[i] = _float_to_half(f[i]);
+	unsigned int i = 0;
+
+	for (; i + 2 <= num_pixels; i += 2) {
+		__m256 v = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)h));
+
+		if (swap_rb)
+			v = _mm256_permute_ps(v, SWAP_RB);
+		_mm256_storeu_ps(f, v);
+
+		h += 8;
+		f += 8;
+	}
+
+	rgbx16f_to_float_scalar(h, f, num_pixels - i, swap_rb);
 }
 
-static void half_to_float(const uint16_t *h, float *f, unsigned int num)
+static void float_to_rgbx16f_avx2(const float *f, uint16_t *h,
+				  unsigned int num_pixels, bool swap_rb)
 {
-	for (int i = 0; i < num; i++)
-		f[i] = _half_to_float(h[i]);
+	unsigned int i = 0;
+
+	for (; i + 2 <= num_pixels; i += 2) {
+		__m256 v = _mm256_loadu_ps(f);
+
+		if (swap_rb)
+			v = _mm256_permute_ps(v, SWAP_RB);
+		_mm_storeu_si128((__m128i *)h,
+				 _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+
+		h += 8;
+		f += 8;
+	}
+
+	float_to_rgbx16f_scalar(f, h, num_pixels - i, swap_rb);
+}
+
+static void rgbx16_to_float_avx2(const uint16_t *u, float *f,
+				 unsigned int num_pixels, bool swap_rb)
+{
+	const __m256 scale = _mm256_set1_ps(65535.0f);
+	unsigned int i = 0;
+
+	for (; i + 2 <= num_pixels; i += 2) {
+		__m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)u));
+		__m256 v = _mm256_div_ps(_mm256_cvtepi32_ps(w), scale);
+
+		if (swap_rb)
+			v = _mm256_permute_ps(v, SWAP_RB);
+		_mm256_storeu_ps(f, v);
+
+		u += 8;
+		f += 8;
+	}
+
+	rgbx16_to_float_scalar(u, f, num_pixels - i, swap_rb);
+}
+
+static void float_to_rgbx16_avx2(const float *f, uint16_t *u,
+				 unsigned int num_pixels, bool swap_rb)
+{
+	const __m256 scale = _mm256_set1_ps(65535.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	unsigned int i = 0;
+
+	for (; i + 2 <= num_pixels; i += 2) {
+		__m256 v = _mm256_loadu_ps(f);
+		__m256i w;
+
+		if (swap_rb)
+			v = _mm256_permute_ps(v, SWAP_RB);
+		/* maxps returns its second operand for NaN, clamping it to 0 */
+		v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+		/* Keep mul and add separate to match the scalar rounding */
+		w = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+		_mm_storeu_si128((__m128i *)u,
+				 _mm_packus_epi32(_mm256_castsi256_si128(w),
+						  _mm256_extracti128_si256(w, 1)));
+
+		u += 8;
+		f += 8;
+	}
+
+	float_to_rgbx16_scalar(f, u, num_pixels - i, swap_rb);
+}
+
+#undef SWAP_RB
+
+#pragma GCC pop_options
+
+static const struct igt_rgbx16_kernels rgbx16_kernels[] = {
+	{
+		.name = "avx2",
+		.half_to_float = rgbx16f_to_float_avx2,
+		.float_to_half = float_to_rgbx16f_avx2,
+		.uint16_to_float = rgbx16_to_float_avx2,
+		.float_to_uint16 = float_to_rgbx16_avx2,
+	},
+	{
+		.name = "scalar",
+		.half_to_float = rgbx16f_to_float_scalar,
+		.float_to_half = float_to_rgbx16f_scalar,
+		.uint16_to_float = rgbx16_to_float_scalar,
+		.float_to_uint16 = float_to_rgbx16_scalar,
+	},
+};
+
+static bool rgbx16_kernels_supported(const struct igt_rgbx16_kernels *k)
+{
+	if (k == &rgbx16_kernels[0])
+		return (igt_x86_features() & (AVX2 | F16C)) == (AVX2 | F16C);
+
+	return true;
 }
 
 /* The PLT is not initialized when ifunc resolvers run, so all external
@@ -224,19 +402,228 @@ static void (*resolve_half_to_float(void))(const uint16_t *h, float *f, unsigned
 void igt_half_to_float(const uint16_t *h, float *f, unsigned int num)
 	__attribute__((ifunc("resolve_half_to_float")));
 
+#define RGBX16_RESOLVE(name, member, src_t, dst_t)			\
+__attribute__((flatten))						\
+static void (*resolve_##name(void))(const src_t *src, dst_t *dst,	\
+				    unsigned int num_pixels,		\
+				    bool swap_rb)			\
+{									\
+	if ((igt_x86_features() & (AVX2 | F16C)) == (AVX2 | F16C))	\
+		return rgbx16_kernels[0].member;			\
+									\
+	return rgbx16_kernels[1].member;				\
+}									\
+									\
+void igt_##name(const src_t *src, dst_t *dst,				\
+		unsigned int num_pixels, bool swap_rb)			\
+	__attribute__((ifunc("resolve_" #name)));
+
+RGBX16_RESOLVE(rgbx16f_to_float, half_to_float, uint16_t, float)
+RGBX16_RESOLVE(float_to_rgbx16f, float_to_half, float, uint16_t)
+RGBX16_RESOLVE(rgbx16_to_float, uint16_to_float, uint16_t, float)
+RGBX16_RESOLVE(float_to_rgbx16, float_to_uint16, float, uint16_t)
+
 #else
 
 void igt_float_to_half(const float *f, uint16_t *h, unsigned int num)
 {
-	for (int i = 0; i < num; i++)
-		h[i] = _float_to_half(f[i]);
+	float_to_half(f, h, num);
 }
 
 void igt_half_to_float(const uint16_t *h, float *f, unsigned int num)
 {
-	for (int i = 0; i < num; i++)
-		f[i] = _half_to_float(h[i]);
+	half_to_float(h, f, num);
+}
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+/*
+ * vld4/vst4 deinterleave whole pixels into one register per channel, which
+ * makes the R<->B swap free: just store the channel registers in a
+ * different order.
+ */
+static void rgbx16f_to_float_neon(const uint16_t *h, float *f,
+				  unsigned int num_pixels, bool swap_rb)
+{
+	const int r = swap_rb ? 2 : 0, b = swap_rb ? 0 : 2;
+	unsigned int i = 0;
+
+	for (; i + 8 <= num_pixels; i += 8) {
+		uint16x8x4_t in = vld4q_u16(h);
+		float32x4x4_t lo, hi;
+
+		for (int c = 0; c < 4; c++) {
+			float16x8_t v = vreinterpretq_f16_u16(in.val[c]);
+			int d = c == r ? 0 : c == b ? 2 : c;
+
+			lo.val[d] = vcvt_f32_f16(vget_low_f16(v));
+			hi.val[d] = vcvt_high_f32_f16(v);
+		}
+		vst4q_f32(f, lo);
+		vst4q_f32(f + 16, hi);
+
+		h += 32;
+		f += 32;
+	}
+
+	rgbx16f_to_float_scalar(h, f, num_pixels - i, swap_rb);
+}
+
+static void float_to_rgbx16f_neon(const float *f, uint16_t *h,
+				  unsigned int num_pixels, bool swap_rb)
+{
+	const int r = swap_rb ? 2 : 0, b = swap_rb ? 0 : 2;
+	unsigned int i = 0;
+
+	for (; i + 4 <= num_pixels; i += 4) {
+		float32x4x4_t in = vld4q_f32(f);
+		uint16x4x4_t out;
+
+		for (int c = 0; c < 4; c++) {
+			int d = c == r ? 0 : c == b ? 2 : c;
+
+			out.val[d] = vreinterpret_u16_f16(vcvt_f16_f32(in.val[c]));
+		}
+		vst4_u16(h, out);
+
+		h += 16;
+		f += 16;
+	}
+
+	float_to_rgbx16f_scalar(f, h, num_pixels - i, swap_rb);
+}
+
+static void rgbx16_to_float_neon(const uint16_t *u, float *f,
+				 unsigned int num_pixels, bool swap_rb)
+{
+	const float32x4_t scale = vdupq_n_f32(65535.0f);
+	const int r = swap_rb ? 2 : 0, b = swap_rb ? 0 : 2;
+	unsigned int i = 0;
+
+	for (; i + 8 <= num_pixels; i += 8) {
+		uint16x8x4_t in = vld4q_u16(u);
+		float32x4x4_t lo, hi;
+
+		for (int c = 0; c < 4; c++) {
+			int d = c == r ? 0 : c == b ? 2 : c;
+
+			lo.val[d] = vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(in.val[c]))), scale);
+			hi.val[d] = vdivq_f32(vcvtq_f32_u32(vmovl_high_u16(in.val[c])), scale);
+		}
+		vst4q_f32(f, lo);
+		vst4q_f32(f + 16, hi);
+
+		u += 32;
+		f += 32;
+	}
+
+	rgbx16_to_float_scalar(u, f, num_pixels - i, swap_rb);
+}
+
+static void float_to_rgbx16_neon(const float *f, uint16_t *u,
+				 unsigned int num_pixels, bool swap_rb)
+{
+	const float32x4_t scale = vdupq_n_f32(65535.0f);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	const int r = swap_rb ? 2 : 0, b = swap_rb ? 0 : 2;
+	unsigned int i = 0;
+
+	for (; i + 4 <= num_pixels; i += 4) {
+		float32x4x4_t in = vld4q_f32(f);
+		uint16x4x4_t out;
+
+		for (int c = 0; c < 4; c++) {
+			int d = c == r ? 0 : c == b ? 2 : c;
+			/* Keep mul and add separate to match the scalar rounding */
+			float32x4_t v = vaddq_f32(vmulq_f32(in.val[c], scale), half);
+
+			/*
+			 * vcvtq saturates negative values and NaN to 0, the
+			 * narrowing has to saturate too to clamp above 1.0.
+			 */
+			out.val[d] = vqmovn_u32(vcvtq_u32_f32(v));
+		}
+		vst4_u16(u, out);
+
+		u += 16;
+		f += 16;
+	}
+
+	float_to_rgbx16_scalar(f, u, num_pixels - i, swap_rb);
 }
+#endif
 
+static const struct igt_rgbx16_kernels rgbx16_kernels[] = {
+#if defined(__aarch64__)
+	{
+		.name = "neon",
+		.half_to_float = rgbx16f_to_float_neon,
+		.float_to_half = float_to_rgbx16f_neon,
+		.uint16_to_float = rgbx16_to_float_neon,
+		.float_to_uint16 = float_to_rgbx16_neon,
+	},
 #endif
+	{
+		.name = "scalar",
+		.half_to_float = rgbx16f_to_float_scalar,
+		.float_to_half = float_to_rgbx16f_scalar,
+		.uint16_to_float = rgbx16_to_float_scalar,
+		.float_to_uint16 = float_to_rgbx16_scalar,
+	},
+};
 
+static bool rgbx16_kernels_supported(const struct igt_rgbx16_kernels *k)
+{
+	return true;
+}
+
+void igt_rgbx16f_to_float(const uint16_t *h, float *f,
+			  unsigned int num_pixels, bool swap_rb)
+{
+	rgbx16_kernels[0].half_to_float(h, f, num_pixels, swap_rb);
+}
+
+void igt_float_to_rgbx16f(const float *f, uint16_t *h,
+			  unsigned int num_pixels, bool swap_rb)
+{
+	rgbx16_kernels[0].float_to_half(f, h, num_pixels, swap_rb);
+}
+
+void igt_rgbx16_to_float(const uint16_t *u, float *f,
+			 unsigned int num_pixels, bool swap_rb)
+{
+	rgbx16_kernels[0].uint16_to_float(u, f, num_pixels, swap_rb);
+}
+
+void igt_float_to_rgbx16(const float *f, uint16_t *u,
+			 unsigned int num_pixels, bool swap_rb)
+{
+	rgbx16_kernels[0].float_to_uint16(f, u, num_pixels, swap_rb);
+}
+
+#endif
+
+/**
+ * igt_rgbx16_kernels_get:
+ * @idx: index of the kernel set
+ *
+ * Enumerates the RGBX16 conversion kernel sets usable on this CPU, best
+ * first. Mostly useful for benchmarking and cross-checking the SIMD paths
+ * against the scalar one, regular users should call the igt_rgbx16*()
+ * functions which pick the best kernels automatically.
+ *
+ * Returns: the kernel set at @idx, or NULL past the last one.
+ */
+const struct igt_rgbx16_kernels *igt_rgbx16_kernels_get(unsigned int idx)
+{
+	for (int i = 0; i < sizeof(rgbx16_kernels) / sizeof(rgbx16_kernels[0]); i++) {
+		if (!rgbx16_kernels_supported(&rgbx16_kernels[i]))
+			continue;
+
+		if (idx-- == 0)
+			return &rgbx16_kernels[i];
+	}
+
+	return NULL;
+}
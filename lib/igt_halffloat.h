@@ -20,8 +20,41 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#ifndef IGT_HALFFLOAT_H
+#define IGT_HALFFLOAT_H
+
+#include <stdbool.h>
 #include <stdint.h>
 
 void igt_float_to_half(const float *f, uint16_t *h, unsigned int num);
 void igt_half_to_float(const uint16_t *h, float *f, unsigned int num);
 
+/*
+ * Whole-row conversions between 4 channel 16 bpc pixels (half float or
+ * unorm) and RGBX float pixels. @swap_rb swaps the R and B channels on the
+ * way, which converts between BGRX and RGBX channel order.
+ */
+void igt_rgbx16f_to_float(const uint16_t *h, float *f,
+			  unsigned int num_pixels, bool swap_rb);
+void igt_float_to_rgbx16f(const float *f, uint16_t *h,
+			  unsigned int num_pixels, bool swap_rb);
+void igt_rgbx16_to_float(const uint16_t *u, float *f,
+			 unsigned int num_pixels, bool swap_rb);
+void igt_float_to_rgbx16(const float *f, uint16_t *u,
+			 unsigned int num_pixels, bool swap_rb);
+
+struct igt_rgbx16_kernels {
+	const char *name;
+	void (*half_to_float)(const uint16_t *h, float *f,
+			      unsigned int num_pixels, bool swap_rb);
+	void (*float_to_half)(const float *f, uint16_t *h,
+			      unsigned int num_pixels, bool swap_rb);
+	void (*uint16_to_float)(const uint16_t *u, float *f,
+				unsigned int num_pixels, bool swap_rb);
+	void (*float_to_uint16)(const float *f, uint16_t *u,
+				unsigned int num_pixels, bool swap_rb);
+};
+
+const struct igt_rgbx16_kernels *igt_rgbx16_kernels_get(unsigned int idx);
+
+#endif /* IGT_HALFFLOAT_H */
@@ -54,6 +54,7 @@
 #include "drmtest.h"
 #include "igt_core.h"
 #include "igt_kms.h"
+#include "igt_kms_props.h"
 #include "igt_aux.h"
 #include "igt_edid.h"
 #include "intel_chipset.h"
@@ -745,7 +746,7 @@ const char * const igt_rotation_names[] = {
 
 static unsigned int
 igt_plane_rotations(igt_display_t *display, igt_plane_t *plane,
-		    drmModePropertyPtr prop)
+		    const drmModePropertyRes *prop)
 {
 	unsigned int rotations = 0;
 
@@ -777,36 +778,29 @@ static void
 igt_fill_plane_props(igt_display_t *display, igt_plane_t *plane,
 		     int num_props, const char * const prop_names[])
 {
-	drmModeObjectPropertiesPtr props;
-	int i, j, fd;
-
-	fd = display->drm_fd;
+	struct igt_kms_props *props;
+	int i, j;
 
-	props = drmModeObjectGetProperties(fd, plane->drm_plane->plane_id, DRM_MODE_OBJECT_PLANE);
+	props = igt_kms_props_get(display->drm_fd,
+				  plane->drm_plane->plane_id,
+				  DRM_MODE_OBJECT_PLANE);
 	igt_assert(props);
 
-	for (i = 0; i < props->count_props; i++) {
-		drmModePropertyPtr prop =
-			drmModeGetProperty(fd, props->props[i]);
-
-		for (j = 0; j < num_props; j++) {
-			if (strcmp(prop->name, prop_names[j]) != 0)
-				continue;
-
-			plane->props[j] = props->props[i];
-			break;
-		}
-
-		if (strcmp(prop->name, "rotation") == 0)
-			plane->rotations = igt_plane_rotations(display, plane, prop);
-
-		drmModeFreeProperty(prop);
+	for (j = 0; j < num_props; j++) {
+		i = igt_kms_props_find(props, prop_names[j]);
+		if (i >= 0)
+			plane->props[j] = props->ids[i];
 	}
 
+	i = igt_kms_props_find(props, "rotation");
+	if (i >= 0)
+		plane->rotations = igt_plane_rotations(display, plane,
+						       props->info[i]);
+
 	if (!plane->rotations)
 		plane->rotations = IGT_ROTATION_0;
 
-	drmModeFreeObjectProperties(props);
+	igt_kms_props_put(props);
 }
 
 /*
@@ -817,60 +811,41 @@ static void
 igt_atomic_fill_connector_props(igt_display_t *display, igt_output_t *output,
 			int num_connector_props, const char * const conn_prop_names[])
 {
-	drmModeObjectPropertiesPtr props;
-	int i, j, fd;
-
-	fd = display->drm_fd;
+	struct igt_kms_props *props;
+	int i, j;
 
-	props = drmModeObjectGetProperties(fd, output->config.connector->connector_id, DRM_MODE_OBJECT_CONNECTOR);
+	props = igt_kms_props_get(display->drm_fd,
+				  output->config.connector->connector_id,
+				  DRM_MODE_OBJECT_CONNECTOR);
 	igt_assert(props);
 
-	for (i = 0; i < props->count_props; i++) {
-		drmModePropertyPtr prop =
-			drmModeGetProperty(fd, props->props[i]);
-
-		for (j = 0; j < num_connector_props; j++) {
-			if (strcmp(prop->name, conn_prop_names[j]) != 0)
-				continue;
-
-			output->props[j] = props->props[i];
-			break;
-		}
-
-		drmModeFreeProperty(prop);
+	for (j = 0; j < num_connector_props; j++) {
+		i = igt_kms_props_find(props, conn_prop_names[j]);
+		if (i >= 0)
+			output->props[j] = props->ids[i];
 	}
 
-	drmModeFreeObjectProperties(props);
+	igt_kms_props_put(props);
 }
 
 static void
 igt_fill_pipe_props(igt_display_t *display, igt_pipe_t *pipe,
 		    int num_crtc_props, const char * const crtc_prop_names[])
 {
-	drmModeObjectPropertiesPtr props;
-	int i, j, fd;
-
-	fd = display->drm_fd;
+	struct igt_kms_props *props;
+	int i, j;
 
-	props = drmModeObjectGetProperties(fd, pipe->crtc_id, DRM_MODE_OBJECT_CRTC);
+	props = igt_kms_props_get(display->drm_fd, pipe->crtc_id,
+				  DRM_MODE_OBJECT_CRTC);
 	igt_assert(props);
 
-	for (i = 0; i < props->count_props; i++) {
-		drmModePropertyPtr prop =
-			drmModeGetProperty(fd, props->props[i]);
-
-		for (j = 0; j < num_crtc_props; j++) {
-			if (strcmp(prop->name, crtc_prop_names[j]) != 0)
-				continue;
-
-			pipe->props[j] = props->props[i];
-			break;
-		}
-
-		drmModeFreeProperty(prop);
+	for (j = 0; j < num_crtc_props; j++) {
+		i = igt_kms_props_find(props, crtc_prop_names[j]);
+		if (i >= 0)
+			pipe->props[j] = props->ids[i];
 	}
 
-	drmModeFreeObjectProperties(props);
+	igt_kms_props_put(props);
 }
 
 static igt_plane_t *igt_get_assigned_primary(igt_output_t *output, igt_pipe_t *pipe)
@@ -2272,38 +2247,32 @@ kmstest_get_property(int drm_fd, uint32_t object_id, uint32_t object_type,
 		     uint64_t *value /* out */,
 		     drmModePropertyPtr *prop /* out */)
 {
-	drmModeObjectPropertiesPtr proplist;
-	drmModePropertyPtr _prop;
-	bool found = false;
+	struct igt_kms_props *props;
 	int i;
 
-	proplist = drmModeObjectGetProperties(drm_fd, object_id, object_type);
-	if (!proplist)
+	props = igt_kms_props_get(drm_fd, object_id, object_type);
+	if (!props)
 		return false;
 
-	for (i = 0; i < proplist->count_props; i++) {
-		_prop = drmModeGetProperty(drm_fd, proplist->props[i]);
-		if (!_prop)
-			continue;
+	i = igt_kms_props_find(props, name);
 
-		if (strcmp(_prop->name, name) == 0) {
-			found = true;
-			if (prop_id)
-				*prop_id = proplist->props[i];
-			if (value)
-				*value = proplist->prop_values[i];
-			if (prop)
-				*prop = _prop;
-			else
-				drmModeFreeProperty(_prop);
+	/* The caller frees it, so it cannot be the cached one */
+	if (i >= 0 && prop) {
+		*prop = drmModeGetProperty(drm_fd, props->ids[i]);
+		if (!*prop)
+			i = -1;
+	}
 
-			break;
-		}
-		drmModeFreeProperty(_prop);
+	if (i >= 0) {
+		if (prop_id)
+			*prop_id = props->ids[i];
+		if (value)
+			*value = props->values[i];
 	}
 
-	drmModeFreeObjectProperties(proplist);
-	return found;
+	igt_kms_props_put(props);
+
+	return i >= 0;
 }
 
 /**
@@ -3323,6 +3292,8 @@ void igt_display_fini(igt_display_t *display)
 	display->pipes = NULL;
 	free(display->planes);
 	display->planes = NULL;
+
+	igt_kms_props_invalidate(display->drm_fd);
 }
 
 static void igt_display_refresh(igt_display_t *display)
@@ -4093,7 +4064,7 @@ uint64_t igt_plane_get_prop(igt_plane_t *plane, enum igt_atomic_plane_properties
 
 static bool igt_mode_object_get_prop_enum_value(int drm_fd, uint32_t id, const char *str, uint64_t *val)
 {
-	drmModePropertyPtr prop = drmModeGetProperty(drm_fd, id);
+	const drmModePropertyRes *prop = igt_kms_prop_info(drm_fd, id);
 	int i;
 
 	igt_assert(id);
@@ -4102,7 +4073,6 @@ static bool igt_mode_object_get_prop_enum_value(int drm_fd, uint32_t id, const c
 	for (i = 0; i < prop->count_enums; i++)
 		if (!strcmp(str, prop->enums[i].name)) {
 			*val = prop->enums[i].value;
-			drmModeFreeProperty(prop);
 			return true;
 		}
 
@@ -5647,6 +5617,10 @@ bool event_detected(struct udev_monitor *mon, int timeout_secs,
 		udev_device_unref(dev);
 	}
 
+	/* Connectors and their properties may have come and gone */
+	if (event_received)
+		igt_kms_props_invalidate(-1);
+
 	return event_received;
 }
 
@@ -5720,6 +5694,9 @@ void igt_flush_uevents(struct udev_monitor *mon)
 
 	while ((dev = udev_monitor_receive_device(mon)))
 		udev_device_unref(dev);
+
+	/* Any hotplug flushed is never seen */
+	igt_kms_props_invalidate(-1);
 }
 
 /**
@@ -0,0 +1,3179 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_kms_fake
+ * @short_description: Recorded KMS device served from memory
+ * @title: Fake KMS
+ * @include: igt_kms_fake.h
+ *
+ * igt_kms_fake_record() writes the mode objects of a KMS device to a file,
+ * along with their properties and the blobs they refer to.
+ * igt_kms_fake_open() loads such a recording and returns an fd whose KMS
+ * ioctls are served from memory. Display setup, atomic commits and
+ * framebuffer creation in igt_kms and igt_fb can then be tested and
+ * benchmarked without a display, deterministically and on the cpu alone.
+ *
+ * Only programs linked with the lib_igt_kms_fake dependency reach the fake.
+ * It interposes drmIoctl() and mmap() and passes every other fd on to
+ * libdrm and libc.
+ *
+ * The fake keeps the state of the properties. It checks atomic commits much
+ * like the atomic helpers of the kernel do: property ranges and enums,
+ * planes on enabled crtcs with formats they support, and crtcs enabled with
+ * a mode and connectors. Modesets need DRM_MODE_ATOMIC_ALLOW_MODESET. Legacy
+ * modesets, plane updates and page flips go through the same checks. Dumb
+ * buffers are backed by memory. Vblank and flip events are read from the fd
+ * as usual.
+ *
+ * Every commit that is not a test takes #igt_kms_fake_opts.commit_ns. If
+ * #igt_kms_fake_opts.vblank is set, a commit then completes on the next
+ * vblank of the crtcs it touches, timed from the refresh rate of their mode.
+ * A blocking commit waits until it completes. A nonblocking commit returns
+ * at once: its flip event is stamped with the completion time, and
+ * nonblocking commits to its crtcs fail with EBUSY until then.
+ *
+ * The fake reports itself as the "igt_fake" driver, with the recorded driver
+ * as its description. igt_kms and igt_fb therefore take their generic paths
+ * rather than driver specific ones the recording cannot serve.
+ * Framebuffers are not recorded, so planes come up without one.
+ *
+ * The recording is text. The first line is "igt-kms-fake 1", then one record
+ * per line: a keyword followed by numbers, with any name last.
+ * |[<!-- language="plain" -->
+ * driver <major> <minor> <patchlevel> <name>
+ * cap <capability> <value>
+ * client-cap <capability>
+ * size <min width> <max width> <min height> <max height>
+ * prop <id> <flags> <name>
+ * prop-value <prop> <value>
+ * prop-enum <prop> <value> <name>
+ * blob <id> <data in hex>
+ * crtc <id> <gamma size>
+ * encoder <id> <type> <possible crtcs> <possible clones>
+ * connector <id> <type> <type id> <connection> <mm width> <mm height>
+ *	<subpixel>
+ * connector-encoder <connector> <encoder>
+ * mode <connector> <clock> <hdisplay> <hsync start> <hsync end> <htotal>
+ *	<hskew> <vdisplay> <vsync start> <vsync end> <vtotal> <vscan> <vrefresh>
+ *	<flags> <type> <name>
+ * plane <id> <possible crtcs> <gamma size>
+ * plane-formats <plane> <fourcc>...
+ * object-prop <object> <prop> <value>
+ * ]|
+ * Objects, properties and blobs are defined before they are referred to.
+ * Crtcs are indexed in the order they are defined.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "drm_fourcc.h"
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_kms_fake.h"
+#include "igt_kms_props.h"
+#include "igt_list.h"
+#include "igt_map.h"
+#include "ioctl_wrappers.h"
+
+#define FAKE_DRIVER "igt_fake"
+#define FAKE_HEADER "igt-kms-fake 1"
+#define FAKE_MAX_CAPS 32
+#define FAKE_EVENT_SPACE 4096 /* as the kernel allows per file */
+#define FAKE_DUMB_PITCH 64
+
+enum fake_known_prop {
+	PROP_FB_ID,
+	PROP_CRTC_ID,
+	PROP_SRC_X,
+	PROP_SRC_Y,
+	PROP_SRC_W,
+	PROP_SRC_H,
+	PROP_CRTC_X,
+	PROP_CRTC_Y,
+	PROP_CRTC_W,
+	PROP_CRTC_H,
+	PROP_TYPE,
+	PROP_ACTIVE,
+	PROP_MODE_ID,
+	PROP_IN_FENCE_FD,
+	PROP_OUT_FENCE_PTR,
+	PROP_WRITEBACK_FB_ID,
+	PROP_WRITEBACK_OUT_FENCE_PTR,
+	NUM_KNOWN_PROPS
+};
+
+static const char * const known_names[NUM_KNOWN_PROPS] = {
+	[PROP_FB_ID] = "FB_ID",
+	[PROP_CRTC_ID] = "CRTC_ID",
+	[PROP_SRC_X] = "SRC_X",
+	[PROP_SRC_Y] = "SRC_Y",
+	[PROP_SRC_W] = "SRC_W",
+	[PROP_SRC_H] = "SRC_H",
+	[PROP_CRTC_X] = "CRTC_X",
+	[PROP_CRTC_Y] = "CRTC_Y",
+	[PROP_CRTC_W] = "CRTC_W",
+	[PROP_CRTC_H] = "CRTC_H",
+	[PROP_TYPE] = "type",
+	[PROP_ACTIVE] = "ACTIVE",
+	[PROP_MODE_ID] = "MODE_ID",
+	[PROP_IN_FENCE_FD] = "IN_FENCE_FD",
+	[PROP_OUT_FENCE_PTR] = "OUT_FENCE_PTR",
+	[PROP_WRITEBACK_FB_ID] = "WRITEBACK_FB_ID",
+	[PROP_WRITEBACK_OUT_FENCE_PTR] = "WRITEBACK_OUT_FENCE_PTR",
+};
+
+struct fake_prop;
+
+/* Common to all the mode objects, which share the id space */
+struct fake_object {
+	uint32_t id;
+	uint32_t type;
+	bool released; /* not held by userspace, freed once unused */
+	unsigned int count_props;
+	struct fake_prop **props;
+	uint64_t *values;
+	int known[NUM_KNOWN_PROPS]; /* index in props, or -1 */
+};
+
+struct fake_prop {
+	struct fake_object base;
+	uint32_t flags;
+	char name[DRM_PROP_NAME_LEN];
+	unsigned int count_values;
+	uint64_t *values;
+	unsigned int count_enums;
+	struct drm_mode_property_enum *enums;
+};
+
+struct fake_blob {
+	struct fake_object base;
+	uint32_t length;
+	void *data;
+};
+
+struct fake_crtc {
+	struct fake_object base;
+	unsigned int index;
+	uint32_t gamma_size;
+	uint64_t epoch; /* time of vblank 0 */
+	uint64_t done; /* completion of the last commit */
+};
+
+struct fake_encoder {
+	struct fake_object base;
+	uint32_t encoder_type;
+	uint32_t possible_crtcs;
+	uint32_t possible_clones;
+};
+
+struct fake_connector {
+	struct fake_object base;
+	uint32_t connector_type;
+	uint32_t connector_type_id;
+	uint32_t connection;
+	uint32_t mm_width;
+	uint32_t mm_height;
+	uint32_t subpixel;
+	unsigned int count_encoders;
+	struct fake_encoder **encoders;
+	unsigned int count_modes;
+	struct drm_mode_modeinfo *modes;
+};
+
+struct fake_plane {
+	struct fake_object base;
+	uint32_t possible_crtcs;
+	uint32_t gamma_size;
+	unsigned int count_formats;
+	uint32_t *formats;
+};
+
+struct fake_fb {
+	struct fake_object base;
+	struct igt_list_head link;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixel_format;
+	uint32_t flags;
+	uint32_t handles[4];
+	uint32_t pitches[4];
+	uint32_t offsets[4];
+	uint64_t modifier[4];
+};
+
+struct fake_bo {
+	uint32_t handle;
+	uint64_t size;
+	uint64_t offset;
+};
+
+struct fake_kms {
+	struct igt_list_head link;
+	pthread_mutex_t mutex;
+	int fd; /* handed out, events are read from it */
+	int fd_ref; /* keeps the socket and its inode while the fake is open */
+	int event_fd; /* other end of the socket, events are written to it */
+	int memfd; /* backing store of the dumb buffers */
+	ino_t ino;
+	struct igt_kms_fake_opts opts;
+	struct igt_kms_fake_stats stats;
+
+	int version[3];
+	char driver[64];
+	unsigned int nr_caps;
+	struct {
+		uint64_t cap;
+		uint64_t value;
+	} caps[FAKE_MAX_CAPS];
+	uint64_t client_caps; /* supported, a bit per capability */
+	uint64_t enabled_caps;
+	uint32_t min_width, max_width;
+	uint32_t min_height, max_height;
+
+	struct igt_map *objects; /* id -> struct fake_object */
+	uint32_t next_id;
+	unsigned int nr_crtcs;
+	struct fake_crtc **crtcs;
+	unsigned int nr_encoders;
+	struct fake_encoder **encoders;
+	unsigned int nr_connectors;
+	struct fake_connector **connectors;
+	unsigned int nr_planes;
+	struct fake_plane **planes;
+	struct igt_list_head fbs;
+
+	struct igt_map *bos; /* handle -> struct fake_bo */
+	uint32_t next_handle;
+	uint64_t next_offset;
+};
+
+/* Property changes of a commit, undone if it fails or is only a test */
+struct fake_commit {
+	unsigned int nr_changes;
+	struct fake_change {
+		struct fake_object *obj;
+		unsigned int idx;
+		uint64_t old;
+	} *changes;
+	unsigned int nr_fences;
+	uint64_t *fences; /* where to write out fences */
+	uint32_t crtcs; /* crtcs affected, by index */
+	uint32_t modeset; /* crtcs needing a modeset, by index */
+};
+
+static IGT_LIST_HEAD(fakes);
+static pthread_mutex_t fakes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int nr_fakes;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * (uint64_t)NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+	struct timespec ts = {
+		.tv_sec = t / NSEC_PER_SEC,
+		.tv_nsec = t % NSEC_PER_SEC,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+	       EINTR)
+		;
+}
+
+/* Grows the array by a zeroed element and returns it */
+static void *append(void *array, unsigned int *count, size_t size)
+{
+	void **ptr = array;
+	char *grown;
+
+	grown = realloc(*ptr, (*count + 1) * size);
+	if (!grown)
+		return NULL;
+
+	*ptr = grown;
+	memset(grown + *count * size, 0, size);
+
+	return grown + (*count)++ * size;
+}
+
+static void *alloc_object(size_t size, uint32_t id, uint32_t type)
+{
+	struct fake_object *obj;
+	int i;
+
+	obj = calloc(1, size);
+	if (!obj)
+		return NULL;
+
+	obj->id = id;
+	obj->type = type;
+	for (i = 0; i < NUM_KNOWN_PROPS; i++)
+		obj->known[i] = -1;
+
+	return obj;
+}
+
+static void free_object(struct fake_object *obj)
+{
+	switch (obj->type) {
+	case DRM_MODE_OBJECT_PROPERTY:
+		free(((struct fake_prop *)obj)->values);
+		free(((struct fake_prop *)obj)->enums);
+		break;
+	case DRM_MODE_OBJECT_BLOB:
+		free(((struct fake_blob *)obj)->data);
+		break;
+	case DRM_MODE_OBJECT_CONNECTOR:
+		free(((struct fake_connector *)obj)->encoders);
+		free(((struct fake_connector *)obj)->modes);
+		break;
+	case DRM_MODE_OBJECT_PLANE:
+		free(((struct fake_plane *)obj)->formats);
+		break;
+	case DRM_MODE_OBJECT_FB:
+		igt_list_del(&((struct fake_fb *)obj)->link);
+		break;
+	}
+
+	free(obj->props);
+	free(obj->values);
+	free(obj);
+}
+
+static void free_object_entry(struct igt_map_entry *entry)
+{
+	free_object(entry->data);
+}
+
+static void free_bo_entry(struct igt_map_entry *entry)
+{
+	free(entry->data);
+}
+
+static int add_object(struct fake_kms *kms, struct fake_object *obj)
+{
+	if (!obj->id || igt_map_search(kms->objects, &obj->id)) {
+		free_object(obj);
+		return -EEXIST;
+	}
+
+	igt_map_insert(kms->objects, &obj->id, obj);
+	if (obj->id >= kms->next_id)
+		kms->next_id = obj->id + 1;
+
+	return 0;
+}
+
+static void destroy_object(struct fake_kms *kms, struct fake_object *obj)
+{
+	igt_map_remove(kms->objects, &obj->id, NULL);
+	free_object(obj);
+}
+
+static struct fake_object *
+find_object(struct fake_kms *kms, uint32_t id, uint32_t type)
+{
+	struct fake_object *obj;
+
+	obj = igt_map_search(kms->objects, &id);
+	if (!obj || (type != DRM_MODE_OBJECT_ANY && obj->type != type))
+		return NULL;
+
+	return obj;
+}
+
+static struct fake_crtc *find_crtc(struct fake_kms *kms, uint32_t id)
+{
+	return (struct fake_crtc *)find_object(kms, id, DRM_MODE_OBJECT_CRTC);
+}
+
+static struct fake_blob *find_blob(struct fake_kms *kms, uint32_t id)
+{
+	return (struct fake_blob *)find_object(kms, id, DRM_MODE_OBJECT_BLOB);
+}
+
+static struct fake_fb *find_fb(struct fake_kms *kms, uint32_t id)
+{
+	return (struct fake_fb *)find_object(kms, id, DRM_MODE_OBJECT_FB);
+}
+
+static uint64_t value(const struct fake_object *obj, enum fake_known_prop k)
+{
+	return obj->known[k] < 0 ? 0 : obj->values[obj->known[k]];
+}
+
+static int find_prop(const struct fake_object *obj, uint32_t prop_id)
+{
+	unsigned int i;
+
+	for (i = 0; i < obj->count_props; i++)
+		if (obj->props[i]->base.id == prop_id)
+			return i;
+
+	return -1;
+}
+
+static bool cap_enabled(const struct fake_kms *kms, uint64_t cap)
+{
+	return kms->enabled_caps & 1ull << cap;
+}
+
+static bool prop_visible(const struct fake_kms *kms,
+			 const struct fake_prop *prop)
+{
+	return !(prop->flags & DRM_MODE_PROP_ATOMIC) ||
+	       cap_enabled(kms, DRM_CLIENT_CAP_ATOMIC);
+}
+
+static bool connector_visible(const struct fake_kms *kms,
+			      const struct fake_connector *connector)
+{
+	return connector->connector_type != DRM_MODE_CONNECTOR_WRITEBACK ||
+	       cap_enabled(kms, DRM_CLIENT_CAP_WRITEBACK_CONNECTORS);
+}
+
+static bool encoder_visible(const struct fake_kms *kms,
+			    const struct fake_encoder *encoder)
+{
+	return encoder->encoder_type != DRM_MODE_ENCODER_VIRTUAL ||
+	       cap_enabled(kms, DRM_CLIENT_CAP_WRITEBACK_CONNECTORS);
+}
+
+static bool plane_visible(const struct fake_kms *kms,
+			  const struct fake_plane *plane)
+{
+	return cap_enabled(kms, DRM_CLIENT_CAP_UNIVERSAL_PLANES) ||
+	       value(&plane->base, PROP_TYPE) == DRM_PLANE_TYPE_OVERLAY;
+}
+
+static uint32_t crtc_bit(struct fake_kms *kms, uint64_t id)
+{
+	struct fake_crtc *crtc = find_crtc(kms, id);
+
+	return crtc ? 1u << crtc->index : 0;
+}
+
+static const struct drm_mode_modeinfo *
+crtc_mode(struct fake_kms *kms, const struct fake_crtc *crtc)
+{
+	struct fake_blob *blob = find_blob(kms, value(&crtc->base,
+						      PROP_MODE_ID));
+
+	if (!blob || blob->length != sizeof(struct drm_mode_modeinfo))
+		return NULL;
+
+	return blob->data;
+}
+
+/* Returns the duration of a frame of an active crtc, 0 if it is off */
+static uint64_t crtc_period(struct fake_kms *kms, const struct fake_crtc *crtc)
+{
+	const struct drm_mode_modeinfo *mode = crtc_mode(kms, crtc);
+
+	if (!value(&crtc->base, PROP_ACTIVE) || !mode || !mode->clock)
+		return 0;
+
+	return (uint64_t)mode->htotal * mode->vtotal * 1000000 / mode->clock;
+}
+
+static uint64_t crtc_vblank(const struct fake_crtc *crtc, uint64_t period,
+			    uint64_t t)
+{
+	return t > crtc->epoch ? (t - crtc->epoch) / period : 0;
+}
+
+static uint32_t connector_crtcs(const struct fake_connector *connector)
+{
+	uint32_t crtcs = 0;
+	unsigned int i;
+
+	for (i = 0; i < connector->count_encoders; i++)
+		crtcs |= connector->encoders[i]->possible_crtcs;
+
+	return crtcs;
+}
+
+/* The encoder driving the connector, as the atomic helpers would pick it */
+static struct fake_encoder *
+connector_encoder(struct fake_kms *kms, const struct fake_connector *connector)
+{
+	uint32_t bit = crtc_bit(kms, value(&connector->base, PROP_CRTC_ID));
+	unsigned int i;
+
+	if (!bit)
+		return NULL;
+
+	for (i = 0; i < connector->count_encoders; i++)
+		if (connector->encoders[i]->possible_crtcs & bit)
+			return connector->encoders[i];
+
+	return NULL;
+}
+
+static struct fake_plane *primary_plane(struct fake_kms *kms,
+					const struct fake_crtc *crtc)
+{
+	struct fake_plane *first = NULL;
+	unsigned int i;
+
+	for (i = 0; i < kms->nr_planes; i++) {
+		struct fake_plane *plane = kms->planes[i];
+
+		if (!(plane->possible_crtcs & 1u << crtc->index) ||
+		    value(&plane->base, PROP_TYPE) != DRM_PLANE_TYPE_PRIMARY)
+			continue;
+
+		if (value(&plane->base, PROP_CRTC_ID) == crtc->base.id)
+			return plane;
+		if (!first)
+			first = plane;
+	}
+
+	return first;
+}
+
+static bool is_referenced(struct fake_kms *kms, uint32_t id)
+{
+	struct fake_object **objects[] = {
+		(struct fake_object **)kms->crtcs,
+		(struct fake_object **)kms->connectors,
+		(struct fake_object **)kms->planes,
+	};
+	unsigned int counts[] = {
+		kms->nr_crtcs, kms->nr_connectors, kms->nr_planes,
+	};
+	unsigned int i, j, k;
+
+	for (i = 0; i < ARRAY_SIZE(objects); i++) {
+		for (j = 0; j < counts[i]; j++) {
+			const struct fake_object *obj = objects[i][j];
+
+			for (k = 0; k < obj->count_props; k++)
+				if (obj->values[k] == id &&
+				    obj->props[k]->flags &
+				    (DRM_MODE_PROP_BLOB | DRM_MODE_PROP_OBJECT))
+					return true;
+		}
+	}
+
+	return false;
+}
+
+/* Frees a blob or fb released by userspace once nothing refers to it */
+static void put_object(struct fake_kms *kms, uint64_t id)
+{
+	struct fake_object *obj = find_object(kms, id, DRM_MODE_OBJECT_ANY);
+
+	if (obj && obj->released && !is_referenced(kms, id))
+		destroy_object(kms, obj);
+}
+
+static struct fake_blob *create_blob(struct fake_kms *kms, const void *data,
+				     uint32_t length)
+{
+	struct fake_blob *blob;
+
+	blob = alloc_object(sizeof(*blob), kms->next_id, DRM_MODE_OBJECT_BLOB);
+	if (!blob)
+		return NULL;
+
+	blob->data = malloc(length);
+	if (!blob->data) {
+		free(blob);
+		return NULL;
+	}
+	memcpy(blob->data, data, length);
+	blob->length = length;
+
+	if (add_object(kms, &blob->base))
+		return NULL;
+
+	return blob;
+}
+
+static bool valid_value(struct fake_kms *kms, const struct fake_prop *prop,
+			uint64_t value)
+{
+	uint64_t mask = 0;
+	unsigned int i;
+
+	if (prop->flags & (DRM_MODE_PROP_RANGE | DRM_MODE_PROP_SIGNED_RANGE) &&
+	    prop->count_values < 2)
+		return true;
+
+	if (prop->flags & DRM_MODE_PROP_RANGE)
+		return value >= prop->values[0] && value <= prop->values[1];
+
+	if ((prop->flags & DRM_MODE_PROP_EXTENDED_TYPE) ==
+	    DRM_MODE_PROP_SIGNED_RANGE)
+		return (int64_t)value >= (int64_t)prop->values[0] &&
+		       (int64_t)value <= (int64_t)prop->values[1];
+
+	if (prop->flags & DRM_MODE_PROP_ENUM) {
+		for (i = 0; i < prop->count_enums; i++)
+			if (prop->enums[i].value == value)
+				return true;
+		return false;
+	}
+
+	if (prop->flags & DRM_MODE_PROP_BITMASK) {
+		for (i = 0; i < prop->count_enums; i++)
+			mask |= 1ull << prop->enums[i].value;
+		return !(value & ~mask);
+	}
+
+	if (prop->flags & DRM_MODE_PROP_BLOB)
+		return !value || find_blob(kms, value);
+
+	if ((prop->flags & DRM_MODE_PROP_EXTENDED_TYPE) ==
+	    DRM_MODE_PROP_OBJECT)
+		return !value || (prop->count_values &&
+				  find_object(kms, value, prop->values[0]));
+
+	return true;
+}
+
+/* Sets a property, keeping its old value to roll back to */
+static int stage(struct fake_kms *kms, struct fake_commit *c,
+		 struct fake_object *obj, unsigned int idx, uint64_t val)
+{
+	struct fake_change *change;
+	uint64_t old = obj->values[idx];
+	uint32_t bits;
+
+	change = append(&c->changes, &c->nr_changes, sizeof(*change));
+	if (!change)
+		return -ENOMEM;
+
+	change->obj = obj;
+	change->idx = idx;
+	change->old = old;
+	obj->values[idx] = val;
+
+	switch (obj->type) {
+	case DRM_MODE_OBJECT_CRTC:
+		bits = 1u << ((struct fake_crtc *)obj)->index;
+		c->crtcs |= bits;
+		if (val != old && ((int)idx == obj->known[PROP_ACTIVE] ||
+				   (int)idx == obj->known[PROP_MODE_ID]))
+			c->modeset |= bits;
+		break;
+	case DRM_MODE_OBJECT_PLANE:
+	case DRM_MODE_OBJECT_CONNECTOR:
+		bits = crtc_bit(kms, value(obj, PROP_CRTC_ID));
+		if ((int)idx == obj->known[PROP_CRTC_ID])
+			bits |= crtc_bit(kms, old);
+		c->crtcs |= bits;
+		if (obj->type == DRM_MODE_OBJECT_CONNECTOR && val != old &&
+		    (int)idx == obj->known[PROP_CRTC_ID])
+			c->modeset |= bits;
+		break;
+	}
+
+	return 0;
+}
+
+static int stage_known(struct fake_kms *kms, struct fake_commit *c,
+		       struct fake_object *obj, enum fake_known_prop k,
+		       uint64_t val)
+{
+	if (obj->known[k] < 0)
+		return 0;
+
+	return stage(kms, c, obj, obj->known[k], val);
+}
+
+/* Stages a property set by userspace, as the atomic ioctl checks it */
+static int stage_property(struct fake_kms *kms, struct fake_commit *c,
+			  struct fake_object *obj, uint32_t prop_id,
+			  uint64_t val)
+{
+	const struct fake_prop *prop;
+	int idx;
+
+	idx = find_prop(obj, prop_id);
+	if (idx < 0 || !prop_visible(kms, obj->props[idx]))
+		return -ENOENT;
+
+	prop = obj->props[idx];
+	if (prop->flags & DRM_MODE_PROP_IMMUTABLE ||
+	    !valid_value(kms, prop, val))
+		return -EINVAL;
+
+	/* Not state, the kernel does not report them back either */
+	if (idx == obj->known[PROP_OUT_FENCE_PTR] ||
+	    idx == obj->known[PROP_WRITEBACK_OUT_FENCE_PTR]) {
+		uint64_t *fence;
+
+		if (!val)
+			return 0;
+
+		fence = append(&c->fences, &c->nr_fences, sizeof(*fence));
+		if (!fence)
+			return -ENOMEM;
+		*fence = val;
+
+		return 0;
+	}
+
+	/* Fences are always signaled and writeback jobs done at once */
+	if (idx == obj->known[PROP_IN_FENCE_FD] ||
+	    idx == obj->known[PROP_WRITEBACK_FB_ID])
+		return 0;
+
+	return stage(kms, c, obj, idx, val);
+}
+
+static void rollback(struct fake_commit *c)
+{
+	while (c->nr_changes--) {
+		struct fake_change *change = &c->changes[c->nr_changes];
+
+		change->obj->values[change->idx] = change->old;
+	}
+}
+
+static void free_commit(struct fake_commit *c)
+{
+	free(c->changes);
+	free(c->fences);
+}
+
+static int disable_crtc(struct fake_kms *kms, struct fake_commit *c,
+			struct fake_crtc *crtc)
+{
+	unsigned int i;
+	int ret;
+
+	ret = stage_known(kms, c, &crtc->base, PROP_ACTIVE, 0);
+	if (!ret)
+		ret = stage_known(kms, c, &crtc->base, PROP_MODE_ID, 0);
+
+	for (i = 0; !ret && i < kms->nr_planes; i++) {
+		struct fake_object *plane = &kms->planes[i]->base;
+
+		if (value(plane, PROP_CRTC_ID) != crtc->base.id)
+			continue;
+
+		ret = stage_known(kms, c, plane, PROP_FB_ID, 0);
+		if (!ret)
+			ret = stage_known(kms, c, plane, PROP_CRTC_ID, 0);
+	}
+
+	for (i = 0; !ret && i < kms->nr_connectors; i++) {
+		struct fake_object *connector = &kms->connectors[i]->base;
+
+		if (value(connector, PROP_CRTC_ID) == crtc->base.id)
+			ret = stage_known(kms, c, connector, PROP_CRTC_ID, 0);
+	}
+
+	return ret;
+}
+
+static bool has_format(const struct fake_plane *plane, uint32_t format)
+{
+	unsigned int i;
+
+	for (i = 0; i < plane->count_formats; i++)
+		if (plane->formats[i] == format)
+			return true;
+
+	return false;
+}
+
+static int check_plane(struct fake_kms *kms, const struct fake_plane *plane)
+{
+	const struct fake_object *obj = &plane->base;
+	uint64_t fb_id = value(obj, PROP_FB_ID);
+	uint64_t crtc_id = value(obj, PROP_CRTC_ID);
+	struct fake_crtc *crtc;
+	struct fake_fb *fb;
+
+	if (!fb_id != !crtc_id) {
+		igt_debug("fake: plane %u has fb %"PRIu64" on crtc %"PRIu64"\n",
+			  obj->id, fb_id, crtc_id);
+		return -EINVAL;
+	}
+
+	if (!fb_id)
+		return 0;
+
+	crtc = find_crtc(kms, crtc_id);
+	fb = find_fb(kms, fb_id);
+	if (!crtc || !fb)
+		return -EINVAL;
+
+	if (!(plane->possible_crtcs & 1u << crtc->index)) {
+		igt_debug("fake: plane %u cannot be on crtc %u\n",
+			  obj->id, crtc->base.id);
+		return -EINVAL;
+	}
+
+	if (!value(&crtc->base, PROP_MODE_ID)) {
+		igt_debug("fake: plane %u on disabled crtc %u\n",
+			  obj->id, crtc->base.id);
+		return -EINVAL;
+	}
+
+	if (!has_format(plane, fb->pixel_format)) {
+		igt_debug("fake: plane %u does not support format %#x\n",
+			  obj->id, fb->pixel_format);
+		return -EINVAL;
+	}
+
+	if (value(obj, PROP_SRC_X) + value(obj, PROP_SRC_W) >
+	    (uint64_t)fb->width << 16 ||
+	    value(obj, PROP_SRC_Y) + value(obj, PROP_SRC_H) >
+	    (uint64_t)fb->height << 16) {
+		igt_debug("fake: plane %u source outside of fb %u\n",
+			  obj->id, fb->base.id);
+		return -ENOSPC;
+	}
+
+	return 0;
+}
+
+static int check_crtc(struct fake_kms *kms, const struct fake_crtc *crtc)
+{
+	bool enable = value(&crtc->base, PROP_MODE_ID);
+	unsigned int i, nr_connectors = 0;
+
+	if (value(&crtc->base, PROP_ACTIVE) && !enable) {
+		igt_debug("fake: crtc %u active without a mode\n",
+			  crtc->base.id);
+		return -EINVAL;
+	}
+
+	if (enable && !crtc_mode(kms, crtc)) {
+		igt_debug("fake: crtc %u has an invalid mode\n", crtc->base.id);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < kms->nr_connectors; i++)
+		nr_connectors += value(&kms->connectors[i]->base,
+				       PROP_CRTC_ID) == crtc->base.id;
+
+	if (enable != !!nr_connectors) {
+		igt_debug("fake: crtc %u enabled %d with %u connectors\n",
+			  crtc->base.id, enable, nr_connectors);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int check_connector(struct fake_kms *kms,
+			   const struct fake_connector *connector)
+{
+	uint32_t bit = crtc_bit(kms, value(&connector->base, PROP_CRTC_ID));
+
+	if (bit && !(connector_crtcs(connector) & bit)) {
+		igt_debug("fake: connector %u cannot be on crtc %"PRIu64"\n",
+			  connector->base.id,
+			  value(&connector->base, PROP_CRTC_ID));
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Checks the state of the whole device, as staged */
+static int check_state(struct fake_kms *kms)
+{
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; !ret && i < kms->nr_planes; i++)
+		ret = check_plane(kms, kms->planes[i]);
+	for (i = 0; !ret && i < kms->nr_crtcs; i++)
+		ret = check_crtc(kms, kms->crtcs[i]);
+	for (i = 0; !ret && i < kms->nr_connectors; i++)
+		ret = check_connector(kms, kms->connectors[i]);
+
+	return ret;
+}
+
+static bool event_space(struct fake_kms *kms, unsigned int nr_events)
+{
+	int pending = 0;
+
+	if (ioctl(kms->fd_ref, FIONREAD, &pending))
+		return false;
+
+	return pending + nr_events * sizeof(struct drm_event_vblank) <=
+	       FAKE_EVENT_SPACE;
+}
+
+static int queue_event(struct fake_kms *kms, uint32_t type,
+		       uint64_t user_data, uint64_t t, uint32_t sequence,
+		       uint32_t crtc_id)
+{
+	struct drm_event_vblank ev = {
+		.base.type = type,
+		.base.length = sizeof(ev),
+		.user_data = user_data,
+		.tv_sec = t / NSEC_PER_SEC,
+		.tv_usec = t % NSEC_PER_SEC / 1000,
+		.sequence = sequence,
+		.crtc_id = crtc_id,
+	};
+
+	if (send(kms->event_fd, &ev, sizeof(ev),
+		 MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(ev))
+		return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * Checks and applies the staged changes, or rolls them back. Flags are
+ * those of the atomic ioctl, @wait is set to when a blocking commit
+ * completes.
+ */
+static int finish_commit(struct fake_kms *kms, struct fake_commit *c,
+			 uint32_t flags, uint64_t user_data, uint64_t *wait)
+{
+	uint64_t now = now_ns(), done = now;
+	unsigned int i, nr_events = 0;
+	int ret;
+
+	if (c->modeset && !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET)) {
+		igt_debug("fake: modeset not allowed\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = check_state(kms);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < kms->nr_crtcs; i++) {
+		struct fake_crtc *crtc = kms->crtcs[i];
+
+		if (!(c->crtcs & 1u << i))
+			continue;
+
+		if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
+			if (!value(&crtc->base, PROP_ACTIVE)) {
+				ret = -EINVAL;
+				goto out;
+			}
+			nr_events++;
+		}
+
+		if (flags & DRM_MODE_ATOMIC_NONBLOCK && crtc->done > now) {
+			ret = -EBUSY;
+			goto out;
+		}
+
+		/* A blocking commit waits for the previous one */
+		if (crtc->done > done)
+			done = crtc->done;
+	}
+
+	if (nr_events && !event_space(kms, nr_events)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (flags & DRM_MODE_ATOMIC_TEST_ONLY) {
+		kms->stats.test_commits++;
+		goto out;
+	}
+
+	done += kms->opts.commit_ns;
+
+	for (i = 0; kms->opts.vblank && i < kms->nr_crtcs; i++) {
+		struct fake_crtc *crtc = kms->crtcs[i];
+		uint64_t period = crtc_period(kms, crtc), next;
+
+		if (!(c->crtcs & ~c->modeset & 1u << i) || !period)
+			continue;
+
+		next = crtc->epoch +
+		       (crtc_vblank(crtc, period, done) + 1) * period;
+		if (next > done)
+			done = next;
+	}
+
+	for (i = 0; i < kms->nr_crtcs; i++) {
+		struct fake_crtc *crtc = kms->crtcs[i];
+		uint64_t period = crtc_period(kms, crtc);
+
+		if (!(c->crtcs & 1u << i))
+			continue;
+
+		/* The timings start over with the new mode */
+		if (c->modeset & 1u << i)
+			crtc->epoch = done;
+		crtc->done = done;
+
+		if (flags & DRM_MODE_PAGE_FLIP_EVENT)
+			queue_event(kms, DRM_EVENT_FLIP_COMPLETE, user_data,
+				    done, period ?
+				    crtc_vblank(crtc, period, done) : 0,
+				    crtc->base.id);
+	}
+
+	for (i = 0; i < c->nr_fences; i++) {
+		int32_t *fence = from_user_pointer(c->fences[i]);
+
+		/* Signaled at once, as far as poll() can tell */
+		*fence = eventfd(1, EFD_CLOEXEC);
+	}
+
+	for (i = 0; i < c->nr_changes; i++) {
+		const struct fake_change *change = &c->changes[i];
+
+		if (change->obj->values[change->idx] != change->old)
+			put_object(kms, change->old);
+	}
+	c->nr_changes = 0;
+
+	kms->stats.commits++;
+	if (!(flags & DRM_MODE_ATOMIC_NONBLOCK))
+		*wait = done;
+
+out:
+	rollback(c);
+	free_commit(c);
+
+	return ret;
+}
+
+static int fake_atomic(struct fake_kms *kms, struct drm_mode_atomic *arg,
+		       uint64_t *wait)
+{
+	uint32_t *objs = from_user_pointer(arg->objs_ptr);
+	uint32_t *count_props = from_user_pointer(arg->count_props_ptr);
+	uint32_t *props = from_user_pointer(arg->props_ptr);
+	uint64_t *values = from_user_pointer(arg->prop_values_ptr);
+	struct fake_commit c = { };
+	unsigned int i, j, k = 0;
+	int ret = 0;
+
+	if (!cap_enabled(kms, DRM_CLIENT_CAP_ATOMIC))
+		return -EINVAL;
+
+	if (arg->flags & ~DRM_MODE_ATOMIC_FLAGS || arg->reserved ||
+	    arg->flags & DRM_MODE_PAGE_FLIP_ASYNC)
+		return -EINVAL;
+
+	if (arg->flags & DRM_MODE_ATOMIC_TEST_ONLY &&
+	    arg->flags & DRM_MODE_PAGE_FLIP_EVENT)
+		return -EINVAL;
+
+	for (i = 0; !ret && i < arg->count_objs; i++) {
+		struct fake_object *obj;
+
+		obj = find_object(kms, objs[i], DRM_MODE_OBJECT_ANY);
+		if (!obj || !obj->count_props) {
+			ret = -ENOENT;
+			break;
+		}
+
+		for (j = 0; !ret && j < count_props[i]; j++, k++)
+			ret = stage_property(kms, &c, obj, props[k], values[k]);
+	}
+
+	if (ret) {
+		rollback(&c);
+		free_commit(&c);
+		return ret;
+	}
+
+	return finish_commit(kms, &c, arg->flags, arg->user_data, wait);
+}
+
+static int set_property(struct fake_kms *kms, struct fake_object *obj,
+			uint32_t prop_id, uint64_t val, uint64_t *wait)
+{
+	struct fake_commit c = { };
+	int ret;
+
+	ret = stage_property(kms, &c, obj, prop_id, val);
+	if (ret) {
+		rollback(&c);
+		free_commit(&c);
+		return ret == -ENOENT ? -EINVAL : ret;
+	}
+
+	return finish_commit(kms, &c, DRM_MODE_ATOMIC_ALLOW_MODESET, 0, wait);
+}
+
+static int fake_obj_setproperty(struct fake_kms *kms,
+				struct drm_mode_obj_set_property *arg,
+				uint64_t *wait)
+{
+	struct fake_object *obj;
+
+	obj = find_object(kms, arg->obj_id, arg->obj_type);
+	if (!obj)
+		return -ENOENT;
+
+	return set_property(kms, obj, arg->prop_id, arg->value, wait);
+}
+
+static int
+fake_connector_setproperty(struct fake_kms *kms,
+			   struct drm_mode_connector_set_property *arg,
+			   uint64_t *wait)
+{
+	struct fake_object *obj;
+
+	obj = find_object(kms, arg->connector_id, DRM_MODE_OBJECT_CONNECTOR);
+	if (!obj)
+		return -ENOENT;
+
+	return set_property(kms, obj, arg->prop_id, arg->value, wait);
+}
+
+static bool in_list(const uint32_t *ids, unsigned int count, uint32_t id)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		if (ids[i] == id)
+			return true;
+
+	return false;
+}
+
+static int stage_plane(struct fake_kms *kms, struct fake_commit *c,
+		       struct fake_plane *plane, uint32_t crtc_id,
+		       uint32_t fb_id, int32_t crtc_x, int32_t crtc_y,
+		       uint32_t crtc_w, uint32_t crtc_h, uint32_t src_x,
+		       uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	const struct {
+		enum fake_known_prop k;
+		uint64_t value;
+	} set[] = {
+		{ PROP_FB_ID, fb_id },
+		{ PROP_CRTC_ID, crtc_id },
+		{ PROP_CRTC_X, (uint64_t)(int64_t)crtc_x },
+		{ PROP_CRTC_Y, (uint64_t)(int64_t)crtc_y },
+		{ PROP_CRTC_W, crtc_w },
+		{ PROP_CRTC_H, crtc_h },
+		{ PROP_SRC_X, src_x },
+		{ PROP_SRC_Y, src_y },
+		{ PROP_SRC_W, src_w },
+		{ PROP_SRC_H, src_h },
+	};
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; !ret && i < ARRAY_SIZE(set); i++)
+		ret = stage_known(kms, c, &plane->base, set[i].k,
+				  set[i].value);
+
+	return ret;
+}
+
+static int fake_setcrtc(struct fake_kms *kms, struct drm_mode_crtc *arg,
+			uint64_t *wait)
+{
+	const uint32_t *ids = from_user_pointer(arg->set_connectors_ptr);
+	struct fake_blob *mode = NULL;
+	struct fake_plane *primary;
+	struct fake_commit c = { };
+	struct fake_crtc *crtc;
+	uint32_t fb_id = 0;
+	unsigned int i;
+	int ret = 0;
+
+	crtc = find_crtc(kms, arg->crtc_id);
+	if (!crtc)
+		return -ENOENT;
+
+	primary = primary_plane(kms, crtc);
+
+	if (!arg->mode_valid) {
+		if (arg->count_connectors || arg->fb_id)
+			return -EINVAL;
+
+		ret = disable_crtc(kms, &c, crtc);
+		goto commit;
+	}
+
+	if (!arg->count_connectors || !primary)
+		return -EINVAL;
+
+	for (i = 0; i < arg->count_connectors; i++)
+		if (!find_object(kms, ids[i], DRM_MODE_OBJECT_CONNECTOR))
+			return -ENOENT;
+
+	fb_id = arg->fb_id;
+	if (fb_id == (uint32_t)-1)
+		fb_id = value(&primary->base, PROP_FB_ID);
+	if (!find_fb(kms, fb_id))
+		return fb_id ? -ENOENT : -EINVAL;
+
+	/* Held by the crtc alone, as the kernel creates it */
+	mode = create_blob(kms, &arg->mode, sizeof(arg->mode));
+	if (!mode)
+		return -ENOMEM;
+	mode->base.released = true;
+
+	ret = stage_known(kms, &c, &crtc->base, PROP_MODE_ID, mode->base.id);
+	if (!ret)
+		ret = stage_known(kms, &c, &crtc->base, PROP_ACTIVE, 1);
+	if (!ret)
+		ret = stage_plane(kms, &c, primary, crtc->base.id, fb_id, 0, 0,
+				  arg->mode.hdisplay, arg->mode.vdisplay,
+				  arg->x << 16, arg->y << 16,
+				  arg->mode.hdisplay << 16,
+				  arg->mode.vdisplay << 16);
+
+	for (i = 0; !ret && i < kms->nr_connectors; i++) {
+		struct fake_object *connector = &kms->connectors[i]->base;
+
+		if (in_list(ids, arg->count_connectors, connector->id))
+			ret = stage_known(kms, &c, connector, PROP_CRTC_ID,
+					  crtc->base.id);
+		else if (value(connector, PROP_CRTC_ID) == crtc->base.id)
+			ret = stage_known(kms, &c, connector, PROP_CRTC_ID, 0);
+	}
+
+	/* Crtcs the connectors were taken from are left without any */
+	for (i = 0; !ret && i < kms->nr_crtcs; i++) {
+		struct fake_crtc *other = kms->crtcs[i];
+		unsigned int j, nr = 0;
+
+		if (other == crtc || !value(&other->base, PROP_MODE_ID))
+			continue;
+
+		for (j = 0; j < kms->nr_connectors; j++)
+			nr += value(&kms->connectors[j]->base,
+				    PROP_CRTC_ID) == other->base.id;
+		if (!nr)
+			ret = disable_crtc(kms, &c, other);
+	}
+
+commit:
+	if (ret) {
+		rollback(&c);
+		free_commit(&c);
+	} else {
+		ret = finish_commit(kms, &c, DRM_MODE_ATOMIC_ALLOW_MODESET,
+				    0, wait);
+	}
+
+	if (mode)
+		put_object(kms, mode->base.id);
+
+	return ret;
+}
+
+static int fake_getcrtc(struct fake_kms *kms, struct drm_mode_crtc *arg)
+{
+	const struct drm_mode_modeinfo *mode;
+	struct fake_plane *primary;
+	struct fake_crtc *crtc;
+
+	crtc = find_crtc(kms, arg->crtc_id);
+	if (!crtc)
+		return -ENOENT;
+
+	arg->gamma_size = crtc->gamma_size;
+	arg->fb_id = 0;
+	arg->x = arg->y = 0;
+
+	primary = primary_plane(kms, crtc);
+	if (primary && value(&primary->base, PROP_CRTC_ID) == crtc->base.id) {
+		arg->fb_id = value(&primary->base, PROP_FB_ID);
+		arg->x = value(&primary->base, PROP_SRC_X) >> 16;
+		arg->y = value(&primary->base, PROP_SRC_Y) >> 16;
+	}
+
+	mode = crtc_mode(kms, crtc);
+	arg->mode_valid = mode != NULL;
+	if (mode)
+		arg->mode = *mode;
+	else
+		memset(&arg->mode, 0, sizeof(arg->mode));
+
+	return 0;
+}
+
+static int fake_setplane(struct fake_kms *kms, struct drm_mode_set_plane *arg,
+			 uint64_t *wait)
+{
+	struct fake_commit c = { };
+	struct fake_plane *plane;
+	int ret;
+
+	plane = (struct fake_plane *)find_object(kms, arg->plane_id,
+						 DRM_MODE_OBJECT_PLANE);
+	if (!plane)
+		return -ENOENT;
+
+	if (!arg->fb_id) {
+		ret = stage_known(kms, &c, &plane->base, PROP_FB_ID, 0);
+		if (!ret)
+			ret = stage_known(kms, &c, &plane->base,
+					  PROP_CRTC_ID, 0);
+	} else if (!find_crtc(kms, arg->crtc_id) ||
+		   !find_fb(kms, arg->fb_id)) {
+		ret = -ENOENT;
+	} else {
+		ret = stage_plane(kms, &c, plane, arg->crtc_id, arg->fb_id,
+				  arg->crtc_x, arg->crtc_y,
+				  arg->crtc_w, arg->crtc_h,
+				  arg->src_x, arg->src_y,
+				  arg->src_w, arg->src_h);
+	}
+
+	if (ret) {
+		rollback(&c);
+		free_commit(&c);
+		return ret;
+	}
+
+	return finish_commit(kms, &c, 0, 0, wait);
+}
+
+static int fake_page_flip(struct fake_kms *kms,
+			  struct drm_mode_crtc_page_flip_target *arg,
+			  uint64_t *wait)
+{
+	struct fake_commit c = { };
+	struct fake_plane *primary;
+	struct fake_crtc *crtc;
+	int ret;
+
+	if (arg->flags & ~DRM_MODE_PAGE_FLIP_FLAGS ||
+	    arg->flags & DRM_MODE_PAGE_FLIP_TARGET)
+		return -EINVAL;
+
+	crtc = find_crtc(kms, arg->crtc_id);
+	if (!crtc)
+		return -ENOENT;
+
+	primary = primary_plane(kms, crtc);
+	if (!primary || !value(&crtc->base, PROP_ACTIVE) ||
+	    value(&primary->base, PROP_CRTC_ID) != crtc->base.id)
+		return -EINVAL;
+
+	if (!find_fb(kms, arg->fb_id))
+		return -ENOENT;
+
+	ret = stage_known(kms, &c, &primary->base, PROP_FB_ID, arg->fb_id);
+	if (ret) {
+		rollback(&c);
+		free_commit(&c);
+		return ret;
+	}
+
+	return finish_commit(kms, &c, DRM_MODE_ATOMIC_NONBLOCK |
+			     (arg->flags & DRM_MODE_PAGE_FLIP_EVENT),
+			     arg->user_data, wait);
+}
+
+static int fake_wait_vblank(struct fake_kms *kms, union drm_wait_vblank *vbl,
+			    uint64_t *wait)
+{
+	unsigned int type = vbl->request.type, pipe;
+	uint64_t now = now_ns(), period, seq, target;
+	struct fake_crtc *crtc;
+
+	if (type & ~(_DRM_VBLANK_TYPES_MASK | _DRM_VBLANK_HIGH_CRTC_MASK |
+		     _DRM_VBLANK_EVENT | _DRM_VBLANK_NEXTONMISS |
+		     _DRM_VBLANK_SECONDARY))
+		return -EINVAL;
+
+	pipe = (type & _DRM_VBLANK_HIGH_CRTC_MASK) >>
+	       _DRM_VBLANK_HIGH_CRTC_SHIFT;
+	if (type & _DRM_VBLANK_SECONDARY)
+		pipe = 1;
+	if (pipe >= kms->nr_crtcs)
+		return -EINVAL;
+
+	crtc = kms->crtcs[pipe];
+	period = crtc_period(kms, crtc);
+	if (!period)
+		return -EINVAL;
+
+	seq = crtc_vblank(crtc, period, now);
+	if (type & _DRM_VBLANK_RELATIVE)
+		target = seq + vbl->request.sequence;
+	else
+		target = seq + (int32_t)(vbl->request.sequence - (uint32_t)seq);
+
+	if (type & _DRM_VBLANK_NEXTONMISS && target <= seq)
+		target = seq + 1;
+
+	if (type & _DRM_VBLANK_EVENT) {
+		if (!event_space(kms, 1))
+			return -ENOMEM;
+
+		vbl->reply.sequence = target;
+		return queue_event(kms, DRM_EVENT_VBLANK, vbl->request.signal,
+				   crtc->epoch + target * period, target,
+				   crtc->base.id);
+	}
+
+	if (target > seq)
+		*wait = crtc->epoch + target * period;
+	else
+		target = seq;
+
+	now = crtc->epoch + target * period;
+	vbl->reply.sequence = target;
+	vbl->reply.tval_sec = now / NSEC_PER_SEC;
+	vbl->reply.tval_usec = now % NSEC_PER_SEC / 1000;
+
+	return 0;
+}
+
+/* Copies out the ids if the array given is large enough, like the kernel */
+static void copy_ids(uint64_t ptr, uint32_t size, const uint32_t *ids,
+		     uint32_t count)
+{
+	if (count && size >= count)
+		memcpy(from_user_pointer(ptr), ids, count * sizeof(*ids));
+}
+
+static int fake_getresources(struct fake_kms *kms,
+			     struct drm_mode_card_res *arg)
+{
+	unsigned int count = kms->nr_crtcs + kms->nr_connectors +
+			     kms->nr_encoders;
+	uint32_t *ids, nr_fbs = 0, nr_connectors = 0, nr_encoders = 0;
+	struct fake_fb *fb;
+	unsigned int i;
+
+	igt_list_for_each_entry(fb, &kms->fbs, link)
+		count++;
+
+	ids = malloc(count * sizeof(*ids) + 1);
+	if (!ids)
+		return -ENOMEM;
+
+	igt_list_for_each_entry(fb, &kms->fbs, link)
+		if (!fb->base.released)
+			ids[nr_fbs++] = fb->base.id;
+	copy_ids(arg->fb_id_ptr, arg->count_fbs, ids, nr_fbs);
+	arg->count_fbs = nr_fbs;
+
+	for (i = 0; i < kms->nr_crtcs; i++)
+		ids[i] = kms->crtcs[i]->base.id;
+	copy_ids(arg->crtc_id_ptr, arg->count_crtcs, ids, kms->nr_crtcs);
+	arg->count_crtcs = kms->nr_crtcs;
+
+	for (i = 0; i < kms->nr_connectors; i++)
+		if (connector_visible(kms, kms->connectors[i]))
+			ids[nr_connectors++] = kms->connectors[i]->base.id;
+	copy_ids(arg->connector_id_ptr, arg->count_connectors,
+		 ids, nr_connectors);
+	arg->count_connectors = nr_connectors;
+
+	for (i = 0; i < kms->nr_encoders; i++)
+		if (encoder_visible(kms, kms->encoders[i]))
+			ids[nr_encoders++] = kms->encoders[i]->base.id;
+	copy_ids(arg->encoder_id_ptr, arg->count_encoders, ids, nr_encoders);
+	arg->count_encoders = nr_encoders;
+
+	arg->min_width = kms->min_width;
+	arg->max_width = kms->max_width;
+	arg->min_height = kms->min_height;
+	arg->max_height = kms->max_height;
+
+	free(ids);
+
+	return 0;
+}
+
+static int fake_getencoder(struct fake_kms *kms,
+			   struct drm_mode_get_encoder *arg)
+{
+	struct fake_encoder *encoder;
+	unsigned int i;
+
+	encoder = (struct fake_encoder *)find_object(kms, arg->encoder_id,
+						     DRM_MODE_OBJECT_ENCODER);
+	if (!encoder || !encoder_visible(kms, encoder))
+		return -ENOENT;
+
+	arg->encoder_type = encoder->encoder_type;
+	arg->possible_crtcs = encoder->possible_crtcs;
+	arg->possible_clones = encoder->possible_clones;
+	arg->crtc_id = 0;
+
+	for (i = 0; i < kms->nr_connectors; i++) {
+		struct fake_connector *connector = kms->connectors[i];
+
+		if (connector_encoder(kms, connector) == encoder)
+			arg->crtc_id = value(&connector->base, PROP_CRTC_ID);
+	}
+
+	return 0;
+}
+
+/* Copies out the visible properties of the object, like the kernel */
+static void copy_props(struct fake_kms *kms, const struct fake_object *obj,
+		       uint64_t props_ptr, uint64_t values_ptr,
+		       uint32_t *count_props)
+{
+	uint32_t *props = from_user_pointer(props_ptr);
+	uint64_t *values = from_user_pointer(values_ptr);
+	unsigned int i, count = 0;
+
+	for (i = 0; i < obj->count_props; i++)
+		count += prop_visible(kms, obj->props[i]);
+
+	if (count && *count_props >= count) {
+		count = 0;
+		for (i = 0; i < obj->count_props; i++) {
+			if (!prop_visible(kms, obj->props[i]))
+				continue;
+
+			props[count] = obj->props[i]->base.id;
+			values[count] = obj->values[i];
+			count++;
+		}
+	}
+
+	*count_props = count;
+}
+
+static int fake_getconnector(struct fake_kms *kms,
+			     struct drm_mode_get_connector *arg)
+{
+	struct fake_connector *connector;
+	struct fake_encoder *encoder;
+	uint32_t *encoders;
+	unsigned int i;
+
+	connector = (struct fake_connector *)
+		find_object(kms, arg->connector_id, DRM_MODE_OBJECT_CONNECTOR);
+	if (!connector || !connector_visible(kms, connector))
+		return -ENOENT;
+
+	encoder = connector_encoder(kms, connector);
+	arg->encoder_id = encoder ? encoder->base.id : 0;
+	arg->connector_type = connector->connector_type;
+	arg->connector_type_id = connector->connector_type_id;
+	arg->connection = connector->connection;
+	arg->mm_width = connector->mm_width;
+	arg->mm_height = connector->mm_height;
+	/* Recorded as libdrm reports it, from 1 rather than 0 */
+	arg->subpixel = connector->subpixel ? connector->subpixel - 1 : 0;
+
+	if (connector->count_modes &&
+	    arg->count_modes >= connector->count_modes)
+		memcpy(from_user_pointer(arg->modes_ptr), connector->modes,
+		       connector->count_modes * sizeof(*connector->modes));
+	arg->count_modes = connector->count_modes;
+
+	if (connector->count_encoders &&
+	    arg->count_encoders >= connector->count_encoders) {
+		encoders = from_user_pointer(arg->encoders_ptr);
+		for (i = 0; i < connector->count_encoders; i++)
+			encoders[i] = connector->encoders[i]->base.id;
+	}
+	arg->count_encoders = connector->count_encoders;
+
+	copy_props(kms, &connector->base, arg->props_ptr,
+		   arg->prop_values_ptr, &arg->count_props);
+
+	return 0;
+}
+
+static int fake_getplaneresources(struct fake_kms *kms,
+				  struct drm_mode_get_plane_res *arg)
+{
+	uint32_t *ids, count = 0;
+	unsigned int i;
+
+	ids = malloc(kms->nr_planes * sizeof(*ids) + 1);
+	if (!ids)
+		return -ENOMEM;
+
+	for (i = 0; i < kms->nr_planes; i++)
+		if (plane_visible(kms, kms->planes[i]))
+			ids[count++] = kms->planes[i]->base.id;
+
+	copy_ids(arg->plane_id_ptr, arg->count_planes, ids, count);
+	arg->count_planes = count;
+	free(ids);
+
+	return 0;
+}
+
+static int fake_getplane(struct fake_kms *kms, struct drm_mode_get_plane *arg)
+{
+	struct fake_plane *plane;
+
+	plane = (struct fake_plane *)find_object(kms, arg->plane_id,
+						 DRM_MODE_OBJECT_PLANE);
+	if (!plane)
+		return -ENOENT;
+
+	arg->crtc_id = value(&plane->base, PROP_CRTC_ID);
+	arg->fb_id = value(&plane->base, PROP_FB_ID);
+	arg->possible_crtcs = plane->possible_crtcs;
+	arg->gamma_size = plane->gamma_size;
+
+	copy_ids(arg->format_type_ptr, arg->count_format_types,
+		 plane->formats, plane->count_formats);
+	arg->count_format_types = plane->count_formats;
+
+	return 0;
+}
+
+static int fake_obj_getproperties(struct fake_kms *kms,
+				  struct drm_mode_obj_get_properties *arg)
+{
+	struct fake_object *obj;
+
+	obj = find_object(kms, arg->obj_id, arg->obj_type);
+	if (!obj)
+		return -ENOENT;
+
+	copy_props(kms, obj, arg->props_ptr, arg->prop_values_ptr,
+		   &arg->count_props);
+
+	return 0;
+}
+
+static int fake_getproperty(struct fake_kms *kms,
+			    struct drm_mode_get_property *arg)
+{
+	struct fake_prop *prop;
+
+	prop = (struct fake_prop *)find_object(kms, arg->prop_id,
+					       DRM_MODE_OBJECT_PROPERTY);
+	if (!prop)
+		return -ENOENT;
+
+	memcpy(arg->name, prop->name, sizeof(arg->name));
+	arg->flags = prop->flags;
+
+	if (prop->count_values && arg->count_values >= prop->count_values)
+		memcpy(from_user_pointer(arg->values_ptr), prop->values,
+		       prop->count_values * sizeof(*prop->values));
+	arg->count_values = prop->count_values;
+
+	if (!(prop->flags & (DRM_MODE_PROP_ENUM | DRM_MODE_PROP_BITMASK))) {
+		arg->count_enum_blobs = 0;
+		return 0;
+	}
+
+	if (prop->count_enums && arg->count_enum_blobs >= prop->count_enums)
+		memcpy(from_user_pointer(arg->enum_blob_ptr), prop->enums,
+		       prop->count_enums * sizeof(*prop->enums));
+	arg->count_enum_blobs = prop->count_enums;
+
+	return 0;
+}
+
+static int fake_getpropblob(struct fake_kms *kms,
+			    struct drm_mode_get_blob *arg)
+{
+	struct fake_blob *blob = find_blob(kms, arg->blob_id);
+
+	if (!blob)
+		return -ENOENT;
+
+	if (arg->length == blob->length)
+		memcpy(from_user_pointer(arg->data), blob->data, blob->length);
+	arg->length = blob->length;
+
+	return 0;
+}
+
+static int fake_createpropblob(struct fake_kms *kms,
+			       struct drm_mode_create_blob *arg)
+{
+	struct fake_blob *blob;
+
+	if (!arg->length)
+		return -EINVAL;
+
+	blob = create_blob(kms, from_user_pointer(arg->data), arg->length);
+	if (!blob)
+		return -ENOMEM;
+
+	arg->blob_id = blob->base.id;
+
+	return 0;
+}
+
+static int fake_destroypropblob(struct fake_kms *kms,
+				struct drm_mode_destroy_blob *arg)
+{
+	struct fake_blob *blob = find_blob(kms, arg->blob_id);
+
+	if (!blob || blob->base.released)
+		return -EPERM;
+
+	blob->base.released = true;
+	put_object(kms, blob->base.id);
+
+	return 0;
+}
+
+static struct fake_bo *find_bo(struct fake_kms *kms, uint32_t handle)
+{
+	return igt_map_search(kms->bos, &handle);
+}
+
+static int add_fb(struct fake_kms *kms, struct drm_mode_fb_cmd2 *arg)
+{
+	struct fake_bo *bo;
+	struct fake_fb *fb;
+	unsigned int i;
+
+	if (arg->flags & ~(DRM_MODE_FB_INTERLACED | DRM_MODE_FB_MODIFIERS))
+		return -EINVAL;
+
+	if (arg->flags & DRM_MODE_FB_MODIFIERS) {
+		for (i = 0; i < kms->nr_caps; i++)
+			if (kms->caps[i].cap == DRM_CAP_ADDFB2_MODIFIERS)
+				break;
+		if (i == kms->nr_caps || !kms->caps[i].value)
+			return -EINVAL;
+	}
+
+	if (!arg->width || arg->width > kms->max_width ||
+	    !arg->height || arg->height > kms->max_height)
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(arg->handles); i++)
+		if ((arg->handles[i] || !i) && !find_bo(kms, arg->handles[i]))
+			return -ENOENT;
+
+	bo = find_bo(kms, arg->handles[0]);
+	if (arg->offsets[0] + (uint64_t)arg->pitches[0] * arg->height >
+	    bo->size)
+		return -EINVAL;
+
+	fb = alloc_object(sizeof(*fb), kms->next_id, DRM_MODE_OBJECT_FB);
+	if (!fb)
+		return -ENOMEM;
+
+	fb->width = arg->width;
+	fb->height = arg->height;
+	fb->pixel_format = arg->pixel_format;
+	fb->flags = arg->flags;
+	memcpy(fb->handles, arg->handles, sizeof(fb->handles));
+	memcpy(fb->pitches, arg->pitches, sizeof(fb->pitches));
+	memcpy(fb->offsets, arg->offsets, sizeof(fb->offsets));
+	if (arg->flags & DRM_MODE_FB_MODIFIERS)
+		memcpy(fb->modifier, arg->modifier, sizeof(fb->modifier));
+	igt_list_add_tail(&fb->link, &kms->fbs);
+
+	arg->fb_id = fb->base.id;
+
+	return add_object(kms, &fb->base);
+}
+
+static int fake_addfb(struct fake_kms *kms, struct drm_mode_fb_cmd *arg)
+{
+	struct drm_mode_fb_cmd2 cmd = {
+		.width = arg->width,
+		.height = arg->height,
+		.handles[0] = arg->handle,
+		.pitches[0] = arg->pitch,
+	};
+	int ret;
+
+	switch (arg->bpp << 8 | arg->depth) {
+	case 8 << 8 | 8:
+		cmd.pixel_format = DRM_FORMAT_C8;
+		break;
+	case 16 << 8 | 15:
+		cmd.pixel_format = DRM_FORMAT_XRGB1555;
+		break;
+	case 16 << 8 | 16:
+		cmd.pixel_format = DRM_FORMAT_RGB565;
+		break;
+	case 24 << 8 | 24:
+		cmd.pixel_format = DRM_FORMAT_RGB888;
+		break;
+	case 32 << 8 | 24:
+		cmd.pixel_format = DRM_FORMAT_XRGB8888;
+		break;
+	case 32 << 8 | 30:
+		cmd.pixel_format = DRM_FORMAT_XRGB2101010;
+		break;
+	case 32 << 8 | 32:
+		cmd.pixel_format = DRM_FORMAT_ARGB8888;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ret = add_fb(kms, &cmd);
+	arg->fb_id = cmd.fb_id;
+
+	return ret;
+}
+
+static int fake_rmfb(struct fake_kms *kms, uint32_t *fb_id, uint64_t *wait)
+{
+	struct fake_commit c = { };
+	struct fake_fb *fb;
+	unsigned int i;
+	int ret = 0;
+
+	fb = find_fb(kms, *fb_id);
+	if (!fb || fb->base.released)
+		return -ENOENT;
+
+	/* Planes scanning it out are disabled, crtcs with their primary */
+	for (i = 0; !ret && i < kms->nr_planes; i++) {
+		struct fake_plane *plane = kms->planes[i];
+		struct fake_crtc *crtc;
+
+		if (value(&plane->base, PROP_FB_ID) != fb->base.id)
+			continue;
+
+		crtc = find_crtc(kms, value(&plane->base, PROP_CRTC_ID));
+		if (crtc && primary_plane(kms, crtc) == plane)
+			ret = disable_crtc(kms, &c, crtc);
+		if (!ret)
+			ret = stage_plane(kms, &c, plane, 0, 0, 0, 0, 0, 0,
+					  0, 0, 0, 0);
+	}
+
+	if (ret) {
+		rollback(&c);
+		free_commit(&c);
+	} else if (c.nr_changes) {
+		ret = finish_commit(kms, &c, DRM_MODE_ATOMIC_ALLOW_MODESET,
+				    0, wait);
+	} else {
+		free_commit(&c);
+	}
+
+	if (!ret)
+		destroy_object(kms, &fb->base);
+
+	return ret;
+}
+
+static int fake_closefb(struct fake_kms *kms, struct drm_mode_closefb *arg)
+{
+	struct fake_fb *fb = find_fb(kms, arg->fb_id);
+
+	if (!fb || fb->base.released || arg->pad)
+		return -ENOENT;
+
+	fb->base.released = true;
+	put_object(kms, fb->base.id);
+
+	return 0;
+}
+
+static int fake_dirtyfb(struct fake_kms *kms, struct drm_mode_fb_dirty_cmd *arg)
+{
+	return find_fb(kms, arg->fb_id) ? 0 : -ENOENT;
+}
+
+static int fake_create_dumb(struct fake_kms *kms,
+			    struct drm_mode_create_dumb *arg)
+{
+	uint64_t pitch, size;
+	struct fake_bo *bo;
+
+	if (!arg->width || !arg->height || !arg->bpp || arg->flags)
+		return -EINVAL;
+
+	pitch = ALIGN((uint64_t)arg->width * DIV_ROUND_UP(arg->bpp, 8),
+		      FAKE_DUMB_PITCH);
+	size = ALIGN(pitch * arg->height, 4096);
+	if (pitch > UINT32_MAX)
+		return -EINVAL;
+
+	bo = malloc(sizeof(*bo));
+	if (!bo)
+		return -ENOMEM;
+
+	if (ftruncate(kms->memfd, kms->next_offset + size)) {
+		free(bo);
+		return -ENOMEM;
+	}
+
+	bo->handle = kms->next_handle++;
+	bo->size = size;
+	bo->offset = kms->next_offset;
+	kms->next_offset += size;
+	igt_map_insert(kms->bos, &bo->handle, bo);
+
+	arg->handle = bo->handle;
+	arg->pitch = pitch;
+	arg->size = size;
+
+	return 0;
+}
+
+static int fake_map_dumb(struct fake_kms *kms, struct drm_mode_map_dumb *arg)
+{
+	struct fake_bo *bo = find_bo(kms, arg->handle);
+
+	if (!bo)
+		return -ENOENT;
+
+	arg->offset = bo->offset;
+
+	return 0;
+}
+
+static int destroy_bo(struct fake_kms *kms, uint32_t handle)
+{
+	struct fake_bo *bo = find_bo(kms, handle);
+
+	if (!bo)
+		return -EINVAL;
+
+	/* Offsets are not reused, only the memory behind them */
+	fallocate(kms->memfd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		  bo->offset, bo->size);
+	igt_map_remove(kms->bos, &handle, NULL);
+	free(bo);
+
+	return 0;
+}
+
+static int fake_destroy_dumb(struct fake_kms *kms,
+			     struct drm_mode_destroy_dumb *arg)
+{
+	return destroy_bo(kms, arg->handle);
+}
+
+static int fake_gem_close(struct fake_kms *kms, struct drm_gem_close *arg)
+{
+	return destroy_bo(kms, arg->handle);
+}
+
+static int fake_cursor(struct fake_kms *kms, struct drm_mode_cursor *arg)
+{
+	return find_crtc(kms, arg->crtc_id) ? 0 : -ENOENT;
+}
+
+static void copy_string(char *dst, __kernel_size_t *len, const char *src)
+{
+	size_t n = strlen(src);
+
+	if (*len && dst)
+		memcpy(dst, src, min(*len, n));
+	*len = n;
+}
+
+static int fake_version(struct fake_kms *kms, struct drm_version *arg)
+{
+	arg->version_major = kms->version[0];
+	arg->version_minor = kms->version[1];
+	arg->version_patchlevel = kms->version[2];
+	copy_string(arg->name, &arg->name_len, FAKE_DRIVER);
+	copy_string(arg->date, &arg->date_len, "0");
+	copy_string(arg->desc, &arg->desc_len, kms->driver);
+
+	return 0;
+}
+
+static int fake_get_cap(struct fake_kms *kms, struct drm_get_cap *arg)
+{
+	unsigned int i;
+
+	for (i = 0; i < kms->nr_caps; i++) {
+		if (kms->caps[i].cap == arg->capability) {
+			arg->value = kms->caps[i].value;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int fake_set_client_cap(struct fake_kms *kms,
+			       struct drm_set_client_cap *arg)
+{
+	uint64_t bit;
+
+	if (arg->capability >= 64 || arg->value > 1 ||
+	    !(kms->client_caps & 1ull << arg->capability))
+		return -EINVAL;
+
+	if (arg->capability == DRM_CLIENT_CAP_WRITEBACK_CONNECTORS &&
+	    !cap_enabled(kms, DRM_CLIENT_CAP_ATOMIC))
+		return -EINVAL;
+
+	bit = 1ull << arg->capability;
+	if (arg->capability == DRM_CLIENT_CAP_ATOMIC && arg->value)
+		bit |= (1ull << DRM_CLIENT_CAP_UNIVERSAL_PLANES |
+			1ull << DRM_CLIENT_CAP_ASPECT_RATIO) &
+		       kms->client_caps;
+
+	if (arg->value)
+		kms->enabled_caps |= bit;
+	else
+		kms->enabled_caps &= ~bit;
+
+	return 0;
+}
+
+static int fake_ioctl(struct fake_kms *kms, unsigned long request, void *arg,
+		      uint64_t *wait)
+{
+	switch (request) {
+	case DRM_IOCTL_VERSION:
+		return fake_version(kms, arg);
+	case DRM_IOCTL_GET_CAP:
+		return fake_get_cap(kms, arg);
+	case DRM_IOCTL_SET_CLIENT_CAP:
+		return fake_set_client_cap(kms, arg);
+	case DRM_IOCTL_SET_MASTER:
+	case DRM_IOCTL_DROP_MASTER:
+		return 0;
+	case DRM_IOCTL_WAIT_VBLANK:
+		return fake_wait_vblank(kms, arg, wait);
+	case DRM_IOCTL_GEM_CLOSE:
+		return fake_gem_close(kms, arg);
+	case DRM_IOCTL_MODE_GETRESOURCES:
+		return fake_getresources(kms, arg);
+	case DRM_IOCTL_MODE_GETCRTC:
+		return fake_getcrtc(kms, arg);
+	case DRM_IOCTL_MODE_SETCRTC:
+		return fake_setcrtc(kms, arg, wait);
+	case DRM_IOCTL_MODE_CURSOR:
+	case DRM_IOCTL_MODE_CURSOR2:
+		return fake_cursor(kms, arg);
+	case DRM_IOCTL_MODE_GETENCODER:
+		return fake_getencoder(kms, arg);
+	case DRM_IOCTL_MODE_GETCONNECTOR:
+		return fake_getconnector(kms, arg);
+	case DRM_IOCTL_MODE_GETPROPERTY:
+		return fake_getproperty(kms, arg);
+	case DRM_IOCTL_MODE_SETPROPERTY:
+		return fake_connector_setproperty(kms, arg, wait);
+	case DRM_IOCTL_MODE_GETPROPBLOB:
+		return fake_getpropblob(kms, arg);
+	case DRM_IOCTL_MODE_ADDFB:
+		return fake_addfb(kms, arg);
+	case DRM_IOCTL_MODE_ADDFB2:
+		return add_fb(kms, arg);
+	case DRM_IOCTL_MODE_RMFB:
+		return fake_rmfb(kms, arg, wait);
+	case DRM_IOCTL_MODE_CLOSEFB:
+		return fake_closefb(kms, arg);
+	case DRM_IOCTL_MODE_DIRTYFB:
+		return fake_dirtyfb(kms, arg);
+	case DRM_IOCTL_MODE_PAGE_FLIP:
+		return fake_page_flip(kms, arg, wait);
+	case DRM_IOCTL_MODE_CREATE_DUMB:
+		return fake_create_dumb(kms, arg);
+	case DRM_IOCTL_MODE_MAP_DUMB:
+		return fake_map_dumb(kms, arg);
+	case DRM_IOCTL_MODE_DESTROY_DUMB:
+		return fake_destroy_dumb(kms, arg);
+	case DRM_IOCTL_MODE_GETPLANERESOURCES:
+		return fake_getplaneresources(kms, arg);
+	case DRM_IOCTL_MODE_GETPLANE:
+		return fake_getplane(kms, arg);
+	case DRM_IOCTL_MODE_SETPLANE:
+		return fake_setplane(kms, arg, wait);
+	case DRM_IOCTL_MODE_OBJ_GETPROPERTIES:
+		return fake_obj_getproperties(kms, arg);
+	case DRM_IOCTL_MODE_OBJ_SETPROPERTY:
+		return fake_obj_setproperty(kms, arg, wait);
+	case DRM_IOCTL_MODE_ATOMIC:
+		return fake_atomic(kms, arg, wait);
+	case DRM_IOCTL_MODE_CREATEPROPBLOB:
+		return fake_createpropblob(kms, arg);
+	case DRM_IOCTL_MODE_DESTROYPROPBLOB:
+		return fake_destroypropblob(kms, arg);
+	default:
+		igt_debug("fake: ioctl %#lx not served\n", request);
+		return -EINVAL;
+	}
+}
+
+static int load_driver(struct fake_kms *kms, char *args)
+{
+	int n = 0;
+
+	if (sscanf(args, "%d %d %d %n", &kms->version[0], &kms->version[1],
+		   &kms->version[2], &n) != 3 || !n)
+		return -EINVAL;
+
+	snprintf(kms->driver, sizeof(kms->driver), "%s", args + n);
+
+	return 0;
+}
+
+static int load_cap(struct fake_kms *kms, char *args)
+{
+	uint64_t cap, val;
+
+	if (sscanf(args, "%" SCNu64 " %" SCNu64, &cap, &val) != 2 ||
+	    kms->nr_caps == FAKE_MAX_CAPS)
+		return -EINVAL;
+
+	kms->caps[kms->nr_caps].cap = cap;
+	kms->caps[kms->nr_caps].value = val;
+	kms->nr_caps++;
+
+	return 0;
+}
+
+static int load_client_cap(struct fake_kms *kms, char *args)
+{
+	unsigned int cap;
+
+	if (sscanf(args, "%u", &cap) != 1 || cap >= 64)
+		return -EINVAL;
+
+	kms->client_caps |= 1ull << cap;
+
+	return 0;
+}
+
+static int load_size(struct fake_kms *kms, char *args)
+{
+	if (sscanf(args, "%u %u %u %u", &kms->min_width, &kms->max_width,
+		   &kms->min_height, &kms->max_height) != 4)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int load_prop(struct fake_kms *kms, char *args)
+{
+	struct fake_prop *prop;
+	uint32_t id, flags;
+	int n = 0;
+
+	if (sscanf(args, "%u %u %n", &id, &flags, &n) != 2 || !n)
+		return -EINVAL;
+
+	prop = alloc_object(sizeof(*prop), id, DRM_MODE_OBJECT_PROPERTY);
+	if (!prop)
+		return -ENOMEM;
+
+	prop->flags = flags;
+	snprintf(prop->name, sizeof(prop->name), "%s", args + n);
+
+	return add_object(kms, &prop->base);
+}
+
+static int load_prop_value(struct fake_kms *kms, char *args)
+{
+	struct fake_prop *prop;
+	uint64_t *val;
+	uint32_t id;
+	uint64_t v;
+
+	if (sscanf(args, "%u %" SCNu64, &id, &v) != 2)
+		return -EINVAL;
+
+	prop = (struct fake_prop *)find_object(kms, id,
+					       DRM_MODE_OBJECT_PROPERTY);
+	if (!prop)
+		return -ENOENT;
+
+	val = append(&prop->values, &prop->count_values, sizeof(*val));
+	if (!val)
+		return -ENOMEM;
+	*val = v;
+
+	return 0;
+}
+
+static int load_prop_enum(struct fake_kms *kms, char *args)
+{
+	struct drm_mode_property_enum *e;
+	struct fake_prop *prop;
+	uint32_t id;
+	uint64_t v;
+	int n = 0;
+
+	if (sscanf(args, "%u %" SCNu64 " %n", &id, &v, &n) != 2 || !n)
+		return -EINVAL;
+
+	prop = (struct fake_prop *)find_object(kms, id,
+					       DRM_MODE_OBJECT_PROPERTY);
+	if (!prop)
+		return -ENOENT;
+
+	e = append(&prop->enums, &prop->count_enums, sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+	e->value = v;
+	snprintf(e->name, sizeof(e->name), "%s", args + n);
+
+	return 0;
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+static int load_blob(struct fake_kms *kms, char *args)
+{
+	struct fake_blob *blob;
+	const char *hex;
+	size_t len, i;
+	uint32_t id;
+	int n = 0;
+
+	if (sscanf(args, "%u %n", &id, &n) != 1 || !n)
+		return -EINVAL;
+
+	hex = args + n;
+	len = strlen(hex);
+	if (!len || len % 2)
+		return -EINVAL;
+
+	blob = alloc_object(sizeof(*blob), id, DRM_MODE_OBJECT_BLOB);
+	if (!blob)
+		return -ENOMEM;
+
+	/* Recorded blobs are only held by the objects referring to them */
+	blob->base.released = true;
+	blob->length = len / 2;
+	blob->data = malloc(blob->length);
+	if (!blob->data) {
+		free_object(&blob->base);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < blob->length; i++) {
+		int hi = hex_digit(hex[2 * i]), lo = hex_digit(hex[2 * i + 1]);
+
+		if (hi < 0 || lo < 0) {
+			free_object(&blob->base);
+			return -EINVAL;
+		}
+		((uint8_t *)blob->data)[i] = hi << 4 | lo;
+	}
+
+	return add_object(kms, &blob->base);
+}
+
+static int load_crtc(struct fake_kms *kms, char *args)
+{
+	struct fake_crtc *crtc, **slot;
+	uint32_t id, gamma_size;
+	int ret;
+
+	if (sscanf(args, "%u %u", &id, &gamma_size) != 2 || kms->nr_crtcs == 32)
+		return -EINVAL;
+
+	crtc = alloc_object(sizeof(*crtc), id, DRM_MODE_OBJECT_CRTC);
+	if (!crtc)
+		return -ENOMEM;
+
+	crtc->index = kms->nr_crtcs;
+	crtc->gamma_size = gamma_size;
+
+	ret = add_object(kms, &crtc->base);
+	if (ret)
+		return ret;
+
+	slot = append(&kms->crtcs, &kms->nr_crtcs, sizeof(*slot));
+	if (!slot)
+		return -ENOMEM;
+	*slot = crtc;
+
+	return 0;
+}
+
+static int load_encoder(struct fake_kms *kms, char *args)
+{
+	struct fake_encoder *encoder, **slot;
+	uint32_t id;
+	int ret;
+
+	encoder = alloc_object(sizeof(*encoder), 0, DRM_MODE_OBJECT_ENCODER);
+	if (!encoder)
+		return -ENOMEM;
+
+	if (sscanf(args, "%u %u %u %u", &id, &encoder->encoder_type,
+		   &encoder->possible_crtcs,
+		   &encoder->possible_clones) != 4) {
+		free_object(&encoder->base);
+		return -EINVAL;
+	}
+	encoder->base.id = id;
+
+	ret = add_object(kms, &encoder->base);
+	if (ret)
+		return ret;
+
+	slot = append(&kms->encoders, &kms->nr_encoders, sizeof(*slot));
+	if (!slot)
+		return -ENOMEM;
+	*slot = encoder;
+
+	return 0;
+}
+
+static int load_connector(struct fake_kms *kms, char *args)
+{
+	struct fake_connector *connector, **slot;
+	uint32_t id;
+	int ret;
+
+	connector = alloc_object(sizeof(*connector), 0,
+				 DRM_MODE_OBJECT_CONNECTOR);
+	if (!connector)
+		return -ENOMEM;
+
+	if (sscanf(args, "%u %u %u %u %u %u %u", &id,
+		   &connector->connector_type, &connector->connector_type_id,
+		   &connector->connection, &connector->mm_width,
+		   &connector->mm_height, &connector->subpixel) != 7) {
+		free_object(&connector->base);
+		return -EINVAL;
+	}
+	connector->base.id = id;
+
+	ret = add_object(kms, &connector->base);
+	if (ret)
+		return ret;
+
+	slot = append(&kms->connectors, &kms->nr_connectors, sizeof(*slot));
+	if (!slot)
+		return -ENOMEM;
+	*slot = connector;
+
+	return 0;
+}
+
+static int load_connector_encoder(struct fake_kms *kms, char *args)
+{
+	struct fake_encoder *encoder, **slot;
+	struct fake_connector *connector;
+	uint32_t connector_id, encoder_id;
+
+	if (sscanf(args, "%u %u", &connector_id, &encoder_id) != 2)
+		return -EINVAL;
+
+	connector = (struct fake_connector *)
+		find_object(kms, connector_id, DRM_MODE_OBJECT_CONNECTOR);
+	encoder = (struct fake_encoder *)
+		find_object(kms, encoder_id, DRM_MODE_OBJECT_ENCODER);
+	if (!connector || !encoder)
+		return -ENOENT;
+
+	slot = append(&connector->encoders, &connector->count_encoders,
+		      sizeof(*slot));
+	if (!slot)
+		return -ENOMEM;
+	*slot = encoder;
+
+	return 0;
+}
+
+static int load_mode(struct fake_kms *kms, char *args)
+{
+	struct fake_connector *connector;
+	struct drm_mode_modeinfo *mode;
+	unsigned int f[15];
+	int n = 0;
+
+	if (sscanf(args, "%u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %n",
+		   &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7],
+		   &f[8], &f[9], &f[10], &f[11], &f[12], &f[13], &f[14],
+		   &n) != 15 || !n)
+		return -EINVAL;
+
+	connector = (struct fake_connector *)
+		find_object(kms, f[0], DRM_MODE_OBJECT_CONNECTOR);
+	if (!connector)
+		return -ENOENT;
+
+	mode = append(&connector->modes, &connector->count_modes,
+		      sizeof(*mode));
+	if (!mode)
+		return -ENOMEM;
+
+	mode->clock = f[1];
+	mode->hdisplay = f[2];
+	mode->hsync_start = f[3];
+	mode->hsync_end = f[4];
+	mode->htotal = f[5];
+	mode->hskew = f[6];
+	mode->vdisplay = f[7];
+	mode->vsync_start = f[8];
+	mode->vsync_end = f[9];
+	mode->vtotal = f[10];
+	mode->vscan = f[11];
+	mode->vrefresh = f[12];
+	mode->flags = f[13];
+	mode->type = f[14];
+	snprintf(mode->name, sizeof(mode->name), "%s", args + n);
+
+	return 0;
+}
+
+static int load_plane(struct fake_kms *kms, char *args)
+{
+	struct fake_plane *plane, **slot;
+	uint32_t id;
+	int ret;
+
+	plane = alloc_object(sizeof(*plane), 0, DRM_MODE_OBJECT_PLANE);
+	if (!plane)
+		return -ENOMEM;
+
+	if (sscanf(args, "%u %u %u", &id, &plane->possible_crtcs,
+		   &plane->gamma_size) != 3) {
+		free_object(&plane->base);
+		return -EINVAL;
+	}
+	plane->base.id = id;
+
+	ret = add_object(kms, &plane->base);
+	if (ret)
+		return ret;
+
+	slot = append(&kms->planes, &kms->nr_planes, sizeof(*slot));
+	if (!slot)
+		return -ENOMEM;
+	*slot = plane;
+
+	return 0;
+}
+
+static int load_plane_formats(struct fake_kms *kms, char *args)
+{
+	struct fake_plane *plane;
+	char *end;
+	uint32_t id;
+	int n = 0;
+
+	if (sscanf(args, "%u %n", &id, &n) != 1 || !n)
+		return -EINVAL;
+
+	plane = (struct fake_plane *)find_object(kms, id,
+						 DRM_MODE_OBJECT_PLANE);
+	if (!plane)
+		return -ENOENT;
+
+	for (args += n; *args; args = end) {
+		unsigned long format = strtoul(args, &end, 0);
+		uint32_t *slot;
+
+		if (end == args)
+			return -EINVAL;
+
+		slot = append(&plane->formats, &plane->count_formats,
+			      sizeof(*slot));
+		if (!slot)
+			return -ENOMEM;
+		*slot = format;
+	}
+
+	return 0;
+}
+
+static int load_object_prop(struct fake_kms *kms, char *args)
+{
+	struct fake_object *obj;
+	struct fake_prop *prop;
+	uint32_t obj_id, prop_id;
+	unsigned int count, i;
+	uint64_t *values;
+	uint64_t v;
+	void *props;
+
+	if (sscanf(args, "%u %u %" SCNu64, &obj_id, &prop_id, &v) != 3)
+		return -EINVAL;
+
+	obj = find_object(kms, obj_id, DRM_MODE_OBJECT_ANY);
+	prop = (struct fake_prop *)find_object(kms, prop_id,
+					       DRM_MODE_OBJECT_PROPERTY);
+	if (!obj || !prop)
+		return -ENOENT;
+
+	count = obj->count_props;
+	props = append(&obj->props, &count, sizeof(*obj->props));
+	if (!props)
+		return -ENOMEM;
+	count = obj->count_props;
+	values = append(&obj->values, &count, sizeof(*obj->values));
+	if (!values)
+		return -ENOMEM;
+
+	obj->props[obj->count_props] = prop;
+	*values = v;
+
+	for (i = 0; i < NUM_KNOWN_PROPS; i++)
+		if (obj->known[i] < 0 && !strcmp(prop->name, known_names[i]))
+			obj->known[i] = obj->count_props;
+
+	obj->count_props++;
+
+	return 0;
+}
+
+static const struct {
+	const char *keyword;
+	int (*load)(struct fake_kms *kms, char *args);
+} records[] = {
+	{ "driver", load_driver },
+	{ "cap", load_cap },
+	{ "client-cap", load_client_cap },
+	{ "size", load_size },
+	{ "prop", load_prop },
+	{ "prop-value", load_prop_value },
+	{ "prop-enum", load_prop_enum },
+	{ "blob", load_blob },
+	{ "crtc", load_crtc },
+	{ "encoder", load_encoder },
+	{ "connector", load_connector },
+	{ "connector-encoder", load_connector_encoder },
+	{ "mode", load_mode },
+	{ "plane", load_plane },
+	{ "plane-formats", load_plane_formats },
+	{ "object-prop", load_object_prop },
+};
+
+/*
+ * Drops the references to what was not recorded, framebuffers in
+ * particular, and starts the timings of the active crtcs.
+ */
+static void finish_load(struct fake_kms *kms)
+{
+	struct igt_map_entry *entry;
+	uint64_t now = now_ns();
+	unsigned int i;
+
+	igt_map_foreach(kms->objects, entry) {
+		struct fake_object *obj = entry->data;
+
+		for (i = 0; i < obj->count_props; i++) {
+			if (obj->props[i]->flags & DRM_MODE_PROP_IMMUTABLE ||
+			    valid_value(kms, obj->props[i], obj->values[i]))
+				continue;
+
+			if (obj->props[i]->flags & DRM_MODE_PROP_BLOB ||
+			    (obj->props[i]->flags &
+			     DRM_MODE_PROP_EXTENDED_TYPE) ==
+			    DRM_MODE_PROP_OBJECT)
+				obj->values[i] = 0;
+		}
+	}
+
+	for (i = 0; i < kms->nr_planes; i++) {
+		struct fake_object *plane = &kms->planes[i]->base;
+
+		if (!value(plane, PROP_FB_ID) &&
+		    plane->known[PROP_CRTC_ID] >= 0)
+			plane->values[plane->known[PROP_CRTC_ID]] = 0;
+	}
+
+	for (i = 0; i < kms->nr_crtcs; i++)
+		kms->crtcs[i]->epoch = now;
+}
+
+static int load(struct fake_kms *kms, FILE *f, const char *filename)
+{
+	unsigned int lineno = 1, i;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	int ret = 0;
+
+	len = getline(&line, &size, f);
+	if (len < 0 || strncmp(line, FAKE_HEADER "\n", len)) {
+		igt_warn("%s: not a KMS recording\n", filename);
+		free(line);
+		return -EINVAL;
+	}
+
+	while (!ret && (len = getline(&line, &size, f)) > 0) {
+		char keyword[32], *args;
+		int n = 0;
+
+		lineno++;
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		if (sscanf(line, "%31s%n", keyword, &n) != 1 ||
+		    keyword[0] == '#')
+			continue;
+
+		args = line + n;
+		ret = -EINVAL;
+		for (i = 0; i < ARRAY_SIZE(records); i++) {
+			if (!strcmp(keyword, records[i].keyword)) {
+				ret = records[i].load(kms, args);
+				break;
+			}
+		}
+
+		if (ret)
+			igt_warn("%s:%u: invalid record: %s\n",
+				 filename, lineno, strerror(-ret));
+	}
+
+	free(line);
+
+	if (!ret)
+		finish_load(kms);
+
+	return ret;
+}
+
+static void free_kms(struct fake_kms *kms)
+{
+	igt_map_destroy(kms->objects, free_object_entry);
+	igt_map_destroy(kms->bos, free_bo_entry);
+	free(kms->crtcs);
+	free(kms->encoders);
+	free(kms->connectors);
+	free(kms->planes);
+
+	if (kms->fd >= 0)
+		close(kms->fd);
+	if (kms->fd_ref >= 0)
+		close(kms->fd_ref);
+	if (kms->event_fd >= 0)
+		close(kms->event_fd);
+	if (kms->memfd >= 0)
+		close(kms->memfd);
+
+	pthread_mutex_destroy(&kms->mutex);
+	free(kms);
+}
+
+static struct fake_kms *get_fake(int fd)
+{
+	struct fake_kms *kms, *found = NULL;
+	struct stat st;
+
+	if (fd < 0 || !__atomic_load_n(&nr_fakes, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	pthread_mutex_lock(&fakes_mutex);
+	igt_list_for_each_entry(kms, &fakes, link) {
+		if (kms->fd == fd) {
+			found = kms;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&fakes_mutex);
+
+	/* The fd may have been closed and its number reused behind our back */
+	if (found && (fstat(fd, &st) || st.st_ino != found->ino))
+		return NULL;
+
+	return found;
+}
+
+/**
+ * igt_kms_fake_open:
+ * @filename: Recording from igt_kms_fake_record()
+ * @opts: Latency of the commits, NULL for none
+ *
+ * Loads a recording of a KMS device and opens a fake of it. The ioctls of
+ * the fd returned are served by the fake, through libdrm and igt_kms, in
+ * programs linked with the lib_igt_kms_fake dependency. As a real DRM fd,
+ * it polls readable when events are pending and mmap() maps dumb buffers.
+ *
+ * Returns: The fd of the fake, to be closed with igt_kms_fake_close(), or a
+ * negative errno if the recording could not be loaded.
+ */
+int igt_kms_fake_open(const char *filename,
+		      const struct igt_kms_fake_opts *opts)
+{
+	struct fake_kms *kms;
+	struct stat st;
+	int sv[2], ret;
+	FILE *f;
+
+	f = fopen(filename, "r");
+	if (!f)
+		return -errno;
+
+	kms = calloc(1, sizeof(*kms));
+	if (!kms) {
+		fclose(f);
+		return -ENOMEM;
+	}
+
+	kms->fd = kms->fd_ref = kms->event_fd = kms->memfd = -1;
+	pthread_mutex_init(&kms->mutex, NULL);
+	IGT_INIT_LIST_HEAD(&kms->fbs);
+	kms->objects = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	kms->bos = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	kms->next_id = 1;
+	kms->next_handle = 1;
+	if (opts)
+		kms->opts = *opts;
+
+	ret = load(kms, f, filename);
+	fclose(f);
+	if (ret)
+		goto err;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv)) {
+		ret = -errno;
+		goto err;
+	}
+	kms->fd = sv[0];
+	kms->event_fd = sv[1];
+
+	kms->fd_ref = fcntl(kms->fd, F_DUPFD_CLOEXEC, 0);
+	kms->memfd = memfd_create("igt_kms_fake", MFD_CLOEXEC);
+	if (kms->fd_ref < 0 || kms->memfd < 0 || fstat(kms->fd, &st)) {
+		ret = -errno;
+		goto err;
+	}
+	kms->ino = st.st_ino;
+
+	pthread_mutex_lock(&fakes_mutex);
+	igt_list_add(&kms->link, &fakes);
+	__atomic_add_fetch(&nr_fakes, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&fakes_mutex);
+
+	return kms->fd;
+
+err:
+	free_kms(kms);
+	return ret;
+}
+
+/**
+ * igt_kms_fake_close:
+ * @fd: Fd from igt_kms_fake_open()
+ *
+ * Closes the fake, along with its fd and all that was created through it.
+ */
+void igt_kms_fake_close(int fd)
+{
+	struct fake_kms *kms = get_fake(fd);
+
+	if (!kms)
+		return;
+
+	pthread_mutex_lock(&fakes_mutex);
+	igt_list_del(&kms->link);
+	__atomic_sub_fetch(&nr_fakes, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&fakes_mutex);
+
+	/* Another fake may get the same fd number */
+	igt_kms_props_invalidate(fd);
+	free_kms(kms);
+}
+
+/**
+ * igt_kms_fake_owns:
+ * @fd: Any fd
+ *
+ * Returns: Whether @fd is the fd of a fake opened with igt_kms_fake_open().
+ */
+bool igt_kms_fake_owns(int fd)
+{
+	return get_fake(fd);
+}
+
+/**
+ * igt_kms_fake_get_stats:
+ * @fd: Fd from igt_kms_fake_open()
+ * @stats: Returns the counts of what the fake has served so far
+ */
+void igt_kms_fake_get_stats(int fd, struct igt_kms_fake_stats *stats)
+{
+	struct fake_kms *kms = get_fake(fd);
+
+	memset(stats, 0, sizeof(*stats));
+	if (!kms)
+		return;
+
+	pthread_mutex_lock(&kms->mutex);
+	*stats = kms->stats;
+	pthread_mutex_unlock(&kms->mutex);
+}
+
+/**
+ * igt_kms_fake_ioctl:
+ * @fd: Fd from igt_kms_fake_open()
+ * @request: DRM ioctl
+ * @arg: Argument of the ioctl
+ *
+ * Serves a DRM ioctl from the fake, as drmIoctl() does for lib_igt_kms_fake
+ * users. Ioctls the fake does not know fail with EINVAL. Blocking commits
+ * and vblank waits sleep until they complete, without holding up the other
+ * ioctls on the fd.
+ *
+ * Returns: 0 on success, -1 with errno set on failure, as drmIoctl().
+ */
+int igt_kms_fake_ioctl(int fd, unsigned long request, void *arg)
+{
+	struct fake_kms *kms = get_fake(fd);
+	uint64_t wait = 0;
+	int ret;
+
+	if (!kms) {
+		errno = EBADF;
+		return -1;
+	}
+
+	pthread_mutex_lock(&kms->mutex);
+	ret = fake_ioctl(kms, request, arg, &wait);
+	kms->stats.ioctls++;
+	kms->stats.failed += ret != 0;
+	pthread_mutex_unlock(&kms->mutex);
+
+	if (wait)
+		sleep_until(wait);
+
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * igt_kms_fake_mmap:
+ * @addr: As for mmap()
+ * @length: As for mmap()
+ * @prot: As for mmap()
+ * @flags: As for mmap()
+ * @fd: Fd from igt_kms_fake_open()
+ * @offset: Offset of a dumb buffer, from DRM_IOCTL_MODE_MAP_DUMB
+ *
+ * Maps dumb buffers of the fake, as mmap() does for lib_igt_kms_fake users.
+ *
+ * Returns: The mapping, or MAP_FAILED with errno set.
+ */
+void *igt_kms_fake_mmap(void *addr, size_t length, int prot, int flags,
+			int fd, uint64_t offset)
+{
+	struct fake_kms *kms = get_fake(fd);
+
+	if (!kms) {
+		errno = EBADF;
+		return MAP_FAILED;
+	}
+
+	return mmap(addr, length, prot, flags, kms->memfd, offset);
+}
+
+struct recorder {
+	int fd;
+	FILE *f;
+	struct igt_map *written; /* ids of the properties and blobs written */
+};
+
+/* Returns whether the property or blob was written already */
+static bool written(struct recorder *r, uint32_t id)
+{
+	uint32_t *key;
+
+	if (igt_map_search(r->written, &id))
+		return true;
+
+	key = malloc(sizeof(*key));
+	if (key) {
+		*key = id;
+		igt_map_insert(r->written, key, key);
+	}
+
+	return false;
+}
+
+static void free_written(struct igt_map_entry *entry)
+{
+	free(entry->data);
+}
+
+static void record_prop(struct recorder *r, const drmModePropertyRes *prop)
+{
+	int i;
+
+	fprintf(r->f, "prop %u %u %s\n", prop->prop_id, prop->flags,
+		prop->name);
+
+	for (i = 0; i < prop->count_values; i++)
+		fprintf(r->f, "prop-value %u %" PRIu64 "\n",
+			prop->prop_id, (uint64_t)prop->values[i]);
+
+	for (i = 0; i < prop->count_enums; i++)
+		fprintf(r->f, "prop-enum %u %" PRIu64 " %s\n", prop->prop_id,
+			(uint64_t)prop->enums[i].value, prop->enums[i].name);
+}
+
+static void record_blob(struct recorder *r, uint32_t id)
+{
+	drmModePropertyBlobPtr blob;
+	uint32_t i;
+
+	/* Gone since, the value is dropped when loading */
+	blob = drmModeGetPropertyBlob(r->fd, id);
+	if (!blob)
+		return;
+
+	fprintf(r->f, "blob %u ", id);
+	for (i = 0; i < blob->length; i++)
+		fprintf(r->f, "%02x", ((const uint8_t *)blob->data)[i]);
+	fputc('\n', r->f);
+
+	drmModeFreePropertyBlob(blob);
+}
+
+static int record_props(struct recorder *r, uint32_t id, uint32_t type)
+{
+	drmModeObjectPropertiesPtr props;
+	uint32_t i;
+
+	props = drmModeObjectGetProperties(r->fd, id, type);
+	if (!props)
+		return -errno;
+
+	for (i = 0; i < props->count_props; i++) {
+		const drmModePropertyRes *prop;
+		uint64_t v = props->prop_values[i];
+
+		prop = igt_kms_prop_info(r->fd, props->props[i]);
+		if (!prop)
+			continue;
+
+		if (!written(r, prop->prop_id))
+			record_prop(r, prop);
+
+		if (prop->flags & DRM_MODE_PROP_BLOB && v && !written(r, v))
+			record_blob(r, v);
+
+		fprintf(r->f, "object-prop %u %u %" PRIu64 "\n",
+			id, prop->prop_id, v);
+	}
+
+	drmModeFreeObjectProperties(props);
+
+	return 0;
+}
+
+static int record_connector(struct recorder *r, uint32_t id)
+{
+	drmModeConnectorPtr connector;
+	int i;
+
+	connector = drmModeGetConnector(r->fd, id);
+	if (!connector)
+		return -errno;
+
+	fprintf(r->f, "connector %u %u %u %u %u %u %u\n",
+		connector->connector_id, connector->connector_type,
+		connector->connector_type_id, connector->connection,
+		connector->mmWidth, connector->mmHeight, connector->subpixel);
+
+	for (i = 0; i < connector->count_encoders; i++)
+		fprintf(r->f, "connector-encoder %u %u\n",
+			connector->connector_id, connector->encoders[i]);
+
+	for (i = 0; i < connector->count_modes; i++) {
+		const drmModeModeInfo *m = &connector->modes[i];
+
+		fprintf(r->f, "mode %u %u %u %u %u %u %u %u %u %u %u %u %u %u "
+			"%u %s\n",
+			connector->connector_id, m->clock,
+			m->hdisplay, m->hsync_start, m->hsync_end, m->htotal,
+			m->hskew, m->vdisplay, m->vsync_start, m->vsync_end,
+			m->vtotal, m->vscan, m->vrefresh, m->flags, m->type,
+			m->name);
+	}
+
+	drmModeFreeConnector(connector);
+
+	return record_props(r, id, DRM_MODE_OBJECT_CONNECTOR);
+}
+
+static int record_planes(struct recorder *r)
+{
+	drmModePlaneResPtr res;
+	uint32_t i, j;
+	int ret = 0;
+
+	res = drmModeGetPlaneResources(r->fd);
+	if (!res)
+		return -errno;
+
+	for (i = 0; !ret && i < res->count_planes; i++) {
+		drmModePlanePtr plane = drmModeGetPlane(r->fd, res->planes[i]);
+
+		if (!plane) {
+			ret = -errno;
+			break;
+		}
+
+		fprintf(r->f, "plane %u %u %u\n", plane->plane_id,
+			plane->possible_crtcs, plane->gamma_size);
+
+		fprintf(r->f, "plane-formats %u", plane->plane_id);
+		for (j = 0; j < plane->count_formats; j++)
+			fprintf(r->f, " %#x", plane->formats[j]);
+		fputc('\n', r->f);
+
+		drmModeFreePlane(plane);
+
+		ret = record_props(r, res->planes[i], DRM_MODE_OBJECT_PLANE);
+	}
+
+	drmModeFreePlaneResources(res);
+
+	return ret;
+}
+
+static int record(struct recorder *r)
+{
+	static const uint64_t client_caps[] = {
+		DRM_CLIENT_CAP_STEREO_3D,
+		DRM_CLIENT_CAP_UNIVERSAL_PLANES,
+		DRM_CLIENT_CAP_ATOMIC,
+		DRM_CLIENT_CAP_ASPECT_RATIO,
+		DRM_CLIENT_CAP_WRITEBACK_CONNECTORS,
+		DRM_CLIENT_CAP_CURSOR_PLANE_HOTSPOT,
+	};
+	drmVersionPtr version;
+	drmModeResPtr res;
+	unsigned int i;
+	uint64_t cap;
+	int ret = 0;
+
+	version = drmGetVersion(r->fd);
+	if (!version)
+		return errno ? -errno : -ENODEV;
+
+	fprintf(r->f, "%s\n", FAKE_HEADER);
+	/* A fake records the driver it was recorded from */
+	fprintf(r->f, "driver %d %d %d %s\n", version->version_major,
+		version->version_minor, version->version_patchlevel,
+		igt_kms_fake_owns(r->fd) ? version->desc : version->name);
+	drmFreeVersion(version);
+
+	/*
+	 * All that the device can expose is recorded, so the client caps
+	 * stay set, but for those that only change how modes are listed.
+	 */
+	for (i = 0; i < ARRAY_SIZE(client_caps); i++) {
+		if (drmSetClientCap(r->fd, client_caps[i], 1))
+			continue;
+
+		fprintf(r->f, "client-cap %" PRIu64 "\n", client_caps[i]);
+		if (client_caps[i] == DRM_CLIENT_CAP_STEREO_3D)
+			drmSetClientCap(r->fd, client_caps[i], 0);
+	}
+
+	for (i = DRM_CAP_DUMB_BUFFER; i <= DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP; i++)
+		if (!drmGetCap(r->fd, i, &cap))
+			fprintf(r->f, "cap %u %" PRIu64 "\n", i, cap);
+
+	res = drmModeGetResources(r->fd);
+	if (!res)
+		return -errno;
+
+	fprintf(r->f, "size %u %u %u %u\n", res->min_width, res->max_width,
+		res->min_height, res->max_height);
+
+	for (i = 0; !ret && i < res->count_crtcs; i++) {
+		drmModeCrtcPtr crtc = drmModeGetCrtc(r->fd, res->crtcs[i]);
+
+		if (!crtc) {
+			ret = -errno;
+			break;
+		}
+
+		fprintf(r->f, "crtc %u %u\n", crtc->crtc_id, crtc->gamma_size);
+		drmModeFreeCrtc(crtc);
+
+		ret = record_props(r, res->crtcs[i], DRM_MODE_OBJECT_CRTC);
+	}
+
+	for (i = 0; !ret && i < res->count_encoders; i++) {
+		drmModeEncoderPtr encoder;
+
+		encoder = drmModeGetEncoder(r->fd, res->encoders[i]);
+		if (!encoder) {
+			ret = -errno;
+			break;
+		}
+
+		fprintf(r->f, "encoder %u %u %u %u\n", encoder->encoder_id,
+			encoder->encoder_type, encoder->possible_crtcs,
+			encoder->possible_clones);
+		drmModeFreeEncoder(encoder);
+	}
+
+	for (i = 0; !ret && i < res->count_connectors; i++)
+		ret = record_connector(r, res->connectors[i]);
+
+	drmModeFreeResources(res);
+
+	if (!ret)
+		ret = record_planes(r);
+
+	return ret;
+}
+
+/**
+ * igt_kms_fake_record:
+ * @fd: DRM fd of a KMS device
+ * @filename: File to write the recording to
+ *
+ * Records the mode objects of the device, their properties and the blobs
+ * referred to, for igt_kms_fake_open(). Connectors are probed. All the
+ * client caps the device supports are set on @fd, but for
+ * DRM_CLIENT_CAP_STEREO_3D, so that all the objects are recorded.
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_kms_fake_record(int fd, const char *filename)
+{
+	struct recorder r = { .fd = fd };
+	int ret;
+
+	r.f = fopen(filename, "w");
+	if (!r.f)
+		return -errno;
+
+	r.written = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	ret = record(&r);
+	igt_map_destroy(r.written, free_written);
+
+	if (fclose(r.f) && !ret)
+		ret = -errno;
+
+	return ret;
+}
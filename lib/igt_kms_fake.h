@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_KMS_FAKE_H
+#define IGT_KMS_FAKE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * igt_kms_fake_opts:
+ * @commit_ns: Time taken by every commit that is not a test, in nanoseconds
+ * @vblank: Whether commits wait for the vblank of their crtcs, like a real
+ *	    device, rather than completing after @commit_ns
+ */
+struct igt_kms_fake_opts {
+	uint64_t commit_ns;
+	bool vblank;
+};
+
+/**
+ * igt_kms_fake_stats:
+ * @ioctls: Number of ioctls served
+ * @commits: Number of atomic and legacy commits applied
+ * @test_commits: Number of atomic commits only tested
+ * @failed: Number of ioctls that failed
+ */
+struct igt_kms_fake_stats {
+	uint64_t ioctls;
+	uint64_t commits;
+	uint64_t test_commits;
+	uint64_t failed;
+};
+
+int igt_kms_fake_record(int fd, const char *filename);
+int igt_kms_fake_open(const char *filename,
+		      const struct igt_kms_fake_opts *opts);
+void igt_kms_fake_close(int fd);
+bool igt_kms_fake_owns(int fd);
+void igt_kms_fake_get_stats(int fd, struct igt_kms_fake_stats *stats);
+
+int igt_kms_fake_ioctl(int fd, unsigned long request, void *arg);
+void *igt_kms_fake_mmap(void *addr, size_t length, int prot, int flags,
+			int fd, uint64_t offset);
+
+#endif /* IGT_KMS_FAKE_H */
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/*
+ * Linked whole into the programs using lib_igt_kms_fake, so that libdrm and
+ * libigt call the drmIoctl() and mmap() here, which pass the fds of the
+ * fakes to igt_kms_fake and the others on. drmWaitVBlank() is wrapped as
+ * well, since libdrm calls ioctl() directly for it.
+ */
+
+/* Both mmap() and mmap64() are defined, whatever the offsets of the build */
+#undef _FILE_OFFSET_BITS
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <xf86drm.h>
+
+#include "igt_kms_fake.h"
+
+static int (*libdrm_ioctl)(int fd, unsigned long request, void *arg);
+static int (*libdrm_wait_vblank)(int fd, drmVBlankPtr vbl);
+static void *(*libc_mmap)(void *addr, size_t length, int prot, int flags,
+			  int fd, off_t offset);
+static void *(*libc_mmap64)(void *addr, size_t length, int prot, int flags,
+			    int fd, off64_t offset);
+
+static void __attribute__ ((constructor))
+init(void)
+{
+	libdrm_ioctl = dlsym(RTLD_NEXT, "drmIoctl");
+	libdrm_wait_vblank = dlsym(RTLD_NEXT, "drmWaitVBlank");
+	libc_mmap = dlsym(RTLD_NEXT, "mmap");
+	libc_mmap64 = dlsym(RTLD_NEXT, "mmap64");
+
+	if (!libdrm_ioctl || !libdrm_wait_vblank || !libc_mmap ||
+	    !libc_mmap64) {
+		fprintf(stderr, "igt_kms_fake: failed to get libdrm or mmap\n");
+		abort();
+	}
+}
+
+int drmIoctl(int fd, unsigned long request, void *arg)
+{
+	if (igt_kms_fake_owns(fd))
+		return igt_kms_fake_ioctl(fd, request, arg);
+
+	return libdrm_ioctl(fd, request, arg);
+}
+
+int drmWaitVBlank(int fd, drmVBlankPtr vbl)
+{
+	if (igt_kms_fake_owns(fd))
+		return igt_kms_fake_ioctl(fd, DRM_IOCTL_WAIT_VBLANK, vbl);
+
+	return libdrm_wait_vblank(fd, vbl);
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd,
+	   off_t offset)
+{
+	/* Mappings made by other constructors, before ours */
+	if (!libc_mmap)
+		return mmap64(addr, length, prot, flags, fd, offset);
+
+	if (fd >= 0 && igt_kms_fake_owns(fd))
+		return igt_kms_fake_mmap(addr, length, prot, flags, fd,
+					 (uint64_t)offset);
+
+	return libc_mmap(addr, length, prot, flags, fd, offset);
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd,
+	     off64_t offset)
+{
+	if (!libc_mmap64)
+		libc_mmap64 = dlsym(RTLD_NEXT, "mmap64");
+
+	if (fd >= 0 && igt_kms_fake_owns(fd))
+		return igt_kms_fake_mmap(addr, length, prot, flags, fd,
+					 (uint64_t)offset);
+
+	return libc_mmap64(addr, length, prot, flags, fd, offset);
+}
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_kms_props
+ * @short_description: Cache of KMS property metadata
+ * @title: KMS properties
+ * @include: igt_kms_props.h
+ *
+ * Looking up the properties of a mode object by name takes a
+ * drmModeGetProperty() for every property of the object, two ioctls each,
+ * which adds up to thousands of ioctls to set up a display with a few pipes
+ * and dozens of planes. The metadata of the properties, their names, types,
+ * ranges and enums, never changes, so it is fetched once per device fd and
+ * kept in a hash table by property id.
+ *
+ * igt_kms_props_get() still fetches the property ids and current values of the
+ * object, with a single drmModeObjectGetProperties(), since the properties
+ * exposed depend on the client caps of the fd and objects come and go with
+ * hotplugs. For each object the names are indexed by a hash table, which is
+ * reused as long as the object keeps the same properties, so that
+ * igt_kms_props_find() does not need to compare names.
+ *
+ * Properties created along with an object, such as those of MST connectors,
+ * may be destroyed on hotplug and their ids reused, so igt_kms drops the cache
+ * with igt_kms_props_invalidate() whenever it sees a hotplug uevent. The cache
+ * of an fd is also dropped by igt_display_fini() and drm_close_driver(), as
+ * the fd number may be reused, and when the fd turns out to be of another
+ * device.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "igt_kms_props.h"
+#include "igt_list.h"
+#include "igt_map.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+struct kms_object_props {
+	uint32_t id;
+	uint32_t type;
+	unsigned int count;
+	uint32_t *ids;
+	const drmModePropertyRes **info;
+	struct igt_map *names; /* property name -> index + 1 */
+	unsigned int users; /* Properties handed out, under caches_mutex */
+	bool detached; /* No longer cached, freed by the last user */
+};
+
+struct kms_props_cache {
+	struct igt_list_head link;
+	int fd;
+	dev_t rdev;
+	struct igt_map *props; /* property id -> drmModePropertyPtr */
+	struct igt_map *objects; /* object id -> struct kms_object_props */
+};
+
+static IGT_LIST_HEAD(caches);
+static pthread_mutex_t caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hash_name(const void *key)
+{
+	const char *name = key;
+	uint32_t hash = FNV_OFFSET_BASIS;
+
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * FNV_PRIME;
+
+	return hash;
+}
+
+static int equal_names(const void *key1, const void *key2)
+{
+	return !strcmp(key1, key2);
+}
+
+static void free_prop(struct igt_map_entry *entry)
+{
+	drmModeFreeProperty(entry->data);
+}
+
+static void free_object(struct kms_object_props *object)
+{
+	igt_map_destroy(object->names, NULL);
+	free(object->ids);
+	free(object->info);
+	free(object);
+}
+
+/* Properties handed out before may still point to it. */
+static void release_object(struct kms_object_props *object)
+{
+	if (object->users)
+		object->detached = true;
+	else
+		free_object(object);
+}
+
+static void release_object_entry(struct igt_map_entry *entry)
+{
+	release_object(entry->data);
+}
+
+static void free_cache(struct kms_props_cache *cache)
+{
+	igt_map_destroy(cache->objects, release_object_entry);
+	igt_map_destroy(cache->props, free_prop);
+	igt_list_del(&cache->link);
+	free(cache);
+}
+
+/* Returns the cache of the fd, dropping any left from another device. */
+static struct kms_props_cache *get_cache(int fd)
+{
+	struct kms_props_cache *cache;
+	struct stat st;
+
+	if (fstat(fd, &st))
+		return NULL;
+
+	igt_list_for_each_entry(cache, &caches, link) {
+		if (cache->fd != fd)
+			continue;
+
+		if (cache->rdev == st.st_rdev)
+			return cache;
+
+		free_cache(cache);
+		break;
+	}
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->fd = fd;
+	cache->rdev = st.st_rdev;
+	cache->props = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	cache->objects = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	if (!cache->props || !cache->objects) {
+		igt_map_destroy(cache->props, NULL);
+		igt_map_destroy(cache->objects, NULL);
+		free(cache);
+		return NULL;
+	}
+
+	igt_list_add(&cache->link, &caches);
+
+	return cache;
+}
+
+static const drmModePropertyRes *
+get_info(struct kms_props_cache *cache, uint32_t prop_id)
+{
+	drmModePropertyPtr prop;
+
+	prop = igt_map_search(cache->props, &prop_id);
+	if (prop)
+		return prop;
+
+	prop = drmModeGetProperty(cache->fd, prop_id);
+	if (prop)
+		igt_map_insert(cache->props, &prop->prop_id, prop);
+
+	return prop;
+}
+
+static bool object_matches(const struct kms_object_props *object,
+			   uint32_t type, drmModeObjectPropertiesPtr list)
+{
+	return object->type == type &&
+	       object->count == list->count_props &&
+	       !memcmp(object->ids, list->props,
+		       list->count_props * sizeof(*list->props));
+}
+
+static struct kms_object_props *
+create_object(struct kms_props_cache *cache, uint32_t id, uint32_t type,
+	      drmModeObjectPropertiesPtr list)
+{
+	struct kms_object_props *object;
+	unsigned int i;
+
+	object = calloc(1, sizeof(*object));
+	if (!object)
+		return NULL;
+
+	object->id = id;
+	object->type = type;
+	object->count = list->count_props;
+	object->ids = calloc(object->count + 1, sizeof(*object->ids));
+	object->info = calloc(object->count + 1, sizeof(*object->info));
+	object->names = igt_map_create(hash_name, equal_names);
+	if (!object->ids || !object->info || !object->names) {
+		free_object(object);
+		return NULL;
+	}
+
+	for (i = 0; i < object->count; i++) {
+		const drmModePropertyRes *info;
+
+		object->ids[i] = list->props[i];
+
+		/* Not cached, the next lookup tries again */
+		info = get_info(cache, list->props[i]);
+		if (!info)
+			continue;
+
+		object->info[i] = info;
+		if (!igt_map_search(object->names, info->name))
+			igt_map_insert(object->names, info->name,
+				       (void *)(uintptr_t)(i + 1));
+	}
+
+	return object;
+}
+
+/*
+ * Returns the cached properties of the object, refreshed if they are not
+ * the ones listed now.
+ */
+static struct kms_object_props *
+get_object(struct kms_props_cache *cache, uint32_t id, uint32_t type,
+	   drmModeObjectPropertiesPtr list)
+{
+	struct kms_object_props *object, *old;
+	unsigned int i;
+
+	old = igt_map_search(cache->objects, &id);
+	if (old && object_matches(old, type, list)) {
+		for (i = 0; i < old->count; i++)
+			if (!old->info[i])
+				break;
+		if (i == old->count)
+			return old;
+	}
+
+	object = create_object(cache, id, type, list);
+	if (!object)
+		return NULL;
+
+	if (old) {
+		igt_map_remove(cache->objects, &id, NULL);
+		release_object(old);
+	}
+	igt_map_insert(cache->objects, &object->id, object);
+
+	return object;
+}
+
+/**
+ * igt_kms_props_get:
+ * @fd: DRM fd
+ * @object_id: Mode object to get the properties of
+ * @object_type: Type of the object, DRM_MODE_OBJECT_*
+ *
+ * Gets the properties of the object along with their current values, with a
+ * single drmModeObjectGetProperties(). The metadata of the properties comes
+ * from the cache of the fd, only new properties are queried.
+ *
+ * Returns: The properties, to be released with igt_kms_props_put(), or NULL
+ * if they could not be fetched.
+ */
+struct igt_kms_props *igt_kms_props_get(int fd, uint32_t object_id,
+					uint32_t object_type)
+{
+	struct kms_object_props *object = NULL;
+	drmModeObjectPropertiesPtr list;
+	struct kms_props_cache *cache;
+	struct igt_kms_props *props;
+
+	list = drmModeObjectGetProperties(fd, object_id, object_type);
+	if (!list)
+		return NULL;
+
+	props = calloc(1, sizeof(*props));
+	if (!props) {
+		drmModeFreeObjectProperties(list);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&caches_mutex);
+	cache = get_cache(fd);
+	if (cache)
+		object = get_object(cache, object_id, object_type, list);
+	if (object)
+		object->users++;
+	pthread_mutex_unlock(&caches_mutex);
+
+	if (!object) {
+		drmModeFreeObjectProperties(list);
+		free(props);
+		return NULL;
+	}
+
+	props->object_id = object_id;
+	props->object_type = object_type;
+	props->count = list->count_props;
+	props->ids = list->props;
+	props->values = list->prop_values;
+	props->info = object->info;
+	props->list = list;
+	props->object = object;
+
+	return props;
+}
+
+/**
+ * igt_kms_props_put:
+ * @props: Properties from igt_kms_props_get()
+ *
+ * Releases the properties. Their metadata stays cached.
+ */
+void igt_kms_props_put(struct igt_kms_props *props)
+{
+	if (!props)
+		return;
+
+	pthread_mutex_lock(&caches_mutex);
+	if (!--props->object->users && props->object->detached)
+		free_object(props->object);
+	pthread_mutex_unlock(&caches_mutex);
+
+	drmModeFreeObjectProperties(props->list);
+	free(props);
+}
+
+/**
+ * igt_kms_props_find:
+ * @props: Properties from igt_kms_props_get()
+ * @name: Name of the property
+ *
+ * Looks up the property of the given name, without comparing it to the names
+ * of all the properties of the object.
+ *
+ * Returns: The index of the property in @props, or -1 if the object has no
+ * such property.
+ */
+int igt_kms_props_find(const struct igt_kms_props *props, const char *name)
+{
+	uintptr_t idx;
+
+	idx = (uintptr_t)igt_map_search(props->object->names, name);
+
+	return (int)idx - 1;
+}
+
+/**
+ * igt_kms_prop_info:
+ * @fd: DRM fd
+ * @prop_id: Property id
+ *
+ * Gets the metadata of a property, from the cache of the fd or queried once
+ * with drmModeGetProperty(). It stays valid until the cache is invalidated and
+ * must not be freed.
+ *
+ * Returns: The metadata of the property, or NULL if there is no such property.
+ */
+const drmModePropertyRes *igt_kms_prop_info(int fd, uint32_t prop_id)
+{
+	const drmModePropertyRes *info = NULL;
+	struct kms_props_cache *cache;
+
+	pthread_mutex_lock(&caches_mutex);
+	cache = get_cache(fd);
+	if (cache)
+		info = get_info(cache, prop_id);
+	pthread_mutex_unlock(&caches_mutex);
+
+	return info;
+}
+
+/**
+ * igt_kms_props_invalidate:
+ * @fd: DRM fd, or -1 for all of them
+ *
+ * Drops the cached metadata of the properties of the fd, which is fetched
+ * again as needed. All the metadata and properties handed out before become
+ * invalid, the properties still need to be released with igt_kms_props_put().
+ */
+void igt_kms_props_invalidate(int fd)
+{
+	struct kms_props_cache *cache, *tmp;
+
+	pthread_mutex_lock(&caches_mutex);
+	igt_list_for_each_entry_safe(cache, tmp, &caches, link)
+		if (fd < 0 || cache->fd == fd)
+			free_cache(cache);
+	pthread_mutex_unlock(&caches_mutex);
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_KMS_PROPS_H
+#define IGT_KMS_PROPS_H
+
+#include <stdint.h>
+#include <xf86drmMode.h>
+
+struct kms_object_props;
+
+/**
+ * igt_kms_props:
+ * @object_id: Object the properties are of
+ * @object_type: Type of the object, DRM_MODE_OBJECT_*
+ * @count: Number of properties
+ * @ids: Property ids, in the order of the kernel
+ * @values: Current values of the properties
+ * @info: Cached metadata of the properties, such as their names, types and
+ *	  enums, which must not be freed
+ */
+struct igt_kms_props {
+	uint32_t object_id;
+	uint32_t object_type;
+	unsigned int count;
+	uint32_t *ids;
+	uint64_t *values;
+	const drmModePropertyRes * const *info;
+
+	/*< private >*/
+	drmModeObjectPropertiesPtr list;
+	struct kms_object_props *object;
+};
+
+struct igt_kms_props *igt_kms_props_get(int fd, uint32_t object_id,
+					uint32_t object_type);
+void igt_kms_props_put(struct igt_kms_props *props);
+int igt_kms_props_find(const struct igt_kms_props *props, const char *name);
+const drmModePropertyRes *igt_kms_prop_info(int fd, uint32_t prop_id);
+void igt_kms_props_invalidate(int fd);
+
+#endif /* IGT_KMS_PROPS_H */
@@ -0,0 +1,482 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_perf_sampler
+ * @short_description: Periodic sampling of perf counter groups
+ * @title: Perf sampler
+ * @include: igt_perf_sampler.h
+ *
+ * Reads one or more perf event groups, as opened by igt_perf_open_group(),
+ * on a fixed period from a dedicated thread. The period is driven by a
+ * timerfd armed with absolute deadlines, so sampling neither drifts with the
+ * time it takes to render the previous sample nor with scheduling delays, and
+ * ticks which could not be serviced in time are reported rather than
+ * silently stretching the period.
+ *
+ * Samples are kept in an igt_seqlock ring the consumer reads without taking
+ * any lock. When the groups are opened with PERF_FORMAT_TOTAL_TIME_RUNNING
+ * the values are scaled for the time the counters were multiplexed out.
+ *
+ * Any file descriptor returning records in the group read format works, which
+ * allows testing with a pipe instead of real counters.
+ */
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_perf_sampler.h"
+#include "igt_seqlock.h"
+
+#define MAX_GROUPS 8
+
+struct sampler_group {
+	int fd;
+	unsigned int num;
+	uint64_t read_format;
+	size_t len; /* Of one group read. */
+};
+
+struct igt_perf_sampler {
+	uint64_t period_ns;
+
+	struct sampler_group groups[MAX_GROUPS];
+	unsigned int num_groups;
+	unsigned int num_values;
+	uint64_t *buf; /* Raw group read. */
+	struct igt_perf_sample *next; /* Sample being assembled. */
+
+	struct igt_seqlock_ring ring;
+	uint64_t head; /* Number of samples published. */
+	int error; /* Negative errno which stopped the sampling thread. */
+
+	uint64_t start; /* Deadline of the first sample. */
+	uint64_t ticks;
+
+	int timer_fd;
+	int stop_fd;
+	int ready_fd;
+	pthread_t thread;
+	bool running;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void notify(int fd)
+{
+	const uint64_t one = 1;
+
+	/* Only fails once the counter saturates, it then still polls readable. */
+	if (write(fd, &one, sizeof(one)) != sizeof(one))
+		return;
+}
+
+/**
+ * igt_perf_sampler_create:
+ * @period_ns: Sampling period
+ * @history: Number of samples kept in the ring
+ *
+ * Returns a sampler to add groups to with igt_perf_sampler_add_group(), or
+ * NULL with errno set.
+ */
+struct igt_perf_sampler *igt_perf_sampler_create(uint64_t period_ns,
+						 unsigned int history)
+{
+	struct igt_perf_sampler *s;
+
+	if (!period_ns || history < 2) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->period_ns = period_ns;
+	s->ring.history = history;
+	s->ring.head = &s->head;
+	s->timer_fd = -1;
+	s->stop_fd = -1;
+	s->ready_fd = -1;
+
+	return s;
+}
+
+/**
+ * igt_perf_sampler_add_group:
+ * @s: Sampler which was not started yet
+ * @fd: Group leader, or anything returning records in its format
+ * @num: Number of counters in the group
+ * @read_format: PERF_FORMAT_ flags the group was opened with
+ *
+ * The counters of the group land in igt_perf_sample.val in the order groups
+ * are added. Only the first group provides igt_perf_sample.timestamp.
+ *
+ * Returns the index of the first counter of the group in
+ * igt_perf_sample.val, or a negative errno.
+ */
+int igt_perf_sampler_add_group(struct igt_perf_sampler *s, int fd,
+			       unsigned int num, uint64_t read_format)
+{
+	struct sampler_group *g;
+	int base = s->num_values;
+
+	if (s->running || s->num_groups == MAX_GROUPS || !num)
+		return -EINVAL;
+
+	if (!(read_format & PERF_FORMAT_GROUP) ||
+	    read_format & ~(PERF_FORMAT_GROUP |
+			    PERF_FORMAT_TOTAL_TIME_ENABLED |
+			    PERF_FORMAT_TOTAL_TIME_RUNNING))
+		return -EINVAL;
+
+	g = &s->groups[s->num_groups++];
+	g->fd = fd;
+	g->num = num;
+	g->read_format = read_format;
+	g->len = (1 + num +
+		  !!(read_format & PERF_FORMAT_TOTAL_TIME_ENABLED) +
+		  !!(read_format & PERF_FORMAT_TOTAL_TIME_RUNNING)) *
+		 sizeof(uint64_t);
+
+	s->num_values += num;
+
+	return base;
+}
+
+static uint64_t scale(uint64_t val, uint64_t enabled, uint64_t running)
+{
+	if (!running || running >= enabled)
+		return val;
+
+	return (unsigned __int128)val * enabled / running;
+}
+
+/* Reads all groups into s->next. */
+static int read_groups(struct igt_perf_sampler *s)
+{
+	uint64_t *val = s->next->val;
+	unsigned int i, j;
+
+	for (i = 0; i < s->num_groups; i++) {
+		const struct sampler_group *g = &s->groups[i];
+		uint64_t enabled = 0, running = 0;
+		const uint64_t *p = s->buf;
+		ssize_t len;
+
+		len = read(g->fd, s->buf, g->len);
+		if (len < 0)
+			return -errno;
+		if (len != g->len || s->buf[0] != g->num)
+			return -EIO;
+
+		p++;
+		if (g->read_format & PERF_FORMAT_TOTAL_TIME_ENABLED)
+			enabled = *p++;
+		if (g->read_format & PERF_FORMAT_TOTAL_TIME_RUNNING)
+			running = *p++;
+
+		if (i == 0)
+			s->next->timestamp = enabled;
+
+		for (j = 0; j < g->num; j++)
+			*val++ = scale(p[j], enabled, running);
+	}
+
+	return 0;
+}
+
+static void publish(struct igt_perf_sampler *s)
+{
+	memcpy(igt_seqlock_ring_begin(&s->ring), s->next,
+	       sizeof(*s->next) + s->num_values * sizeof(s->next->val[0]));
+	igt_seqlock_ring_commit(&s->ring);
+
+	notify(s->ready_fd);
+}
+
+static int take_sample(struct igt_perf_sampler *s, uint64_t deadline,
+		       uint64_t missed)
+{
+	int err;
+
+	err = read_groups(s);
+	if (err)
+		return err;
+
+	s->next->index = s->head;
+	s->next->deadline = deadline;
+	s->next->read_time = now_ns();
+	s->next->missed = missed;
+
+	publish(s);
+
+	return 0;
+}
+
+static void *sampler_thread(void *data)
+{
+	struct igt_perf_sampler *s = data;
+	int err = 0;
+
+	while (!err) {
+		struct pollfd pfd[2] = {
+			{ .fd = s->timer_fd, .events = POLLIN },
+			{ .fd = s->stop_fd, .events = POLLIN },
+		};
+		uint64_t expirations;
+
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno != EINTR)
+				err = -errno;
+			continue;
+		}
+
+		if (pfd[1].revents)
+			break;
+
+		if (read(s->timer_fd, &expirations, sizeof(expirations)) !=
+		    sizeof(expirations) || !expirations)
+			continue;
+
+		s->ticks += expirations;
+		err = take_sample(s, s->start + s->ticks * s->period_ns,
+				  expirations - 1);
+	}
+
+	if (err) {
+		__atomic_store_n(&s->error, err, __ATOMIC_RELEASE);
+		notify(s->ready_fd);
+	}
+
+	return NULL;
+}
+
+/**
+ * igt_perf_sampler_start:
+ * @s: Sampler with at least one group
+ *
+ * Takes the first sample right away and then one every period from a new
+ * thread, which has all signals blocked.
+ *
+ * Returns 0 or a negative errno.
+ */
+int igt_perf_sampler_start(struct igt_perf_sampler *s)
+{
+	struct itimerspec its = { };
+	sigset_t all, old;
+	size_t buf_len = 0;
+	unsigned int i;
+	int err;
+
+	if (s->running || !s->num_groups)
+		return -EINVAL;
+
+	for (i = 0; i < s->num_groups; i++)
+		if (s->groups[i].len > buf_len)
+			buf_len = s->groups[i].len;
+
+	s->ring.slot_size = sizeof(uint64_t) + sizeof(struct igt_perf_sample) +
+			    s->num_values * sizeof(uint64_t);
+	s->ring.slots = calloc(s->ring.history, s->ring.slot_size);
+	s->buf = malloc(buf_len);
+	s->next = igt_perf_sampler_alloc_sample(s);
+	if (!s->ring.slots || !s->buf || !s->next)
+		return -ENOMEM;
+	s->next->num_values = s->num_values;
+
+	s->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+				     TFD_NONBLOCK | TFD_CLOEXEC);
+	s->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	s->ready_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (s->timer_fd < 0 || s->stop_fd < 0 || s->ready_fd < 0)
+		return -errno;
+
+	s->start = now_ns();
+	err = take_sample(s, s->start, 0);
+	if (err)
+		return err;
+
+	its.it_value.tv_sec = (s->start + s->period_ns) / 1000000000ull;
+	its.it_value.tv_nsec = (s->start + s->period_ns) % 1000000000ull;
+	its.it_interval.tv_sec = s->period_ns / 1000000000ull;
+	its.it_interval.tv_nsec = s->period_ns % 1000000000ull;
+	if (timerfd_settime(s->timer_fd, TFD_TIMER_ABSTIME, &its, NULL))
+		return -errno;
+
+	/* Signals are for the consumer, not for the sampling thread. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&s->thread, NULL, sampler_thread, s);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err)
+		return -err;
+
+	s->running = true;
+
+	return 0;
+}
+
+/**
+ * igt_perf_sampler_poll_fd:
+ * @s: Started sampler
+ *
+ * Returns a file descriptor which polls readable once a sample was published
+ * since igt_perf_sampler_wait() last returned, or the sampler failed.
+ */
+int igt_perf_sampler_poll_fd(const struct igt_perf_sampler *s)
+{
+	return s->ready_fd;
+}
+
+/**
+ * igt_perf_sampler_latest:
+ * @s: Started sampler
+ *
+ * Returns the index of the latest sample, -1 if there is none.
+ */
+int64_t igt_perf_sampler_latest(const struct igt_perf_sampler *s)
+{
+	return igt_seqlock_ring_latest(&s->ring);
+}
+
+/**
+ * igt_perf_sampler_wait:
+ * @s: Started sampler
+ * @after: Index of the last sample consumed, -1 for none
+ * @timeout_ms: As for poll()
+ *
+ * Waits for a sample newer than @after.
+ *
+ * Returns the index of the latest sample, -ETIMEDOUT, -EINTR when a signal
+ * arrived, or the error which stopped the sampler.
+ */
+int64_t igt_perf_sampler_wait(struct igt_perf_sampler *s, int64_t after,
+			      int timeout_ms)
+{
+	struct pollfd pfd = { .fd = s->ready_fd, .events = POLLIN };
+	uint64_t count;
+	int64_t latest;
+	int ret;
+
+	for (;;) {
+		latest = igt_perf_sampler_latest(s);
+		if (latest > after)
+			return latest;
+
+		ret = __atomic_load_n(&s->error, __ATOMIC_ACQUIRE);
+		if (ret)
+			return ret;
+
+		ret = poll(&pfd, 1, timeout_ms);
+		if (ret < 0)
+			return -errno;
+		if (!ret)
+			return -ETIMEDOUT;
+
+		/* Failing means someone else drained it, recheck anyway. */
+		ret = read(s->ready_fd, &count, sizeof(count));
+	}
+}
+
+/**
+ * igt_perf_sampler_alloc_sample:
+ * @s: Sampler with all groups added
+ *
+ * Returns a sample large enough for igt_perf_sampler_read(), to be released
+ * with free().
+ */
+struct igt_perf_sample *igt_perf_sampler_alloc_sample(const struct igt_perf_sampler *s)
+{
+	return calloc(1, sizeof(struct igt_perf_sample) +
+			 s->num_values * sizeof(uint64_t));
+}
+
+/**
+ * igt_perf_sampler_read:
+ * @s: Started sampler
+ * @index: Sample to read
+ * @sample: From igt_perf_sampler_alloc_sample()
+ *
+ * Copies out a consistent sample, without ever blocking the sampler.
+ *
+ * Returns 0 on success, -EAGAIN if the sample was not taken yet and -ENODATA
+ * if it was already overwritten.
+ */
+int igt_perf_sampler_read(const struct igt_perf_sampler *s, uint64_t index,
+			  struct igt_perf_sample *sample)
+{
+	int ret;
+
+	ret = igt_seqlock_ring_read(&s->ring, index, sample,
+				    sizeof(*sample) +
+				    s->num_values * sizeof(sample->val[0]),
+				    NULL);
+	if (!ret && sample->index != index)
+		ret = -ENODATA;
+
+	return ret;
+}
+
+/**
+ * igt_perf_sampler_stop:
+ * @s: Sampler
+ *
+ * Stops sampling, samples taken so far can still be read.
+ */
+void igt_perf_sampler_stop(struct igt_perf_sampler *s)
+{
+	if (!s->running)
+		return;
+
+	notify(s->stop_fd);
+	pthread_join(s->thread, NULL);
+
+	s->running = false;
+}
+
+/**
+ * igt_perf_sampler_destroy:
+ * @s: Sampler
+ *
+ * Stops and frees the sampler. The group file descriptors stay open.
+ */
+void igt_perf_sampler_destroy(struct igt_perf_sampler *s)
+{
+	if (!s)
+		return;
+
+	igt_perf_sampler_stop(s);
+
+	if (s->timer_fd >= 0)
+		close(s->timer_fd);
+	if (s->stop_fd >= 0)
+		close(s->stop_fd);
+	if (s->ready_fd >= 0)
+		close(s->ready_fd);
+
+	free(s->next);
+	free(s->buf);
+	free(s->ring.slots);
+	free(s);
+}
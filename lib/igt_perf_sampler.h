@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_PERF_SAMPLER_H
+#define IGT_PERF_SAMPLER_H
+
+#include <stdint.h>
+
+struct igt_perf_sampler;
+
+/**
+ * igt_perf_sample:
+ * @index: number of samples taken before this one
+ * @deadline: CLOCK_MONOTONIC time the sample was due, ns
+ * @read_time: CLOCK_MONOTONIC time once all groups were read, ns
+ * @missed: timer ticks skipped right before this sample
+ * @timestamp: time enabled of the first group, ns
+ * @num_values: number of entries in @val
+ * @val: counter values of all groups, in the order they were added, scaled
+ *	for the time the counters were not scheduled
+ */
+struct igt_perf_sample {
+	uint64_t index;
+	uint64_t deadline;
+	uint64_t read_time;
+	uint64_t missed;
+	uint64_t timestamp;
+	uint32_t num_values;
+	uint32_t pad;
+	uint64_t val[];
+};
+
+struct igt_perf_sampler *igt_perf_sampler_create(uint64_t period_ns,
+						 unsigned int history);
+int igt_perf_sampler_add_group(struct igt_perf_sampler *s, int fd,
+			       unsigned int num, uint64_t read_format);
+int igt_perf_sampler_start(struct igt_perf_sampler *s);
+int igt_perf_sampler_poll_fd(const struct igt_perf_sampler *s);
+int64_t igt_perf_sampler_latest(const struct igt_perf_sampler *s);
+int64_t igt_perf_sampler_wait(struct igt_perf_sampler *s, int64_t after,
+			      int timeout_ms);
+struct igt_perf_sample *igt_perf_sampler_alloc_sample(const struct igt_perf_sampler *s);
+int igt_perf_sampler_read(const struct igt_perf_sampler *s, uint64_t index,
+			  struct igt_perf_sample *sample);
+void igt_perf_sampler_stop(struct igt_perf_sampler *s);
+void igt_perf_sampler_destroy(struct igt_perf_sampler *s);
+
+#endif /* IGT_PERF_SAMPLER_H */
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_seqlock
+ * @short_description: Lockless ring of fixed size slots
+ * @title: Seqlock ring
+ * @include: igt_seqlock.h
+ *
+ * A single writer publishes payloads into a ring of slots which any number
+ * of readers copy out without taking any lock. Each slot is protected by a
+ * sequence count which is odd while the slot is being written, and readers
+ * retry when it moved under them, so neither side ever blocks the other.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+
+#include "igt_seqlock.h"
+
+/* Give up on a slot the writer keeps rewriting under us. */
+#define READ_RETRIES 1000
+
+static uint64_t *slot_seq(const struct igt_seqlock_ring *r, uint64_t index)
+{
+	return (uint64_t *)((char *)r->slots +
+			    (index % r->history) * r->slot_size);
+}
+
+/**
+ * igt_seqlock_ring_begin:
+ * @r: Ring
+ *
+ * Starts writing the next payload. Only one writer may use the ring.
+ *
+ * Returns the payload of the slot, to fill in before igt_seqlock_ring_commit().
+ */
+void *igt_seqlock_ring_begin(const struct igt_seqlock_ring *r)
+{
+	uint64_t *seq = slot_seq(r, *r->head);
+
+	__atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	return seq + 1;
+}
+
+/**
+ * igt_seqlock_ring_commit:
+ * @r: Ring
+ *
+ * Publishes the payload started by igt_seqlock_ring_begin() as the latest one.
+ */
+void igt_seqlock_ring_commit(const struct igt_seqlock_ring *r)
+{
+	uint64_t *seq = slot_seq(r, *r->head);
+
+	__atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(r->head, *r->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * igt_seqlock_ring_latest:
+ * @r: Ring
+ *
+ * Returns the index of the latest published payload, or -1 if there is none
+ * yet.
+ */
+int64_t igt_seqlock_ring_latest(const struct igt_seqlock_ring *r)
+{
+	return (int64_t)__atomic_load_n(r->head, __ATOMIC_ACQUIRE) - 1;
+}
+
+/**
+ * igt_seqlock_ring_read:
+ * @r: Ring
+ * @index: Payload to read
+ * @dst: Where to copy the payload
+ * @len: Bytes to copy
+ * @copy: Copies @len bytes of a payload which may change under it, or NULL
+ *	for memcpy()
+ *
+ * Copies out a consistent payload. The slot may have been rewritten with a
+ * newer payload between looking at the head and reading it, so callers need
+ * to store the index in the payload and check it.
+ *
+ * Returns 0 on success, -EAGAIN if the payload was not published yet and
+ * -ENODATA if it was already overwritten.
+ */
+int igt_seqlock_ring_read(const struct igt_seqlock_ring *r, uint64_t index,
+			  void *dst, size_t len, igt_seqlock_copy_t copy)
+{
+	uint64_t head = __atomic_load_n(r->head, __ATOMIC_ACQUIRE);
+	const uint64_t *seqp = slot_seq(r, index);
+
+	if (index >= head)
+		return -EAGAIN;
+	if (head - index > r->history)
+		return -ENODATA;
+
+	for (int i = 0; i < READ_RETRIES; i++) {
+		uint64_t seq = __atomic_load_n(seqp, __ATOMIC_ACQUIRE);
+
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		if (copy)
+			copy(dst, seqp + 1, len);
+		else
+			memcpy(dst, seqp + 1, len);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(seqp, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+
+	return -ENODATA;
+}
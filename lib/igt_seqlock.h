@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_SEQLOCK_H
+#define IGT_SEQLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * igt_seqlock_ring:
+ * @slots: First slot, each one starting with its uint64_t sequence count
+ *	directly followed by the payload
+ * @slot_size: Size of a slot, sequence count included
+ * @history: Number of slots
+ * @head: Number of payloads published
+ *
+ * Describes a ring living in memory owned by the caller, like a shared
+ * memory segment, so the same ring can be described in every process
+ * mapping it.
+ */
+struct igt_seqlock_ring {
+	void *slots;
+	size_t slot_size;
+	unsigned int history;
+	uint64_t *head;
+};
+
+typedef void (*igt_seqlock_copy_t)(void *dst, const void *src, size_t len);
+
+void *igt_seqlock_ring_begin(const struct igt_seqlock_ring *r);
+void igt_seqlock_ring_commit(const struct igt_seqlock_ring *r);
+int64_t igt_seqlock_ring_latest(const struct igt_seqlock_ring *r);
+int igt_seqlock_ring_read(const struct igt_seqlock_ring *r, uint64_t index,
+			  void *dst, size_t len, igt_seqlock_copy_t copy);
+
+#endif /* IGT_SEQLOCK_H */
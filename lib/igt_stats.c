@@ -64,6 +64,9 @@
  *
  *	igt_stats_fini(&stats);
  * ]|
+ *
+ * Where too many samples are taken to keep them all, struct igt_histogram
+ * still gives their percentiles, at a fixed relative precision.
  */
 
 static unsigned int get_new_capacity(int need)
@@ -671,3 +674,202 @@ double igt_mean_get_variance(struct igt_mean *m)
 	return m->sq / m->count;
 }
 
+
+/*
+ * Values below 2^(precision + 1) get a bucket each, above that every power
+ * of two is split into 2^precision buckets.
+ */
+static unsigned int histogram_bucket(const struct igt_histogram *h,
+				     uint64_t v)
+{
+	unsigned int shift;
+
+	if (v >> (h->precision + 1) == 0)
+		return v;
+
+	shift = 63 - __builtin_clzll(v) - h->precision;
+
+	return (shift << h->precision) + (v >> shift);
+}
+
+/* Highest value falling into the bucket. */
+static uint64_t histogram_bucket_value(const struct igt_histogram *h,
+				       unsigned int bucket)
+{
+	unsigned int shift;
+
+	if (bucket >> (h->precision + 1) == 0)
+		return bucket;
+
+	shift = (bucket >> h->precision) - 1;
+
+	return ((uint64_t)(bucket - (shift << h->precision)) << shift) +
+	       (1ull << shift) - 1;
+}
+
+/**
+ * igt_histogram_init:
+ * @h: histogram
+ * @precision: Number of buckets per power of two, as a power of two
+ * @limit: Largest value to tell apart, larger ones are counted as @limit
+ *
+ * Initializes @h. Samples are kept with a relative error below
+ * 2^-@precision, 7 being good for about two significant digits.
+ */
+void igt_histogram_init(struct igt_histogram *h, unsigned int precision,
+			uint64_t limit)
+{
+	igt_assert(precision < 32);
+
+	memset(h, 0, sizeof(*h));
+	h->precision = precision;
+	h->limit = limit;
+	h->min = U64_MAX;
+	h->nr_buckets = histogram_bucket(h, limit) + 1;
+	h->buckets = calloc(h->nr_buckets, sizeof(*h->buckets));
+	igt_assert(h->buckets);
+}
+
+/**
+ * igt_histogram_fini:
+ * @h: histogram
+ *
+ * Frees resources allocated in igt_histogram_init().
+ */
+void igt_histogram_fini(struct igt_histogram *h)
+{
+	free(h->buckets);
+	h->buckets = NULL;
+}
+
+/**
+ * igt_histogram_add:
+ * @h: histogram
+ * @v: value
+ *
+ * Adds a new value @v to @h.
+ */
+void igt_histogram_add(struct igt_histogram *h, uint64_t v)
+{
+	if (v > h->limit)
+		v = h->limit;
+
+	h->buckets[histogram_bucket(h, v)]++;
+	h->count++;
+	h->sum += v;
+	if (v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+}
+
+/**
+ * igt_histogram_merge:
+ * @dst: histogram to add to
+ * @src: histogram to add
+ *
+ * Adds all the samples of @src to @dst.
+ *
+ * Returns: false if the two were not initialized with the same precision and
+ * limit, leaving @dst untouched.
+ */
+bool igt_histogram_merge(struct igt_histogram *dst,
+			 const struct igt_histogram *src)
+{
+	unsigned int i;
+
+	if (dst->precision != src->precision || dst->limit != src->limit)
+		return false;
+
+	for (i = 0; i < dst->nr_buckets; i++)
+		dst->buckets[i] += src->buckets[i];
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+
+	return true;
+}
+
+/**
+ * igt_histogram_get_count:
+ * @h: histogram
+ *
+ * Returns the number of samples in @h.
+ */
+uint64_t igt_histogram_get_count(const struct igt_histogram *h)
+{
+	return h->count;
+}
+
+/**
+ * igt_histogram_get_min:
+ * @h: histogram
+ *
+ * Returns the smallest sample in @h, or 0 if it is empty.
+ */
+uint64_t igt_histogram_get_min(const struct igt_histogram *h)
+{
+	return h->count ? h->min : 0;
+}
+
+/**
+ * igt_histogram_get_max:
+ * @h: histogram
+ *
+ * Returns the largest sample in @h.
+ */
+uint64_t igt_histogram_get_max(const struct igt_histogram *h)
+{
+	return h->max;
+}
+
+/**
+ * igt_histogram_get_mean:
+ * @h: histogram
+ *
+ * Returns the exact mean of the samples in @h.
+ */
+double igt_histogram_get_mean(const struct igt_histogram *h)
+{
+	return h->count ? h->sum / h->count : 0;
+}
+
+/**
+ * igt_histogram_get_percentile:
+ * @h: histogram
+ * @percentile: 0 to 100
+ *
+ * Returns the value which @percentile percent of the samples in @h do not
+ * exceed, within the precision of @h.
+ */
+uint64_t igt_histogram_get_percentile(const struct igt_histogram *h,
+				      double percentile)
+{
+	uint64_t rank, seen = 0, value;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+
+	rank = ceil(percentile / 100 * h->count);
+	if (rank < 1)
+		rank = 1;
+
+	for (i = 0; i < h->nr_buckets; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	value = histogram_bucket_value(h, i);
+	if (value > h->max)
+		value = h->max;
+	if (value < h->min)
+		value = h->min;
+
+	return value;
+}
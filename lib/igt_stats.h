@@ -101,4 +101,34 @@ void igt_mean_add(struct igt_mean *m, double v);
 double igt_mean_get(struct igt_mean *m);
 double igt_mean_get_variance(struct igt_mean *m);
 
+/**
+ * igt_histogram:
+ *
+ * Log-linear histogram of integer samples, in the manner of a HDR histogram,
+ * with a fixed memory footprint and constant cost to add a sample. Needs to
+ * be initialized with igt_histogram_init().
+ */
+struct igt_histogram {
+	/*< private >*/
+	unsigned int precision;
+	unsigned int nr_buckets;
+	uint64_t *buckets;
+	uint64_t limit;
+	uint64_t count, min, max;
+	double sum;
+};
+
+void igt_histogram_init(struct igt_histogram *h, unsigned int precision,
+			uint64_t limit);
+void igt_histogram_fini(struct igt_histogram *h);
+void igt_histogram_add(struct igt_histogram *h, uint64_t v);
+bool igt_histogram_merge(struct igt_histogram *dst,
+			 const struct igt_histogram *src);
+uint64_t igt_histogram_get_count(const struct igt_histogram *h);
+uint64_t igt_histogram_get_min(const struct igt_histogram *h);
+uint64_t igt_histogram_get_max(const struct igt_histogram *h);
+double igt_histogram_get_mean(const struct igt_histogram *h);
+uint64_t igt_histogram_get_percentile(const struct igt_histogram *h,
+				      double percentile);
+
 #endif /* __IGT_STATS_H__ */
@@ -0,0 +1,730 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_stream_capture
+ * @short_description: Capture of perf record streams to disk or memory
+ * @title: Stream capture
+ * @include: igt_stream_capture.h
+ *
+ * Moves the records read from an i915/xe perf stream to a file, or to an
+ * in memory ring keeping the most recent records, while adding as little
+ * latency as possible to the draining of the stream.
+ *
+ * The stream is read into a pool of large page aligned buffers, either
+ * from the thread calling igt_capture_pump() or from a dedicated, possibly
+ * CPU pinned, reader thread. In the latter case the reader never waits on
+ * the output: filled buffers are queued and written out with a single
+ * writev() per igt_capture_pump(), the reader only stalls when every
+ * buffer is waiting to be written.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <i915_drm.h>
+
+#include "igt_core.h"
+#include "igt_stream_capture.h"
+
+#define DEFAULT_BUFFER_SIZE (1024 * 1024)
+#define DEFAULT_N_BUFFERS 16
+
+/* Room left for one more read(), larger than any record. */
+#define MIN_READ_SIZE 4096
+
+struct capture_buffer {
+	struct capture_buffer *next;
+	uint8_t *data;
+	size_t len;
+};
+
+struct igt_capture {
+	int stream_fd;
+	int output_fd;
+	struct igt_capture_options opts;
+
+	uint8_t *storage;
+	struct capture_buffer *buffers;
+
+	/* Protects the lists and reader side statistics. */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct capture_buffer *free;
+	struct capture_buffer *queue, **queue_tail;
+	unsigned int n_queued;
+
+	pthread_t thread;
+	bool running;
+	bool stopping; /* Under the lock, tells the reader to leave. */
+	int ready_fd;
+	int stop_fd;
+	bool eof;
+	int error; /* Under the lock, set by the reader. */
+
+	/* Record framing, carried over buffer boundaries. */
+	struct {
+		struct drm_i915_perf_record_header header;
+		uint32_t header_len;
+		uint32_t skip;
+	} scan;
+
+	struct {
+		uint8_t *data;
+		size_t size;
+		size_t begin;
+		size_t len;
+	} ring;
+
+	struct timespec start;
+	struct igt_capture_stats stats;
+};
+
+static uint64_t elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return 1000000000ull * (now.tv_sec - start->tv_sec) +
+		now.tv_nsec - start->tv_nsec;
+}
+
+/**
+ * igt_capture_create:
+ * @stream_fd: non blocking perf stream file descriptor
+ * @output_fd: where to write the records, unused in ring mode
+ * @opts: options, or NULL for the defaults
+ *
+ * Returns: a new capture, to be started with igt_capture_start(), or NULL
+ * on allocation failure.
+ */
+struct igt_capture *igt_capture_create(int stream_fd, int output_fd,
+				       const struct igt_capture_options *opts)
+{
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	struct igt_capture *cap;
+
+	cap = calloc(1, sizeof(*cap));
+	if (!cap)
+		return NULL;
+
+	cap->stream_fd = stream_fd;
+	cap->output_fd = output_fd;
+	cap->ready_fd = -1;
+	cap->stop_fd = -1;
+	if (opts)
+		cap->opts = *opts;
+	else
+		cap->opts.cpu = -1;
+
+	if (!cap->opts.buffer_size)
+		cap->opts.buffer_size = DEFAULT_BUFFER_SIZE;
+	if (!cap->opts.n_buffers)
+		cap->opts.n_buffers = DEFAULT_N_BUFFERS;
+
+	/* A buffer must fit in the ring once its oldest records are gone. */
+	if (cap->opts.ring_size) {
+		cap->opts.ring_size = cap->opts.ring_size > 2 * MIN_READ_SIZE ?
+			cap->opts.ring_size : 2 * MIN_READ_SIZE;
+		if (cap->opts.buffer_size > cap->opts.ring_size / 2)
+			cap->opts.buffer_size = cap->opts.ring_size / 2;
+	}
+	cap->opts.buffer_size = (cap->opts.buffer_size + page_size - 1) & ~(page_size - 1);
+
+	if (posix_memalign((void **)&cap->storage, page_size,
+			   cap->opts.buffer_size * cap->opts.n_buffers))
+		goto err;
+
+	cap->buffers = calloc(cap->opts.n_buffers, sizeof(*cap->buffers));
+	if (!cap->buffers)
+		goto err;
+
+	for (unsigned int i = 0; i < cap->opts.n_buffers; i++) {
+		cap->buffers[i].data = cap->storage + i * cap->opts.buffer_size;
+		cap->buffers[i].next = cap->free;
+		cap->free = &cap->buffers[i];
+	}
+	cap->queue_tail = &cap->queue;
+
+	if (cap->opts.ring_size) {
+		cap->ring.size = cap->opts.ring_size;
+		cap->ring.data = malloc(cap->ring.size);
+		if (!cap->ring.data)
+			goto err;
+	}
+
+	pthread_mutex_init(&cap->lock, NULL);
+	pthread_cond_init(&cap->cond, NULL);
+
+	return cap;
+
+err:
+	free(cap->buffers);
+	free(cap->storage);
+	free(cap);
+	return NULL;
+}
+
+static void queue_buffer(struct igt_capture *cap, struct capture_buffer *buf)
+{
+	pthread_mutex_lock(&cap->lock);
+	buf->next = NULL;
+	*cap->queue_tail = buf;
+	cap->queue_tail = &buf->next;
+	if (++cap->n_queued > cap->stats.max_queued)
+		cap->stats.max_queued = cap->n_queued;
+	pthread_mutex_unlock(&cap->lock);
+
+	if (cap->ready_fd >= 0) {
+		uint64_t one = 1;
+
+		igt_ignore_warn(write(cap->ready_fd, &one, sizeof(one)));
+	}
+}
+
+static struct capture_buffer *dequeue_all(struct igt_capture *cap)
+{
+	struct capture_buffer *list;
+
+	pthread_mutex_lock(&cap->lock);
+	list = cap->queue;
+	cap->queue = NULL;
+	cap->queue_tail = &cap->queue;
+	cap->n_queued = 0;
+	pthread_mutex_unlock(&cap->lock);
+
+	return list;
+}
+
+static void release_buffers(struct igt_capture *cap, struct capture_buffer *list)
+{
+	pthread_mutex_lock(&cap->lock);
+	while (list) {
+		struct capture_buffer *next = list->next;
+
+		list->len = 0;
+		list->next = cap->free;
+		cap->free = list;
+		list = next;
+	}
+	pthread_cond_broadcast(&cap->cond);
+	pthread_mutex_unlock(&cap->lock);
+}
+
+static void scan_records(struct igt_capture *cap, const uint8_t *data, size_t len)
+{
+	while (len) {
+		size_t n;
+
+		if (cap->scan.skip) {
+			n = len < cap->scan.skip ? len : cap->scan.skip;
+			cap->scan.skip -= n;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		n = sizeof(cap->scan.header) - cap->scan.header_len;
+		n = len < n ? len : n;
+		memcpy((uint8_t *)&cap->scan.header + cap->scan.header_len, data, n);
+		cap->scan.header_len += n;
+		data += n;
+		len -= n;
+		if (cap->scan.header_len < sizeof(cap->scan.header))
+			break;
+
+		switch (cap->scan.header.type) {
+		case DRM_I915_PERF_RECORD_SAMPLE:
+			cap->stats.samples++;
+			break;
+		case DRM_I915_PERF_RECORD_OA_REPORT_LOST:
+			cap->stats.reports_lost++;
+			break;
+		case DRM_I915_PERF_RECORD_OA_BUFFER_LOST:
+			cap->stats.buffers_lost++;
+			break;
+		}
+
+		cap->scan.header_len = 0;
+		if (cap->scan.header.size > sizeof(cap->scan.header))
+			cap->scan.skip = cap->scan.header.size - sizeof(cap->scan.header);
+	}
+}
+
+static uint16_t ring_record_size(const struct igt_capture *cap, size_t offset)
+{
+	struct drm_i915_perf_record_header header;
+	size_t pos = (cap->ring.begin + offset) % cap->ring.size;
+	size_t first = cap->ring.size - pos;
+
+	if (first >= sizeof(header)) {
+		memcpy(&header, cap->ring.data + pos, sizeof(header));
+	} else {
+		memcpy(&header, cap->ring.data + pos, first);
+		memcpy((uint8_t *)&header + first, cap->ring.data, sizeof(header) - first);
+	}
+
+	return header.size;
+}
+
+static void ring_append(struct igt_capture *cap, const uint8_t *data, size_t len)
+{
+	assert(len <= cap->ring.size / 2 + MIN_READ_SIZE);
+
+	/* Drop the oldest records, keeping the ring record aligned. */
+	while (cap->ring.size - cap->ring.len < len) {
+		size_t size = cap->ring.len >= sizeof(struct drm_i915_perf_record_header) ?
+			ring_record_size(cap, 0) : 0;
+
+		if (size < sizeof(struct drm_i915_perf_record_header) ||
+		    size > cap->ring.len) {
+			/* Not a record stream, start over. */
+			cap->stats.ring_dropped += cap->ring.len;
+			cap->ring.begin = 0;
+			cap->ring.len = 0;
+			break;
+		}
+
+		cap->ring.begin = (cap->ring.begin + size) % cap->ring.size;
+		cap->ring.len -= size;
+		cap->stats.ring_dropped += size;
+	}
+
+	while (len) {
+		size_t end = (cap->ring.begin + cap->ring.len) % cap->ring.size;
+		size_t n = cap->ring.size - end < len ? cap->ring.size - end : len;
+
+		memcpy(cap->ring.data + end, data, n);
+		cap->ring.len += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static int write_iov(struct igt_capture *cap, struct iovec *iov, int n_iov)
+{
+	while (n_iov) {
+		ssize_t ret = writev(cap->output_fd, iov, n_iov);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		cap->stats.writes++;
+		cap->stats.bytes_written += ret;
+
+		while (n_iov && ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			n_iov--;
+		}
+		if (n_iov) {
+			iov->iov_base = (uint8_t *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+static int emit(struct igt_capture *cap, struct capture_buffer *list)
+{
+	struct iovec iov[64];
+	int n_iov = 0, err = 0;
+
+	for (struct capture_buffer *buf = list; buf; buf = buf->next) {
+		scan_records(cap, buf->data, buf->len);
+
+		if (cap->ring.data) {
+			ring_append(cap, buf->data, buf->len);
+			cap->stats.bytes_written += buf->len;
+			continue;
+		}
+
+		iov[n_iov].iov_base = buf->data;
+		iov[n_iov].iov_len = buf->len;
+		if (++n_iov == sizeof(iov) / sizeof(iov[0]) || !buf->next) {
+			if (!err)
+				err = write_iov(cap, iov, n_iov);
+			n_iov = 0;
+		}
+	}
+
+	return err;
+}
+
+static void set_error(struct igt_capture *cap, int err)
+{
+	pthread_mutex_lock(&cap->lock);
+	cap->error = err;
+	pthread_mutex_unlock(&cap->lock);
+}
+
+static int get_error(struct igt_capture *cap)
+{
+	int err;
+
+	pthread_mutex_lock(&cap->lock);
+	err = cap->error;
+	pthread_mutex_unlock(&cap->lock);
+
+	return err;
+}
+
+/* Returns NULL if the reader thread is asked to stop while waiting. */
+static struct capture_buffer *get_free_buffer(struct igt_capture *cap)
+{
+	struct capture_buffer *buf;
+
+	pthread_mutex_lock(&cap->lock);
+	while (!cap->free) {
+		if (!cap->running) {
+			/* We are the writer as well, make room ourselves. */
+			struct capture_buffer *list;
+			int err;
+
+			pthread_mutex_unlock(&cap->lock);
+			list = dequeue_all(cap);
+			err = emit(cap, list);
+			release_buffers(cap, list);
+			pthread_mutex_lock(&cap->lock);
+			if (err)
+				cap->error = err;
+			continue;
+		}
+
+		if (cap->stopping) {
+			pthread_mutex_unlock(&cap->lock);
+			return NULL;
+		}
+
+		cap->stats.stalls++;
+		pthread_cond_wait(&cap->cond, &cap->lock);
+	}
+	buf = cap->free;
+	cap->free = buf->next;
+	pthread_mutex_unlock(&cap->lock);
+
+	return buf;
+}
+
+/*
+ * Read until the stream would block, queueing the filled buffers. The reader
+ * thread leaves early when asked to stop, the rest is read by
+ * igt_capture_stop().
+ */
+static void read_stream(struct igt_capture *cap)
+{
+	struct capture_buffer *buf = get_free_buffer(cap);
+
+	while (buf && !cap->eof) {
+		ssize_t ret = read(cap->stream_fd, buf->data + buf->len,
+				   cap->opts.buffer_size - buf->len);
+		bool stopping;
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				set_error(cap, -errno);
+			break;
+		}
+
+		if (ret == 0) {
+			cap->eof = true;
+			break;
+		}
+
+		buf->len += ret;
+		pthread_mutex_lock(&cap->lock);
+		cap->stats.reads++;
+		cap->stats.bytes_read += ret;
+		stopping = cap->stopping;
+		pthread_mutex_unlock(&cap->lock);
+
+		if (cap->opts.buffer_size - buf->len < MIN_READ_SIZE) {
+			queue_buffer(cap, buf);
+			buf = get_free_buffer(cap);
+		}
+
+		if (stopping)
+			break;
+	}
+
+	if (!buf)
+		return;
+
+	if (buf->len) {
+		queue_buffer(cap, buf);
+	} else {
+		buf->next = NULL;
+		release_buffers(cap, buf);
+	}
+}
+
+static void *reader_thread(void *data)
+{
+	struct igt_capture *cap = data;
+
+	if (cap->opts.cpu >= 0) {
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(cap->opts.cpu, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+
+	for (;;) {
+		struct pollfd pfd[2] = {
+			{ .fd = cap->stop_fd, .events = POLLIN },
+			{ .fd = cap->stream_fd, .events = POLLIN },
+		};
+
+		if (poll(pfd, cap->eof ? 1 : 2, -1) < 0 && errno != EINTR)
+			break;
+
+		if (pfd[1].revents)
+			read_stream(cap);
+		if (pfd[0].revents || get_error(cap))
+			break;
+	}
+
+	return NULL;
+}
+
+/**
+ * igt_capture_start:
+ * @cap: the capture
+ *
+ * Starts capturing, spawning the reader thread if requested.
+ *
+ * Returns: 0 on success, a negative error code otherwise.
+ */
+int igt_capture_start(struct igt_capture *cap)
+{
+	int err;
+
+	clock_gettime(CLOCK_MONOTONIC, &cap->start);
+
+	if (!cap->opts.threaded)
+		return 0;
+
+	cap->ready_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	cap->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (cap->ready_fd < 0 || cap->stop_fd < 0)
+		return -errno;
+
+	cap->running = true;
+	err = pthread_create(&cap->thread, NULL, reader_thread, cap);
+	if (err) {
+		cap->running = false;
+		return -err;
+	}
+
+	return 0;
+}
+
+/**
+ * igt_capture_poll_fd:
+ * @cap: the capture
+ *
+ * Returns: the file descriptor to poll for POLLIN before calling
+ * igt_capture_pump(), the stream itself unless a reader thread is used.
+ */
+int igt_capture_poll_fd(const struct igt_capture *cap)
+{
+	return cap->running ? cap->ready_fd : cap->stream_fd;
+}
+
+/**
+ * igt_capture_pump:
+ * @cap: the capture
+ *
+ * Reads the stream until it would block when there is no reader thread,
+ * then writes everything read so far out, or into the ring.
+ *
+ * Returns: 0 on success, a negative error code otherwise.
+ */
+int igt_capture_pump(struct igt_capture *cap)
+{
+	struct capture_buffer *list;
+	int err;
+
+	if (cap->running) {
+		uint64_t count;
+
+		igt_ignore_warn(read(cap->ready_fd, &count, sizeof(count)));
+	} else {
+		read_stream(cap);
+	}
+
+	list = dequeue_all(cap);
+	err = emit(cap, list);
+	release_buffers(cap, list);
+
+	return err ?: get_error(cap);
+}
+
+/**
+ * igt_capture_write:
+ * @cap: the capture
+ * @data: complete records to add
+ * @len: length of @data
+ *
+ * Adds records of our own, like timestamp correlations, after the data
+ * read so far.
+ *
+ * Returns: 0 on success, a negative error code otherwise.
+ */
+int igt_capture_write(struct igt_capture *cap, const void *data, size_t len)
+{
+	struct capture_buffer buf = {
+		.data = (uint8_t *)data,
+		.len = len,
+	};
+	int err;
+
+	err = igt_capture_pump(cap);
+	if (err)
+		return err;
+
+	return emit(cap, &buf);
+}
+
+/**
+ * igt_capture_dump:
+ * @cap: the capture
+ * @fd: where to write
+ *
+ * Writes the complete records held in the ring to @fd, leaving the ring
+ * untouched.
+ *
+ * Returns: 0 on success, a negative error code otherwise.
+ */
+int igt_capture_dump(struct igt_capture *cap, int fd)
+{
+	struct igt_capture dumper = { .output_fd = fd };
+	size_t len = 0, end;
+	struct iovec iov[2];
+	int err;
+
+	if (!cap->ring.data)
+		return -EINVAL;
+
+	err = igt_capture_pump(cap);
+	if (err)
+		return err;
+
+	/* Leave out a partial record at the end. */
+	while (cap->ring.len - len >= sizeof(struct drm_i915_perf_record_header)) {
+		uint16_t size = ring_record_size(cap, len);
+
+		if (!size || size > cap->ring.len - len)
+			break;
+		len += size;
+	}
+
+	end = cap->ring.size - cap->ring.begin;
+	iov[0].iov_base = cap->ring.data + cap->ring.begin;
+	iov[0].iov_len = len < end ? len : end;
+	iov[1].iov_base = cap->ring.data;
+	iov[1].iov_len = len - iov[0].iov_len;
+
+	return write_iov(&dumper, iov, iov[1].iov_len ? 2 : 1);
+}
+
+/*
+ * The reader may be waiting for a buffer to free up, which only happens when
+ * pumping, so wake it up as well as making it leave its poll().
+ */
+static void stop_reader(struct igt_capture *cap)
+{
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&cap->lock);
+	cap->stopping = true;
+	pthread_cond_broadcast(&cap->cond);
+	pthread_mutex_unlock(&cap->lock);
+
+	igt_ignore_warn(write(cap->stop_fd, &one, sizeof(one)));
+	pthread_join(cap->thread, NULL);
+
+	cap->running = false;
+	cap->stopping = false;
+}
+
+/**
+ * igt_capture_stop:
+ * @cap: the capture
+ *
+ * Stops the reader thread, if any, and writes out the remaining data.
+ *
+ * Returns: 0 on success, a negative error code otherwise.
+ */
+int igt_capture_stop(struct igt_capture *cap)
+{
+	if (cap->running)
+		stop_reader(cap);
+
+	cap->stats.elapsed_ns = elapsed_ns(&cap->start);
+
+	return igt_capture_pump(cap);
+}
+
+/**
+ * igt_capture_get_stats:
+ * @cap: the capture
+ * @stats: filled with the statistics so far
+ */
+void igt_capture_get_stats(struct igt_capture *cap,
+			   struct igt_capture_stats *stats)
+{
+	pthread_mutex_lock(&cap->lock);
+	*stats = cap->stats;
+	pthread_mutex_unlock(&cap->lock);
+
+	if (cap->running || !stats->elapsed_ns)
+		stats->elapsed_ns = elapsed_ns(&cap->start);
+}
+
+/**
+ * igt_capture_destroy:
+ * @cap: the capture
+ *
+ * Stops and frees @cap, without writing out pending data.
+ */
+void igt_capture_destroy(struct igt_capture *cap)
+{
+	if (!cap)
+		return;
+
+	if (cap->running)
+		stop_reader(cap);
+
+	if (cap->ready_fd >= 0)
+		close(cap->ready_fd);
+	if (cap->stop_fd >= 0)
+		close(cap->stop_fd);
+
+	pthread_cond_destroy(&cap->cond);
+	pthread_mutex_destroy(&cap->lock);
+	free(cap->ring.data);
+	free(cap->buffers);
+	free(cap->storage);
+	free(cap);
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_STREAM_CAPTURE_H
+#define IGT_STREAM_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct igt_capture;
+
+/**
+ * igt_capture_options:
+ * @buffer_size: size of each capture buffer, 0 for the default (1MiB)
+ * @n_buffers: number of capture buffers, 0 for the default (16)
+ * @threaded: read the stream from a dedicated thread
+ * @cpu: CPU to pin the reader thread to, -1 to let it float
+ * @ring_size: when non zero, keep the last @ring_size bytes of records in
+ *	memory rather than writing them out, see igt_capture_dump()
+ */
+struct igt_capture_options {
+	size_t buffer_size;
+	unsigned int n_buffers;
+	bool threaded;
+	int cpu;
+	size_t ring_size;
+};
+
+/**
+ * igt_capture_stats:
+ * @bytes_read: data read from the stream
+ * @bytes_written: data written out, including igt_capture_write() records
+ * @reads: number of read() calls returning data
+ * @writes: number of write()/writev() calls
+ * @samples: DRM_I915_PERF_RECORD_SAMPLE records seen
+ * @reports_lost: DRM_I915_PERF_RECORD_OA_REPORT_LOST records seen
+ * @buffers_lost: DRM_I915_PERF_RECORD_OA_BUFFER_LOST records seen
+ * @stalls: times the reader found no free buffer and had to wait
+ * @ring_dropped: bytes of old records dropped from the ring
+ * @max_queued: highest number of buffers waiting to be written
+ * @elapsed_ns: time since igt_capture_start()
+ */
+struct igt_capture_stats {
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t samples;
+	uint64_t reports_lost;
+	uint64_t buffers_lost;
+	uint64_t stalls;
+	uint64_t ring_dropped;
+	unsigned int max_queued;
+	uint64_t elapsed_ns;
+};
+
+struct igt_capture *igt_capture_create(int stream_fd, int output_fd,
+				       const struct igt_capture_options *opts);
+int igt_capture_start(struct igt_capture *cap);
+int igt_capture_poll_fd(const struct igt_capture *cap);
+int igt_capture_pump(struct igt_capture *cap);
+int igt_capture_write(struct igt_capture *cap, const void *data, size_t len);
+int igt_capture_dump(struct igt_capture *cap, int fd);
+int igt_capture_stop(struct igt_capture *cap);
+void igt_capture_get_stats(struct igt_capture *cap,
+			   struct igt_capture_stats *stats);
+void igt_capture_destroy(struct igt_capture *cap);
+
+#endif /* IGT_STREAM_CAPTURE_H */
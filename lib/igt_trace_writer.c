@@ -0,0 +1,482 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_trace_writer
+ * @short_description: Streaming writer of timeline traces
+ * @title: Trace writer
+ * @include: igt_trace_writer.h
+ *
+ * Writes counters, slices and instant events to a file descriptor in the
+ * Chrome JSON trace event format or as a Perfetto protobuf trace, for
+ * viewing in ui.perfetto.dev or chrome://tracing.
+ *
+ * Events are encoded as they come into a fixed size buffer which is
+ * written out whenever it fills up, so memory usage does not depend on
+ * the length of the trace. Only the track names are kept around.
+ *
+ * All timestamps are in nanoseconds, in whatever clock domain the caller
+ * uses consistently.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_trace_writer.h"
+
+#define OUTPUT_SIZE (64 * 1024)
+#define MAX_NAME 200
+
+/* Perfetto protobuf field numbers, see perfetto/trace/trace_packet.proto. */
+#define TRACE_PACKET 1
+
+#define PACKET_TIMESTAMP 8
+#define PACKET_SEQUENCE_ID 10
+#define PACKET_TRACK_EVENT 11
+#define PACKET_SEQUENCE_FLAGS 13
+#define PACKET_TRACK_DESCRIPTOR 60
+
+#define SEQ_INCREMENTAL_STATE_CLEARED 1
+
+#define TRACK_UUID 1
+#define TRACK_NAME 2
+#define TRACK_PARENT_UUID 5
+#define TRACK_COUNTER 8
+
+#define EVENT_TYPE 9
+#define EVENT_TRACK_UUID 11
+#define EVENT_NAME 23
+#define EVENT_DOUBLE_COUNTER_VALUE 44
+
+#define EVENT_TYPE_SLICE_BEGIN 1
+#define EVENT_TYPE_SLICE_END 2
+#define EVENT_TYPE_INSTANT 3
+#define EVENT_TYPE_COUNTER 4
+
+#define WIRE_VARINT 0
+#define WIRE_FIXED64 1
+#define WIRE_BYTES 2
+
+#define ROOT_UUID 1
+#define SEQUENCE_ID 1
+
+struct trace_track {
+	enum igt_trace_track_type type;
+	/* JSON escaped in the JSON format */
+	char *name;
+};
+
+struct igt_trace_writer {
+	int fd;
+	enum igt_trace_format format;
+	int error;
+	bool first;
+
+	struct trace_track *tracks;
+	uint32_t n_tracks;
+
+	size_t len;
+	uint8_t data[OUTPUT_SIZE];
+};
+
+/**
+ * igt_trace_format_parse:
+ * @name: "json" or "perfetto"
+ * @format: set to the matching format
+ *
+ * Returns: 0 on success, -EINVAL for an unknown format name.
+ */
+int igt_trace_format_parse(const char *name, enum igt_trace_format *format)
+{
+	if (!strcmp(name, "json"))
+		*format = IGT_TRACE_FORMAT_JSON;
+	else if (!strcmp(name, "perfetto"))
+		*format = IGT_TRACE_FORMAT_PERFETTO;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+static void flush(struct igt_trace_writer *writer)
+{
+	size_t offset = 0;
+
+	while (!writer->error && offset < writer->len) {
+		ssize_t ret = write(writer->fd, writer->data + offset,
+				    writer->len - offset);
+
+		if (ret < 0) {
+			if (errno != EINTR)
+				writer->error = -errno;
+			continue;
+		}
+		offset += ret;
+	}
+
+	writer->len = 0;
+}
+
+static void emit(struct igt_trace_writer *writer, const void *data, size_t len)
+{
+	if (writer->len + len > sizeof(writer->data))
+		flush(writer);
+
+	memcpy(writer->data + writer->len, data, len);
+	writer->len += len;
+}
+
+/* Protobuf encoding. */
+
+static uint8_t *pb_varint(uint8_t *p, uint64_t value)
+{
+	while (value >= 0x80) {
+		*p++ = value | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+
+	return p;
+}
+
+static uint8_t *pb_uint(uint8_t *p, uint32_t field, uint64_t value)
+{
+	p = pb_varint(p, field << 3 | WIRE_VARINT);
+	return pb_varint(p, value);
+}
+
+static uint8_t *pb_double(uint8_t *p, uint32_t field, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	p = pb_varint(p, field << 3 | WIRE_FIXED64);
+	for (int i = 0; i < 8; i++)
+		*p++ = bits >> (8 * i);
+
+	return p;
+}
+
+static uint8_t *pb_bytes(uint8_t *p, uint32_t field, const void *data, size_t len)
+{
+	p = pb_varint(p, field << 3 | WIRE_BYTES);
+	p = pb_varint(p, len);
+	if (len)
+		memcpy(p, data, len);
+
+	return p + len;
+}
+
+static uint8_t *pb_string(uint8_t *p, uint32_t field, const char *str)
+{
+	return pb_bytes(p, field, str, strnlen(str, MAX_NAME));
+}
+
+static void emit_packet(struct igt_trace_writer *writer,
+			const uint8_t *packet, size_t len)
+{
+	uint8_t header[16], *p;
+
+	p = pb_varint(header, TRACE_PACKET << 3 | WIRE_BYTES);
+	p = pb_varint(p, len);
+	emit(writer, header, p - header);
+	emit(writer, packet, len);
+}
+
+static void emit_track_descriptor(struct igt_trace_writer *writer,
+				  uint64_t uuid, const char *name, bool counter)
+{
+	uint8_t desc[MAX_NAME + 64], packet[MAX_NAME + 96], *d, *p;
+
+	d = pb_uint(desc, TRACK_UUID, uuid);
+	d = pb_string(d, TRACK_NAME, name);
+	if (uuid != ROOT_UUID)
+		d = pb_uint(d, TRACK_PARENT_UUID, ROOT_UUID);
+	if (counter)
+		d = pb_bytes(d, TRACK_COUNTER, NULL, 0);
+
+	p = pb_bytes(packet, PACKET_TRACK_DESCRIPTOR, desc, d - desc);
+	p = pb_uint(p, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+	if (writer->first) {
+		p = pb_uint(p, PACKET_SEQUENCE_FLAGS, SEQ_INCREMENTAL_STATE_CLEARED);
+		writer->first = false;
+	}
+	emit_packet(writer, packet, p - packet);
+}
+
+static void emit_track_event(struct igt_trace_writer *writer, uint32_t track,
+			     uint32_t type, const char *name,
+			     uint64_t ts_ns, double value)
+{
+	uint8_t event[MAX_NAME + 64], packet[MAX_NAME + 96], *e, *p;
+
+	e = pb_uint(event, EVENT_TYPE, type);
+	e = pb_uint(e, EVENT_TRACK_UUID, ROOT_UUID + 1 + track);
+	if (name)
+		e = pb_string(e, EVENT_NAME, name);
+	if (type == EVENT_TYPE_COUNTER)
+		e = pb_double(e, EVENT_DOUBLE_COUNTER_VALUE, value);
+
+	p = pb_uint(packet, PACKET_TIMESTAMP, ts_ns);
+	p = pb_bytes(p, PACKET_TRACK_EVENT, event, e - event);
+	p = pb_uint(p, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+	emit_packet(writer, packet, p - packet);
+}
+
+/* JSON encoding. */
+
+static void json_escape(char *dst, const char *src)
+{
+	char *end = dst + MAX_NAME;
+
+	for (; *src && dst + 7 < end; src++) {
+		unsigned char c = *src;
+
+		if (c == '"' || c == '\\') {
+			*dst++ = '\\';
+			*dst++ = c;
+		} else if (c < 0x20) {
+			dst += sprintf(dst, "\\u%04x", c);
+		} else {
+			*dst++ = c;
+		}
+	}
+	*dst = '\0';
+}
+
+static void emit_json(struct igt_trace_writer *writer, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void emit_json(struct igt_trace_writer *writer, const char *fmt, ...)
+{
+	char event[3 * MAX_NAME];
+	va_list ap;
+	int len;
+
+	len = snprintf(event, sizeof(event), "%s", writer->first ? "" : ",\n");
+	writer->first = false;
+
+	va_start(ap, fmt);
+	len += vsnprintf(event + len, sizeof(event) - len, fmt, ap);
+	va_end(ap);
+
+	emit(writer, event, len < sizeof(event) ? len : sizeof(event) - 1);
+}
+
+#define JSON_TS "%" PRIu64 ".%03" PRIu64
+#define JSON_TS_ARGS(ns) (ns) / 1000, (ns) % 1000
+
+/**
+ * igt_trace_writer_create:
+ * @fd: file descriptor to write the trace to
+ * @format: format of the trace
+ * @name: name of the process grouping all the tracks
+ *
+ * Returns: a new writer, or NULL on allocation failure.
+ */
+struct igt_trace_writer *igt_trace_writer_create(int fd, enum igt_trace_format format,
+						 const char *name)
+{
+	struct igt_trace_writer *writer = calloc(1, sizeof(*writer));
+	char escaped[MAX_NAME];
+
+	if (!writer)
+		return NULL;
+
+	writer->fd = fd;
+	writer->format = format;
+	writer->first = true;
+
+	switch (format) {
+	case IGT_TRACE_FORMAT_JSON:
+		emit(writer, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n",
+		     strlen("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"));
+		json_escape(escaped, name);
+		emit_json(writer,
+			  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+			  "\"args\":{\"name\":\"%s\"}}", escaped);
+		break;
+	case IGT_TRACE_FORMAT_PERFETTO:
+		emit_track_descriptor(writer, ROOT_UUID, name, false);
+		break;
+	}
+
+	return writer;
+}
+
+/**
+ * igt_trace_writer_add_track:
+ * @writer: the writer
+ * @name: name of the track
+ * @type: kind of events going to the track
+ *
+ * Returns: identifier of the new track, for the other functions.
+ */
+uint32_t igt_trace_writer_add_track(struct igt_trace_writer *writer,
+				    const char *name,
+				    enum igt_trace_track_type type)
+{
+	uint32_t track = writer->n_tracks;
+	struct trace_track *tracks;
+	char escaped[MAX_NAME];
+
+	tracks = realloc(writer->tracks, (track + 1) * sizeof(*tracks));
+	if (!tracks) {
+		writer->error = -ENOMEM;
+		return track;
+	}
+	writer->tracks = tracks;
+	writer->n_tracks++;
+
+	tracks[track].type = type;
+	tracks[track].name = NULL;
+
+	switch (writer->format) {
+	case IGT_TRACE_FORMAT_JSON:
+		json_escape(escaped, name);
+		/* Counter events are named after their track. */
+		if (type == IGT_TRACE_TRACK_COUNTER) {
+			tracks[track].name = strdup(escaped);
+			if (!tracks[track].name)
+				writer->error = -ENOMEM;
+		} else {
+			emit_json(writer,
+				  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+				  "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				  track + 1, escaped);
+		}
+		break;
+	case IGT_TRACE_FORMAT_PERFETTO:
+		emit_track_descriptor(writer, ROOT_UUID + 1 + track, name,
+				      type == IGT_TRACE_TRACK_COUNTER);
+		break;
+	}
+
+	return track;
+}
+
+/**
+ * igt_trace_writer_counter:
+ * @writer: the writer
+ * @track: an #IGT_TRACE_TRACK_COUNTER track
+ * @ts_ns: time of the new value
+ * @value: new value of the counter, kept until the next one
+ */
+void igt_trace_writer_counter(struct igt_trace_writer *writer, uint32_t track,
+			      uint64_t ts_ns, double value)
+{
+	if (track >= writer->n_tracks ||
+	    writer->tracks[track].type != IGT_TRACE_TRACK_COUNTER)
+		return;
+
+	switch (writer->format) {
+	case IGT_TRACE_FORMAT_JSON:
+		emit_json(writer,
+			  "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":" JSON_TS ",\"pid\":1,"
+			  "\"args\":{\"value\":%.10g}}",
+			  writer->tracks[track].name ?: "", JSON_TS_ARGS(ts_ns),
+			  isfinite(value) ? value : 0.0);
+		break;
+	case IGT_TRACE_FORMAT_PERFETTO:
+		emit_track_event(writer, track, EVENT_TYPE_COUNTER, NULL, ts_ns, value);
+		break;
+	}
+}
+
+/**
+ * igt_trace_writer_slice:
+ * @writer: the writer
+ * @track: an #IGT_TRACE_TRACK_SLICES track
+ * @name: name of the slice
+ * @ts_ns: beginning of the slice
+ * @dur_ns: duration of the slice
+ */
+void igt_trace_writer_slice(struct igt_trace_writer *writer, uint32_t track,
+			    const char *name, uint64_t ts_ns, uint64_t dur_ns)
+{
+	char escaped[MAX_NAME];
+
+	if (track >= writer->n_tracks ||
+	    writer->tracks[track].type != IGT_TRACE_TRACK_SLICES)
+		return;
+
+	switch (writer->format) {
+	case IGT_TRACE_FORMAT_JSON:
+		json_escape(escaped, name);
+		emit_json(writer,
+			  "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":" JSON_TS ",\"dur\":" JSON_TS
+			  ",\"pid\":1,\"tid\":%u}",
+			  escaped, JSON_TS_ARGS(ts_ns), JSON_TS_ARGS(dur_ns), track + 1);
+		break;
+	case IGT_TRACE_FORMAT_PERFETTO:
+		emit_track_event(writer, track, EVENT_TYPE_SLICE_BEGIN, name, ts_ns, 0);
+		emit_track_event(writer, track, EVENT_TYPE_SLICE_END, NULL,
+				 ts_ns + dur_ns, 0);
+		break;
+	}
+}
+
+/**
+ * igt_trace_writer_instant:
+ * @writer: the writer
+ * @track: an #IGT_TRACE_TRACK_SLICES track
+ * @name: name of the event
+ * @ts_ns: time of the event
+ */
+void igt_trace_writer_instant(struct igt_trace_writer *writer, uint32_t track,
+			      const char *name, uint64_t ts_ns)
+{
+	char escaped[MAX_NAME];
+
+	if (track >= writer->n_tracks ||
+	    writer->tracks[track].type != IGT_TRACE_TRACK_SLICES)
+		return;
+
+	switch (writer->format) {
+	case IGT_TRACE_FORMAT_JSON:
+		json_escape(escaped, name);
+		emit_json(writer,
+			  "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" JSON_TS
+			  ",\"pid\":1,\"tid\":%u}",
+			  escaped, JSON_TS_ARGS(ts_ns), track + 1);
+		break;
+	case IGT_TRACE_FORMAT_PERFETTO:
+		emit_track_event(writer, track, EVENT_TYPE_INSTANT, name, ts_ns, 0);
+		break;
+	}
+}
+
+/**
+ * igt_trace_writer_close:
+ * @writer: the writer
+ *
+ * Terminates the trace, writes out the buffered events and frees @writer.
+ * The file descriptor is left open.
+ *
+ * Returns: 0 on success, the first error hit while writing the trace
+ * otherwise.
+ */
+int igt_trace_writer_close(struct igt_trace_writer *writer)
+{
+	int error;
+
+	if (writer->format == IGT_TRACE_FORMAT_JSON)
+		emit(writer, "\n]}\n", 4);
+	flush(writer);
+
+	error = writer->error;
+	for (uint32_t i = 0; i < writer->n_tracks; i++)
+		free(writer->tracks[i].name);
+	free(writer->tracks);
+	free(writer);
+
+	return error;
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#ifndef IGT_TRACE_WRITER_H
+#define IGT_TRACE_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct igt_trace_writer;
+
+/**
+ * igt_trace_format:
+ * @IGT_TRACE_FORMAT_JSON: Chrome JSON trace event format, readable by
+ *	chrome://tracing and ui.perfetto.dev
+ * @IGT_TRACE_FORMAT_PERFETTO: Perfetto protobuf trace
+ */
+enum igt_trace_format {
+	IGT_TRACE_FORMAT_JSON,
+	IGT_TRACE_FORMAT_PERFETTO,
+};
+
+/**
+ * igt_trace_track_type:
+ * @IGT_TRACE_TRACK_SLICES: track of slices and instant events
+ * @IGT_TRACE_TRACK_COUNTER: track of counter values
+ */
+enum igt_trace_track_type {
+	IGT_TRACE_TRACK_SLICES,
+	IGT_TRACE_TRACK_COUNTER,
+};
+
+int igt_trace_format_parse(const char *name, enum igt_trace_format *format);
+
+struct igt_trace_writer *igt_trace_writer_create(int fd, enum igt_trace_format format,
+						 const char *name);
+uint32_t igt_trace_writer_add_track(struct igt_trace_writer *writer,
+				    const char *name,
+				    enum igt_trace_track_type type);
+void igt_trace_writer_counter(struct igt_trace_writer *writer, uint32_t track,
+			      uint64_t ts_ns, double value);
+void igt_trace_writer_slice(struct igt_trace_writer *writer, uint32_t track,
+			    const char *name, uint64_t ts_ns, uint64_t dur_ns);
+void igt_trace_writer_instant(struct igt_trace_writer *writer, uint32_t track,
+			      const char *name, uint64_t ts_ns);
+int igt_trace_writer_close(struct igt_trace_writer *writer);
+
+#endif /* IGT_TRACE_WRITER_H */
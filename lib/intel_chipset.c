@@ -34,6 +34,7 @@
 #include <assert.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include "i915_drm.h"
@@ -127,12 +128,26 @@ static uint32_t __i915_get_drm_devid(int fd)
 	return devid;
 }
 
+/*
+ * Looking up the devid takes several ioctls (driver name checks plus the
+ * query itself) and is done over and over by the feature macros, so
+ * remember it per fd. The device number of the fd tells us whether the
+ * slot still refers to the same device, as fds get closed and reused.
+ */
+#define DEVID_CACHE_FDS 256
+
+static struct {
+	dev_t rdev;
+	uint32_t devid;
+} devid_cache[DEVID_CACHE_FDS];
+static pthread_mutex_t devid_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * intel_get_drm_devid:
  * @fd: open i915/xe drm file descriptor
  *
  * Queries the kernel for the pci device id corresponding to the drm file
- * descriptor.
+ * descriptor. The result is cached per file descriptor.
  *
  * Returns:
  * The devid, exits the program on any failures.
@@ -141,17 +156,41 @@ uint32_t
 intel_get_drm_devid(int fd)
 {
 	const char *override;
+	struct stat st;
+	bool cacheable;
+	uint32_t devid;
+
+	override = getenv("INTEL_DEVID_OVERRIDE");
+
+	cacheable = !override && fd >= 0 && fd < DEVID_CACHE_FDS &&
+		    fstat(fd, &st) == 0 && S_ISCHR(st.st_mode);
+	if (cacheable) {
+		pthread_mutex_lock(&devid_cache_lock);
+		devid = devid_cache[fd].rdev == st.st_rdev ?
+			devid_cache[fd].devid : 0;
+		pthread_mutex_unlock(&devid_cache_lock);
+		if (devid)
+			return devid;
+	}
 
 	igt_assert(is_intel_device(fd));
 
-	override = getenv("INTEL_DEVID_OVERRIDE");
 	if (override)
 		return strtol(override, NULL, 0);
 
 	if (is_i915_device(fd))
-		return __i915_get_drm_devid(fd);
+		devid = __i915_get_drm_devid(fd);
 	else
-		return xe_dev_id(fd);
+		devid = xe_dev_id(fd);
+
+	if (cacheable && devid) {
+		pthread_mutex_lock(&devid_cache_lock);
+		devid_cache[fd].rdev = st.st_rdev;
+		devid_cache[fd].devid = devid;
+		pthread_mutex_unlock(&devid_cache_lock);
+	}
+
+	return devid;
 }
 
 /**
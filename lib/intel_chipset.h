@@ -99,6 +99,7 @@ struct intel_device_info {
 };
 
 const struct intel_device_info *intel_get_device_info(uint16_t devid) __attribute__((pure));
+const struct intel_device_info *__intel_get_device_info_linear(uint16_t devid);
 
 const struct intel_cmds_info *intel_get_cmds_info(uint16_t devid) __attribute__((pure));
 unsigned intel_gen(uint16_t devid) __attribute__((pure));
@@ -2,6 +2,8 @@
 #include "pciids.h"
 #include "i915_pciids_local.h"
 
+#include <pthread.h>
+#include <stdlib.h>
 #include <strings.h> /* ffs() */
 
 static const struct intel_device_info intel_generic_info = {
@@ -660,6 +662,82 @@ static const struct pci_id_match intel_device_match[] = {
 
 #undef INTEL_PCI_ID_INIT
 
+#define INTEL_DEVICE_MATCH_COUNT (sizeof(intel_device_match) / sizeof(intel_device_match[0]) - 1)
+
+/*
+ * intel_device_match[] is kept grouped by platform for readability, so
+ * build a copy sorted by device id the first time we need it. Ties are
+ * broken by table position to keep the first-match semantics of the
+ * linear walk.
+ */
+static const struct pci_id_match *intel_device_sorted[INTEL_DEVICE_MATCH_COUNT];
+static pthread_once_t intel_device_sorted_once = PTHREAD_ONCE_INIT;
+
+static int cmp_device_match(const void *A, const void *B)
+{
+	const struct pci_id_match *a = *(const struct pci_id_match **)A;
+	const struct pci_id_match *b = *(const struct pci_id_match **)B;
+
+	if (a->device_id != b->device_id)
+		return a->device_id < b->device_id ? -1 : 1;
+
+	return a < b ? -1 : a > b;
+}
+
+static void sort_device_match(void)
+{
+	for (int i = 0; i < INTEL_DEVICE_MATCH_COUNT; i++)
+		intel_device_sorted[i] = &intel_device_match[i];
+
+	qsort(intel_device_sorted, INTEL_DEVICE_MATCH_COUNT,
+	      sizeof(*intel_device_sorted), cmp_device_match);
+}
+
+static const struct intel_device_info *lookup_device_info(uint16_t devid)
+{
+	size_t lo = 0, hi = INTEL_DEVICE_MATCH_COUNT;
+
+	pthread_once(&intel_device_sorted_once, sort_device_match);
+
+	/* Find the first entry not below devid */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (intel_device_sorted[mid]->device_id < devid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < INTEL_DEVICE_MATCH_COUNT &&
+	    intel_device_sorted[lo]->device_id == devid)
+		return (void *)intel_device_sorted[lo]->match_data;
+
+	return &intel_generic_info;
+}
+
+/**
+ * __intel_get_device_info_linear:
+ * @devid: pci device id
+ *
+ * Reference implementation of intel_get_device_info() walking the whole
+ * device table, for selftests only.
+ *
+ * Returns:
+ * The associated intel_device_info
+ */
+const struct intel_device_info *__intel_get_device_info_linear(uint16_t devid)
+{
+	int i;
+
+	for (i = 0; intel_device_match[i].device_id != PCI_MATCH_ANY; i++) {
+		if (devid == intel_device_match[i].device_id)
+			break;
+	}
+
+	return (void *)intel_device_match[i].match_data;
+}
+
 /**
  * intel_get_device_info:
  * @devid: pci device id
@@ -673,19 +751,12 @@ const struct intel_device_info *intel_get_device_info(uint16_t devid)
 {
 	static __thread const struct intel_device_info *cache = &intel_generic_info;
 	static __thread uint16_t cached_devid;
-	int i;
 
 	if (cached_devid == devid)
 		goto out;
 
-	/* XXX Presort table and bsearch! */
-	for (i = 0; intel_device_match[i].device_id != PCI_MATCH_ANY; i++) {
-		if (devid == intel_device_match[i].device_id)
-			break;
-	}
-
 	cached_devid = devid;
-	cache = (void *)intel_device_match[i].match_data;
+	cache = lookup_device_info(devid);
 
 out:
 	return cache;
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <i915_drm.h>
+
+#include "igt_core.h"
+#include "i915/perf.h"
+
+IGT_TEST_DESCRIPTION("Check the OA report accumulation kernels against a "
+		     "counter by counter reference");
+
+#define REPORT_SIZE 256
+#define N_DELTAS 37
+
+struct run {
+	char type;	/* 't'imestamp, 'T'imestamp64, 'C'lock64, 'u'32, 'U'40 */
+	int offset;	/* dwords, qwords for 64 bit runs */
+	int a_index;	/* high byte of 40 bit counters */
+	int count;
+};
+
+static const struct {
+	const char *name;
+	uint64_t format;
+	struct run runs[10];
+} formats[] = {
+	{ "a24u40-a14u32-b8-c8", I915_OA_FORMAT_A24u40_A14u32_B8_C8, {
+		{ 't', 1, 0, 1 }, { 'u', 3, 0, 5 }, { 'U', 8, 4, 20 },
+		{ 'u', 28, 0, 4 }, { 'U', 32, 28, 4 }, { 'u', 36, 0, 5 },
+		{ 'u', 46, 0, 1 }, { 'u', 48, 0, 16 } } },
+	{ "a32u40-a4u32-b8-c8", I915_OA_FORMAT_A32u40_A4u32_B8_C8, {
+		{ 't', 1, 0, 1 }, { 'u', 3, 0, 1 }, { 'U', 4, 0, 32 },
+		{ 'u', 36, 0, 4 }, { 'u', 48, 0, 16 } } },
+	{ "oar-a32u40-a4u32-b8-c8", I915_OAR_FORMAT_A32u40_A4u32_B8_C8, {
+		{ 't', 1, 0, 1 }, { 'u', 3, 0, 1 }, { 'U', 4, 0, 32 },
+		{ 'u', 36, 0, 4 }, { 'u', 48, 0, 16 } } },
+	{ "a45-b8-c8", I915_OA_FORMAT_A45_B8_C8, {
+		{ 't', 1, 0, 1 }, { 'u', 3, 0, 61 } } },
+	{ "mpec8u32-b8-c8", I915_OAM_FORMAT_MPEC8u32_B8_C8, {
+		{ 'T', 1, 0, 1 }, { 'C', 3, 0, 1 }, { 'u', 8, 0, 24 } } },
+};
+
+static void reference(const struct run *runs, int shift,
+		      const uint32_t *r0, const uint32_t *r1,
+		      uint64_t *deltas)
+{
+	const uint64_t *q0 = (const uint64_t *)r0, *q1 = (const uint64_t *)r1;
+	const uint8_t *h0 = (const uint8_t *)(r0 + 40);
+	const uint8_t *h1 = (const uint8_t *)(r1 + 40);
+	int idx = 0;
+
+	for (const struct run *run = runs; run->count; run++) {
+		for (int i = 0; i < run->count; i++) {
+			int o = run->offset + i, a = run->a_index + i;
+			uint64_t v0, v1;
+
+			switch (run->type) {
+			case 't':
+				deltas[idx++] = shift >= 0 ?
+					(uint32_t)((r1[o] - r0[o]) << shift) :
+					(r1[o] - r0[o]) >> -shift;
+				break;
+			case 'T':
+				deltas[idx++] = shift >= 0 ?
+					(q1[o] - q0[o]) << shift :
+					(q1[o] - q0[o]) >> -shift;
+				break;
+			case 'C':
+				deltas[idx++] = q1[o] - q0[o];
+				break;
+			case 'u':
+				deltas[idx++] = (uint32_t)(r1[o] - r0[o]);
+				break;
+			case 'U':
+				v0 = r0[o] | (uint64_t)h0[a] << 32;
+				v1 = r1[o] | (uint64_t)h1[a] << 32;
+				deltas[idx++] = v0 > v1 ?
+					(1ULL << 40) + v1 - v0 : v1 - v0;
+				break;
+			}
+		}
+	}
+}
+
+static void check_format(int f, int shift, uint8_t *data)
+{
+	const struct drm_i915_perf_record_header *records[N_DELTAS + 1];
+	const size_t record_size = sizeof(*records[0]) + REPORT_SIZE;
+	const struct intel_perf_accumulate_impl *impl;
+	struct intel_perf_metric_set metric_set = {
+		.perf_oa_format = formats[f].format,
+	};
+	struct intel_perf perf = {
+		.devinfo.oa_timestamp_shift = shift,
+	};
+	uint64_t expected[N_DELTAS][INTEL_PERF_MAX_RAW_OA_COUNTERS] = {};
+	uint64_t columns[INTEL_PERF_MAX_RAW_OA_COUNTERS * (N_DELTAS + 3)];
+
+	for (int i = 0; i <= N_DELTAS; i++)
+		records[i] = (const void *)(data + i * record_size);
+
+	for (int i = 0; i < N_DELTAS; i++) {
+		struct intel_perf_accumulator acc;
+
+		reference(formats[f].runs, shift,
+			  (const uint32_t *)(records[i] + 1),
+			  (const uint32_t *)(records[i + 1] + 1),
+			  expected[i]);
+
+		intel_perf_accumulate_reports(&acc, &perf, &metric_set,
+					      records[i], records[i + 1]);
+		igt_assert(!memcmp(acc.deltas, expected[i], sizeof(acc.deltas)));
+	}
+
+	for (unsigned int n = 0; (impl = intel_perf_accumulate_impl_get(n)); n++) {
+		/* Exercise partial blocks and a stride wider than the batch */
+		for (uint32_t n_deltas = 1; n_deltas <= N_DELTAS; n_deltas += 6) {
+			struct intel_perf_deltas deltas = {
+				.deltas = columns,
+				.stride = N_DELTAS + 3,
+			};
+
+			impl->accumulate(&deltas, &perf, &metric_set,
+					 records, n_deltas);
+
+			for (uint32_t i = 0; i < n_deltas; i++) {
+				struct intel_perf_accumulator acc;
+
+				intel_perf_deltas_get(&deltas, i, &acc);
+				igt_assert_f(!memcmp(acc.deltas, expected[i],
+						     sizeof(acc.deltas)),
+					     "%s: pair %u of %u differs\n",
+					     impl->name, i, n_deltas);
+			}
+		}
+	}
+}
+
+igt_main
+{
+	const size_t record_size =
+		sizeof(struct drm_i915_perf_record_header) + REPORT_SIZE;
+	uint8_t *data;
+
+	igt_fixture {
+		data = malloc(record_size * (N_DELTAS + 1));
+		igt_assert(data);
+
+		srandom(0x0a0a);
+		for (size_t i = 0; i < record_size * (N_DELTAS + 1); i++)
+			data[i] = random();
+	}
+
+	for (int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		igt_subtest_f("%s", formats[f].name) {
+			for (int shift = -3; shift <= 3; shift += 3)
+				check_format(f, shift, data);
+		}
+	}
+
+	igt_fixture
+		free(data);
+}
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <i915_drm.h>
+
+#include "igt_core.h"
+#include "i915/perf_data_reader.h"
+
+IGT_TEST_DESCRIPTION("Check reading an i915-perf recording through its index "
+		     "against a full parse");
+
+#define DEVID 0x9a49 /* TGL GT2 */
+#define REPORT_SIZE 256
+#define N_REPORTS 1000
+#define N_CORRELATIONS 11
+/* GPU ticks between reports, reports between context switches */
+#define REPORT_PERIOD 10
+#define CONTEXT_PERIOD 7
+
+static void emit(int fd, uint32_t type, const void *data, size_t size)
+{
+	struct drm_i915_perf_record_header header = {
+		.type = type,
+		.size = sizeof(header) + size,
+	};
+
+	igt_assert_eq(write(fd, &header, sizeof(header)), sizeof(header));
+	igt_assert_eq(write(fd, data, size), size);
+}
+
+static void emit_correlation(int fd, uint64_t gpu_ts)
+{
+	/* 1000 ticks per microsecond keeps the correlation exact */
+	struct intel_perf_record_timestamp_correlation corr = {
+		.cpu_timestamp = 1000000 + gpu_ts * 1000,
+		.gpu_timestamp = gpu_ts,
+	};
+
+	emit(fd, INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+	     &corr, sizeof(corr));
+}
+
+static void write_recording(int fd)
+{
+	struct intel_perf_record_version version = {
+		.version = INTEL_PERF_RECORD_VERSION,
+	};
+	struct intel_perf_record_device_info info = {
+		.timestamp_frequency = 1000000000,
+		.device_id = DEVID,
+		.gt_min_frequency = 300000000,
+		.gt_max_frequency = 1300000000,
+		.oa_format = I915_OA_FORMAT_A32u40_A4u32_B8_C8,
+		.metric_set_name = "RenderBasic",
+	};
+	uint8_t topology[sizeof(struct drm_i915_query_topology_info) + 16] = {};
+	struct drm_i915_query_topology_info *topo = (void *)topology;
+	const uint64_t span = (uint64_t)REPORT_PERIOD * N_REPORTS;
+
+	topo->max_slices = 1;
+	topo->max_subslices = 6;
+	topo->max_eus_per_subslice = 16;
+	topo->subslice_offset = 1;
+	topo->subslice_stride = 1;
+	topo->eu_offset = 2;
+	topo->eu_stride = 2;
+	topo->data[0] = 0x1;
+	topo->data[1] = 0x3f;
+	memset(&topo->data[2], 0xff, 12);
+
+	emit(fd, INTEL_PERF_RECORD_TYPE_VERSION, &version, sizeof(version));
+	emit(fd, INTEL_PERF_RECORD_TYPE_DEVICE_INFO, &info, sizeof(info));
+	emit(fd, INTEL_PERF_RECORD_TYPE_DEVICE_TOPOLOGY, topology, sizeof(topology));
+
+	emit_correlation(fd, 0);
+	for (uint32_t i = 0; i < N_REPORTS; i++) {
+		uint32_t report[REPORT_SIZE / 4] = {};
+
+		/* Interleave correlations as the recorder does */
+		if (i && i % (N_REPORTS / (N_CORRELATIONS - 1)) == 0)
+			emit_correlation(fd, (uint64_t)i * REPORT_PERIOD);
+
+		report[1] = REPORT_PERIOD * i + 1;
+		report[2] = 0x100 + (i / CONTEXT_PERIOD) % 3;
+		emit(fd, DRM_I915_PERF_RECORD_SAMPLE, report, sizeof(report));
+	}
+	emit_correlation(fd, span + REPORT_PERIOD);
+}
+
+static int tmpfile_fd(void)
+{
+	FILE *file = tmpfile();
+
+	igt_assert(file);
+	return dup(fileno(file));
+}
+
+static int copy_fd(int fd)
+{
+	int copy = tmpfile_fd();
+	char buf[4096];
+	ssize_t len;
+
+	lseek(fd, 0, SEEK_SET);
+	while ((len = read(fd, buf, sizeof(buf))) > 0)
+		igt_assert_eq(write(copy, buf, len), len);
+
+	return copy;
+}
+
+/* Overwrite @size bytes at @offset of a copy of the index, then open it */
+static bool init_corrupted(int fd, int index_fd, off_t offset,
+			   const void *data, size_t size)
+{
+	struct intel_perf_data_reader reader;
+	int corrupted = copy_fd(index_fd);
+	bool ret;
+
+	igt_assert_eq(pwrite(corrupted, data, size, offset), size);
+	ret = intel_perf_data_reader_init_indexed(&reader, fd, corrupted);
+	intel_perf_data_reader_fini(&reader);
+	close(corrupted);
+
+	return ret;
+}
+
+static void check_iter(struct intel_perf_data_reader *reader,
+		       uint64_t begin, uint64_t end,
+		       uint32_t first, uint32_t last)
+{
+	const struct drm_i915_perf_record_header *record;
+	struct intel_perf_data_iter iter;
+	uint32_t n = first;
+
+	intel_perf_data_reader_iter_init(reader, begin, end, &iter);
+	while ((record = intel_perf_data_iter_next(&iter)))
+		igt_assert(record == intel_perf_data_reader_get_record(reader, n++));
+	igt_assert_eq(n, last + 1);
+}
+
+static void check_same(struct intel_perf_data_reader *full,
+		       struct intel_perf_data_reader *indexed)
+{
+	struct intel_perf_context_busy busy_full[4], busy_indexed[4];
+	uint64_t begin, end;
+	uint32_t n;
+
+	igt_assert(indexed->index_records);
+	igt_assert(!indexed->records);
+	igt_assert_eq(indexed->n_records, full->n_records);
+	igt_assert_eq(indexed->n_timelines, full->n_timelines);
+	igt_assert_eq(indexed->n_correlations, full->n_correlations);
+	igt_assert(!strcmp(indexed->metric_set->symbol_name,
+			   full->metric_set->symbol_name));
+
+	for (uint32_t i = 0; i < full->n_records; i++) {
+		const struct drm_i915_perf_record_header *a, *b;
+
+		a = intel_perf_data_reader_get_record(full, i);
+		b = intel_perf_data_reader_get_record(indexed, i);
+		igt_assert_eq(a->size, b->size);
+		igt_assert(!memcmp(a, b, a->size));
+		igt_assert_eq_u64(intel_perf_data_reader_get_record_cpu_ts(full, i),
+				  intel_perf_data_reader_get_record_cpu_ts(indexed, i));
+	}
+
+	for (uint32_t i = 0; i < full->n_timelines; i++) {
+		struct intel_perf_timeline_item a, b;
+
+		intel_perf_data_reader_get_timeline(full, i, &a);
+		intel_perf_data_reader_get_timeline(indexed, i, &b);
+		igt_assert_eq_u64(a.cpu_ts_start, b.cpu_ts_start);
+		igt_assert_eq_u64(a.cpu_ts_end, b.cpu_ts_end);
+		igt_assert_eq(a.record_start, b.record_start);
+		igt_assert_eq(a.record_end, b.record_end);
+		igt_assert_eq(a.hw_id, b.hw_id);
+	}
+
+	/* A window in the middle of the recording */
+	begin = intel_perf_data_reader_get_record_cpu_ts(full, 123) - 1;
+	end = intel_perf_data_reader_get_record_cpu_ts(full, 456) + 1;
+
+	check_iter(full, begin, end, 123, 456);
+	check_iter(indexed, begin, end, 123, 456);
+
+	n = intel_perf_data_reader_context_busy(full, begin, end, busy_full,
+						sizeof(busy_full) / sizeof(busy_full[0]));
+	igt_assert_eq(n, 3);
+	igt_assert_eq(intel_perf_data_reader_context_busy(indexed, begin, end,
+							  busy_indexed,
+							  sizeof(busy_indexed) / sizeof(busy_indexed[0])),
+		      n);
+
+	for (uint32_t i = 0; i < n; i++) {
+		igt_assert_eq(busy_full[i].hw_id, busy_indexed[i].hw_id);
+		igt_assert_eq(busy_full[i].n_timelines, busy_indexed[i].n_timelines);
+		igt_assert_eq_u64(busy_full[i].busy_ns, busy_indexed[i].busy_ns);
+		igt_assert(busy_full[i].busy_ns > 0);
+		igt_assert(busy_full[i].busy_ns < end - begin);
+	}
+
+	/* Contexts past max_busy are dropped */
+	igt_assert_eq(intel_perf_data_reader_context_busy(indexed, begin, end,
+							  busy_indexed, 1), 1);
+	igt_assert_eq(busy_indexed[0].hw_id, busy_full[0].hw_id);
+}
+
+igt_main
+{
+	struct intel_perf_data_reader full, indexed;
+	int fd = -1, index_fd = -1;
+
+	igt_fixture {
+		fd = tmpfile_fd();
+		write_recording(fd);
+
+		igt_assert_f(intel_perf_data_reader_init(&full, fd),
+			     "%s\n", full.error_msg);
+		igt_assert_eq(full.n_records, N_REPORTS);
+		igt_assert(full.n_timelines > 0);
+
+		index_fd = tmpfile_fd();
+		igt_assert_f(intel_perf_data_reader_write_index(&full, index_fd),
+			     "%s\n", full.error_msg);
+	}
+
+	igt_subtest("indexed") {
+		igt_assert_f(intel_perf_data_reader_init_indexed(&indexed, fd, index_fd),
+			     "%s\n", indexed.error_msg);
+		check_same(&full, &indexed);
+		intel_perf_data_reader_fini(&indexed);
+	}
+
+	igt_subtest("stale-index") {
+		struct drm_i915_perf_record_header header = {
+			.type = DRM_I915_PERF_RECORD_OA_REPORT_LOST,
+			.size = sizeof(header),
+		};
+		int grown = tmpfile_fd();
+		char buf[4096];
+		ssize_t len;
+
+		lseek(fd, 0, SEEK_SET);
+		while ((len = read(fd, buf, sizeof(buf))) > 0)
+			igt_assert_eq(write(grown, buf, len), len);
+		igt_assert_eq(write(grown, &header, sizeof(header)), sizeof(header));
+
+		igt_assert(!intel_perf_data_reader_init_indexed(&indexed, grown, index_fd));
+		intel_perf_data_reader_fini(&indexed);
+		close(grown);
+	}
+
+	igt_subtest("corrupt-index") {
+		const off_t records = sizeof(struct intel_perf_index_header);
+		const off_t timelines = records +
+			full.n_records * sizeof(struct intel_perf_index_record);
+		uint64_t offset = lseek(fd, 0, SEEK_END) - 8;
+		uint32_t record = full.n_records;
+
+		/* Unmodified, the copy is fine */
+		igt_assert(init_corrupted(fd, index_fd, 0, "i915pidx", 8));
+
+		/* A sample running past the end of the recording */
+		igt_assert(!init_corrupted(fd, index_fd,
+					   records + 500 * sizeof(struct intel_perf_index_record) +
+					   offsetof(struct intel_perf_index_record, offset),
+					   &offset, sizeof(offset)));
+
+		/* A context switch past the last sample */
+		igt_assert(!init_corrupted(fd, index_fd,
+					   timelines +
+					   offsetof(struct intel_perf_index_timeline, record_end),
+					   &record, sizeof(record)));
+
+		/* A context switch ending before it starts */
+		record = 0;
+		igt_assert(!init_corrupted(fd, index_fd,
+					   timelines + sizeof(struct intel_perf_index_timeline) +
+					   offsetof(struct intel_perf_index_timeline, record_end),
+					   &record, sizeof(record)));
+	}
+
+	igt_subtest("cached") {
+		char path[] = "/tmp/i915-perf-recording-XXXXXX", index_path[64];
+		int copy = mkstemp(path);
+		char buf[4096];
+		ssize_t len;
+
+		igt_assert(copy >= 0);
+		lseek(fd, 0, SEEK_SET);
+		while ((len = read(fd, buf, sizeof(buf))) > 0)
+			igt_assert_eq(write(copy, buf, len), len);
+		close(copy);
+		snprintf(index_path, sizeof(index_path), "%s.idx", path);
+
+		/* First open parses and caches, the second goes through the index */
+		igt_assert(intel_perf_data_reader_init_cached(&indexed, path));
+		igt_assert(!indexed.index_records);
+		intel_perf_data_reader_fini(&indexed);
+		igt_assert(access(index_path, R_OK) == 0);
+
+		igt_assert(intel_perf_data_reader_init_cached(&indexed, path));
+		check_same(&full, &indexed);
+		intel_perf_data_reader_fini(&indexed);
+
+		unlink(index_path);
+		unlink(path);
+	}
+
+	igt_fixture {
+		intel_perf_data_reader_fini(&full);
+		close(index_fd);
+		close(fd);
+	}
+}
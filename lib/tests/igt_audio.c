@@ -25,8 +25,11 @@
 
 #include "config.h"
 
+#include <math.h>
 #include <stdlib.h>
+#include <unistd.h>
 
+#include "drmtest.h"
 #include "igt_core.h"
 #include "igt_audio.h"
 
@@ -174,8 +177,313 @@ static void test_signal_detect_phaseshift(struct audio_signal *signal)
 	igt_assert(!ok);
 }
 
+static bool detector_run(struct audio_signal *signal,
+			 enum audio_detector_backend backend,
+			 const double *buf, size_t len)
+{
+	struct audio_detector *det;
+	struct audio_detector_stats stats;
+
+	/* Slide by a quarter window to exercise the overlapping windows */
+	det = audio_detector_init(signal, SAMPLING_RATE, 0, BUFFER_LEN,
+				  BUFFER_LEN / 4, backend);
+	audio_detector_push(det, buf, len);
+	audio_detector_get_stats(det, &stats);
+	audio_detector_fini(det);
+
+	igt_assert(stats.windows == (len - BUFFER_LEN) / (BUFFER_LEN / 4) + 1);
+
+	return stats.detected == stats.windows;
+}
+
+static void test_detector_untampered(struct audio_signal *signal,
+				     enum audio_detector_backend backend)
+{
+	double buf[4 * BUFFER_LEN];
+
+	audio_signal_fill(signal, buf, 4 * BUFFER_LEN / CHANNELS);
+	igt_assert(detector_run(signal, backend, buf, 4 * BUFFER_LEN));
+}
+
+static void test_detector_silence(struct audio_signal *signal,
+				  enum audio_detector_backend backend)
+{
+	double buf[4 * BUFFER_LEN] = {0};
+
+	igt_assert(!detector_run(signal, backend, buf, 4 * BUFFER_LEN));
+}
+
+static void test_detector_with_missing_freq(struct audio_signal *signal,
+					    enum audio_detector_backend backend)
+{
+	double buf[4 * BUFFER_LEN];
+	struct audio_signal *missing;
+	size_t i;
+
+	missing = audio_signal_init(CHANNELS, SAMPLING_RATE);
+	for (i = 1; i < test_freqs_len; i++)
+		audio_signal_add_frequency(missing, test_freqs[i], 0);
+	audio_signal_synthesize(missing);
+
+	audio_signal_fill(missing, buf, 4 * BUFFER_LEN / CHANNELS);
+	igt_assert(!detector_run(signal, backend, buf, 4 * BUFFER_LEN));
+
+	audio_signal_fini(missing);
+}
+
+static void test_detector_with_unexpected_freq(struct audio_signal *signal,
+					       enum audio_detector_backend backend)
+{
+	double buf[4 * BUFFER_LEN];
+	struct audio_signal *extra;
+	size_t i;
+
+	extra = audio_signal_init(CHANNELS, SAMPLING_RATE);
+	for (i = 0; i < test_freqs_len; i++)
+		audio_signal_add_frequency(extra, test_freqs[i], 0);
+	audio_signal_add_frequency(extra, TEST_EXTRA_FREQ, 0);
+	audio_signal_synthesize(extra);
+
+	audio_signal_fill(extra, buf, 4 * BUFFER_LEN / CHANNELS);
+	igt_assert(!detector_run(signal, backend, buf, 4 * BUFFER_LEN));
+
+	audio_signal_fini(extra);
+}
+
+#define AGREEMENT_LEN (8 * BUFFER_LEN)
+
+enum impairment {
+	WHITE_NOISE,
+	HIGHPASS_NOISE,
+	EXTRA_TONE,
+	DC_OFFSET,
+	NEGATIVE_DC_OFFSET,
+	HELD_SAMPLES,
+	DROPPED_SAMPLES,
+	QUANTIZATION,
+};
+
+static double gaussian_noise(void)
+{
+	double u = (random() + 1.0) / (RAND_MAX + 2.0);
+	double v = (random() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void impair(double *buf, const double *clean, int sampling_rate,
+		   enum impairment type, double level)
+{
+	double prev = 0, n, q;
+	size_t i, j, skip = 0;
+
+	srandom(level * 1e6);
+
+	for (i = 0; i < AGREEMENT_LEN; i++) {
+		switch (type) {
+		case WHITE_NOISE:
+			buf[i] = clean[i] + level * gaussian_noise();
+			break;
+		case HIGHPASS_NOISE:
+			/* No energy left in the noise band checked by both */
+			n = gaussian_noise();
+			buf[i] = clean[i] + level * (n - prev) / 2;
+			prev = n;
+			break;
+		case EXTRA_TONE:
+			buf[i] = clean[i] +
+				 level * sin(2 * M_PI * 1234.5 * i / sampling_rate);
+			break;
+		case DC_OFFSET:
+			buf[i] = clean[i] + level;
+			break;
+		case NEGATIVE_DC_OFFSET:
+			buf[i] = clean[i] - level;
+			break;
+		case HELD_SAMPLES:
+			j = i % (BUFFER_LEN / 3);
+			buf[i] = j && j < level ? buf[i - 1] : clean[i];
+			break;
+		case DROPPED_SAMPLES:
+			if (i % (BUFFER_LEN / 2) == BUFFER_LEN / 4)
+				skip += (size_t)level;
+			buf[i] = clean[(i + skip) % (2 * AGREEMENT_LEN)];
+			break;
+		case QUANTIZATION:
+			q = 1 << ((int)level - 1);
+			buf[i] = round(clean[i] * q) / q;
+			break;
+		}
+	}
+}
+
+/*
+ * The Goertzel detector is a cheaper stand-in for the FFT one, make sure it
+ * reaches the same verdict on every window of signals impaired in various
+ * ways and to various degrees, on both sides of the thresholds.
+ */
+static void test_detector_agreement(int sampling_rate)
+{
+	static const struct {
+		enum impairment type;
+		double from, to, factor;
+	} sweeps[] = {
+		{ WHITE_NOISE, 1e-3, 0.05, 1.25 },
+		{ HIGHPASS_NOISE, 0.02, 0.6, 1.25 },
+		{ EXTRA_TONE, 0.02, 0.3, 1.1 },
+		{ DC_OFFSET, 1e-4, 3e-3, 1.25 },
+		{ NEGATIVE_DC_OFFSET, 1e-4, 3e-3, 1.25 },
+		{ HELD_SAMPLES, 2, 12, 1.5 },
+		{ DROPPED_SAMPLES, 1, 12, 1.5 },
+		{ QUANTIZATION, 4, 10, 1.25 },
+	};
+	struct audio_detector_stats goertzel_stats, fft_stats;
+	struct audio_detector *goertzel, *fft;
+	struct audio_signal *signal;
+	double *clean, *buf, level;
+	size_t i, j, detected = 0, windows = 0;
+
+	signal = audio_signal_init(CHANNELS, sampling_rate);
+	for (i = 0; i < test_freqs_len; i++)
+		audio_signal_add_frequency(signal, test_freqs[i], 0);
+	audio_signal_synthesize(signal);
+
+	clean = malloc(2 * AGREEMENT_LEN * sizeof(double));
+	buf = malloc(AGREEMENT_LEN * sizeof(double));
+	igt_assert(clean && buf);
+	audio_signal_fill(signal, clean, 2 * AGREEMENT_LEN / CHANNELS);
+
+	for (i = 0; i < ARRAY_SIZE(sweeps); i++) {
+		for (level = sweeps[i].from; level <= sweeps[i].to;
+		     level *= sweeps[i].factor) {
+			impair(buf, clean, sampling_rate, sweeps[i].type, level);
+
+			goertzel = audio_detector_init(signal, sampling_rate, 0,
+						       BUFFER_LEN,
+						       BUFFER_LEN / 4,
+						       AUDIO_DETECTOR_GOERTZEL);
+			fft = audio_detector_init(signal, sampling_rate, 0,
+						  BUFFER_LEN, BUFFER_LEN / 4,
+						  AUDIO_DETECTOR_FFT);
+
+			for (j = 0; j < AGREEMENT_LEN; j += BUFFER_LEN / 4) {
+				audio_detector_push(goertzel, buf + j,
+						    BUFFER_LEN / 4);
+				audio_detector_push(fft, buf + j,
+						    BUFFER_LEN / 4);
+
+				audio_detector_get_stats(goertzel,
+							 &goertzel_stats);
+				audio_detector_get_stats(fft, &fft_stats);
+				if (!fft_stats.windows)
+					continue;
+
+				igt_assert_f(goertzel_stats.last == fft_stats.last,
+					     "Impairment %d, level %g, window %zu: "
+					     "goertzel %s, fft %s\n",
+					     sweeps[i].type, level,
+					     fft_stats.windows - 1,
+					     goertzel_stats.last ? "detected" : "rejected",
+					     fft_stats.last ? "detected" : "rejected");
+			}
+
+			detected += fft_stats.detected;
+			windows += fft_stats.windows;
+
+			audio_detector_fini(goertzel);
+			audio_detector_fini(fft);
+		}
+	}
+
+	/* Both verdicts must have been exercised for this to mean anything */
+	igt_assert(detected > windows / 4 && detected < windows * 3 / 4);
+
+	free(buf);
+	free(clean);
+	audio_signal_fini(signal);
+}
+
+static void test_detector_wav_file(struct audio_signal *signal)
+{
+	char tmpdir[] = "/tmp/igt_audio.XXXXXX";
+	struct audio_signal *stereo;
+	struct audio_detector *det[3];
+	struct audio_detector_stats stats;
+	double buf[4 * BUFFER_LEN * 2];
+	int32_t pcm[4 * BUFFER_LEN * 2], chunk[256 * 2];
+	uint32_t rate;
+	uint16_t channels;
+	char *path;
+	ssize_t len;
+	size_t i;
+	int fd;
+
+	/* Two channels with different frequencies */
+	stereo = audio_signal_init(2, SAMPLING_RATE);
+	for (i = 0; i < test_freqs_len; i++) {
+		audio_signal_add_frequency(stereo, test_freqs[i], 0);
+		audio_signal_add_frequency(stereo, 2 * test_freqs[i], 1);
+	}
+	audio_signal_synthesize(stereo);
+	audio_signal_fill(stereo, buf, 4 * BUFFER_LEN);
+	audio_convert_to(pcm, buf, 4 * BUFFER_LEN * 2, SND_PCM_FORMAT_S32_LE);
+
+	igt_assert(mkdtemp(tmpdir));
+	igt_frame_dump_path = tmpdir;
+	fd = audio_create_wav_file_s32_le("detector", SAMPLING_RATE, 2, &path);
+	igt_assert(fd >= 0);
+	igt_assert_eq(write(fd, pcm, sizeof(pcm)), sizeof(pcm));
+	close(fd);
+
+	fd = audio_open_wav_file_s32_le(path, &rate, &channels);
+	igt_assert(fd >= 0);
+	igt_assert_eq(rate, SAMPLING_RATE);
+	igt_assert_eq(channels, 2);
+
+	/* det[2] looks for the frequencies of channel 1 in channel 0 */
+	for (i = 0; i < ARRAY_SIZE(det); i++)
+		det[i] = audio_detector_init(stereo, rate, i ? 1 : 0, BUFFER_LEN,
+					     BUFFER_LEN, AUDIO_DETECTOR_GOERTZEL);
+
+	while ((len = read(fd, chunk, sizeof(chunk))) > 0) {
+		audio_detector_push_s32_le(det[0], chunk, len / sizeof(int32_t),
+					   channels, 0);
+		audio_detector_push_s32_le(det[1], chunk, len / sizeof(int32_t),
+					   channels, 1);
+		audio_detector_push_s32_le(det[2], chunk, len / sizeof(int32_t),
+					   channels, 0);
+	}
+	close(fd);
+
+	for (i = 0; i < 2; i++) {
+		audio_detector_get_stats(det[i], &stats);
+		igt_assert_eq(stats.windows, 4);
+		igt_assert_eq(stats.detected, 4);
+	}
+
+	audio_detector_get_stats(det[2], &stats);
+	igt_assert_eq(stats.windows, 4);
+	igt_assert_eq(stats.detected, 0);
+
+	for (i = 0; i < ARRAY_SIZE(det); i++)
+		audio_detector_fini(det[i]);
+	audio_signal_fini(stereo);
+
+	unlink(path);
+	free(path);
+	rmdir(tmpdir);
+	igt_frame_dump_path = NULL;
+}
+
 igt_main
 {
+	static const struct {
+		const char *name;
+		enum audio_detector_backend backend;
+	} backends[] = {
+		{ "goertzel", AUDIO_DETECTOR_GOERTZEL },
+		{ "fft", AUDIO_DETECTOR_FFT },
+	};
 	struct audio_signal *signal = NULL;
 	int ret;
 	size_t i;
@@ -215,6 +523,35 @@ igt_main
 		igt_subtest("signal-detect-phaseshift")
 			test_signal_detect_phaseshift(signal);
 
+		for (i = 0; i < ARRAY_SIZE(backends); i++) {
+			igt_subtest_f("%s-detect-untampered", backends[i].name)
+				test_detector_untampered(signal,
+							 backends[i].backend);
+
+			igt_subtest_f("%s-detect-silence", backends[i].name)
+				test_detector_silence(signal,
+						      backends[i].backend);
+
+			igt_subtest_f("%s-detect-with-missing-freq",
+				      backends[i].name)
+				test_detector_with_missing_freq(signal,
+								backends[i].backend);
+
+			igt_subtest_f("%s-detect-with-unexpected-freq",
+				      backends[i].name)
+				test_detector_with_unexpected_freq(signal,
+								   backends[i].backend);
+		}
+
+		igt_subtest("goertzel-detect-wav-file")
+			test_detector_wav_file(signal);
+
+		igt_subtest("goertzel-fft-agreement")
+			test_detector_agreement(SAMPLING_RATE);
+
+		igt_subtest("goertzel-fft-agreement-48khz")
+			test_detector_agreement(48000);
+
 		igt_fixture {
 			audio_signal_fini(signal);
 		}
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_benchmark.h"
+#include "igt_core.h"
+
+IGT_TEST_DESCRIPTION("Check the benchmark harness and comparing its results");
+
+struct sequence {
+	const double *values;
+	unsigned int count, next;
+};
+
+static double next_value(void *data)
+{
+	struct sequence *s = data;
+
+	igt_assert(s->next < s->count);
+	return s->values[s->next++];
+}
+
+static void option(struct igt_benchmark *b, int opt, const char *arg)
+{
+	igt_assert_eq(igt_benchmark_option(b, opt, arg), 0);
+}
+
+static void test_run(void)
+{
+	/* Two warm-up runs, then an outlier among the samples */
+	static const double values[] = {
+		500, 500, 10, 11, 10, 12, 1000, 11, 10,
+	};
+	struct sequence s = { values, ARRAY_SIZE(values) };
+	const struct igt_benchmark_result *r;
+	struct igt_benchmark *b;
+
+	b = igt_benchmark_create("test");
+	igt_assert(b);
+	option(b, IGT_BENCHMARK_OPT_WARMUP, "2");
+	option(b, IGT_BENCHMARK_OPT_REPEAT, "7");
+
+	r = igt_benchmark_run(b, "values", "ns", false, next_value, &s);
+	igt_assert(r);
+	igt_assert_eq(s.next, s.count);
+	igt_assert_eq(r->nr_samples, 6);
+	igt_assert_eq(r->nr_outliers, 1);
+	igt_assert(r->median == 10.5);
+	igt_assert(r->min == 10 && r->max == 12);
+	igt_assert(fabs(r->mean - 64 / 6.) < 1e-9);
+	igt_assert(!strcmp(r->name, "values") && !strcmp(r->unit, "ns"));
+	igt_assert(!r->higher_is_better);
+
+	igt_assert_eq(igt_benchmark_option(b, IGT_BENCHMARK_OPT_REPEAT, "0"),
+		      -EINVAL);
+	igt_assert_eq(igt_benchmark_option(b, IGT_BENCHMARK_OPT_CPU, "x"),
+		      -EINVAL);
+	igt_assert_eq(igt_benchmark_option(b, 'x', NULL), -ENOENT);
+
+	igt_assert_eq(igt_benchmark_finish(b), 0);
+}
+
+static void test_json(void)
+{
+	static const double values[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	struct sequence s = { values, ARRAY_SIZE(values) };
+	char filename[] = "/tmp/igt_benchmark.XXXXXX";
+	struct igt_benchmark_results *results;
+	const struct igt_benchmark_result *r;
+	struct igt_benchmark *b;
+	int fd;
+
+	fd = mkstemp(filename);
+	igt_assert(fd >= 0);
+	close(fd);
+
+	b = igt_benchmark_create("test \"json\"");
+	igt_assert(b);
+	option(b, IGT_BENCHMARK_OPT_WARMUP, "0");
+	option(b, IGT_BENCHMARK_OPT_REPEAT, "4");
+	option(b, IGT_BENCHMARK_OPT_JSON, filename);
+	igt_benchmark_param(b, "size", "%d", 4096);
+
+	igt_assert(igt_benchmark_run(b, "first", "MiB/s", true,
+				     next_value, &s));
+	igt_assert(igt_benchmark_run(b, "second\tone", "us", false,
+				     next_value, &s));
+	igt_assert_eq(igt_benchmark_finish(b), 0);
+
+	igt_assert_eq(igt_benchmark_load(filename, &results), 0);
+	unlink(filename);
+
+	igt_assert(!strcmp(results->benchmark, "test \"json\""));
+	igt_assert_eq(results->nr_results, 2);
+	igt_assert(!igt_benchmark_find(results, "third"));
+
+	r = igt_benchmark_find(results, "first");
+	igt_assert(r && r == &results->results[0]);
+	igt_assert(!strcmp(r->unit, "MiB/s") && r->higher_is_better);
+	igt_assert_eq(r->nr_samples, 4);
+	igt_assert(!memcmp(r->samples, values, 4 * sizeof(*values)));
+	igt_assert(r->median == 2.5);
+
+	r = igt_benchmark_find(results, "second\tone");
+	igt_assert(r && !r->higher_is_better);
+	igt_assert(!memcmp(r->samples, values + 4, 4 * sizeof(*values)));
+	igt_assert(r->min == 5 && r->max == 8);
+
+	igt_benchmark_results_free(results);
+}
+
+static int parse(const char *json, struct igt_benchmark_results **out)
+{
+	return igt_benchmark_parse(json, strlen(json), out);
+}
+
+static void test_parse(void)
+{
+	struct igt_benchmark_results *results;
+
+	/* Unknown keys are skipped, whatever they hold */
+	igt_assert_eq(parse("{ \"version\": 1, \"benchmark\": \"b\\u0041\","
+			    "  \"extra\": [ { \"a\": [ true, null ] }, -1e3 ],"
+			    "  \"results\": [ { \"name\": \"r\","
+			    "    \"unit\": \"s\", \"higher_is_better\": false,"
+			    "    \"median\": 123, \"samples\": [ 3, 1, 2 ]"
+			    "  } ] }", &results), 0);
+	igt_assert(!strcmp(results->benchmark, "bA"));
+	igt_assert_eq(results->nr_results, 1);
+	igt_assert(results->results[0].median == 2);
+	igt_benchmark_results_free(results);
+
+	igt_assert_eq(parse("{ \"version\": 2, \"benchmark\": \"b\","
+			    "  \"results\": [ ] }", &results), -EPROTO);
+	igt_assert_eq(parse("{ \"version\": 1, \"benchmark\": \"b\","
+			    "  \"results\": [ ", &results), -EINVAL);
+	igt_assert_eq(parse("{ \"version\": 1, \"benchmark\": \"b\","
+			    "  \"results\": [ { \"name\": \"r\" } ] }",
+			    &results), -EINVAL);
+	igt_assert_eq(parse("{ \"version\": 1 } trailing", &results),
+		      -EINVAL);
+	igt_assert_eq(parse("", &results), -EINVAL);
+}
+
+/* Results of the samples, parsed like a file of them would be */
+static struct igt_benchmark_results *
+result(const double *samples, unsigned int count, bool higher_is_better)
+{
+	struct igt_benchmark_results *results;
+	char json[1024];
+	int len;
+
+	len = snprintf(json, sizeof(json),
+		       "{ \"version\": 1, \"benchmark\": \"b\", \"results\": "
+		       "[ { \"name\": \"r\", \"unit\": \"s\", "
+		       "\"higher_is_better\": %s, \"samples\": [ ",
+		       higher_is_better ? "true" : "false");
+	for (unsigned int i = 0; i < count; i++)
+		len += snprintf(json + len, sizeof(json) - len, "%s%.17g",
+				i ? ", " : "", samples[i]);
+	snprintf(json + len, sizeof(json) - len, " ] } ] }");
+
+	igt_assert_eq(parse(json, &results), 0);
+	igt_assert_eq(results->nr_results, 1);
+
+	return results;
+}
+
+#define compare(base, result) \
+	igt_benchmark_compare(&(base)->results[0], &(result)->results[0], \
+			      0.05, 0.02, &c)
+
+static void test_compare(void)
+{
+	static const double a[] = { 1, 2, 3, 4, 5 };
+	static const double b[] = { 2, 3, 4, 5, 6 };
+	static const double base[] = { 100, 101, 99, 100, 100.5, 99.5 };
+	static const double slower[] = { 90, 91, 89, 90, 90.5, 89.5 };
+	static const double close[] = { 99, 100, 98, 99, 99.5, 98.5 };
+	static const double noisy[] = { 60, 140, 70, 130, 50, 90 };
+	struct igt_benchmark_results *ra, *rb, *rbase, *rslower, *rclose;
+	struct igt_benchmark_results *rnoisy;
+	struct igt_benchmark_comparison c;
+
+	/* Welch's t-test of t = -1 over 8 degrees of freedom */
+	ra = result(a, ARRAY_SIZE(a), true);
+	rb = result(b, ARRAY_SIZE(b), true);
+	compare(ra, rb);
+	igt_assert(fabs(c.p - 0.34659) < 1e-4);
+	igt_assert(fabs(c.change - 1 / 3.) < 1e-9);
+	igt_assert(!c.regression && !c.improvement);
+
+	rbase = result(base, ARRAY_SIZE(base), true);
+	rslower = result(slower, ARRAY_SIZE(slower), true);
+	compare(rbase, rslower);
+	igt_assert(c.p < 1e-6);
+	igt_assert(c.regression && !c.improvement);
+
+	compare(rslower, rbase);
+	igt_assert(!c.regression && c.improvement);
+
+	/* Lower is better the other way around */
+	rbase->results[0].higher_is_better = false;
+	compare(rbase, rslower);
+	igt_assert(!c.regression && c.improvement);
+	rbase->results[0].higher_is_better = true;
+
+	/* Significant, but below the threshold */
+	rclose = result(close, ARRAY_SIZE(close), true);
+	compare(rbase, rclose);
+	igt_assert(c.p < 0.05);
+	igt_assert(!c.regression && !c.improvement);
+
+	/* A large change, but lost in the noise */
+	rnoisy = result(noisy, ARRAY_SIZE(noisy), true);
+	compare(rbase, rnoisy);
+	igt_assert(c.change < -0.02 && c.p > 0.05);
+	igt_assert(!c.regression && !c.improvement);
+
+	compare(rbase, rbase);
+	igt_assert(c.p == 1 && c.change == 0);
+
+	igt_benchmark_results_free(ra);
+	igt_benchmark_results_free(rb);
+	igt_benchmark_results_free(rbase);
+	igt_benchmark_results_free(rslower);
+	igt_benchmark_results_free(rclose);
+	igt_benchmark_results_free(rnoisy);
+}
+
+igt_main
+{
+	igt_subtest("run")
+		test_run();
+
+	igt_subtest("json")
+		test_json();
+
+	igt_subtest("parse")
+		test_parse();
+
+	igt_subtest("compare")
+		test_compare();
+}
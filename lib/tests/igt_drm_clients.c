@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_drm_clients.h"
+
+IGT_TEST_DESCRIPTION("Check DRM client discovery against a fake /proc");
+
+#define MANY_CLIENTS 300
+
+static char root[] = "/tmp/igt-drm-clients-XXXXXX";
+static unsigned int null_major;
+
+static void write_file(const char *path, const char *content)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	igt_assert(fd >= 0);
+	igt_assert_eq(write(fd, content, strlen(content)), strlen(content));
+	close(fd);
+}
+
+static void add_pid(unsigned int pid, const char *name)
+{
+	char path[256], stat[128];
+
+	snprintf(path, sizeof(path), "%s/%u", root, pid);
+	igt_assert_eq(mkdir(path, 0755), 0);
+	snprintf(path, sizeof(path), "%s/%u/fd", root, pid);
+	igt_assert_eq(mkdir(path, 0755), 0);
+	snprintf(path, sizeof(path), "%s/%u/fdinfo", root, pid);
+	igt_assert_eq(mkdir(path, 0755), 0);
+
+	snprintf(path, sizeof(path), "%s/%u/stat", root, pid);
+	snprintf(stat, sizeof(stat), "%u (%s) S 1 %u %u 0 -1\n", pid, name, pid, pid);
+	write_file(path, stat);
+}
+
+static void set_fdinfo(unsigned int pid, unsigned int fd,
+		       unsigned long id, unsigned long render_ns)
+{
+	char path[256], fdinfo[256];
+
+	snprintf(path, sizeof(path), "%s/%u/fdinfo/%u", root, pid, fd);
+	if (id)
+		snprintf(fdinfo, sizeof(fdinfo),
+			 "pos:\t0\nflags:\t02100002\nmnt_id:\t24\n"
+			 "drm-driver:\ti915\ndrm-client-id:\t%lu\n"
+			 "drm-engine-render:\t%lu ns\n", id, render_ns);
+	else
+		snprintf(fdinfo, sizeof(fdinfo),
+			 "pos:\t0\nflags:\t02100002\nmnt_id:\t24\n");
+	write_file(path, fdinfo);
+}
+
+/* A DRM fd when @id is non zero, /dev/null standing in for the DRM device. */
+static void add_fd(unsigned int pid, unsigned int fd,
+		   unsigned long id, unsigned long render_ns)
+{
+	char path[256], target[256];
+
+	if (id)
+		snprintf(target, sizeof(target), "/dev/null");
+	else
+		snprintf(target, sizeof(target), "%s/regular", root);
+
+	snprintf(path, sizeof(path), "%s/%u/fd/%u", root, pid, fd);
+	igt_assert_eq(symlink(target, path), 0);
+	set_fdinfo(pid, fd, id, render_ns);
+}
+
+static void remove_fd(unsigned int pid, unsigned int fd)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%u/fd/%u", root, pid, fd);
+	igt_assert_eq(unlink(path), 0);
+	snprintf(path, sizeof(path), "%s/%u/fdinfo/%u", root, pid, fd);
+	igt_assert_eq(unlink(path), 0);
+}
+
+static int remove_entry(const char *path, const struct stat *st,
+			int flag, struct FTW *ftw)
+{
+	return remove(path);
+}
+
+static void remove_tree(const char *path)
+{
+	igt_assert_eq(nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS), 0);
+}
+
+static void remove_pid(unsigned int pid)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%u", root, pid);
+	remove_tree(path);
+}
+
+static struct igt_drm_client *
+find_client(struct igt_drm_clients *clients, unsigned long id)
+{
+	struct igt_drm_client *c, *found = NULL;
+	int tmp;
+
+	igt_for_each_drm_client(clients, c, tmp) {
+		if (c->status != IGT_DRM_CLIENT_ALIVE || c->id != id)
+			continue;
+		igt_assert_f(!found, "client %lu listed twice\n", id);
+		found = c;
+	}
+
+	return found;
+}
+
+static unsigned int count_alive(struct igt_drm_clients *clients)
+{
+	struct igt_drm_client *c;
+	unsigned int n = 0;
+	int tmp;
+
+	igt_for_each_drm_client(clients, c, tmp)
+		n += c->status == IGT_DRM_CLIENT_ALIVE;
+
+	return n;
+}
+
+static int cmp_id(const void *_a, const void *_b, void *ctx)
+{
+	const struct igt_drm_client *a = _a, *b = _b;
+
+	return a->id < b->id ? 1 : a->id > b->id ? -1 : 0;
+}
+
+/* Like the tools, keep alive clients sorted first after each scan. */
+static void scan(struct igt_drm_clients *clients)
+{
+	igt_drm_clients_scan(clients, NULL, NULL, 0, NULL, 0);
+	igt_drm_clients_sort(clients, cmp_id);
+}
+
+static void test_lifetime(void)
+{
+	struct igt_drm_clients *clients = igt_drm_clients_init(NULL);
+	struct igt_drm_client *c;
+
+	igt_assert(clients);
+	igt_assert_eq(igt_drm_clients_set_proc(clients, root, null_major), 0);
+
+	add_pid(100, "app");
+	add_fd(100, 3, 7, 1000);
+	add_fd(100, 4, 0, 0);
+	add_pid(200, "game");
+	add_fd(200, 5, 8, 500);
+	add_fd(200, 6, 8, 500); /* dup() of the same client */
+	add_pid(300, "shell");
+	add_fd(300, 0, 0, 0);
+
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 2);
+	c = find_client(clients, 7);
+	igt_assert(c);
+	igt_assert_eq(c->pid, 100);
+	igt_assert(!strcmp(c->name, "app"));
+	igt_assert_eq(c->drm_minor, minor(makedev(null_major, 3)));
+	c = find_client(clients, 8);
+	igt_assert(c);
+	igt_assert_eq(c->pid, 200);
+
+	/* Busyness of known clients is updated */
+	set_fdinfo(100, 3, 7, 3000);
+	scan(clients);
+	c = find_client(clients, 7);
+	igt_assert(c);
+	igt_assert_eq(c->agg_delta_engine_time, 2000);
+	igt_assert_eq(c->samples, 2);
+
+	/* New file descriptors are found */
+	add_fd(100, 9, 9, 100);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 3);
+	igt_assert(find_client(clients, 9));
+
+	/* Exited processes and closed file descriptors are dropped */
+	remove_pid(200);
+	remove_fd(100, 3);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 1);
+	igt_assert(!find_client(clients, 7));
+	igt_assert(!find_client(clients, 8));
+	igt_assert(find_client(clients, 9));
+
+	remove_pid(100);
+	remove_pid(300);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 0);
+
+	igt_drm_clients_free(clients);
+}
+
+static void test_fd_reuse(void)
+{
+	struct igt_drm_clients *clients = igt_drm_clients_init(NULL);
+
+	igt_assert(clients);
+	igt_assert_eq(igt_drm_clients_set_proc(clients, root, null_major), 0);
+
+	add_pid(100, "app");
+	add_fd(100, 3, 7, 1000);
+	add_fd(100, 4, 0, 0);
+
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 1);
+
+	/* fd 4 closed and reopened on a DRM device, same number of fds */
+	remove_fd(100, 4);
+	add_fd(100, 4, 8, 500);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 2);
+	igt_assert(find_client(clients, 8));
+
+	/* And the DRM fd 3 reused for a regular file */
+	remove_fd(100, 3);
+	add_fd(100, 3, 0, 0);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 1);
+	igt_assert(!find_client(clients, 7));
+	igt_assert(find_client(clients, 8));
+
+	remove_pid(100);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 0);
+
+	igt_drm_clients_free(clients);
+}
+
+static void test_many(void)
+{
+	struct igt_drm_clients *clients = igt_drm_clients_init(NULL);
+
+	igt_assert(clients);
+	igt_assert_eq(igt_drm_clients_set_proc(clients, root, null_major), 0);
+
+	for (unsigned int i = 0; i < MANY_CLIENTS; i++) {
+		add_pid(1000 + i, "worker");
+		add_fd(1000 + i, 3, 0, 0);
+		add_fd(1000 + i, 4, 100 + i, i);
+	}
+
+	scan(clients);
+	igt_assert_eq(count_alive(clients), MANY_CLIENTS);
+
+	/* Sorting reordered the client array under the lookup index */
+	for (unsigned int i = 0; i < MANY_CLIENTS; i++)
+		set_fdinfo(1000 + i, 4, 100 + i, 2 * i);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), MANY_CLIENTS);
+
+	for (unsigned int i = 0; i < MANY_CLIENTS; i++) {
+		struct igt_drm_client *c = find_client(clients, 100 + i);
+
+		igt_assert(c);
+		igt_assert_eq(c->pid, 1000 + i);
+		igt_assert_eq(c->agg_delta_engine_time, i);
+		igt_assert_eq(c->samples, 2);
+	}
+
+	for (unsigned int i = 0; i < MANY_CLIENTS; i++)
+		remove_pid(1000 + i);
+	scan(clients);
+	igt_assert_eq(count_alive(clients), 0);
+
+	igt_drm_clients_free(clients);
+}
+
+igt_main
+{
+	igt_fixture {
+		struct stat st;
+		char path[256];
+
+		igt_require(stat("/dev/null", &st) == 0 && S_ISCHR(st.st_mode));
+		null_major = major(st.st_rdev);
+
+		igt_assert(mkdtemp(root));
+		snprintf(path, sizeof(path), "%s/regular", root);
+		write_file(path, "");
+	}
+
+	igt_subtest("lifetime")
+		test_lifetime();
+
+	igt_subtest("fd-reuse")
+		test_fd_reuse();
+
+	igt_subtest("many")
+		test_many();
+
+	igt_fixture
+		remove_tree(root);
+}
@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_core.h"
+#include "igt_drm_fdinfo.h"
+
+IGT_TEST_DESCRIPTION("Check the fdinfo parser against synthetic fdinfo files");
+
+static const char i915_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t26\n"
+	"ino:\t1077\n"
+	"drm-driver:\ti915\n"
+	"drm-client-id:\t42\n"
+	"drm-pdev:\t0000:00:02.0\n"
+	"drm-total-system0:\t4 KiB\n"
+	"drm-shared-system0:\t0\n"
+	"drm-active-system0:\t0\n"
+	"drm-resident-system0:\t4 KiB\n"
+	"drm-purgeable-system0:\t0\n"
+	"drm-engine-render:\t9288864723 ns\n"
+	"drm-engine-copy:\t2035071108 ns\n"
+	"drm-engine-video:\t0 ns\n"
+	"drm-engine-capacity-video:\t2\n"
+	"drm-engine-video-enhance:\t7 ns\n";
+
+static const char xe_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t0100002\n"
+	"mnt_id:\t25\n"
+	"drm-driver:\txe\n"
+	"drm-client-id:\t7\n"
+	"drm-pdev:\t0000:03:00.0\n"
+	"drm-total-system:\t0\n"
+	"drm-shared-system:\t0\n"
+	"drm-active-system:\t0\n"
+	"drm-resident-system:\t0\n"
+	"drm-purgeable-system:\t0\n"
+	"drm-total-gtt:\t128 KiB\n"
+	"drm-resident-gtt:\t128 KiB\n"
+	"drm-total-vram0:\t23 MiB\n"
+	"drm-resident-vram0:\t23 MiB\n"
+	"drm-cycles-rcs:\t28257900\n"
+	"drm-total-cycles-rcs:\t7655183225\n"
+	"drm-cycles-bcs:\t0\n"
+	"drm-total-cycles-bcs:\t7655183225\n"
+	"drm-cycles-vcs:\t0\n"
+	"drm-total-cycles-vcs:\t7655183225\n"
+	"drm-engine-capacity-vcs:\t2\n"
+	"drm-cycles-vecs:\t0\n"
+	"drm-total-cycles-vecs:\t7655183225\n"
+	"drm-cycles-ccs:\t0\n"
+	"drm-total-cycles-ccs:\t7655183225\n";
+
+static const char amdgpu_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t24\n"
+	"drm-driver:\tamdgpu\n"
+	"drm-client-id:\t3\n"
+	"drm-pdev:\t0000:0a:00.0\n"
+	"pasid:\t32770\n"
+	"drm-memory-vram:\t1024 KiB\n"
+	"drm-memory-gtt:\t2048 KiB\n"
+	"drm-memory-cpu:\t0 KiB\n"
+	"amd-memory-visible-vram:\t0 KiB\n"
+	"amd-evicted-vram:\t0 KiB\n"
+	"drm-engine-gfx:\t123456 ns\n"
+	"drm-engine-compute:\t0 ns\n"
+	"drm-engine-dma:\t0 ns\n"
+	"drm-engine-dec:\t0 ns\n"
+	"drm-engine-enc:\t0 ns\n"
+	"drm-engine-enc_1:\t0 ns\n"
+	"drm-engine-jpeg:\t0 ns\n";
+
+static const char msm_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t24\n"
+	"drm-driver:\tmsm\n"
+	"drm-client-id:\t3\n"
+	"drm-engine-gpu:\t1234567 ns\n"
+	"drm-cycles-gpu:\t22334455\n"
+	"drm-maxfreq-gpu:\t680000000 Hz\n"
+	"drm-total-memory:\t1 GiB\n"
+	"drm-shared-memory:\t0\n"
+	"drm-active-memory:\t0\n"
+	"drm-resident-memory:\t1024 KiB\n"
+	"drm-purgeable-memory:\t0\n";
+
+static const char *i915_engines[] = {
+	"render",
+	"copy",
+	"video",
+	"video-enhance",
+	"compute",
+};
+
+static const char *i915_regions[] = {
+	"system0",
+	"local0",
+};
+
+static char root[] = "/tmp/igt-drm-fdinfo-XXXXXX";
+static int dir = -1;
+
+static void write_file(const char *name, const char *content)
+{
+	int fd = openat(dir, name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	igt_assert(fd >= 0);
+	igt_assert_eq(write(fd, content, strlen(content)), strlen(content));
+	close(fd);
+}
+
+static void check_i915(const struct drm_client_fdinfo *info, bool mapped)
+{
+	igt_assert(!strcmp(info->driver, "i915"));
+	igt_assert(!strcmp(info->pdev, "0000:00:02.0"));
+	igt_assert_eq(info->id, 42);
+	igt_assert_eq(info->num_engines, 4);
+	igt_assert_eq(info->num_regions, 1);
+	igt_assert_eq(info->utilization_mask, DRM_FDINFO_UTILIZATION_ENGINE_TIME);
+
+	/* Auto-detected engines are numbered as they are found, like the map. */
+	igt_assert(mapped || !strcmp(info->names[3], "video-enhance"));
+	igt_assert_eq_u64(info->engine_time[0], 9288864723ull);
+	igt_assert_eq_u64(info->engine_time[1], 2035071108ull);
+	igt_assert_eq_u64(info->engine_time[3], 7);
+	igt_assert_eq(info->capacity[0], 1);
+	igt_assert_eq(info->capacity[2], 2);
+	igt_assert_eq(info->last_engine_index, 3);
+
+	igt_assert(!strcmp(info->region_names[0], "system0"));
+	igt_assert_eq_u64(info->region_mem[0].total, 4096);
+	igt_assert_eq_u64(info->region_mem[0].resident, 4096);
+}
+
+static void test_i915(void)
+{
+	struct drm_client_fdinfo info = { };
+
+	write_file("i915", i915_fdinfo);
+
+	/* Required keys, engines, one capacity and one region */
+	igt_assert_eq(__igt_parse_drm_fdinfo(dir, "i915", &info,
+					     NULL, 0, NULL, 0), 8);
+	check_i915(&info, false);
+
+	memset(&info, 0, sizeof(info));
+	igt_assert_eq(__igt_parse_drm_fdinfo(dir, "i915", &info,
+					     i915_engines, ARRAY_SIZE(i915_engines),
+					     i915_regions, ARRAY_SIZE(i915_regions)), 8);
+	check_i915(&info, true);
+}
+
+static void test_xe(void)
+{
+	struct drm_client_fdinfo info = { };
+	static const char *regions[] = { "system", "gtt", "vram0" };
+
+	write_file("xe", xe_fdinfo);
+
+	igt_assert_eq(__igt_parse_drm_fdinfo(dir, "xe", &info,
+					     NULL, 0, regions, ARRAY_SIZE(regions)),
+		      2 + 5 + 1 + 3);
+	igt_assert(!strcmp(info.driver, "xe"));
+	igt_assert_eq(info.utilization_mask,
+		      DRM_FDINFO_UTILIZATION_CYCLES |
+		      DRM_FDINFO_UTILIZATION_TOTAL_CYCLES);
+	igt_assert(!strcmp(info.names[0], "rcs"));
+	igt_assert(!strcmp(info.names[4], "ccs"));
+	igt_assert_eq_u64(info.cycles[0], 28257900);
+	igt_assert_eq_u64(info.total_cycles[4], 7655183225ull);
+	igt_assert_eq(info.capacity[2], 2);
+	igt_assert_eq(info.capacity[3], 1);
+	igt_assert_eq_u64(info.region_mem[1].total, 128 * 1024);
+	igt_assert_eq_u64(info.region_mem[2].resident, 23 * 1024 * 1024);
+	igt_assert(!strcmp(info.region_names[2], "vram0"));
+
+	/* Names match the map entries they are a prefix of */
+	memset(&info, 0, sizeof(info));
+	igt_assert_eq(__igt_parse_drm_fdinfo(dir, "xe", &info, NULL, 0,
+					     i915_regions, ARRAY_SIZE(i915_regions)),
+		      2 + 5 + 1 + 1);
+	igt_assert(!strcmp(info.region_names[0], "system"));
+}
+
+static void test_amdgpu(void)
+{
+	struct drm_client_fdinfo info = { };
+
+	write_file("amdgpu", amdgpu_fdinfo);
+
+	igt_assert_eq(__igt_parse_drm_fdinfo(dir, "amdgpu", &info,
+					     NULL, 0, NULL, 0), 2 + 7 + 3);
+	igt_assert(!strcmp(info.names[5], "enc_1"));
+	igt_assert_eq_u64(info.engine_time[0], 123456);
+	/* Legacy drm-memory- keys count as resident memory */
+	igt_assert(!strcmp(info.region_names[0], "vram"));
+	igt_assert_eq_u64(info.region_mem[0].resident, 1024 * 1024);
+	igt_assert_eq_u64(info.region_mem[1].resident, 2048 * 1024);
+	igt_assert_eq_u64(info.region_mem[0].total, 0);
+}
+
+static void test_msm(void)
+{
+	struct drm_client_fdinfo info = { };
+
+	write_file("msm", msm_fdinfo);
+
+	igt_assert_eq(__igt_parse_drm_fdinfo(dir, "msm", &info,
+					     NULL, 0, NULL, 0), 2 + 1 + 1);
+	igt_assert(info.pdev[0] == '\0');
+	igt_assert_eq(info.utilization_mask,
+		      DRM_FDINFO_UTILIZATION_ENGINE_TIME |
+		      DRM_FDINFO_UTILIZATION_CYCLES);
+	igt_assert_eq_u64(info.engine_time[0], 1234567);
+	igt_assert_eq_u64(info.cycles[0], 22334455);
+	igt_assert(!strcmp(info.region_names[0], "memory"));
+	igt_assert_eq_u64(info.region_mem[0].total, 1024ull * 1024 * 1024);
+}
+
+static void test_batch(void)
+{
+	static const char * const files[] = {
+		"i915", "plain", "missing", "i915", "truncated",
+	};
+	struct drm_client_fdinfo infos[ARRAY_SIZE(files)];
+	unsigned int results[ARRAY_SIZE(files)];
+	struct igt_drm_fdinfo_parser *parser;
+
+	write_file("i915", i915_fdinfo);
+	write_file("plain", "pos:\t0\nflags:\t02\nmnt_id:\t24\n");
+	write_file("truncated", "drm-driver:\ti915\ndrm-client-id:\t1\ndrm-eng");
+
+	parser = igt_drm_fdinfo_parser_create(i915_engines,
+					      ARRAY_SIZE(i915_engines),
+					      i915_regions,
+					      ARRAY_SIZE(i915_regions));
+	igt_assert(parser);
+
+	/* The parser and the output are reused, nothing leaks across files */
+	for (int pass = 0; pass < 2; pass++) {
+		igt_assert_eq(igt_drm_fdinfo_parse_batch(parser, dir, files,
+							 ARRAY_SIZE(files),
+							 infos, results), 2);
+		igt_assert_eq(results[0], 8);
+		igt_assert_eq(results[1], 0);
+		igt_assert_eq(results[2], 0);
+		igt_assert_eq(results[3], 8);
+		igt_assert_eq(results[4], 0);
+		check_i915(&infos[0], true);
+		check_i915(&infos[3], true);
+	}
+
+	igt_drm_fdinfo_parser_destroy(parser);
+}
+
+igt_main
+{
+	igt_fixture {
+		igt_assert(mkdtemp(root));
+		dir = open(root, O_DIRECTORY | O_RDONLY);
+		igt_assert(dir >= 0);
+	}
+
+	igt_subtest("i915")
+		test_i915();
+
+	igt_subtest("xe")
+		test_xe();
+
+	igt_subtest("amdgpu")
+		test_amdgpu();
+
+	igt_subtest("msm")
+		test_msm();
+
+	igt_subtest("batch")
+		test_batch();
+
+	igt_fixture {
+		static const char * const files[] = {
+			"i915", "xe", "amdgpu", "msm", "plain", "truncated",
+		};
+
+		for (unsigned int i = 0; i < ARRAY_SIZE(files); i++)
+			unlinkat(dir, files[i], 0);
+		close(dir);
+		rmdir(root);
+	}
+}
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "i915_drm.h"
+#include "igt_core.h"
+#include "igt_exec_replay.h"
+
+IGT_TEST_DESCRIPTION("Check replaying execbuf traces without a device");
+
+#define BATCH 1000
+#define MAX_EVENTS 64
+
+static struct igt_exec_trace_event events[MAX_EVENTS];
+static uint8_t records[MAX_EVENTS][128];
+static uint32_t tids[] = { 100, 101 };
+static struct igt_exec_trace trace = {
+	.events = events,
+	.tids = tids,
+	.nr_threads = sizeof(tids) / sizeof(tids[0]),
+	.timed = true,
+};
+
+static void event(unsigned int thread, uint64_t time_ns, uint8_t cmd,
+		  const void *data, size_t len)
+{
+	unsigned int i = trace.nr_events++;
+
+	igt_assert(i < MAX_EVENTS && 1 + len <= sizeof(records[i]));
+	records[i][0] = cmd;
+	memcpy(&records[i][1], data, len);
+
+	events[i] = (struct igt_exec_trace_event){
+		.time_ns = time_ns,
+		.thread = thread,
+		.cmd = cmd,
+		.record = records[i],
+		.len = 1 + len,
+	};
+}
+
+static void handle(unsigned int thread, uint64_t time_ns, uint8_t cmd,
+		   uint32_t handle)
+{
+	event(thread, time_ns, cmd, &handle, sizeof(handle));
+}
+
+static void exec(unsigned int thread, uint64_t time_ns, uint32_t ctx,
+		 uint32_t bo)
+{
+	struct {
+		struct igt_exec_trace_exec exec;
+		struct igt_exec_trace_exec_object obj;
+	} __attribute__((packed)) t = {
+		.exec = { 1, I915_EXEC_NO_RELOC, ctx },
+		.obj = { .handle = bo },
+	};
+
+	event(thread, time_ns, IGT_EXEC_TRACE_EXEC, &t, sizeof(t));
+}
+
+static struct {
+	pthread_mutex_t mutex;
+	unsigned long requests[MAX_EVENTS];
+	uint32_t handles[MAX_EVENTS];
+	unsigned int count;
+	uint32_t next;
+} issued = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+/* Notes the ioctls and their handles, in the order they were issued. */
+static int log_ioctl(int fd, unsigned long request, void *arg)
+{
+	uint32_t handle = 0;
+
+	pthread_mutex_lock(&issued.mutex);
+
+	switch (request) {
+	case DRM_IOCTL_I915_GEM_CREATE:
+		handle = ++issued.next;
+		((struct drm_i915_gem_create *)arg)->handle = handle;
+		break;
+	case DRM_IOCTL_I915_GEM_CONTEXT_CREATE:
+		handle = ++issued.next;
+		((struct drm_i915_gem_context_create *)arg)->ctx_id = handle;
+		break;
+	case DRM_IOCTL_GEM_CLOSE:
+		handle = ((struct drm_gem_close *)arg)->handle;
+		break;
+	case DRM_IOCTL_I915_GEM_EXECBUFFER2: {
+		struct drm_i915_gem_execbuffer2 *eb = arg;
+		struct drm_i915_gem_exec_object2 *obj =
+			(void *)(uintptr_t)eb->buffers_ptr;
+
+		igt_assert_eq(eb->buffer_count, 2);
+		igt_assert_eq(obj[1].handle, BATCH);
+		igt_assert(!(eb->batch_start_offset & 63));
+		igt_assert(eb->batch_start_offset < 4096);
+		handle = obj[0].handle;
+		break;
+	}
+	}
+
+	igt_assert(issued.count < MAX_EVENTS);
+	issued.requests[issued.count] = request;
+	issued.handles[issued.count] = handle;
+	issued.count++;
+
+	pthread_mutex_unlock(&issued.mutex);
+
+	return 0;
+}
+
+static void test_order(void)
+{
+	const struct igt_exec_replay_opts opts = {
+		.ioctl = log_ioctl,
+		.batch = BATCH,
+		.range = 4096,
+	};
+	struct igt_exec_replay_stats stats;
+
+	/*
+	 * The buffer is shared by both threads, all at the same time: the
+	 * second thread can only execute once the first created it and the
+	 * first can only close it after.
+	 */
+	trace.nr_events = 0;
+	handle(0, 0, IGT_EXEC_TRACE_ADD_BO, 7);
+	exec(1, 0, 0, 7);
+	exec(1, 0, 0, 7);
+	handle(0, 0, IGT_EXEC_TRACE_DEL_BO, 7);
+
+	for (unsigned int loop = 0; loop < 100; loop++) {
+		issued.count = 0;
+		igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), 0);
+		igt_assert_eq(stats.nr_events, 4);
+		igt_assert_eq(stats.nr_errors, 0);
+
+		igt_assert_eq(issued.count, 4);
+		igt_assert_eq(issued.requests[0], DRM_IOCTL_I915_GEM_CREATE);
+		igt_assert_eq(issued.requests[1],
+			      DRM_IOCTL_I915_GEM_EXECBUFFER2);
+		igt_assert_eq(issued.requests[2],
+			      DRM_IOCTL_I915_GEM_EXECBUFFER2);
+		igt_assert_eq(issued.requests[3], DRM_IOCTL_GEM_CLOSE);
+		for (unsigned int i = 1; i < 4; i++)
+			igt_assert_eq(issued.handles[i], issued.handles[0]);
+	}
+}
+
+static void test_pacing(void)
+{
+	const uint64_t span = 20000000, step = span / 10;
+	struct igt_exec_replay_opts opts = {
+		.ioctl = igt_exec_replay_null_ioctl,
+	};
+	struct igt_exec_replay_stats stats;
+
+	trace.nr_events = 0;
+	for (unsigned int i = 0; i <= 10; i++)
+		handle(i & 1, i * step, IGT_EXEC_TRACE_ADD_CTX, i + 1);
+
+	opts.scale = 1;
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), 0);
+	igt_debug("slip median %"PRIu64"ns, max %"PRIu64"ns\n",
+		  stats.slip_median_ns, stats.slip_max_ns);
+	igt_assert_eq(stats.nr_events, 11);
+	igt_assert(stats.elapsed_ns >= span);
+	igt_assert(stats.slip_median_ns <= stats.slip_p99_ns);
+	igt_assert(stats.slip_p99_ns <= stats.slip_max_ns);
+
+	/* Only the lower bounds, a loaded machine may run late */
+	opts.scale = 0.5;
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), 0);
+	igt_assert(stats.elapsed_ns >= span / 2);
+
+	/* As fast as possible, without any slip to speak of */
+	opts.scale = 0;
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), 0);
+	igt_assert_eq(stats.nr_events, 11);
+	igt_assert_eq_u64(stats.slip_max_ns, 0);
+}
+
+static int fail_ioctl(int fd, unsigned long request, void *arg)
+{
+	return -EINVAL;
+}
+
+static void test_untimed(void)
+{
+	struct igt_exec_replay_opts opts = { .ioctl = fail_ioctl, .scale = 1 };
+	struct igt_exec_replay_stats stats;
+
+	trace.nr_events = 0;
+	handle(0, 0, IGT_EXEC_TRACE_ADD_BO, 1);
+	exec(0, 0, 0, 1);
+	handle(0, 0, IGT_EXEC_TRACE_DEL_BO, 1);
+
+	trace.timed = false;
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), -EINVAL);
+
+	opts.scale = -1;
+	trace.timed = true;
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), -EINVAL);
+
+	/* Failing ioctls are counted, without stopping the replay */
+	opts.scale = 0;
+	trace.timed = false;
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), 0);
+	igt_assert_eq(stats.nr_events, 3);
+	igt_assert_eq(stats.nr_errors, 3);
+	trace.timed = true;
+}
+
+static void test_handles(void)
+{
+	const struct igt_exec_replay_opts opts = {
+		.ioctl = igt_exec_replay_null_ioctl,
+	};
+	const uint32_t last = IGT_EXEC_TRACE_MAX_HANDLE - 1;
+	struct igt_exec_replay_stats stats;
+
+	/* Sparse handles are fine, from both threads */
+	trace.nr_events = 0;
+	handle(0, 0, IGT_EXEC_TRACE_ADD_CTX, last);
+	handle(0, 0, IGT_EXEC_TRACE_ADD_BO, last);
+	exec(1, 0, last, last);
+	handle(0, 0, IGT_EXEC_TRACE_DEL_BO, last);
+	handle(1, 0, IGT_EXEC_TRACE_DEL_CTX, last);
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), 0);
+	igt_assert_eq(stats.nr_events, 5);
+	igt_assert_eq(stats.nr_errors, 0);
+
+	/* Corrupt ones are refused before replaying anything */
+	trace.nr_events = 0;
+	handle(0, 0, IGT_EXEC_TRACE_ADD_BO, 0xffffffff);
+	handle(0, 0, IGT_EXEC_TRACE_DEL_BO, 0xffffffff);
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), -EIO);
+
+	trace.nr_events = 0;
+	handle(0, 0, IGT_EXEC_TRACE_ADD_BO, 1);
+	exec(1, 0, IGT_EXEC_TRACE_MAX_HANDLE, 1);
+	igt_assert_eq(igt_exec_replay(&trace, &opts, &stats), -EIO);
+}
+
+igt_main
+{
+	igt_subtest("order")
+		test_order();
+
+	igt_subtest("pacing")
+		test_pacing();
+
+	igt_subtest("untimed")
+		test_untimed();
+
+	igt_subtest("handles")
+		test_handles();
+}
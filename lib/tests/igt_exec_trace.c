@@ -0,0 +1,543 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i915_drm.h"
+#include "igt_core.h"
+#include "igt_exec_trace.h"
+
+IGT_TEST_DESCRIPTION("Check converting execbuf traces to gem_wsim workloads");
+
+static uint8_t trace[16384];
+static size_t trace_len;
+
+static void put(const void *data, size_t len)
+{
+	igt_assert(trace_len + len <= sizeof(trace));
+	memcpy(trace + trace_len, data, len);
+	trace_len += len;
+}
+
+static void begin(uint32_t version)
+{
+	const struct igt_exec_trace_version v = {
+		IGT_EXEC_TRACE_MAGIC, version
+	};
+
+	trace_len = 0;
+	put(&v, sizeof(v));
+}
+
+static void cmd(uint8_t cmd, uint32_t handle)
+{
+	put(&cmd, sizeof(cmd));
+	put(&handle, sizeof(handle));
+}
+
+static void add_bo(uint32_t handle)
+{
+	const struct igt_exec_trace_add_bo t = { handle, 4096 };
+
+	put(&(uint8_t){ IGT_EXEC_TRACE_ADD_BO }, 1);
+	put(&t, sizeof(t));
+}
+
+/* The batch goes last, @write is a mask of the objects written. */
+static void exec(uint32_t ctx, uint64_t flags, const uint32_t *handles,
+		 unsigned int count, unsigned int write)
+{
+	const struct igt_exec_trace_exec t = { count, flags, ctx };
+
+	put(&(uint8_t){ IGT_EXEC_TRACE_EXEC }, 1);
+	put(&t, sizeof(t));
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct igt_exec_trace_exec_object obj = {
+			.handle = handles[i],
+			.flags = write & (1 << i) ? EXEC_OBJECT_WRITE : 0,
+		};
+
+		put(&obj, sizeof(obj));
+	}
+}
+
+static char *convert(const struct igt_exec_trace_wsim *opts, int *ret)
+{
+	char *buf = NULL;
+	size_t size;
+	FILE *out;
+
+	out = open_memstream(&buf, &size);
+	igt_assert(out);
+	*ret = igt_exec_trace_to_wsim(trace, trace_len, out, opts);
+	fclose(out);
+	igt_debug("%s", buf);
+
+	return buf;
+}
+
+static void check(const struct igt_exec_trace_wsim *opts, const char *expect)
+{
+	char *wsim;
+	int ret;
+
+	wsim = convert(opts, &ret);
+	igt_assert_eq(ret, 0);
+	igt_assert_f(!strcmp(wsim, expect), "got:\n%sexpected:\n%s",
+		     wsim, expect);
+	free(wsim);
+}
+
+static void test_dependencies(void)
+{
+	const struct igt_exec_trace_wsim opts = { .duration_us = 100 };
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	cmd(IGT_EXEC_TRACE_ADD_CTX, 5);
+	cmd(IGT_EXEC_TRACE_ADD_CTX, 6);
+	for (uint32_t handle = 1; handle <= 4; handle++)
+		add_bo(handle);
+
+	/* Render writes 2, video reads it and writes 4 */
+	exec(5, I915_EXEC_RENDER, (uint32_t[]){ 2, 1 }, 2, 1);
+	exec(6, I915_EXEC_BSD | I915_EXEC_BSD_RING2,
+	     (uint32_t[]){ 2, 4, 3 }, 3, 2);
+
+	/* Render is in order with its own write of 2 */
+	exec(5, I915_EXEC_RENDER, (uint32_t[]){ 2, 4, 1 }, 3, 0);
+
+	/* Writing 2 waits for both readers, then the client waits */
+	exec(5, I915_EXEC_BLT, (uint32_t[]){ 2, 4, 1 }, 3, 1);
+	cmd(IGT_EXEC_TRACE_WAIT, 4);
+
+	/* Nothing left to wait for on the GPU, 4 is idle */
+	exec(0, 0, (uint32_t[]){ 3 }, 1, 0);
+	exec(6, I915_EXEC_BSD | I915_EXEC_BSD_RING2,
+	     (uint32_t[]){ 4, 3 }, 2, 1);
+	exec(0, 0, (uint32_t[]){ 1 }, 1, 0);
+
+	cmd(IGT_EXEC_TRACE_WAIT, 4);
+	cmd(IGT_EXEC_TRACE_WAIT, 4);
+	cmd(IGT_EXEC_TRACE_WAIT, 2);
+	cmd(IGT_EXEC_TRACE_DEL_BO, 3);
+	cmd(IGT_EXEC_TRACE_WAIT, 3);
+
+	check(&opts,
+	      "# Converted from gem_exec_tracer: 7 batches on 3 contexts\n"
+	      "1.RCS.100.0.0\n"
+	      "2.VCS2.100.-1.0\n"
+	      "1.RCS.100.-1.0\n"
+	      "1.BCS.100.-1/-2/-3.1\n"
+	      "3.RCS.100.0.0\n"
+	      "2.VCS2.100.0.0\n"
+	      "3.RCS.100.0.0\n"
+	      "s.-2\n");
+}
+
+static void test_frames(void)
+{
+	const struct igt_exec_trace_wsim opts = {
+		.duration_us = 500,
+		.period_us = 16667,
+		.loop = true,
+	};
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	for (uint32_t handle = 1; handle <= 3; handle++)
+		add_bo(handle);
+
+	/* Setup writes 3, then render and video take turns on 2 */
+	exec(1, I915_EXEC_RENDER, (uint32_t[]){ 3, 1 }, 2, 1);
+	for (int frame = 0; frame < 10; frame++) {
+		exec(1, I915_EXEC_RENDER, (uint32_t[]){ 2, 1 }, 2, 1);
+		exec(2, I915_EXEC_BSD, (uint32_t[]){ 2, 3, 1 }, 3, 0);
+		cmd(IGT_EXEC_TRACE_WAIT, 2);
+	}
+	/* A frame cut short */
+	exec(1, I915_EXEC_RENDER, (uint32_t[]){ 2, 1 }, 2, 1);
+
+	check(&opts,
+	      "# Converted from gem_exec_tracer: 22 batches on 2 contexts\n"
+	      "# Frame of 2 steps repeating 9 times, run with -r 9\n"
+	      "# The 3 steps before were skipped\n"
+	      "p.16667\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n");
+
+	/* Without looking for frames all steps are kept */
+	check(&(struct igt_exec_trace_wsim){ .duration_us = 500 },
+	      "# Converted from gem_exec_tracer: 22 batches on 2 contexts\n"
+	      "1.RCS.500.0.0\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1/-2.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n"
+	      "2.VCS.500.-1.1\n"
+	      "1.RCS.500.0.0\n");
+}
+
+/* Record sizes in a version 1 trace, after the command byte. */
+static size_t record_size(const uint8_t *ptr)
+{
+	const struct igt_exec_trace_exec *exec = (const void *)(ptr + 1);
+	size_t len = sizeof(*exec);
+
+	switch (*ptr) {
+	case IGT_EXEC_TRACE_ADD_BO:
+		return sizeof(struct igt_exec_trace_add_bo);
+	case IGT_EXEC_TRACE_EXEC:
+		for (uint32_t i = 0; i < exec->object_count; i++) {
+			const struct igt_exec_trace_exec_object *obj =
+				(const void *)(ptr + 1 + len);
+
+			len += sizeof(*obj) + obj->relocation_count *
+			       sizeof(struct drm_i915_gem_relocation_entry);
+		}
+		return len;
+	default:
+		return sizeof(uint32_t);
+	}
+}
+
+static uint8_t *pack_record(struct igt_exec_trace_packer *packer,
+			    uint8_t *out, const uint8_t *ptr, uint64_t seq,
+			    uint64_t time)
+{
+	const struct igt_exec_trace_exec *exec = (const void *)(ptr + 1);
+	const struct igt_exec_trace_add_bo *bo = (const void *)(ptr + 1);
+	const struct igt_exec_trace_wait *handle = (const void *)(ptr + 1);
+
+	out = igt_exec_trace_pack_cmd(packer, out, *ptr, seq, time);
+
+	switch (*ptr) {
+	case IGT_EXEC_TRACE_ADD_BO:
+		out = igt_exec_trace_pack_handle(packer, out, bo->handle);
+		return igt_exec_trace_pack(out, bo->size);
+	case IGT_EXEC_TRACE_ADD_CTX:
+	case IGT_EXEC_TRACE_DEL_CTX:
+		return igt_exec_trace_pack(out, handle->handle);
+	case IGT_EXEC_TRACE_EXEC:
+		break;
+	default:
+		return igt_exec_trace_pack_handle(packer, out, handle->handle);
+	}
+
+	out = igt_exec_trace_pack(out, exec->object_count);
+	out = igt_exec_trace_pack(out, exec->flags);
+	out = igt_exec_trace_pack(out, exec->context);
+	ptr += 1 + sizeof(*exec);
+
+	for (uint32_t i = 0; i < exec->object_count; i++) {
+		const struct igt_exec_trace_exec_object *obj = (const void *)ptr;
+		const struct drm_i915_gem_relocation_entry *reloc =
+			(const void *)(obj + 1);
+
+		out = igt_exec_trace_pack_handle(packer, out, obj->handle);
+		out = igt_exec_trace_pack(out, obj->relocation_count);
+		out = igt_exec_trace_pack(out, obj->alignment);
+		out = igt_exec_trace_pack(out, obj->offset);
+		out = igt_exec_trace_pack(out, obj->flags);
+		out = igt_exec_trace_pack(out, obj->rsvd1);
+		out = igt_exec_trace_pack(out, obj->rsvd2);
+
+		for (uint32_t r = 0; r < obj->relocation_count; r++) {
+			out = igt_exec_trace_pack(out, reloc[r].target_handle);
+			out = igt_exec_trace_pack(out, reloc[r].delta);
+			out = igt_exec_trace_pack(out, reloc[r].offset);
+			out = igt_exec_trace_pack(out, reloc[r].presumed_offset);
+			out = igt_exec_trace_pack(out, reloc[r].read_domains);
+			out = igt_exec_trace_pack(out, reloc[r].write_domain);
+		}
+		ptr = (const void *)(reloc + obj->relocation_count);
+	}
+
+	return out;
+}
+
+#define N_BUFFERS 3
+#define TID 100
+#define START_NS 123456789
+#define STEP_NS 1000
+
+/*
+ * Packs the trace the way the tracer would, with the records spread over
+ * threads, STEP_NS apart, and their buffers written out in small chunks.
+ */
+static size_t pack(uint8_t *packed, unsigned int chunk)
+{
+	static uint8_t buffers[N_BUFFERS][sizeof(trace)];
+	struct igt_exec_trace_packer packers[N_BUFFERS] = { };
+	size_t len[N_BUFFERS] = { }, done[N_BUFFERS] = { }, out;
+	const uint8_t *ptr = trace + sizeof(struct igt_exec_trace_version);
+	bool more = true;
+
+	for (unsigned int b = 0; b < N_BUFFERS; b++)
+		len[b] = igt_exec_trace_pack(buffers[b], TID + b) - buffers[b];
+
+	for (uint64_t seq = 0; ptr < trace + trace_len; seq++) {
+		unsigned int b = seq * 7 % N_BUFFERS;
+
+		len[b] = pack_record(&packers[b], buffers[b] + len[b], ptr,
+				     seq, START_NS + seq * STEP_NS) - buffers[b];
+		ptr += 1 + record_size(ptr);
+	}
+
+	memcpy(packed, &(struct igt_exec_trace_version){
+		IGT_EXEC_TRACE_MAGIC, IGT_EXEC_TRACE_VERSION_TIMED
+	}, sizeof(struct igt_exec_trace_version));
+	out = sizeof(struct igt_exec_trace_version);
+
+	while (more) {
+		more = false;
+		for (unsigned int b = 0; b < N_BUFFERS; b++) {
+			size_t n = len[b] - done[b];
+
+			if (n > chunk)
+				n = chunk;
+			if (!n)
+				continue;
+
+			out = igt_exec_trace_pack(packed + out, b) - packed;
+			out = igt_exec_trace_pack(packed + out, n) - packed;
+			memcpy(packed + out, buffers[b] + done[b], n);
+			out += n;
+			done[b] += n;
+			more = true;
+		}
+	}
+
+	return out;
+}
+
+/* A bit of everything, with handles going up and down */
+static void build_mixed(void)
+{
+	begin(IGT_EXEC_TRACE_VERSION);
+	cmd(IGT_EXEC_TRACE_ADD_CTX, 3);
+	for (uint32_t handle = 1; handle <= 40; handle++)
+		add_bo(handle * 37 % 101);
+	for (int i = 0; i < 20; i++) {
+		exec(3, I915_EXEC_RENDER, (uint32_t[]){ 37, 74, 10 }, 3, 1);
+		exec(0, I915_EXEC_BLT | I915_EXEC_HANDLE_LUT,
+		     (uint32_t[]){ 74, 100000 + i, 37 }, 3, 2);
+		cmd(IGT_EXEC_TRACE_WAIT, 74);
+	}
+	cmd(IGT_EXEC_TRACE_DEL_BO, 10);
+	cmd(IGT_EXEC_TRACE_DEL_CTX, 3);
+}
+
+static void test_unpack(void)
+{
+	const struct igt_exec_trace_wsim opts = { .duration_us = 100 };
+	static uint8_t packed[sizeof(trace)];
+	/* A buffer creation followed by an execbuf without its objects */
+	static const uint8_t cut[] = {
+		0xef, 0xbe, 0xad, 0xde, IGT_EXEC_TRACE_VERSION_PACKED, 0, 0, 0,
+		0, 8, IGT_EXEC_TRACE_ADD_BO, 0, 10, 0x80, 0x20,
+		IGT_EXEC_TRACE_EXEC, 1, 1,
+	};
+	/* And followed by an unknown command */
+	static const uint8_t bad[] = {
+		0xef, 0xbe, 0xad, 0xde, IGT_EXEC_TRACE_VERSION_PACKED, 0, 0, 0,
+		0, 6, IGT_EXEC_TRACE_ADD_BO, 0, 10, 0x80, 0x20, 0x7f,
+	};
+	size_t packed_len, len;
+	void *unpacked;
+	char *expect;
+	int ret;
+
+	build_mixed();
+	for (unsigned int chunk = 1; chunk <= 4096; chunk *= 8) {
+		packed_len = pack(packed, chunk);
+		igt_assert_eq(igt_exec_trace_unpack(packed, packed_len,
+						    &unpacked, &len), 0);
+		igt_assert_eq(len, trace_len);
+		igt_assert(!memcmp(unpacked, trace, len));
+		free(unpacked);
+	}
+	igt_debug("%zu bytes packed into %zu\n", trace_len, packed_len);
+	igt_assert(packed_len < trace_len / 3);
+
+	/* Converts the same as unpacked */
+	expect = convert(&opts, &ret);
+	igt_assert_eq(ret, 0);
+	memcpy(trace, packed, packed_len);
+	trace_len = packed_len;
+	check(&opts, expect);
+	free(expect);
+
+	/* Chunks cut short do not unpack */
+	igt_assert_eq(igt_exec_trace_unpack(packed, packed_len - 1,
+					    &unpacked, &len), -EIO);
+
+	/* The last record of a buffer may be, as the tracer exits */
+	igt_assert_eq(igt_exec_trace_unpack(cut, sizeof(cut),
+					    &unpacked, &len), 0);
+	begin(IGT_EXEC_TRACE_VERSION);
+	add_bo(5);
+	igt_assert_eq(len, trace_len);
+	igt_assert(!memcmp(unpacked, trace, len));
+	free(unpacked);
+
+	/* But not be corrupt */
+	igt_assert_eq(igt_exec_trace_unpack(bad, sizeof(bad),
+					    &unpacked, &len), -EIO);
+	igt_assert_eq(igt_exec_trace_unpack(trace, 4, &unpacked, &len),
+		      -EINVAL);
+	begin(IGT_EXEC_TRACE_VERSION);
+	igt_assert_eq(igt_exec_trace_unpack(trace, trace_len,
+					    &unpacked, &len), -EPROTO);
+}
+
+static void test_parse(void)
+{
+	static uint8_t packed[sizeof(trace)];
+	/* An older packed trace, a buffer creation without timestamps */
+	static const uint8_t untimed[] = {
+		0xef, 0xbe, 0xad, 0xde, IGT_EXEC_TRACE_VERSION_PACKED, 0, 0, 0,
+		0, 5, IGT_EXEC_TRACE_ADD_BO, 0, 10, 0x80, 0x20,
+	};
+	struct igt_exec_trace *parsed;
+	unsigned int nr_events;
+	const uint8_t *ptr;
+	size_t packed_len;
+
+	build_mixed();
+	packed_len = pack(packed, 100);
+
+	/* Events of all threads in order, timed from the first */
+	igt_assert_eq(igt_exec_trace_parse(packed, packed_len, &parsed), 0);
+	igt_assert(parsed->timed);
+	igt_assert_eq(parsed->nr_threads, N_BUFFERS);
+	for (unsigned int i = 0; i < N_BUFFERS; i++)
+		igt_assert_eq(parsed->tids[i], TID + i);
+
+	ptr = trace + sizeof(struct igt_exec_trace_version);
+	for (unsigned int i = 0; i < parsed->nr_events; i++) {
+		const struct igt_exec_trace_event *ev = &parsed->events[i];
+
+		igt_assert_eq(ev->thread, i * 7 % N_BUFFERS);
+		igt_assert_eq_u64(ev->time_ns, i * STEP_NS);
+		igt_assert_eq(ev->cmd, *ptr);
+		igt_assert_eq(ev->len, 1 + record_size(ptr));
+		igt_assert(!memcmp(ev->record, ptr, ev->len));
+		ptr += ev->len;
+	}
+	igt_assert(ptr == trace + trace_len);
+	nr_events = parsed->nr_events;
+	igt_exec_trace_free(parsed);
+
+	/* Plain traces are of a single thread without timestamps */
+	igt_assert_eq(igt_exec_trace_parse(trace, trace_len, &parsed), 0);
+	igt_assert(!parsed->timed);
+	igt_assert_eq(parsed->nr_threads, 1);
+	igt_assert_eq(parsed->nr_events, nr_events);
+	igt_assert_eq_u64(parsed->events[nr_events - 1].time_ns, 0);
+	igt_exec_trace_free(parsed);
+
+	igt_assert_eq(igt_exec_trace_parse(untimed, sizeof(untimed), &parsed),
+		      0);
+	igt_assert(!parsed->timed);
+	igt_assert_eq(parsed->nr_events, 1);
+	igt_assert_eq(parsed->events[0].cmd, IGT_EXEC_TRACE_ADD_BO);
+	igt_assert(!memcmp(parsed->events[0].record + 1,
+			   &(struct igt_exec_trace_add_bo){ 5, 4096 },
+			   sizeof(struct igt_exec_trace_add_bo)));
+	igt_exec_trace_free(parsed);
+	/* Handles which cannot be real are corruption */
+	begin(IGT_EXEC_TRACE_VERSION);
+	add_bo(IGT_EXEC_TRACE_MAX_HANDLE);
+	igt_assert_eq(igt_exec_trace_parse(trace, trace_len, &parsed), -EIO);
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	add_bo(1);
+	exec(0xffffffff, 0, (uint32_t[]){ 1 }, 1, 0);
+	igt_assert_eq(igt_exec_trace_parse(trace, trace_len, &parsed), -EIO);
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	exec(0, 0, (uint32_t[]){ 1, 0xffffffff }, 2, 0);
+	igt_assert_eq(igt_exec_trace_parse(trace, trace_len, &parsed), -EIO);
+}
+
+static void test_invalid(void)
+{
+	const struct igt_exec_trace_wsim opts = { .duration_us = 100 };
+	char *wsim;
+	int ret;
+
+	begin(0);
+	trace[0] = 0;
+	wsim = convert(&opts, &ret);
+	igt_assert_eq(ret, -EINVAL);
+	free(wsim);
+
+	begin(IGT_EXEC_TRACE_VERSION_TIMED + 1);
+	wsim = convert(&opts, &ret);
+	igt_assert_eq(ret, -EPROTO);
+	free(wsim);
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	exec(0, 0, (uint32_t[]){ 1, 2 }, 2, 0);
+	trace_len--;
+	wsim = convert(&opts, &ret);
+	igt_assert_eq(ret, -EIO);
+	free(wsim);
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	put(&(uint8_t){ 0xff }, 1);
+	wsim = convert(&opts, &ret);
+	igt_assert_eq(ret, -EIO);
+	free(wsim);
+
+	/* Corrupt handles must not be used to size the tables. */
+	begin(IGT_EXEC_TRACE_VERSION);
+	exec(0, 0, (uint32_t[]){ 0xfffff000, 2 }, 2, 1);
+	wsim = convert(&opts, &ret);
+	igt_assert_eq(ret, -EIO);
+	free(wsim);
+
+	begin(IGT_EXEC_TRACE_VERSION);
+	exec(0xffffffff, 0, (uint32_t[]){ 1, 2 }, 2, 1);
+	wsim = convert(&opts, &ret);
+	igt_assert_eq(ret, -EIO);
+	free(wsim);
+}
+
+igt_main
+{
+	igt_subtest("dependencies")
+		test_dependencies();
+
+	igt_subtest("frames")
+		test_frames();
+
+	igt_subtest("unpack")
+		test_unpack();
+
+	igt_subtest("parse")
+		test_parse();
+
+	igt_subtest("invalid")
+		test_invalid();
+}
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_gpu_top_record.h"
+
+IGT_TEST_DESCRIPTION("Check recording and replaying GPU samples");
+
+#define N_SAMPLES 100
+
+static char path[64];
+
+static const struct igt_gpu_top_info info = {
+	.card = "/dev/dri/card0",
+	.num_gts = 1,
+	.num_engines = 2,
+	.engines = {
+		{ .name = "rcs0", .present = 1 },
+		{ .name = "bcs0", .class = 1, .present = 1 },
+	},
+};
+
+/* Busy engines and clients coming and going, like a real session. */
+static void fill(struct igt_gpu_top_sample *sample, uint64_t i)
+{
+	memset(sample, 0, sizeof(*sample));
+
+	sample->index = 1000 + i; /* Replaced by the recording */
+	sample->timestamp = i * 1000000;
+	sample->realtime = 1ull << 60 | i * 1000000;
+	sample->counters[IGT_GPU_TOP_IRQ] = 7 * i;
+	sample->counters[IGT_GPU_TOP_RC6] = i * i;
+	sample->engines[0][IGT_GPU_TOP_ENGINE_BUSY] = i * 500000;
+	sample->engines[1][IGT_GPU_TOP_ENGINE_BUSY] = (i / 10) * 3;
+
+	sample->num_clients = i % 5;
+	for (int c = 0; c < sample->num_clients; c++) {
+		struct igt_gpu_top_client *client = &sample->clients[c];
+
+		client->id = c + i / 20;
+		client->pid = 100 + c;
+		snprintf(client->name, sizeof(client->name), "client%d", c);
+		client->engine_time[0] = i * 1000 + c;
+		client->memory[0].resident = 4096 * (i % 3);
+	}
+}
+
+static void check(const struct igt_gpu_top_sample *sample, uint64_t i)
+{
+	struct igt_gpu_top_sample *expect = malloc(sizeof(*expect));
+
+	igt_assert(expect);
+	fill(expect, i);
+	expect->index = i;
+
+	igt_assert(!memcmp(sample, expect,
+			   offsetof(struct igt_gpu_top_sample, clients)));
+	igt_assert(!memcmp(sample->clients, expect->clients,
+			   sample->num_clients * sizeof(sample->clients[0])));
+	free(expect);
+}
+
+static void record(unsigned int count)
+{
+	struct igt_gpu_top_sample *sample = malloc(sizeof(*sample));
+	struct igt_gpu_top_record *rec;
+
+	igt_assert(sample);
+	rec = igt_gpu_top_record_create(path, &info, 1000000);
+	igt_assert(rec);
+
+	for (uint64_t i = 0; i < count; i++) {
+		fill(sample, i);
+		igt_assert_eq(igt_gpu_top_record_write(rec, sample), 0);
+	}
+
+	igt_assert_eq(igt_gpu_top_record_close(rec), 0);
+	free(sample);
+}
+
+static void replay(unsigned int count)
+{
+	struct igt_gpu_top_sample *sample = malloc(sizeof(*sample));
+	const struct igt_gpu_top_record_header *header;
+	struct igt_gpu_top_replay *replay;
+
+	igt_assert(sample);
+	replay = igt_gpu_top_replay_open(path);
+	igt_assert(replay);
+
+	header = igt_gpu_top_replay_header(replay);
+	igt_assert_eq_u64(header->period_ns, 1000000);
+	igt_assert(!strcmp(header->info.card, "/dev/dri/card0"));
+	igt_assert(!strcmp(header->info.engines[1].name, "bcs0"));
+
+	for (uint64_t i = 0; i < count; i++) {
+		igt_assert_eq(igt_gpu_top_replay_next(replay, sample), 0);
+		check(sample, i);
+	}
+	igt_assert_eq(igt_gpu_top_replay_next(replay, sample), -ENODATA);
+
+	igt_gpu_top_replay_close(replay);
+	free(sample);
+}
+
+static off_t file_size(void)
+{
+	struct stat st;
+
+	igt_assert_eq(stat(path, &st), 0);
+	return st.st_size;
+}
+
+static void test_roundtrip(void)
+{
+	record(N_SAMPLES);
+	replay(N_SAMPLES);
+
+	/* Unchanged words cost nothing, well below 100 bytes per sample */
+	igt_debug("%u samples in %jd bytes\n", N_SAMPLES, (intmax_t)file_size());
+	igt_assert(file_size() < sizeof(struct igt_gpu_top_record_header) +
+				 N_SAMPLES * 100);
+}
+
+static void test_truncated(void)
+{
+	off_t size;
+
+	record(N_SAMPLES);
+
+	/* A recording cut short replays up to its last whole sample */
+	size = file_size();
+	igt_assert_eq(truncate(path, size - 1), 0);
+	replay(N_SAMPLES - 1);
+}
+
+static void test_invalid(void)
+{
+	FILE *file = fopen(path, "w");
+
+	igt_assert(file);
+	fprintf(file, "not a recording");
+	fclose(file);
+
+	igt_assert(!igt_gpu_top_replay_open(path));
+	igt_assert_eq(errno, EINVAL);
+
+	unlink(path);
+	igt_assert(!igt_gpu_top_replay_open(path));
+	igt_assert_eq(errno, ENOENT);
+}
+
+igt_main
+{
+	igt_fixture
+		snprintf(path, sizeof(path), "/tmp/igt_gpu_top_record-%d",
+			 getpid());
+
+	igt_subtest("roundtrip")
+		test_roundtrip();
+
+	igt_subtest("truncated")
+		test_truncated();
+
+	igt_subtest("invalid")
+		test_invalid();
+
+	igt_fixture
+		unlink(path);
+}
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_gpu_top_shm.h"
+
+IGT_TEST_DESCRIPTION("Check publishing and reading GPU samples through shared memory");
+
+#define HISTORY 8
+#define N_CONCURRENT 20000
+
+static char name[64];
+
+static void fill(struct igt_gpu_top_sample *sample, uint64_t value)
+{
+	sample->timestamp = value;
+	sample->realtime = value;
+	for (int i = 0; i < IGT_GPU_TOP_NUM_COUNTERS; i++)
+		sample->counters[i] = value;
+	for (int i = 0; i < IGT_GPU_TOP_MAX_ENGINES; i++)
+		for (int j = 0; j < IGT_GPU_TOP_ENGINE_COUNTERS; j++)
+			sample->engines[i][j] = value;
+
+	sample->num_clients = value % IGT_GPU_TOP_MAX_CLIENTS;
+	for (int i = 0; i < sample->num_clients; i++) {
+		sample->clients[i].id = value;
+		sample->clients[i].pid = value;
+		sample->clients[i].engine_time[0] = value;
+	}
+}
+
+static void check(const struct igt_gpu_top_sample *sample, uint64_t value)
+{
+	igt_assert_eq_u64(sample->timestamp, value);
+	igt_assert_eq_u64(sample->realtime, value);
+	for (int i = 0; i < IGT_GPU_TOP_NUM_COUNTERS; i++)
+		igt_assert_eq_u64(sample->counters[i], value);
+	for (int i = 0; i < IGT_GPU_TOP_MAX_ENGINES; i++)
+		for (int j = 0; j < IGT_GPU_TOP_ENGINE_COUNTERS; j++)
+			igt_assert_eq_u64(sample->engines[i][j], value);
+
+	igt_assert_eq(sample->num_clients, value % IGT_GPU_TOP_MAX_CLIENTS);
+	for (int i = 0; i < sample->num_clients; i++) {
+		igt_assert_eq_u64(sample->clients[i].id, value);
+		igt_assert_eq_u64(sample->clients[i].engine_time[0], value);
+	}
+}
+
+static struct igt_gpu_top_shm *create(void)
+{
+	struct igt_gpu_top_info info = {
+		.card = "/dev/dri/card0",
+		.num_gts = 1,
+		.num_engines = 1,
+		.engines[0] = { .name = "rcs0", .present = 1 },
+	};
+	struct igt_gpu_top_shm *shm;
+
+	shm = igt_gpu_top_shm_create(name, &info, HISTORY, 1000000);
+	igt_assert(shm);
+
+	return shm;
+}
+
+static void publish(struct igt_gpu_top_shm *shm, uint64_t value)
+{
+	fill(igt_gpu_top_shm_begin(shm), value);
+	igt_gpu_top_shm_commit(shm);
+}
+
+static void test_publish(void)
+{
+	struct igt_gpu_top_sample *sample = malloc(sizeof(*sample));
+	const struct igt_gpu_top_shm *view;
+	struct igt_gpu_top_shm *shm;
+
+	igt_assert(sample);
+	shm = create();
+
+	view = igt_gpu_top_shm_attach(name);
+	igt_assert(view);
+	igt_assert(!strcmp(view->info.card, "/dev/dri/card0"));
+	igt_assert(!strcmp(view->info.engines[0].name, "rcs0"));
+	igt_assert_eq(view->pid, getpid());
+	igt_assert_eq(igt_gpu_top_shm_latest(view), -1);
+	igt_assert_eq(igt_gpu_top_shm_read(view, 0, sample), -EAGAIN);
+
+	for (uint64_t i = 0; i < 3 * HISTORY + 3; i++) {
+		publish(shm, 1000 + i);
+
+		igt_assert_eq(igt_gpu_top_shm_latest(view), i);
+		igt_assert_eq(igt_gpu_top_shm_read(view, i, sample), 0);
+		igt_assert_eq_u64(sample->index, i);
+		check(sample, 1000 + i);
+	}
+
+	/* The whole history is there, older samples are gone */
+	for (uint64_t i = 2 * HISTORY + 3; i < 3 * HISTORY + 3; i++) {
+		igt_assert_eq(igt_gpu_top_shm_read(view, i, sample), 0);
+		check(sample, 1000 + i);
+	}
+	igt_assert_eq(igt_gpu_top_shm_read(view, 2 * HISTORY + 2, sample), -ENODATA);
+	igt_assert_eq(igt_gpu_top_shm_read(view, 0, sample), -ENODATA);
+	igt_assert_eq(igt_gpu_top_shm_read(view, 3 * HISTORY + 3, sample), -EAGAIN);
+
+	igt_gpu_top_shm_detach(view);
+	igt_gpu_top_shm_destroy(shm, name);
+
+	igt_assert(!igt_gpu_top_shm_attach(name));
+	igt_assert_eq(errno, ENOENT);
+	free(sample);
+}
+
+static void *writer(void *data)
+{
+	struct igt_gpu_top_shm *shm = data;
+
+	for (uint64_t i = 0; i < N_CONCURRENT; i++)
+		publish(shm, i);
+
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	struct igt_gpu_top_sample *sample = malloc(sizeof(*sample));
+	const struct igt_gpu_top_shm *view;
+	struct igt_gpu_top_shm *shm;
+	unsigned int reads = 0;
+	pthread_t thread;
+	int64_t latest;
+
+	igt_assert(sample);
+	shm = create();
+	view = igt_gpu_top_shm_attach(name);
+	igt_assert(view);
+
+	igt_assert_eq(pthread_create(&thread, NULL, writer, shm), 0);
+
+	/* Every successful read is one whole sample, never a mix of two */
+	do {
+		latest = igt_gpu_top_shm_latest(view);
+		if (latest < 0)
+			continue;
+
+		if (igt_gpu_top_shm_read(view, latest, sample) == 0) {
+			igt_assert_eq_u64(sample->index, latest);
+			check(sample, latest);
+			reads++;
+		}
+	} while (latest < N_CONCURRENT - 1);
+
+	pthread_join(thread, NULL);
+	igt_assert(reads > 0);
+	igt_debug("%u consistent reads\n", reads);
+
+	igt_gpu_top_shm_detach(view);
+	igt_gpu_top_shm_destroy(shm, name);
+	free(sample);
+}
+
+igt_main
+{
+	igt_fixture
+		snprintf(name, sizeof(name), "/igt_gpu_top_shm-%d", getpid());
+
+	igt_subtest("publish")
+		test_publish();
+
+	igt_subtest("concurrent")
+		test_concurrent();
+}
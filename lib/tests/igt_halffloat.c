@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_core.h"
+#include "igt_halffloat.h"
+
+IGT_TEST_DESCRIPTION("Check the SIMD RGBX16 conversion kernels against the scalar ones");
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+/* Odd, so that the kernels also go through their scalar tail */
+#define NUM_PIXELS 16389
+
+static const float edge_values[] = {
+	0.0f, -0.0f, 1.0f, -1.0f, 0.5f,
+	1.0f - 0x1p-24f, 1.0f + 0x1p-23f, 1.5f, 2.0f,
+	0x1p-24f, -0x1p-24f, 0x1p-126f, 0x1p-149f,
+	0.5f / 65535.0f, 1.5f / 65535.0f, 65534.5f / 65535.0f,
+	65504.0f, 65520.0f, -65520.0f, 0x1p31f, 0x1p32f, 1e10f, -1e10f,
+	INFINITY, -INFINITY, NAN, -NAN,
+};
+
+static const struct igt_rgbx16_kernels *scalar_kernels(void)
+{
+	const struct igt_rgbx16_kernels *k;
+
+	for (unsigned int i = 0; (k = igt_rgbx16_kernels_get(i)); i++)
+		if (!strcmp(k->name, "scalar"))
+			return k;
+
+	igt_assert(!"no scalar kernels");
+	return NULL;
+}
+
+static float *float_pixels(void)
+{
+	float *f = malloc(NUM_PIXELS * 4 * sizeof(*f));
+	uint32_t nan_payload = 0x7f800001;
+
+	igt_assert(f);
+
+	srandom(0x16);
+	for (unsigned int i = 0; i < NUM_PIXELS * 4; i++) {
+		if (i % 3 == 0) {
+			f[i] = edge_values[(i / 3) % ARRAY_SIZE(edge_values)];
+		} else if (i % 101 == 100) {
+			/* Signalling and payload carrying NaNs */
+			memcpy(&f[i], &nan_payload, sizeof(f[i]));
+			nan_payload = 0x7f800001 + random() % 0x7fffff;
+		} else {
+			f[i] = (float)random() / RAND_MAX * 1.25f - 0.125f;
+		}
+	}
+
+	return f;
+}
+
+static uint16_t *uint16_pixels(void)
+{
+	uint16_t *u = malloc(NUM_PIXELS * 4 * sizeof(*u));
+
+	igt_assert(u);
+
+	/* Every 16 bit pattern, including all half float NaNs */
+	for (unsigned int i = 0; i < NUM_PIXELS * 4; i++)
+		u[i] = i;
+
+	return u;
+}
+
+static void check_from_float(const struct igt_rgbx16_kernels *k,
+			     const struct igt_rgbx16_kernels *ref)
+{
+	float *f = float_pixels();
+	uint16_t *a = malloc(NUM_PIXELS * 4 * sizeof(*a));
+	uint16_t *b = malloc(NUM_PIXELS * 4 * sizeof(*b));
+
+	igt_assert(a && b);
+
+	for (int swap_rb = 0; swap_rb <= 1; swap_rb++) {
+		k->float_to_uint16(f, a, NUM_PIXELS, swap_rb);
+		ref->float_to_uint16(f, b, NUM_PIXELS, swap_rb);
+		for (unsigned int i = 0; i < NUM_PIXELS * 4; i++)
+			igt_assert_f(a[i] == b[i],
+				     "unorm: %a -> %04x, expected %04x\n",
+				     f[i ^ (swap_rb && (i & 1) == 0 ? 2 : 0)],
+				     a[i], b[i]);
+
+		k->float_to_half(f, a, NUM_PIXELS, swap_rb);
+		ref->float_to_half(f, b, NUM_PIXELS, swap_rb);
+		for (unsigned int i = 0; i < NUM_PIXELS * 4; i++)
+			igt_assert_f(a[i] == b[i],
+				     "half: %a -> %04x, expected %04x\n",
+				     f[i ^ (swap_rb && (i & 1) == 0 ? 2 : 0)],
+				     a[i], b[i]);
+	}
+
+	free(b);
+	free(a);
+	free(f);
+}
+
+static void check_to_float(const struct igt_rgbx16_kernels *k,
+			   const struct igt_rgbx16_kernels *ref)
+{
+	uint16_t *u = uint16_pixels();
+	float *a = malloc(NUM_PIXELS * 4 * sizeof(*a));
+	float *b = malloc(NUM_PIXELS * 4 * sizeof(*b));
+
+	igt_assert(a && b);
+
+	for (int swap_rb = 0; swap_rb <= 1; swap_rb++) {
+		/* Compare the bit patterns, NaN != NaN */
+		k->uint16_to_float(u, a, NUM_PIXELS, swap_rb);
+		ref->uint16_to_float(u, b, NUM_PIXELS, swap_rb);
+		igt_assert(!memcmp(a, b, NUM_PIXELS * 4 * sizeof(*a)));
+
+		k->half_to_float(u, a, NUM_PIXELS, swap_rb);
+		ref->half_to_float(u, b, NUM_PIXELS, swap_rb);
+		igt_assert(!memcmp(a, b, NUM_PIXELS * 4 * sizeof(*a)));
+	}
+
+	free(b);
+	free(a);
+	free(u);
+}
+
+static void test_clamp(void)
+{
+	const float f[8] = { -1.0f, 2.0f, NAN, INFINITY,
+			     -INFINITY, 1e10f, 0.0f, 1.0f };
+	const uint16_t expected[8] = { 0, 65535, 0, 65535,
+				       0, 65535, 0, 65535 };
+	const struct igt_rgbx16_kernels *k;
+	uint16_t u[8];
+
+	for (unsigned int i = 0; (k = igt_rgbx16_kernels_get(i)); i++) {
+		k->float_to_uint16(f, u, 2, false);
+		for (int c = 0; c < 8; c++)
+			igt_assert_f(u[c] == expected[c],
+				     "%s: %f -> %04x, expected %04x\n",
+				     k->name, f[c], u[c], expected[c]);
+	}
+}
+
+igt_main
+{
+	const struct igt_rgbx16_kernels *ref;
+
+	igt_fixture
+		ref = scalar_kernels();
+
+	igt_subtest("unorm-clamp")
+		test_clamp();
+
+	igt_subtest_with_dynamic("simd-vs-scalar") {
+		const struct igt_rgbx16_kernels *k;
+
+		for (unsigned int i = 0; (k = igt_rgbx16_kernels_get(i)); i++) {
+			if (k == ref)
+				continue;
+
+			igt_dynamic_f("%s", k->name) {
+				check_from_float(k, ref);
+				check_to_float(k, ref);
+			}
+		}
+	}
+}
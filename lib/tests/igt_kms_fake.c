@@ -0,0 +1,464 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_core.h"
+#include "igt_fb.h"
+#include "igt_kms.h"
+#include "igt_kms_fake.h"
+
+IGT_TEST_DESCRIPTION("Drive igt_kms through a recorded fake KMS device");
+
+#define PROP_ATOMIC_OBJECT (DRM_MODE_PROP_OBJECT | DRM_MODE_PROP_ATOMIC)
+#define PROP_ATOMIC_RANGE (DRM_MODE_PROP_RANGE | DRM_MODE_PROP_ATOMIC)
+#define PROP_ATOMIC_SIGNED (DRM_MODE_PROP_SIGNED_RANGE | DRM_MODE_PROP_ATOMIC)
+
+enum {
+	FB_ID = 1,
+	CRTC_ID,
+	SRC_X,
+	SRC_Y,
+	SRC_W,
+	SRC_H,
+	CRTC_X,
+	CRTC_Y,
+	CRTC_W,
+	CRTC_H,
+	TYPE,
+	ACTIVE,
+	MODE_ID,
+	OUT_FENCE_PTR,
+	DPMS,
+};
+
+enum {
+	CRTC_A = 31,
+	CRTC_B,
+	ENCODER_A = 41,
+	ENCODER_B,
+	CONNECTOR_A = 51,
+	CONNECTOR_B,
+	PRIMARY_A = 61,
+	OVERLAY,
+	CURSOR_A,
+	PRIMARY_B,
+	CURSOR_B,
+	MODE_BLOB = 100,
+};
+
+static const drmModeModeInfo modes[] = {
+	{ 148500, 1920, 2008, 2052, 2200, 0, 1080, 1084, 1089, 1125, 0, 60,
+	  DRM_MODE_FLAG_PHSYNC | DRM_MODE_FLAG_PVSYNC,
+	  DRM_MODE_TYPE_PREFERRED | DRM_MODE_TYPE_DRIVER, "1920x1080" },
+	{ 74250, 1280, 1390, 1430, 1650, 0, 720, 725, 730, 750, 0, 60,
+	  DRM_MODE_FLAG_PHSYNC | DRM_MODE_FLAG_PVSYNC,
+	  DRM_MODE_TYPE_DRIVER, "1280x720" },
+};
+
+static char recording[] = "/tmp/igt_kms_fake.XXXXXX";
+
+static void write_prop(FILE *f, uint32_t id, uint32_t flags,
+		       const char *name, uint64_t min, uint64_t max)
+{
+	fprintf(f, "prop %u %u %s\n", id, flags, name);
+	if (flags & (DRM_MODE_PROP_RANGE | DRM_MODE_PROP_SIGNED_RANGE))
+		fprintf(f, "prop-value %u %" PRIu64 "\n"
+			"prop-value %u %" PRIu64 "\n", id, min, id, max);
+	else if (flags & DRM_MODE_PROP_OBJECT)
+		fprintf(f, "prop-value %u %" PRIu64 "\n", id, min);
+}
+
+static void write_mode(FILE *f, uint32_t connector, const drmModeModeInfo *m)
+{
+	fprintf(f, "mode %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %s\n",
+		connector, m->clock, m->hdisplay, m->hsync_start, m->hsync_end,
+		m->htotal, m->hskew, m->vdisplay, m->vsync_start, m->vsync_end,
+		m->vtotal, m->vscan, m->vrefresh, m->flags, m->type, m->name);
+}
+
+static void write_plane(FILE *f, uint32_t id, uint32_t crtcs, uint64_t type)
+{
+	static const uint32_t ids[] = {
+		FB_ID, CRTC_ID, SRC_X, SRC_Y, SRC_W, SRC_H,
+		CRTC_X, CRTC_Y, CRTC_W, CRTC_H,
+	};
+	unsigned int i;
+
+	fprintf(f, "plane %u %u 0\n", id, crtcs);
+	if (type == DRM_PLANE_TYPE_CURSOR)
+		fprintf(f, "plane-formats %u %#x\n", id, DRM_FORMAT_ARGB8888);
+	else
+		fprintf(f, "plane-formats %u %#x %#x %#x\n", id,
+			DRM_FORMAT_XRGB8888, DRM_FORMAT_ARGB8888,
+			DRM_FORMAT_RGB565);
+
+	/* Left scanning out a framebuffer that was not recorded */
+	for (i = 0; i < ARRAY_SIZE(ids); i++)
+		fprintf(f, "object-prop %u %u %u\n", id, ids[i],
+			id == PRIMARY_A && ids[i] == FB_ID ? 99 :
+			id == PRIMARY_A && ids[i] == CRTC_ID ? CRTC_A : 0);
+	fprintf(f, "object-prop %u %u %" PRIu64 "\n", id, TYPE, type);
+}
+
+/*
+ * Two crtcs, with a connector each and an overlay plane shared between them.
+ * The first is enabled, as left by the console.
+ */
+static void write_recording(const char *filename)
+{
+	const uint8_t *mode = (const uint8_t *)&modes[0];
+	uint32_t connectors[] = { CONNECTOR_A, CONNECTOR_B };
+	unsigned int i, j;
+	FILE *f;
+
+	f = fopen(filename, "w");
+	igt_assert(f);
+
+	fprintf(f, "igt-kms-fake 1\n");
+	fprintf(f, "driver 1 0 0 fake\n");
+	fprintf(f, "client-cap %u\nclient-cap %u\nclient-cap %u\n",
+		DRM_CLIENT_CAP_UNIVERSAL_PLANES, DRM_CLIENT_CAP_ATOMIC,
+		DRM_CLIENT_CAP_ASPECT_RATIO);
+	fprintf(f, "cap %u 1\ncap %u 1\n", DRM_CAP_DUMB_BUFFER,
+		DRM_CAP_ADDFB2_MODIFIERS);
+	fprintf(f, "size 0 8192 0 8192\n");
+
+	write_prop(f, FB_ID, PROP_ATOMIC_OBJECT, "FB_ID",
+		   DRM_MODE_OBJECT_FB, 0);
+	write_prop(f, CRTC_ID, PROP_ATOMIC_OBJECT, "CRTC_ID",
+		   DRM_MODE_OBJECT_CRTC, 0);
+	write_prop(f, SRC_X, PROP_ATOMIC_RANGE, "SRC_X", 0, UINT32_MAX);
+	write_prop(f, SRC_Y, PROP_ATOMIC_RANGE, "SRC_Y", 0, UINT32_MAX);
+	write_prop(f, SRC_W, PROP_ATOMIC_RANGE, "SRC_W", 0, UINT32_MAX);
+	write_prop(f, SRC_H, PROP_ATOMIC_RANGE, "SRC_H", 0, UINT32_MAX);
+	write_prop(f, CRTC_X, PROP_ATOMIC_SIGNED, "CRTC_X",
+		   (uint64_t)(int64_t)INT32_MIN, INT32_MAX);
+	write_prop(f, CRTC_Y, PROP_ATOMIC_SIGNED, "CRTC_Y",
+		   (uint64_t)(int64_t)INT32_MIN, INT32_MAX);
+	write_prop(f, CRTC_W, PROP_ATOMIC_RANGE, "CRTC_W", 0, INT32_MAX);
+	write_prop(f, CRTC_H, PROP_ATOMIC_RANGE, "CRTC_H", 0, INT32_MAX);
+	write_prop(f, TYPE, DRM_MODE_PROP_ENUM | DRM_MODE_PROP_IMMUTABLE,
+		   "type", 0, 0);
+	fprintf(f, "prop-enum %u 0 Overlay\nprop-enum %u 1 Primary\n"
+		"prop-enum %u 2 Cursor\n", TYPE, TYPE, TYPE);
+	write_prop(f, ACTIVE, PROP_ATOMIC_RANGE, "ACTIVE", 0, 1);
+	write_prop(f, MODE_ID, DRM_MODE_PROP_BLOB | DRM_MODE_PROP_ATOMIC,
+		   "MODE_ID", 0, 0);
+	write_prop(f, OUT_FENCE_PTR, PROP_ATOMIC_RANGE, "OUT_FENCE_PTR",
+		   0, UINT64_MAX);
+	write_prop(f, DPMS, DRM_MODE_PROP_ENUM, "DPMS", 0, 0);
+	fprintf(f, "prop-enum %u 0 On\nprop-enum %u 3 Off\n", DPMS, DPMS);
+
+	fprintf(f, "blob %u ", MODE_BLOB);
+	for (i = 0; i < sizeof(modes[0]); i++)
+		fprintf(f, "%02x", mode[i]);
+	fprintf(f, "\n");
+
+	for (i = 0; i < 2; i++) {
+		fprintf(f, "crtc %u 256\n", CRTC_A + i);
+		fprintf(f, "object-prop %u %u %u\n", CRTC_A + i, ACTIVE, !i);
+		fprintf(f, "object-prop %u %u %u\n", CRTC_A + i, MODE_ID,
+			i ? 0 : MODE_BLOB);
+		fprintf(f, "object-prop %u %u 0\n", CRTC_A + i, OUT_FENCE_PTR);
+	}
+
+	for (i = 0; i < 2; i++)
+		fprintf(f, "encoder %u %u %u 0\n", ENCODER_A + i,
+			DRM_MODE_ENCODER_TMDS, 1 << i);
+
+	for (i = 0; i < 2; i++) {
+		fprintf(f, "connector %u %u 1 %u 520 290 %u\n", connectors[i],
+			i ? DRM_MODE_CONNECTOR_DisplayPort :
+			DRM_MODE_CONNECTOR_HDMIA, DRM_MODE_CONNECTED,
+			DRM_MODE_SUBPIXEL_UNKNOWN);
+		fprintf(f, "connector-encoder %u %u\n", connectors[i],
+			ENCODER_A + i);
+		for (j = 0; j < ARRAY_SIZE(modes); j++)
+			write_mode(f, connectors[i], &modes[j]);
+		fprintf(f, "object-prop %u %u 0\n", connectors[i], DPMS);
+		fprintf(f, "object-prop %u %u %u\n", connectors[i], CRTC_ID,
+			i ? 0 : CRTC_A);
+	}
+
+	write_plane(f, PRIMARY_A, 1, DRM_PLANE_TYPE_PRIMARY);
+	write_plane(f, OVERLAY, 3, DRM_PLANE_TYPE_OVERLAY);
+	write_plane(f, CURSOR_A, 1, DRM_PLANE_TYPE_CURSOR);
+	write_plane(f, PRIMARY_B, 2, DRM_PLANE_TYPE_PRIMARY);
+	write_plane(f, CURSOR_B, 2, DRM_PLANE_TYPE_CURSOR);
+
+	igt_assert_eq(fclose(f), 0);
+}
+
+static int open_fake(uint64_t commit_ns, bool vblank)
+{
+	struct igt_kms_fake_opts opts = {
+		.commit_ns = commit_ns,
+		.vblank = vblank,
+	};
+	int fd;
+
+	fd = igt_kms_fake_open(recording, &opts);
+	igt_assert_f(fd >= 0, "failed to load %s: %s\n",
+		     recording, strerror(-fd));
+	igt_assert(igt_kms_fake_owns(fd));
+
+	return fd;
+}
+
+static void test_display(void)
+{
+	struct igt_kms_fake_stats stats;
+	igt_display_t display;
+	igt_output_t *output;
+	drmModeCrtc *crtc;
+	drmModeModeInfo *mode;
+	struct igt_fb fb;
+	igt_plane_t *primary;
+	enum pipe pipe;
+	int fd;
+
+	fd = open_fake(0, false);
+
+	igt_display_require(&display, fd);
+	igt_assert(display.is_atomic);
+	igt_assert(display.has_cursor_plane);
+	igt_display_require_output(&display);
+	igt_display_reset(&display);
+
+	for_each_pipe_with_valid_output(&display, pipe, output)
+		break;
+
+	igt_output_set_pipe(output, pipe);
+	mode = igt_output_get_mode(output);
+	igt_create_color_fb(fd, mode->hdisplay, mode->vdisplay,
+			    DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR,
+			    0.0, 1.0, 0.0, &fb);
+	primary = igt_output_get_plane_type(output, DRM_PLANE_TYPE_PRIMARY);
+	igt_plane_set_fb(primary, &fb);
+	igt_display_commit2(&display, COMMIT_ATOMIC);
+
+	crtc = drmModeGetCrtc(fd, display.pipes[pipe].crtc_id);
+	igt_assert(crtc);
+	igt_assert(crtc->mode_valid);
+	igt_assert_eq(crtc->mode.hdisplay, mode->hdisplay);
+	igt_assert_eq(crtc->buffer_id, fb.fb_id);
+	drmModeFreeCrtc(crtc);
+
+	igt_plane_set_fb(primary, NULL);
+	igt_output_set_pipe(output, PIPE_NONE);
+	igt_display_commit2(&display, COMMIT_ATOMIC);
+
+	crtc = drmModeGetCrtc(fd, display.pipes[pipe].crtc_id);
+	igt_assert(crtc);
+	igt_assert(!crtc->mode_valid);
+	drmModeFreeCrtc(crtc);
+
+	igt_remove_fb(fd, &fb);
+	igt_display_fini(&display);
+
+	igt_kms_fake_get_stats(fd, &stats);
+	igt_info("%" PRIu64 " ioctls, %" PRIu64 " commits, %" PRIu64
+		 " tested, %" PRIu64 " failed\n", stats.ioctls, stats.commits,
+		 stats.test_commits, stats.failed);
+	igt_assert_lte(2, stats.commits);
+
+	igt_kms_fake_close(fd);
+	igt_assert(!igt_kms_fake_owns(fd));
+}
+
+static int commit_mode(int fd, uint32_t crtc, uint32_t connector,
+		       uint32_t blob, uint32_t flags)
+{
+	drmModeAtomicReq *req = drmModeAtomicAlloc();
+	int ret;
+
+	igt_assert(req);
+	drmModeAtomicAddProperty(req, crtc, ACTIVE, !!blob);
+	drmModeAtomicAddProperty(req, crtc, MODE_ID, blob);
+	drmModeAtomicAddProperty(req, connector, CRTC_ID, blob ? crtc : 0);
+
+	ret = drmModeAtomicCommit(fd, req, flags, NULL);
+	drmModeAtomicFree(req);
+
+	return ret ? -errno : 0;
+}
+
+static void test_checks(void)
+{
+	uint32_t blob;
+	drmModeCrtc *crtc;
+	int fd;
+
+	fd = open_fake(0, false);
+	igt_assert_eq(drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1), 0);
+	igt_assert_eq(drmModeCreatePropertyBlob(fd, &modes[1],
+						sizeof(modes[1]), &blob), 0);
+
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob, 0), -EINVAL);
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_A, blob,
+				  DRM_MODE_ATOMIC_ALLOW_MODESET), -EINVAL);
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob,
+				  DRM_MODE_ATOMIC_ALLOW_MODESET |
+				  DRM_MODE_ATOMIC_TEST_ONLY), 0);
+
+	crtc = drmModeGetCrtc(fd, CRTC_B);
+	igt_assert(!crtc->mode_valid);
+	drmModeFreeCrtc(crtc);
+
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob,
+				  DRM_MODE_ATOMIC_ALLOW_MODESET), 0);
+	igt_assert_eq(drmModeDestroyPropertyBlob(fd, blob), 0);
+
+	/* Still held by the crtc */
+	crtc = drmModeGetCrtc(fd, CRTC_B);
+	igt_assert(crtc->mode_valid);
+	igt_assert_eq(crtc->mode.hdisplay, modes[1].hdisplay);
+	drmModeFreeCrtc(crtc);
+
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, 0,
+				  DRM_MODE_ATOMIC_ALLOW_MODESET), 0);
+	igt_assert(!drmModeGetPropertyBlob(fd, blob));
+
+	/* The recorded fb is gone, the primary plane left without one */
+	crtc = drmModeGetCrtc(fd, CRTC_A);
+	igt_assert(crtc->mode_valid);
+	igt_assert_eq(crtc->buffer_id, 0);
+	drmModeFreeCrtc(crtc);
+
+	igt_kms_fake_close(fd);
+}
+
+static void test_latency(void)
+{
+	const uint64_t commit_ns = 20 * NSEC_PER_MSEC;
+	struct timespec start = { };
+	drmEventContext evctx = {
+		.version = 2,
+	};
+	struct pollfd pfd;
+	uint32_t blob;
+	int fd, ret;
+
+	fd = open_fake(commit_ns, true);
+	igt_assert_eq(drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1), 0);
+	igt_assert_eq(drmModeCreatePropertyBlob(fd, &modes[0],
+						sizeof(modes[0]), &blob), 0);
+
+	igt_nsec_elapsed(&start);
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob,
+				  DRM_MODE_ATOMIC_ALLOW_MODESET |
+				  DRM_MODE_ATOMIC_TEST_ONLY), 0);
+
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob,
+				  DRM_MODE_ATOMIC_ALLOW_MODESET), 0);
+	igt_assert_lte_u64(commit_ns, igt_nsec_elapsed(&start));
+
+	/* A flip waits for the next vblank, a frame of 16.7ms */
+	memset(&start, 0, sizeof(start));
+	igt_nsec_elapsed(&start);
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob,
+				  DRM_MODE_ATOMIC_NONBLOCK |
+				  DRM_MODE_PAGE_FLIP_EVENT), 0);
+
+	/* Busy until the flip is done, unless we got preempted for that long */
+	ret = commit_mode(fd, CRTC_B, CONNECTOR_B, blob,
+			  DRM_MODE_ATOMIC_NONBLOCK);
+	if (igt_nsec_elapsed(&start) < commit_ns)
+		igt_assert_eq(ret, -EBUSY);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	igt_assert_eq(poll(&pfd, 1, 0), 1);
+	igt_assert_eq(drmHandleEvent(fd, &evctx), 0);
+
+	igt_assert_eq(commit_mode(fd, CRTC_B, CONNECTOR_B, blob, 0), 0);
+	igt_assert_lte_u64(commit_ns + 16 * NSEC_PER_MSEC,
+			   igt_nsec_elapsed(&start));
+
+	igt_kms_fake_close(fd);
+}
+
+static char *read_file(const char *filename)
+{
+	char *data;
+	FILE *f;
+	long len;
+
+	f = fopen(filename, "r");
+	igt_assert(f);
+	igt_assert_eq(fseek(f, 0, SEEK_END), 0);
+	len = ftell(f);
+	rewind(f);
+
+	data = calloc(1, len + 1);
+	igt_assert(data);
+	igt_assert_eq(fread(data, 1, len, f), len);
+	fclose(f);
+
+	return data;
+}
+
+static void test_record(void)
+{
+	char first[] = "/tmp/igt_kms_fake.XXXXXX";
+	char second[] = "/tmp/igt_kms_fake.XXXXXX";
+	char *a, *b;
+	int fd, replay;
+
+	close(mkstemp(first));
+	close(mkstemp(second));
+
+	fd = open_fake(0, false);
+	igt_assert_eq(igt_kms_fake_record(fd, first), 0);
+
+	replay = igt_kms_fake_open(first, NULL);
+	igt_assert_lte(0, replay);
+	igt_assert_eq(igt_kms_fake_record(replay, second), 0);
+
+	a = read_file(first);
+	b = read_file(second);
+	igt_assert_eq(strcmp(a, b), 0);
+	free(a);
+	free(b);
+
+	igt_kms_fake_close(replay);
+	igt_kms_fake_close(fd);
+	unlink(first);
+	unlink(second);
+}
+
+igt_main
+{
+	igt_fixture {
+		int fd = mkstemp(recording);
+
+		igt_assert(fd >= 0);
+		close(fd);
+		write_recording(recording);
+	}
+
+	igt_subtest("display")
+		test_display();
+
+	igt_subtest("checks")
+		test_checks();
+
+	igt_subtest("latency")
+		test_latency();
+
+	igt_subtest("record")
+		test_record();
+
+	igt_fixture
+		unlink(recording);
+}
@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_core.h"
+#include "igt_kms.h"
+#include "igt_kms_props.h"
+#include "ioctl_wrappers.h"
+
+IGT_TEST_DESCRIPTION("Check the cache of KMS property metadata against a fake "
+		     "device");
+
+#define NR_PIPES 4
+#define NR_PLANES 32
+#define NR_CONNECTORS 4
+#define MAX_PROPS 512
+#define MAX_OBJECT_PROPS 32
+
+static const char * const rotations[] = {
+	"rotate-0", "rotate-90", "rotate-180", "rotate-270",
+	"reflect-x", "reflect-y",
+};
+
+static const char * const plane_types[] = { "Overlay", "Primary", "Cursor" };
+
+/* A device of 4 pipes with 8 planes each, served by drmIoctl() below */
+static struct {
+	struct drm_mode_get_property props[MAX_PROPS];
+	struct drm_mode_property_enum enums[MAX_PROPS][8];
+	uint64_t values[MAX_PROPS][8];
+	unsigned int nr_props;
+
+	struct fake_object {
+		uint32_t id, type;
+		uint32_t props[MAX_OBJECT_PROPS];
+		uint64_t values[MAX_OBJECT_PROPS];
+		unsigned int count;
+		unsigned int hidden; /* trailing props left out, as by caps */
+	} objects[NR_PIPES + NR_PLANES + NR_CONNECTORS];
+	unsigned int nr_objects;
+
+	unsigned int get_properties, get_property;
+} dev;
+
+static int fake_fd = -1;
+
+static struct fake_object *find_object(uint32_t id)
+{
+	for (unsigned int i = 0; i < dev.nr_objects; i++)
+		if (dev.objects[i].id == id)
+			return &dev.objects[i];
+
+	return NULL;
+}
+
+static int get_properties(struct drm_mode_obj_get_properties *arg)
+{
+	struct fake_object *obj = find_object(arg->obj_id);
+	unsigned int count;
+
+	dev.get_properties++;
+
+	if (!obj || (arg->obj_type && arg->obj_type != obj->type))
+		return -ENOENT;
+
+	count = obj->count - obj->hidden;
+	if (count && arg->count_props >= count) {
+		memcpy(from_user_pointer(arg->props_ptr), obj->props,
+		       count * sizeof(*obj->props));
+		memcpy(from_user_pointer(arg->prop_values_ptr), obj->values,
+		       count * sizeof(*obj->values));
+	}
+	arg->count_props = count;
+
+	return 0;
+}
+
+static int get_property(struct drm_mode_get_property *arg)
+{
+	const struct drm_mode_get_property *prop;
+	unsigned int i = arg->prop_id - 1;
+
+	dev.get_property++;
+
+	if (i >= dev.nr_props)
+		return -ENOENT;
+
+	prop = &dev.props[i];
+	if (prop->count_values && arg->count_values >= prop->count_values)
+		memcpy(from_user_pointer(arg->values_ptr), dev.values[i],
+		       prop->count_values * sizeof(uint64_t));
+	if (prop->count_enum_blobs &&
+	    arg->count_enum_blobs >= prop->count_enum_blobs)
+		memcpy(from_user_pointer(arg->enum_blob_ptr), dev.enums[i],
+		       prop->count_enum_blobs * sizeof(*dev.enums[i]));
+
+	arg->flags = prop->flags;
+	memcpy(arg->name, prop->name, sizeof(arg->name));
+	arg->count_values = prop->count_values;
+	arg->count_enum_blobs = prop->count_enum_blobs;
+
+	return 0;
+}
+
+/* Overrides the one of libdrm, for the fd of the fake device only. */
+int drmIoctl(int fd, unsigned long request, void *arg)
+{
+	int ret;
+
+	if (fd != fake_fd) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	switch (request) {
+	case DRM_IOCTL_MODE_OBJ_GETPROPERTIES:
+		ret = get_properties(arg);
+		break;
+	case DRM_IOCTL_MODE_GETPROPERTY:
+		ret = get_property(arg);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+static uint32_t add_prop(const char *name, uint32_t flags,
+			 const char * const *enums, unsigned int count)
+{
+	struct drm_mode_get_property *prop;
+	unsigned int i = dev.nr_props++;
+
+	igt_assert(i < MAX_PROPS);
+	prop = &dev.props[i];
+	prop->prop_id = i + 1;
+	prop->flags = flags;
+	snprintf(prop->name, sizeof(prop->name), "%s", name);
+
+	if (flags & (DRM_MODE_PROP_ENUM | DRM_MODE_PROP_BITMASK)) {
+		for (unsigned int j = 0; j < count; j++) {
+			dev.enums[i][j].value = j;
+			snprintf(dev.enums[i][j].name,
+				 sizeof(dev.enums[i][j].name), "%s", enums[j]);
+			dev.values[i][j] = j;
+		}
+		prop->count_enum_blobs = count;
+		prop->count_values = count;
+	} else if (flags & DRM_MODE_PROP_RANGE) {
+		dev.values[i][1] = UINT32_MAX;
+		prop->count_values = 2;
+	}
+
+	return prop->prop_id;
+}
+
+static struct fake_object *add_object(uint32_t type)
+{
+	struct fake_object *obj = &dev.objects[dev.nr_objects++];
+
+	obj->id = 1000 + dev.nr_objects;
+	obj->type = type;
+
+	return obj;
+}
+
+static void attach(struct fake_object *obj, uint32_t prop, uint64_t value)
+{
+	igt_assert(obj->count < MAX_OBJECT_PROPS);
+	obj->props[obj->count] = prop;
+	obj->values[obj->count] = value;
+	obj->count++;
+}
+
+static void attach_all(struct fake_object *obj, const uint32_t *ids,
+		       unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		if (ids[i])
+			attach(obj, ids[i], i);
+}
+
+static void create_device(void)
+{
+	uint32_t crtc[IGT_NUM_CRTC_PROPS], plane[IGT_NUM_PLANE_PROPS];
+	uint32_t connector[IGT_NUM_CONNECTOR_PROPS];
+	uint32_t edid, type;
+	unsigned int i;
+
+	memset(&dev, 0, sizeof(dev));
+
+	for (i = 0; i < IGT_NUM_CRTC_PROPS; i++)
+		crtc[i] = add_prop(igt_crtc_prop_names[i],
+				   DRM_MODE_PROP_RANGE, NULL, 0);
+
+	/* The type comes first and each plane has a zpos of its own */
+	for (i = 0; i < IGT_NUM_PLANE_PROPS; i++) {
+		if (i == IGT_PLANE_TYPE || i == IGT_PLANE_ZPOS)
+			plane[i] = 0;
+		else if (i == IGT_PLANE_ROTATION)
+			plane[i] = add_prop("rotation", DRM_MODE_PROP_BITMASK,
+					    rotations, ARRAY_SIZE(rotations));
+		else
+			plane[i] = add_prop(igt_plane_prop_names[i],
+					    DRM_MODE_PROP_RANGE, NULL, 0);
+	}
+	type = add_prop("type", DRM_MODE_PROP_ENUM | DRM_MODE_PROP_IMMUTABLE,
+			plane_types, ARRAY_SIZE(plane_types));
+
+	for (i = 0; i < IGT_NUM_CONNECTOR_PROPS; i++)
+		connector[i] = add_prop(igt_connector_prop_names[i],
+					DRM_MODE_PROP_RANGE, NULL, 0);
+	edid = add_prop("EDID", DRM_MODE_PROP_BLOB | DRM_MODE_PROP_IMMUTABLE,
+			NULL, 0);
+
+	for (i = 0; i < NR_PIPES; i++)
+		attach_all(add_object(DRM_MODE_OBJECT_CRTC), crtc,
+			   IGT_NUM_CRTC_PROPS);
+
+	for (i = 0; i < NR_PLANES; i++) {
+		struct fake_object *obj = add_object(DRM_MODE_OBJECT_PLANE);
+
+		attach(obj, type, i % 8 == 0 ? 1 : 0);
+		attach_all(obj, plane, IGT_NUM_PLANE_PROPS);
+		attach(obj, add_prop("zpos", DRM_MODE_PROP_RANGE, NULL, 0),
+		       i % 8);
+	}
+
+	for (i = 0; i < NR_CONNECTORS; i++) {
+		struct fake_object *obj = add_object(DRM_MODE_OBJECT_CONNECTOR);
+
+		attach_all(obj, connector, IGT_NUM_CONNECTOR_PROPS);
+		attach(obj, edid, 0);
+	}
+}
+
+static void reset_counts(void)
+{
+	dev.get_properties = 0;
+	dev.get_property = 0;
+}
+
+static void test_lookup(void)
+{
+	struct fake_object *plane = &dev.objects[NR_PIPES + 1];
+	const drmModePropertyRes *info;
+	struct igt_kms_props *props;
+	drmModePropertyPtr prop;
+	uint64_t value;
+	uint32_t id;
+	int i;
+
+	props = igt_kms_props_get(fake_fd, plane->id, DRM_MODE_OBJECT_PLANE);
+	igt_assert(props);
+	igt_assert_eq(props->count, plane->count);
+	igt_assert(!memcmp(props->ids, plane->props,
+			   plane->count * sizeof(*plane->props)));
+
+	i = igt_kms_props_find(props, "rotation");
+	igt_assert(i >= 0);
+	info = props->info[i];
+	igt_assert(!strcmp(info->name, "rotation"));
+	igt_assert(info->flags & DRM_MODE_PROP_BITMASK);
+	igt_assert_eq(info->count_enums, ARRAY_SIZE(rotations));
+	igt_assert(!strcmp(info->enums[3].name, "rotate-270"));
+	igt_assert(igt_kms_prop_info(fake_fd, props->ids[i]) == info);
+
+	i = igt_kms_props_find(props, "zpos");
+	igt_assert(i >= 0);
+	igt_assert_eq(props->ids[i], plane->props[plane->count - 1]);
+	igt_assert_eq_u64(props->values[i], 1);
+
+	igt_assert_eq(igt_kms_props_find(props, "no such property"), -1);
+	igt_assert_eq(igt_kms_props_find(props, "Rotation"), -1);
+	igt_kms_props_put(props);
+
+	igt_assert(!igt_kms_props_get(fake_fd, 1, DRM_MODE_OBJECT_PLANE));
+	igt_assert(!igt_kms_props_get(fake_fd, plane->id,
+				      DRM_MODE_OBJECT_CRTC));
+	igt_assert(!igt_kms_prop_info(fake_fd, MAX_PROPS + 1));
+
+	igt_assert(kmstest_get_property(fake_fd, plane->id,
+					DRM_MODE_OBJECT_PLANE, "type",
+					&id, &value, &prop));
+	igt_assert_eq(id, plane->props[0]);
+	igt_assert_eq_u64(value, 0);
+	igt_assert(!strcmp(prop->name, "type"));
+	igt_assert_eq(prop->count_enums, ARRAY_SIZE(plane_types));
+	drmModeFreeProperty(prop);
+
+	igt_assert(!kmstest_get_property(fake_fd, plane->id,
+					 DRM_MODE_OBJECT_PLANE, "EDID",
+					 NULL, NULL, NULL));
+}
+
+/* Looks up all the names igt_kms does, as igt_display_require() would */
+static void lookup_all(void)
+{
+	for (unsigned int i = 0; i < dev.nr_objects; i++) {
+		const struct fake_object *obj = &dev.objects[i];
+		const char * const *names;
+		struct igt_kms_props *props;
+		unsigned int count, found = 0;
+
+		switch (obj->type) {
+		case DRM_MODE_OBJECT_CRTC:
+			names = igt_crtc_prop_names;
+			count = IGT_NUM_CRTC_PROPS;
+			break;
+		case DRM_MODE_OBJECT_PLANE:
+			names = igt_plane_prop_names;
+			count = IGT_NUM_PLANE_PROPS;
+			break;
+		default:
+			names = igt_connector_prop_names;
+			count = IGT_NUM_CONNECTOR_PROPS;
+			break;
+		}
+
+		props = igt_kms_props_get(fake_fd, obj->id, obj->type);
+		igt_assert(props);
+		for (unsigned int j = 0; j < count; j++)
+			found += igt_kms_props_find(props, names[j]) >= 0;
+		igt_assert_eq(found, count);
+		igt_kms_props_put(props);
+	}
+}
+
+/* The lookup before the cache: every property of the object, by name */
+static void lookup_all_uncached(void)
+{
+	for (unsigned int i = 0; i < dev.nr_objects; i++) {
+		const struct fake_object *obj = &dev.objects[i];
+		drmModeObjectPropertiesPtr list;
+
+		list = drmModeObjectGetProperties(fake_fd, obj->id, obj->type);
+		igt_assert(list);
+		for (unsigned int j = 0; j < list->count_props; j++) {
+			drmModePropertyPtr prop;
+
+			prop = drmModeGetProperty(fake_fd, list->props[j]);
+			igt_assert(prop);
+			drmModeFreeProperty(prop);
+		}
+		drmModeFreeObjectProperties(list);
+	}
+}
+
+static void test_ioctls(void)
+{
+	unsigned int uncached, first, cached, total_props = 0;
+	struct timespec start;
+	double t_uncached, t_cached;
+
+	for (unsigned int i = 0; i < dev.nr_objects; i++)
+		total_props += dev.objects[i].count;
+
+	reset_counts();
+	igt_gettime(&start);
+	lookup_all_uncached();
+	t_uncached = igt_nsec_elapsed(&start) / 1e3;
+	uncached = dev.get_properties + dev.get_property;
+	igt_assert_eq(dev.get_property, 2 * total_props);
+
+	igt_kms_props_invalidate(fake_fd);
+	reset_counts();
+	lookup_all();
+	first = dev.get_properties + dev.get_property;
+	igt_assert_eq(dev.get_property, 2 * dev.nr_props);
+
+	/* Once cached, only the property lists are fetched */
+	reset_counts();
+	igt_gettime(&start);
+	lookup_all();
+	t_cached = igt_nsec_elapsed(&start) / 1e3;
+	cached = dev.get_properties + dev.get_property;
+	igt_assert_eq(dev.get_property, 0);
+	igt_assert_eq(dev.get_properties, 2 * dev.nr_objects);
+
+	igt_info("%u objects, %u properties: %u ioctls in %.1fus uncached, "
+		 "%u when filling the cache, %u in %.1fus cached\n",
+		 dev.nr_objects, total_props, uncached, t_uncached,
+		 first, cached, t_cached);
+	igt_assert(cached * 10 < uncached);
+}
+
+static void test_invalidate(void)
+{
+	struct fake_object *connector = &dev.objects[dev.nr_objects - 1];
+	struct igt_kms_props *props, *hidden;
+	uint32_t edid = connector->props[connector->count - 1];
+	int i;
+
+	lookup_all();
+
+	/* Without the cap, the last property is not listed */
+	connector->hidden = 1;
+	reset_counts();
+	hidden = igt_kms_props_get(fake_fd, connector->id,
+				   DRM_MODE_OBJECT_CONNECTOR);
+	igt_assert(hidden);
+	igt_assert_eq(hidden->count, connector->count - 1);
+	igt_assert_eq(igt_kms_props_find(hidden, "EDID"), -1);
+	igt_assert_eq(dev.get_property, 0);
+
+	connector->hidden = 0;
+	props = igt_kms_props_get(fake_fd, connector->id,
+				  DRM_MODE_OBJECT_CONNECTOR);
+	i = igt_kms_props_find(props, "EDID");
+	igt_assert(i >= 0 && props->ids[i] == edid);
+	igt_assert_eq(dev.get_property, 0);
+
+	/* Still usable after being replaced */
+	igt_assert(igt_kms_props_find(hidden, "DPMS") >= 0);
+	igt_kms_props_put(hidden);
+	igt_kms_props_put(props);
+
+	/* The property was destroyed on hotplug and its id reused */
+	snprintf(dev.props[edid - 1].name, DRM_PROP_NAME_LEN, "PATH");
+	igt_kms_props_invalidate(-1);
+	reset_counts();
+	props = igt_kms_props_get(fake_fd, connector->id,
+				  DRM_MODE_OBJECT_CONNECTOR);
+	igt_assert_eq(igt_kms_props_find(props, "EDID"), -1);
+	igt_assert(igt_kms_props_find(props, "PATH") >= 0);
+	igt_assert_eq(dev.get_property, 2 * connector->count);
+	igt_kms_props_put(props);
+
+	snprintf(dev.props[edid - 1].name, DRM_PROP_NAME_LEN, "EDID");
+	igt_kms_props_invalidate(fake_fd);
+
+	/* Properties handed out outlive the cache until released */
+	props = igt_kms_props_get(fake_fd, connector->id,
+				  DRM_MODE_OBJECT_CONNECTOR);
+	igt_assert(props);
+	igt_kms_props_invalidate(fake_fd);
+	igt_kms_props_put(props);
+}
+
+igt_main
+{
+	igt_fixture {
+		fake_fd = open("/dev/null", O_RDWR);
+		igt_assert(fake_fd >= 0);
+		create_device();
+	}
+
+	igt_subtest("lookup")
+		test_lookup();
+
+	igt_subtest("ioctls")
+		test_ioctls();
+
+	igt_subtest("invalidate")
+		test_invalidate();
+
+	igt_fixture {
+		igt_kms_props_invalidate(fake_fd);
+		close(fake_fd);
+	}
+}
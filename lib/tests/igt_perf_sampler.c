@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_perf_sampler.h"
+
+IGT_TEST_DESCRIPTION("Check the periodic perf sampler against mock group fds");
+
+#define GROUP_FORMAT (PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED)
+#define SCALED_FORMAT (GROUP_FORMAT | PERF_FORMAT_TOTAL_TIME_RUNNING)
+
+#define PERIOD_NS 2000000ull /* 2ms */
+
+/* A pipe stands in for a group leader, records are queued up front. */
+static int mock_group(int fds[2])
+{
+	igt_assert_eq(pipe2(fds, O_NONBLOCK), 0);
+	return fds[0];
+}
+
+static void queue(int fd, uint64_t enabled, uint64_t running,
+		  const uint64_t *val, unsigned int num, bool scaled)
+{
+	uint64_t buf[8];
+	unsigned int n = 0;
+
+	buf[n++] = num;
+	buf[n++] = enabled;
+	if (scaled)
+		buf[n++] = running;
+	memcpy(&buf[n], val, num * sizeof(*val));
+	n += num;
+
+	igt_assert_eq(write(fd, buf, n * sizeof(buf[0])), n * sizeof(buf[0]));
+}
+
+static void test_sampling(void)
+{
+	const unsigned int count = 50;
+	struct igt_perf_sample *sample, *first;
+	struct igt_perf_sampler *s;
+	uint64_t missed = 0;
+	int main_fds[2], other_fds[2];
+	int64_t latest = -1;
+
+	s = igt_perf_sampler_create(PERIOD_NS, 2 * count);
+	igt_assert(s);
+
+	igt_assert_eq(igt_perf_sampler_add_group(s, mock_group(main_fds), 2,
+						 GROUP_FORMAT), 0);
+	igt_assert_eq(igt_perf_sampler_add_group(s, mock_group(other_fds), 1,
+						 SCALED_FORMAT), 2);
+	igt_assert_eq(igt_perf_sampler_add_group(s, -1, 1, PERF_FORMAT_GROUP |
+						 PERF_FORMAT_ID), -EINVAL);
+
+	for (uint64_t i = 0; i < count; i++) {
+		uint64_t val[2] = { 10 * i, 20 * i };
+
+		queue(main_fds[1], 1000 * i, 0, val, 2, false);
+		/* Counter only scheduled half of the time */
+		queue(other_fds[1], 1000 * i, 500 * i, val, 1, true);
+	}
+
+	sample = igt_perf_sampler_alloc_sample(s);
+	first = igt_perf_sampler_alloc_sample(s);
+	igt_assert(sample && first);
+
+	igt_assert_eq(igt_perf_sampler_start(s), 0);
+	igt_assert(igt_perf_sampler_latest(s) >= 0);
+	igt_assert_eq(igt_perf_sampler_read(s, 0, first), 0);
+
+	while (latest < count - 1) {
+		latest = igt_perf_sampler_wait(s, latest, 1000);
+		igt_assert(latest >= 0);
+	}
+
+	for (uint64_t i = 0; i < count; i++) {
+		igt_assert_eq(igt_perf_sampler_read(s, i, sample), 0);
+		igt_assert_eq_u64(sample->index, i);
+		igt_assert_eq(sample->num_values, 3);
+		igt_assert_eq_u64(sample->timestamp, 1000 * i);
+		igt_assert_eq_u64(sample->val[0], 10 * i);
+		igt_assert_eq_u64(sample->val[1], 20 * i);
+		igt_assert_eq_u64(sample->val[2], 2 * 10 * i);
+
+		/* Deadlines stay on the grid, however late the reads were */
+		missed += sample->missed;
+		igt_assert_eq_u64(sample->deadline - first->deadline,
+				  (i + missed) * PERIOD_NS);
+		igt_assert(sample->read_time >= sample->deadline);
+	}
+	igt_debug("%"PRIu64" ticks missed\n", missed);
+
+	/* Running out of records stops the sampler with the read error */
+	igt_assert_eq(igt_perf_sampler_wait(s, count - 1, 1000), -EAGAIN);
+	igt_assert_eq(igt_perf_sampler_read(s, count - 1, sample), 0);
+	igt_assert_eq(igt_perf_sampler_read(s, count, sample), -EAGAIN);
+
+	igt_perf_sampler_destroy(s);
+	free(sample);
+	free(first);
+	close(main_fds[0]);
+	close(main_fds[1]);
+	close(other_fds[0]);
+	close(other_fds[1]);
+}
+
+static void test_history(void)
+{
+	const uint64_t val = 1;
+	struct igt_perf_sample *sample;
+	struct igt_perf_sampler *s;
+	int fds[2];
+	int64_t latest = -1;
+
+	s = igt_perf_sampler_create(PERIOD_NS, 4);
+	igt_assert(s);
+	igt_assert_eq(igt_perf_sampler_add_group(s, mock_group(fds), 1,
+						 GROUP_FORMAT), 0);
+	for (int i = 0; i < 10; i++)
+		queue(fds[1], i, 0, &val, 1, false);
+
+	sample = igt_perf_sampler_alloc_sample(s);
+	igt_assert(sample);
+	igt_assert_eq(igt_perf_sampler_start(s), 0);
+
+	while (latest < 9) {
+		latest = igt_perf_sampler_wait(s, latest, 1000);
+		igt_assert(latest >= 0);
+	}
+
+	igt_assert_eq(igt_perf_sampler_read(s, 5, sample), -ENODATA);
+	for (int i = 6; i < 10; i++) {
+		igt_assert_eq(igt_perf_sampler_read(s, i, sample), 0);
+		igt_assert_eq_u64(sample->timestamp, i);
+	}
+
+	igt_perf_sampler_destroy(s);
+	free(sample);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void test_stop(void)
+{
+	const uint64_t val = 1;
+	struct igt_perf_sampler *s;
+	struct timespec start, end;
+	int fds[2];
+
+	/* A long period must neither delay the first sample nor stopping */
+	s = igt_perf_sampler_create(60ull * 1000000000, 2);
+	igt_assert(s);
+	igt_assert_eq(igt_perf_sampler_add_group(s, mock_group(fds), 1,
+						 GROUP_FORMAT), 0);
+	queue(fds[1], 1, 0, &val, 1, false);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	igt_assert_eq(igt_perf_sampler_start(s), 0);
+	igt_assert_eq(igt_perf_sampler_wait(s, -1, 0), 0);
+	igt_assert_eq(igt_perf_sampler_wait(s, 0, 10), -ETIMEDOUT);
+	igt_perf_sampler_destroy(s);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	igt_assert(end.tv_sec - start.tv_sec < 5);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+igt_main
+{
+	igt_subtest("sampling")
+		test_sampling();
+
+	igt_subtest("history")
+		test_history();
+
+	igt_subtest("stop")
+		test_stop();
+}
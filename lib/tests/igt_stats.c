@@ -228,6 +228,64 @@ static void test_reallocation(void)
 	igt_stats_fini(&stats);
 }
 
+static void assert_percentile(struct igt_histogram *h, double percentile,
+			      uint64_t expected)
+{
+	uint64_t v = igt_histogram_get_percentile(h, percentile);
+
+	/* Within the precision, and never below the exact answer */
+	igt_assert(v >= expected);
+	igt_assert(v - expected <= expected >> 7);
+}
+
+static void test_histogram(void)
+{
+	struct igt_histogram h, lo, hi;
+	uint64_t i;
+
+	igt_histogram_init(&h, 7, 1000000000);
+	igt_histogram_init(&lo, 7, 1000000000);
+	igt_histogram_init(&hi, 7, 1000000000);
+
+	for (i = 1; i <= 100000; i++) {
+		igt_histogram_add(&h, i);
+		igt_histogram_add(i <= 50000 ? &lo : &hi, i);
+	}
+
+	igt_assert_eq_u64(igt_histogram_get_count(&h), 100000);
+	igt_assert_eq_u64(igt_histogram_get_min(&h), 1);
+	igt_assert_eq_u64(igt_histogram_get_max(&h), 100000);
+	igt_assert_eq_double(igt_histogram_get_mean(&h), 50000.5);
+	igt_assert_eq_u64(igt_histogram_get_percentile(&h, 0), 1);
+	igt_assert_eq_u64(igt_histogram_get_percentile(&h, 0.1), 100);
+	assert_percentile(&h, 50, 50000);
+	assert_percentile(&h, 99, 99000);
+	assert_percentile(&h, 99.9, 99900);
+	igt_assert_eq_u64(igt_histogram_get_percentile(&h, 100), 100000);
+
+	/* Merging the halves gives back the whole */
+	igt_assert(igt_histogram_merge(&lo, &hi));
+	igt_assert_eq_u64(igt_histogram_get_count(&lo), 100000);
+	igt_assert_eq_u64(igt_histogram_get_min(&lo), 1);
+	igt_assert_eq_u64(igt_histogram_get_max(&lo), 100000);
+	for (i = 0; i <= 1000; i++)
+		igt_assert_eq_u64(igt_histogram_get_percentile(&lo, i / 10.),
+				  igt_histogram_get_percentile(&h, i / 10.));
+
+	/* Values past the limit count as the limit */
+	igt_histogram_add(&h, ~0ull);
+	igt_assert_eq_u64(igt_histogram_get_max(&h), 1000000000);
+	igt_assert_eq_u64(igt_histogram_get_percentile(&h, 100), 1000000000);
+
+	igt_histogram_fini(&hi);
+	igt_histogram_init(&hi, 6, 1000000000);
+	igt_assert(!igt_histogram_merge(&lo, &hi));
+
+	igt_histogram_fini(&h);
+	igt_histogram_fini(&lo);
+	igt_histogram_fini(&hi);
+}
+
 igt_simple_main
 {
 	test_init_zero();
@@ -240,4 +298,5 @@ igt_simple_main
 	test_invalidate_mean();
 	test_std_deviation();
 	test_reallocation();
+	test_histogram();
 }
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <i915_drm.h>
+
+#include "igt_core.h"
+#include "igt_stream_capture.h"
+
+IGT_TEST_DESCRIPTION("Check the perf stream capture against a pipe");
+
+#define REPORT_SIZE 256
+#define N_RECORDS 4000
+#define RECORD_SIZE (sizeof(struct drm_i915_perf_record_header) + REPORT_SIZE)
+
+static uint8_t *stream;
+static size_t stream_len;
+static uint32_t n_samples, n_reports_lost, n_buffers_lost;
+
+static void build_stream(void)
+{
+	stream = malloc(N_RECORDS * RECORD_SIZE);
+	igt_assert(stream);
+
+	for (uint32_t i = 0; i < N_RECORDS; i++) {
+		struct drm_i915_perf_record_header *header = (void *)(stream + stream_len);
+
+		header->type = DRM_I915_PERF_RECORD_SAMPLE;
+		header->size = RECORD_SIZE;
+		if (i % 97 == 96) {
+			header->type = DRM_I915_PERF_RECORD_OA_REPORT_LOST;
+			header->size = sizeof(*header);
+			n_reports_lost++;
+		} else if (i % 1000 == 999) {
+			header->type = DRM_I915_PERF_RECORD_OA_BUFFER_LOST;
+			header->size = sizeof(*header);
+			n_buffers_lost++;
+		} else {
+			memset(header + 1, i, REPORT_SIZE);
+			n_samples++;
+		}
+		stream_len += header->size;
+	}
+}
+
+static int tmpfile_fd(void)
+{
+	FILE *file = tmpfile();
+
+	igt_assert(file);
+	return dup(fileno(file));
+}
+
+/*
+ * Feeds the stream through a non blocking pipe in odd sized chunks,
+ * pumping the capture whenever it has data.
+ */
+static void run(struct igt_capture *cap, int pipe_fd[2])
+{
+	size_t offset = 0;
+
+	igt_assert_eq(igt_capture_start(cap), 0);
+
+	while (offset < stream_len) {
+		struct pollfd pfd = {
+			.fd = igt_capture_poll_fd(cap),
+			.events = POLLIN,
+		};
+		size_t len = stream_len - offset < 3001 ? stream_len - offset : 3001;
+		ssize_t ret = write(pipe_fd[1], stream + offset, len);
+
+		if (ret > 0)
+			offset += ret;
+		else
+			igt_assert(errno == EAGAIN);
+
+		if (poll(&pfd, 1, 0) > 0)
+			igt_assert_eq(igt_capture_pump(cap), 0);
+	}
+	close(pipe_fd[1]);
+
+	igt_assert_eq(igt_capture_stop(cap), 0);
+}
+
+static void open_pipe(int pipe_fd[2])
+{
+	igt_assert_eq(pipe2(pipe_fd, O_NONBLOCK), 0);
+}
+
+static void check_stats(struct igt_capture *cap)
+{
+	struct igt_capture_stats stats;
+
+	igt_capture_get_stats(cap, &stats);
+	igt_assert_eq_u64(stats.bytes_read, stream_len);
+	igt_assert_eq_u64(stats.samples, n_samples);
+	igt_assert_eq_u64(stats.reports_lost, n_reports_lost);
+	igt_assert_eq_u64(stats.buffers_lost, n_buffers_lost);
+}
+
+static void check_file(int fd, const uint8_t *expected, size_t len)
+{
+	uint8_t *data = malloc(len + 1);
+
+	igt_assert(data);
+	igt_assert_eq(pread(fd, data, len + 1, 0), len);
+	igt_assert(!memcmp(data, expected, len));
+	free(data);
+}
+
+static void test_file(bool threaded)
+{
+	struct igt_capture_options opts = {
+		.buffer_size = 16384,
+		.n_buffers = 4,
+		.threaded = threaded,
+		.cpu = threaded ? 0 : -1,
+	};
+	struct igt_capture_stats stats;
+	struct igt_capture *cap;
+	int pipe_fd[2], fd;
+
+	open_pipe(pipe_fd);
+	fd = tmpfile_fd();
+
+	cap = igt_capture_create(pipe_fd[0], fd, &opts);
+	igt_assert(cap);
+	run(cap, pipe_fd);
+
+	check_stats(cap);
+	igt_capture_get_stats(cap, &stats);
+	igt_assert_eq_u64(stats.bytes_written, stream_len);
+	igt_assert(stats.writes <= stats.reads);
+	check_file(fd, stream, stream_len);
+
+	igt_capture_destroy(cap);
+	close(pipe_fd[0]);
+	close(fd);
+}
+
+static void test_write(void)
+{
+	struct drm_i915_perf_record_header header = {
+		.type = DRM_I915_PERF_RECORD_OA_REPORT_LOST,
+		.size = sizeof(header),
+	};
+	struct igt_capture *cap;
+	int pipe_fd[2], fd;
+	uint8_t *expected;
+
+	open_pipe(pipe_fd);
+	fd = tmpfile_fd();
+
+	cap = igt_capture_create(pipe_fd[0], fd, NULL);
+	igt_assert(cap);
+	igt_assert_eq(igt_capture_start(cap), 0);
+
+	/* Our own records land after what was read from the stream so far */
+	igt_assert_eq(write(pipe_fd[1], stream, RECORD_SIZE), RECORD_SIZE);
+	igt_assert_eq(igt_capture_write(cap, &header, sizeof(header)), 0);
+	close(pipe_fd[1]);
+	igt_assert_eq(igt_capture_stop(cap), 0);
+
+	expected = malloc(RECORD_SIZE + sizeof(header));
+	memcpy(expected, stream, RECORD_SIZE);
+	memcpy(expected + RECORD_SIZE, &header, sizeof(header));
+	check_file(fd, expected, RECORD_SIZE + sizeof(header));
+
+	free(expected);
+	igt_capture_destroy(cap);
+	close(pipe_fd[0]);
+	close(fd);
+}
+
+static void test_stalled(void)
+{
+	struct igt_capture_options opts = {
+		.buffer_size = 8192,
+		.n_buffers = 2,
+		.threaded = true,
+		.cpu = -1,
+	};
+	struct igt_capture_stats stats;
+	struct igt_capture *cap;
+	int pipe_fd[2], fd;
+	ssize_t len;
+
+	open_pipe(pipe_fd);
+	fd = tmpfile_fd();
+
+	cap = igt_capture_create(pipe_fd[0], fd, &opts);
+	igt_assert(cap);
+	igt_assert_eq(igt_capture_start(cap), 0);
+
+	/* Fill every buffer without ever pumping, until the reader waits */
+	len = write(pipe_fd[1], stream, stream_len);
+	igt_assert(len > 2 * opts.buffer_size);
+	do {
+		usleep(1000);
+		igt_capture_get_stats(cap, &stats);
+	} while (!stats.stalls);
+	close(pipe_fd[1]);
+
+	igt_assert_eq(igt_capture_stop(cap), 0);
+
+	igt_capture_get_stats(cap, &stats);
+	igt_assert_eq_u64(stats.bytes_read, len);
+	igt_assert_eq_u64(stats.bytes_written, len);
+	check_file(fd, stream, len);
+
+	igt_capture_destroy(cap);
+	close(pipe_fd[0]);
+	close(fd);
+}
+
+static void test_ring(void)
+{
+	struct igt_capture_options opts = {
+		.buffer_size = 8192,
+		.cpu = -1,
+		.ring_size = 65536,
+	};
+	struct igt_capture_stats stats;
+	struct igt_capture *cap;
+	int pipe_fd[2], fd;
+	size_t offset = 0;
+	off_t len;
+
+	open_pipe(pipe_fd);
+	fd = tmpfile_fd();
+
+	cap = igt_capture_create(pipe_fd[0], -1, &opts);
+	igt_assert(cap);
+	run(cap, pipe_fd);
+
+	check_stats(cap);
+	igt_capture_get_stats(cap, &stats);
+	igt_assert(stats.ring_dropped > 0);
+
+	igt_assert_eq(igt_capture_dump(cap, fd), 0);
+	len = lseek(fd, 0, SEEK_END);
+	igt_assert(len > 0 && len <= opts.ring_size);
+	igt_assert_eq_u64(len + stats.ring_dropped, stream_len);
+
+	/* The dump is the tail of the stream, starting on a record */
+	while (offset < stream_len - len) {
+		const struct drm_i915_perf_record_header *header =
+			(void *)(stream + offset);
+
+		offset += header->size;
+	}
+	igt_assert_eq_u64(offset, stream_len - len);
+	check_file(fd, stream + offset, len);
+
+	igt_capture_destroy(cap);
+	close(pipe_fd[0]);
+	close(fd);
+}
+
+igt_main
+{
+	igt_fixture
+		build_stream();
+
+	igt_subtest("file")
+		test_file(false);
+
+	igt_subtest("threaded")
+		test_file(true);
+
+	igt_subtest("write")
+		test_write();
+
+	igt_subtest("stalled")
+		test_stalled();
+
+	igt_subtest("ring")
+		test_ring();
+
+	igt_fixture
+		free(stream);
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_trace_writer.h"
+
+IGT_TEST_DESCRIPTION("Check the framing of the traces written by igt_trace_writer");
+
+/* Enough to go through the output buffer several times */
+#define N_EVENTS 10000
+
+static int tmpfile_fd(void)
+{
+	FILE *file = tmpfile();
+
+	igt_assert(file);
+	return dup(fileno(file));
+}
+
+static char *read_all(int fd, size_t *len)
+{
+	off_t size = lseek(fd, 0, SEEK_END);
+	char *data = malloc(size + 1);
+
+	igt_assert(data);
+	igt_assert_eq(pread(fd, data, size, 0), size);
+	data[size] = '\0';
+	*len = size;
+
+	return data;
+}
+
+static void write_trace(int fd, enum igt_trace_format format)
+{
+	struct igt_trace_writer *writer;
+	uint32_t busy, contexts, events;
+
+	writer = igt_trace_writer_create(fd, format, "gpu \"0\"");
+	igt_assert(writer);
+
+	busy = igt_trace_writer_add_track(writer, "GpuBusy", IGT_TRACE_TRACK_COUNTER);
+	contexts = igt_trace_writer_add_track(writer, "Contexts", IGT_TRACE_TRACK_SLICES);
+	events = igt_trace_writer_add_track(writer, "Events", IGT_TRACE_TRACK_SLICES);
+
+	for (uint32_t i = 0; i < N_EVENTS; i++) {
+		igt_trace_writer_counter(writer, busy, 1000 * i + 1, i / 100.);
+		if (i % 10 == 0)
+			igt_trace_writer_slice(writer, contexts, "hw_id=0x1\n",
+					       1000 * i, 5000);
+	}
+	igt_trace_writer_instant(writer, events, "correlation", 42);
+
+	/* Events on the wrong kind of track are dropped */
+	igt_trace_writer_counter(writer, contexts, 0, 1);
+	igt_trace_writer_slice(writer, busy, "dropped", 0, 1);
+
+	igt_assert_eq(igt_trace_writer_close(writer), 0);
+}
+
+static unsigned int count(const char *haystack, const char *needle)
+{
+	unsigned int n = 0;
+
+	while ((haystack = strstr(haystack, needle))) {
+		haystack++;
+		n++;
+	}
+
+	return n;
+}
+
+static void test_json(void)
+{
+	const char prefix[] = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	int fd = tmpfile_fd();
+	size_t len;
+	char *data;
+
+	write_trace(fd, IGT_TRACE_FORMAT_JSON);
+	data = read_all(fd, &len);
+
+	igt_assert(!strncmp(data, prefix, strlen(prefix)));
+	igt_assert(!strcmp(data + len - 4, "\n]}\n"));
+	igt_assert(strstr(data, "\"args\":{\"name\":\"gpu \\\"0\\\"\"}"));
+	igt_assert(strstr(data, "\"name\":\"hw_id=0x1\\u000a\",\"ph\":\"X\","
+			  "\"ts\":10.000,\"dur\":5.000,\"pid\":1,\"tid\":2}"));
+	igt_assert(strstr(data, "\"ph\":\"C\",\"ts\":0.001,\"pid\":1,"
+			  "\"args\":{\"value\":0}}"));
+	igt_assert(strstr(data, "\"ph\":\"C\",\"ts\":9999.001,\"pid\":1,"
+			  "\"args\":{\"value\":99.99}}"));
+	igt_assert_eq(count(data, "\"ph\":\"C\""), N_EVENTS);
+	igt_assert_eq(count(data, "\"ph\":\"X\""), N_EVENTS / 10);
+	igt_assert_eq(count(data, "\"ph\":\"i\""), 1);
+	igt_assert(!strstr(data, "dropped"));
+	/* One separator between each event */
+	igt_assert_eq(count(data, "},\n{"), count(data, "\"ph\":") - 1);
+
+	free(data);
+	close(fd);
+}
+
+static uint64_t read_varint(const uint8_t **p, const uint8_t *end)
+{
+	uint64_t value = 0;
+
+	for (int shift = 0; *p < end; shift += 7) {
+		uint8_t byte = *(*p)++;
+
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+
+	igt_assert(!"truncated varint");
+	return 0;
+}
+
+static void test_perfetto(void)
+{
+	const uint8_t *p, *end;
+	unsigned int n_packets = 0, n_timestamps = 0;
+	int fd = tmpfile_fd();
+	size_t len;
+	char *data;
+
+	write_trace(fd, IGT_TRACE_FORMAT_PERFETTO);
+	data = read_all(fd, &len);
+
+	/* A Trace message is only made of TracePacket, field 1 */
+	p = (const uint8_t *)data;
+	end = p + len;
+	while (p < end) {
+		const uint8_t *packet_end;
+		uint64_t size;
+
+		igt_assert_eq(read_varint(&p, end), 1 << 3 | 2);
+		size = read_varint(&p, end);
+		igt_assert(size <= end - p);
+		packet_end = p + size;
+
+		while (p < packet_end) {
+			uint64_t tag = read_varint(&p, packet_end);
+
+			switch (tag & 7) {
+			case 0:
+				read_varint(&p, packet_end);
+				break;
+			case 1:
+				p += 8;
+				break;
+			case 2:
+				size = read_varint(&p, packet_end);
+				p += size;
+				break;
+			default:
+				igt_assert(!"unexpected wire type");
+			}
+			if (tag >> 3 == 8)
+				n_timestamps++;
+		}
+		igt_assert(p == packet_end);
+		n_packets++;
+	}
+
+	/* Root track, 3 tracks, the counters, slice begin/end pairs, an instant */
+	igt_assert_eq(n_packets, 1 + 3 + N_EVENTS + 2 * N_EVENTS / 10 + 1);
+	igt_assert_eq(n_timestamps, n_packets - 4);
+	igt_assert(memmem(data, len, "GpuBusy", 7));
+	igt_assert(memmem(data, len, "correlation", 11));
+	igt_assert(!memmem(data, len, "dropped", 7));
+
+	free(data);
+	close(fd);
+}
+
+igt_main
+{
+	igt_subtest("format") {
+		enum igt_trace_format format;
+
+		igt_assert_eq(igt_trace_format_parse("json", &format), 0);
+		igt_assert_eq(format, IGT_TRACE_FORMAT_JSON);
+		igt_assert_eq(igt_trace_format_parse("perfetto", &format), 0);
+		igt_assert_eq(format, IGT_TRACE_FORMAT_PERFETTO);
+		igt_assert_eq(igt_trace_format_parse("ctf", &format), -EINVAL);
+	}
+
+	igt_subtest("json")
+		test_json();
+
+	igt_subtest("perfetto")
+		test_perfetto();
+}
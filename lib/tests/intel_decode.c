@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "drmtest.h"
+#include "igt_core.h"
+#include "i915/intel_decode.h"
+
+IGT_TEST_DESCRIPTION("Check the commands seen by the intel_decode visitor");
+
+#define SKL_DEVID 0x1912
+#define BATCH_OFFSET 0x10000
+
+#define MI_NOOP			0
+#define MI_LOAD_REGISTER_IMM	(0x22 << 23 | 1)
+#define MI_BATCH_BUFFER_END	(0x0a << 23)
+#define PIPE_CONTROL		(0x7a00 << 16 | 4)
+
+static uint32_t batch[] = {
+	MI_NOOP,
+	MI_LOAD_REGISTER_IMM, 0x2580, 0x00010001,
+	PIPE_CONTROL, 0x00100000, 0, 0, 0, 0,
+	MI_NOOP,
+	MI_BATCH_BUFFER_END,
+};
+
+static const struct {
+	enum intel_decode_cmd_type type;
+	uint32_t opcode;
+	const char *name;
+	uint32_t dw;
+	uint32_t len;
+} expected[] = {
+	{ INTEL_DECODE_CMD_MI, 0x00, "MI_NOOP", 0, 1 },
+	{ INTEL_DECODE_CMD_MI, 0x22, "MI_LOAD_REGISTER_IMM", 1, 3 },
+	{ INTEL_DECODE_CMD_3D, 0x7a00, "PIPE_CONTROL", 4, 6 },
+	{ INTEL_DECODE_CMD_MI, 0x00, "MI_NOOP", 10, 1 },
+	{ INTEL_DECODE_CMD_MI, 0x0a, "MI_BATCH_BUFFER_END", 11, 1 },
+};
+
+struct visited {
+	struct intel_decode_cmd cmds[ARRAY_SIZE(expected) + 1];
+	uint32_t dw0[ARRAY_SIZE(expected) + 1];
+	unsigned int count;
+};
+
+static void visit(const struct intel_decode_cmd *cmd, void *data)
+{
+	struct visited *v = data;
+
+	igt_assert(v->count < ARRAY_SIZE(v->cmds));
+
+	/* cmd->data only lives until we return */
+	v->dw0[v->count] = cmd->data[0];
+	v->cmds[v->count++] = *cmd;
+}
+
+static struct intel_decode *decode_alloc(FILE *output)
+{
+	struct intel_decode *ctx;
+
+	ctx = intel_decode_context_alloc(SKL_DEVID);
+	igt_assert(ctx);
+
+	intel_decode_set_output_file(ctx, output);
+	intel_decode_set_batch_pointer(ctx, batch, BATCH_OFFSET,
+				       ARRAY_SIZE(batch));
+
+	return ctx;
+}
+
+static void check_visited(const struct visited *v)
+{
+	igt_assert_eq(v->count, ARRAY_SIZE(expected));
+
+	for (unsigned int i = 0; i < v->count; i++) {
+		const struct intel_decode_cmd *cmd = &v->cmds[i];
+
+		igt_assert_eq(cmd->type, expected[i].type);
+		igt_assert_eq_u32(cmd->opcode, expected[i].opcode);
+		igt_assert_eq_u32(cmd->len, expected[i].len);
+		igt_assert_eq_u32(cmd->hw_offset,
+				  BATCH_OFFSET + 4 * expected[i].dw);
+		igt_assert_eq_u32(v->dw0[i], batch[expected[i].dw]);
+		igt_assert(cmd->name);
+		igt_assert_eq(strcmp(cmd->name, expected[i].name), 0);
+	}
+}
+
+static void test_visitor(FILE *output)
+{
+	struct visited v = {};
+	struct intel_decode *ctx;
+
+	ctx = decode_alloc(output);
+	intel_decode_set_visitor(ctx, visit, &v);
+	intel_decode(ctx);
+	check_visited(&v);
+
+	/* Clearing the visitor stops the callbacks */
+	v.count = 0;
+	intel_decode_set_visitor(ctx, NULL, NULL);
+	intel_decode(ctx);
+	igt_assert_eq(v.count, 0);
+
+	intel_decode_context_free(ctx);
+}
+
+static void test_unknown(void)
+{
+	uint32_t unknown[] = { 0x3f << 23, MI_BATCH_BUFFER_END };
+	struct visited v = {};
+	struct intel_decode *ctx;
+
+	ctx = decode_alloc(NULL);
+	intel_decode_set_batch_pointer(ctx, unknown, BATCH_OFFSET,
+				       ARRAY_SIZE(unknown));
+	intel_decode_set_visitor(ctx, visit, &v);
+	intel_decode(ctx);
+
+	igt_assert_eq(v.count, 2);
+	igt_assert_eq(v.cmds[0].type, INTEL_DECODE_CMD_MI);
+	igt_assert_eq_u32(v.cmds[0].opcode, 0x3f);
+	igt_assert(!v.cmds[0].name);
+	igt_assert_eq_u32(v.cmds[1].hw_offset, BATCH_OFFSET + 4);
+
+	intel_decode_context_free(ctx);
+}
+
+static void test_summary(void)
+{
+	struct intel_decode *ctx;
+	char *text = NULL;
+	size_t size = 0;
+	FILE *f;
+
+	ctx = decode_alloc(NULL);
+	igt_assert_eq(intel_decode_set_summary(ctx, 1), 0);
+	intel_decode(ctx);
+	intel_decode(ctx);
+
+	f = open_memstream(&text, &size);
+	igt_assert(f);
+	intel_decode_print_summary(ctx, f);
+	fclose(f);
+
+	igt_debug("%s", text);
+	igt_assert(strstr(text, "           4  MI_NOOP\n"));
+	igt_assert(strstr(text, "           2  MI_LOAD_REGISTER_IMM\n"));
+	igt_assert(strstr(text, "           2  PIPE_CONTROL\n"));
+	igt_assert(strstr(text, "           2  MI_BATCH_BUFFER_END\n"));
+
+	free(text);
+	intel_decode_context_free(ctx);
+}
+
+igt_main
+{
+	igt_subtest("visitor") {
+		FILE *null = fopen("/dev/null", "w");
+
+		igt_assert(null);
+		test_visitor(null);
+		fclose(null);
+	}
+
+	igt_subtest("visitor-quiet")
+		test_visitor(NULL);
+
+	igt_subtest("unknown")
+		test_unknown();
+
+	igt_subtest("summary")
+		test_summary();
+}
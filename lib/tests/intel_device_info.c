@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+#include "igt_core.h"
+#include "intel_chipset.h"
+
+IGT_TEST_DESCRIPTION("Check the device info lookup against a linear search");
+
+igt_simple_main
+{
+	for (uint32_t devid = 0; devid <= UINT16_MAX; devid++) {
+		const struct intel_device_info *expected, *info;
+
+		expected = __intel_get_device_info_linear(devid);
+		info = intel_get_device_info(devid);
+
+		igt_assert_f(info == expected,
+			     "devid 0x%04x: got %s, expected %s\n", devid,
+			     info->codename ?: "generic",
+			     expected->codename ?: "generic");
+	}
+}
@@ -5,6 +5,8 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,6 +22,7 @@
 #include "xe_oa_data_reader.h"
 
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 static inline bool
@@ -100,10 +103,45 @@ find_metric_set(struct intel_xe_perf *perf, const char *symbol_name)
 }
 
 static bool
-parse_data(struct intel_xe_perf_data_reader *reader)
+load_perf(struct intel_xe_perf_data_reader *reader)
 {
 	const struct intel_xe_perf_record_device_info *record_info;
 	const struct intel_xe_perf_record_device_topology *record_topology;
+
+	record_info = reader->record_info;
+	record_topology = reader->record_topology;
+
+	reader->perf = intel_xe_perf_for_devinfo(record_info->device_id,
+						 record_info->device_revision,
+						 record_info->timestamp_frequency,
+						 record_info->gt_min_frequency,
+						 record_info->gt_max_frequency,
+						 &record_topology->topology);
+	if (!reader->perf) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Recording occured on unsupported device (0x%x)",
+			 record_info->device_id);
+		return false;
+	}
+
+	reader->devinfo = reader->perf->devinfo;
+
+	reader->metric_set_name = record_info->metric_set_name;
+	reader->metric_set_uuid = record_info->metric_set_uuid;
+	reader->metric_set = find_metric_set(reader->perf, record_info->metric_set_name);
+	if (!reader->metric_set) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Unknown metric set '%.200s'",
+			 record_info->metric_set_name);
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_data(struct intel_xe_perf_data_reader *reader)
+{
 	const uint8_t *end = reader->mmap_data + reader->mmap_size;
 	const uint8_t *iter = reader->mmap_data;
 
@@ -162,34 +200,24 @@ parse_data(struct intel_xe_perf_data_reader *reader)
 		return false;
 	}
 
-	record_info = reader->record_info;
-	record_topology = reader->record_topology;
-
-	reader->perf = intel_xe_perf_for_devinfo(record_info->device_id,
-						 record_info->device_revision,
-						 record_info->timestamp_frequency,
-						 record_info->gt_min_frequency,
-						 record_info->gt_max_frequency,
-						 &record_topology->topology);
-	if (!reader->perf) {
-		snprintf(reader->error_msg, sizeof(reader->error_msg),
-			 "Recording occured on unsupported device (0x%x)",
-			 record_info->device_id);
-		return false;
-	}
-
-	reader->devinfo = reader->perf->devinfo;
+	return load_perf(reader);
+}
 
-	reader->metric_set_name = record_info->metric_set_name;
-	reader->metric_set_uuid = record_info->metric_set_uuid;
-	reader->metric_set = find_metric_set(reader->perf, record_info->metric_set_name);
+static uint64_t
+correlate_in(const struct intel_xe_perf_data_reader *reader,
+	     uint32_t i, uint64_t gpu_ts)
+{
+	uint64_t mask = reader->perf->devinfo.oa_timestamp_mask;
 
-	return true;
+	return reader->correlations[i]->cpu_timestamp +
+		(gpu_ts - (reader->correlations[i]->gpu_timestamp & mask)) *
+		(reader->correlations[i + 1]->cpu_timestamp - reader->correlations[i]->cpu_timestamp) /
+		(reader->correlations[i + 1]->gpu_timestamp - reader->correlations[i]->gpu_timestamp);
 }
 
 static uint64_t
-correlate_gpu_timestamp(struct intel_xe_perf_data_reader *reader,
-			uint64_t gpu_ts)
+correlate_gpu_timestamp(const struct intel_xe_perf_data_reader *reader,
+			uint64_t gpu_ts, uint32_t *hint)
 {
 	/* OA reports only have the lower 32bits of the timestamp
 	 * register, while our correlation data has the whole 36bits.
@@ -205,6 +233,18 @@ correlate_gpu_timestamp(struct intel_xe_perf_data_reader *reader,
 	 */
 	gpu_ts = gpu_ts & mask;
 
+	/* Sequential walks mostly stay within the correlation interval
+	 * of the previous report, or move to the next one.
+	 */
+	for (uint32_t i = hint ? *hint : reader->n_correlations;
+	     i + 1 < reader->n_correlations && i <= *hint + 1; i++) {
+		if (gpu_ts >= (reader->correlations[i]->gpu_timestamp & mask) &&
+		    gpu_ts < (reader->correlations[i + 1]->gpu_timestamp & mask)) {
+			*hint = i;
+			return correlate_in(reader, i, gpu_ts);
+		}
+	}
+
 	for (uint32_t i = 0; i < reader->n_correlation_chunks; i++) {
 		if (gpu_ts >= (reader->correlation_chunks[i].gpu_ts_begin & mask) &&
 		    gpu_ts <= (reader->correlation_chunks[i].gpu_ts_end & mask)) {
@@ -225,10 +265,9 @@ correlate_gpu_timestamp(struct intel_xe_perf_data_reader *reader,
 	for (uint32_t i = corr_idx; i < (reader->n_correlations - 1); i++) {
 		if (gpu_ts >= (reader->correlations[i]->gpu_timestamp & mask) &&
 		    gpu_ts < (reader->correlations[i + 1]->gpu_timestamp & mask)) {
-			return reader->correlations[i]->cpu_timestamp +
-				(gpu_ts - (reader->correlations[i]->gpu_timestamp & mask)) *
-				(reader->correlations[i + 1]->cpu_timestamp - reader->correlations[i]->cpu_timestamp) /
-				(reader->correlations[i + 1]->gpu_timestamp - reader->correlations[i]->gpu_timestamp);
+			if (hint)
+				*hint = i;
+			return correlate_in(reader, i, gpu_ts);
 		}
 	}
 
@@ -257,9 +296,9 @@ append_timeline_event(struct intel_xe_perf_data_reader *reader,
 	reader->timelines[reader->n_timelines].ts_start = ts_start;
 	reader->timelines[reader->n_timelines].ts_end = ts_end;
 	reader->timelines[reader->n_timelines].cpu_ts_start =
-		correlate_gpu_timestamp(reader, ts_start);
+		correlate_gpu_timestamp(reader, ts_start, NULL);
 	reader->timelines[reader->n_timelines].cpu_ts_end =
-		correlate_gpu_timestamp(reader, ts_end);
+		correlate_gpu_timestamp(reader, ts_end, NULL);
 	reader->timelines[reader->n_timelines].record_start = record_start;
 	reader->timelines[reader->n_timelines].record_end = record_end;
 	reader->timelines[reader->n_timelines].hw_id = hw_id;
@@ -326,29 +365,40 @@ compute_correlation_chunks(struct intel_xe_perf_data_reader *reader)
 	}
 }
 
-bool
-intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
-			       int perf_file_fd)
+static bool
+map_file(struct intel_xe_perf_data_reader *reader, int fd,
+	 const uint8_t **data, size_t *size)
 {
 	struct stat st;
-	if (fstat(perf_file_fd, &st) != 0) {
+
+	if (fstat(fd, &st) != 0) {
 		snprintf(reader->error_msg, sizeof(reader->error_msg),
 			 "Unable to access file (%s)", strerror(errno));
 		return false;
 	}
 
-	memset(reader, 0, sizeof(*reader));
-
-	reader->mmap_size = st.st_size;
-	reader->mmap_data = (const uint8_t *) mmap(NULL, st.st_size,
-						   PROT_READ, MAP_PRIVATE,
-						   perf_file_fd, 0);
-	if (reader->mmap_data == MAP_FAILED) {
+	*size = st.st_size;
+	*data = (const uint8_t *) mmap(NULL, st.st_size,
+				       PROT_READ, MAP_PRIVATE, fd, 0);
+	if (*data == MAP_FAILED) {
+		*data = NULL;
 		snprintf(reader->error_msg, sizeof(reader->error_msg),
 			 "Unable to access file (%s)", strerror(errno));
 		return false;
 	}
 
+	return true;
+}
+
+bool
+intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
+			       int perf_file_fd)
+{
+	memset(reader, 0, sizeof(*reader));
+
+	if (!map_file(reader, perf_file_fd, &reader->mmap_data, &reader->mmap_size))
+		return false;
+
 	if (!parse_data(reader))
 		return false;
 
@@ -358,12 +408,456 @@ intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
 	return true;
 }
 
+static bool
+index_record_is_sample(const struct intel_xe_perf_data_reader *reader,
+		       uint64_t offset)
+{
+	const struct intel_xe_perf_record_header *header;
+
+	if (offset + sizeof(*header) > reader->mmap_size)
+		return false;
+
+	header = (const struct intel_xe_perf_record_header *)
+		(reader->mmap_data + offset);
+
+	return header->type == INTEL_XE_PERF_RECORD_TYPE_SAMPLE &&
+		offset + header->size <= reader->mmap_size;
+}
+
+/*
+ * Check that every indexed sample lies within the recording and that the
+ * timelines only point at indexed samples, the accessors don't check.
+ */
+static bool
+index_is_consistent(const struct intel_xe_perf_data_reader *reader)
+{
+	const struct intel_xe_perf_index_record *records = reader->index_records;
+	uint64_t sample_size = sizeof(struct intel_xe_perf_record_header) +
+		reader->metric_set->perf_raw_size;
+
+	/* Samples are in file order and don't overlap. */
+	for (uint32_t i = 0; i < reader->n_records; i++) {
+		uint64_t next = i + 1 < reader->n_records ?
+			records[i + 1].offset : reader->mmap_size;
+
+		if (records[i].offset > next ||
+		    next - records[i].offset < sample_size)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < reader->n_timelines; i++) {
+		const struct intel_xe_perf_index_timeline *timeline =
+			&reader->index_timelines[i];
+
+		if (timeline->record_start > timeline->record_end ||
+		    timeline->record_end >= reader->n_records)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Open a recording through an index written by
+ * intel_xe_perf_data_reader_write_index(). Only the device info, topology
+ * and correlation records are looked at, records and timelines are read
+ * lazily from the index.
+ */
+bool
+intel_xe_perf_data_reader_init_indexed(struct intel_xe_perf_data_reader *reader,
+				       int perf_file_fd, int index_fd)
+{
+	const struct intel_xe_perf_index_header *header;
+	const struct intel_xe_perf_record_timestamp_correlation *correlations;
+
+	memset(reader, 0, sizeof(*reader));
+
+	if (!map_file(reader, perf_file_fd, &reader->mmap_data, &reader->mmap_size) ||
+	    !map_file(reader, index_fd, &reader->index_data, &reader->index_size))
+		return false;
+
+	header = (const struct intel_xe_perf_index_header *) reader->index_data;
+	if (reader->index_size < sizeof(*header) ||
+	    memcmp(header->magic, INTEL_XE_PERF_INDEX_MAGIC, sizeof(header->magic)) ||
+	    header->version != INTEL_XE_PERF_INDEX_VERSION) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Invalid or unsupported index");
+		return false;
+	}
+
+	if (header->data_size != reader->mmap_size ||
+	    reader->index_size != sizeof(*header) +
+	    (uint64_t) header->n_records * sizeof(struct intel_xe_perf_index_record) +
+	    (uint64_t) header->n_timelines * sizeof(struct intel_xe_perf_index_timeline) +
+	    (uint64_t) header->n_correlations * sizeof(*correlations) ||
+	    header->n_records < 2 || header->n_correlations < 2 ||
+	    header->device_info_offset + sizeof(struct intel_xe_perf_record_device_info) >
+	    reader->mmap_size ||
+	    header->topology_offset + sizeof(struct intel_xe_perf_record_device_topology) >
+	    reader->mmap_size) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Index does not match the recording");
+		return false;
+	}
+
+	reader->n_records = header->n_records;
+	reader->n_timelines = header->n_timelines;
+	reader->n_correlations = header->n_correlations;
+	reader->index_records = (const struct intel_xe_perf_index_record *) (header + 1);
+	reader->index_timelines = (const struct intel_xe_perf_index_timeline *)
+		(reader->index_records + reader->n_records);
+	correlations = (const struct intel_xe_perf_record_timestamp_correlation *)
+		(reader->index_timelines + reader->n_timelines);
+
+	/* Cheap staleness check, records are in file order. */
+	if (!index_record_is_sample(reader, reader->index_records[0].offset) ||
+	    !index_record_is_sample(reader, reader->index_records[reader->n_records - 1].offset)) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Index does not match the recording");
+		return false;
+	}
+
+	reader->correlations = malloc(reader->n_correlations * sizeof(*reader->correlations));
+	assert(reader->correlations);
+	for (uint32_t i = 0; i < reader->n_correlations; i++)
+		reader->correlations[i] = &correlations[i];
+
+	reader->record_info = reader->mmap_data + header->device_info_offset;
+	reader->record_topology = reader->mmap_data + header->topology_offset;
+	if (!load_perf(reader))
+		return false;
+
+	if (!index_is_consistent(reader)) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Index does not match the recording");
+		return false;
+	}
+
+	compute_correlation_chunks(reader);
+
+	return true;
+}
+
+/*
+ * Open the recording at @path through its <path>.idx sidecar index,
+ * building and caching the index when it is missing or stale.
+ */
+bool
+intel_xe_perf_data_reader_init_cached(struct intel_xe_perf_data_reader *reader,
+				      const char *path)
+{
+	char index_path[PATH_MAX];
+	int fd, index_fd;
+	bool ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		memset(reader, 0, sizeof(*reader));
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Unable to open file (%s)", strerror(errno));
+		return false;
+	}
+
+	snprintf(index_path, sizeof(index_path), "%s.idx", path);
+	index_fd = open(index_path, O_RDONLY);
+	if (index_fd >= 0) {
+		ret = intel_xe_perf_data_reader_init_indexed(reader, fd, index_fd);
+		close(index_fd);
+		if (ret) {
+			close(fd);
+			return true;
+		}
+		intel_xe_perf_data_reader_fini(reader);
+	}
+
+	ret = intel_xe_perf_data_reader_init(reader, fd);
+	close(fd);
+	if (!ret)
+		return false;
+
+	/* Best effort, the recording might live in a read only place. */
+	index_fd = open(index_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (index_fd >= 0) {
+		if (!intel_xe_perf_data_reader_write_index(reader, index_fd))
+			unlink(index_path);
+		close(index_fd);
+	}
+
+	return true;
+}
+
+static bool
+write_all(int fd, const void *data, size_t size)
+{
+	while (size) {
+		ssize_t ret = write(fd, data, size);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data = (const uint8_t *) data + ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+/*
+ * Write an index of a recording opened with intel_xe_perf_data_reader_init(),
+ * to be used with intel_xe_perf_data_reader_init_indexed().
+ */
+bool
+intel_xe_perf_data_reader_write_index(struct intel_xe_perf_data_reader *reader,
+				      int index_fd)
+{
+	struct intel_xe_perf_index_header header = {
+		.magic = INTEL_XE_PERF_INDEX_MAGIC,
+		.version = INTEL_XE_PERF_INDEX_VERSION,
+		.n_records = reader->n_records,
+		.n_timelines = reader->n_timelines,
+		.n_correlations = reader->n_correlations,
+		.data_size = reader->mmap_size,
+		.device_info_offset = (const uint8_t *) reader->record_info - reader->mmap_data,
+		.topology_offset = (const uint8_t *) reader->record_topology - reader->mmap_data,
+	};
+	struct intel_xe_perf_index_record entries[1024];
+	uint32_t hint = 0, n = 0;
+
+	if (!reader->records || reader->n_records < 2 || reader->n_correlations < 2) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Nothing to index");
+		return false;
+	}
+
+	if (!write_all(index_fd, &header, sizeof(header)))
+		goto err;
+
+	for (uint32_t i = 0; i < reader->n_records; i++) {
+		const struct intel_xe_perf_record_header *record = reader->records[i];
+		uint64_t gpu_ts = intel_xe_perf_read_record_timestamp(reader->perf,
+								      reader->metric_set,
+								      record);
+
+		entries[n].offset = (const uint8_t *) record - reader->mmap_data;
+		entries[n].cpu_timestamp = correlate_gpu_timestamp(reader, gpu_ts, &hint);
+		if (++n == ARRAY_SIZE(entries) || i == reader->n_records - 1) {
+			if (!write_all(index_fd, entries, n * sizeof(entries[0])))
+				goto err;
+			n = 0;
+		}
+	}
+
+	for (uint32_t i = 0; i < reader->n_timelines; i++) {
+		const struct intel_xe_perf_timeline_item *item = &reader->timelines[i];
+		struct intel_xe_perf_index_timeline timeline = {
+			.ts_start = item->ts_start,
+			.ts_end = item->ts_end,
+			.cpu_ts_start = item->cpu_ts_start,
+			.cpu_ts_end = item->cpu_ts_end,
+			.record_start = item->record_start,
+			.record_end = item->record_end,
+			.hw_id = item->hw_id,
+		};
+
+		if (!write_all(index_fd, &timeline, sizeof(timeline)))
+			goto err;
+	}
+
+	for (uint32_t i = 0; i < reader->n_correlations; i++) {
+		if (!write_all(index_fd, reader->correlations[i],
+			       sizeof(*reader->correlations[i])))
+			goto err;
+	}
+
+	return true;
+
+err:
+	snprintf(reader->error_msg, sizeof(reader->error_msg),
+		 "Unable to write index (%s)", strerror(errno));
+	return false;
+}
+
 void
 intel_xe_perf_data_reader_fini(struct intel_xe_perf_data_reader *reader)
 {
-	intel_xe_perf_free(reader->perf);
+	if (reader->perf)
+		intel_xe_perf_free(reader->perf);
 	free(reader->records);
 	free(reader->timelines);
 	free(reader->correlations);
-	munmap((void *)reader->mmap_data, reader->mmap_size);
+	if (reader->mmap_data)
+		munmap((void *)reader->mmap_data, reader->mmap_size);
+	if (reader->index_data)
+		munmap((void *)reader->index_data, reader->index_size);
+}
+
+const struct intel_xe_perf_record_header *
+intel_xe_perf_data_reader_get_record(const struct intel_xe_perf_data_reader *reader,
+				     uint32_t idx)
+{
+	assert(idx < reader->n_records);
+
+	if (reader->index_records)
+		return (const struct intel_xe_perf_record_header *)
+			(reader->mmap_data + reader->index_records[idx].offset);
+
+	return reader->records[idx];
+}
+
+uint64_t
+intel_xe_perf_data_reader_get_record_cpu_ts(const struct intel_xe_perf_data_reader *reader,
+					    uint32_t idx)
+{
+	assert(idx < reader->n_records);
+
+	if (reader->index_records)
+		return reader->index_records[idx].cpu_timestamp;
+
+	return correlate_gpu_timestamp(reader,
+				       intel_xe_perf_read_record_timestamp(reader->perf,
+									   reader->metric_set,
+									   reader->records[idx]),
+				       NULL);
+}
+
+void
+intel_xe_perf_data_reader_get_timeline(const struct intel_xe_perf_data_reader *reader,
+				       uint32_t idx,
+				       struct intel_xe_perf_timeline_item *item)
+{
+	const struct intel_xe_perf_index_timeline *timeline;
+
+	assert(idx < reader->n_timelines);
+
+	if (!reader->index_timelines) {
+		*item = reader->timelines[idx];
+		return;
+	}
+
+	timeline = &reader->index_timelines[idx];
+	item->ts_start = timeline->ts_start;
+	item->ts_end = timeline->ts_end;
+	item->cpu_ts_start = timeline->cpu_ts_start;
+	item->cpu_ts_end = timeline->cpu_ts_end;
+	item->record_start = timeline->record_start;
+	item->record_end = timeline->record_end;
+	item->hw_id = timeline->hw_id;
+	item->user_data = NULL;
+}
+
+/* Index of the first record at or after @cpu_ts, n_records if none. */
+uint32_t
+intel_xe_perf_data_reader_find_record(const struct intel_xe_perf_data_reader *reader,
+				      uint64_t cpu_ts)
+{
+	uint32_t lo = 0, hi = reader->n_records;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (intel_xe_perf_data_reader_get_record_cpu_ts(reader, mid) < cpu_ts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static uint64_t
+timeline_cpu_ts_end(const struct intel_xe_perf_data_reader *reader, uint32_t idx)
+{
+	if (reader->index_timelines)
+		return reader->index_timelines[idx].cpu_ts_end;
+
+	return reader->timelines[idx].cpu_ts_end;
+}
+
+/* Index of the first timeline ending after @cpu_ts, n_timelines if none. */
+uint32_t
+intel_xe_perf_data_reader_find_timeline(const struct intel_xe_perf_data_reader *reader,
+					uint64_t cpu_ts)
+{
+	uint32_t lo = 0, hi = reader->n_timelines;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (timeline_cpu_ts_end(reader, mid) <= cpu_ts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+void
+intel_xe_perf_data_reader_iter_init(const struct intel_xe_perf_data_reader *reader,
+				    uint64_t cpu_ts_begin, uint64_t cpu_ts_end,
+				    struct intel_xe_perf_data_iter *iter)
+{
+	iter->reader = reader;
+	iter->next = intel_xe_perf_data_reader_find_record(reader, cpu_ts_begin);
+	iter->end = intel_xe_perf_data_reader_find_record(reader, cpu_ts_end);
+}
+
+const struct intel_xe_perf_record_header *
+intel_xe_perf_data_iter_next(struct intel_xe_perf_data_iter *iter)
+{
+	if (iter->next >= iter->end)
+		return NULL;
+
+	return intel_xe_perf_data_reader_get_record(iter->reader, iter->next++);
+}
+
+/*
+ * Sum the time each context spent on the GPU between @cpu_ts_begin and
+ * @cpu_ts_end from the context switch timelines, without looking at the
+ * records. Returns the number of entries filled in @busy, contexts past
+ * the first @max_busy are ignored, so are idle periods.
+ */
+uint32_t
+intel_xe_perf_data_reader_context_busy(const struct intel_xe_perf_data_reader *reader,
+				       uint64_t cpu_ts_begin, uint64_t cpu_ts_end,
+				       struct intel_xe_perf_context_busy *busy,
+				       uint32_t max_busy)
+{
+	uint32_t n_busy = 0;
+
+	for (uint32_t i = intel_xe_perf_data_reader_find_timeline(reader, cpu_ts_begin);
+	     i < reader->n_timelines; i++) {
+		struct intel_xe_perf_timeline_item item;
+		uint64_t start, end;
+		uint32_t c;
+
+		intel_xe_perf_data_reader_get_timeline(reader, i, &item);
+		if (item.cpu_ts_start >= cpu_ts_end)
+			break;
+		if (item.hw_id == 0xffffffff)
+			continue;
+
+		start = MAX(item.cpu_ts_start, cpu_ts_begin);
+		end = MIN(item.cpu_ts_end, cpu_ts_end);
+
+		for (c = 0; c < n_busy; c++) {
+			if (busy[c].hw_id == item.hw_id)
+				break;
+		}
+		if (c == n_busy) {
+			if (n_busy == max_busy)
+				continue;
+			busy[n_busy++] = (struct intel_xe_perf_context_busy) {
+				.hw_id = item.hw_id,
+			};
+		}
+
+		busy[c].n_timelines++;
+		busy[c].busy_ns += end > start ? end - start : 0;
+	}
+
+	return n_busy;
 }
@@ -36,12 +36,17 @@ struct intel_xe_perf_timeline_item {
 };
 
 struct intel_xe_perf_data_reader {
-	/* Array of pointers into the mmapped xe perf file. */
+	/* Array of pointers into the mmapped xe perf file, NULL when
+	 * reading through an index, use
+	 * intel_xe_perf_data_reader_get_record() instead.
+	 */
 	const struct intel_xe_perf_record_header **records;
 	uint32_t n_records;
 	uint32_t n_allocated_records;
 
-	/**/
+	/* NULL when reading through an index, use
+	 * intel_xe_perf_data_reader_get_timeline() instead.
+	 */
 	struct intel_xe_perf_timeline_item *timelines;
 	uint32_t n_timelines;
 	uint32_t n_allocated_timelines;
@@ -74,12 +79,69 @@ struct intel_xe_perf_data_reader {
 
 	const uint8_t *mmap_data;
 	size_t mmap_size;
+
+	/* Sidecar index, see intel_xe_perf_data_reader_init_indexed() */
+	const struct intel_xe_perf_index_record *index_records;
+	const struct intel_xe_perf_index_timeline *index_timelines;
+
+	const uint8_t *index_data;
+	size_t index_size;
+};
+
+/* Lazy iteration over the records of a time range. */
+struct intel_xe_perf_data_iter {
+	const struct intel_xe_perf_data_reader *reader;
+	uint32_t next;
+	uint32_t end;
+};
+
+/* Time spent on the GPU by a given hw_id. */
+struct intel_xe_perf_context_busy {
+	uint32_t hw_id;
+	uint32_t n_timelines;
+	uint64_t busy_ns;
 };
 
 bool intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
 				    int perf_file_fd);
+bool intel_xe_perf_data_reader_init_indexed(struct intel_xe_perf_data_reader *reader,
+					    int perf_file_fd, int index_fd);
+bool intel_xe_perf_data_reader_init_cached(struct intel_xe_perf_data_reader *reader,
+					   const char *path);
+bool intel_xe_perf_data_reader_write_index(struct intel_xe_perf_data_reader *reader,
+					   int index_fd);
 void intel_xe_perf_data_reader_fini(struct intel_xe_perf_data_reader *reader);
 
+const struct intel_xe_perf_record_header *
+intel_xe_perf_data_reader_get_record(const struct intel_xe_perf_data_reader *reader,
+				     uint32_t idx);
+uint64_t
+intel_xe_perf_data_reader_get_record_cpu_ts(const struct intel_xe_perf_data_reader *reader,
+					    uint32_t idx);
+void
+intel_xe_perf_data_reader_get_timeline(const struct intel_xe_perf_data_reader *reader,
+				       uint32_t idx,
+				       struct intel_xe_perf_timeline_item *item);
+
+uint32_t
+intel_xe_perf_data_reader_find_record(const struct intel_xe_perf_data_reader *reader,
+				      uint64_t cpu_ts);
+uint32_t
+intel_xe_perf_data_reader_find_timeline(const struct intel_xe_perf_data_reader *reader,
+					uint64_t cpu_ts);
+
+void intel_xe_perf_data_reader_iter_init(const struct intel_xe_perf_data_reader *reader,
+					 uint64_t cpu_ts_begin, uint64_t cpu_ts_end,
+					 struct intel_xe_perf_data_iter *iter);
+const struct intel_xe_perf_record_header *
+intel_xe_perf_data_iter_next(struct intel_xe_perf_data_iter *iter);
+
+uint32_t
+intel_xe_perf_data_reader_context_busy(const struct intel_xe_perf_data_reader *reader,
+				       uint64_t cpu_ts_begin, uint64_t cpu_ts_end,
+				       struct intel_xe_perf_context_busy *busy,
+				       uint32_t max_busy);
+
 #ifdef __cplusplus
 };
 #endif
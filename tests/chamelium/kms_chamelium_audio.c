@@ -388,11 +388,12 @@ static int audio_output_frequencies_callback(void *data, void *buffer,
 
 static bool test_audio_frequencies(struct audio_state *state)
 {
+	struct audio_detector *detectors[CHAMELIUM_MAX_AUDIO_CHANNELS];
+	struct audio_detector_stats stats;
 	int freq, step;
-	int32_t *recv, *buf;
-	double *channel;
+	int32_t *recv;
 	size_t i, j, streak;
-	size_t recv_len, buf_len, buf_cap, channel_len;
+	size_t recv_len;
 	bool success;
 	int capture_chan;
 
@@ -440,60 +441,48 @@ static bool test_audio_frequencies(struct audio_state *state)
 	 * sines. For lower sampling rates, the capture duration will be
 	 * longer.
 	 */
-	channel_len = CAPTURE_SAMPLES;
-	channel = malloc(sizeof(double) * channel_len);
-
-	buf_cap = state->capture.channels * channel_len;
-	buf = malloc(sizeof(int32_t) * buf_cap);
-	buf_len = 0;
+	for (j = 0; j < state->playback.channels; j++)
+		detectors[j] = audio_detector_init(state->signal,
+						   state->capture.rate, j,
+						   CAPTURE_SAMPLES,
+						   CAPTURE_SAMPLES,
+						   AUDIO_DETECTOR_GOERTZEL);
 
 	recv = NULL;
 	recv_len = 0;
 
 	success = false;
-	streak = 0;
 	while (!success && state->msec < AUDIO_TIMEOUT) {
 		audio_state_receive(state, &recv, &recv_len);
 
-		memcpy(&buf[buf_len], recv, recv_len * sizeof(int32_t));
-		buf_len += recv_len;
-
-		if (buf_len < buf_cap)
-			continue;
-		igt_assert(buf_len == buf_cap);
-
-		igt_debug("Detecting audio signal, t=%d msec\n", state->msec);
-
+		/* Feed the interleaved capture straight to the per-channel
+		 * detectors, they evaluate a window every CAPTURE_SAMPLES. */
+		streak = 0;
 		for (j = 0; j < state->playback.channels; j++) {
 			capture_chan = state->channel_mapping[j];
 			igt_assert(capture_chan >= 0);
-			igt_debug("Processing channel %zu (captured as "
-				  "channel %d)\n",
-				  j, capture_chan);
 
-			audio_extract_channel_s32_le(channel, channel_len, buf,
-						     buf_len,
-						     state->capture.channels,
-						     capture_chan);
+			audio_detector_push_s32_le(detectors[j], recv, recv_len,
+						   state->capture.channels,
+						   capture_chan);
 
-			if (audio_signal_detect(state->signal,
-						state->capture.rate, j, channel,
-						channel_len))
+			audio_detector_get_stats(detectors[j], &stats);
+			igt_debug("Channel %zu (captured as channel %d): "
+				  "detected in %zu/%zu windows, t=%d msec\n",
+				  j, capture_chan, stats.detected,
+				  stats.windows, state->msec);
+			if (stats.streak >= MIN_STREAK)
 				streak++;
-			else
-				streak = 0;
 		}
 
-		buf_len = 0;
-
-		success = streak == MIN_STREAK * state->playback.channels;
+		success = streak == state->playback.channels;
 	}
 
 	audio_state_stop(state, success);
 
 	free(recv);
-	free(buf);
-	free(channel);
+	for (j = 0; j < state->playback.channels; j++)
+		audio_detector_fini(detectors[j]);
 	audio_signal_fini(state->signal);
 
 	check_audio_infoframe(state);
@@ -43,7 +43,7 @@ static void remote_request_workload(int fd, int *done)
 	 *
 	 * Based on code patterns found in tests/i915/perf.c
 	 */
-	struct intel_perf_metric_set *metric_set = NULL, *metric_set_iter;
+	struct intel_perf_metric_set *metric_set;
 	struct intel_perf *intel_perf = intel_perf_for_fd(fd, 0);
 	uint64_t properties[] = {
 		DRM_I915_PERF_PROP_SAMPLE_OA, true,
@@ -59,17 +59,12 @@ static void remote_request_workload(int fd, int *done)
 	uint32_t devid = intel_get_drm_devid(fd);
 
 	igt_require(intel_perf);
-	intel_perf_load_perf_configs(intel_perf, fd);
-
 	igt_require(devid);
-	igt_list_for_each_entry(metric_set_iter, &intel_perf->metric_sets, link) {
-		if (!strcmp(metric_set_iter->symbol_name,
-			    IS_HASWELL(devid) ? "RenderBasic" : "TestOa")) {
-			metric_set = metric_set_iter;
-			break;
-		}
-	}
+
+	metric_set = intel_perf_find_metric_set(intel_perf,
+						IS_HASWELL(devid) ? "RenderBasic" : "TestOa");
 	igt_require(metric_set);
+	intel_perf_load_perf_configs(intel_perf, fd);
 	igt_require(metric_set->perf_oa_metrics_set);
 	properties[3] = metric_set->perf_oa_metrics_set;
 	properties[5] = metric_set->perf_oa_format;
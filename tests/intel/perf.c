@@ -5536,8 +5536,7 @@ static struct drm_i915_query_engine_info *query_engine_info(int i915)
 static struct intel_perf_metric_set *metric_set(const struct intel_execution_engine2 *e2)
 {
 	const char *test_set_name = NULL;
-	struct intel_perf_metric_set *metric_set_iter;
-	struct intel_perf_metric_set *test_set = NULL;
+	struct intel_perf_metric_set *test_set;
 
 	if (IS_HASWELL(devid))
 		test_set_name = "RenderBasic";
@@ -5550,13 +5549,7 @@ static struct intel_perf_metric_set *metric_set(const struct intel_execution_eng
 	else
 		igt_assert(!"reached");
 
-	igt_list_for_each_entry(metric_set_iter, &intel_perf->metric_sets, link) {
-		if (strcmp(metric_set_iter->symbol_name, test_set_name) == 0) {
-			test_set = metric_set_iter;
-			break;
-		}
-	}
-
+	test_set = intel_perf_find_metric_set(intel_perf, test_set_name);
 	igt_assert(test_set);
 
 	/*
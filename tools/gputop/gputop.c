@@ -24,6 +24,7 @@
 #include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "drmtest.h"
@@ -500,12 +501,37 @@ static void sigint_handler(int sig)
 	stop_top = true;
 }
 
+/*
+ * Sleeps until the next period boundary after @deadline, skipping the ones
+ * already missed, so the loop does not drift by the time spent rendering and
+ * client rates computed over period_us stay accurate.
+ */
+static void wait_next_period(struct timespec *deadline, unsigned int period_us)
+{
+	const uint64_t period_ns = (uint64_t)period_us * 1000;
+	struct timespec now;
+	uint64_t next, cur;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	cur = now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+	next = deadline->tv_sec * NSEC_PER_SEC + deadline->tv_nsec + period_ns;
+	if (next <= cur)
+		next += ((cur - next) / period_ns + 1) * period_ns;
+
+	deadline->tv_sec = next / NSEC_PER_SEC;
+	deadline->tv_nsec = next % NSEC_PER_SEC;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR &&
+	       !stop_top)
+		;
+}
+
 int main(int argc, char **argv)
 {
 	struct gputop_args args;
 	unsigned int period_us;
 	struct igt_profiled_device *profiled_devices = NULL;
 	struct igt_drm_clients *clients = NULL;
+	struct timespec deadline;
 	int con_w = -1, con_h = -1;
 	int ret;
 	long n;
@@ -585,6 +611,7 @@ int main(int argc, char **argv)
 	}
 
 	igt_drm_clients_scan(clients, NULL, NULL, 0, NULL, 0);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
 
 	while ((n != 0) && !stop_top) {
 		struct igt_drm_client *c, *prevc = NULL;
@@ -637,7 +664,7 @@ int main(int argc, char **argv)
 		if (lines++ < con_h)
 			printf("\n");
 
-		usleep(period_us);
+		wait_next_period(&deadline, period_us);
 		if (n > 0)
 			n--;
 
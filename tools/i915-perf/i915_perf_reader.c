@@ -37,6 +37,7 @@
 #include <i915_drm.h>
 
 #include "igt_core.h"
+#include "igt_trace_writer.h"
 #include "intel_chipset.h"
 #include "i915/perf.h"
 #include "i915/perf_data_reader.h"
@@ -44,6 +45,12 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) > (b) ? (b) : (a))
 
+/* Report pairs accumulated per call, bounding the memory of --reports */
+#define DELTAS_CHUNK 256
+
+/* Report deltas computed at once when writing a trace. */
+#define TRACE_CHUNK 1024
+
 static void
 usage(void)
 {
@@ -54,7 +61,16 @@ usage(void)
 	       "     --counters, -c c1,c2,...  List of counters to display values for.\n"
 	       "                               Use 'all' to display all counters.\n"
 	       "                               Use 'list' to list available counters.\n"
-	       "     --reports, -r             Print out data per report.\n");
+	       "     --reports, -r             Print out data per report.\n"
+	       "     --index,   -i             Read through <file>.idx, creating it if needed.\n"
+	       "     --busy,    -b             Print per context busy time.\n"
+	       "     --start,   -s <ts>        Only look at data after CPU timestamp <ts>.\n"
+	       "     --end,     -e <ts>        Only look at data before CPU timestamp <ts>.\n"
+	       "     --trace,   -t <path>      Write the counters, context switches and\n"
+	       "                               correlation points to a trace for\n"
+	       "                               ui.perfetto.dev instead of printing them.\n"
+	       "                               Without --counters, all counters are traced.\n"
+	       "     --trace-format, -f <fmt>  Trace format: json (default) or perfetto.\n");
 }
 
 static struct intel_perf_logical_counter *
@@ -167,18 +183,11 @@ get_logical_counters(struct intel_perf_metric_set *metric_set,
 }
 
 static void
-print_report_deltas(const struct intel_perf_data_reader *reader,
-		    const struct drm_i915_perf_record_header *i915_report0,
-		    const struct drm_i915_perf_record_header *i915_report1,
-		    struct intel_perf_logical_counter **counters,
-		    uint32_t n_counters)
+print_deltas(const struct intel_perf_data_reader *reader,
+	     struct intel_perf_accumulator *accu,
+	     struct intel_perf_logical_counter **counters,
+	     uint32_t n_counters)
 {
-	struct intel_perf_accumulator accu;
-
-	intel_perf_accumulate_reports(&accu,
-				      reader->perf, reader->metric_set,
-				      i915_report0, i915_report1);
-
 	for (uint32_t c = 0; c < n_counters; c++) {
 		struct intel_perf_logical_counter *counter = counters[c];
 
@@ -189,19 +198,165 @@ print_report_deltas(const struct intel_perf_data_reader *reader,
 			fprintf(stdout, "   %s: %" PRIu64 "\n",
 				counter->symbol_name, counter->read_uint64(reader->perf,
 									   reader->metric_set,
-									   accu.deltas));
+									   accu->deltas));
 			break;
 		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
 		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
 			fprintf(stdout, "   %s: %f\n",
 				counter->symbol_name, counter->read_float(reader->perf,
 									  reader->metric_set,
-									  accu.deltas));
+									  accu->deltas));
 			break;
 		}
 	}
 }
 
+static double
+read_counter(const struct intel_perf_data_reader *reader,
+	     const struct intel_perf_logical_counter *counter,
+	     uint64_t *deltas)
+{
+	switch (counter->storage) {
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT64:
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT32:
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_BOOL32:
+		return counter->read_uint64(reader->perf, reader->metric_set, deltas);
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
+		return counter->read_float(reader->perf, reader->metric_set, deltas);
+	}
+
+	return 0;
+}
+
+static void
+print_report_deltas(const struct intel_perf_data_reader *reader,
+		    const struct drm_i915_perf_record_header *i915_report0,
+		    const struct drm_i915_perf_record_header *i915_report1,
+		    struct intel_perf_logical_counter **counters,
+		    uint32_t n_counters)
+{
+	struct intel_perf_accumulator accu;
+
+	intel_perf_accumulate_reports(&accu,
+				      reader->perf, reader->metric_set,
+				      i915_report0, i915_report1);
+	print_deltas(reader, &accu, counters, n_counters);
+}
+
+/*
+ * Streams the recording between cpu_ts_start & cpu_ts_end into a trace,
+ * TRACE_CHUNK reports at a time so that memory usage does not depend on
+ * the size of the recording.
+ */
+static bool
+write_trace(const struct intel_perf_data_reader *reader,
+	    const struct intel_device_info *devinfo,
+	    struct intel_perf_logical_counter **counters, uint32_t n_counters,
+	    uint64_t cpu_ts_start, uint64_t cpu_ts_end,
+	    int fd, enum igt_trace_format format)
+{
+	const struct drm_i915_perf_record_header *records[TRACE_CHUNK + 1];
+	struct intel_perf_deltas deltas = { .stride = TRACE_CHUNK };
+	struct igt_trace_writer *writer;
+	uint32_t contexts_track, correlations_track, *counter_tracks;
+	uint64_t cpu_ts[TRACE_CHUNK];
+	char name[128];
+	uint32_t i;
+
+	deltas.deltas = malloc(sizeof(*deltas.deltas) *
+			       INTEL_PERF_MAX_RAW_OA_COUNTERS * deltas.stride);
+	counter_tracks = calloc(n_counters, sizeof(*counter_tracks));
+	if (!deltas.deltas || !counter_tracks) {
+		free(deltas.deltas);
+		free(counter_tracks);
+		return false;
+	}
+
+	snprintf(name, sizeof(name), "%s %s",
+		 devinfo->codename, reader->metric_set->symbol_name);
+	writer = igt_trace_writer_create(fd, format, name);
+	if (!writer) {
+		free(deltas.deltas);
+		free(counter_tracks);
+		return false;
+	}
+
+	contexts_track = igt_trace_writer_add_track(writer, "Contexts",
+						    IGT_TRACE_TRACK_SLICES);
+	correlations_track = igt_trace_writer_add_track(writer, "CPU/GPU correlations",
+							IGT_TRACE_TRACK_SLICES);
+	for (uint32_t c = 0; c < n_counters; c++)
+		counter_tracks[c] = igt_trace_writer_add_track(writer,
+							       counters[c]->symbol_name,
+							       IGT_TRACE_TRACK_COUNTER);
+
+	for (i = intel_perf_data_reader_find_timeline(reader, cpu_ts_start);
+	     i < reader->n_timelines; i++) {
+		struct intel_perf_timeline_item item;
+
+		intel_perf_data_reader_get_timeline(reader, i, &item);
+		if (item.cpu_ts_start >= cpu_ts_end)
+			break;
+		if (item.hw_id == 0xffffffff)
+			continue;
+
+		snprintf(name, sizeof(name), "hw_id=0x%x", item.hw_id);
+		igt_trace_writer_slice(writer, contexts_track, name, item.cpu_ts_start,
+				       item.cpu_ts_end - item.cpu_ts_start);
+	}
+
+	for (i = 0; i < reader->n_correlations; i++) {
+		const struct intel_perf_record_timestamp_correlation *corr =
+			reader->correlations[i];
+
+		if (corr->cpu_timestamp < cpu_ts_start || corr->cpu_timestamp >= cpu_ts_end)
+			continue;
+
+		snprintf(name, sizeof(name), "gpu_ts=0x%" PRIx64, corr->gpu_timestamp);
+		igt_trace_writer_instant(writer, correlations_track, name,
+					 corr->cpu_timestamp);
+	}
+
+	/* Each delta is shown from the report it starts at. */
+	i = intel_perf_data_reader_find_record(reader, cpu_ts_start);
+	while (i + 1 < reader->n_records) {
+		uint32_t n_deltas = MIN(TRACE_CHUNK, reader->n_records - 1 - i);
+
+		for (uint32_t r = 0; r <= n_deltas; r++)
+			records[r] = intel_perf_data_reader_get_record(reader, i + r);
+		for (uint32_t r = 0; r < n_deltas; r++) {
+			cpu_ts[r] = intel_perf_data_reader_get_record_cpu_ts(reader, i + r);
+			if (cpu_ts[r] >= cpu_ts_end) {
+				n_deltas = r;
+				break;
+			}
+		}
+		if (!n_deltas)
+			break;
+
+		intel_perf_accumulate_reports_n(&deltas, reader->perf, reader->metric_set,
+						records, n_deltas);
+
+		for (uint32_t r = 0; r < n_deltas; r++) {
+			struct intel_perf_accumulator accu;
+
+			intel_perf_deltas_get(&deltas, r, &accu);
+			for (uint32_t c = 0; c < n_counters; c++)
+				igt_trace_writer_counter(writer, counter_tracks[c], cpu_ts[r],
+							 read_counter(reader, counters[c],
+								      accu.deltas));
+		}
+
+		i += n_deltas;
+	}
+
+	free(deltas.deltas);
+	free(counter_tracks);
+
+	return igt_trace_writer_close(writer) == 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -209,17 +364,27 @@ main(int argc, char *argv[])
 		{"help",             no_argument, 0, 'h'},
 		{"counters",   required_argument, 0, 'c'},
 		{"reports",          no_argument, 0, 'r'},
+		{"index",            no_argument, 0, 'i'},
+		{"busy",             no_argument, 0, 'b'},
+		{"start",      required_argument, 0, 's'},
+		{"end",        required_argument, 0, 'e'},
+		{"trace",      required_argument, 0, 't'},
+		{"trace-format", required_argument, 0, 'f'},
 		{0, 0, 0, 0}
 	};
 	struct intel_perf_data_reader reader;
 	struct intel_perf_logical_counter **counters;
+	const struct drm_i915_perf_record_header **records = NULL;
+	struct intel_perf_deltas deltas = {};
 	const struct intel_device_info *devinfo;
-	const char *counter_names = NULL;
+	const char *counter_names = NULL, *trace_path = NULL;
+	enum igt_trace_format trace_format = IGT_TRACE_FORMAT_JSON;
+	uint64_t cpu_ts_start = 0, cpu_ts_end = UINT64_MAX;
 	int32_t n_counters;
-	int fd, opt;
-	bool print_reports = false;
+	int fd = -1, opt, ret = EXIT_SUCCESS;
+	bool print_reports = false, use_index = false, print_busy = false;
 
-	while ((opt = getopt_long(argc, argv, "hc:r", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:ribs:e:t:f:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage();
@@ -230,6 +395,27 @@ main(int argc, char *argv[])
 		case 'r':
 			print_reports = true;
 			break;
+		case 'i':
+			use_index = true;
+			break;
+		case 'b':
+			print_busy = true;
+			break;
+		case 's':
+			cpu_ts_start = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			cpu_ts_end = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			trace_path = optarg;
+			break;
+		case 'f':
+			if (igt_trace_format_parse(optarg, &trace_format)) {
+				fprintf(stderr, "Unknown trace format '%s'.\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -243,22 +429,36 @@ main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	fd = open(argv[optind], 0, O_RDONLY);
-	if (fd < 0) {
-		fprintf(stderr, "Cannot open '%s': %s.\n",
-			argv[optind], strerror(errno));
-		return EXIT_FAILURE;
+	if (use_index) {
+		if (!intel_perf_data_reader_init_cached(&reader, argv[optind])) {
+			fprintf(stderr, "Unable to parse '%s': %s.\n",
+				argv[optind], reader.error_msg);
+			return EXIT_FAILURE;
+		}
+	} else {
+		fd = open(argv[optind], 0, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "Cannot open '%s': %s.\n",
+				argv[optind], strerror(errno));
+			return EXIT_FAILURE;
+		}
 	}
 
-	if (!intel_perf_data_reader_init(&reader, fd)) {
+	if (fd >= 0 && !intel_perf_data_reader_init(&reader, fd)) {
 		fprintf(stderr, "Unable to parse '%s': %s.\n",
 			argv[optind], reader.error_msg);
 		return EXIT_FAILURE;
 	}
 
-	counters = get_logical_counters(reader.metric_set, counter_names, &n_counters);
-	if (n_counters < 0)
+	counters = get_logical_counters(reader.metric_set,
+					counter_names ?: (trace_path ? "all" : NULL),
+					&n_counters);
+	if (n_counters < 0) {
+		/* Either the counters were listed or one was unknown */
+		if (!counter_names || strcmp(counter_names, "list"))
+			ret = EXIT_FAILURE;
 		goto exit;
+	}
 
 	devinfo = intel_get_device_info(reader.devinfo.devid);
 
@@ -274,7 +474,8 @@ main(int argc, char *argv[])
 
 	if (reader.n_correlations < 2) {
 		fprintf(stderr, "Less than 2 CPU/GPU timestamp correlation points.\n");
-		return EXIT_FAILURE;
+		ret = EXIT_FAILURE;
+		goto exit;
 	}
 
 	fprintf(stdout, "Timestamp correlation CPU range:       0x%016"PRIx64"-0x%016"PRIx64"\n",
@@ -290,17 +491,19 @@ main(int argc, char *argv[])
 	fprintf(stdout, "OA data timestamp range:               0x%016"PRIx64"-0x%016"PRIx64"\n",
 		intel_perf_read_record_timestamp(reader.perf,
 						 reader.metric_set,
-						 reader.records[0]),
+						 intel_perf_data_reader_get_record(&reader, 0)),
 		intel_perf_read_record_timestamp(reader.perf,
 						 reader.metric_set,
-						 reader.records[reader.n_records - 1]));
+						 intel_perf_data_reader_get_record(&reader,
+										   reader.n_records - 1)));
 	fprintf(stdout, "OA raw data timestamp range:           0x%016"PRIx64"-0x%016"PRIx64"\n",
 		intel_perf_read_record_timestamp_raw(reader.perf,
 						     reader.metric_set,
-						     reader.records[0]),
+						     intel_perf_data_reader_get_record(&reader, 0)),
 		intel_perf_read_record_timestamp_raw(reader.perf,
 						     reader.metric_set,
-						     reader.records[reader.n_records - 1]));
+						     intel_perf_data_reader_get_record(&reader,
+										       reader.n_records - 1)));
 
 	if (strcmp(reader.metric_set_uuid, reader.metric_set->hw_config_guid)) {
 		fprintf(stdout,
@@ -308,37 +511,96 @@ main(int argc, char *argv[])
 			"WARNING: This could lead to inconsistent counter values.\n");
 	}
 
-	for (uint32_t i = 0; i < reader.n_timelines; i++) {
-		const struct intel_perf_timeline_item *item = &reader.timelines[i];
+	if (trace_path) {
+		int trace_fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (trace_fd < 0 ||
+		    !write_trace(&reader, devinfo, counters, n_counters,
+				 cpu_ts_start, cpu_ts_end, trace_fd, trace_format)) {
+			fprintf(stderr, "Unable to write trace '%s': %s.\n",
+				trace_path, strerror(errno));
+			ret = EXIT_FAILURE;
+		} else {
+			fprintf(stdout, "Trace written to %s\n", trace_path);
+		}
+		if (trace_fd >= 0)
+			close(trace_fd);
+		goto exit;
+	}
+
+	if (print_reports) {
+		deltas.stride = DELTAS_CHUNK;
+		deltas.deltas = calloc((size_t)INTEL_PERF_MAX_RAW_OA_COUNTERS * deltas.stride,
+				       sizeof(*deltas.deltas));
+		records = calloc(deltas.stride + 1, sizeof(*records));
+		if (!deltas.deltas || !records) {
+			fprintf(stderr, "Unable to allocate report deltas.\n");
+			ret = EXIT_FAILURE;
+			goto exit;
+		}
+	}
+
+	if (print_busy) {
+		struct intel_perf_context_busy busy[64];
+		uint32_t n_busy;
+
+		n_busy = intel_perf_data_reader_context_busy(&reader,
+							     cpu_ts_start, cpu_ts_end,
+							     busy, sizeof(busy) / sizeof(busy[0]));
+		for (uint32_t i = 0; i < n_busy; i++) {
+			fprintf(stdout, "hw_id=0x%x busy=%" PRIu64 "ns switches=%u\n",
+				busy[i].hw_id, busy[i].busy_ns, busy[i].n_timelines);
+		}
+	}
+
+	for (uint32_t i = intel_perf_data_reader_find_timeline(&reader, cpu_ts_start);
+	     i < reader.n_timelines; i++) {
+		struct intel_perf_timeline_item item;
+
+		intel_perf_data_reader_get_timeline(&reader, i, &item);
+		if (item.cpu_ts_start >= cpu_ts_end)
+			break;
 
 		fprintf(stdout, "Time: CPU=0x%016" PRIx64 "-0x%016" PRIx64
 			" GPU=0x%016" PRIx64 "-0x%016" PRIx64"\n",
-			item->cpu_ts_start, item->cpu_ts_end,
-			item->ts_start, item->ts_end);
+			item.cpu_ts_start, item.cpu_ts_end,
+			item.ts_start, item.ts_end);
 		fprintf(stdout, "hw_id=0x%x %s\n",
-			item->hw_id, item->hw_id == 0xffffffff ? "(idle)" : "");
+			item.hw_id, item.hw_id == 0xffffffff ? "(idle)" : "");
 
 		print_report_deltas(&reader,
-				    reader.records[item->record_start],
-				    reader.records[item->record_end],
+				    intel_perf_data_reader_get_record(&reader, item.record_start),
+				    intel_perf_data_reader_get_record(&reader, item.record_end),
 				    counters, n_counters);
 
-		if (print_reports) {
-			for (uint32_t r = item->record_start; r < item->record_end; r++) {
+		/* Per report deltas, a chunk of consecutive pairs at a time. */
+		for (uint32_t r = item.record_start;
+		     print_reports && r < item.record_end; r += deltas.stride) {
+			uint32_t n_deltas = MIN(item.record_end - r, deltas.stride);
+
+			for (uint32_t d = 0; d <= n_deltas; d++)
+				records[d] = intel_perf_data_reader_get_record(&reader, r + d);
+			intel_perf_accumulate_reports_n(&deltas, reader.perf, reader.metric_set,
+							records, n_deltas);
+
+			for (uint32_t d = 0; d < n_deltas; d++) {
+				struct intel_perf_accumulator accu;
+
 				fprintf(stdout, " report%i = %s\n",
-					r - item->record_start,
-					intel_perf_read_report_reason(reader.perf, reader.records[r]));
-				print_report_deltas(&reader,
-						    reader.records[r],
-						    reader.records[r + 1],
-						    counters, n_counters);
+					r + d - item.record_start,
+					intel_perf_read_report_reason(reader.perf, records[d]));
+				intel_perf_deltas_get(&deltas, d, &accu);
+				print_deltas(&reader, &accu, counters, n_counters);
 			}
 		}
 	}
 
  exit:
+	free(records);
+	free(deltas.deltas);
 	intel_perf_data_reader_fini(&reader);
-	close(fd);
+	if (fd >= 0)
+		close(fd);
 
-	return EXIT_SUCCESS;
+	return ret;
 }
@@ -45,9 +45,11 @@
 #include <i915_drm.h>
 
 #include "igt_core.h"
+#include "igt_stream_capture.h"
 #include "intel_chipset.h"
 #include "i915/perf.h"
 #include "i915/perf_data.h"
+#include "i915/perf_data_reader.h"
 
 #include "i915_perf_recorder_commands.h"
 
@@ -56,154 +58,6 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
-struct circular_buffer {
-	char   *data;
-	size_t  allocated_size;
-	size_t  size;
-	size_t  beginpos;
-	size_t  endpos;
-};
-
-struct chunk {
-	char *data;
-	size_t len;
-};
-
-static size_t
-circular_available_size(const struct circular_buffer *buffer)
-{
-	assert(buffer->size <= buffer->allocated_size);
-	return buffer->allocated_size - buffer->size;
-}
-
-static void
-get_chunks(struct chunk *chunks, struct circular_buffer *buffer, bool write, size_t len)
-{
-	size_t offset = write ? buffer->endpos : buffer->beginpos;
-
-	if (write)
-		assert(circular_available_size(buffer) >= len);
-	else
-		assert(buffer->size >= len);
-
-	chunks[0].data = &buffer->data[offset];
-
-	if ((offset + len) > buffer->allocated_size) {
-		chunks[0].len = buffer->allocated_size - offset;
-		chunks[1].data = buffer->data;
-		chunks[1].len = len - (buffer->allocated_size - offset);
-	} else {
-		chunks[0].len = len;
-		chunks[1].data = NULL;
-		chunks[1].len = 0;
-	}
-}
-
-static ssize_t
-circular_buffer_read(void *c, char *buf, size_t size)
-{
-	struct circular_buffer *buffer = c;
-	struct chunk chunks[2];
-
-	if (buffer->size < size)
-		return -1;
-
-	get_chunks(chunks, buffer, false, size);
-
-	memcpy(buf, chunks[0].data, chunks[0].len);
-	memcpy(buf + chunks[0].len, chunks[1].data, chunks[1].len);
-	buffer->beginpos = (buffer->beginpos + size) % buffer->allocated_size;
-	buffer->size -= size;
-
-	return size;
-}
-
-static size_t
-peek_item_size(struct circular_buffer *buffer)
-{
-	struct drm_i915_perf_record_header header;
-	struct chunk chunks[2];
-
-	if (!buffer->size)
-		return 0;
-
-	assert(buffer->size >= sizeof(header));
-
-	get_chunks(chunks, buffer, false, sizeof(header));
-	memcpy(&header, chunks[0].data, chunks[0].len);
-	memcpy((char *) &header + chunks[0].len, chunks[1].data, chunks[1].len);
-
-	return header.size;
-}
-
-static void
-circular_shrink(struct circular_buffer *buffer, size_t size)
-{
-	size_t shrank = 0, item_size;
-
-	assert(size <= buffer->allocated_size);
-
-	while (shrank < size && buffer->size > (item_size = peek_item_size(buffer))) {
-		assert(item_size > 0 && item_size <= buffer->allocated_size);
-
-		buffer->beginpos = (buffer->beginpos + item_size) % buffer->allocated_size;
-		buffer->size -= item_size;
-
-		shrank += item_size;
-	}
-}
-
-static ssize_t
-circular_buffer_write(void *c, const char *buf, size_t _size)
-{
-	struct circular_buffer *buffer = c;
-	size_t size = _size;
-
-	while (size) {
-		size_t avail = circular_available_size(buffer), item_size;
-		struct chunk chunks[2];
-
-		/* Make space in the buffer if there is too much data. */
-		if (avail < size)
-			circular_shrink(buffer, size - avail);
-
-		item_size = MIN(circular_available_size(buffer), size);
-
-		get_chunks(chunks, buffer, true, item_size);
-
-		memcpy(chunks[0].data, buf, chunks[0].len);
-		memcpy(chunks[1].data, buf + chunks[0].len, chunks[1].len);
-
-		buf += item_size;
-		size -= item_size;
-
-		buffer->endpos = (buffer->endpos + item_size) % buffer->allocated_size;
-		buffer->size += item_size;
-	}
-
-	return _size;
-}
-
-static int
-circular_buffer_seek(void *c, off64_t *offset, int whence)
-{
-	return -1;
-}
-
-static int
-circular_buffer_close(void *c)
-{
-	return 0;
-}
-
-cookie_io_functions_t circular_buffer_functions = {
-	.read  = circular_buffer_read,
-	.write = circular_buffer_write,
-	.seek  = circular_buffer_seek,
-	.close = circular_buffer_close,
-};
-
-
 static bool
 read_file_uint64(const char *file, uint64_t *value)
 {
@@ -402,8 +256,8 @@ struct recording_context {
 
 	uint32_t oa_exponent;
 
-	struct circular_buffer circular_buffer;
-	FILE *output_stream;
+	FILE *output;
+	struct igt_capture *capture;
 
 	const char *command_fifo;
 	int command_fifo_fd;
@@ -576,21 +430,6 @@ write_topology(FILE *output, struct recording_context *ctx)
 	return true;
 }
 
-static bool
-write_i915_perf_data(FILE *output, int perf_fd)
-{
-	ssize_t ret;
-	char data[4096];
-
-	while ((ret = read(perf_fd, data, sizeof(data))) > 0 ||
-	       errno == EINTR) {
-		if (fwrite(data, ret, 1, output) != 1)
-			return false;
-	}
-
-	return true;
-}
-
 static uint64_t timespec_diff(struct timespec *begin,
 			      struct timespec *end)
 {
@@ -683,6 +522,30 @@ write_correlation_timestamps(FILE *output, int drm_fd)
 	return write_saved_correlation_timestamps(output, &corr);
 }
 
+static bool
+capture_correlation_timestamps(struct igt_capture *capture, int drm_fd)
+{
+	struct {
+		struct drm_i915_perf_record_header header;
+		struct intel_perf_record_timestamp_correlation corr;
+	} __attribute__((packed)) record = {
+		.header = {
+			.type = INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+			.size = sizeof(record),
+		},
+	};
+	int ret;
+
+	if (!get_correlation_timestamps(&record.corr, drm_fd))
+		return false;
+
+	ret = igt_capture_write(capture, &record, sizeof(record));
+	if (ret)
+		errno = -ret;
+
+	return ret == 0;
+}
+
 static void
 read_command_file(struct recording_context *ctx)
 {
@@ -710,18 +573,11 @@ read_command_file(struct recording_context *ctx)
 
 		file = fopen((const char *) dump, "w+");
 		if (file) {
-			struct chunk chunks[2];
-
-			fflush(ctx->output_stream);
-			get_chunks(chunks, &ctx->circular_buffer,
-				   false, ctx->circular_buffer.size);
-
 			if (!write_version(file, ctx) ||
 			    !write_header(file, ctx) ||
 			    !write_topology(file, ctx) ||
-			    fwrite(chunks[0].data, chunks[0].len, 1, file) != 1 ||
-			    (chunks[1].len > 0 &&
-			     fwrite(chunks[1].data, chunks[1].len, 1, file) != 1) ||
+			    fflush(file) != 0 ||
+			    igt_capture_dump(ctx->capture, fileno(file)) != 0 ||
 			    !write_correlation_timestamps(file, ctx->drm_fd)) {
 				fprintf(stderr, "Unable to write circular buffer data in file '%s'\n",
 					dump);
@@ -743,11 +599,13 @@ read_command_file(struct recording_context *ctx)
 }
 
 static void
-print_metric_sets(const struct intel_perf *perf)
+print_metric_sets(struct intel_perf *perf)
 {
 	struct intel_perf_metric_set *metric_set;
 	uint32_t longest_name = 0;
 
+	intel_perf_load_metric_sets(perf);
+
 	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
 		longest_name = MAX(longest_name, strlen(metric_set->symbol_name));
 	}
@@ -785,6 +643,7 @@ print_metric_sets_counters(struct intel_perf *perf)
 {
 	struct intel_perf_metric_set *metric_set;
 
+	intel_perf_load_metric_sets(perf);
 	igt_list_for_each_entry(metric_set, &perf->metric_sets, link)
 		print_metric_set_counters(metric_set);
 }
@@ -818,7 +677,14 @@ usage(const char *name)
 		"                                       for OA reports periodically\n"
 		"                                       (default = 5000), Minimum = 100.\n"
 		"     --engine-class        -e <value>  Engine class used for the OA capture.\n"
-		"     --engine-instance     -i <value>  Engine instance used for the OA capture.\n",
+		"     --engine-instance     -i <value>  Engine instance used for the OA capture.\n"
+		"     --index,              -x          Write a <output>.idx index of the recording\n"
+		"                                       once done (for i915-perf-reader --index)\n"
+		"                                       Not available with a circular buffer\n"
+		"     --reader-thread,      -t          Drain the perf stream from a dedicated thread\n"
+		"     --reader-cpu,         -u <value>  CPU to pin the reader thread to, implies -t\n"
+		"     --buffer-size,        -b <value>  Size of the capture buffers in kilobytes\n"
+		"                                       (default = 1024)\n",
 		name);
 }
 
@@ -836,10 +702,9 @@ teardown_recording_context(struct recording_context *ctx)
 	if (ctx->command_fifo_fd != -1)
 		close(ctx->command_fifo_fd);
 
-	if (ctx->output_stream)
-		fclose(ctx->output_stream);
-
-	free(ctx->circular_buffer.data);
+	igt_capture_destroy(ctx->capture);
+	if (ctx->output)
+		fclose(ctx->output);
 
 	if (ctx->perf_fd != -1)
 		close(ctx->perf_fd);
@@ -891,6 +756,10 @@ main(int argc, char *argv[])
 		{"poll-period",          required_argument, 0, 'P'},
 		{"engine-class",         required_argument, 0, 'e'},
 		{"engine-instance",      required_argument, 0, 'i'},
+		{"index",                      no_argument, 0, 'x'},
+		{"reader-thread",              no_argument, 0, 't'},
+		{"reader-cpu",           required_argument, 0, 'u'},
+		{"buffer-size",          required_argument, 0, 'b'},
 		{0, 0, 0, 0}
 	};
 	const struct {
@@ -903,14 +772,14 @@ main(int argc, char *argv[])
 	};
 	double corr_period = 1.0, perf_period = 0.001;
 	const char *metric_name = NULL, *output_file = "i915_perf.record";
-	struct intel_perf_metric_set *metric_set;
-	struct intel_perf_record_timestamp_correlation initial_correlation;
+	struct igt_capture_options capture_opts = { .cpu = -1 };
+	struct igt_capture_stats stats;
 	struct timespec now;
 	uint64_t corr_period_ns, poll_time_ns;
 	uint32_t circular_size = 0;
-	int opt, dev_node_id = -1;
-	bool list_counters = false;
-	FILE *output = NULL;
+	int opt, ret, dev_node_id = -1;
+	bool list_counters = false, write_index = false;
+	char index_path[PATH_MAX];
 	struct recording_context ctx = {
 		.drm_fd = -1,
 		.perf_fd = -1,
@@ -923,7 +792,7 @@ main(int argc, char *argv[])
 		.engine = { USHRT_MAX, USHRT_MAX },
 	};
 
-	while ((opt = getopt_long(argc, argv, "hc:d:p:m:Co:s:f:k:P:e:i:", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:d:p:m:Co:s:f:k:P:e:i:xtu:b:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0]);
@@ -980,6 +849,19 @@ main(int argc, char *argv[])
 		case 'i':
 			ctx.engine.engine_instance = atoi(optarg);
 			break;
+		case 'x':
+			write_index = true;
+			break;
+		case 't':
+			capture_opts.threaded = true;
+			break;
+		case 'u':
+			capture_opts.threaded = true;
+			capture_opts.cpu = atoi(optarg);
+			break;
+		case 'b':
+			capture_opts.buffer_size = MAX(8, atoi(optarg)) * 1024;
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -993,6 +875,14 @@ main(int argc, char *argv[])
 		return EXIT_SUCCESS;
 	}
 
+	/* Circular recordings are only written out on a dump command */
+	if (write_index && circular_size) {
+		fprintf(stderr, "--index cannot be used with a circular buffer "
+			"(--size or --command-fifo).\n");
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
 	if (ctx.engine.engine_class == USHRT_MAX ||
 	    ctx.engine.engine_instance == USHRT_MAX) {
 		ctx.engine.engine_class = I915_ENGINE_CLASS_RENDER;
@@ -1027,26 +917,19 @@ main(int argc, char *argv[])
 		goto fail;
 	}
 
-	ctx.perf = intel_perf_for_fd(ctx.drm_fd, ctx.gt);
+	ctx.perf = intel_perf_for_fd_lazy(ctx.drm_fd, ctx.gt);
 	if (!ctx.perf) {
 		fprintf(stderr, "No perf data found.\n");
 		goto fail;
 	}
 
-	intel_perf_load_perf_configs(ctx.perf, ctx.drm_fd);
-
 	if (metric_name) {
 		if (!strcmp(metric_name, "list")) {
 			print_metric_sets(ctx.perf);
 			return EXIT_SUCCESS;
 		}
 
-		igt_list_for_each_entry(metric_set, &ctx.perf->metric_sets, link) {
-			if (!strcasecmp(metric_set->symbol_name, metric_name)) {
-				ctx.metric_set = metric_set;
-				break;
-			}
-		}
+		ctx.metric_set = intel_perf_find_metric_set(ctx.perf, metric_name);
 	}
 
 	if (list_counters) {
@@ -1091,47 +974,33 @@ main(int argc, char *argv[])
 	}
 
 	if (circular_size) {
-		ctx.circular_buffer.allocated_size = circular_size;
-		ctx.circular_buffer.data = malloc(circular_size);
-		if (!ctx.circular_buffer.data) {
-			fprintf(stderr, "Unable to allocate circular buffer\n");
-			goto fail;
-		}
-
-		ctx.output_stream = fopencookie(&ctx.circular_buffer, "w+",
-						circular_buffer_functions);
-		if (!ctx.output_stream) {
-			fprintf(stderr, "Unable to create circular buffer\n");
-			goto fail;
-		}
-
-		if (!get_correlation_timestamps(&initial_correlation, ctx.drm_fd)) {
-			fprintf(stderr, "Unable to correlation timestamps\n");
-			goto fail;
-		}
-
-		write_correlation_timestamps(ctx.output_stream, ctx.drm_fd);
+		capture_opts.ring_size = circular_size;
 		fprintf(stdout,
 			"Recoding in internal circular buffer.\n"
 			"Use i915-perf-control to snapshot into file.\n");
 	} else {
-		output = fopen(output_file, "w+");
-		if (!output) {
+		ctx.output = fopen(output_file, "w+");
+		if (!ctx.output) {
 			fprintf(stderr, "Unable to open output file '%s'\n",
 				output_file);
 			goto fail;
 		}
 
-		if (!write_version(output, &ctx) ||
-		    !write_header(output, &ctx) ||
-		    !write_topology(output, &ctx) ||
-		    !write_correlation_timestamps(output, ctx.drm_fd)) {
+		/* An index of a previous recording would no longer match. */
+		snprintf(index_path, sizeof(index_path), "%s.idx", output_file);
+		unlink(index_path);
+
+		/* The capture writes to the file descriptor from here on. */
+		if (!write_version(ctx.output, &ctx) ||
+		    !write_header(ctx.output, &ctx) ||
+		    !write_topology(ctx.output, &ctx) ||
+		    !write_correlation_timestamps(ctx.output, ctx.drm_fd) ||
+		    fflush(ctx.output) != 0) {
 			fprintf(stderr, "Unable to write header in file '%s'\n",
 				output_file);
 			goto fail;
 		}
 
-		ctx.output_stream = output;
 		fprintf(stdout, "Writing recoding to %s\n", output_file);
 	}
 
@@ -1157,16 +1026,35 @@ main(int argc, char *argv[])
 		goto fail;
 	}
 
+	ctx.capture = igt_capture_create(ctx.perf_fd,
+					 ctx.output ? fileno(ctx.output) : -1,
+					 &capture_opts);
+	if (!ctx.capture) {
+		fprintf(stderr, "Unable to allocate capture buffers\n");
+		goto fail;
+	}
+
+	if (circular_size &&
+	    !capture_correlation_timestamps(ctx.capture, ctx.drm_fd)) {
+		fprintf(stderr, "Unable to correlation timestamps\n");
+		goto fail;
+	}
+
+	ret = igt_capture_start(ctx.capture);
+	if (ret) {
+		fprintf(stderr, "Unable to start capture: %s\n", strerror(-ret));
+		goto fail;
+	}
+
 	corr_period_ns = corr_period * 1000000000ul;
 	poll_time_ns = corr_period_ns;
 
 	while (!quit) {
 		struct pollfd pollfd[2] = {
-			{         ctx.perf_fd, POLLIN, 0 },
+			{ igt_capture_poll_fd(ctx.capture), POLLIN, 0 },
 			{ ctx.command_fifo_fd, POLLIN, 0 },
 		};
 		uint64_t elapsed_ns;
-		int ret;
 
 		igt_gettime(&now);
 		ret = poll(pollfd, ctx.command_fifo_fd != -1 ? 2 : 1, poll_time_ns / 1000000);
@@ -1178,9 +1066,10 @@ main(int argc, char *argv[])
 
 		if (ret > 0) {
 			if (pollfd[0].revents & POLLIN) {
-				if (!write_i915_perf_data(ctx.output_stream, ctx.perf_fd)) {
+				ret = igt_capture_pump(ctx.capture);
+				if (ret) {
 					fprintf(stderr, "Failed to write i915-perf data: %s\n",
-						strerror(errno));
+						strerror(-ret));
 					break;
 				}
 			}
@@ -1193,7 +1082,7 @@ main(int argc, char *argv[])
 		elapsed_ns = igt_nsec_elapsed(&now);
 		if (elapsed_ns > poll_time_ns) {
 			poll_time_ns = corr_period_ns;
-			if (!write_correlation_timestamps(ctx.output_stream, ctx.drm_fd)) {
+			if (!capture_correlation_timestamps(ctx.capture, ctx.drm_fd)) {
 				fprintf(stderr,
 					"Failed to write i915 timestamp correlation data: %s\n",
 					strerror(errno));
@@ -1206,19 +1095,40 @@ main(int argc, char *argv[])
 
 	fprintf(stdout, "Exiting...\n");
 
-	if (!write_i915_perf_data(ctx.output_stream, ctx.perf_fd)) {
+	ret = igt_capture_stop(ctx.capture);
+	if (ret) {
 		fprintf(stderr, "Failed to write i915-perf data: %s\n",
-			strerror(errno));
+			strerror(-ret));
 	}
 
-	if (!write_correlation_timestamps(ctx.output_stream, ctx.drm_fd)) {
+	if (!capture_correlation_timestamps(ctx.capture, ctx.drm_fd)) {
 		fprintf(stderr,
 			"Failed to write final i915 timestamp correlation data: %s\n",
 			strerror(errno));
 	}
 
+	igt_capture_get_stats(ctx.capture, &stats);
+	fprintf(stdout,
+		"Captured %"PRIu64" reports (%.1f MiB/s), %"PRIu64" reports lost, "
+		"%"PRIu64" buffer overflows, %"PRIu64" reader stalls\n",
+		stats.samples,
+		stats.elapsed_ns ?
+		stats.bytes_read * 1e9 / stats.elapsed_ns / (1024 * 1024) : 0.0,
+		stats.reports_lost, stats.buffers_lost, stats.stalls);
+
 	teardown_recording_context(&ctx);
 
+	if (write_index) {
+		struct intel_perf_data_reader reader;
+
+		fprintf(stdout, "Indexing %s\n", output_file);
+		if (intel_perf_data_reader_init_cached(&reader, output_file))
+			intel_perf_data_reader_fini(&reader);
+		else
+			fprintf(stderr, "Unable to index '%s': %s\n",
+				output_file, reader.error_msg);
+	}
+
 	return EXIT_SUCCESS;
 
  fail:
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2026 Intel Corporation
+ */
+
+/*
+ * Compares the results of a benchmark written with --json against those of
+ * a baseline run, flagging the statistically significant changes. Exits
+ * with 1 if any result regressed, so it can gate a run.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_benchmark.h"
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-a <alpha>] [-t <threshold>] "
+		"<base.json> <result.json>\n"
+		"  -a  significance level, default 0.05\n"
+		"  -t  smallest relative change of the medians, default 0.02\n",
+		name);
+}
+
+static struct igt_benchmark_results *load(const char *filename)
+{
+	struct igt_benchmark_results *results;
+	int ret;
+
+	ret = igt_benchmark_load(filename, &results);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", filename,
+			ret == -EPROTO ? "unknown schema version" :
+			ret == -EINVAL ? "not benchmark results" :
+			strerror(-ret));
+		return NULL;
+	}
+
+	return results;
+}
+
+int main(int argc, char **argv)
+{
+	struct igt_benchmark_results *base, *results;
+	double alpha = 0.05, threshold = 0.02;
+	unsigned int regressions = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "a:t:h")) != -1) {
+		switch (c) {
+		case 'a':
+			alpha = atof(optarg);
+			break;
+		case 't':
+			threshold = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 2;
+		}
+	}
+
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	base = load(argv[optind]);
+	results = load(argv[optind + 1]);
+	if (!base || !results)
+		return 2;
+
+	if (strcmp(base->benchmark, results->benchmark))
+		fprintf(stderr, "Comparing %s against %s\n",
+			results->benchmark, base->benchmark);
+
+	printf("%-32s %12s %12s %8s %8s\n",
+	       "result", "base", "new", "change", "p");
+	for (unsigned int i = 0; i < results->nr_results; i++) {
+		const struct igt_benchmark_result *r = &results->results[i];
+		const struct igt_benchmark_result *b;
+		struct igt_benchmark_comparison cmp;
+
+		b = igt_benchmark_find(base, r->name);
+		if (!b) {
+			printf("%-32s %12s %12.4g %8s %8s  new\n",
+			       r->name, "-", r->median, "-", "-");
+			continue;
+		}
+
+		igt_benchmark_compare(b, r, alpha, threshold, &cmp);
+		printf("%-32s %12.4g %12.4g %+7.1f%% %8.3g%s\n",
+		       r->name, b->median, r->median,
+		       100 * cmp.change, cmp.p,
+		       cmp.regression ? "  REGRESSION" :
+		       cmp.improvement ? "  improvement" : "");
+		regressions += cmp.regression;
+	}
+
+	for (unsigned int i = 0; i < base->nr_results; i++)
+		if (!igt_benchmark_find(results, base->results[i].name))
+			printf("%-32s %12.4g %12s %8s %8s  missing\n",
+			       base->results[i].name, base->results[i].median,
+			       "-", "-", "-");
+
+	igt_benchmark_results_free(base);
+	igt_benchmark_results_free(results);
+
+	if (regressions)
+		printf("%u regression%s\n", regressions,
+		       regressions > 1 ? "s" : "");
+
+	return regressions ? 1 : 0;
+}
@@ -161,17 +161,19 @@ main (int argc, char *argv[])
 	int i, c;
 	int option_index = 0;
 	int binary = -1;
+	int summary = 0;
 
 	static struct option long_options[] = {
 		{"devid", 1, 0, 'd'},
 		{"ascii", 0, 0, 'a'},
 		{"binary", 0, 0, 'b'},
+		{"summary", 0, 0, 's'},
 		{ 0 }
 	};
 
 	devid_str = getenv("INTEL_DEVID_OVERRIDE");
 
-	while((c = getopt_long(argc, argv, "ad:b",
+	while((c = getopt_long(argc, argv, "ad:bs",
 			       long_options, &option_index)) != -1) {
 		switch(c) {
 		case 'd':
@@ -183,6 +185,9 @@ main (int argc, char *argv[])
 		case 'a':
 			binary = 0;
 			break;
+		case 's':
+			summary = 1;
+			break;
 		default:
 			printf("unkown command options\n");
 			break;
@@ -194,6 +199,15 @@ main (int argc, char *argv[])
 
 	ctx = intel_decode_context_alloc(devid);
 
+	/* Only count the commands, skipping the text decode */
+	if (summary) {
+		intel_decode_set_output_file(ctx, NULL);
+		if (intel_decode_set_summary(ctx, 1)) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+	}
+
 	if (optind == argc) {
 		fprintf(stderr, "no input file given\n");
 		exit(-1);
@@ -213,5 +227,8 @@ main (int argc, char *argv[])
 			read_autodetect_file(argv[i]);
 	}
 
+	if (summary)
+		intel_decode_print_summary(ctx, stdout);
+
 	return 0;
 }
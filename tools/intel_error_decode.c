@@ -46,17 +46,21 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <err.h>
+#include <pthread.h>
 #include <assert.h>
 #include <zlib.h>
 #include <ctype.h>
+#include <getopt.h>
 
 #include "intel_chipset.h"
 #include "intel_io.h"
 #include "instdone.h"
 #include "intel_reg.h"
 #include "drmtest.h"
+#include "igt_aux.h"
 #include "i915/intel_decode.h"
 
 static uint32_t
@@ -445,43 +449,169 @@ static bool maybe_ascii(const void *data, int check)
 	return true;
 }
 
-static void decode(struct intel_decode *ctx,
-		   const char *buffer_name,
-		   const char *ring_name,
-		   uint64_t gtt_offset,
-		   uint32_t head_offset,
-		   uint32_t *data, int *count,
-		   int decode)
+/*
+ * The error state is decoded in two phases. The first pass over the input
+ * splits it into sections: runs of register dump lines that are printed as
+ * is, and buffers. Buffers are then decompressed and decoded by a pool of
+ * workers into memory, while the main thread writes the sections out in
+ * their original order. Buffers excluded by the command line filters are
+ * never decompressed.
+ */
+enum section_type {
+	SECTION_TEXT,
+	SECTION_ASCII85,
+	SECTION_ASCII85_ZLIB,
+	SECTION_HEX,
+};
+
+struct section {
+	enum section_type type;
+	const char *start, *end;
+
+	/* Buffer name, location and the decoder state when it was dumped */
+	const char *buffer_name;
+	const char *ring_name;
+	uint64_t gtt_offset;
+	uint32_t head_offset;
+	uint32_t devid;
+	bool has_ctx;
+	uint32_t head, tail;
+	bool do_decode;
+	/* ACTHD of the buffer's own engine, if it was found */
+	bool has_acthd;
+	uint64_t acthd;
+
+	/* Decoded output, valid once done is set */
+	char *out;
+	size_t out_len;
+	bool done;
+};
+
+struct error_state {
+	const char *data;
+	size_t size;
+	bool mapped;
+
+	struct section *sections;
+	unsigned int num_sections;
+	unsigned int max_sections;
+
+	char **ring_names;
+	unsigned int num_ring_names;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Next section for the workers, and the number written out so far */
+	unsigned int next;
+	unsigned int emitted;
+};
+
+static struct {
+	unsigned int jobs;
+	const char *engine;
+	const char *buffers;
+	int around;
+} opts = {
+	.around = -1,
+};
+
+/* Offsets relative to the start of the buffer */
+struct packet_start {
+	uint32_t target;
+	uint32_t found;
+};
+
+static void find_packet_start(const struct intel_decode_cmd *cmd, void *data)
+{
+	struct packet_start *ps = data;
+
+	if (cmd->hw_offset <= ps->target)
+		ps->found = cmd->hw_offset;
+}
+
+/*
+ * Narrow the decode down to opts.around dwords either side of the ring's
+ * HEAD or the engine's ACTHD, starting on a packet boundary.
+ */
+static bool around_head(struct intel_decode *ctx, const struct section *s,
+			uint32_t *data, int count, int *start, int *end)
 {
-	if (!*count)
+	uint64_t acthd = s->has_acthd ? s->acthd : s->head;
+	struct packet_start ps;
+	int64_t center;
+
+	if (s->head_offset != -1)
+		center = s->head_offset / 4;
+	else if (acthd >= s->gtt_offset && acthd - s->gtt_offset < 4ull * count)
+		center = (acthd - s->gtt_offset) / 4;
+	else
+		return false;
+
+	*start = max_t(int64_t, (center - opts.around), 0);
+	*end = min_t(int64_t, (center + opts.around + 1), count);
+
+	/* The decoder's offsets are 32 bits, so walk the buffer from 0 */
+	ps.target = 4 * *start;
+	ps.found = 0;
+	intel_decode_set_output_file(ctx, NULL);
+	intel_decode_set_visitor(ctx, find_packet_start, &ps);
+	intel_decode_set_batch_pointer(ctx, data, 0, *start + 1);
+	intel_decode(ctx);
+	intel_decode_set_visitor(ctx, NULL, NULL);
+	*start = ps.found / 4;
+
+	return true;
+}
+
+static void decode(FILE *f, struct intel_decode *ctx,
+		   const struct section *s, uint32_t *data, int count)
+{
+	int start = 0, end = count;
+
+	if (!count)
 		return;
 
-	printf("%s (%s) at 0x%08x_%08x", buffer_name, ring_name,
-	       (unsigned)(gtt_offset >> 32),
-	       (unsigned)(gtt_offset & 0xffffffff));
-	if (head_offset != -1)
-		printf("; HEAD points to: 0x%08x_%08x",
-		       (unsigned)((head_offset + gtt_offset) >> 32),
-		       (unsigned)((head_offset + gtt_offset) & 0xffffffff));
-	printf("\n");
-
-	if (decode && ctx) {
-		intel_decode_set_batch_pointer(ctx, data, gtt_offset,
-						   *count);
+	if (opts.around >= 0 &&
+	    (!ctx || !around_head(ctx, s, data, count, &start, &end)))
+		return;
+
+	fprintf(f, "%s (%s) at 0x%08x_%08x", s->buffer_name, s->ring_name,
+		(unsigned)(s->gtt_offset >> 32),
+		(unsigned)(s->gtt_offset & 0xffffffff));
+	if (s->head_offset != -1)
+		fprintf(f, "; HEAD points to: 0x%08x_%08x",
+			(unsigned)((s->head_offset + s->gtt_offset) >> 32),
+			(unsigned)((s->head_offset + s->gtt_offset) & 0xffffffff));
+	fprintf(f, "\n");
+
+	if (s->do_decode && ctx) {
+		intel_decode_set_output_file(ctx, f);
+		/*
+		 * The decoder only tracks the low 32 bits of addresses, like
+		 * those of the batch pointer below.
+		 */
+		if (opts.around >= 0 && s->has_acthd)
+			intel_decode_set_head_tail(ctx, s->acthd & 0xffffffff,
+						   0xffffffff);
+		else
+			intel_decode_set_head_tail(ctx, s->head, s->tail);
+		intel_decode_set_batch_pointer(ctx, data + start,
+					       s->gtt_offset + 4 * start,
+					       end - start);
 		intel_decode(ctx);
 	} else if (maybe_ascii(data, 16)) {
-		printf("%*s\n", 4 * *count, (char *)data);
+		fprintf(f, "%*s\n", 4 * count, (char *)data);
 	} else {
-		for (int i = 0; i + 4 <= *count; i += 4)
-			printf("[%04x] %08x %08x %08x %08x\n",
-			       4*i, data[i], data[i+1], data[i+2], data[i+3]);
+		for (int i = 0; i + 4 <= count; i += 4)
+			fprintf(f, "[%04x] %08x %08x %08x %08x\n",
+				4*i, data[i], data[i+1], data[i+2], data[i+3]);
 	}
-	*count = 0;
 }
 
 static int zlib_inflate(uint32_t **ptr, int len)
 {
 	struct z_stream_s zstream;
+	size_t size;
 	void *out;
 
 	memset(&zstream, 0, sizeof(zstream));
@@ -492,9 +622,15 @@ static int zlib_inflate(uint32_t **ptr, int len)
 	if (inflateInit(&zstream) != Z_OK)
 		return 0;
 
-	out = malloc(128*4096); /* approximate obj size */
+	/* Batches typically compress about 4:1, avoid regrowing those */
+	size = max_t(size_t, 128*4096, (16*(size_t)len));
+	out = malloc(size);
+	if (out == NULL) {
+		inflateEnd(&zstream);
+		return 0;
+	}
 	zstream.next_out = out;
-	zstream.avail_out = 128*4096;
+	zstream.avail_out = size;
 
 	do {
 		switch (inflate(&zstream, Z_SYNC_FLUSH)) {
@@ -503,6 +639,7 @@ static int zlib_inflate(uint32_t **ptr, int len)
 		case Z_OK:
 			break;
 		default:
+			free(out);
 			inflateEnd(&zstream);
 			return 0;
 		}
@@ -526,27 +663,36 @@ end:
 	return zstream.total_out / 4;
 }
 
-static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
+static bool is_ascii85(char c)
 {
-	int len = 0, size = 1024;
+	return c >= '!' && c <= 'z';
+}
 
-	*out = realloc(*out, sizeof(uint32_t)*size);
+static int ascii85_decode(const char *in, const char *end,
+			  uint32_t **out, bool inflate)
+{
+	const char *c;
+	int len = 0;
+
+	/* Size the output exactly, 'z' is a zero dword, otherwise 5 chars */
+	for (c = in; c < end && is_ascii85(*c); len++)
+		c += *c == 'z' ? 1 : 5;
+	end = c;
+
+	*out = malloc(sizeof(uint32_t) * max(len, 1));
 	if (*out == NULL)
 		return 0;
 
-	while (*in >= '!' && *in <= 'z') {
+	len = 0;
+	while (in < end) {
 		uint32_t v = 0;
 
-		if (len == size) {
-			size *= 2;
-			*out = realloc(*out, sizeof(uint32_t)*size);
-			if (*out == NULL)
-				return 0;
-		}
-
 		if (*in == 'z') {
 			in++;
 		} else {
+			if (end - in < 5)
+				break;
+
 			v += in[0] - 33; v *= 85;
 			v += in[1] - 33; v *= 85;
 			v += in[2] - 33; v *= 85;
@@ -563,42 +709,254 @@ static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
 	return zlib_inflate(out, len);
 }
 
+static const char *next_line(const char *line, const char *end)
+{
+	const char *eol = memchr(line, '\n', end - line);
+
+	return eol ? eol + 1 : end;
+}
+
+/* NUL terminated copy of the start of a line, enough for sscanf() */
+static const char *line_str(char *buf, size_t size,
+			    const char *line, const char *eol)
+{
+	size_t len = min((size_t)(eol - line), size - 1);
+
+	memcpy(buf, line, len);
+	buf[len] = '\0';
+
+	return buf;
+}
+
+static int hex_decode(const char *in, const char *end, uint32_t **out)
+{
+	int len = 0, size = 1024;
+	uint32_t offset, value;
+	char buf[64];
+
+	*out = malloc(sizeof(uint32_t) * size);
+	if (*out == NULL)
+		return 0;
+
+	for (; in < end; in = next_line(in, end)) {
+		if (sscanf(line_str(buf, sizeof(buf), in, end),
+			   "%08x : %08x", &offset, &value) != 2)
+			continue;
+
+		if (len == size) {
+			size *= 2;
+			*out = realloc(*out, sizeof(uint32_t) * size);
+			if (*out == NULL)
+				return 0;
+		}
+		(*out)[len++] = value;
+	}
+
+	return len;
+}
+
+static void decode_section(struct section *s, struct intel_decode **ctx,
+			   uint32_t *ctx_devid)
+{
+	uint32_t *data = NULL;
+	int count;
+	FILE *f;
+
+	if (s->has_ctx && (!*ctx || *ctx_devid != s->devid)) {
+		if (*ctx)
+			intel_decode_context_free(*ctx);
+		*ctx = intel_decode_context_alloc(s->devid);
+		*ctx_devid = s->devid;
+	}
+
+	if (s->type == SECTION_HEX) {
+		count = hex_decode(s->start, s->end, &data);
+	} else {
+		count = ascii85_decode(s->start + 1, s->end, &data,
+				       s->type == SECTION_ASCII85_ZLIB);
+		if (count == 0)
+			fprintf(stderr, "ASCII85 decode failed (%s - %s).\n",
+				s->ring_name, s->buffer_name);
+	}
+
+	f = open_memstream(&s->out, &s->out_len);
+	if (f) {
+		decode(f, s->has_ctx ? *ctx : NULL, s, data, count);
+		fclose(f);
+	}
+
+	free(data);
+}
+
+static void *decode_worker(void *arg)
+{
+	struct error_state *es = arg;
+	struct intel_decode *ctx = NULL;
+	uint32_t ctx_devid = 0;
+	/* Bound the decoded output held in memory ahead of the writer */
+	unsigned int window = 4 * opts.jobs;
+
+	pthread_mutex_lock(&es->lock);
+	for (;;) {
+		unsigned int i = es->next;
+		struct section *s;
+
+		while (i < es->num_sections &&
+		       es->sections[i].type == SECTION_TEXT)
+			i++;
+		if (i >= es->num_sections)
+			break;
+
+		if (i >= es->emitted + window) {
+			pthread_cond_wait(&es->cond, &es->lock);
+			continue;
+		}
+
+		es->next = i + 1;
+		s = &es->sections[i];
+		pthread_mutex_unlock(&es->lock);
+
+		decode_section(s, &ctx, &ctx_devid);
+
+		pthread_mutex_lock(&es->lock);
+		s->done = true;
+		pthread_cond_broadcast(&es->cond);
+	}
+	pthread_mutex_unlock(&es->lock);
+
+	if (ctx)
+		intel_decode_context_free(ctx);
+
+	return NULL;
+}
+
+static bool buffer_wanted(const char *ring_name, const char *buffer_name)
+{
+	const char *b, *sep;
+
+	if (opts.engine &&
+	    (!ring_name ||
+	     strncasecmp(ring_name, opts.engine, strlen(opts.engine))))
+		return false;
+
+	if (!opts.buffers)
+		return true;
+
+	for (b = opts.buffers; *b; b = *sep ? sep + 1 : sep) {
+		sep = strchrnul(b, ',');
+		if (sep != b && !strncasecmp(buffer_name, b, sep - b))
+			return true;
+	}
+
+	return false;
+}
+
+static struct section *
+add_section(struct error_state *es, enum section_type type,
+	    const char *start, const char *end)
+{
+	struct section *s;
+
+	if (es->num_sections == es->max_sections) {
+		es->max_sections = es->max_sections ? 2 * es->max_sections : 256;
+		es->sections = realloc(es->sections,
+				       es->max_sections * sizeof(*s));
+		if (es->sections == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+	}
+
+	s = &es->sections[es->num_sections++];
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+	s->start = start;
+	s->end = end;
+
+	return s;
+}
+
 static void
-read_data_file(FILE *file)
+index_error_state(struct error_state *es)
 {
-	struct intel_decode *decode_ctx = NULL;
+	const char *end = es->data + es->size;
+	const char *line, *eol;
+	const char *text = NULL, *hex = NULL;
 	uint32_t devid = PCI_CHIP_I855_GM;
-	uint32_t *data = NULL;
 	uint32_t head[MAX_RINGS];
 	int head_idx = 0;
 	int num_rings = 0;
-	long long unsigned fence;
-	int data_size = 0, count = 0, matched;
-	char *line = NULL;
-	size_t line_size;
-	uint32_t offset, value, ring_length = 0;
+	struct {
+		char name[32];
+		bool has_acthd;
+		uint64_t acthd;
+	} engines[MAX_RINGS];
+	int num_engines = 0;
+	bool has_ctx = false;
+	uint32_t ctx_head = 0, ctx_tail = 0;
 	uint64_t gtt_offset = 0;
 	uint32_t head_offset = -1;
 	const char *buffer_name = "batch buffer";
 	char *ring_name = NULL;
 	int do_decode = 1;
-
-	while (getline(&line, &line_size, file) > 0) {
-		char *dashes;
+	uint32_t offset, value, reg, lo;
+	char buf[256];
+	int matched;
+
+/* Only decodable buffers can be narrowed down to HEAD */
+#define ADD_BUFFER(type, start, end) do {				\
+	if (buffer_wanted(ring_name, buffer_name) &&			\
+	    (opts.around < 0 || do_decode)) {				\
+		struct section *s = add_section(es, type, start, end);	\
+		s->buffer_name = buffer_name;				\
+		s->ring_name = ring_name;				\
+		s->gtt_offset = gtt_offset;				\
+		s->head_offset = head_offset;				\
+		s->devid = devid;					\
+		s->has_ctx = has_ctx;					\
+		s->head = ctx_head;					\
+		s->tail = ctx_tail;					\
+		s->do_decode = do_decode;				\
+		for (int e = 0; ring_name && e < num_engines; e++) {	\
+			if (strncasecmp(ring_name, engines[e].name,	\
+					strlen(engines[e].name)))	\
+				continue;				\
+			s->has_acthd = engines[e].has_acthd;		\
+			s->acthd = engines[e].acthd;			\
+			break;						\
+		}							\
+	}								\
+} while (0)
+
+#define FLUSH_TEXT(_end) do {						\
+	if (text)							\
+		add_section(es, SECTION_TEXT, text, _end);		\
+	text = NULL;							\
+} while (0)
+
+#define FLUSH_HEX(_end) do {						\
+	if (hex)							\
+		ADD_BUFFER(SECTION_HEX, hex, _end);			\
+	hex = NULL;							\
+} while (0)
+
+	for (line = es->data; line < end; line = eol) {
+		const char *dashes, *cs;
+
+		eol = next_line(line, end);
 
 		if (line[0] == ':' || line[0] == '~') {
-			count = ascii85_decode(line+1, &data, line[0] == ':');
-			if (count == 0)
-				fprintf(stderr, "ASCII85 decode failed (%s - %s).\n",
-					ring_name, buffer_name);
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
+			FLUSH_TEXT(line);
+			FLUSH_HEX(line);
+			ADD_BUFFER(line[0] == ':' ?
+				   SECTION_ASCII85_ZLIB : SECTION_ASCII85,
+				   line, eol);
 			continue;
 		}
 
-		dashes = strstr(line, "---");
+		line_str(buf, sizeof(buf), line, eol);
+
+		dashes = strstr(buf, "---");
 		if (dashes) {
 			const struct {
 				const char *match;
@@ -620,21 +978,21 @@ read_data_file(FILE *file)
 				{ "guc ct buffer", "GuC CTB", 0 },
 				{ },
 			}, *b;
-			char *new_ring_name;
 
-			new_ring_name = malloc(dashes - line);
-			strncpy(new_ring_name, line, dashes - line);
-			new_ring_name[dashes - line - 1] = '\0';
-
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
+			FLUSH_TEXT(line);
+			FLUSH_HEX(line);
 			gtt_offset = 0;
 			head_offset = -1;
 
-			free(ring_name);
-			ring_name = new_ring_name;
+			ring_name = strndup(buf, max_t(ptrdiff_t, (dashes - buf - 1), 0));
+			es->ring_names = realloc(es->ring_names,
+						 (es->num_ring_names + 1) *
+						 sizeof(*es->ring_names));
+			if (!ring_name || !es->ring_names) {
+				fprintf(stderr, "Out of memory.\n");
+				exit(1);
+			}
+			es->ring_names[es->num_ring_names++] = ring_name;
 
 			dashes += 4;
 			for (b = buffers; b->match; b++) {
@@ -661,112 +1019,266 @@ read_data_file(FILE *file)
 				do_decode = b->do_decode;
 				buffer_name = b->name;
 				if (b == buffers)
-					head_offset = head[head_idx++];
+					head_offset = head_idx < num_rings ?
+						head[head_idx++] : -1;
 				break;
 			}
 
 			continue;
 		}
 
-		matched = sscanf(line, "%08x : %08x", &offset, &value);
-		if (matched != 2) {
-			unsigned int reg, reg2;
-
-			/* display reg section is after the ringbuffers, don't mix them */
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
-
-			printf("%s", line);
-
-			matched = sscanf(line, "PCI ID: 0x%04x\n", &reg);
-			if (matched == 0)
-				matched = sscanf(line, " PCI ID: 0x%04x\n", &reg);
-			if (matched == 0) {
-				const char *pci_id_start = strstr(line, "PCI ID");
-				if (pci_id_start)
-					matched = sscanf(pci_id_start, "PCI ID: 0x%04x\n", &reg);
-			}
-			if (matched == 1) {
-				devid = reg;
-				printf("Detected GEN%i chipset\n",
-						intel_gen(devid));
+		if (sscanf(buf, "%08x : %08x", &offset, &value) == 2) {
+			FLUSH_TEXT(line);
+			if (!hex)
+				hex = line;
+			continue;
+		}
 
-				decode_ctx = intel_decode_context_alloc(devid);
-			}
+		/* display reg section is after the ringbuffers, don't mix them */
+		FLUSH_HEX(line);
+		if (!text)
+			text = line;
+
+		matched = sscanf(buf, "PCI ID: 0x%04x\n", &reg);
+		if (matched == 0)
+			matched = sscanf(buf, " PCI ID: 0x%04x\n", &reg);
+		if (matched == 0) {
+			const char *pci_id_start = strstr(buf, "PCI ID");
+			if (pci_id_start)
+				matched = sscanf(pci_id_start, "PCI ID: 0x%04x\n", &reg);
+		}
+		if (matched == 1) {
+			devid = reg;
+			has_ctx = true;
+			ctx_head = ctx_tail = 0;
+		}
 
-			matched = sscanf(line, "  CTL: 0x%08x\n", &reg);
-			if (matched == 1)
-				ring_length = print_ctl(reg);
+		if (sscanf(buf, "  HEAD: 0x%08x\n", &reg) == 1 &&
+		    num_rings < MAX_RINGS)
+			head[num_rings++] = reg & (0x7ffff<<2);
 
-			matched = sscanf(line, "  HEAD: 0x%08x\n", &reg);
-			if (matched == 1) {
-				head[num_rings++] = print_head(reg);
+		/* Gen8+ print the upper and lower halves of ACTHD */
+		matched = sscanf(buf, "  ACTHD: 0x%08x %08x\n", &reg, &lo);
+		if (matched > 0) {
+			if (has_ctx) {
+				ctx_head = reg;
+				ctx_tail = 0xffffffff;
+			}
+			if (num_engines) {
+				engines[num_engines - 1].has_acthd = true;
+				engines[num_engines - 1].acthd = matched == 2 ?
+					(uint64_t)reg << 32 | lo : reg;
 			}
+		}
+
+		cs = strstr(buf, " command stream:");
+		if (cs && num_engines < MAX_RINGS) {
+			const char *name = buf + strspn(buf, " ");
+
+			snprintf(engines[num_engines].name,
+				 sizeof(engines[num_engines].name), "%.*s",
+				 (int)max_t(ptrdiff_t, (cs - name), 0), name);
+			engines[num_engines].has_acthd = false;
+			num_engines++;
+		}
+	}
 
-			matched = sscanf(line, "  ACTHD: 0x%08x\n", &reg);
-			if (matched == 1) {
-				print_acthd(reg, ring_length);
-				if (decode_ctx)
-					intel_decode_set_head_tail(decode_ctx,
-								       reg,
-								       0xffffffff);
+	FLUSH_TEXT(end);
+	FLUSH_HEX(end);
+
+#undef FLUSH_HEX
+#undef FLUSH_TEXT
+#undef ADD_BUFFER
+}
+
+struct text_state {
+	uint32_t devid;
+	uint32_t ring_length;
+	char *line;
+	size_t line_size;
+};
+
+static void
+print_text_section(const struct section *s, struct text_state *ts)
+{
+	const char *in, *eol;
+
+	for (in = s->start; in < s->end; in = eol) {
+		char *line;
+		unsigned int reg, reg2;
+		long long unsigned fence;
+		int matched;
+
+		eol = next_line(in, s->end);
+		if (ts->line_size < eol - in + 1) {
+			ts->line_size = eol - in + 1;
+			ts->line = realloc(ts->line, ts->line_size);
+			if (ts->line == NULL) {
+				fprintf(stderr, "Out of memory.\n");
+				exit(1);
 			}
+		}
+		line = (char *)line_str(ts->line, ts->line_size, in, eol);
+
+		printf("%s", line);
 
-			matched = sscanf(line, "  PGTBL_ER: 0x%08x\n", &reg);
-			if (matched == 1 && reg)
-				print_pgtbl_err(reg, devid);
+		matched = sscanf(line, "PCI ID: 0x%04x\n", &reg);
+		if (matched == 0)
+			matched = sscanf(line, " PCI ID: 0x%04x\n", &reg);
+		if (matched == 0) {
+			const char *pci_id_start = strstr(line, "PCI ID");
+			if (pci_id_start)
+				matched = sscanf(pci_id_start, "PCI ID: 0x%04x\n", &reg);
+		}
+		if (matched == 1) {
+			ts->devid = reg;
+			printf("Detected GEN%i chipset\n",
+					intel_gen(ts->devid));
+		}
 
-			matched = sscanf(line, "  ERROR: 0x%08x\n", &reg);
-			if (matched == 1 && reg)
-				print_error(reg, devid);
+		matched = sscanf(line, "  CTL: 0x%08x\n", &reg);
+		if (matched == 1)
+			ts->ring_length = print_ctl(reg);
 
-			matched = sscanf(line, "  INSTDONE: 0x%08x\n", &reg);
-			if (matched == 1)
-				print_instdone(devid, reg, -1);
+		matched = sscanf(line, "  HEAD: 0x%08x\n", &reg);
+		if (matched == 1)
+			print_head(reg);
 
-			matched = sscanf(line, "  INSTDONE1: 0x%08x\n", &reg);
-			if (matched == 1)
-				print_instdone(devid, -1, reg);
+		matched = sscanf(line, "  ACTHD: 0x%08x\n", &reg);
+		if (matched == 1)
+			print_acthd(reg, ts->ring_length);
 
-			matched = sscanf(line, "  fence[%i] = %Lx\n", &reg, &fence);
-			if (matched == 2)
-				print_fence(devid, fence);
+		matched = sscanf(line, "  PGTBL_ER: 0x%08x\n", &reg);
+		if (matched == 1 && reg)
+			print_pgtbl_err(reg, ts->devid);
 
-			matched = sscanf(line, "  FAULT_REG: 0x%08x\n", &reg);
-			if (matched == 1 && reg)
-				print_fault_reg(devid, reg);
+		matched = sscanf(line, "  ERROR: 0x%08x\n", &reg);
+		if (matched == 1 && reg)
+			print_error(reg, ts->devid);
 
-			matched = sscanf(line, "  FAULT_TLB_DATA: 0x%08x 0x%08x\n", &reg, &reg2);
-			if (matched == 2)
-				print_fault_data(devid, reg, reg2);
+		matched = sscanf(line, "  INSTDONE: 0x%08x\n", &reg);
+		if (matched == 1)
+			print_instdone(ts->devid, reg, -1);
 
-			continue;
+		matched = sscanf(line, "  INSTDONE1: 0x%08x\n", &reg);
+		if (matched == 1)
+			print_instdone(ts->devid, -1, reg);
+
+		matched = sscanf(line, "  fence[%i] = %Lx\n", &reg, &fence);
+		if (matched == 2)
+			print_fence(ts->devid, fence);
+
+		matched = sscanf(line, "  FAULT_REG: 0x%08x\n", &reg);
+		if (matched == 1 && reg)
+			print_fault_reg(ts->devid, reg);
+
+		matched = sscanf(line, "  FAULT_TLB_DATA: 0x%08x 0x%08x\n", &reg, &reg2);
+		if (matched == 2)
+			print_fault_data(ts->devid, reg, reg2);
+	}
+}
+
+static bool
+load_error_state(struct error_state *es, FILE *file)
+{
+	size_t size = 0, cap = 1 << 20, ret;
+	struct stat st;
+	char *buf;
+
+	/* Regular files are mapped, sysfs and pipes have to be read */
+	if (!fstat(fileno(file), &st) && S_ISREG(st.st_mode) && st.st_size) {
+		void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				 fileno(file), 0);
+
+		if (ptr != MAP_FAILED) {
+			es->data = ptr;
+			es->size = st.st_size;
+			es->mapped = true;
+			return true;
 		}
+	}
 
-		count++;
+	buf = malloc(cap);
+	while (buf && (ret = fread(buf + size, 1, cap - size, file)) > 0) {
+		size += ret;
+		if (size == cap) {
+			cap *= 2;
+			buf = realloc(buf, cap);
+		}
+	}
+	if (!buf)
+		return false;
 
-		if (count > data_size) {
-			data_size = data_size ? data_size * 2 : 1024;
-			data = realloc(data, data_size * sizeof (uint32_t));
-			if (data == NULL) {
-				fprintf(stderr, "Out of memory.\n");
-				exit(1);
-			}
+	es->data = buf;
+	es->size = size;
+	es->mapped = false;
+	return true;
+}
+
+static void
+read_data_file(FILE *file)
+{
+	struct error_state es = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	struct text_state ts = {
+		.devid = PCI_CHIP_I855_GM,
+	};
+	pthread_t *workers;
+	unsigned int i, n;
+
+	if (!load_error_state(&es, file)) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	index_error_state(&es);
+
+	workers = calloc(opts.jobs, sizeof(*workers));
+	for (n = 0; workers && n < opts.jobs; n++)
+		if (pthread_create(&workers[n], NULL, decode_worker, &es))
+			break;
+	if (!n) {
+		fprintf(stderr, "Failed to start the decode threads.\n");
+		exit(1);
+	}
+
+	for (i = 0; i < es.num_sections; i++) {
+		struct section *s = &es.sections[i];
+
+		if (s->type == SECTION_TEXT) {
+			print_text_section(s, &ts);
+		} else {
+			pthread_mutex_lock(&es.lock);
+			while (!s->done)
+				pthread_cond_wait(&es.cond, &es.lock);
+			pthread_mutex_unlock(&es.lock);
+
+			fwrite(s->out, 1, s->out_len, stdout);
+			free(s->out);
 		}
 
-		data[count-1] = value;
+		pthread_mutex_lock(&es.lock);
+		es.emitted = i + 1;
+		pthread_cond_broadcast(&es.cond);
+		pthread_mutex_unlock(&es.lock);
 	}
 
-	decode(decode_ctx,
-	       buffer_name, ring_name,
-	       gtt_offset, head_offset,
-	       data, &count, do_decode);
+	while (n--)
+		pthread_join(workers[n], NULL);
+	free(workers);
 
-	free(data);
-	free(line);
-	free(ring_name);
+	for (i = 0; i < es.num_ring_names; i++)
+		free(es.ring_names[i]);
+	free(es.ring_names);
+	free(es.sections);
+	free(ts.line);
+
+	if (es.mapped)
+		munmap((void *)es.data, es.size);
+	else
+		free((void *)es.data);
 }
 
 static void setup_pager(void)
@@ -800,20 +1312,57 @@ main(int argc, char *argv[])
 	const char *path;
 	char *filename = NULL;
 	struct stat st;
-	int error;
+	int error, c;
+
+	static const struct option long_options[] = {
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "engine", required_argument, NULL, 'e' },
+		{ "buffers", required_argument, NULL, 'b' },
+		{ "around", required_argument, NULL, 'a' },
+		{ }
+	};
+
+	opts.jobs = max_t(long, sysconf(_SC_NPROCESSORS_ONLN), 1);
+
+	while ((c = getopt_long(argc, argv, "j:e:b:a:",
+				long_options, NULL)) != -1) {
+		switch (c) {
+		case 'j':
+			opts.jobs = max(atoi(optarg), 1);
+			break;
+		case 'e':
+			opts.engine = optarg;
+			break;
+		case 'b':
+			opts.buffers = optarg;
+			break;
+		case 'a':
+			opts.around = max(atoi(optarg), 0);
+			break;
+		default:
+			argc = -1;
+			break;
+		}
+	}
 
-	if (argc > 2) {
+	if (argc < 0 || argc - optind > 1) {
 		fprintf(stderr,
 				"intel_gpu_decode: Parse an Intel GPU i915_error_state\n"
 				"Usage:\n"
-				"\t%s [<file>]\n"
+				"\t%s [options] [<file>]\n"
 				"\n"
 				"With no arguments, debugfs-dri-directory is probed for in "
 				"/debug and \n"
 				"/sys/kernel/debug.  Otherwise, it may be "
 				"specified.  If a file is given,\n"
 				"it is parsed as an GPU dump in the format of "
-				"/debug/dri/0/i915_error_state.\n",
+				"/debug/dri/0/i915_error_state.\n"
+				"\n"
+				"Options:\n"
+				"\t-j, --jobs=N        decode buffers on N threads\n"
+				"\t-e, --engine=NAME   only show buffers of engine NAME, e.g. rcs0\n"
+				"\t-b, --buffers=LIST  only show these buffer types, e.g. batch,ring\n"
+				"\t-a, --around=N      only decode N dwords either side of HEAD\n",
 				argv[0]);
 		return 1;
 	}
@@ -821,7 +1370,7 @@ main(int argc, char *argv[])
 	if (isatty(1))
 		setup_pager();
 
-	if (argc == 1) {
+	if (optind == argc) {
 		if (isatty(0)) {
 			path = "/sys/class/drm/card0/error";
 			error = stat(path, &st);
@@ -844,7 +1393,7 @@ main(int argc, char *argv[])
 			exit(0);
 		}
 	} else {
-		path = argv[1];
+		path = argv[optind];
 		error = stat(path, &st);
 		if (error != 0) {
 			fprintf(stderr, "Error opening %s: %s\n",
@@ -28,6 +28,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <locale.h>
@@ -47,8 +48,11 @@
 #include <sys/sysmacros.h>
 
 #include "igt_perf.h"
+#include "igt_perf_sampler.h"
 #include "igt_drm_clients.h"
 #include "igt_drm_fdinfo.h"
+#include "igt_gpu_top_record.h"
+#include "igt_gpu_top_shm.h"
 
 #define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
 
@@ -120,6 +124,11 @@ struct engines {
 
 	int num_gts;
 
+	struct igt_perf_sampler *sampler;
+	struct igt_perf_sample *sample;
+	int64_t sample_index;
+	int rapl_base, imc_base;
+
 	/* Do not edit below this line.
 	 * This structure is reallocated every time a new engine is
 	 * found and size is increased by sizeof (engine).
@@ -500,8 +509,11 @@ static void free_engines(struct engines *engines)
 		free((char *)engine->display_name);
 	}
 
-	closedir(engines->root);
+	if (engines->root)
+		closedir(engines->root);
 
+	igt_perf_sampler_destroy(engines->sampler);
+	free(engines->sample);
 	free(engines->class);
 	free(engines);
 }
@@ -664,21 +676,47 @@ static int pmu_init(struct engines *engines)
 	return 0;
 }
 
-static uint64_t pmu_read_multi(int fd, unsigned int num, uint64_t *val)
+/* Samples kept by the sampler thread, only the latest one is displayed. */
+#define SAMPLER_HISTORY 4
+
+/*
+ * Reads all the groups from a thread woken on absolute deadlines, so neither
+ * rendering nor client scanning delays or skews the counter reads.
+ */
+static int pmu_start_sampler(struct engines *engines, unsigned int period_us)
 {
-	uint64_t buf[2 + num];
-	unsigned int i;
-	ssize_t len;
+	const uint64_t format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+				PERF_FORMAT_GROUP;
+	struct igt_perf_sampler *s;
+	int ret;
 
-	memset(buf, 0, sizeof(buf));
+	s = igt_perf_sampler_create((uint64_t)period_us * 1000,
+				    SAMPLER_HISTORY);
+	if (!s)
+		return -errno;
 
-	len = read(fd, buf, sizeof(buf));
-	assert(len == sizeof(buf));
+	ret = igt_perf_sampler_add_group(s, engines->fd,
+					 engines->num_counters, format);
+	if (ret >= 0 && engines->num_rapl)
+		ret = engines->rapl_base =
+			igt_perf_sampler_add_group(s, engines->rapl_fd,
+						   engines->num_rapl, format);
+	if (ret >= 0 && engines->num_imc)
+		ret = engines->imc_base =
+			igt_perf_sampler_add_group(s, engines->imc_fd,
+						   engines->num_imc, format);
+	if (ret >= 0)
+		ret = igt_perf_sampler_start(s);
+	if (ret < 0) {
+		igt_perf_sampler_destroy(s);
+		return ret;
+	}
 
-	for (i = 0; i < num; i++)
-		val[i] = buf[2 + i];
+	engines->sampler = s;
+	engines->sample = igt_perf_sampler_alloc_sample(s);
+	engines->sample_index = -1;
 
-	return buf[1];
+	return engines->sample ? 0 : -ENOMEM;
 }
 
 static double pmu_calc(struct pmu_pair *p, double d, double t, double s)
@@ -718,29 +756,22 @@ static void update_sample(struct pmu_counter *counter, uint64_t *val)
 		__update_sample(counter, val[counter->idx]);
 }
 
-static void pmu_sample(struct engines *engines)
+/* Averages the per GT counters into the device wide ones. */
+static void update_aggregate_counters(struct engines *engines)
 {
-	const int num_val = engines->num_counters;
-	uint64_t val[2 + num_val];
 	unsigned int i;
 
-	engines->ts.prev = engines->ts.cur;
-	engines->ts.cur = pmu_read_multi(engines->fd, num_val, val);
-
 	engines->freq_req.val.cur = engines->freq_req.val.prev = 0;
 	engines->freq_act.val.cur = engines->freq_act.val.prev = 0;
 	engines->rc6.val.cur = engines->rc6.val.prev = 0;
 
 	for (i = 0; i < engines->num_gts; i++) {
-		update_sample(&engines->freq_req_gt[i], val);
 		engines->freq_req.val.cur += engines->freq_req_gt[i].val.cur;
 		engines->freq_req.val.prev += engines->freq_req_gt[i].val.prev;
 
-		update_sample(&engines->freq_act_gt[i], val);
 		engines->freq_act.val.cur += engines->freq_act_gt[i].val.cur;
 		engines->freq_act.val.prev += engines->freq_act_gt[i].val.prev;
 
-		update_sample(&engines->rc6_gt[i], val);
 		engines->rc6.val.cur += engines->rc6_gt[i].val.cur;
 		engines->rc6.val.prev += engines->rc6_gt[i].val.prev;
 	}
@@ -753,6 +784,41 @@ static void pmu_sample(struct engines *engines)
 
 	engines->rc6.val.cur /= engines->num_gts;
 	engines->rc6.val.prev /= engines->num_gts;
+}
+
+static int pmu_sample(struct engines *engines)
+{
+	struct igt_perf_sample *sample = engines->sample;
+	uint64_t *val = sample->val;
+	unsigned int i;
+	int64_t index;
+	int ret;
+
+	/* Blocks until the sampler thread took a sample not yet shown. */
+	index = igt_perf_sampler_wait(engines->sampler,
+				      engines->sample_index, -1);
+	if (index < 0) {
+		if (index != -EINTR)
+			fprintf(stderr, "Failed to sample PMU! (%s)\n",
+				strerror(-index));
+		return index;
+	}
+
+	ret = igt_perf_sampler_read(engines->sampler, index, sample);
+	if (ret)
+		return ret;
+
+	engines->sample_index = index;
+	engines->ts.prev = engines->ts.cur;
+	engines->ts.cur = sample->timestamp;
+
+	for (i = 0; i < engines->num_gts; i++) {
+		update_sample(&engines->freq_req_gt[i], val);
+		update_sample(&engines->freq_act_gt[i], val);
+		update_sample(&engines->rc6_gt[i], val);
+	}
+
+	update_aggregate_counters(engines);
 
 	update_sample(&engines->irq, val);
 
@@ -765,16 +831,18 @@ static void pmu_sample(struct engines *engines)
 	}
 
 	if (engines->num_rapl) {
-		pmu_read_multi(engines->rapl_fd, engines->num_rapl, val);
+		val = sample->val + engines->rapl_base;
 		update_sample(&engines->r_gpu, val);
 		update_sample(&engines->r_pkg, val);
 	}
 
 	if (engines->num_imc) {
-		pmu_read_multi(engines->imc_fd, engines->num_imc, val);
+		val = sample->val + engines->imc_base;
 		update_sample(&engines->imc_reads, val);
 		update_sample(&engines->imc_writes, val);
 	}
+
+	return 0;
 }
 
 static int
@@ -1051,8 +1119,13 @@ usage(const char *appname)
 		"\t[-d <device>]   Device filter, please check manual page for more details.\n"
 		"\t[-p]            Default to showing physical engines instead of classes.\n"
 		"\t[-m]            Default to showing all memory regions.\n"
+		"\t[--daemon[=<name>]]  Publish samples to shared memory (default %s).\n"
+		"\t[--attach[=<name>]]  Display samples published by a daemon.\n"
+		"\t[--record=<file>]    Also record the displayed samples to file.\n"
+		"\t[--replay=<file>]    Display the samples of a recording.\n"
+		"\t[--replay-speed=<x>] Replay speed factor, 0 for unpaced (default 1).\n"
 		"\n",
-		appname, DEFAULT_PERIOD_MS);
+		appname, DEFAULT_PERIOD_MS, IGT_GPU_TOP_SHM_NAME);
 	igt_device_print_filter_types();
 }
 
@@ -2555,8 +2628,6 @@ intel_init_clients(struct intel_clients *iclients,
 		iclients->classes.capacity[i] = engines->class[i].num_engines;
 		iclients->classes.names[i] = strdup(engines->class[i].name);
 	}
-
-	iclients->clients = igt_drm_clients_init(iclients);
 }
 
 static void intel_free_clients(struct intel_clients *iclients)
@@ -2603,12 +2674,580 @@ static void intel_scan_clients(struct intel_clients *iclients)
 	}
 }
 
+/* Samples kept by the daemon, a minute at the default period. */
+#define DAEMON_HISTORY 64
+
+static void export_counter(struct igt_gpu_top_info *info, unsigned int idx,
+			   const struct pmu_counter *pmu)
+{
+	struct igt_gpu_top_counter_info *ci = &info->counters[idx];
+
+	ci->present = pmu->present;
+	ci->scale = pmu->scale;
+	if (pmu->present && pmu->units)
+		snprintf(ci->units, sizeof(ci->units), "%s", pmu->units);
+}
+
+static void
+export_info(struct igt_gpu_top_info *info,
+	    const struct igt_device_card *card, const char *codename,
+	    struct engines *engines, const struct intel_clients *iclients)
+{
+	unsigned int i;
+
+	memset(info, 0, sizeof(*info));
+
+	snprintf(info->card, sizeof(info->card), "%s", card->card);
+	snprintf(info->codename, sizeof(info->codename), "%s",
+		 codename ?: "");
+	snprintf(info->pci_slot, sizeof(info->pci_slot), "%s",
+		 iclients->pci_slot ?: card->pci_slot_name);
+	snprintf(info->pmu_device, sizeof(info->pmu_device), "%s",
+		 engines->device);
+	info->discrete = engines->discrete;
+	info->num_gts = engines->num_gts;
+
+	export_counter(info, IGT_GPU_TOP_IRQ, &engines->irq);
+	export_counter(info, IGT_GPU_TOP_POWER_GPU, &engines->r_gpu);
+	export_counter(info, IGT_GPU_TOP_POWER_PKG, &engines->r_pkg);
+	export_counter(info, IGT_GPU_TOP_IMC_READS, &engines->imc_reads);
+	export_counter(info, IGT_GPU_TOP_IMC_WRITES, &engines->imc_writes);
+	for (i = 0; i < engines->num_gts; i++) {
+		export_counter(info, IGT_GPU_TOP_FREQ_REQ + i,
+			       &engines->freq_req_gt[i]);
+		export_counter(info, IGT_GPU_TOP_FREQ_ACT + i,
+			       &engines->freq_act_gt[i]);
+		export_counter(info, IGT_GPU_TOP_RC6 + i, &engines->rc6_gt[i]);
+	}
+
+	info->num_engines = engines->num_engines;
+	if (info->num_engines > IGT_GPU_TOP_MAX_ENGINES)
+		info->num_engines = IGT_GPU_TOP_MAX_ENGINES;
+	for (i = 0; i < info->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+		struct igt_gpu_top_engine_info *ei = &info->engines[i];
+
+		snprintf(ei->name, sizeof(ei->name), "%s", engine->name);
+		ei->class = engine->class;
+		ei->instance = engine->instance;
+		ei->present = engine->busy.present << IGT_GPU_TOP_ENGINE_BUSY |
+			      engine->wait.present << IGT_GPU_TOP_ENGINE_WAIT |
+			      engine->sema.present << IGT_GPU_TOP_ENGINE_SEMA;
+	}
+
+	info->num_classes = engines->num_classes;
+	if (info->num_classes > IGT_GPU_TOP_MAX_CLASSES)
+		info->num_classes = IGT_GPU_TOP_MAX_CLASSES;
+	for (i = 0; i < info->num_classes; i++)
+		snprintf(info->classes[i], sizeof(info->classes[i]), "%s",
+			 engines->class[i].name);
+
+	info->num_regions = ARRAY_SIZE(memory_region_map);
+	for (i = 0; i < info->num_regions; i++)
+		snprintf(info->regions[i], sizeof(info->regions[i]), "%s",
+			 memory_region_map[i]);
+}
+
+static void export_client(struct igt_gpu_top_client *sc,
+			  const struct igt_drm_client *c)
+{
+	unsigned int i;
+
+	memset(sc, 0, sizeof(*sc));
+
+	sc->id = c->id;
+	sc->pid = c->pid;
+	sc->drm_minor = c->drm_minor;
+	sc->num_regions = c->regions->num_regions;
+	snprintf(sc->name, sizeof(sc->name), "%s", c->print_name);
+
+	for (i = 0; i <= c->engines->max_engine_id &&
+		    i < IGT_GPU_TOP_MAX_CLASSES; i++)
+		sc->engine_time[i] = c->utilization[i].last_engine_time;
+
+	for (i = 0; i <= c->regions->max_region_id &&
+		    i < IGT_GPU_TOP_MAX_REGIONS; i++) {
+		sc->memory[i].total = c->memory[i].total;
+		sc->memory[i].shared = c->memory[i].shared;
+		sc->memory[i].resident = c->memory[i].resident;
+		sc->memory[i].purgeable = c->memory[i].purgeable;
+		sc->memory[i].active = c->memory[i].active;
+	}
+}
+
+/* Fills in everything but the index, which the shm or recording assigns. */
+static void export_sample(struct igt_gpu_top_sample *sample,
+			  struct engines *engines,
+			  const struct intel_clients *iclients)
+{
+	uint64_t *counters = sample->counters;
+	struct igt_drm_client *c;
+	unsigned int i, num = 0;
+	struct timespec now;
+	int tmp;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	sample->timestamp = engines->ts.cur;
+	sample->realtime = now.tv_sec * (uint64_t)NSEC_PER_SEC + now.tv_nsec;
+
+	counters[IGT_GPU_TOP_IRQ] = engines->irq.val.cur;
+	counters[IGT_GPU_TOP_POWER_GPU] = engines->r_gpu.val.cur;
+	counters[IGT_GPU_TOP_POWER_PKG] = engines->r_pkg.val.cur;
+	counters[IGT_GPU_TOP_IMC_READS] = engines->imc_reads.val.cur;
+	counters[IGT_GPU_TOP_IMC_WRITES] = engines->imc_writes.val.cur;
+	for (i = 0; i < engines->num_gts; i++) {
+		counters[IGT_GPU_TOP_FREQ_REQ + i] = engines->freq_req_gt[i].val.cur;
+		counters[IGT_GPU_TOP_FREQ_ACT + i] = engines->freq_act_gt[i].val.cur;
+		counters[IGT_GPU_TOP_RC6 + i] = engines->rc6_gt[i].val.cur;
+	}
+
+	for (i = 0; i < engines->num_engines &&
+		    i < IGT_GPU_TOP_MAX_ENGINES; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		sample->engines[i][IGT_GPU_TOP_ENGINE_BUSY] = engine->busy.val.cur;
+		sample->engines[i][IGT_GPU_TOP_ENGINE_WAIT] = engine->wait.val.cur;
+		sample->engines[i][IGT_GPU_TOP_ENGINE_SEMA] = engine->sema.val.cur;
+	}
+
+	if (iclients->clients) {
+		igt_for_each_drm_client(iclients->clients, c, tmp) {
+			if (c->status != IGT_DRM_CLIENT_ALIVE)
+				continue;
+			if (num == IGT_GPU_TOP_MAX_CLIENTS)
+				break;
+
+			export_client(&sample->clients[num++], c);
+		}
+	}
+	sample->num_clients = num;
+}
+
+static void record_sample(struct igt_gpu_top_record *rec,
+			  const struct igt_gpu_top_sample *sample)
+{
+	int ret = igt_gpu_top_record_write(rec, sample);
+
+	if (ret) {
+		fprintf(stderr, "Failed to write recording! (%s)\n",
+			strerror(-ret));
+		stop_top = true;
+	}
+}
+
+/*
+ * Headless mode: keep sampling like the interactive loop does, but publish
+ * the raw counters for any number of viewers instead of printing them.
+ */
+static int run_daemon(const char *name, const struct igt_device_card *card,
+		      const char *codename, struct engines *engines,
+		      struct intel_clients *iclients, unsigned int period_us,
+		      struct igt_gpu_top_record *rec)
+{
+	struct igt_gpu_top_sample *sample;
+	struct igt_gpu_top_info info;
+	struct igt_gpu_top_shm *shm;
+
+	export_info(&info, card, codename, engines, iclients);
+
+	shm = igt_gpu_top_shm_create(name, &info, DAEMON_HISTORY,
+				     (uint64_t)period_us * 1000);
+	if (!shm) {
+		fprintf(stderr, "Failed to create shared memory %s! (%s)\n",
+			name, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	while (!stop_top) {
+		if (pmu_sample(engines))
+			break;
+		intel_scan_clients(iclients);
+
+		sample = igt_gpu_top_shm_begin(shm);
+		export_sample(sample, engines, iclients);
+		if (rec)
+			record_sample(rec, sample);
+		igt_gpu_top_shm_commit(shm);
+	}
+
+	igt_gpu_top_shm_destroy(shm, name);
+
+	return EXIT_SUCCESS;
+}
+
+struct shm_view {
+	const struct igt_gpu_top_shm *shm; /* Or replay. */
+	struct igt_gpu_top_replay *replay;
+	double speed; /* Of the replay, as fast as possible if not positive. */
+	uint64_t deadline; /* Of the next replayed sample, ns. */
+	int64_t index; /* Latest sample displayed. */
+	struct igt_drm_client_regions regions;
+	struct igt_gpu_top_sample prev, cur;
+};
+
+static void import_counter(struct pmu_counter *pmu,
+			   const struct igt_gpu_top_counter_info *ci)
+{
+	pmu->present = ci->present;
+	pmu->scale = ci->scale;
+	if (pmu->present && ci->units[0]) {
+		pmu->units = strndup(ci->units, sizeof(ci->units));
+		assert(pmu->units);
+	}
+}
+
+/* Rebuilds the engine list of the daemon, without opening any PMU. */
+static struct engines *view_engines(const struct igt_gpu_top_info *info)
+{
+	unsigned int num_engines = info->num_engines;
+	struct engines *engines;
+	unsigned int i;
+	int ret;
+
+	if (num_engines > IGT_GPU_TOP_MAX_ENGINES)
+		num_engines = IGT_GPU_TOP_MAX_ENGINES;
+
+	engines = calloc(1, sizeof(struct engines) +
+			    num_engines * sizeof(struct engine));
+	assert(engines);
+
+	engines->num_engines = num_engines;
+	engines->fd = engines->rapl_fd = engines->imc_fd = -1;
+	engines->discrete = info->discrete;
+	engines->num_gts = info->num_gts;
+	if (engines->num_gts < 1 || engines->num_gts > MAX_GTS)
+		engines->num_gts = 1;
+
+	import_counter(&engines->irq, &info->counters[IGT_GPU_TOP_IRQ]);
+	import_counter(&engines->r_gpu, &info->counters[IGT_GPU_TOP_POWER_GPU]);
+	import_counter(&engines->r_pkg, &info->counters[IGT_GPU_TOP_POWER_PKG]);
+	import_counter(&engines->imc_reads,
+		       &info->counters[IGT_GPU_TOP_IMC_READS]);
+	import_counter(&engines->imc_writes,
+		       &info->counters[IGT_GPU_TOP_IMC_WRITES]);
+	engines->num_rapl = engines->r_gpu.present + engines->r_pkg.present;
+	engines->num_imc = engines->imc_reads.present +
+			   engines->imc_writes.present;
+
+	init_aggregate_counters(engines);
+	for (i = 0; i < engines->num_gts; i++) {
+		import_counter(&engines->freq_req_gt[i],
+			       &info->counters[IGT_GPU_TOP_FREQ_REQ + i]);
+		import_counter(&engines->freq_act_gt[i],
+			       &info->counters[IGT_GPU_TOP_FREQ_ACT + i]);
+		import_counter(&engines->rc6_gt[i],
+			       &info->counters[IGT_GPU_TOP_RC6 + i]);
+	}
+
+	for (i = 0; i < num_engines; i++) {
+		const struct igt_gpu_top_engine_info *ei = &info->engines[i];
+		struct engine *engine = engine_ptr(engines, i);
+
+		engine->name = strndup(ei->name, sizeof(ei->name));
+		assert(engine->name);
+		engine->class = ei->class;
+		engine->instance = ei->instance;
+
+		ret = asprintf(&engine->display_name, "%s/%u",
+			       class_display_name(engine->class),
+			       engine->instance);
+		assert(ret > 0);
+		ret = asprintf(&engine->short_name, "%s/%u",
+			       class_short_name(engine->class),
+			       engine->instance);
+		assert(ret > 0);
+
+		engine->busy.present = ei->present & 1 << IGT_GPU_TOP_ENGINE_BUSY;
+		engine->wait.present = ei->present & 1 << IGT_GPU_TOP_ENGINE_WAIT;
+		engine->sema.present = ei->present & 1 << IGT_GPU_TOP_ENGINE_SEMA;
+		engine->num_counters = engine->busy.present +
+				       engine->wait.present +
+				       engine->sema.present;
+	}
+
+	return engines;
+}
+
+static void view_counter(struct pmu_counter *pmu,
+			 const struct shm_view *view, unsigned int idx)
+{
+	if (pmu->present) {
+		pmu->val.prev = view->prev.counters[idx];
+		pmu->val.cur = view->cur.counters[idx];
+	}
+}
+
+static void view_engine_counter(struct pmu_counter *pmu,
+				const struct shm_view *view,
+				unsigned int engine, unsigned int idx)
+{
+	if (pmu->present) {
+		pmu->val.prev = view->prev.engines[engine][idx];
+		pmu->val.cur = view->cur.engines[engine][idx];
+	}
+}
+
+static const struct igt_gpu_top_client *
+view_find_client(const struct igt_gpu_top_sample *sample,
+		 const struct igt_gpu_top_client *sc)
+{
+	unsigned int i;
+
+	for (i = 0; i < sample->num_clients &&
+		    i < IGT_GPU_TOP_MAX_CLIENTS; i++) {
+		if (sample->clients[i].id == sc->id &&
+		    sample->clients[i].drm_minor == sc->drm_minor)
+			return &sample->clients[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Clients are rebuilt from the two samples on every update, allocated like
+ * display_clients() does so free_display_clients() releases them.
+ */
+static void view_clients(struct shm_view *view, struct intel_clients *iclients)
+{
+	struct igt_drm_client_engines *classes = &iclients->classes;
+	unsigned int num = view->cur.num_clients;
+	struct igt_drm_clients *clients;
+	unsigned int i, j;
+
+	if (num > IGT_GPU_TOP_MAX_CLIENTS)
+		num = IGT_GPU_TOP_MAX_CLIENTS;
+
+	if (iclients->clients)
+		free_display_clients(iclients->clients);
+
+	clients = calloc(1, sizeof(*clients));
+	assert(clients);
+	clients->client = calloc(num ?: 1, sizeof(*clients->client));
+	assert(clients->client);
+	clients->private_data = iclients;
+
+	view->regions.num_regions = 0;
+
+	for (i = 0; i < num; i++) {
+		const struct igt_gpu_top_client *sc = &view->cur.clients[i];
+		const struct igt_gpu_top_client *sp =
+			view_find_client(&view->prev, sc);
+		struct igt_drm_client *c = &clients->client[i];
+		int len;
+
+		c->clients = clients;
+		c->status = IGT_DRM_CLIENT_ALIVE;
+		c->engines = classes;
+		c->regions = &view->regions;
+		c->id = sc->id;
+		c->drm_minor = sc->drm_minor;
+		c->pid = sc->pid;
+		c->samples = sp ? 2 : 1;
+		c->utilization_mask = IGT_DRM_CLIENT_UTILIZATION_ENGINE_TIME;
+
+		len = snprintf(c->pid_str, sizeof(c->pid_str), "%u", c->pid);
+		if (len > clients->max_pid_len)
+			clients->max_pid_len = len;
+
+		snprintf(c->name, sizeof(c->name), "%.*s",
+			 (int)sizeof(sc->name), sc->name);
+		strcpy(c->print_name, c->name);
+		len = strlen(c->print_name);
+		if (len > clients->max_name_len)
+			clients->max_name_len = len;
+
+		c->utilization = calloc(classes->max_engine_id + 1,
+					sizeof(*c->utilization));
+		assert(c->utilization);
+		for (j = 0; j <= classes->max_engine_id &&
+			    j < IGT_GPU_TOP_MAX_CLASSES; j++) {
+			struct igt_drm_client_utilization *u = &c->utilization[j];
+
+			u->last_engine_time = sc->engine_time[j];
+			c->total_engine_time += u->last_engine_time;
+
+			if (sp && sc->engine_time[j] > sp->engine_time[j]) {
+				u->delta_engine_time = sc->engine_time[j] -
+						       sp->engine_time[j];
+				c->agg_delta_engine_time += u->delta_engine_time;
+			}
+		}
+
+		c->memory = calloc(view->regions.max_region_id + 1,
+				   sizeof(c->memory[0]));
+		assert(c->memory);
+		for (j = 0; j <= view->regions.max_region_id; j++) {
+			c->memory[j].total = sc->memory[j].total;
+			c->memory[j].shared = sc->memory[j].shared;
+			c->memory[j].resident = sc->memory[j].resident;
+			c->memory[j].purgeable = sc->memory[j].purgeable;
+			c->memory[j].active = sc->memory[j].active;
+		}
+
+		if (sc->num_regions > view->regions.num_regions)
+			view->regions.num_regions = sc->num_regions;
+	}
+
+	clients->num_clients = num;
+	clients->active_clients = num;
+
+	iclients->clients = clients;
+	iclients->regions = view->regions.num_regions ? &view->regions : NULL;
+}
+
+/*
+ * Waits for a sample newer than the one displayed and loads it, together
+ * with the one before, as the previous and current samples.
+ */
+static bool view_wait_shm(struct shm_view *view)
+{
+	const struct igt_gpu_top_shm *shm = view->shm;
+	int64_t latest;
+
+	for (;;) {
+		if (stop_top)
+			return false;
+
+		latest = igt_gpu_top_shm_latest(shm);
+		if (latest > view->index && latest > 0 &&
+		    !igt_gpu_top_shm_read(shm, latest - 1, &view->prev) &&
+		    !igt_gpu_top_shm_read(shm, latest, &view->cur))
+			break;
+
+		if (kill(shm->pid, 0) && errno == ESRCH) {
+			fprintf(stderr, "Daemon %u has exited!\n", shm->pid);
+			return false;
+		}
+
+		usleep(10000);
+	}
+
+	view->index = latest;
+
+	return true;
+}
+
+/*
+ * Steps to the next sample of a recording, waiting for as long as it took
+ * when recorded, scaled by the replay speed.
+ */
+static bool view_next_replay(struct shm_view *view)
+{
+	struct timespec ts;
+	int ret;
+
+	if (view->index < 0) {
+		ret = igt_gpu_top_replay_next(view->replay, &view->cur);
+		if (ret)
+			goto err;
+	}
+
+	view->prev = view->cur;
+	ret = igt_gpu_top_replay_next(view->replay, &view->cur);
+	if (ret)
+		goto err;
+
+	view->index = view->cur.index;
+
+	if (view->speed <= 0)
+		return true;
+
+	if (!view->deadline) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		view->deadline = ts.tv_sec * (uint64_t)NSEC_PER_SEC + ts.tv_nsec;
+	}
+	view->deadline += (view->cur.timestamp - view->prev.timestamp) /
+			  view->speed;
+
+	ts.tv_sec = view->deadline / NSEC_PER_SEC;
+	ts.tv_nsec = view->deadline % NSEC_PER_SEC;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR &&
+	       !stop_top)
+		;
+
+	return !stop_top;
+
+err:
+	if (ret != -ENODATA)
+		fprintf(stderr, "Failed to read recording! (%s)\n",
+			strerror(-ret));
+	return false;
+}
+
+/*
+ * Loads the next sample to display from the daemon or the recording, as the
+ * current counter values, with the one before as the previous ones.
+ */
+static bool view_sample(struct shm_view *view, struct engines *engines,
+			struct intel_clients *iclients, unsigned int *scan_us)
+{
+	unsigned int i;
+
+	if (view->replay ? !view_next_replay(view) : !view_wait_shm(view))
+		return false;
+
+	engines->ts.prev = view->prev.timestamp;
+	engines->ts.cur = view->cur.timestamp;
+
+	view_counter(&engines->irq, view, IGT_GPU_TOP_IRQ);
+	view_counter(&engines->r_gpu, view, IGT_GPU_TOP_POWER_GPU);
+	view_counter(&engines->r_pkg, view, IGT_GPU_TOP_POWER_PKG);
+	view_counter(&engines->imc_reads, view, IGT_GPU_TOP_IMC_READS);
+	view_counter(&engines->imc_writes, view, IGT_GPU_TOP_IMC_WRITES);
+	for (i = 0; i < engines->num_gts; i++) {
+		view_counter(&engines->freq_req_gt[i], view,
+			     IGT_GPU_TOP_FREQ_REQ + i);
+		view_counter(&engines->freq_act_gt[i], view,
+			     IGT_GPU_TOP_FREQ_ACT + i);
+		view_counter(&engines->rc6_gt[i], view, IGT_GPU_TOP_RC6 + i);
+	}
+	update_aggregate_counters(engines);
+
+	for (i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		view_engine_counter(&engine->busy, view, i,
+				    IGT_GPU_TOP_ENGINE_BUSY);
+		view_engine_counter(&engine->wait, view, i,
+				    IGT_GPU_TOP_ENGINE_WAIT);
+		view_engine_counter(&engine->sema, view, i,
+				    IGT_GPU_TOP_ENGINE_SEMA);
+	}
+
+	*scan_us = (view->cur.timestamp - view->prev.timestamp) / 1000;
+	view_clients(view, iclients);
+
+	return true;
+}
+
+enum {
+	OPT_DAEMON = 256,
+	OPT_ATTACH,
+	OPT_RECORD,
+	OPT_REPLAY,
+	OPT_REPLAY_SPEED,
+};
+
 int main(int argc, char **argv)
 {
+	static const struct option long_options[] = {
+		{ "daemon", optional_argument, NULL, OPT_DAEMON },
+		{ "attach", optional_argument, NULL, OPT_ATTACH },
+		{ "record", required_argument, NULL, OPT_RECORD },
+		{ "replay", required_argument, NULL, OPT_REPLAY },
+		{ "replay-speed", required_argument, NULL, OPT_REPLAY_SPEED },
+		{ }
+	};
 	unsigned int period_us = DEFAULT_PERIOD_MS * 1000;
+	const char *daemon_name = NULL, *attach_name = NULL;
+	const char *record_path = NULL, *replay_path = NULL;
+	struct igt_gpu_top_record *rec = NULL;
+	struct igt_gpu_top_sample *rec_sample = NULL;
+	double replay_speed = 1.0;
 	bool physical_engines = false;
 	bool separate_regions = false;
-	struct intel_clients iclients;
+	struct intel_clients iclients = { };
+	struct shm_view *view = NULL;
 	int con_w = -1, con_h = -1;
 	char *output_path = NULL;
 	struct engines *engines;
@@ -2620,8 +3259,24 @@ int main(int argc, char **argv)
 	struct timespec ts;
 
 	/* Parse options */
-	while ((ch = getopt(argc, argv, "o:s:d:mpcJLlh")) != -1) {
+	while ((ch = getopt_long(argc, argv, "o:s:d:mpcJLlh",
+				 long_options, NULL)) != -1) {
 		switch (ch) {
+		case OPT_DAEMON:
+			daemon_name = optarg ?: IGT_GPU_TOP_SHM_NAME;
+			break;
+		case OPT_ATTACH:
+			attach_name = optarg ?: IGT_GPU_TOP_SHM_NAME;
+			break;
+		case OPT_RECORD:
+			record_path = optarg;
+			break;
+		case OPT_REPLAY:
+			replay_path = optarg;
+			break;
+		case OPT_REPLAY_SPEED:
+			replay_speed = atof(optarg);
+			break;
 		case 'o':
 			output_path = optarg;
 			break;
@@ -2659,7 +3314,13 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (output_mode == INTERACTIVE && (output_path || isatty(1) != 1))
+	if (!!daemon_name + !!attach_name + !!replay_path > 1) {
+		fprintf(stderr, "--daemon, --attach and --replay are mutually exclusive!\n");
+		exit(1);
+	}
+
+	if (output_mode == INTERACTIVE &&
+	    (output_path || daemon_name || isatty(1) != 1))
 		output_mode = TEXT;
 
 	if (output_path && strcmp(output_path, "-")) {
@@ -2676,7 +3337,8 @@ int main(int argc, char **argv)
 
 	text_header_repeat = output_mode == TEXT && isatty(fileno(out));
 
-	if (signal(SIGINT, sigint_handler) == SIG_ERR)
+	if (signal(SIGINT, sigint_handler) == SIG_ERR ||
+	    (daemon_name && signal(SIGTERM, sigint_handler) == SIG_ERR))
 		fprintf(stderr, "Failed to install signal handler!\n");
 
 	class_view = !physical_engines;
@@ -2701,6 +3363,55 @@ int main(int argc, char **argv)
 		break;
 	};
 
+	if (attach_name || replay_path) {
+		const struct igt_gpu_top_info *info;
+
+		view = calloc(1, sizeof(*view));
+		assert(view);
+		view->index = -1;
+		view->speed = replay_speed;
+
+		if (replay_path) {
+			view->replay = igt_gpu_top_replay_open(replay_path);
+			if (!view->replay) {
+				fprintf(stderr, "Failed to open recording %s! (%s)\n",
+					replay_path, strerror(errno));
+				free(view);
+				ret = EXIT_FAILURE;
+				goto exit;
+			}
+			info = &igt_gpu_top_replay_header(view->replay)->info;
+		} else {
+			view->shm = igt_gpu_top_shm_attach(attach_name);
+			if (!view->shm || view->shm->history < 2) {
+				fprintf(stderr, "Failed to attach to %s! (%s)\n",
+					attach_name,
+					view->shm ? "history too short" :
+						    strerror(errno));
+				igt_gpu_top_shm_detach(view->shm);
+				free(view);
+				ret = EXIT_FAILURE;
+				goto exit;
+			}
+			info = &view->shm->info;
+		}
+
+		memset(&card, 0, sizeof(card));
+		snprintf(card.card, sizeof(card.card), "%s", info->card);
+		snprintf(card.pci_slot_name, sizeof(card.pci_slot_name), "%s",
+			 info->pci_slot);
+		codename = strndup(info->codename, sizeof(info->codename));
+		pmu_device = strndup(info->pmu_device, sizeof(info->pmu_device));
+
+		view->regions.max_region_id = info->num_regions ?
+					      info->num_regions - 1 : 0;
+		if (view->regions.max_region_id >= IGT_GPU_TOP_MAX_REGIONS)
+			view->regions.max_region_id = IGT_GPU_TOP_MAX_REGIONS - 1;
+
+		engines = view_engines(info);
+		goto init;
+	}
+
 	igt_devices_scan();
 
 	if (list_device) {
@@ -2748,6 +3459,11 @@ int main(int argc, char **argv)
 	}
 
 	ret = pmu_init(engines);
+	if (!ret) {
+		ret = pmu_start_sampler(engines, period_us);
+		if (ret)
+			errno = -ret;
+	}
 	if (ret) {
 		fprintf(stderr,
 			"Failed to initialize PMU! (%s)\n", strerror(errno));
@@ -2764,15 +3480,53 @@ int main(int argc, char **argv)
 		goto err_pmu;
 	}
 
+init:
 	ret = EXIT_SUCCESS;
 
 	init_engine_classes(engines);
 
-	if (has_drm_fdinfo(&card))
+	if (view) {
+		intel_init_clients(&iclients, &card, engines);
+	} else if (has_drm_fdinfo(&card)) {
 		intel_init_clients(&iclients, &card, engines);
+		iclients.clients = igt_drm_clients_init(&iclients);
+	}
+
+	if (record_path) {
+		struct igt_gpu_top_info info;
+		uint64_t period_ns = (uint64_t)period_us * 1000;
 
-	pmu_sample(engines);
-	intel_scan_clients(&iclients);
+		if (view && view->replay) {
+			info = igt_gpu_top_replay_header(view->replay)->info;
+			period_ns = igt_gpu_top_replay_header(view->replay)->period_ns;
+		} else if (view) {
+			info = view->shm->info;
+			period_ns = view->shm->period_ns;
+		} else {
+			export_info(&info, &card, codename, engines, &iclients);
+			rec_sample = malloc(sizeof(*rec_sample));
+			assert(rec_sample);
+		}
+
+		rec = igt_gpu_top_record_create(record_path, &info, period_ns);
+		if (!rec) {
+			fprintf(stderr, "Failed to create recording %s! (%s)\n",
+				record_path, strerror(errno));
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	if (daemon_name) {
+		ret = run_daemon(daemon_name, &card, codename, engines,
+				 &iclients, period_us, rec);
+		goto out;
+	}
+
+	if (!view) {
+		pmu_sample(engines);
+		intel_scan_clients(&iclients);
+	}
 	gettime(&ts);
 
 	if (output_mode == JSON)
@@ -2800,12 +3554,25 @@ int main(int argc, char **argv)
 			}
 		}
 
-		pmu_sample(engines);
+		if (view) {
+			if (!view_sample(view, engines, &iclients, &scan_us))
+				break;
+		} else {
+			if (pmu_sample(engines))
+				break;
+			intel_scan_clients(&iclients);
+			scan_us = elapsed_us(&ts, period_us);
+		}
 		t = (double)(engines->ts.cur - engines->ts.prev) / 1e9;
 
-		intel_scan_clients(&iclients);
+		if (rec && view) {
+			record_sample(rec, &view->cur);
+		} else if (rec) {
+			export_sample(rec_sample, engines, &iclients);
+			record_sample(rec, rec_sample);
+		}
+
 		disp_clients = display_clients(iclients.clients);
-		scan_us = elapsed_us(&ts, period_us);
 
 		if (stop_top)
 			break;
@@ -2861,15 +3628,30 @@ int main(int argc, char **argv)
 		if (stop_top)
 			break;
 
+		/* Otherwise the sampler, daemon or replay paces the loop. */
 		if (output_mode == INTERACTIVE)
-			process_stdin(period_us);
-		else
-			usleep(period_us);
+			process_stdin(view ? 0 : period_us);
 	}
 
 	if (output_mode == JSON)
 		printf("]\n");
 
+out:
+	if (igt_gpu_top_record_close(rec)) {
+		fprintf(stderr, "Failed to write recording %s!\n", record_path);
+		ret = EXIT_FAILURE;
+	}
+	free(rec_sample);
+
+	if (view) {
+		if (iclients.clients)
+			free_display_clients(iclients.clients);
+		iclients.clients = NULL;
+		igt_gpu_top_shm_detach(view->shm);
+		igt_gpu_top_replay_close(view->replay);
+		free(view);
+	}
+
 	intel_free_clients(&iclients);
 
 	free(codename);
@@ -2878,6 +3660,7 @@ err_pmu:
 err_engines:
 	free(pmu_device);
 exit:
-	igt_devices_free();
+	if (!attach_name && !replay_path) /* Devices are not scanned then. */
+		igt_devices_free();
 	return ret;
 }
@@ -18,6 +18,7 @@
 #include <unistd.h>
 
 #include "igt_core.h"
+#include "igt_trace_writer.h"
 #include "intel_chipset.h"
 #include "xe/xe_oa.h"
 #include "xe/xe_oa_data_reader.h"
@@ -35,7 +36,16 @@ usage(void)
 	       "     --counters, -c c1,c2,...  List of counters to display values for.\n"
 	       "                               Use 'all' to display all counters.\n"
 	       "                               Use 'list' to list available counters.\n"
-	       "     --reports, -r             Print out data per report.\n");
+	       "     --reports, -r             Print out data per report.\n"
+	       "     --index,   -i             Read through <file>.idx, creating it if needed.\n"
+	       "     --busy,    -b             Print per context busy time.\n"
+	       "     --start,   -s <ts>        Only look at data after CPU timestamp <ts>.\n"
+	       "     --end,     -e <ts>        Only look at data before CPU timestamp <ts>.\n"
+	       "     --trace,   -t <path>      Write the counters, context switches and\n"
+	       "                               correlation points to a trace for\n"
+	       "                               ui.perfetto.dev instead of printing them.\n"
+	       "                               Without --counters, all counters are traced.\n"
+	       "     --trace-format, -f <fmt>  Trace format: json (default) or perfetto.\n");
 }
 
 static struct intel_xe_perf_logical_counter *
@@ -183,6 +193,112 @@ print_report_deltas(const struct intel_xe_perf_data_reader *reader,
 	}
 }
 
+static double
+read_counter(const struct intel_xe_perf_data_reader *reader,
+	     const struct intel_xe_perf_logical_counter *counter,
+	     uint64_t *deltas)
+{
+	switch (counter->storage) {
+	case INTEL_XE_PERF_LOGICAL_COUNTER_STORAGE_UINT64:
+	case INTEL_XE_PERF_LOGICAL_COUNTER_STORAGE_UINT32:
+	case INTEL_XE_PERF_LOGICAL_COUNTER_STORAGE_BOOL32:
+		return counter->read_uint64(reader->perf, reader->metric_set, deltas);
+	case INTEL_XE_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
+	case INTEL_XE_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
+		return counter->read_float(reader->perf, reader->metric_set, deltas);
+	}
+
+	return 0;
+}
+
+/*
+ * Streams the recording between cpu_ts_start & cpu_ts_end into a trace,
+ * one report pair at a time.
+ */
+static bool
+write_trace(const struct intel_xe_perf_data_reader *reader,
+	    const struct intel_device_info *devinfo,
+	    struct intel_xe_perf_logical_counter **counters, uint32_t n_counters,
+	    uint64_t cpu_ts_start, uint64_t cpu_ts_end,
+	    int fd, enum igt_trace_format format)
+{
+	struct igt_trace_writer *writer;
+	uint32_t contexts_track, correlations_track, *counter_tracks;
+	char name[128];
+	uint32_t i;
+
+	counter_tracks = calloc(n_counters, sizeof(*counter_tracks));
+	if (!counter_tracks)
+		return false;
+
+	snprintf(name, sizeof(name), "%s %s",
+		 devinfo->codename, reader->metric_set->symbol_name);
+	writer = igt_trace_writer_create(fd, format, name);
+	if (!writer) {
+		free(counter_tracks);
+		return false;
+	}
+
+	contexts_track = igt_trace_writer_add_track(writer, "Contexts",
+						    IGT_TRACE_TRACK_SLICES);
+	correlations_track = igt_trace_writer_add_track(writer, "CPU/GPU correlations",
+							IGT_TRACE_TRACK_SLICES);
+	for (uint32_t c = 0; c < n_counters; c++)
+		counter_tracks[c] = igt_trace_writer_add_track(writer,
+							       counters[c]->symbol_name,
+							       IGT_TRACE_TRACK_COUNTER);
+
+	for (i = 0; i < reader->n_correlations; i++) {
+		const struct intel_xe_perf_record_timestamp_correlation *corr =
+			reader->correlations[i];
+
+		if (corr->cpu_timestamp < cpu_ts_start || corr->cpu_timestamp >= cpu_ts_end)
+			continue;
+
+		snprintf(name, sizeof(name), "gpu_ts=0x%" PRIx64, corr->gpu_timestamp);
+		igt_trace_writer_instant(writer, correlations_track, name,
+					 corr->cpu_timestamp);
+	}
+
+	for (i = intel_xe_perf_data_reader_find_timeline(reader, cpu_ts_start);
+	     i < reader->n_timelines; i++) {
+		struct intel_xe_perf_timeline_item item;
+
+		intel_xe_perf_data_reader_get_timeline(reader, i, &item);
+		if (item.cpu_ts_start >= cpu_ts_end)
+			break;
+		if (item.hw_id == 0xffffffff)
+			continue;
+
+		snprintf(name, sizeof(name), "hw_id=0x%x", item.hw_id);
+		igt_trace_writer_slice(writer, contexts_track, name, item.cpu_ts_start,
+				       item.cpu_ts_end - item.cpu_ts_start);
+	}
+
+	/* Each delta is shown from the report it starts at. */
+	for (i = intel_xe_perf_data_reader_find_record(reader, cpu_ts_start);
+	     i + 1 < reader->n_records; i++) {
+		struct intel_xe_perf_accumulator accu;
+		uint64_t cpu_ts = intel_xe_perf_data_reader_get_record_cpu_ts(reader, i);
+
+		if (cpu_ts >= cpu_ts_end)
+			break;
+
+		intel_xe_perf_accumulate_reports(&accu,
+						 reader->perf, reader->metric_set,
+						 intel_xe_perf_data_reader_get_record(reader, i),
+						 intel_xe_perf_data_reader_get_record(reader, i + 1));
+		for (uint32_t c = 0; c < n_counters; c++)
+			igt_trace_writer_counter(writer, counter_tracks[c], cpu_ts,
+						 read_counter(reader, counters[c],
+							      accu.deltas));
+	}
+
+	free(counter_tracks);
+
+	return igt_trace_writer_close(writer) == 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -190,17 +306,25 @@ main(int argc, char *argv[])
 		{"help",             no_argument, 0, 'h'},
 		{"counters",   required_argument, 0, 'c'},
 		{"reports",          no_argument, 0, 'r'},
+		{"index",            no_argument, 0, 'i'},
+		{"busy",             no_argument, 0, 'b'},
+		{"start",      required_argument, 0, 's'},
+		{"end",        required_argument, 0, 'e'},
+		{"trace",      required_argument, 0, 't'},
+		{"trace-format", required_argument, 0, 'f'},
 		{0, 0, 0, 0}
 	};
 	struct intel_xe_perf_data_reader reader;
 	struct intel_xe_perf_logical_counter **counters;
 	const struct intel_device_info *devinfo;
-	const char *counter_names = NULL;
+	const char *counter_names = NULL, *trace_path = NULL;
+	enum igt_trace_format trace_format = IGT_TRACE_FORMAT_JSON;
+	uint64_t cpu_ts_start = 0, cpu_ts_end = UINT64_MAX;
 	int32_t n_counters;
-	int fd, opt;
-	bool print_reports = false;
+	int fd = -1, opt, ret = EXIT_SUCCESS;
+	bool print_reports = false, use_index = false, print_busy = false;
 
-	while ((opt = getopt_long(argc, argv, "hc:r", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:ribs:e:t:f:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage();
@@ -211,6 +335,27 @@ main(int argc, char *argv[])
 		case 'r':
 			print_reports = true;
 			break;
+		case 'i':
+			use_index = true;
+			break;
+		case 'b':
+			print_busy = true;
+			break;
+		case 's':
+			cpu_ts_start = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			cpu_ts_end = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			trace_path = optarg;
+			break;
+		case 'f':
+			if (igt_trace_format_parse(optarg, &trace_format)) {
+				fprintf(stderr, "Unknown trace format '%s'.\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -224,22 +369,36 @@ main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	fd = open(argv[optind], 0, O_RDONLY);
-	if (fd < 0) {
-		fprintf(stderr, "Cannot open '%s': %s.\n",
-			argv[optind], strerror(errno));
-		return EXIT_FAILURE;
+	if (use_index) {
+		if (!intel_xe_perf_data_reader_init_cached(&reader, argv[optind])) {
+			fprintf(stderr, "Unable to parse '%s': %s.\n",
+				argv[optind], reader.error_msg);
+			return EXIT_FAILURE;
+		}
+	} else {
+		fd = open(argv[optind], 0, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "Cannot open '%s': %s.\n",
+				argv[optind], strerror(errno));
+			return EXIT_FAILURE;
+		}
 	}
 
-	if (!intel_xe_perf_data_reader_init(&reader, fd)) {
+	if (fd >= 0 && !intel_xe_perf_data_reader_init(&reader, fd)) {
 		fprintf(stderr, "Unable to parse '%s': %s.\n",
 			argv[optind], reader.error_msg);
 		return EXIT_FAILURE;
 	}
 
-	counters = get_logical_counters(reader.metric_set, counter_names, &n_counters);
-	if (n_counters < 0)
+	counters = get_logical_counters(reader.metric_set,
+					counter_names ?: (trace_path ? "all" : NULL),
+					&n_counters);
+	if (n_counters < 0) {
+		/* Either the counters were listed or one was unknown */
+		if (!counter_names || strcmp(counter_names, "list"))
+			ret = EXIT_FAILURE;
 		goto exit;
+	}
 
 	devinfo = intel_get_device_info(reader.devinfo.devid);
 
@@ -255,7 +414,8 @@ main(int argc, char *argv[])
 
 	if (reader.n_correlations < 2) {
 		fprintf(stderr, "Less than 2 CPU/GPU timestamp correlation points.\n");
-		return EXIT_FAILURE;
+		ret = EXIT_FAILURE;
+		goto exit;
 	}
 
 	fprintf(stdout, "Timestamp correlation CPU range:       0x%016"PRIx64"-0x%016"PRIx64"\n",
@@ -270,18 +430,20 @@ main(int argc, char *argv[])
 
 	fprintf(stdout, "OA data timestamp range:               0x%016"PRIx64"-0x%016"PRIx64"\n",
 		intel_xe_perf_read_record_timestamp(reader.perf,
-						 reader.metric_set,
-						 reader.records[0]),
+						    reader.metric_set,
+						    intel_xe_perf_data_reader_get_record(&reader, 0)),
 		intel_xe_perf_read_record_timestamp(reader.perf,
-						 reader.metric_set,
-						 reader.records[reader.n_records - 1]));
+						    reader.metric_set,
+						    intel_xe_perf_data_reader_get_record(&reader,
+											 reader.n_records - 1)));
 	fprintf(stdout, "OA raw data timestamp range:           0x%016"PRIx64"-0x%016"PRIx64"\n",
 		intel_xe_perf_read_record_timestamp_raw(reader.perf,
-						     reader.metric_set,
-						     reader.records[0]),
+							reader.metric_set,
+							intel_xe_perf_data_reader_get_record(&reader, 0)),
 		intel_xe_perf_read_record_timestamp_raw(reader.perf,
-						     reader.metric_set,
-						     reader.records[reader.n_records - 1]));
+							reader.metric_set,
+							intel_xe_perf_data_reader_get_record(&reader,
+											     reader.n_records - 1)));
 
 	if (strcmp(reader.metric_set_uuid, reader.metric_set->hw_config_guid)) {
 		fprintf(stdout,
@@ -289,29 +451,66 @@ main(int argc, char *argv[])
 			"WARNING: This could lead to inconsistent counter values.\n");
 	}
 
-	for (uint32_t i = 0; i < reader.n_timelines; i++) {
-		const struct intel_xe_perf_timeline_item *item = &reader.timelines[i];
+	if (trace_path) {
+		int trace_fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (trace_fd < 0 ||
+		    !write_trace(&reader, devinfo, counters, n_counters,
+				 cpu_ts_start, cpu_ts_end, trace_fd, trace_format)) {
+			fprintf(stderr, "Unable to write trace '%s': %s.\n",
+				trace_path, strerror(errno));
+			ret = EXIT_FAILURE;
+		} else {
+			fprintf(stdout, "Trace written to %s\n", trace_path);
+		}
+		if (trace_fd >= 0)
+			close(trace_fd);
+		goto exit;
+	}
+
+	if (print_busy) {
+		struct intel_xe_perf_context_busy busy[64];
+		uint32_t n_busy;
+
+		n_busy = intel_xe_perf_data_reader_context_busy(&reader,
+								cpu_ts_start, cpu_ts_end,
+								busy, sizeof(busy) / sizeof(busy[0]));
+		for (uint32_t i = 0; i < n_busy; i++) {
+			fprintf(stdout, "hw_id=0x%x busy=%" PRIu64 "ns switches=%u\n",
+				busy[i].hw_id, busy[i].busy_ns, busy[i].n_timelines);
+		}
+	}
+
+	for (uint32_t i = intel_xe_perf_data_reader_find_timeline(&reader, cpu_ts_start);
+	     i < reader.n_timelines; i++) {
+		struct intel_xe_perf_timeline_item item;
+
+		intel_xe_perf_data_reader_get_timeline(&reader, i, &item);
+		if (item.cpu_ts_start >= cpu_ts_end)
+			break;
 
 		fprintf(stdout, "Time: CPU=0x%016" PRIx64 "-0x%016" PRIx64
 			" GPU=0x%016" PRIx64 "-0x%016" PRIx64"\n",
-			item->cpu_ts_start, item->cpu_ts_end,
-			item->ts_start, item->ts_end);
+			item.cpu_ts_start, item.cpu_ts_end,
+			item.ts_start, item.ts_end);
 		fprintf(stdout, "hw_id=0x%x %s\n",
-			item->hw_id, item->hw_id == 0xffffffff ? "(idle)" : "");
+			item.hw_id, item.hw_id == 0xffffffff ? "(idle)" : "");
 
 		print_report_deltas(&reader,
-				    reader.records[item->record_start],
-				    reader.records[item->record_end],
+				    intel_xe_perf_data_reader_get_record(&reader, item.record_start),
+				    intel_xe_perf_data_reader_get_record(&reader, item.record_end),
 				    counters, n_counters);
 
 		if (print_reports) {
-			for (uint32_t r = item->record_start; r < item->record_end; r++) {
+			for (uint32_t r = item.record_start; r < item.record_end; r++) {
+				const struct intel_xe_perf_record_header *record =
+					intel_xe_perf_data_reader_get_record(&reader, r);
+
 				fprintf(stdout, " report%i = %s\n",
-					r - item->record_start,
-					intel_xe_perf_read_report_reason(reader.perf, reader.records[r]));
-				print_report_deltas(&reader,
-						    reader.records[r],
-						    reader.records[r + 1],
+					r - item.record_start,
+					intel_xe_perf_read_report_reason(reader.perf, record));
+				print_report_deltas(&reader, record,
+						    intel_xe_perf_data_reader_get_record(&reader, r + 1),
 						    counters, n_counters);
 			}
 		}
@@ -319,7 +518,8 @@ main(int argc, char *argv[])
 
  exit:
 	intel_xe_perf_data_reader_fini(&reader);
-	close(fd);
+	if (fd >= 0)
+		close(fd);
 
-	return EXIT_SUCCESS;
+	return ret;
 }
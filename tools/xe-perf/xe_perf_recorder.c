@@ -31,6 +31,7 @@
 #include "linux_scaffold.h"
 #include "xe/xe_oa.h"
 #include "xe/xe_oa_data.h"
+#include "xe/xe_oa_data_reader.h"
 #include "xe/xe_query.h"
 
 #include "xe_perf_recorder_commands.h"
@@ -828,7 +829,10 @@ usage(const char *name)
 		"     --output,             -o <path>   Output file (default = xe_perf.record)\n"
 		"     --cpu-clock,          -k <path>   Cpu clock to use for correlations\n"
 		"                                       Values: boot, mono, mono_raw (default = mono)\n"
-		"     --oa-unit-id          -u <value>  OA unit id for the capture.\n",
+		"     --oa-unit-id          -u <value>  OA unit id for the capture.\n"
+		"     --index,              -x          Write a <output>.idx index of the recording\n"
+		"                                       once done (for xe-perf-reader --index)\n"
+		"                                       Not available with a circular buffer\n",
 		name);
 }
 
@@ -927,6 +931,7 @@ main(int argc, char *argv[])
 		{"command-fifo",	required_argument, 0, 'f'},
 		{"cpu-clock",		required_argument, 0, 'k'},
 		{"oa-unit-id",		required_argument, 0, 'u'},
+		{"index",		no_argument, 0, 'x'},
 		{0, 0, 0, 0}
 	};
 	const struct {
@@ -945,7 +950,8 @@ main(int argc, char *argv[])
 	uint64_t corr_period_ns, poll_time_ns;
 	uint32_t circular_size = 0;
 	int opt, dev_node_id = -1;
-	bool list_counters = false;
+	bool list_counters = false, write_index = false;
+	char index_path[PATH_MAX];
 	FILE *output = NULL;
 	struct recording_context ctx = {
 		.drm_fd = -1,
@@ -957,7 +963,7 @@ main(int argc, char *argv[])
 		.oa_unit_id = 0,
 	};
 
-	while ((opt = getopt_long(argc, argv, "hc:d:p:m:Co:s:f:k:P:u:", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:d:p:m:Co:s:f:k:P:u:x", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0]);
@@ -1008,6 +1014,9 @@ main(int argc, char *argv[])
 		case 'u':
 			ctx.oa_unit_id = atoi(optarg);
 			break;
+		case 'x':
+			write_index = true;
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -1021,6 +1030,14 @@ main(int argc, char *argv[])
 		return EXIT_SUCCESS;
 	}
 
+	/* Circular recordings are only written out on a dump command */
+	if (write_index && circular_size) {
+		fprintf(stderr, "--index cannot be used with a circular buffer "
+			"(--size or --command-fifo).\n");
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
 	ctx.drm_fd = open_render_node(&ctx.devid, dev_node_id);
 	if (ctx.drm_fd < 0) {
 		fprintf(stderr, "Unable to open device.\n");
@@ -1145,6 +1162,10 @@ main(int argc, char *argv[])
 			goto fail;
 		}
 
+		/* An index of a previous recording would no longer match. */
+		snprintf(index_path, sizeof(index_path), "%s.idx", output_file);
+		unlink(index_path);
+
 		if (!write_version(output, &ctx) ||
 		    !write_header(output, &ctx) ||
 		    !write_topology(output, &ctx) ||
@@ -1242,6 +1263,17 @@ main(int argc, char *argv[])
 
 	teardown_recording_context(&ctx);
 
+	if (write_index) {
+		struct intel_xe_perf_data_reader reader;
+
+		fprintf(stdout, "Indexing %s\n", output_file);
+		if (intel_xe_perf_data_reader_init_cached(&reader, output_file))
+			intel_xe_perf_data_reader_fini(&reader);
+		else
+			fprintf(stderr, "Unable to index '%s': %s\n",
+				output_file, reader.error_msg);
+	}
+
 	return EXIT_SUCCESS;
 
  fail: